@@ -0,0 +1,80 @@
+/* short-lived bulk-freed allocations, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chunk.h"
+#include "where.h"
+#include "lswalloc.h"		/* for alloc_usage_cb */
+
+struct logger;
+
+/*
+ * An arena hands out zeroed memory by bumping a pointer through a
+ * block; nothing in it is freed individually, everything goes when
+ * the arena is freed.  Use it for objects that all die together,
+ * such as a received message and everything decoded from it.
+ *
+ * Blocks are recycled through a small per-thread cache so the common
+ * case reaches neither malloc() nor the leak-detective bookkeeping.
+ *
+ * Leak-detective accounting is by category rather than by pointer:
+ * each category counts, using atomics, its live arenas and the bytes
+ * handed out; report_leaks() complains about any category that still
+ * has live arenas, and whack --memory lists them.
+ */
+
+struct arena_category {
+	const char *name;
+	/* the rest is private */
+	uintmax_t live;		/* arenas */
+	uintmax_t bytes;	/* handed out by live arenas */
+	uintmax_t peak_live;
+	uintmax_t peak_bytes;
+	uintmax_t total;	/* arenas ever allocated */
+	struct arena_category *next;
+};
+
+#define ARENA_CATEGORY(NAME) { .name = NAME, }
+
+struct arena;
+
+struct arena *alloc_arena(struct arena_category *category, where_t where);
+void free_arena(struct arena **arena, where_t where);
+
+void *arena_alloc_bytes(struct arena *arena, size_t size);
+void *arena_clone_bytes(struct arena *arena, const void *orig, size_t size);
+
+#define arena_alloc_thing(ARENA, THING)				\
+	((THING*) arena_alloc_bytes(ARENA, sizeof(THING)))
+#define arena_clone_thing(ARENA, ORIG)					\
+	((__typeof__(&(ORIG))) arena_clone_bytes(ARENA, &(ORIG), sizeof(ORIG)))
+
+chunk_t arena_alloc_chunk(struct arena *arena, size_t size);
+
+/* the calling thread's block cache; for a clean shutdown */
+void free_arena_cache(void);
+
+/* true is bad; called by report_leaks() */
+bool report_arena_leaks(struct logger *logger);
+/* one entry per category */
+void arena_usage(alloc_usage_cb *cb, void *context);
+
+#endif
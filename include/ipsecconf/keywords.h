@@ -60,6 +60,7 @@ enum keyword_string_config_field {
 	KSF_LISTEN,
 	KSF_OCSP_URI,
 	KSF_OCSP_TRUSTNAME,
+	KSF_LEASE_SNAPSHOT,
 
 	KSF_ROOF
 };
@@ -279,6 +280,7 @@ enum keyword_numeric_conn_field {
 	KNCF_TCP,		/* TCP (yes/no/fallback) */
 	KNCF_REMOTE_TCPPORT,	/* TCP remote port - default 4500 */
 	KNCF_IGNORE_PEER_DNS,	/* Accept DNS nameservers from peer */
+	KNCF_IKE_WINDOW,	/* IKEv2 SET_WINDOW_SIZE to advertise */
 
 	KNCF_ROOF
 };
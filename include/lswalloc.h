@@ -23,6 +23,7 @@
 
 #include <sys/types.h>
 #include <stdarg.h>
+#include <stdint.h>		/* for uintmax_t */
 
 #include "constants.h"
 #include "lswcdefs.h"
@@ -46,6 +47,22 @@ void realloc_bytes(void **ptr, size_t old_size, size_t new_size, const char *nam
 extern bool leak_detective;
 extern bool report_leaks(struct logger *logger); /* true is bad */
 
+/*
+ * With leak_detective, memory usage by allocation name (and arena
+ * category).  The peaks are high-water marks.
+ */
+
+struct alloc_usage {
+	const char *name;
+	uintmax_t count;
+	uintmax_t bytes;
+	uintmax_t peak_count;
+	uintmax_t peak_bytes;
+};
+
+typedef void (alloc_usage_cb)(const struct alloc_usage *usage, void *context);
+void alloc_usage(alloc_usage_cb *cb, void *context);
+
 /*
  * Notes on __typeof__().
  *
@@ -55,6 +55,17 @@
 # define STRFTIME_LIKE(n) __attribute__ ((format(strftime, n, 0)))
 #endif
 
+/*
+ * Branch hint: the guarded code is expected to be skipped, so GCC
+ * moves it out of line.  Used by DBGP() so that, with debugging
+ * off, a dbg() costs a load and a not-taken branch.
+ */
+#ifdef GCC_LINT
+# define UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+# define UNLIKELY(x) (x)
+#endif
+
 /*
  * A macro to discard the const portion of a variable to avoid
  * otherwise unavoidable -Wcast-qual warnings.  USE WITH CAUTION and
@@ -354,7 +354,13 @@ extern lset_t cur_debugging;	/* current debugging level */
 
 #define DEBUG_PREFIX "| "
 
-#define DBGP(cond)	(cur_debugging & (cond))
+/*
+ * With debugging off, this is the entire cost of a dbg() et.al.:
+ * the message arguments are only evaluated inside the (out of line)
+ * guarded block.  Hence arguments such as str_enum() or
+ * str_endpoint() belong inside the dbg() and not before it.
+ */
+#define DBGP(cond)	UNLIKELY(cur_debugging & (cond))
 
 #define DBGF(COND, MESSAGE, ...)				\
 	{							\
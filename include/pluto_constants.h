@@ -186,6 +186,7 @@ enum global_timer {
 	EVENT_PENDING_PHASE2,		/* do not make pending phase2 wait forever */
 	EVENT_CHECK_CRLS,		/* check/update CRLS */
 	EVENT_REVIVE_CONNS,
+	EVENT_CHECK_ORIENTATIONS,	/* re-orient connections after changes */
 
 	EVENT_FREE_ROOT_CERTS,
 #define FREE_ROOT_CERTS_TIMEOUT		deltatime(5 * secs_per_minute)
@@ -193,6 +194,12 @@ enum global_timer {
 	EVENT_RESET_LOG_LIMITER,	/* set rate limited log message count back to 0 */
 #define RESET_LOG_LIMITER_FREQUENCY	deltatime(secs_per_hour)
 
+	EVENT_SAVE_LEASE_SNAPSHOT,	/* checkpoint address pool leases */
+#define LEASE_SNAPSHOT_DELAY		deltatime(10)
+
+	EVENT_ROTATE_TICKET_KEY,	/* replace the session resumption ticket key */
+#define TICKET_KEY_LIFETIME		deltatime(IKE_SA_LIFETIME_MAXIMUM)
+
 	EVENT_NAT_T_KEEPALIVE,		/* NAT Traversal Keepalive */
 
 	EVENT_PROCESS_KERNEL_QUEUE,	/* non-netkey */
@@ -369,6 +376,7 @@ typedef enum {
 #define IPSEC_SA_DEFAULT_REPLAY_WINDOW 128 /* for Linux, requires 2.6.39+ */
 
 #define IKE_V2_OVERLAPPING_WINDOW_SIZE	1 /* our default for rfc 7296 # 2.3 */
+#define IKE_V2_MAX_WINDOW_SIZE		32 /* fairly arbitrary; bounds parked exchanges */
 
 #define PPK_ID_MAXLEN 64 /* fairly arbitrary */
 
@@ -239,8 +239,7 @@ diag_t unpack_dns_ipseckey(const struct id *id, /* ASKK */
 			   realtime_t install_time, realtime_t until_time,
 			   uint32_t ttl,
 			   shunk_t dnssec_pubkey,
-			   struct pubkey **pubkey,
-			   struct pubkey_list **head);
+			   struct pubkey **pubkey);
 
 void replace_public_key(struct pubkey_list **pubkey_db,
 			struct pubkey **pk);
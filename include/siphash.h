@@ -0,0 +1,42 @@
+/* SipHash-2-4 keyed MAC, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef SIPHASH_H
+#define SIPHASH_H
+
+#include <stdint.h>
+
+#include "shunk.h"
+
+/*
+ * SipHash-2-4 with a 128-bit output (Aumasson and Bernstein).
+ *
+ * A short-input keyed MAC that needs no context, no allocation and
+ * no NSS; good for stateless tokens such as IKEv2 cookies where the
+ * key is local and short lived.  It is not a replacement for the
+ * negotiated PRF/integrity algorithms.
+ */
+
+struct siphash_key {
+	uint8_t bytes[16];
+};
+
+struct siphash_mac {
+	uint8_t bytes[16];
+};
+
+struct siphash_mac siphash_2_4(const struct siphash_key *key, shunk_t data);
+
+#endif
@@ -67,7 +67,7 @@
  */
 
 #define WHACK_BASIC_MAGIC (((((('w' << 8) + 'h') << 8) + 'k') << 8) + 25)
-#define WHACK_MAGIC (((((('o' << 8) + 'h') << 8) + 'k') << 8) + 49)
+#define WHACK_MAGIC (((((('o' << 8) + 'h') << 8) + 'k') << 8) + 51)
 
 /* struct whack_end is a lot like connection.h's struct end
  * It differs because it is going to be shipped down a socket
@@ -150,6 +150,7 @@ struct whack_message {
 	 */
 
 	bool whack_process_status; /* non-basic */
+	bool whack_memory_status; /* non-basic */
 
 	bool whack_leave_state; /* non-basic: dont send delete or  clean kernel state on shutdown */
 	/* name is used in connection and initiate */
@@ -252,6 +253,7 @@ struct whack_message {
 	bool send_no_esp_tfc;
 	reqid_t sa_reqid;
 	int nflog_group;
+	unsigned ike_window;	/* IKEv2 SET_WINDOW_SIZE; 0 for default */
 
 	char *sec_label;	/* sec_label string (if any) -- decoded by pluto */
 
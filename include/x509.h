@@ -78,6 +78,16 @@ extern bool same_dn(asn1_t a, asn1_t b);
 extern bool match_dn(asn1_t a, asn1_t b, int *wildcards);
 extern bool match_dn_any_order_wild(const char *prefix, asn1_t a, asn1_t b, int *wildcards);
 extern bool dn_has_wildcards(asn1_t dn);
+
+/*
+ * Hash each non-wildcard AVA value of DN, in the canonical form
+ * match_dn_any_order_wild() uses to reject (ASCII case folded,
+ * spaces dropped, OID and string type ignored).  If A matches B then
+ * every hash of B is also a hash of A.  Returns the number of
+ * hashes, or -1 when DN doesn't parse, has more than MAX values, or
+ * has a value NSS might re-encode.
+ */
+extern int dn_value_hashes(asn1_t dn, uint64_t *hashes, unsigned max);
 extern err_t atodn(const char *src, chunk_t *dn);
 extern void free_generalNames(generalName_t *gn, bool free_name);
 extern void load_crls(void);
@@ -397,6 +397,7 @@ const struct keyword_def ipsec_conf_keywords[] = {
 #endif
   { "virtual-private",  kv_config,  kt_string,  KSF_VIRTUALPRIVATE, NULL, NULL, },
   { "virtual_private",  kv_config,  kt_string,  KSF_VIRTUALPRIVATE, NULL, NULL, }, /* obsolete variant, very common */
+  { "lease-snapshot",  kv_config,  kt_filename,  KSF_LEASE_SNAPSHOT, NULL, NULL, },
   { "seedbits",  kv_config,  kt_number,  KBF_SEEDBITS, NULL, NULL, },
   { "keep-alive",  kv_config,  kt_number,  KBF_KEEPALIVE, NULL, NULL, },
 
@@ -579,6 +580,7 @@ const struct keyword_def ipsec_conf_keywords[] = {
   { "priority",  kv_conn,  kt_number,  KNCF_PRIORITY, NULL, NULL, },
   { "tfc",  kv_conn,  kt_number,  KNCF_TFCPAD, NULL, NULL, },
   { "reqid",  kv_conn,  kt_number,  KNCF_REQID, NULL, NULL, },
+  { "ikewindow",  kv_conn,  kt_number,  KNCF_IKE_WINDOW, NULL, NULL, },
 #ifdef HAVE_IPTABLES
   { "nflog",  kv_conn,  kt_number,  KNCF_NFLOG_CONN, NULL, NULL, },
 #endif
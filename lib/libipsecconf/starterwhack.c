@@ -544,6 +544,8 @@ static int starter_whack_basic_add_conn(struct starter_config *cfg,
 		msg.send_no_esp_tfc = conn->options[KNCF_NO_ESP_TFC];
 	if (conn->options_set[KNCF_NFLOG_CONN])
 		msg.nflog_group = conn->options[KNCF_NFLOG_CONN];
+	if (conn->options_set[KNCF_IKE_WINDOW])
+		msg.ike_window = conn->options[KNCF_IKE_WINDOW];
 
 	if (conn->options_set[KNCF_REQID]) {
 		if (conn->options[KNCF_REQID] <= 0 ||
@@ -30,6 +30,7 @@
 #include "lswlog.h"
 
 #include "lswalloc.h"
+#include "arena.h"		/* for report_arena_leaks() */
 
 bool leak_detective = false;	/* must not change after first alloc! */
 
@@ -52,52 +53,142 @@ bool leak_detective = false;	/* must not change after first alloc! */
 /* this magic number is 3671129837 decimal (623837458 complemented) */
 #define LEAK_MAGIC 0xDAD0FEEDul
 
+/*
+ * Allocations are tracked in shards so that threads don't all
+ * serialize on one mutex.  A thread is assigned a shard on its first
+ * allocation and, from then on, adds its allocations to that shard.
+ * Freeing an allocation removes it from the shard it was added to;
+ * only then (a free on a different thread) is there any contention.
+ *
+ * Each shard also keeps per-name counters and high-water marks.
+ * They are merged across shards, by name, only when reporting.  The
+ * merged high-water mark is the sum of each shard's and so can
+ * overstate the true peak.
+ */
+
+#define ALLOC_SHARDS 16
+#define ALLOC_NAMES 1024	/* per shard; power of 2 */
+
+struct alloc_name {
+	const char *name;
+	/* NAME can be dynamic and freed; keep a copy */
+	char text[48];
+	struct alloc_usage usage;
+};
+
+union mhdr;
+
+static struct alloc_shard {
+	pthread_mutex_t mutex;
+	union mhdr *allocs;	/* newest */
+	struct alloc_name names[ALLOC_NAMES];
+	struct alloc_name overflow;
+} alloc_shards[ALLOC_SHARDS];
+
+static pthread_once_t alloc_shards_once = PTHREAD_ONCE_INIT;
+static unsigned next_alloc_shard;
+static __thread struct alloc_shard *thread_alloc_shard;
+
 union mhdr {
 	struct {
 		const char *name;
 		union mhdr *older, *newer;
 		unsigned long magic;
 		unsigned long size;
+		struct alloc_shard *shard;
+		struct alloc_name *counters;
 	} i;	/* info */
 	unsigned long long junk;	/* force maximal alignment */
 };
 
-/* protects updates to the leak-detective linked list */
-static pthread_mutex_t leak_detective_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void init_alloc_shards(void)
+{
+	for (unsigned i = 0; i < ALLOC_SHARDS; i++) {
+		pthread_mutex_init(&alloc_shards[i].mutex, NULL);
+		alloc_shards[i].overflow.usage.name = "(other)";
+	}
+}
+
+static struct alloc_shard *alloc_shard(void)
+{
+	if (thread_alloc_shard == NULL) {
+		pthread_once(&alloc_shards_once, init_alloc_shards);
+		unsigned i = __atomic_fetch_add(&next_alloc_shard, 1, __ATOMIC_RELAXED);
+		thread_alloc_shard = &alloc_shards[i % ALLOC_SHARDS];
+	}
+	return thread_alloc_shard;
+}
 
-static union mhdr *allocs = NULL;
+/*
+ * Names are almost always string constants so hash by address; the
+ * text is compared as well in case a dynamic name's address gets
+ * re-used.
+ */
+static struct alloc_name *alloc_name(struct alloc_shard *shard, const char *name)
+{
+	uintptr_t hash = (uintptr_t)name;
+	hash ^= hash >> 17;
+	hash *= 0x9E3779B1u;
+	for (unsigned probe = 0; probe < ALLOC_NAMES; probe++) {
+		struct alloc_name *n = &shard->names[(hash + probe) & (ALLOC_NAMES - 1)];
+		if (n->name == name &&
+		    strncmp(n->text, name, sizeof(n->text) - 1) == 0) {
+			return n;
+		}
+		if (n->name == NULL) {
+			n->name = name;
+			strncpy(n->text, name, sizeof(n->text) - 1);
+			n->usage.name = n->text;
+			return n;
+		}
+	}
+	return &shard->overflow;
+}
 
 static void install_allocation(union mhdr *p, size_t size, const char *name)
 {
+	struct alloc_shard *shard = alloc_shard();
 	p->i.name = name;
 	p->i.size = size;
 	p->i.magic = LEAK_MAGIC;
 	p->i.newer = NULL;
+	p->i.shard = shard;
 	{
-		pthread_mutex_lock(&leak_detective_mutex);
-		p->i.older = allocs;
-		if (allocs != NULL)
-			allocs->i.newer = p;
-		allocs = p;
-		pthread_mutex_unlock(&leak_detective_mutex);
+		pthread_mutex_lock(&shard->mutex);
+		p->i.older = shard->allocs;
+		if (shard->allocs != NULL)
+			shard->allocs->i.newer = p;
+		shard->allocs = p;
+		struct alloc_usage *u = &(p->i.counters = alloc_name(shard, name))->usage;
+		u->count++;
+		u->bytes += size;
+		if (u->count > u->peak_count)
+			u->peak_count = u->count;
+		if (u->bytes > u->peak_bytes)
+			u->peak_bytes = u->bytes;
+		pthread_mutex_unlock(&shard->mutex);
 	}
 }
 
 static void remove_allocation(union mhdr *p)
 {
-	pthread_mutex_lock(&leak_detective_mutex);
+	struct alloc_shard *shard = p->i.shard;
+	pthread_mutex_lock(&shard->mutex);
 	if (p->i.older != NULL) {
 		passert(p->i.older->i.newer == p);
 		p->i.older->i.newer = p->i.newer;
 	}
 	if (p->i.newer == NULL) {
-		passert(p == allocs);
-		allocs = p->i.older;
+		passert(p == shard->allocs);
+		shard->allocs = p->i.older;
 	} else {
 		passert(p->i.newer->i.older == p);
 		p->i.newer->i.older = p->i.older;
 	}
-	pthread_mutex_unlock(&leak_detective_mutex);
+	struct alloc_usage *u = &p->i.counters->usage;
+	u->count--;
+	u->bytes -= p->i.size;
+	pthread_mutex_unlock(&shard->mutex);
 	p->i.magic = ~LEAK_MAGIC;
 }
 
@@ -168,40 +259,46 @@ void pfree(void *ptr)
 
 bool report_leaks(struct logger *logger)
 {
-	union mhdr *p,
-		*pprev = NULL;
-	unsigned long n = 0;
 	unsigned long numleaks = 0;
 	unsigned long total = 0;
 
-	pthread_mutex_lock(&leak_detective_mutex);
-	p = allocs;
-	while (p != NULL) {
-		passert(p->i.magic == LEAK_MAGIC);
-		passert(pprev == p->i.newer);
-		pprev = p;
-		p = p->i.older;
-		n++;
-		if (p == NULL ||
-		    pprev->i.name != p->i.name ||
-		    pprev->i.size != p->i.size) {
-			/* filter out one-time leaks we prefer to not fix */
-			if (strstr(pprev->i.name, "(ignore)") == NULL) {
-				if (n != 1)
-					llog(RC_LOG, logger, "leak: %lu * %s, item size: %lu",
-						    n, pprev->i.name, pprev->i.size);
-				else
-					llog(RC_LOG, logger, "leak: %s, item size: %lu",
-						    pprev->i.name, pprev->i.size);
-				numleaks += n;
-				total += pprev->i.size;
-				n = 0;
-			} else {
-				n = 0;
+	for (unsigned s = 0; s < ALLOC_SHARDS; s++) {
+		struct alloc_shard *shard = &alloc_shards[s];
+		union mhdr *p,
+			*pprev = NULL;
+		unsigned long n = 0;
+		pthread_mutex_lock(&shard->mutex);
+		p = shard->allocs;
+		while (p != NULL) {
+			passert(p->i.magic == LEAK_MAGIC);
+			passert(pprev == p->i.newer);
+			pprev = p;
+			p = p->i.older;
+			n++;
+			if (p == NULL ||
+			    pprev->i.name != p->i.name ||
+			    pprev->i.size != p->i.size) {
+				/* filter out one-time leaks we prefer to not fix */
+				if (strstr(pprev->i.name, "(ignore)") == NULL) {
+					if (n != 1)
+						llog(RC_LOG, logger, "leak: %lu * %s, item size: %lu",
+							    n, pprev->i.name, pprev->i.size);
+					else
+						llog(RC_LOG, logger, "leak: %s, item size: %lu",
+							    pprev->i.name, pprev->i.size);
+					numleaks += n;
+					total += pprev->i.size;
+					n = 0;
+				} else {
+					n = 0;
+				}
 			}
 		}
+		pthread_mutex_unlock(&shard->mutex);
 	}
-	pthread_mutex_unlock(&leak_detective_mutex);
+
+	/* arenas are accounted for by category */
+	bool arena_leaks = report_arena_leaks(logger);
 
 	if (numleaks != 0) {
 		llog(RC_LOG, logger, "leak detective found %lu leaks, total size %lu",
@@ -210,7 +307,73 @@ bool report_leaks(struct logger *logger)
 		llog(RC_LOG, logger, "leak detective found no leaks");
 	}
 
-	return numleaks != 0;
+	return numleaks != 0 || arena_leaks;
+}
+
+/*
+ * Merge the per-shard counters by name.  Names are compared by value
+ * since the same string constant can have more than one address.
+ */
+
+static int alloc_usage_cmp(const void *l, const void *r)
+{
+	const struct alloc_usage *lu = l;
+	const struct alloc_usage *ru = r;
+	/* biggest first */
+	if (lu->bytes != ru->bytes) {
+		return lu->bytes < ru->bytes ? 1 : -1;
+	}
+	return strcmp(lu->name, ru->name);
+}
+
+void alloc_usage(alloc_usage_cb *cb, void *context)
+{
+	if (!leak_detective) {
+		return;
+	}
+
+	/* plain malloc(); can't track the tracker */
+	unsigned roof = 0;
+	struct alloc_usage *usage = NULL;
+
+	for (unsigned s = 0; s < ALLOC_SHARDS; s++) {
+		struct alloc_shard *shard = &alloc_shards[s];
+		pthread_mutex_lock(&shard->mutex);
+		for (unsigned i = 0; i <= ALLOC_NAMES; i++) {
+			const struct alloc_name *n = (i < ALLOC_NAMES ? &shard->names[i] :
+						      &shard->overflow);
+			if (n->usage.name == NULL || n->usage.peak_count == 0) {
+				continue;
+			}
+			unsigned u;
+			for (u = 0; u < roof; u++) {
+				if (streq(usage[u].name, n->usage.name)) {
+					break;
+				}
+			}
+			if (u == roof) {
+				struct alloc_usage *grown = realloc(usage, (roof + 1) * sizeof(*usage));
+				if (grown == NULL) {
+					break;
+				}
+				usage = grown;
+				usage[roof++] = (struct alloc_usage) { .name = n->usage.name, };
+			}
+			usage[u].count += n->usage.count;
+			usage[u].bytes += n->usage.bytes;
+			usage[u].peak_count += n->usage.peak_count;
+			usage[u].peak_bytes += n->usage.peak_bytes;
+		}
+		pthread_mutex_unlock(&shard->mutex);
+	}
+
+	if (roof > 0) {
+		qsort(usage, roof, sizeof(*usage), alloc_usage_cmp);
+	}
+	for (unsigned u = 0; u < roof; u++) {
+		cb(&usage[u], context);
+	}
+	free(usage);
 }
 
 static void *zalloc(size_t size)
@@ -0,0 +1,291 @@
+/* short-lived bulk-freed allocations, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <pthread.h>	/* pthread.h must be first include file */
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "lswalloc.h"		/* for leak_detective */
+#include "lswlog.h"
+#include "refcnt.h"		/* for dbg_alloc() */
+
+/*
+ * Big enough for a struct msg_digest, a full sized UDP packet, and
+ * the odds and ends decoded from it.
+ */
+#define ARENA_BLOCK_SIZE (16 * 1024)
+/* anything this big gets a block of its own */
+#define ARENA_OVERSIZE (ARENA_BLOCK_SIZE / 4)
+/* per thread */
+#define ARENA_CACHE_BLOCKS 8
+
+#define ARENA_ALIGN 16
+#define ARENA_ROUNDUP(SIZE) (((SIZE) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct arena_block {
+	struct arena_block *next;	/* older block, or next cached block */
+	size_t size;			/* of data[] */
+	size_t used;
+	/* align data[] */
+	unsigned long long data[];
+};
+
+struct arena {
+	struct arena_category *category;
+	struct arena_block *blocks;	/* the current block is first */
+	size_t bytes;
+};
+
+/*
+ * Per-thread block cache.
+ *
+ * A block freed on a different thread to the one that allocated it
+ * simply ends up in the other thread's cache.  The cache is emptied
+ * when its thread exits.
+ */
+
+static __thread struct arena_cache {
+	struct arena_block *blocks;
+	unsigned nr;
+	bool registered;
+} arena_cache;
+
+static pthread_once_t arena_cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t arena_cache_key;
+
+static void empty_arena_cache(void *arg)
+{
+	struct arena_cache *cache = arg;
+	while (cache->blocks != NULL) {
+		struct arena_block *block = cache->blocks;
+		cache->blocks = block->next;
+		free(block);
+	}
+	cache->nr = 0;
+}
+
+static void create_arena_cache_key(void)
+{
+	if (pthread_key_create(&arena_cache_key, empty_arena_cache) != 0) {
+		llog_passert(&global_logger, HERE, "creating arena cache key failed");
+	}
+}
+
+void free_arena_cache(void)
+{
+	empty_arena_cache(&arena_cache);
+}
+
+static struct arena_block *get_block(size_t size)
+{
+	if (size == ARENA_BLOCK_SIZE && arena_cache.blocks != NULL) {
+		struct arena_block *block = arena_cache.blocks;
+		arena_cache.blocks = block->next;
+		arena_cache.nr--;
+		block->next = NULL;
+		block->used = 0;
+		return block;
+	}
+	struct arena_block *block = malloc(sizeof(struct arena_block) + size);
+	if (block == NULL) {
+		llog_passert(&global_logger, HERE,
+			     "unable to allocate %zu byte arena block", size);
+	}
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	return block;
+}
+
+static void put_block(struct arena_block *block)
+{
+	if (leak_detective) {
+		/* stomp on memory! same as pfree() */
+		memset(block->data, 0xEF, block->used);
+	}
+	if (block->size != ARENA_BLOCK_SIZE ||
+	    arena_cache.nr >= ARENA_CACHE_BLOCKS) {
+		free(block);
+		return;
+	}
+	if (!arena_cache.registered) {
+		pthread_once(&arena_cache_once, create_arena_cache_key);
+		pthread_setspecific(arena_cache_key, &arena_cache);
+		arena_cache.registered = true;
+	}
+	block->next = arena_cache.blocks;
+	arena_cache.blocks = block;
+	arena_cache.nr++;
+}
+
+static void *bump(struct arena_block *block, size_t size)
+{
+	void *ptr = (uint8_t *)block->data + block->used;
+	block->used += ARENA_ROUNDUP(size);
+	return ptr;
+}
+
+static void raise_peak(uintmax_t *peak, uintmax_t value)
+{
+	uintmax_t old = __atomic_load_n(peak, __ATOMIC_RELAXED);
+	while (value > old &&
+	       !__atomic_compare_exchange_n(peak, &old, value, /*weak*/true,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		/* OLD was updated */
+	}
+}
+
+/*
+ * Categories; registered on first use so report_arena_leaks() can
+ * find them.
+ */
+
+static pthread_mutex_t arena_categories_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct arena_category *arena_categories;
+
+static void register_arena_category(struct arena_category *category)
+{
+	pthread_mutex_lock(&arena_categories_mutex);
+	{
+		struct arena_category *c;
+		for (c = arena_categories; c != NULL; c = c->next) {
+			if (c == category) {
+				break;
+			}
+		}
+		if (c == NULL) {
+			category->next = arena_categories;
+			arena_categories = category;
+		}
+	}
+	pthread_mutex_unlock(&arena_categories_mutex);
+}
+
+struct arena *alloc_arena(struct arena_category *category, where_t where)
+{
+	if (__atomic_add_fetch(&category->total, 1, __ATOMIC_RELAXED) == 1) {
+		register_arena_category(category);
+	}
+	raise_peak(&category->peak_live,
+		   __atomic_add_fetch(&category->live, 1, __ATOMIC_RELAXED));
+
+	struct arena_block *block = get_block(ARENA_BLOCK_SIZE);
+	struct arena *arena = bump(block, sizeof(struct arena));
+	*arena = (struct arena) {
+		.category = category,
+		.blocks = block,
+	};
+	dbg_alloc(category->name, arena, where);
+	return arena;
+}
+
+static void *uninitialized_arena_alloc(struct arena *arena, size_t size)
+{
+	arena->bytes += size;
+	raise_peak(&arena->category->peak_bytes,
+		   __atomic_add_fetch(&arena->category->bytes, size, __ATOMIC_RELAXED));
+	struct arena_block *current = arena->blocks;
+	if (current->size - current->used >= size) {
+		return bump(current, size);
+	}
+	if (size >= ARENA_OVERSIZE) {
+		/* slip it in behind the current block */
+		struct arena_block *block = get_block(size);
+		block->next = current->next;
+		current->next = block;
+		return bump(block, size);
+	}
+	struct arena_block *block = get_block(ARENA_BLOCK_SIZE);
+	block->next = current;
+	arena->blocks = block;
+	return bump(block, size);
+}
+
+void *arena_alloc_bytes(struct arena *arena, size_t size)
+{
+	void *ptr = uninitialized_arena_alloc(arena, size);
+	memset(ptr, '\0', size);
+	return ptr;
+}
+
+void *arena_clone_bytes(struct arena *arena, const void *orig, size_t size)
+{
+	void *ptr = uninitialized_arena_alloc(arena, size);
+	if (size > 0) {
+		memcpy(ptr, orig, size);
+	}
+	return ptr;
+}
+
+chunk_t arena_alloc_chunk(struct arena *arena, size_t size)
+{
+	return (chunk_t) {
+		.ptr = arena_alloc_bytes(arena, size),
+		.len = size,
+	};
+}
+
+void free_arena(struct arena **arenap, where_t where)
+{
+	struct arena *arena = *arenap;
+	*arenap = NULL;
+	if (arena == NULL) {
+		return;
+	}
+	dbg_free(arena->category->name, arena, where);
+	struct arena_category *category = arena->category;
+	__atomic_sub_fetch(&category->live, 1, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&category->bytes, arena->bytes, __ATOMIC_RELAXED);
+	/* ARENA is in the last block */
+	struct arena_block *block = arena->blocks;
+	while (block != NULL) {
+		struct arena_block *next = block->next;
+		put_block(block);
+		block = next;
+	}
+}
+
+bool report_arena_leaks(struct logger *logger)
+{
+	bool leaks = false;
+	pthread_mutex_lock(&arena_categories_mutex);
+	for (struct arena_category *c = arena_categories; c != NULL; c = c->next) {
+		uintmax_t live = __atomic_load_n(&c->live, __ATOMIC_RELAXED);
+		if (live > 0) {
+			llog(RC_LOG, logger, "leak: %ju * arena %s, total size %ju",
+			     live, c->name, __atomic_load_n(&c->bytes, __ATOMIC_RELAXED));
+			leaks = true;
+		}
+	}
+	pthread_mutex_unlock(&arena_categories_mutex);
+	return leaks;
+}
+
+void arena_usage(alloc_usage_cb *cb, void *context)
+{
+	pthread_mutex_lock(&arena_categories_mutex);
+	for (struct arena_category *c = arena_categories; c != NULL; c = c->next) {
+		struct alloc_usage usage = {
+			.name = c->name,
+			.count = __atomic_load_n(&c->live, __ATOMIC_RELAXED),
+			.bytes = __atomic_load_n(&c->bytes, __ATOMIC_RELAXED),
+			.peak_count = __atomic_load_n(&c->peak_live, __ATOMIC_RELAXED),
+			.peak_bytes = __atomic_load_n(&c->peak_bytes, __ATOMIC_RELAXED),
+		};
+		cb(&usage, context);
+	}
+	pthread_mutex_unlock(&arena_categories_mutex);
+}
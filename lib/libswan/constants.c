@@ -2260,8 +2260,11 @@ static const char *global_timer_name[] = {
 	E(EVENT_PENDING_PHASE2),
 	E(EVENT_CHECK_CRLS),
 	E(EVENT_REVIVE_CONNS),
+	E(EVENT_CHECK_ORIENTATIONS),
 	E(EVENT_FREE_ROOT_CERTS),
 	E(EVENT_RESET_LOG_LIMITER),
+	E(EVENT_SAVE_LEASE_SNAPSHOT),
+	E(EVENT_ROTATE_TICKET_KEY),
 	E(EVENT_PROCESS_KERNEL_QUEUE),
 	E(EVENT_NAT_T_KEEPALIVE),
 #undef E
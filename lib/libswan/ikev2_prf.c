@@ -22,6 +22,8 @@
  *
  */
 
+#include <string.h>
+
 #include "ike_alg.h"
 #include "ike_alg_prf_ikev2_ops.h"
 
@@ -72,6 +74,26 @@ PK11SymKey *ikev2_ike_sa_rekey_skeyseed(const struct prf_desc *prf_desc,
 							      Ni, Nr, logger);
 }
 
+/*
+ * SKEYSEED = prf(SK_d (old), "Resumption" | Ni | Nr)
+ *
+ * RFC 5723 5.1; there's no DH so the PRF is used directly.
+ */
+PK11SymKey *ikev2_ike_sa_resume_skeyseed(const struct prf_desc *prf_desc,
+					 PK11SymKey *SK_d_old,
+					 const chunk_t Ni, const chunk_t Nr,
+					 struct logger *logger)
+{
+	static const char resumption[] = "Resumption";
+	struct crypt_prf *prf = crypt_prf_init_symkey("resume SKEYSEED", prf_desc,
+						      "SK_d (old)", SK_d_old,
+						      logger);
+	crypt_prf_update_bytes(prf, "Resumption", resumption, strlen(resumption));
+	crypt_prf_update_hunk(prf, "Ni", Ni);
+	crypt_prf_update_hunk(prf, "Nr", Nr);
+	return crypt_prf_final_symkey(&prf);
+}
+
 /*
  * Compute: prf+ (SKEYSEED, Ni | Nr | SPIi | SPIr)
  */
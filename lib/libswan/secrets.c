@@ -1107,8 +1107,7 @@ diag_t unpack_dns_ipseckey(const struct id *id, /* ASKK */
 			   realtime_t install_time, realtime_t until_time,
 			   uint32_t ttl,
 			   const shunk_t dnssec_pubkey,
-			   struct pubkey **pkp,
-			   struct pubkey_list **head)
+			   struct pubkey **pkp)
 {
 	/*
 	 * First: unpack the raw public key.
@@ -1146,16 +1145,11 @@ diag_t unpack_dns_ipseckey(const struct id *id, /* ASKK */
 	 * Second: use extracted information to create the pubkey.
 	 */
 
-	struct pubkey *pubkey = alloc_pubkey(id, dns_auth_level,
-					     install_time, until_time, ttl,
-					     &scratch_pkc,
-					     null_shunk,	/* raw keys have no issuer */
-					     HERE);
-	if (pkp != NULL) {
-		*pkp = pubkey_addref(pubkey);
-	}
-	install_public_key(&pubkey, head);
-	passert(pubkey == NULL); /* stolen */
+	*pkp = alloc_pubkey(id, dns_auth_level,
+			    install_time, until_time, ttl,
+			    &scratch_pkc,
+			    null_shunk,	/* raw keys have no issuer */
+			    HERE);
 	return NULL;
 }
 
@@ -237,6 +237,207 @@ bool dn_has_wildcards(asn1_t dn)
 	return false;
 }
 
+/*
+ * A cheap summary of a DN, so that the common cases of
+ * match_dn_any_order_wild() (and same_dn()) can be decided without
+ * walking both DNs RDN by RDN or, worse, round-tripping them through
+ * str_dn() and NSS's CERT_AsciiToName().
+ *
+ * Each AVA value is reduced to a canonical form - ASCII lower case
+ * with spaces dropped, OID and string type ignored - and hashed into
+ * a two-bit signature.  Anything the ordered or unordered comparisons
+ * would consider equal has the same canonical form (but not the
+ * reverse), so when B has a non-wildcard AVA whose bits are missing
+ * from A, A can't match B.
+ *
+ * Values that NSS might convert or unescape differently (BMPString,
+ * bytes outside of printable ASCII, '#', '\\') make the DN "opaque"
+ * and the summary isn't used to reject.
+ */
+
+struct dn_summary {
+	bool valid;
+	bool wildcards;
+	bool opaque;
+	uint64_t all;		/* every AVA */
+	uint64_t nowild;	/* every AVA that isn't a '*' */
+};
+
+static uint64_t fnv1a(uint64_t hash, uint8_t byte)
+{
+	return (hash ^ byte) * UINT64_C(0x100000001b3);
+}
+
+#define FNV1A_BASIS UINT64_C(0xcbf29ce484222325)
+
+/*
+ * Hash VALUE's canonical form; set OPAQUE when it might not be
+ * canonical.
+ */
+
+static uint64_t hash_dn_value(enum asn1_type value_type, asn1_t value_content,
+			      bool *opaque)
+{
+	const uint8_t *value = value_content.ptr;
+	if (value_type == ASN1_BMPSTRING) {
+		*opaque = true;
+	}
+
+	uint64_t hash = FNV1A_BASIS;
+	for (size_t i = 0; i < value_content.len; i++) {
+		uint8_t c = value[i];
+		if (c < 0x20 || c >= 0x7f || c == '#' || c == '\\') {
+			*opaque = true;
+		}
+		if (c == ' ') {
+			continue;
+		}
+		if (c >= 'A' && c <= 'Z') {
+			c += 'a' - 'A';
+		}
+		hash = fnv1a(hash, c);
+	}
+	return hash;
+}
+
+static bool is_wildcard_value(asn1_t value_content)
+{
+	return (value_content.len == 1 &&
+		*(const char *)value_content.ptr == '*');
+}
+
+static void summarize_dn(asn1_t dn, struct dn_summary *summary)
+{
+	*summary = (struct dn_summary) {0};
+
+	asn1_t rdn;
+	asn1_t attribute;
+	bool more;
+	if (init_rdn(dn, &rdn, &attribute, &more) != NULL) {
+		return;
+	}
+
+	while (more) {
+		asn1_t oid;
+		asn1_t value_ber;
+		enum asn1_type value_type;
+		asn1_t value_content;
+		if (get_next_rdn(&rdn, &attribute, &oid,
+				 &value_ber, &value_type, &value_content,
+				 &more) != NULL) {
+			return;
+		}
+
+		uint64_t hash = hash_dn_value(value_type, value_content,
+					      &summary->opaque);
+		uint64_t bits = ((UINT64_C(1) << (hash & 63)) |
+				 (UINT64_C(1) << ((hash >> 6) & 63)));
+		summary->all |= bits;
+		if (is_wildcard_value(value_content)) {
+			summary->wildcards = true;
+		} else {
+			summary->nowild |= bits;
+		}
+	}
+
+	summary->valid = true;
+}
+
+int dn_value_hashes(asn1_t dn, uint64_t *hashes, unsigned max)
+{
+	asn1_t rdn;
+	asn1_t attribute;
+	bool more;
+	if (init_rdn(dn, &rdn, &attribute, &more) != NULL) {
+		return -1;
+	}
+
+	unsigned nr = 0;
+	bool opaque = false;
+	while (more) {
+		asn1_t oid;
+		asn1_t value_ber;
+		enum asn1_type value_type;
+		asn1_t value_content;
+		if (get_next_rdn(&rdn, &attribute, &oid,
+				 &value_ber, &value_type, &value_content,
+				 &more) != NULL) {
+			return -1;
+		}
+		uint64_t hash = hash_dn_value(value_type, value_content, &opaque);
+		if (opaque || nr >= max) {
+			return -1;
+		}
+		if (!is_wildcard_value(value_content)) {
+			hashes[nr++] = hash;
+		}
+	}
+	return nr;
+}
+
+/*
+ * Summaries are cached, per-thread, by DN contents.  The struct id
+ * holding a DN is copied by value so there's nowhere to hang a
+ * pointer; instead the DN's bytes are the key.  Oversized DNs aren't
+ * cached.
+ */
+
+#define DN_CACHE_SLOTS 64
+#define DN_CACHE_MAX 256
+
+static __thread struct dn_cache_slot {
+	size_t len;			/* 0 is empty */
+	struct dn_summary summary;
+	uint8_t dn[DN_CACHE_MAX];
+} dn_cache[DN_CACHE_SLOTS];
+
+static void get_dn_summary(asn1_t dn, struct dn_summary *summary)
+{
+	if (dn.len == 0 || dn.len > DN_CACHE_MAX) {
+		summarize_dn(dn, summary);
+		return;
+	}
+
+	/*
+	 * DNs tend to differ at the end (the CN) so, to keep this
+	 * cheap, only hash the tail; memeq() sorts out collisions.
+	 */
+	uint64_t hash = fnv1a(FNV1A_BASIS, (uint8_t)dn.len);
+	for (size_t i = dn.len > 16 ? dn.len - 16 : 0; i < dn.len; i++) {
+		hash = fnv1a(hash, ((const uint8_t *)dn.ptr)[i]);
+	}
+
+	struct dn_cache_slot *slot = &dn_cache[hash % DN_CACHE_SLOTS];
+	if (slot->len == dn.len && memeq(slot->dn, dn.ptr, dn.len)) {
+		*summary = slot->summary;
+		return;
+	}
+
+	summarize_dn(dn, summary);
+	slot->len = dn.len;
+	slot->summary = *summary;
+	memcpy(slot->dn, dn.ptr, dn.len);
+}
+
+/*
+ * Return true when the summaries prove A can't match B; false is
+ * "don't know".
+ */
+
+static bool dn_summary_mismatch(asn1_t a, asn1_t b, bool exact)
+{
+	struct dn_summary sa, sb;
+	get_dn_summary(a, &sa);
+	get_dn_summary(b, &sb);
+	if (!sa.valid || !sb.valid || sa.opaque || sb.opaque) {
+		return false;
+	}
+	if (exact) {
+		return sa.all != sb.all;
+	}
+	return (sb.nowild & ~sa.all) != 0;
+}
+
 /*
  * Formats an ASN.1 Distinguished Name into an ASCII string of
  * OID/value pairs.  If there's a problem, return err_t (buf's
@@ -869,6 +1070,9 @@ bool match_dn(asn1_t a, asn1_t b, int *wildcards)
 		/* try a binary comparison first */
 		if (memeq(a.ptr, b.ptr, b.len))
 			return true;
+
+		if (dn_summary_mismatch(a, b, /*exact*/true))
+			return false;
 	}
 
 	/*
@@ -970,7 +1174,7 @@ bool match_dn(asn1_t a, asn1_t b, int *wildcards)
 		      known_oid(oid_a) == OID_PKCS9_EMAIL)) &&
 		    strncaseeq((char *)value_content_a.ptr,
 				(char *)value_content_b.ptr, value_content_b.len) &&
-		    memchr(value_content_a.ptr, '\0', a.len) == NULL)
+		    memchr(value_content_a.ptr, '\0', value_content_a.len) == NULL)
 		{
 			continue;	/* component match */
 		}
@@ -1109,6 +1313,24 @@ static bool match_dn_unordered(const char *prefix, asn1_t a, asn1_t b, int *cons
 
 bool match_dn_any_order_wild(const char *prefix, asn1_t a, asn1_t b, int *wildcards)
 {
+	/*
+	 * The common cases: the same DN, or a DN that obviously
+	 * doesn't match.  Only candidates that survive both go
+	 * through the slow path.
+	 */
+	if (hunk_eq(a, b)) {
+		struct dn_summary sb;
+		get_dn_summary(b, &sb);
+		if (sb.valid && !sb.wildcards) {
+			*wildcards = 0;
+			return true;
+		}
+	} else if (dn_summary_mismatch(a, b, /*exact*/false)) {
+		dbg("%s%s: DNs can't match in any order", prefix, __func__);
+		*wildcards = 0;
+		return false;
+	}
+
 	bool ret = match_dn(a, b, wildcards);
 
 	if (!ret) {
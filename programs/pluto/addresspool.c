@@ -29,6 +29,14 @@
  * used for more than one connection.
  */
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>		/* for rename() */
+#include <errno.h>
+#include <limits.h>		/* for PATH_MAX */
+
 #include "lswalloc.h"
 #include "connections.h"
 #include "defs.h"
@@ -40,6 +48,9 @@
 #include "log.h"
 #include "refcnt.h"
 #include "show.h"
+#include "hash_table.h"		/* for hash_bytes() */
+#include "timer.h"		/* for schedule_oneshot_timer() */
+#include "ip_info.h"
 
 #define SENTINEL (unsigned)-1
 #define ENTRY_UNUSED (unsigned)-2
@@ -90,7 +101,7 @@ static const struct list empty_list = {
 		if (IS_EMPTY(WHAT, LIST)) {				\
 			result_ = NULL;					\
 		} else {						\
-			result_ = &pool->leases[WHAT->LIST.first];	\
+			result_ = POOL_LEASE(pool, WHAT->LIST.first);	\
 		}							\
 		result_;						\
 	})
@@ -98,14 +109,14 @@ static const struct list empty_list = {
 #define REMOVE(WHAT, LIST, ENTRY, LEASE)				\
 	{								\
 		passert(IS_INSERTED(LEASE, ENTRY));			\
-		unsigned index = LEASE - pool->leases;			\
+		unsigned index = LEASE->index;				\
 		if (WHAT->LIST.first == index) {			\
 			WHAT->LIST.first = LEASE->ENTRY.next;		\
 		} else {						\
 			/* not first; must have prev */			\
 			passert(LEASE->ENTRY.prev != SENTINEL);		\
 			passert(LEASE->ENTRY.prev < pool->nr_leases);	\
-			pool->leases[LEASE->ENTRY.prev].ENTRY.next =	\
+			POOL_LEASE(pool, LEASE->ENTRY.prev)->ENTRY.next = \
 				LEASE->ENTRY.next;			\
 		}							\
 		if (WHAT->LIST.last == index) {				\
@@ -114,7 +125,7 @@ static const struct list empty_list = {
 			/* not last; must have next */			\
 			passert(LEASE->ENTRY.next != SENTINEL);		\
 			passert(LEASE->ENTRY.next < pool->nr_leases);	\
-			pool->leases[LEASE->ENTRY.next].ENTRY.prev =	\
+			POOL_LEASE(pool, LEASE->ENTRY.next)->ENTRY.prev = \
 				LEASE->ENTRY.prev;			\
 		}							\
 		LEASE->ENTRY.next = LEASE->ENTRY.prev = ENTRY_UNUSED;	\
@@ -125,7 +136,7 @@ static const struct list empty_list = {
 #define FILL(WHAT, LIST, ENTRY, LEASE)					\
 	{								\
 		/* empty */						\
-		unsigned index = LEASE - pool->leases;			\
+		unsigned index = LEASE->index;				\
 		WHAT->LIST.first = WHAT->LIST.last = index;		\
 		LEASE->ENTRY.next = LEASE->ENTRY.prev = SENTINEL;	\
 	}
@@ -136,11 +147,11 @@ static const struct list empty_list = {
 		if (IS_EMPTY(WHAT, LIST)) {				\
 			FILL(WHAT, LIST, ENTRY, LEASE);			\
 		} else {						\
-			unsigned index = LEASE - pool->leases;		\
+			unsigned index = LEASE->index;			\
 			unsigned old_last = WHAT->LIST.last;		\
 			LEASE->ENTRY.next = SENTINEL;			\
 			LEASE->ENTRY.prev = old_last;			\
-			pool->leases[old_last].ENTRY.next = index;	\
+			POOL_LEASE(pool, old_last)->ENTRY.next = index;	\
 			WHAT->LIST.last = index;			\
 		}							\
 		WHAT->LIST.nr++;					\
@@ -154,11 +165,11 @@ static const struct list empty_list = {
 			/* empty */					\
 			FILL(WHAT, LIST, ENTRY, LEASE);			\
 		} else {						\
-			unsigned index = LEASE - WHAT->leases;		\
+			unsigned index = LEASE->index;			\
 			unsigned old_first = WHAT->LIST.first;		\
 			LEASE->ENTRY.next = old_first;			\
 			LEASE->ENTRY.prev = SENTINEL;			\
-			pool->leases[old_first].ENTRY.prev = index;	\
+			POOL_LEASE(pool, old_first)->ENTRY.prev = index; \
 			WHAT->LIST.first = index;			\
 		}							\
 		WHAT->LIST.nr++;					\
@@ -175,12 +186,43 @@ static const struct list empty_list = {
 
 struct lease {
 	co_serial_t assigned_to; /* ALWAYS 1:1 */
+	unsigned index;	/* address is r.start+INDEX */
 
 	struct entry free_entry;
 	struct entry reusable_entry;
 
 	char *reusable_name;
-	struct list reusable_bucket;
+	uint32_t snapshot_unit;	/* of reusable_name's record; 0 for none */
+};
+
+/* big enough for an ID and an XAUTH username */
+#define LEASE_NAME_SIZE (sizeof(id_buf) + MAX_XAUTH_USERNAME_LEN)
+
+/*
+ * Leases are allocated in fixed size blocks that, once allocated,
+ * never move; growing a pool adds a block and only the (small) table
+ * of block pointers is ever re-allocated.
+ *
+ * Reusable leases are hashed, by name, into a linear hash table:
+ * whenever there are, on average, more than two reusable leases per
+ * bucket, the next bucket in turn is split in two.  Each insert
+ * moves at most one bucket's leases so there is never a full rehash.
+ * Buckets, like leases, are allocated in blocks that never move.
+ * Growing the pool doesn't touch the table.
+ */
+
+#define LEASES_PER_BLOCK 256
+#define MIN_LEASE_BUCKETS 16
+#define BUCKETS_PER_BLOCK 256
+
+#define POOL_LEASE(POOL, INDEX)						\
+	(&(POOL)->blocks[(INDEX) / LEASES_PER_BLOCK][(INDEX) % LEASES_PER_BLOCK])
+
+#define POOL_BUCKET(POOL, INDEX)					\
+	(&(POOL)->bucket_blocks[(INDEX) / BUCKETS_PER_BLOCK][(INDEX) % BUCKETS_PER_BLOCK])
+
+struct lease_bucket {
+	struct list leases;
 };
 
 struct addresspool {
@@ -192,13 +234,27 @@ struct addresspool {
 	struct list free_list;
 	unsigned nr_in_use;	/* active */
 	/* --- .free.nr + .nr_in_use --- */
-	unsigned nr_leases;	/* nr elements in leases array */
+	unsigned nr_leases;	/* nr leases in blocks */
 
 	/*
-	 * An array of leases with NR_LEASES elements.  Entry A is for
-	 * address r.start+A.
+	 * NR_BLOCKS blocks of LEASES_PER_BLOCK leases (only the last
+	 * block can be short).  Lease L is for address r.start+L.
 	 */
-	struct lease *leases;
+	struct lease **blocks;
+	unsigned nr_blocks;
+	unsigned max_blocks;	/* size of blocks[] */
+
+	/*
+	 * NR_BUCKETS buckets; those below SPLIT have been split so a
+	 * name hashes into one of the first ROUND*2 buckets, the
+	 * others into one of the first ROUND.
+	 */
+	struct lease_bucket **bucket_blocks;
+	unsigned nr_bucket_blocks;
+	unsigned max_bucket_blocks;	/* size of bucket_blocks[] */
+	unsigned nr_buckets;
+	unsigned round;
+	unsigned split;
 
 	struct addresspool *next;	/* next pool */
 };
@@ -210,44 +266,10 @@ static void free_lease_content(struct lease *lease)
 	pfreeany(lease->reusable_name);
 }
 
-static unsigned hasher(const char *name)
-{
-	/*
-	 * 251 is a prime close to 256 (so like <<8).
-	 *
-	 * There's no real rationale for doing this.
-	 */
-	unsigned hash = 0;
-	for (const char *c = name; *c; c++) {
-		hash = hash * 251 + (uint8_t) *c;
-	}
-	return hash;
-}
-
-static struct lease *lease_id_bucket(struct addresspool *pool, const char *name)
-{
-	unsigned hash = hasher(name);
-	return &pool->leases[hash % pool->nr_leases];
-}
-
-static void hash_lease_id(struct addresspool *pool, struct lease *lease)
-{
-	struct lease *bucket = lease_id_bucket(pool, lease->reusable_name);
-	APPEND(bucket, reusable_bucket, reusable_entry, lease);
-	pool->nr_reusable++;
-}
-
-static void unhash_lease_id(struct addresspool *pool, struct lease *lease)
-{
-	struct lease *bucket = lease_id_bucket(pool, lease->reusable_name);
-	REMOVE(bucket, reusable_bucket, reusable_entry, lease);
-	pool->nr_reusable--;
-}
-
 static err_t pool_lease_to_address(const struct addresspool *pool, const struct lease *lease,
 				   ip_address *address)
 {
-	return range_offset_to_address(pool->r, lease - pool->leases, address);
+	return range_offset_to_address(pool->r, lease->index, address);
 }
 
 static void DBG_pool(bool verbose, const struct addresspool *pool,
@@ -304,6 +326,145 @@ static void DBG_lease(bool verbose, const struct addresspool *pool, const struct
 	}
 }
 
+static void snapshot_lease(const struct addresspool *pool, struct lease *lease,
+			   struct logger *logger);
+static void release_snapshot_record(uint32_t unit);
+static void keep_snapshot_lease(const struct addresspool *pool, struct lease *lease);
+
+static unsigned lease_id_hash(const char *name)
+{
+	return hash_bytes(name, strlen(name), zero_hash).hash;
+}
+
+static struct lease_bucket *lease_id_bucket(struct addresspool *pool, const char *name)
+{
+	unsigned hash = lease_id_hash(name);
+	unsigned b = hash % pool->round;
+	if (b < pool->split) {
+		b = hash % (pool->round * 2);
+	}
+	return POOL_BUCKET(pool, b);
+}
+
+/* append an empty bucket; adding a block when needed */
+
+static struct lease_bucket *add_lease_bucket(struct addresspool *pool)
+{
+	if (pool->nr_buckets == pool->nr_bucket_blocks * BUCKETS_PER_BLOCK) {
+		if (pool->nr_bucket_blocks == pool->max_bucket_blocks) {
+			unsigned old_max_blocks = pool->max_bucket_blocks;
+			pool->max_bucket_blocks = (old_max_blocks == 0 ? 1 : old_max_blocks * 2);
+			realloc_things(pool->bucket_blocks, old_max_blocks,
+				       pool->max_bucket_blocks, "lease bucket blocks");
+		}
+		pool->bucket_blocks[pool->nr_bucket_blocks++] =
+			alloc_things(struct lease_bucket, BUCKETS_PER_BLOCK, "lease bucket block");
+	}
+	struct lease_bucket *bucket = POOL_BUCKET(pool, pool->nr_buckets);
+	pool->nr_buckets++;
+	bucket->leases = empty_list;
+	return bucket;
+}
+
+static void init_lease_buckets(struct addresspool *pool)
+{
+	for (unsigned b = 0; b < MIN_LEASE_BUCKETS; b++) {
+		add_lease_bucket(pool);
+	}
+	pool->round = MIN_LEASE_BUCKETS;
+	pool->split = 0;
+}
+
+/*
+ * Split bucket SPLIT: the leases that, using the next round's
+ * modulus, hash into the new bucket SPLIT+ROUND move there.
+ */
+
+static void split_lease_bucket(struct addresspool *pool)
+{
+	struct lease_bucket *old = POOL_BUCKET(pool, pool->split);
+	unsigned new_index = pool->split + pool->round;
+	passert(new_index == pool->nr_buckets);
+	struct lease_bucket *new = add_lease_bucket(pool);
+
+	unsigned next;
+	for (unsigned current = old->leases.first; current != SENTINEL; current = next) {
+		passert(current < pool->nr_leases);
+		struct lease *lease = POOL_LEASE(pool, current);
+		next = lease->reusable_entry.next;
+		if (lease_id_hash(lease->reusable_name) % (pool->round * 2) == new_index) {
+			REMOVE(old, leases, reusable_entry, lease);
+			APPEND(new, leases, reusable_entry, lease);
+		}
+	}
+
+	pool->split++;
+	if (pool->split == pool->round) {
+		/* every bucket split; start the next round */
+		if (DBGP(DBG_BASE)) {
+			DBG_pool(false, pool, "lease buckets doubled to %u", pool->nr_buckets);
+		}
+		pool->round *= 2;
+		pool->split = 0;
+	}
+}
+
+static void hash_lease_id(struct addresspool *pool, struct lease *lease,
+			  struct logger *logger)
+{
+	if (pool->nr_reusable >= pool->nr_buckets * 2) {
+		split_lease_bucket(pool);
+	}
+	struct lease_bucket *bucket = lease_id_bucket(pool, lease->reusable_name);
+	APPEND(bucket, leases, reusable_entry, lease);
+	pool->nr_reusable++;
+	if (lease->snapshot_unit == 0) {
+		snapshot_lease(pool, lease, logger);
+	}
+}
+
+static void unhash_lease_id(struct addresspool *pool, struct lease *lease)
+{
+	struct lease_bucket *bucket = lease_id_bucket(pool, lease->reusable_name);
+	REMOVE(bucket, leases, reusable_entry, lease);
+	pool->nr_reusable--;
+	release_snapshot_record(lease->snapshot_unit);
+	lease->snapshot_unit = 0;
+}
+
+/*
+ * Add a block of leases to the end of the free list, lowest address
+ * first.
+ */
+
+static void grow_addresspool(struct addresspool *pool)
+{
+	passert(pool->nr_leases < pool->size);
+	passert(pool->nr_leases == pool->nr_blocks * LEASES_PER_BLOCK);
+	if (pool->nr_blocks == pool->max_blocks) {
+		unsigned old_max_blocks = pool->max_blocks;
+		pool->max_blocks = (old_max_blocks == 0 ? 1 : old_max_blocks * 2);
+		realloc_things(pool->blocks, old_max_blocks, pool->max_blocks, "lease blocks");
+	}
+	unsigned nr = min((uint32_t)LEASES_PER_BLOCK, pool->size - pool->nr_leases);
+	struct lease *block = alloc_things(struct lease, nr, "lease block");
+	pool->blocks[pool->nr_blocks++] = block;
+	if (DBGP(DBG_BASE)) {
+		DBG_pool(false, pool, "growing address pool from %u to %u",
+			 pool->nr_leases, pool->nr_leases + nr);
+	}
+	for (unsigned l = 0; l < nr; l++) {
+		struct lease *lease = &block[l];
+		*lease = (struct lease) {
+			.index = pool->nr_leases,
+			.free_entry = empty_entry,
+			.reusable_entry = empty_entry,
+		};
+		pool->nr_leases++;
+		APPEND(pool, free_list, free_entry, lease);
+	}
+}
+
 /*
  * A lease is an assignment of a single address from a particular pool.
  *
@@ -399,7 +560,7 @@ static struct lease *connection_lease(struct connection *c)
 	}
 	passert(pool->nr_leases <= pool->size);
 	passert(offset < pool->nr_leases);
-	struct lease *lease = &pool->leases[offset];
+	struct lease *lease = POOL_LEASE(pool, offset);
 
 	/*
 	 * Has the lease been "stolen" by a newer connection with the
@@ -480,50 +641,60 @@ void free_that_address_lease(struct connection *c)
  * return previous lease if there is one lingering for the same ID
  */
 
-static struct lease *recover_lease(const struct connection *c, const char *that_name)
+static struct lease *find_reusable_lease(struct addresspool *pool, const char *that_name)
 {
-	struct addresspool *pool = c->pool;
-	if (pool->nr_leases == 0) {
+	if (pool->nr_reusable == 0) {
 		return NULL;
 	}
 
-	struct lease *bucket = lease_id_bucket(pool, that_name);
-	if (IS_EMPTY(bucket, reusable_bucket)) {
+	struct lease_bucket *bucket = lease_id_bucket(pool, that_name);
+	if (IS_EMPTY(bucket, leases)) {
 		return NULL;
 	}
 
 	struct lease *lease;
-	for (unsigned current = bucket->reusable_bucket.first;
+	for (unsigned current = bucket->leases.first;
 	     current != SENTINEL; current = lease->reusable_entry.next) {
 		passert(current < pool->nr_leases);
-		lease = &pool->leases[current];
+		lease = POOL_LEASE(pool, current);
 		passert(lease->reusable_name != NULL);
 		if (streq(that_name, lease->reusable_name)) {
-			if (IS_INSERTED(lease, free_entry)) {
-				/* unused */
-				REMOVE(pool, free_list, free_entry, lease);
-				pexpect(co_serial_is_unset(lease->assigned_to));
-				pool->nr_in_use++;
-				if (DBGP(DBG_BASE)) {
-					connection_buf cb;
-					DBG_lease(false, pool, lease, "recovered by "PRI_CONNECTION" using '%s'; was on free-list",
-						  pri_connection(c, &cb), that_name);
-				}
-			} else {
-				/* still assigned to older connection */
-				pexpect(co_serial_cmp(lease->assigned_to, <, c->serialno));
-				if (DBGP(DBG_BASE)) {
-					connection_buf cb;
-					DBG_lease(false, pool, lease, "recovered by "PRI_CONNECTION" using '%s'; was in use by "PRI_CO,
-						  pri_connection(c, &cb), that_name, pri_co(lease->assigned_to));
-				}
-			}
 			return lease;
 		}
 	}
 	return NULL;
 }
 
+static struct lease *recover_lease(const struct connection *c, const char *that_name)
+{
+	struct addresspool *pool = c->pool;
+	struct lease *lease = find_reusable_lease(pool, that_name);
+	if (lease == NULL) {
+		return NULL;
+	}
+
+	if (IS_INSERTED(lease, free_entry)) {
+		/* unused */
+		REMOVE(pool, free_list, free_entry, lease);
+		pexpect(co_serial_is_unset(lease->assigned_to));
+		pool->nr_in_use++;
+		if (DBGP(DBG_BASE)) {
+			connection_buf cb;
+			DBG_lease(false, pool, lease, "recovered by "PRI_CONNECTION" using '%s'; was on free-list",
+				  pri_connection(c, &cb), that_name);
+		}
+	} else {
+		/* still assigned to older connection */
+		pexpect(co_serial_cmp(lease->assigned_to, <, c->serialno));
+		if (DBGP(DBG_BASE)) {
+			connection_buf cb;
+			DBG_lease(false, pool, lease, "recovered by "PRI_CONNECTION" using '%s'; was in use by "PRI_CO,
+				  pri_connection(c, &cb), that_name, pri_co(lease->assigned_to));
+		}
+	}
+	return lease;
+}
+
 err_t lease_that_address(struct connection *c, const struct state *st)
 {
 	if (c->spd.that.has_lease &&
@@ -537,12 +708,12 @@ err_t lease_that_address(struct connection *c, const struct state *st)
 	bool reusable = client_can_reuse_lease(c);
 
 	id_buf that_idb;
-	char thatstr[sizeof(id_buf) + MAX_XAUTH_USERNAME_LEN];
+	char thatstr[LEASE_NAME_SIZE];
 	const char *that_name = str_id(that_id, &that_idb);
 
 	jam_str(thatstr, sizeof(thatstr), that_name);
 
-	if(st->st_xauth_username[0] != '\0')
+	if(st->st_xauth_username != NULL)
 		add_str(thatstr, sizeof(thatstr), thatstr, st->st_xauth_username);
 
 	if (DBGP(DBG_BASE)) {
@@ -577,45 +748,7 @@ err_t lease_that_address(struct connection *c, const struct state *st)
 				}
 				return "no free address in addresspool"; /* address pool exhausted */
 			}
-			unsigned old_nr_leases = pool->nr_leases;
-			if (pool->nr_leases == 0) {
-				pool->nr_leases = min(1U, pool->size);
-			} else {
-				pool->nr_leases = min(pool->nr_leases * 2, pool->size);
-			}
-			realloc_things(pool->leases, old_nr_leases, pool->nr_leases, "leases");
-			DBG_pool(false, pool, "growing address pool from %u to %u",
-				 old_nr_leases, pool->nr_leases);
-			/* initialize new leases (and add to free list) */
-			for (unsigned l = old_nr_leases; l < pool->nr_leases; l++) {
-				struct lease *lease = &pool->leases[l];
-				/*
-				 * Danger: must initialize entire
-				 * struct as resize_things(), which
-				 * may use realloc(), can leave the
-				 * data uninitialized.
-				 */
-				*lease = (struct lease) {
-					.free_entry = empty_entry,
-					.reusable_entry = empty_entry,
-					.reusable_bucket = empty_list,
-				};
-				PREPEND(pool, free_list, free_entry, lease);
-			}
-			/* destroy existing hash table */
-			for (unsigned l = 0; l < old_nr_leases; l++) {
-				struct lease *lease = &pool->leases[l];
-				lease->reusable_entry = empty_entry;
-				lease->reusable_bucket = empty_list;
-			}
-			/* build a new hash table containing old */
-			pool->nr_reusable = 0;
-			for (unsigned l = 0; l < old_nr_leases; l++) {
-				struct lease *lease = &pool->leases[l];
-				if (lease->reusable_name != NULL) {
-					hash_lease_id(pool, lease);
-				}
-			}
+			grow_addresspool(pool);
 		}
 		new_lease = HEAD(pool, free_list, free_entry);
 		passert(new_lease != NULL);
@@ -635,7 +768,7 @@ err_t lease_that_address(struct connection *c, const struct state *st)
 		free_lease_content(new_lease);
 		if (reusable) {
 			new_lease->reusable_name = clone_str(thatstr, "lease name");
-			hash_lease_id(pool, new_lease);
+			hash_lease_id(pool, new_lease, c->logger);
 		}
 	}
 
@@ -686,9 +819,20 @@ static void free_addresspool(void *p, where_t where UNUSED)
 		if (*pp == pool) {
 			*pp = pool->next;	/* unlink pool */
 			for (unsigned l = 0; l < pool->nr_leases; l++) {
-				free_lease_content(&pool->leases[l]);
+				struct lease *lease = POOL_LEASE(pool, l);
+				if (lease->reusable_name != NULL) {
+					keep_snapshot_lease(pool, lease);
+				}
+				free_lease_content(lease);
+			}
+			for (unsigned b = 0; b < pool->nr_blocks; b++) {
+				pfree(pool->blocks[b]);
+			}
+			pfreeany(pool->blocks);
+			for (unsigned b = 0; b < pool->nr_bucket_blocks; b++) {
+				pfree(pool->bucket_blocks[b]);
 			}
-			pfreeany(pool->leases);
+			pfreeany(pool->bucket_blocks);
 			pfree(pool);
 			return;
 		}
@@ -740,6 +884,620 @@ diag_t find_addresspool(const ip_range pool_range, struct addresspool **pool)
 	return NULL;
 }
 
+/*
+ * Lease snapshot.
+ *
+ * So that clients are not renumbered when pluto restarts, reusable
+ * leases (in use or lingering) are saved in a file and read back at
+ * startup.  When a pool with the same range is re-created its saved
+ * leases are restored as lingering leases that the same client will
+ * recover.
+ *
+ * While pluto runs the file is mapped and each reusable lease owns a
+ * record in it: the record is written when the lease is given its
+ * name and released when the name is dropped, so a change costs a
+ * copy into the mapping, never a re-write of the file.  Released
+ * records are kept, by size, on free lists for re-use.
+ * LEASE_SNAPSHOT_DELAY after a change the dirty part of the mapping is
+ * handed to the kernel using msync(MS_ASYNC); should pluto crash
+ * nothing is lost, should the host crash, whatever had yet to reach
+ * the disk.
+ *
+ * At shutdown the file is compacted: the records are written,
+ * back-to-back, to a temporary file that is synced and then renamed
+ * over the snapshot.
+ *
+ * The file is a sequence of LEASE_SNAPSHOT_UNIT byte units: a header
+ * unit followed by records, each a whole number of units, and then
+ * zeros.  It is only ever read by the pluto that wrote it so fields
+ * are in host byte order.
+ */
+
+#define LEASE_SNAPSHOT_MAGIC "LSWLEASE"
+#define LEASE_SNAPSHOT_VERSION 2
+#define LEASE_SNAPSHOT_UNIT 64
+#define LEASE_SNAPSHOT_MIN_SIZE (64 * 1024)
+
+struct lease_snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t unit;		/* LEASE_SNAPSHOT_UNIT */
+};
+
+struct lease_snapshot_record {
+	uint32_t size;		/* including name and padding */
+	uint32_t offset;	/* of address in range */
+	uint32_t next_free;	/* unit of next free record this size; 0 for none */
+	uint8_t ip_version;	/* 0 when free */
+	uint8_t pad[3];
+	uint8_t start[16];	/* of range */
+	uint8_t end[16];
+	/* followed by NUL terminated name */
+};
+
+#define LEASE_SNAPSHOT_UNITS(NAME_LEN)					\
+	((sizeof(struct lease_snapshot_record) + (NAME_LEN) + 1 +	\
+	  LEASE_SNAPSHOT_UNIT - 1) / LEASE_SNAPSHOT_UNIT)
+
+#define LEASE_SNAPSHOT_MAX_UNITS LEASE_SNAPSHOT_UNITS(LEASE_NAME_SIZE - 1)
+
+struct restored_lease {
+	struct lease_snapshot_record record;
+	char *name;
+	uint32_t unit;		/* of record in the mapping; 0 for none */
+	struct restored_lease *next;
+};
+
+static char *lease_snapshot_file = NULL;
+static struct restored_lease *restored_leases = NULL;
+
+/* the live file; BASE is NULL when there's none */
+static int lease_snapshot_fd = -1;
+static uint8_t *lease_snapshot_base = NULL;
+static size_t lease_snapshot_size;	/* of file and mapping */
+static uint32_t lease_snapshot_end;	/* first unit after the last record */
+static uint32_t lease_snapshot_free[LEASE_SNAPSHOT_MAX_UNITS + 1];	/* by units */
+static size_t lease_snapshot_dirty_start;
+static size_t lease_snapshot_dirty_end;	/* 0 when clean */
+static bool lease_snapshot_scheduled = false;
+
+static struct lease_snapshot_record *snapshot_record(uint32_t unit)
+{
+	return (void *)(lease_snapshot_base + (size_t)unit * LEASE_SNAPSHOT_UNIT);
+}
+
+static void dirty_snapshot_units(uint32_t unit, uint32_t units)
+{
+	size_t start = (size_t)unit * LEASE_SNAPSHOT_UNIT;
+	size_t end = start + (size_t)units * LEASE_SNAPSHOT_UNIT;
+	if (lease_snapshot_dirty_end == 0) {
+		lease_snapshot_dirty_start = start;
+		lease_snapshot_dirty_end = end;
+	} else {
+		lease_snapshot_dirty_start = min(lease_snapshot_dirty_start, start);
+		lease_snapshot_dirty_end = max(lease_snapshot_dirty_end, end);
+	}
+	if (!lease_snapshot_scheduled) {
+		schedule_oneshot_timer(EVENT_SAVE_LEASE_SNAPSHOT, LEASE_SNAPSHOT_DELAY);
+		lease_snapshot_scheduled = true;
+	}
+}
+
+static void lease_snapshot_timer(struct logger *logger)
+{
+	lease_snapshot_scheduled = false;
+	if (lease_snapshot_base == NULL || lease_snapshot_dirty_end == 0) {
+		return;
+	}
+	/* msync() wants a page aligned start */
+	size_t start = lease_snapshot_dirty_start & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+	if (msync(lease_snapshot_base + start, lease_snapshot_dirty_end - start, MS_ASYNC) < 0) {
+		llog_error(logger, errno, "lease snapshot %s: msync() failed", lease_snapshot_file);
+	}
+	lease_snapshot_dirty_end = 0;
+}
+
+/*
+ * Make room for UNITS more units after the last record; the file is
+ * doubled, and its blocks allocated, so that storing to the mapping
+ * can't fail.
+ */
+
+static bool grow_addresspool_snapshot(uint32_t units, struct logger *logger)
+{
+	size_t need = ((size_t)lease_snapshot_end + units) * LEASE_SNAPSHOT_UNIT;
+	if (need <= lease_snapshot_size) {
+		return true;
+	}
+	if ((uintmax_t)lease_snapshot_end + units > UINT32_MAX) {
+		llog(RC_LOG, logger, "lease snapshot %s: full", lease_snapshot_file);
+		return false;
+	}
+	size_t size = lease_snapshot_size * 2;
+	while (size < need) {
+		size *= 2;
+	}
+	int e = posix_fallocate(lease_snapshot_fd, lease_snapshot_size,
+				size - lease_snapshot_size);
+	if (e != 0) {
+		llog_error(logger, e, "lease snapshot %s: posix_fallocate() failed",
+			   lease_snapshot_file);
+		return false;
+	}
+	uint8_t *base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED,
+			     lease_snapshot_fd, 0);
+	if (base == MAP_FAILED) {
+		llog_error(logger, errno, "lease snapshot %s: mmap() failed",
+			   lease_snapshot_file);
+		return false;
+	}
+	munmap(lease_snapshot_base, lease_snapshot_size);
+	lease_snapshot_base = base;
+	lease_snapshot_size = size;
+	return true;
+}
+
+/*
+ * Copy RECORD, with its size filled in, and NAME to PTR; return the
+ * number of units used.
+ */
+
+static uint32_t jam_snapshot_record(uint8_t *ptr, size_t room,
+				    const struct lease_snapshot_record *record,
+				    const char *name)
+{
+	size_t name_len = strlen(name);
+	uint32_t units = LEASE_SNAPSHOT_UNITS(name_len);
+	passert(units <= LEASE_SNAPSHOT_MAX_UNITS);
+	struct lease_snapshot_record r = *record;
+	r.size = units * LEASE_SNAPSHOT_UNIT;
+	r.next_free = 0;
+	passert(r.size <= room);
+	memset(ptr, 0, r.size);
+	memcpy(ptr, &r, sizeof(r));
+	memcpy(ptr + sizeof(r), name, name_len + 1);
+	return units;
+}
+
+/* store RECORD and NAME in a free record, or after the last */
+
+static uint32_t write_snapshot_record(const struct lease_snapshot_record *record,
+				      const char *name, struct logger *logger)
+{
+	uint32_t units = LEASE_SNAPSHOT_UNITS(strlen(name));
+	passert(units <= LEASE_SNAPSHOT_MAX_UNITS);
+	uint32_t unit = lease_snapshot_free[units];
+	if (unit != 0) {
+		lease_snapshot_free[units] = snapshot_record(unit)->next_free;
+	} else {
+		if (!grow_addresspool_snapshot(units, logger)) {
+			return 0;
+		}
+		unit = lease_snapshot_end;
+		lease_snapshot_end += units;
+	}
+	jam_snapshot_record((uint8_t *)snapshot_record(unit),
+			    (size_t)units * LEASE_SNAPSHOT_UNIT, record, name);
+	dirty_snapshot_units(unit, units);
+	return unit;
+}
+
+/* wipe the record at UNIT and add it to its free list */
+
+static void release_snapshot_record(uint32_t unit)
+{
+	if (lease_snapshot_base == NULL || unit == 0) {
+		return;
+	}
+	struct lease_snapshot_record *record = snapshot_record(unit);
+	uint32_t units = record->size / LEASE_SNAPSHOT_UNIT;
+	passert(units > 0 && units <= LEASE_SNAPSHOT_MAX_UNITS);
+	memset(record, 0, record->size);
+	record->size = units * LEASE_SNAPSHOT_UNIT;
+	record->next_free = lease_snapshot_free[units];
+	lease_snapshot_free[units] = unit;
+	dirty_snapshot_units(unit, units);
+}
+
+static void range_to_snapshot_record(const ip_range range,
+				     struct lease_snapshot_record *record)
+{
+	ip_address start = range_start(range);
+	ip_address end = range_end(range);
+	shunk_t start_bytes = address_as_shunk(&start);
+	shunk_t end_bytes = address_as_shunk(&end);
+	passert(start_bytes.len <= sizeof(record->start));
+	passert(end_bytes.len == start_bytes.len);
+	record->ip_version = address_type(&start)->ip_version;
+	memcpy(record->start, start_bytes.ptr, start_bytes.len);
+	memcpy(record->end, end_bytes.ptr, end_bytes.len);
+}
+
+static void snapshot_lease(const struct addresspool *pool, struct lease *lease,
+			   struct logger *logger)
+{
+	if (lease_snapshot_base == NULL) {
+		return;
+	}
+	struct lease_snapshot_record record = {0};
+	range_to_snapshot_record(pool->r, &record);
+	record.offset = lease->index;
+	lease->snapshot_unit = write_snapshot_record(&record, lease->reusable_name, logger);
+}
+
+/*
+ * POOL is being deleted; hang on to LEASE, and its record, in case
+ * the pool is re-created (for instance, by a reload).
+ */
+
+static void keep_snapshot_lease(const struct addresspool *pool, struct lease *lease)
+{
+	if (lease_snapshot_base == NULL) {
+		return;
+	}
+	struct restored_lease *rl = alloc_thing(struct restored_lease, "restored lease");
+	range_to_snapshot_record(pool->r, &rl->record);
+	rl->record.offset = lease->index;
+	rl->name = lease->reusable_name;
+	lease->reusable_name = NULL;
+	rl->unit = lease->snapshot_unit;
+	lease->snapshot_unit = 0;
+	rl->next = restored_leases;
+	restored_leases = rl;
+}
+
+static void restore_snapshot_leases(struct addresspool *pool,
+				    struct logger *logger)
+{
+	if (restored_leases == NULL) {
+		return;
+	}
+
+	struct lease_snapshot_record range = {0};
+	range_to_snapshot_record(pool->r, &range);
+
+	/*
+	 * First grow the pool so that it covers every restored lease;
+	 * doing it lease by lease would put fresh leases on the free
+	 * list behind the lingering ones.
+	 */
+	unsigned nr_restored = 0;
+	for (struct restored_lease *rl = restored_leases; rl != NULL; rl = rl->next) {
+		if (rl->record.ip_version == range.ip_version &&
+		    memeq(rl->record.start, range.start, sizeof(range.start)) &&
+		    memeq(rl->record.end, range.end, sizeof(range.end)) &&
+		    rl->record.offset < pool->size) {
+			while (pool->nr_leases <= rl->record.offset) {
+				grow_addresspool(pool);
+			}
+			nr_restored++;
+		}
+	}
+	if (nr_restored == 0) {
+		return;
+	}
+
+	nr_restored = 0;
+	for (struct restored_lease **rlp = &restored_leases; *rlp != NULL; ) {
+		struct restored_lease *rl = *rlp;
+		if (rl->record.ip_version != range.ip_version ||
+		    !memeq(rl->record.start, range.start, sizeof(range.start)) ||
+		    !memeq(rl->record.end, range.end, sizeof(range.end)) ||
+		    rl->record.offset >= pool->size) {
+			rlp = &rl->next;
+			continue;
+		}
+		*rlp = rl->next;	/* unlink */
+		struct lease *lease = POOL_LEASE(pool, rl->record.offset);
+		if (lease->reusable_name == NULL &&
+		    find_reusable_lease(pool, rl->name) == NULL) {
+			/* now lingering; the free list's tail; keeps its record */
+			REMOVE(pool, free_list, free_entry, lease);
+			APPEND(pool, free_list, free_entry, lease);
+			lease->reusable_name = rl->name;
+			lease->snapshot_unit = rl->unit;
+			rl->name = NULL;
+			hash_lease_id(pool, lease, logger);
+			if (DBGP(DBG_BASE)) {
+				DBG_lease(false, pool, lease, "restored lingering reusable lease '%s'",
+					  lease->reusable_name);
+			}
+			nr_restored++;
+		} else {
+			release_snapshot_record(rl->unit);
+		}
+		pfreeany(rl->name);
+		pfree(rl);
+	}
+
+	range_buf rb;
+	llog(RC_LOG, logger, "address pool %s: restored %u reusable leases from %s",
+	     str_range(&pool->r, &rb), nr_restored, lease_snapshot_file);
+}
+
+/*
+ * Map the file; when SIZE is zero the file is (re)initialized.
+ */
+
+static bool map_addresspool_snapshot(int fd, size_t size, struct logger *logger)
+{
+	bool new = (size == 0);
+	if (new) {
+		if (ftruncate(fd, 0) < 0) {
+			llog_error(logger, errno, "lease snapshot %s: ftruncate() failed",
+				   lease_snapshot_file);
+			return false;
+		}
+		size = LEASE_SNAPSHOT_MIN_SIZE;
+		int e = posix_fallocate(fd, 0, size);
+		if (e != 0) {
+			llog_error(logger, e, "lease snapshot %s: posix_fallocate() failed",
+				   lease_snapshot_file);
+			return false;
+		}
+	}
+	uint8_t *base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		llog_error(logger, errno, "lease snapshot %s: mmap() failed",
+			   lease_snapshot_file);
+		return false;
+	}
+	lease_snapshot_fd = fd;
+	lease_snapshot_base = base;
+	lease_snapshot_size = size;
+	lease_snapshot_end = 1;	/* after the header */
+	if (new) {
+		struct lease_snapshot_header header = {
+			.version = LEASE_SNAPSHOT_VERSION,
+			.unit = LEASE_SNAPSHOT_UNIT,
+		};
+		memcpy(header.magic, LEASE_SNAPSHOT_MAGIC, sizeof(header.magic));
+		memcpy(base, &header, sizeof(header));
+		dirty_snapshot_units(0, 1);
+	}
+	return true;
+}
+
+static bool snapshot_header_ok(const uint8_t *base, size_t size)
+{
+	struct lease_snapshot_header header;
+	if (size < LEASE_SNAPSHOT_UNIT || size % LEASE_SNAPSHOT_UNIT != 0) {
+		return false;
+	}
+	memcpy(&header, base, sizeof(header));
+	return (memeq(header.magic, LEASE_SNAPSHOT_MAGIC, sizeof(header.magic)) &&
+		header.version == LEASE_SNAPSHOT_VERSION &&
+		header.unit == LEASE_SNAPSHOT_UNIT);
+}
+
+/*
+ * Load the records: in-use records become restored leases, free
+ * records go back on their free list.  A corrupt record, and
+ * everything after it, is wiped.
+ */
+
+static void load_addresspool_snapshot(struct logger *logger)
+{
+	uint32_t nr_units = lease_snapshot_size / LEASE_SNAPSHOT_UNIT;
+	uint32_t unit = 1;
+	unsigned nr = 0;
+	while (unit < nr_units) {
+		struct lease_snapshot_record *record = snapshot_record(unit);
+		if (record->size == 0) {
+			break;
+		}
+		uint32_t units = record->size / LEASE_SNAPSHOT_UNIT;
+		if (record->size % LEASE_SNAPSHOT_UNIT != 0 ||
+		    units > LEASE_SNAPSHOT_MAX_UNITS ||
+		    units > nr_units - unit) {
+			break;
+		}
+		if (record->ip_version == 0) {
+			record->next_free = lease_snapshot_free[units];
+			lease_snapshot_free[units] = unit;
+			dirty_snapshot_units(unit, 1);
+		} else {
+			const char *name = (const char *)(record + 1);
+			size_t room = record->size - sizeof(*record);
+			size_t name_len = strnlen(name, room);
+			if (name_len == 0 || name_len == room ||
+			    (record->ip_version != IPv4 && record->ip_version != IPv6)) {
+				break;
+			}
+			struct restored_lease *rl = alloc_thing(struct restored_lease, "restored lease");
+			rl->record = *record;
+			rl->name = clone_bytes(name, name_len + 1, "lease name");
+			rl->unit = unit;
+			rl->next = restored_leases;
+			restored_leases = rl;
+			nr++;
+		}
+		unit += units;
+	}
+	if (unit < nr_units && snapshot_record(unit)->size != 0) {
+		llog(RC_LOG, logger, "lease snapshot %s: record at unit %u is corrupt; ignoring the rest",
+		     lease_snapshot_file, unit);
+		memset(snapshot_record(unit), 0, (size_t)(nr_units - unit) * LEASE_SNAPSHOT_UNIT);
+		dirty_snapshot_units(unit, nr_units - unit);
+	}
+	lease_snapshot_end = unit;
+	dbg("lease snapshot %s: loaded %u leases", lease_snapshot_file, nr);
+}
+
+void init_addresspool_snapshot(const char *file, struct logger *logger)
+{
+	if (file == NULL) {
+		return;
+	}
+	lease_snapshot_file = clone_str(file, "lease snapshot file");
+	init_oneshot_timer(EVENT_SAVE_LEASE_SNAPSHOT, lease_snapshot_timer);
+
+	int fd = open(file, O_RDWR|O_CREAT|O_CLOEXEC, 0600);
+	if (fd < 0) {
+		llog_error(logger, errno, "lease snapshot %s: open() failed", file);
+		return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		llog_error(logger, errno, "lease snapshot %s: fstat() failed", file);
+		close(fd);
+		return;
+	}
+
+	size_t size = st.st_size;
+	if (size > 0) {
+		if (!map_addresspool_snapshot(fd, size, logger)) {
+			close(fd);
+			return;
+		}
+		if (snapshot_header_ok(lease_snapshot_base, size)) {
+			load_addresspool_snapshot(logger);
+			return;
+		}
+		llog(RC_LOG, logger, "lease snapshot %s: unrecognized format; starting afresh", file);
+		munmap(lease_snapshot_base, lease_snapshot_size);
+		lease_snapshot_base = NULL;
+	}
+
+	/* new, or starting afresh */
+	if (!map_addresspool_snapshot(fd, 0, logger)) {
+		close(fd);
+	}
+}
+
+static void close_addresspool_snapshot(void)
+{
+	if (lease_snapshot_base != NULL) {
+		munmap(lease_snapshot_base, lease_snapshot_size);
+		close(lease_snapshot_fd);
+		lease_snapshot_base = NULL;
+		lease_snapshot_fd = -1;
+		lease_snapshot_dirty_end = 0;
+		zero(&lease_snapshot_free);
+	}
+}
+
+static bool write_addresspool_snapshot(const char *tmp, size_t size, unsigned nr_records,
+				       struct logger *logger)
+{
+	int fd = open(tmp, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+	if (fd < 0) {
+		llog_error(logger, errno, "lease snapshot %s: open() failed", tmp);
+		return false;
+	}
+	if (ftruncate(fd, size) < 0) {
+		llog_error(logger, errno, "lease snapshot %s: ftruncate() failed", tmp);
+		close(fd);
+		return false;
+	}
+	uint8_t *base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		llog_error(logger, errno, "lease snapshot %s: mmap() failed", tmp);
+		return false;
+	}
+
+	struct lease_snapshot_header header = {
+		.version = LEASE_SNAPSHOT_VERSION,
+		.unit = LEASE_SNAPSHOT_UNIT,
+	};
+	memcpy(header.magic, LEASE_SNAPSHOT_MAGIC, sizeof(header.magic));
+	memcpy(base, &header, sizeof(header));
+
+	size_t pos = LEASE_SNAPSHOT_UNIT;
+	unsigned nr = 0;
+	for (struct addresspool *pool = pluto_pools; pool != NULL; pool = pool->next) {
+		struct lease_snapshot_record range = {0};
+		range_to_snapshot_record(pool->r, &range);
+		for (unsigned l = 0; l < pool->nr_leases; l++) {
+			const struct lease *lease = POOL_LEASE(pool, l);
+			if (lease->reusable_name != NULL) {
+				struct lease_snapshot_record record = range;
+				record.offset = lease->index;
+				pos += jam_snapshot_record(base + pos, size - pos, &record,
+							   lease->reusable_name) * LEASE_SNAPSHOT_UNIT;
+				nr++;
+			}
+		}
+	}
+	for (const struct restored_lease *rl = restored_leases; rl != NULL; rl = rl->next) {
+		pos += jam_snapshot_record(base + pos, size - pos, &rl->record,
+					   rl->name) * LEASE_SNAPSHOT_UNIT;
+		nr++;
+	}
+	passert(pos == size);
+	passert(nr == nr_records);
+
+	bool ok = true;
+	if (msync(base, size, MS_SYNC) < 0) {
+		llog_error(logger, errno, "lease snapshot %s: msync() failed", tmp);
+		ok = false;
+	}
+	munmap(base, size);
+	return ok;
+}
+
+/*
+ * At shutdown, replace the live file with a compact copy.  Should
+ * that fail, the live file is synced instead.
+ */
+
+void save_addresspool_snapshot(struct logger *logger)
+{
+	if (lease_snapshot_file == NULL) {
+		return;
+	}
+
+	unsigned nr_records = 0;
+	size_t size = LEASE_SNAPSHOT_UNIT;	/* header */
+	for (struct addresspool *pool = pluto_pools; pool != NULL; pool = pool->next) {
+		for (unsigned l = 0; l < pool->nr_leases; l++) {
+			const struct lease *lease = POOL_LEASE(pool, l);
+			if (lease->reusable_name != NULL) {
+				size += LEASE_SNAPSHOT_UNITS(strlen(lease->reusable_name)) * LEASE_SNAPSHOT_UNIT;
+				nr_records++;
+			}
+		}
+	}
+	for (const struct restored_lease *rl = restored_leases; rl != NULL; rl = rl->next) {
+		size += LEASE_SNAPSHOT_UNITS(strlen(rl->name)) * LEASE_SNAPSHOT_UNIT;
+		nr_records++;
+	}
+
+	/* write then rename so that a crash leaves the old snapshot */
+	char tmp[PATH_MAX];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", lease_snapshot_file);
+	if (!write_addresspool_snapshot(tmp, size, nr_records, logger)) {
+		unlink(tmp);
+	} else if (rename(tmp, lease_snapshot_file) < 0) {
+		llog_error(logger, errno, "lease snapshot %s: rename() failed", lease_snapshot_file);
+		unlink(tmp);
+	} else {
+		dbg("saved %u reusable leases to %s", nr_records, lease_snapshot_file);
+		close_addresspool_snapshot();
+		return;
+	}
+
+	if (lease_snapshot_base != NULL &&
+	    msync(lease_snapshot_base, lease_snapshot_size, MS_SYNC) < 0) {
+		llog_error(logger, errno, "lease snapshot %s: msync() failed", lease_snapshot_file);
+	}
+	close_addresspool_snapshot();
+}
+
+void free_addresspool_snapshot(void)
+{
+	close_addresspool_snapshot();
+	while (restored_leases != NULL) {
+		struct restored_lease *rl = restored_leases;
+		restored_leases = rl->next;
+		pfreeany(rl->name);
+		pfree(rl);
+	}
+	pfreeany(lease_snapshot_file);
+}
+
 /*
  * Create an address pool for POOL_RANGE.  Reject invalid ranges.
  */
@@ -796,7 +1554,10 @@ diag_t install_addresspool(const ip_range pool_range, struct connection *c)
 	new_pool->nr_in_use = 0;
 	new_pool->nr_leases = 0;
 	new_pool->free_list = empty_list;
-	new_pool->leases = NULL;
+	new_pool->blocks = NULL;
+	new_pool->nr_blocks = 0;
+	new_pool->max_blocks = 0;
+	init_lease_buckets(new_pool);
 
 	/* insert at front */
 	new_pool->next = pluto_pools;
@@ -805,6 +1566,7 @@ diag_t install_addresspool(const ip_range pool_range, struct connection *c)
 	if (DBGP(DBG_BASE)) {
 		DBG_pool(false, new_pool, "creating new address pool@%p", new_pool);
 	}
+	restore_snapshot_leases(new_pool, c->logger);
 	c->pool = new_pool;
 	return NULL;
 }
@@ -830,7 +1592,7 @@ void show_addresspool_status(struct show *s)
 		unsigned nr_reusable_entries = 0;
 		unsigned nr_reusable_names = 0;
 		for (unsigned l = 0; l < pool->nr_leases; l++) {
-			struct lease *lease = &pool->leases[l];
+			struct lease *lease = POOL_LEASE(pool, l);
 			ip_address lease_ip;
 			err_t err = pool_lease_to_address(pool, lease, &lease_ip);
 			if (err != NULL) {
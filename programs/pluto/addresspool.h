@@ -34,4 +34,8 @@ extern void free_that_address_lease(struct connection *c);
 
 extern void show_addresspool_status(struct show *s);
 
+void init_addresspool_snapshot(const char *file, struct logger *logger);
+void save_addresspool_snapshot(struct logger *logger);
+void free_addresspool_snapshot(void);
+
 #endif /* _ADDRESSPOOL_H */
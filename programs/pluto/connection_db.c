@@ -13,11 +13,15 @@
  * for more details.
  */
 
+#include <stdlib.h>
+
 #include "connection_db.h"
 #include "connections.h"
 #include "log.h"
 #include "hash_table.h"
 #include "refcnt.h"
+#include "host_pair.h"
+#include "ip_info.h"
 
 /*
  * A table hashed by serialno.
@@ -84,6 +88,7 @@ void rehash_db_connection_that_id(struct connection *c)
 	dbg("%s() rehashing "PRI_CO" that_id=%s",
 	    __func__, pri_co(c->serialno), str_id(&c->remote->host.id, &idb));
 	rehash_table_entry(&connection_that_id_hash_table, c);
+	rehash_host_pair_remote_id(c);
 }
 
 void replace_connection_that_id(struct connection *c, const struct id *src)
@@ -118,12 +123,117 @@ static hash_t hash_spd_route_remote_client(const ip_selector *sr)
 
 HASH_TABLE(spd_route, remote_client, .that.client, STATE_TABLE_SIZE);
 
+/*
+ * The remote client's routing prefix; ignores protocol and port.
+ *
+ * Two subnets overlap when the shorter prefix contains the longer
+ * so, given a subnet, all the (shorter or equal) subnets overlapping
+ * it can be found by probing with each prefix length.
+ */
+
+static void jam_spd_route_remote_prefix(struct jambuf *buf, const struct spd_route *sr)
+{
+	jam_spd_route(buf, sr);
+}
+
+static hash_t hash_spd_route_remote_prefix(const ip_selector *client)
+{
+	const struct ip_info *afi = selector_type(client);
+	if (afi == NULL) {
+		return zero_hash;
+	}
+	struct ip_bytes prefix = ip_bytes_from_blit(afi, client->bytes,
+						    /*routing-prefix*/&keep_bits,
+						    /*host-identifier*/&clear_bits,
+						    client->maskbits);
+	hash_t hash = hash_thing(client->version, zero_hash);
+	hash = hash_thing(client->maskbits, hash);
+	return hash_bytes(prefix.byte, afi->ip_size, hash);
+}
+
+HASH_TABLE(spd_route, remote_prefix, .that.client, STATE_TABLE_SIZE);
+
 HASH_DB(spd_route,
-	&spd_route_remote_client_hash_table);
+	&spd_route_remote_client_hash_table,
+	&spd_route_remote_prefix_hash_table);
 
 void rehash_db_spd_route_remote_client(struct spd_route *sr)
 {
 	rehash_table_entry(&spd_route_remote_client_hash_table, sr);
+	rehash_table_entry(&spd_route_remote_prefix_hash_table, sr);
+}
+
+static int connection_serialno_new2old(const void *lhs, const void *rhs)
+{
+	const struct connection *l = *(const struct connection *const *)lhs;
+	const struct connection *r = *(const struct connection *const *)rhs;
+	return (l->serialno < r->serialno ? 1 :
+		l->serialno > r->serialno ? -1 : 0);
+}
+
+bool remote_client_overlap_candidates(const ip_selector *net,
+				      struct connection ***candidates,
+				      unsigned *nr_candidates)
+{
+	*candidates = NULL;
+	*nr_candidates = 0;
+
+	const struct ip_info *afi = selector_type(net);
+	if (afi == NULL) {
+		return false;
+	}
+
+	/*
+	 * A subnet inside NET (a longer prefix) can't be found by
+	 * probing; give up unless NET is a single address (the
+	 * usual virtual IP).
+	 */
+	if (net->maskbits != afi->mask_cnt) {
+		return false;
+	}
+
+	unsigned size = 0;
+	for (unsigned bits = 0; bits <= net->maskbits; bits++) {
+		ip_selector key = *net;
+		key.maskbits = bits;
+		hash_t hash = hash_spd_route_remote_prefix(&key);
+		struct list_head *bucket = hash_table_bucket(&spd_route_remote_prefix_hash_table, hash);
+		struct ip_bytes prefix = ip_bytes_from_blit(afi, net->bytes,
+							    /*routing-prefix*/&keep_bits,
+							    /*host-identifier*/&clear_bits,
+							    bits);
+		struct spd_route *sr;
+		FOR_EACH_LIST_ENTRY_NEW2OLD(bucket, sr) {
+			const ip_selector *client = &sr->that.client;
+			/* only the first SPD; and exactly this prefix */
+			if (sr != &sr->connection->spd ||
+			    selector_type(client) != afi ||
+			    client->maskbits != bits) {
+				continue;
+			}
+			struct ip_bytes client_prefix =
+				ip_bytes_from_blit(afi, client->bytes,
+						   /*routing-prefix*/&keep_bits,
+						   /*host-identifier*/&clear_bits,
+						   bits);
+			if (!thingeq(client_prefix, prefix)) {
+				continue;
+			}
+			if (*nr_candidates >= size) {
+				size = (size == 0 ? 16 : size * 2);
+				realloc_things(*candidates, *nr_candidates, size,
+					       "overlap candidates");
+			}
+			(*candidates)[(*nr_candidates)++] = sr->connection;
+		}
+	}
+
+	/* same order as next_connection_new2old() */
+	if (*nr_candidates > 1) {
+		qsort(*candidates, *nr_candidates, sizeof((*candidates)[0]),
+		      connection_serialno_new2old);
+	}
+	return true;
 }
 
 static struct list_head *spd_route_filter_head(struct spd_route_filter *filter)
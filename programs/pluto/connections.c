@@ -79,6 +79,7 @@
 #include "pluto_x509.h"
 #include "nss_cert_verify.h" /* for cert_VerifySubjectAltName() */
 #include "nss_cert_load.h"
+#include "ikev2_cert.h"		/* for forget_v2_cert_payloads() */
 #include "ikev2.h"
 #include "virtual_ip.h"	/* needs connections.h */
 #include "host_pair.h"
@@ -97,6 +98,8 @@
 #include "ikev2_proposals.h"
 #include "lswnss.h"
 #include "show.h"
+#include "pluto_shutdown.h"		/* for exiting_pluto */
+#include "ikev2_ticket.h"		/* for bump_v2_ticket_generation() */
 
 #define MINIMUM_IPSEC_SA_RANDOM_MARK 65536
 static uint32_t global_marks = MINIMUM_IPSEC_SA_RANDOM_MARK;
@@ -190,6 +193,10 @@ void delete_connection(struct connection **cp)
 			free_that_address_lease(c);
 		}
 	}
+	if (c->root_config != NULL && !exiting_pluto) {
+		/* invalidate session resumption tickets issued for C */
+		bump_v2_ticket_generation(c->name, c->logger);
+	}
 	release_connection(c);
 	discard_connection(&c, true/*connection_valid*/);
 }
@@ -255,6 +262,7 @@ static void discard_connection(struct connection **cp, bool connection_valid)
 		FOR_EACH_ELEMENT(end, config->end) {
 			pfreeany(end->client.updown);
 			if (end->host.cert.nss_cert != NULL) {
+				forget_v2_cert_payloads(end->host.cert.nss_cert);
 				CERT_DestroyCertificate(end->host.cert.nss_cert);
 			}
 			free_chunk_content(&end->host.ca);
@@ -1430,11 +1438,14 @@ diag_t add_end_cert_and_preload_private_key(CERTCertificate *cert,
 	}
 
 	dbg("loading %s certificate \'%s\' pubkey", leftright, nickname);
-	if (!add_pubkey_from_nss_cert(&pluto_pubkeys, &end->host->id, cert, logger)) {
+	struct pubkey_list *cert_pubkeys = NULL;
+	if (!add_pubkey_from_nss_cert(&cert_pubkeys, &end->host->id, cert, logger)) {
 		/* XXX: push diag_t into add_pubkey_from_nss_cert()? */
+		free_public_keys(&cert_pubkeys);
 		return diag("%s certificate \'%s\' pubkey could not be loaded",
 			    leftright, nickname);
 	}
+	replace_preloaded_pubkeys(&cert_pubkeys);
 
 	config_end->host.cert.nss_cert = cert;
 
@@ -2462,8 +2473,17 @@ static bool extract_connection(const struct whack_message *wm,
 			wild_side->has_client = true;
 	}
 
-	/* non configurable */
-	c->ike_window = IKE_V2_OVERLAPPING_WINDOW_SIZE;
+	/* advertised using SET_WINDOW_SIZE; see ikev2_msgid.c */
+	if (wm->ike_window == 0) {
+		c->ike_window = IKE_V2_OVERLAPPING_WINDOW_SIZE;
+	} else if (wm->ike_window > IKE_V2_MAX_WINDOW_SIZE) {
+		llog(RC_LOG, c->logger,
+		     "ikewindow=%u is too large, using %u",
+		     wm->ike_window, IKE_V2_MAX_WINDOW_SIZE);
+		c->ike_window = IKE_V2_MAX_WINDOW_SIZE;
+	} else {
+		c->ike_window = wm->ike_window;
+	}
 
 	/*
 	 * All done, enter it into the databases.  Since orient() may
@@ -2613,8 +2633,7 @@ struct connection *add_group_instance(struct connection *group,
 	    t->name, t->spd.reqid, group->sa_reqid);
 
 	/* same host_pair as parent: stick after parent on list */
-	/* t->hp_next = group->hp_next; */	/* done by clone_thing */
-	group->hp_next = t;
+	connect_group_instance_to_host_pair(group, t);
 
 	/* all done */
 	hash_connection(t);
@@ -420,6 +420,7 @@ struct spd_route {
 	struct {
 		struct list_entry list;
 		struct list_entry remote_client;
+		struct list_entry remote_prefix;
 	} hash_table_entries;
 };
 
@@ -512,6 +513,8 @@ struct connection {
 	/* host_pair linkage */
 	struct host_pair *host_pair;
 	struct connection *hp_next;
+	uint64_t hp_order;		/* larger is nearer the front */
+	hash_t hp_remote_id;		/* host_pair+remote ID; see host_pair.c */
 
 	enum send_ca_policy send_ca;
 
@@ -526,6 +529,11 @@ struct connection {
 		struct list_entry list;
 		struct list_entry serialno;
 		struct list_entry that_id;
+		/* unoriented; see host_pair.c */
+		struct list_entry unoriented_local;
+		struct list_entry unoriented_remote;
+		/* oriented; see host_pair.c */
+		struct list_entry host_pair_remote_id;
 	} hash_table_entries;
 
 	/*
@@ -762,6 +770,16 @@ void rehash_db_connection_that_id(struct connection *c);
 
 void rehash_db_spd_route_remote_client(struct spd_route *sr);
 
+/*
+ * The connections whose remote client (first SPD) could overlap NET,
+ * in next_connection_new2old() order; false when NET can't be looked
+ * up and all connections need to be checked.  The caller must
+ * pfree() *CANDIDATES.
+ */
+bool remote_client_overlap_candidates(const ip_selector *net,
+				      struct connection ***candidates,
+				      unsigned *nr_candidates);
+
 bool dpd_active_locally(const struct connection *c);
 
 #endif
@@ -39,6 +39,10 @@
  * This means that, while the fetch thread is processing a node
  * (distribution point), the lists can be growing.  Hence the
  * volatile's sprinkled across this code.
+ *
+ * The fetch thread works through the queue in rounds: each round
+ * hands the next untried distribution point of every unsatisfied
+ * request to the fetcher, which is free to fetch them in parallel.
  */
 
 struct crl_distribution_point {
@@ -51,6 +55,9 @@ struct crl_fetch_queue {
 	chunk_t issuer_dn;
 	struct crl_distribution_point *volatile distribution_points;
 	int trials;
+	/* fetch thread only; next distribution point to try */
+	struct crl_distribution_point *dp;
+	bool fetched;
 	struct logger *logger;
 	struct crl_fetch_queue *volatile next;
 };
@@ -85,6 +92,8 @@ static void free_crl_fetch_request(struct crl_fetch_queue **request)
 static pthread_mutex_t crl_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t crl_queue_cond = PTHREAD_COND_INITIALIZER;
 static struct crl_fetch_queue *volatile crl_fetch_queue = NULL;
+/* bumped on each submit; tells the fetch thread to go around again */
+static volatile unsigned crl_fetch_queue_generation;
 
 /*
  * *ALWAYS* Append additional distribution points.
@@ -180,9 +189,11 @@ void submit_crl_fetch_requests(struct crl_fetch_request **requests, struct logge
 			/* copy distribution points */
 			unlocked_append_distribution_points(&new_entry.distribution_points,
 							    request->url, request->dps);
+			new_entry.dp = new_entry.distribution_points;
 			*entry = clone_thing(new_entry, "crl entry");
 		}
 	}
+	crl_fetch_queue_generation++;
 	dbg("CRL: poke the sleeping dragon (fetch thread)");
 	pthread_cond_signal(&crl_queue_cond);
 	pthread_mutex_unlock(&crl_queue_mutex);
@@ -263,41 +274,87 @@ void submit_crl_fetch_request(asn1_t issuer_dn, struct logger *logger)
 	submit_crl_fetch_requests(&requests, logger);
 }
 
-void process_crl_fetch_requests(fetch_crl_fn *fetch_crl, struct logger *unused_logger UNUSED)
+/*
+ * Gather the next untried distribution point of each unsatisfied
+ * request.  Returns the number of jobs.
+ */
+
+static unsigned unlocked_next_crl_fetch_jobs(struct crl_fetch_job **jobs)
+{
+	unsigned nr_jobs = 0;
+	for (struct crl_fetch_queue *req = crl_fetch_queue; req != NULL; req = req->next) {
+		if (!req->fetched && req->dp != NULL) {
+			nr_jobs++;
+		}
+	}
+	if (nr_jobs == 0) {
+		*jobs = NULL;
+		return 0;
+	}
+	*jobs = alloc_things(struct crl_fetch_job, nr_jobs, "crl fetch jobs");
+	unsigned j = 0;
+	for (struct crl_fetch_queue *req = crl_fetch_queue; req != NULL; req = req->next) {
+		if (!req->fetched && req->dp != NULL) {
+			(*jobs)[j++] = (struct crl_fetch_job) {
+				.issuer_dn = req->issuer_dn,
+				.url = req->dp->url,
+				.logger = req->logger,
+				.request = req,
+			};
+		}
+	}
+	passert(j == nr_jobs);
+	return nr_jobs;
+}
+
+void process_crl_fetch_requests(fetch_crls_fn *fetch_crls, struct logger *unused_logger UNUSED)
 {
 	pthread_mutex_lock(&crl_queue_mutex);
 	while (!exiting_pluto) {
 		/* if there's something process it */
 		dbg("CRL: the sleeping dragon awakes");
-		unsigned requests_processed = 0;
-		for (struct crl_fetch_queue *volatile *volatile reqp = &crl_fetch_queue;
-		     *reqp != NULL && !exiting_pluto; ) {
-			requests_processed++;
-			struct crl_fetch_queue *req = *reqp;
+		unsigned generation = crl_fetch_queue_generation;
+		for (struct crl_fetch_queue *req = crl_fetch_queue; req != NULL; req = req->next) {
 			pexpect(req->distribution_points != NULL);
-			bool fetched = false;
-			for (struct crl_distribution_point *volatile dp = req->distribution_points;
-			     dp != NULL && !fetched && !exiting_pluto; dp = dp->next) {
-				/*
-				 * While fetching unlock the QUEUE.
-				 *
-				 * While the table is unlocked, the
-				 * main thread can append to either
-				 * crl_fetch_request list, or its
-				 * crl_distribution_point list.
-				 */
-				dbg("CRL:   unlocking crl queue");
-				pthread_mutex_unlock(&crl_queue_mutex);
-				dn_buf dnb;
-				dbg("CRL:     fetching: %s",
-				    str_dn(ASN1(req->issuer_dn), &dnb));
-				if (fetch_crl(req->issuer_dn, dp->url, req->logger)) {
-					fetched = true;
+			req->dp = req->distribution_points;
+			req->fetched = false;
+		}
+		unsigned rounds = 0;
+		while (!exiting_pluto) {
+			struct crl_fetch_job *jobs;
+			unsigned nr_jobs = unlocked_next_crl_fetch_jobs(&jobs);
+			if (nr_jobs == 0) {
+				break;
+			}
+			rounds++;
+			/*
+			 * While fetching unlock the QUEUE.
+			 *
+			 * While the table is unlocked, the main thread
+			 * can append to either crl_fetch_request list,
+			 * or its crl_distribution_point list.
+			 */
+			dbg("CRL:   unlocking crl queue; fetching %u distribution points (round %u)",
+			    nr_jobs, rounds);
+			pthread_mutex_unlock(&crl_queue_mutex);
+			fetch_crls(jobs, nr_jobs);
+			dbg("CRL:   locked crl queue");
+			pthread_mutex_lock(&crl_queue_mutex);
+			for (unsigned j = 0; j < nr_jobs; j++) {
+				struct crl_fetch_queue *req = jobs[j].request;
+				if (jobs[j].fetched) {
+					req->fetched = true;
+				} else {
+					req->dp = req->dp->next;
 				}
-				dbg("CRL:   locked crl queue");
-				pthread_mutex_lock(&crl_queue_mutex);
 			}
-			if (fetched) {
+			pfree(jobs);
+		}
+		unsigned requests_processed = 0;
+		for (struct crl_fetch_queue *volatile *reqp = &crl_fetch_queue; *reqp != NULL; ) {
+			struct crl_fetch_queue *req = *reqp;
+			requests_processed++;
+			if (req->fetched) {
 				*reqp = req->next;
 				free_crl_fetch_request(&req);
 			} else {
@@ -308,8 +365,13 @@ void process_crl_fetch_requests(fetch_crl_fn *fetch_crl, struct logger *unused_l
 		if (exiting_pluto) {
 			break;
 		}
-		dbg("CRL: %u requests processed, the dragon sleeps",
-		    requests_processed);
+		if (generation != crl_fetch_queue_generation) {
+			dbg("CRL: %u requests processed in %u rounds, more were submitted",
+			    requests_processed, rounds);
+			continue;
+		}
+		dbg("CRL: %u requests processed in %u rounds, the dragon sleeps",
+		    requests_processed, rounds);
 		int status = pthread_cond_wait(&crl_queue_cond, &crl_queue_mutex);
 		passert(status == 0);
 	}
@@ -34,8 +34,25 @@ void add_crl_fetch_request(asn1_t issuer_dn, shunk_t url/*could be empty*/,
 			   struct crl_fetch_request **requests,
 			   struct logger *logger);
 
-typedef bool (fetch_crl_fn)(chunk_t issuer, const char *url, struct logger *logger);
-void process_crl_fetch_requests(fetch_crl_fn *fetch_crl, struct logger *logger);
+/*
+ * One distribution point of a queued request, handed to the fetcher.
+ *
+ * Shallow: ISSUER_DN, URL and LOGGER point into the queue which,
+ * while the fetcher is running, is only ever appended to.  The
+ * fetcher sets FETCHED when the distribution point yielded a current
+ * CRL.
+ */
+
+struct crl_fetch_job {
+	chunk_t issuer_dn;
+	const char *url;
+	struct logger *logger;
+	struct crl_fetch_queue *request;
+	bool fetched;
+};
+
+typedef void (fetch_crls_fn)(struct crl_fetch_job *jobs, unsigned nr_jobs);
+void process_crl_fetch_requests(fetch_crls_fn *fetch_crls, struct logger *logger);
 
 void free_crl_queue(void);
 void list_crl_fetch_requests(struct show *s, bool utc);
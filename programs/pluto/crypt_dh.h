@@ -66,8 +66,8 @@ extern void submit_dh_shared_secret(struct state *task_st,
 /* internal */
 void calc_v1_skeyid_and_iv(struct state *st);
 void calc_v2_keymat(struct state *st,
-		    PK11SymKey *old_skey_d, /* SKEYSEED IKE Rekey */
-		    const struct prf_desc *old_prf, /* IKE Rekey */
+		    PK11SymKey *old_skey_d, /* SKEYSEED IKE Rekey/Resume */
+		    const struct prf_desc *old_prf, /* IKE Rekey/Resume */
 		    const ike_spis_t *new_ike_spis);
 
 #endif
@@ -81,7 +81,13 @@ static void calc_skeyseed_v2(PK11SymKey *shared,
 		/* generate SKEYSEED from key=(Ni|Nr), hash of shared */
 		skeyseed = ikev2_ike_sa_skeyseed(prf, ni, nr, shared,
 						 logger);
-	}  else {
+	} else if (shared == NULL) {
+		/* RFC 5723 resumption; no DH, just the old SK_d */
+		skeyseed = ikev2_ike_sa_resume_skeyseed(old_prf,
+							old_skey_d,
+							ni, nr,
+							logger);
+	} else {
 		skeyseed = ikev2_ike_sa_rekey_skeyseed(old_prf,
 						       old_skey_d,
 						       shared, ni, nr,
@@ -186,8 +192,8 @@ static void calc_skeyseed_v2(PK11SymKey *shared,
 }
 
 void calc_v2_keymat(struct state *st,
-		    PK11SymKey *old_skey_d, /* SKEYSEED IKE Rekey */
-		    const struct prf_desc *old_prf, /* IKE Rekey */
+		    PK11SymKey *old_skey_d, /* SKEYSEED IKE Rekey/Resume */
+		    const struct prf_desc *old_prf, /* IKE Rekey/Resume */
 		    const ike_spis_t *new_ike_spis)
 {
 	calc_skeyseed_v2(st->st_dh_shared_secret,
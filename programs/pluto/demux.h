@@ -33,6 +33,7 @@
 
 struct state;   /* forward declaration of tag */
 struct iface_endpoint;
+struct arena;
 struct logger;
 
 /*
@@ -116,8 +117,14 @@ enum v2_pd {
 	PD_v2N_REDIRECTED_FROM,
 	PD_v2N_REDIRECT_SUPPORTED,
 	PD_v2N_REKEY_SA,
+	PD_v2N_SET_WINDOW_SIZE,
 	PD_v2N_SIGNATURE_HASH_ALGORITHMS,
 	PD_v2N_SINGLE_PAIR_REQUIRED,
+	PD_v2N_TICKET_ACK,
+	PD_v2N_TICKET_LT_OPAQUE,
+	PD_v2N_TICKET_NACK,
+	PD_v2N_TICKET_OPAQUE,
+	PD_v2N_TICKET_REQUEST,
 	PD_v2N_TS_UNACCEPTABLE,
 	PD_v2N_UNSUPPORTED_CRITICAL_PAYLOAD,
 	PD_v2N_UPDATE_SA_ADDRESSES,
@@ -135,11 +142,17 @@ enum v1_pb {
 #endif
 
 /* message digest
- * Note: raw_packet and packet_pbs are "owners" of space on heap.
+ * Note: raw_packet is an "owner" of space on heap.
+ *
+ * The digest itself, the packet that packet_pbs points into, and
+ * anything else that lives exactly as long as the message, are
+ * allocated from .arena and released in one go when the last
+ * reference goes.
  */
 
 struct msg_digest {
 	refcnt_t refcnt;
+	struct arena *arena;			/* contains this digest */
 	chunk_t raw_packet;			/* (v1) if encrypted, received packet before decryption */
 	struct iface_endpoint *iface;		/* interface on which message arrived */
 	ip_endpoint sender;			/* address:port where message came from */
@@ -158,6 +171,7 @@ struct msg_digest {
 	bool fragvid;				/* (v1) Peer supports FRAGMENTATION */
 	bool fake_clone;			/* is this a fake (clone) message */
 	unsigned v2_frags_total;		/* total fragments */
+	bool v2_decrypted;			/* (v2) SK payload passed integrity check */
 
 	/*
 	 * Note that .pd[] is indexed using either enum v1_pd or enum
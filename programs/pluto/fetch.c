@@ -46,11 +46,170 @@
 #include "server.h"
 #include "lswnss.h"			/* for llog_nss_error() */
 #include "pluto_shutdown.h"		/* for exiting_pluto */
+#include "show.h"
 
 #define FETCH_CMD_TIMEOUT       5       /* seconds */
+#define FETCH_MAX_TRANSFERS	8	/* concurrent curl transfers */
 
 static pthread_t fetch_thread_id;
 
+/*
+ * Per-URL fetch history.
+ *
+ * Updated by the fetch thread and listed by whack --listcrls, hence
+ * the lock.  The ETag / Last-Modified validators are only saved once
+ * the CRL they describe is known to be in NSS; they are then used to
+ * make the next fetch conditional.
+ */
+
+enum crl_fetch_result {
+	CRL_FETCH_FAILED,
+	CRL_FETCH_NOT_MODIFIED,	/* 304, or file older than validator */
+	CRL_FETCH_UNCHANGED,	/* NSS already has this CRL number */
+	CRL_FETCH_IMPORTED,
+};
+
+static const char *const crl_fetch_result_name[] = {
+	[CRL_FETCH_FAILED] = "failed",
+	[CRL_FETCH_NOT_MODIFIED] = "not modified",
+	[CRL_FETCH_UNCHANGED] = "unchanged",
+	[CRL_FETCH_IMPORTED] = "imported",
+};
+
+struct crl_fetch_stats {
+	char *url;
+	char *etag;
+	long last_modified;	/* -1 when unknown */
+	realtime_t last_time;
+	deltatime_t last_latency;
+	size_t last_size;
+	enum crl_fetch_result last_result;
+	unsigned count[elemsof(crl_fetch_result_name)];
+	uintmax_t bytes;
+	struct crl_fetch_stats *next;
+};
+
+static pthread_mutex_t crl_fetch_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct crl_fetch_stats *crl_fetch_stats;
+
+static struct crl_fetch_stats *locked_crl_fetch_stats(const char *url)
+{
+	struct crl_fetch_stats **sp;
+	for (sp = &crl_fetch_stats; *sp != NULL; sp = &(*sp)->next) {
+		if (streq((*sp)->url, url)) {
+			return *sp;
+		}
+	}
+	struct crl_fetch_stats new_stats = {
+		.url = clone_str(url, "crl fetch url"),
+		.last_modified = -1,
+	};
+	*sp = clone_thing(new_stats, "crl fetch stats");
+	return *sp;
+}
+
+/*
+ * Return the validators saved by the last successful fetch of URL;
+ * *ETAG must be freed.
+ */
+
+static void get_crl_fetch_validators(const char *url, char **etag, long *last_modified)
+{
+	pthread_mutex_lock(&crl_fetch_stats_mutex);
+	{
+		struct crl_fetch_stats *stats = locked_crl_fetch_stats(url);
+		*etag = clone_str(stats->etag, "crl etag");
+		*last_modified = stats->last_modified;
+	}
+	pthread_mutex_unlock(&crl_fetch_stats_mutex);
+}
+
+/*
+ * Record the outcome of fetching URL.  When the fetch left NSS with
+ * a current CRL, the validators (*ETAG is stolen) are saved.
+ */
+
+static void record_crl_fetch(const char *url, enum crl_fetch_result result,
+			     size_t size, deltatime_t latency,
+			     char **etag, long last_modified)
+{
+	pthread_mutex_lock(&crl_fetch_stats_mutex);
+	{
+		struct crl_fetch_stats *stats = locked_crl_fetch_stats(url);
+		stats->last_time = realnow();
+		stats->last_latency = latency;
+		stats->last_size = size;
+		stats->last_result = result;
+		stats->count[result]++;
+		stats->bytes += size;
+		if (result == CRL_FETCH_IMPORTED || result == CRL_FETCH_UNCHANGED) {
+			pfreeany(stats->etag);
+			stats->etag = *etag;
+			*etag = NULL;
+			stats->last_modified = last_modified;
+		} else if (result == CRL_FETCH_FAILED) {
+			/* start over */
+			pfreeany(stats->etag);
+			stats->last_modified = -1;
+		}
+	}
+	pthread_mutex_unlock(&crl_fetch_stats_mutex);
+	pfreeany(*etag);
+}
+
+static void free_crl_fetch_stats(void)
+{
+	pthread_mutex_lock(&crl_fetch_stats_mutex);
+	{
+		while (crl_fetch_stats != NULL) {
+			struct crl_fetch_stats *tbd = crl_fetch_stats;
+			crl_fetch_stats = tbd->next;
+			pfree(tbd->url);
+			pfreeany(tbd->etag);
+			pfree(tbd);
+		}
+	}
+	pthread_mutex_unlock(&crl_fetch_stats_mutex);
+}
+
+void list_crl_fetch_stats(struct show *s, bool utc)
+{
+	pthread_mutex_lock(&crl_fetch_stats_mutex);
+	{
+		if (crl_fetch_stats != NULL) {
+			show_blank(s);
+			show_comment(s, "List of CRL distribution point fetches:");
+			show_blank(s);
+			for (struct crl_fetch_stats *stats = crl_fetch_stats;
+			     stats != NULL; stats = stats->next) {
+				show_comment(s, "'%s'", stats->url);
+				SHOW_JAMBUF(RC_COMMENT, s, buf) {
+					jam(buf, "       last: ");
+					jam_realtime(buf, stats->last_time, utc);
+					jam(buf, ", %s, %zu bytes in ",
+					    crl_fetch_result_name[stats->last_result],
+					    stats->last_size);
+					jam_deltatime(buf, stats->last_latency);
+					jam(buf, "s");
+				}
+				show_comment(s, "       fetches: imported %u, unchanged %u, not modified %u, failed %u; %ju bytes total",
+					     stats->count[CRL_FETCH_IMPORTED],
+					     stats->count[CRL_FETCH_UNCHANGED],
+					     stats->count[CRL_FETCH_NOT_MODIFIED],
+					     stats->count[CRL_FETCH_FAILED],
+					     stats->bytes);
+				if (stats->etag != NULL) {
+					show_comment(s, "       etag: %s", stats->etag);
+				}
+			}
+		}
+	}
+	pthread_mutex_unlock(&crl_fetch_stats_mutex);
+}
+
+static bool fetched_crl(struct crl_fetch_job *job, chunk_t *blob,
+			enum crl_fetch_result *result);
+
 #ifdef LIBCURL
 
 #include <curl/curl.h>	/* rpm:libcurl-devel dep:libcurl4-nss-dev */
@@ -79,22 +238,72 @@ static size_t write_buffer(void *ptr, size_t size, size_t nmemb, void *data)
 }
 
 /*
- * fetches a binary blob from a url with libcurl
+ * A single curl transfer, one of many running in parallel.
+ */
+
+struct curl_transfer {
+	struct crl_fetch_job *job;
+	CURL *curl;
+	struct curl_slist *headers;
+	chunk_t response;	/* managed by realloc/free */
+	char *etag;		/* from the response */
+	bool conditional;	/* sent If-None-Match or If-Modified-Since */
+	monotime_t start;
+	char errorbuffer[CURL_ERROR_SIZE];
+};
+
+/*
+ * Saves the response's ETag: header in the transfer.
+ * A call-back used with libcurl.
  */
-static err_t fetch_curl(const char *url, chunk_t *blob, struct logger *logger)
+static size_t save_etag(char *ptr, size_t size, size_t nmemb, void *data)
 {
-	char errorbuffer[CURL_ERROR_SIZE] = "?";
-	chunk_t response = EMPTY_CHUNK;	/* managed by realloc/free */
+	size_t realsize = size * nmemb;
+	struct curl_transfer *transfer = data;
+	shunk_t header = shunk2(ptr, realsize);
+	shunk_t name = shunk_token(&header, NULL, ":");
+	if (header.ptr != NULL && hunk_strcaseeq(name, "ETag")) {
+		shunk_span(&header, " \t");
+		shunk_t value = shunk_token(&header, NULL, "\r\n");
+		if (value.len > 0) {
+			pfreeany(transfer->etag);
+			transfer->etag = clone_hunk_as_string(value, "crl etag");
+		}
+	}
+	return realsize;
+}
+
+static bool start_curl_transfer(CURLM *multi, struct curl_transfer *transfer)
+{
+	struct crl_fetch_job *job = transfer->job;
 	long timeout = curl_timeout > 0 ? curl_timeout : FETCH_CMD_TIMEOUT;
 
-	/* get it with libcurl */
-	CURL *curl = curl_easy_init();
+	transfer->errorbuffer[0] = '?';
+	transfer->errorbuffer[1] = '\0';
+
+	transfer->curl = curl_easy_init();
+	if (transfer->curl == NULL) {
+		llog(RC_LOG, job->logger, "fetching uri (%s) with libcurl failed: cannot initialize curl", job->url);
+		return false;
+	}
 
-	if (curl == NULL)
-		return "cannot initialize curl";
+	/*
+	 * When NSS still holds the CRL saved from this URL, only ask
+	 * for it if it has changed.
+	 */
+	char *etag;
+	long last_modified;
+	get_crl_fetch_validators(job->url, &etag, &last_modified);
+	if (!nss_has_crl(job->issuer_dn)) {
+		pfreeany(etag);
+		last_modified = -1;
+	}
 
-	dbg("Trying cURL '%s' with connect timeout of %ld", url, timeout);
+	dbg("Trying cURL '%s' with connect timeout of %ld%s%s%s", job->url, timeout,
+	    etag != NULL ? ", If-None-Match: " : "", etag != NULL ? etag : "",
+	    last_modified >= 0 ? ", If-Modified-Since" : "");
 
+	CURL *curl = transfer->curl;
 	CURLcode res = CURLE_OK;
 
 #	define CESO(optype, optarg) { \
@@ -106,55 +315,190 @@ static err_t fetch_curl(const char *url, chunk_t *blob, struct logger *logger)
 		} \
 	}
 
-	CESO(CURLOPT_URL, url);
+	CESO(CURLOPT_URL, job->url);
 	CESO(CURLOPT_WRITEFUNCTION, write_buffer);
 	/*
 	 * coverity scan:
 	 * "bad_sizeof: Taking the size of &response, which is the address of an object, is suspicious."
 	 * In fact, this code is correct.
 	 */
-	CESO(CURLOPT_WRITEDATA, (void *)&response);
-	CESO(CURLOPT_ERRORBUFFER, errorbuffer);
+	CESO(CURLOPT_WRITEDATA, (void *)&transfer->response);
+	CESO(CURLOPT_HEADERFUNCTION, save_etag);
+	CESO(CURLOPT_HEADERDATA, (void *)transfer);
+	CESO(CURLOPT_PRIVATE, (void *)transfer);
+	CESO(CURLOPT_ERRORBUFFER, transfer->errorbuffer);
 	CESO(CURLOPT_CONNECTTIMEOUT, timeout);
 	CESO(CURLOPT_TIMEOUT, 2 * timeout);
 	CESO(CURLOPT_NOSIGNAL, 1);	/* work around for libcurl signal bug */
+	CESO(CURLOPT_FILETIME, 1L);
 
 	if (curl_iface != NULL)
 		CESO(CURLOPT_INTERFACE, curl_iface);
 
+	if (last_modified >= 0) {
+		CESO(CURLOPT_TIMECONDITION, (long)CURL_TIMECOND_IFMODSINCE);
+		CESO(CURLOPT_TIMEVALUE, last_modified);
+	}
+
+	transfer->conditional = (etag != NULL || last_modified >= 0);
+	if (etag != NULL) {
+		char *header = alloc_printf("If-None-Match: %s", etag);
+		/* curl copies the string */
+		transfer->headers = curl_slist_append(NULL, header);
+		pfree(header);
+		CESO(CURLOPT_HTTPHEADER, transfer->headers);
+	}
+	pfreeany(etag);
+
 #	undef CESO
 
-	if (res == CURLE_OK)
-		res = curl_easy_perform(curl);
+	if (res == CURLE_OK) {
+		CURLMcode mres = curl_multi_add_handle(multi, curl);
+		if (mres != CURLM_OK) {
+			llog(RC_LOG, job->logger, "fetching uri (%s) with libcurl failed: %s",
+			     job->url, curl_multi_strerror(mres));
+			return false;
+		}
+	} else {
+		llog(RC_LOG, job->logger, "fetching uri (%s) with libcurl failed: %s",
+		     job->url, curl_easy_strerror(res));
+		return false;
+	}
+
+	transfer->start = mononow();
+	return true;
+}
+
+static void finish_curl_transfer(struct curl_transfer *transfer, CURLcode res)
+{
+	struct crl_fetch_job *job = transfer->job;
+	enum crl_fetch_result result = CRL_FETCH_FAILED;
+	chunk_t blob = empty_chunk; /* must free */
+	long last_modified = -1;
+	size_t size = transfer->response.len;
+	deltatime_t latency = monotimediff(mononow(), transfer->start);
 
 	if (res == CURLE_OK) {
-		/* clone from realloc(3)ed memory to pluto-allocated memory */
-		errorbuffer[0] = '\0';
-		*blob = clone_hunk(response, "curl blob");
+		long code = 0, unmet = 0;
+		curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &code);
+		curl_easy_getinfo(transfer->curl, CURLINFO_CONDITION_UNMET, &unmet);
+		curl_easy_getinfo(transfer->curl, CURLINFO_FILETIME, &last_modified);
+		if (transfer->conditional && (code == 304 || unmet)) {
+			dbg("CRL: %s not modified", job->url);
+			result = CRL_FETCH_NOT_MODIFIED;
+			job->fetched = true;
+		} else if (code >= 400) {
+			llog(RC_LOG, job->logger,
+			     "fetching uri (%s) with libcurl failed: HTTP response code %ld",
+			     job->url, code);
+		} else {
+			/* clone from realloc(3)ed memory to pluto-allocated memory */
+			blob = clone_hunk(transfer->response, "curl blob");
+			job->fetched = fetched_crl(job, &blob, &result);
+		}
 	} else {
-		llog(RC_LOG, logger,
-		     "fetching uri (%s) with libcurl failed: %s", url, errorbuffer);
+		llog(RC_LOG, job->logger,
+		     "fetching uri (%s) with libcurl failed: %s", job->url,
+		     transfer->errorbuffer[0] != '\0' ? transfer->errorbuffer : curl_easy_strerror(res));
 	}
-	curl_easy_cleanup(curl);
 
-	/* ??? where/how should this be logged? */
-	if (errorbuffer[0] != '\0') {
-		dbg("libcurl(%s) yielded %s", url, errorbuffer);
+	record_crl_fetch(job->url, result, size, latency,
+			 &transfer->etag, last_modified);
+	free_chunk_content(&blob);
+}
+
+static void release_curl_transfer(CURLM *multi, struct curl_transfer *transfer)
+{
+	if (transfer->curl != NULL) {
+		curl_multi_remove_handle(multi, transfer->curl);
+		curl_easy_cleanup(transfer->curl);
+		transfer->curl = NULL;
+	}
+	if (transfer->headers != NULL) {
+		curl_slist_free_all(transfer->headers);
+		transfer->headers = NULL;
+	}
+	if (transfer->response.ptr != NULL) {
+		free(transfer->response.ptr);	/* allocated via realloc(3) */
+		transfer->response = empty_chunk;
+	}
+	pfreeany(transfer->etag);
+}
+
+/*
+ * Fetch the URLs of JOBS in parallel, with at most
+ * FETCH_MAX_TRANSFERS transfers in flight.
+ */
+
+static void fetch_curl_crls(struct crl_fetch_job **jobs, unsigned nr_jobs)
+{
+	CURLM *multi = curl_multi_init();
+	if (multi == NULL) {
+		llog(RC_LOG, jobs[0]->logger, "cannot initialize curl");
+		return;
 	}
 
-	if (response.ptr != NULL)
-		free(response.ptr);	/* allocated via realloc(3) */
+	struct curl_transfer *transfers = alloc_things(struct curl_transfer, nr_jobs, "curl transfers");
+	unsigned started = 0;
+	unsigned running = 0;
 
-	/* ??? should this return errorbuffer instead? */
-	return strlen(errorbuffer) > 0 ? "libcurl error" : NULL;
+	while (!exiting_pluto) {
+		while (running < FETCH_MAX_TRANSFERS && started < nr_jobs) {
+			struct curl_transfer *transfer = &transfers[started++];
+			transfer->job = jobs[started - 1];
+			if (start_curl_transfer(multi, transfer)) {
+				running++;
+			} else {
+				release_curl_transfer(multi, transfer);
+			}
+		}
+		if (running == 0) {
+			break;
+		}
+
+		int still_running;
+		CURLMcode mres = curl_multi_perform(multi, &still_running);
+		if (mres != CURLM_OK) {
+			llog(RC_LOG, jobs[0]->logger, "curl_multi_perform() failed: %s",
+			     curl_multi_strerror(mres));
+			break;
+		}
+
+		CURLMsg *msg;
+		int msgs_left;
+		while ((msg = curl_multi_info_read(multi, &msgs_left)) != NULL) {
+			if (msg->msg != CURLMSG_DONE) {
+				continue;
+			}
+			struct curl_transfer *transfer = NULL;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&transfer);
+			passert(transfer != NULL && transfer->curl == msg->easy_handle);
+			finish_curl_transfer(transfer, msg->data.result);
+			release_curl_transfer(multi, transfer);
+			running--;
+		}
+
+		if (running > 0) {
+			curl_multi_wait(multi, NULL, 0, 1000, NULL);
+		}
+	}
+
+	/* anything left was abandoned */
+	for (unsigned t = 0; t < started; t++) {
+		release_curl_transfer(multi, &transfers[t]);
+	}
+	pfree(transfers);
+	curl_multi_cleanup(multi);
 }
 
 #else	/* LIBCURL */
 
-static err_t fetch_curl(const char *url UNUSED,
-			chunk_t *blob UNUSED)
+static void fetch_curl_crls(struct crl_fetch_job **jobs, unsigned nr_jobs)
 {
-	return "not compiled with libcurl support";
+	for (unsigned j = 0; j < nr_jobs; j++) {
+		llog(RC_LOG, jobs[j]->logger, "fetching uri (%s) failed: not compiled with libcurl support",
+		     jobs[j]->url);
+	}
 }
 
 #endif	/* LIBCURL */
@@ -303,27 +647,14 @@ static err_t fetch_ldap_url(const char *url UNUSED,
 #endif
 
 /*
- * fetch an ASN.1 blob coded in PEM or DER format from a URL
- * Returns error message or NULL.
- * Iff no error, *blob contains fetched ASN.1 blob (to be freed by caller).
+ * Check that the fetched ASN.1 blob is coded in PEM or DER format,
+ * converting PEM to DER.  Returns error message or NULL.  On error
+ * *blob is freed.
  */
 
-static err_t fetch_asn1_blob(const char *url, chunk_t *blob, struct logger *logger)
+static err_t decode_asn1_blob(chunk_t *blob)
 {
-	err_t ugh = NULL;
-
-	*blob = EMPTY_CHUNK;
-	if (startswith(url, "ldap:")) {
-		ugh = fetch_ldap_url(url, blob, logger);
-	} else {
-		ugh = fetch_curl(url, blob, logger);
-	}
-	if (ugh != NULL) {
-		free_chunk_content(blob);
-		return ugh;
-	}
-
-	ugh = asn1_ok(ASN1(*blob));
+	err_t ugh = asn1_ok(ASN1(*blob));
 	if (ugh == NULL) {
 		dbg("  fetched blob coded in DER format");
 	} else {
@@ -366,28 +697,88 @@ static bool insert_crl_nss(chunk_t blob, chunk_t issuer, const char *url, struct
 }
 
 /*
- * try to fetch the crls defined by the fetch requests
+ * Having fetched *BLOB from the job's URL, import it into NSS unless
+ * NSS already has that CRL.  Returns true when NSS is left with a
+ * current CRL.
  */
 
-static fetch_crl_fn fetch_crl; /* type check */
-
-static bool fetch_crl(chunk_t issuer_dn, const char *url, struct logger *logger)
+static bool fetched_crl(struct crl_fetch_job *job, chunk_t *blob,
+			enum crl_fetch_result *result)
 {
-	/* err?!?! */
-	if (!pexpect(url != NULL && strlen(url) > 0)) {
+	err_t ugh = decode_asn1_blob(blob);
+	if (ugh != NULL) {
+		dbg("CRL: fetch failed:  %s", ugh);
+		*result = CRL_FETCH_FAILED;
 		return false;
 	}
 
+	if (nss_crl_is_current(blob->ptr, blob->len, job->logger)) {
+		dn_buf dnb;
+		dbg("CRL: %s: CRL for '%s' unchanged, skipping import",
+		    job->url, str_dn(ASN1(job->issuer_dn), &dnb));
+		*result = CRL_FETCH_UNCHANGED;
+		return true;
+	}
+
+	if (insert_crl_nss(*blob, job->issuer_dn, job->url, job->logger)) {
+		*result = CRL_FETCH_IMPORTED;
+		return true;
+	}
+
+	*result = CRL_FETCH_FAILED;
+	return false;
+}
+
+static void fetch_ldap_crl(struct crl_fetch_job *job)
+{
 	chunk_t blob = empty_chunk; /* must free */
-	err_t ugh = fetch_asn1_blob(url, &blob, logger);
+	enum crl_fetch_result result = CRL_FETCH_FAILED;
+	monotime_t start = mononow();
+	err_t ugh = fetch_ldap_url(job->url, &blob, job->logger);
+	size_t size = blob.len;
 	if (ugh != NULL) {
 		dbg("CRL: fetch failed:  %s", ugh);
-		return false;
+	} else {
+		job->fetched = fetched_crl(job, &blob, &result);
 	}
-
-	bool ok = insert_crl_nss(blob, issuer_dn, url, logger);
+	char *etag = NULL;
+	record_crl_fetch(job->url, result, size,
+			 monotimediff(mononow(), start), &etag, -1);
 	free_chunk_content(&blob);
-	return ok;
+}
+
+/*
+ * Try to fetch the CRLs of the distribution points of one round of
+ * fetch requests.
+ *
+ * LDAP URLs are fetched one at a time; everything else is handed to
+ * libcurl and fetched in parallel.
+ */
+
+static fetch_crls_fn fetch_crls; /* type check */
+
+static void fetch_crls(struct crl_fetch_job *jobs, unsigned nr_jobs)
+{
+	struct crl_fetch_job **curl_jobs = alloc_things(struct crl_fetch_job *, nr_jobs, "curl jobs");
+	unsigned nr_curl_jobs = 0;
+
+	for (unsigned j = 0; j < nr_jobs && !exiting_pluto; j++) {
+		struct crl_fetch_job *job = &jobs[j];
+		/* err?!?! */
+		if (!pexpect(job->url != NULL && strlen(job->url) > 0)) {
+			continue;
+		}
+		if (startswith(job->url, "ldap:")) {
+			fetch_ldap_crl(job);
+		} else {
+			curl_jobs[nr_curl_jobs++] = job;
+		}
+	}
+
+	if (nr_curl_jobs > 0) {
+		fetch_curl_crls(curl_jobs, nr_curl_jobs);
+	}
+	pfree(curl_jobs);
 }
 
 /*
@@ -398,7 +789,7 @@ static bool fetch_crl(chunk_t issuer_dn, const char *url, struct logger *logger)
  * when it merges these requests with any still unprocessed requests.
  *
  * Similarly, if check_crls() is called more frequently than
- * fetch_crl() can process, redundant fetches will be merged.
+ * fetch_crls() can process, redundant fetches will be merged.
  */
 
 static void check_crls(struct logger *logger)
@@ -446,11 +837,9 @@ static void check_crls(struct logger *logger)
 	 * Add the pubkeys distribution points to fetch list.
 	 */
 
-	for (struct pubkey_list *pkl = pluto_pubkeys; pkl != NULL; pkl = pkl->next) {
-		struct pubkey *key = pkl->key;
-		if (key != NULL) {
-			add_crl_fetch_request(key->issuer, null_shunk, &requests, logger);
-		}
+	struct preloaded_pubkey_filter pkf = {0};
+	while (next_preloaded_pubkey(&pkf)) {
+		add_crl_fetch_request(pkf.key->issuer, null_shunk, &requests, logger);
 	}
 
 	/*
@@ -492,7 +881,7 @@ static void *fetch_thread(void *arg UNUSED)
 	dbg("CRL: fetch thread started");
 	/* XXX: on thread so no whack */
 	struct logger *logger = string_logger(null_fd, HERE, "crl thread: "); /* must free */
-	process_crl_fetch_requests(fetch_crl, logger);
+	process_crl_fetch_requests(fetch_crls, logger);
 	free_logger(&logger, HERE);
 	dbg("CRL: fetch thread stopped");
 	return NULL;
@@ -569,6 +958,7 @@ void stop_crl_fetch_helper(struct logger *logger)
 
 void free_crl_fetch(void)
 {
+	free_crl_fetch_stats();
 #ifdef LIBCURL
 	if (deltasecs(crl_check_interval) > 0) {
 		/* cleanup curl */
@@ -13,10 +13,13 @@
  * for more details.
  */
 
+struct show;
+
 extern void start_crl_fetch_helper(struct logger *logger);
 extern void stop_crl_fetch_helper(struct logger *logger);
 
 extern void free_crl_fetch(void);
+extern void list_crl_fetch_stats(struct show *s, bool utc);
 
 extern char *curl_iface;
 extern long curl_timeout;
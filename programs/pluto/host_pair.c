@@ -23,6 +23,9 @@
  *
  */
 
+#include <ctype.h>
+#include <stdlib.h>
+
 #include "defs.h"
 #include "connections.h"
 #include "pending.h"
@@ -33,6 +36,7 @@
 #include "iface.h"
 #include "orient.h"
 #include "host_pair.h"
+#include "timer.h"
 
 /*
  * Table of host_pairs (local->remote endpoints/addresses).
@@ -67,6 +71,39 @@ static hash_t hash_host_pair_addresses(const struct host_pair *hp)
 
 HASH_TABLE(host_pair, addresses, , STATE_TABLE_SIZE);
 
+/*
+ * Host pairs indexed by just the local, or just the remote, address.
+ *
+ * When an interface goes away, the connections oriented on it are
+ * found using the local address; when an interface appears, the
+ * connections that now have our address on both ends are found using
+ * the remote address.
+ */
+
+static hash_t hash_host_pair_local_address(const ip_address *local)
+{
+	return hash_hunk(address_as_shunk(local), zero_hash);
+}
+
+static void jam_host_pair_local_address(struct jambuf *buf, const struct host_pair *hp)
+{
+	jam_host_pair_addresses(buf, hp);
+}
+
+HASH_TABLE(host_pair, local_address, .local, STATE_TABLE_SIZE);
+
+static hash_t hash_host_pair_remote_address(const ip_address *remote)
+{
+	return hash_hunk(address_as_shunk(remote), zero_hash);
+}
+
+static void jam_host_pair_remote_address(struct jambuf *buf, const struct host_pair *hp)
+{
+	jam_host_pair_addresses(buf, hp);
+}
+
+HASH_TABLE(host_pair, remote_address, .remote, STATE_TABLE_SIZE);
+
 #define LIST_RM(ENEXT, E, EHEAD, EXPECTED)				\
 	{								\
 		bool found_ = false;					\
@@ -87,11 +124,297 @@ HASH_TABLE(host_pair, addresses, , STATE_TABLE_SIZE);
  * - should ID be considered (hard because not always known)?
  * - should IP address matter on our end (we don't know our end)?
  * Only oriented connections are registered.
- * Unoriented connections are kept on the unoriented_connections
- * linked list (using hp_next).  For them, host_pair is NULL.
+ * Unoriented connections are indexed by the address of each of their
+ * ends (see below).  For them, host_pair is NULL.
+ */
+
+/*
+ * Unoriented connections, indexed by both the local and remote host
+ * address.
+ *
+ * Since a connection can only become oriented when one of its
+ * addresses matches an interface, an interface appearing need only
+ * consider the connections in the two buckets for its address.
+ * Connections with an unset address (for instance, DNS failed) hash
+ * to the same bucket and are left alone until the address is
+ * updated.
+ *
+ * Before orientation, LOCAL and REMOTE are arbitrary (LEFT and
+ * RIGHT).
  */
 
-static struct connection *unoriented_connections = NULL;
+static hash_t hash_connection_unoriented_local(const ip_address *local)
+{
+	return hash_hunk(address_as_shunk(local), zero_hash);
+}
+
+static void jam_connection_unoriented_local(struct jambuf *buf, const struct connection *c)
+{
+	jam_connection(buf, c);
+	jam_string(buf, " local=");
+	jam_address(buf, &c->local->host.addr);
+}
+
+HASH_TABLE(connection, unoriented_local, .local->host.addr, STATE_TABLE_SIZE);
+
+static hash_t hash_connection_unoriented_remote(const ip_address *remote)
+{
+	return hash_hunk(address_as_shunk(remote), zero_hash);
+}
+
+static void jam_connection_unoriented_remote(struct jambuf *buf, const struct connection *c)
+{
+	jam_connection(buf, c);
+	jam_string(buf, " remote=");
+	jam_address(buf, &c->remote->host.addr);
+}
+
+HASH_TABLE(connection, unoriented_remote, .remote->host.addr, STATE_TABLE_SIZE);
+
+static bool unoriented_connection_indexed(const struct connection *c)
+{
+	/* the entry is only initialized when first indexed */
+	const struct list_entry *entry = &c->hash_table_entries.unoriented_local;
+	return (entry->data != NULL && !detached_list_entry(entry));
+}
+
+static void add_unoriented_connection(struct connection *c)
+{
+	pexpect(c->host_pair == NULL);
+	pexpect(c->interface == NULL);
+	if (c->hash_table_entries.unoriented_local.data == NULL) {
+		/* first time */
+		init_hash_table_entry(&connection_unoriented_local_hash_table, c);
+		init_hash_table_entry(&connection_unoriented_remote_hash_table, c);
+	}
+	add_hash_table_entry(&connection_unoriented_local_hash_table, c);
+	add_hash_table_entry(&connection_unoriented_remote_hash_table, c);
+}
+
+static void del_unoriented_connection(struct connection *c)
+{
+	del_hash_table_entry(&connection_unoriented_local_hash_table, c);
+	del_hash_table_entry(&connection_unoriented_remote_hash_table, c);
+}
+
+/*
+ * Oriented connections, indexed by host pair and remote ID.
+ *
+ * When refining the connection during IKE_AUTH, the responder need
+ * only consider the connections on the host pair that could match
+ * the peer's ID; on a concentrator with thousands of templates
+ * sharing %any that is a handful.
+ *
+ * The key follows match_id():
+ *
+ * - %any and %fromcert match anything so they share a single
+ *   wildcard key per host pair (always looked up);
+ *
+ * - FQDN and USER_FQDN ignore case and trailing dots;
+ *
+ * - a DN is keyed by its last non-wildcard value (normally the CN)
+ *   in the canonical form of dn_value_hashes(); the peer's DN is
+ *   looked up using each of its values, which covers any-order and
+ *   extra-RDN matches; a DN without such a value is a wildcard;
+ *
+ * - anything else is compared exactly.
+ *
+ * Candidates are returned in host-pair list order (.hp_order) so
+ * that the result of the search doesn't change.
+ */
+
+#define HP_ORDER_STEP (UINT64_C(1) << 20)	/* room for group instances */
+#define MAX_REMOTE_ID_KEYS 16
+
+static uint64_t hp_order_counter;
+
+static hash_t hash_remote_id_key(const struct host_pair *hp,
+				 enum ike_id_type kind, shunk_t value)
+{
+	hash_t hash = hash_thing(hp, zero_hash);
+	hash = hash_thing(kind, hash);
+	return hash_hunk(value, hash);
+}
+
+static hash_t hash_remote_id_wildcard(const struct host_pair *hp)
+{
+	return hash_remote_id_key(hp, ID_NONE, null_shunk);
+}
+
+static hash_t hash_remote_id_dn_value(const struct host_pair *hp, uint64_t value)
+{
+	return hash_remote_id_key(hp, ID_DER_ASN1_DN, THING_AS_SHUNK(value));
+}
+
+static hash_t hash_remote_id_fqdn(const struct host_pair *hp, const struct id *id)
+{
+	/* same as id_eq(): no case, no trailing dots, stop at NUL */
+	size_t len = id->name.len;
+	while (len > 0 && ((const uint8_t *)id->name.ptr)[len - 1] == '.') {
+		len--;
+	}
+	hash_t hash = hash_remote_id_key(hp, id->kind, THING_AS_SHUNK(len));
+	for (size_t i = 0; i < len; i++) {
+		char c = tolower(((const uint8_t *)id->name.ptr)[i]);
+		if (c == '\0') {
+			break;
+		}
+		hash = hash_thing(c, hash);
+	}
+	return hash;
+}
+
+/*
+ * The key of a connection's remote ID.
+ */
+
+static hash_t hash_remote_id(const struct host_pair *hp, const struct id *id)
+{
+	switch (id->kind) {
+	case ID_FQDN:
+	case ID_USER_FQDN:
+		return hash_remote_id_fqdn(hp, id);
+	case ID_IPV4_ADDR:
+	case ID_IPV6_ADDR:
+		return hash_remote_id_key(hp, id->kind, address_as_shunk(&id->ip_addr));
+	case ID_KEY_ID:
+		return hash_remote_id_key(hp, id->kind, HUNK_AS_SHUNK(id->name));
+	case ID_NULL:
+		return hash_remote_id_key(hp, id->kind, null_shunk);
+	case ID_DER_ASN1_DN:
+	{
+		uint64_t values[MAX_REMOTE_ID_KEYS];
+		int nr = dn_value_hashes(id->name, values, elemsof(values));
+		if (nr > 0) {
+			return hash_remote_id_dn_value(hp, values[nr - 1]);
+		}
+		return hash_remote_id_wildcard(hp);
+	}
+	default:
+		/* ID_NONE, ID_FROMCERT */
+		return hash_remote_id_wildcard(hp);
+	}
+}
+
+/*
+ * The keys to look up for the peer's ID; false when the peer's ID
+ * can't be keyed and every connection needs to be considered.
+ */
+
+static bool remote_id_keys(const struct host_pair *hp, const struct id *peer_id,
+			   hash_t *keys, unsigned *nr_keys)
+{
+	*nr_keys = 0;
+	keys[(*nr_keys)++] = hash_remote_id_wildcard(hp);
+	switch (peer_id->kind) {
+	case ID_NONE:
+	case ID_FROMCERT:
+		return false;
+	case ID_DER_ASN1_DN:
+	{
+		uint64_t values[MAX_REMOTE_ID_KEYS];
+		int nr = dn_value_hashes(peer_id->name, values, elemsof(values));
+		if (nr < 0) {
+			return false;
+		}
+		for (int i = 0; i < nr; i++) {
+			keys[(*nr_keys)++] = hash_remote_id_dn_value(hp, values[i]);
+		}
+		return true;
+	}
+	default:
+		keys[(*nr_keys)++] = hash_remote_id(hp, peer_id);
+		return true;
+	}
+}
+
+static hash_t hash_connection_host_pair_remote_id(const hash_t *hash)
+{
+	return *hash;
+}
+
+static void jam_connection_host_pair_remote_id(struct jambuf *buf, const struct connection *c)
+{
+	jam_connection(buf, c);
+	jam_string(buf, " remote_id=");
+	jam_id_bytes(buf, &c->remote->host.id, jam_sanitized_bytes);
+}
+
+HASH_TABLE(connection, host_pair_remote_id, .hp_remote_id, STATE_TABLE_SIZE);
+
+static void add_host_pair_remote_id(struct connection *c)
+{
+	if (c->hash_table_entries.host_pair_remote_id.data == NULL) {
+		/* first time */
+		init_hash_table_entry(&connection_host_pair_remote_id_hash_table, c);
+	}
+	c->hp_remote_id = hash_remote_id(c->host_pair, &c->remote->host.id);
+	add_hash_table_entry(&connection_host_pair_remote_id_hash_table, c);
+}
+
+static void del_host_pair_remote_id(struct connection *c)
+{
+	del_hash_table_entry(&connection_host_pair_remote_id_hash_table, c);
+}
+
+void rehash_host_pair_remote_id(struct connection *c)
+{
+	/* a clone has its parent's .host_pair but isn't indexed */
+	if (c->host_pair != NULL &&
+	    c->hash_table_entries.host_pair_remote_id.data != NULL) {
+		del_host_pair_remote_id(c);
+		add_host_pair_remote_id(c);
+	}
+}
+
+static int hp_order_new2old(const void *lhs, const void *rhs)
+{
+	const struct connection *l = *(const struct connection *const *)lhs;
+	const struct connection *r = *(const struct connection *const *)rhs;
+	return (l->hp_order < r->hp_order ? 1 :
+		l->hp_order > r->hp_order ? -1 : 0);
+}
+
+/*
+ * Queue of changes waiting for check_orientations().
+ *
+ * Addresses are those of interfaces that were added or removed (so
+ * could change which end is local); connections are unoriented
+ * connections whose addresses changed.  Connections are saved by
+ * serial number so that they can be safely deleted while queued; a
+ * connection queued twice is only re-oriented once as the second
+ * attempt finds it already oriented (or it fails the same way).
+ */
+
+static struct {
+	ip_address *addresses;
+	unsigned nr_addresses;
+	co_serial_t *connections;
+	unsigned nr_connections;
+} orientation_queue;
+
+static void queue_orientation_address(const ip_address address)
+{
+	for (unsigned i = 0; i < orientation_queue.nr_addresses; i++) {
+		if (address_eq_address(orientation_queue.addresses[i], address)) {
+			return;
+		}
+	}
+	realloc_things(orientation_queue.addresses,
+		       orientation_queue.nr_addresses,
+		       orientation_queue.nr_addresses + 1,
+		       "orientation queue addresses");
+	orientation_queue.addresses[orientation_queue.nr_addresses++] = address;
+}
+
+static void queue_orientation_connection(const struct connection *c)
+{
+	realloc_things(orientation_queue.connections,
+		       orientation_queue.nr_connections,
+		       orientation_queue.nr_connections + 1,
+		       "orientation queue connections");
+	orientation_queue.connections[orientation_queue.nr_connections++] = c->serialno;
+}
 
 void host_pair_enqueue_pending(const struct connection *c,
 			       struct pending *p)
@@ -168,6 +491,10 @@ static struct host_pair *alloc_host_pair(ip_address local, ip_address remote, wh
 	hp->remote = (address_is_unset(&remote) ? address_type(&local)->address.unspec : remote);
 	init_hash_table_entry(&host_pair_addresses_hash_table, hp);
 	add_hash_table_entry(&host_pair_addresses_hash_table, hp);
+	init_hash_table_entry(&host_pair_local_address_hash_table, hp);
+	add_hash_table_entry(&host_pair_local_address_hash_table, hp);
+	init_hash_table_entry(&host_pair_remote_address_hash_table, hp);
+	add_hash_table_entry(&host_pair_remote_address_hash_table, hp);
 	return hp;
 }
 
@@ -177,11 +504,90 @@ static void free_host_pair(struct host_pair **hp, where_t where)
 	passert((*hp)->pending == NULL);
 	pexpect((*hp)->connections == NULL);
 	del_hash_table_entry(&host_pair_addresses_hash_table, *hp);
+	del_hash_table_entry(&host_pair_local_address_hash_table, *hp);
+	del_hash_table_entry(&host_pair_remote_address_hash_table, *hp);
 	dbg_free("hp", *hp, where);
 	pfree(*hp);
 	*hp = NULL;
 }
 
+static struct host_pair *find_host_pair(const ip_address local,
+					const ip_address remote)
+{
+	hash_t hash = hp_hasher(local, remote);
+	struct list_head *bucket = hash_table_bucket(&host_pair_addresses_hash_table, hash);
+	struct host_pair *hp = NULL;
+	FOR_EACH_LIST_ENTRY_NEW2OLD(bucket, hp) {
+		if (host_pair_matches_addresses(hp, local, remote)) {
+			return hp;
+		}
+	}
+	return NULL;
+}
+
+unsigned host_pair_remote_id_candidates(const ip_address local,
+					const ip_address remote,
+					const struct id *peer_id,
+					struct connection ***candidates,
+					unsigned *skipped)
+{
+	*candidates = NULL;
+	*skipped = 0;
+	struct host_pair *hp = find_host_pair(local, remote);
+	if (hp == NULL || hp->nr_connections == 0) {
+		return 0;
+	}
+
+	unsigned nr = 0;
+	*candidates = alloc_things(struct connection *, hp->nr_connections,
+				   "remote ID candidates");
+
+	hash_t keys[1 + MAX_REMOTE_ID_KEYS];
+	unsigned nr_keys;
+	if (peer_id == NULL ||
+	    !remote_id_keys(hp, peer_id, keys, &nr_keys)) {
+		/* the list is already in order */
+		for (struct connection *c = hp->connections; c != NULL; c = c->hp_next) {
+			(*candidates)[nr++] = c;
+		}
+	} else {
+		struct list_head *buckets[elemsof(keys)];
+		unsigned nr_buckets = 0;
+		for (unsigned k = 0; k < nr_keys; k++) {
+			struct list_head *bucket =
+				hash_table_bucket(&connection_host_pair_remote_id_hash_table, keys[k]);
+			/* two keys can share a bucket */
+			bool seen = false;
+			for (unsigned b = 0; b < nr_buckets; b++) {
+				seen |= (buckets[b] == bucket);
+			}
+			if (seen) {
+				continue;
+			}
+			buckets[nr_buckets++] = bucket;
+			struct connection *c;
+			FOR_EACH_LIST_ENTRY_NEW2OLD(bucket, c) {
+				if (c->host_pair != hp) {
+					continue;
+				}
+				for (unsigned i = 0; i < nr_keys; i++) {
+					if (c->hp_remote_id.hash == keys[i].hash) {
+						passert(nr < hp->nr_connections);
+						(*candidates)[nr++] = c;
+						break;
+					}
+				}
+			}
+		}
+		qsort(*candidates, nr, sizeof((*candidates)[0]), hp_order_new2old);
+	}
+
+	*skipped = hp->nr_connections - nr;
+	dbg("%s() %u of %u connections on the host pair could match",
+	    __func__, nr, hp->nr_connections);
+	return nr;
+}
+
 struct connection *next_host_pair_connection(const ip_address local,
 					     const ip_address remote,
 					     struct connection **next,
@@ -198,18 +604,13 @@ struct connection *next_host_pair_connection(const ip_address local,
 		 * Find the host-pair list that contains all
 		 * connections matching REMOTE->LOCAL.
 		 */
-		hash_t hash = hp_hasher(local, remote);
-		struct list_head *bucket = hash_table_bucket(&host_pair_addresses_hash_table, hash);
-		struct host_pair *hp = NULL;
-		FOR_EACH_LIST_ENTRY_NEW2OLD(bucket, hp) {
-			if (host_pair_matches_addresses(hp, local, remote)) {
-				connection_buf cb;
-				address_buf lb, rb;
-				dbg("  host_pair: %s->%s matches "PRI_CONNECTION,
-				    str_address(&remote, &rb), str_address(&local, &lb),
-				    pri_connection(hp->connections, &cb));
-				break;
-			}
+		struct host_pair *hp = find_host_pair(local, remote);
+		if (hp != NULL) {
+			connection_buf cb;
+			address_buf lb, rb;
+			dbg("  host_pair: %s->%s matches "PRI_CONNECTION,
+			    str_address(&remote, &rb), str_address(&local, &lb),
+			    pri_connection(hp->connections, &cb));
 		}
 		c = (hp != NULL) ? hp->connections : NULL;
 	} else {
@@ -228,48 +629,116 @@ void connect_to_host_pair(struct connection *c)
 		address_buf lb, rb;
 		dbg("looking for host pair matching %s->%s",
 		    str_address(&remote, &rb), str_address(&local, &lb));
-		hash_t hash = hp_hasher(local, remote);
-		struct host_pair *hp = NULL;
-		struct list_head *bucket = hash_table_bucket(&host_pair_addresses_hash_table, hash);
-		FOR_EACH_LIST_ENTRY_NEW2OLD(bucket, hp) {
-			if (host_pair_matches_addresses(hp, local, remote)) {
-				break;
-			}
-		}
+		struct host_pair *hp = find_host_pair(local, remote);
 		if (hp == NULL) {
 			/* no suitable host_pair -- build one */
-			ip_address local = c->local->host.addr;
-			/* remote could be unset OR any */
-			ip_address remote = c->remote->host.addr;
 			hp = alloc_host_pair(local, remote, HERE);
 		}
 		c->host_pair = hp;
 		c->hp_next = hp->connections;
 		hp->connections = c;
+		hp->nr_connections++;
+		c->hp_order = ++hp_order_counter * HP_ORDER_STEP;
+		add_host_pair_remote_id(c);
 	} else {
 		/* since this connection isn't oriented, we place it
-		 * in the unoriented_connections list instead.
+		 * in the unoriented connection index instead.
 		 */
 		pexpect(c->host_pair == NULL);
 		pexpect(c->interface == NULL);
 		c->host_pair = NULL;
-		c->hp_next = unoriented_connections;
-		unoriented_connections = c;
+		c->hp_next = NULL;
+		add_unoriented_connection(c);
 	}
 }
 
+/*
+ * Group instances go straight after their group so that they are
+ * found (and tried) in the same order as the group's targets.
+ */
+
+void connect_group_instance_to_host_pair(struct connection *group,
+					 struct connection *t)
+{
+	struct host_pair *hp = group->host_pair;
+	passert(hp != NULL);
+	t->host_pair = hp;
+	t->hp_next = group->hp_next;
+	group->hp_next = t;
+	hp->nr_connections++;
+	/* squeeze between the group and whatever follows */
+	uint64_t floor = group->hp_order - HP_ORDER_STEP;
+	t->hp_order = (t->hp_next != NULL && t->hp_next->hp_order > floor ?
+		       t->hp_next->hp_order + 1 : floor + 1);
+	add_host_pair_remote_id(t);
+}
+
+static int co_serial_new2old(const void *lhs, const void *rhs)
+{
+	co_serial_t l = *(const co_serial_t *)lhs;
+	co_serial_t r = *(const co_serial_t *)rhs;
+	return (l < r ? 1 : l > r ? -1 : 0);
+}
+
 void release_dead_interfaces(struct logger *logger)
 {
+	/*
+	 * Gather the connections oriented on a dead interface.
+	 *
+	 * An oriented connection's local address is its interface's
+	 * address so only host-pairs with a dead local address need
+	 * to be considered.  Save serial numbers, not pointers, as
+	 * deleting an instance below can delete other connections.
+	 */
+	co_serial_t *serialnos = NULL;
+	unsigned nr_serialnos = 0;
+	for (struct iface_endpoint *ifp = interfaces; ifp != NULL; ifp = ifp->next) {
+		if (ifp->ip_dev->ifd_change != IFD_DELETE) {
+			continue;
+		}
+		const ip_address local = ifp->ip_dev->id_address;
+		/*
+		 * An unoriented connection mentioning this address
+		 * may have been ambiguous; give it another go.
+		 */
+		queue_orientation_address(local);
+		hash_t hash = hash_host_pair_local_address(&local);
+		struct list_head *bucket = hash_table_bucket(&host_pair_local_address_hash_table, hash);
+		struct host_pair *hp;
+		FOR_EACH_LIST_ENTRY_NEW2OLD(bucket, hp) {
+			if (!address_eq_address(hp->local, local)) {
+				continue;
+			}
+			for (struct connection *c = hp->connections; c != NULL; c = c->hp_next) {
+				realloc_things(serialnos, nr_serialnos, nr_serialnos + 1,
+					       "dead interface connections");
+				serialnos[nr_serialnos++] = c->serialno;
+			}
+		}
+	}
+
 	/*
 	 * Release (and for instances, delete) any connections with a
 	 * dead interface.
 	 *
-	 * The connections are scanned new-to-old so that instances
-	 * are deleted before templates are released.
+	 * The connections are processed new-to-old so that instances
+	 * are deleted before templates are released.  (A connection
+	 * bound to two dead endpoints on the same address is listed
+	 * twice; the second time it is no longer oriented.)
 	 */
-	struct connection_filter cf = { .where = HERE, };
-	while (next_connection_new2old(&cf)) {
-		struct connection *c = cf.c;
+	if (nr_serialnos > 1) {
+		/* qsort() is nonnull */
+		qsort(serialnos, nr_serialnos, sizeof(serialnos[0]), co_serial_new2old);
+	}
+	dbg("%s() found %u connections on dead interfaces", __func__, nr_serialnos);
+
+	for (unsigned i = 0; i < nr_serialnos; i++) {
+		struct connection *c = connection_by_serialno(serialnos[i]);
+		if (c == NULL) {
+			dbg("connection "PRI_CO" on dead interface already deleted",
+			    pri_co(serialnos[i]));
+			continue;
+		}
 
 		if (!oriented(c)) {
 			connection_buf cb;
@@ -334,18 +803,22 @@ void release_dead_interfaces(struct logger *logger)
 
 		/*
 		 * ... and then disorient it, moving it to the
-		 * unoriented list.
+		 * unoriented index.  Queue it so that the next
+		 * check_orientations() gives it a chance to re-orient
+		 * using a surviving interface.
 		 */
 		pexpect(c->host_pair != NULL);
 		delete_oriented_hp(c);
 		iface_endpoint_delref(&c->interface);
-		c->hp_next = unoriented_connections;
-		unoriented_connections = c;
+		connect_to_host_pair(c);
 		pexpect(c->host_pair == NULL);
+		queue_orientation_connection(c);
 
 		/* XXX: something better? */
 		fd_delref(&c->logger->global_whackfd);
 	}
+
+	pfreeany(serialnos);
 }
 
 void delete_oriented_hp(struct connection *c)
@@ -356,6 +829,8 @@ void delete_oriented_hp(struct connection *c)
 	pexpect(c->interface != NULL);
 
 	LIST_RM(hp_next, c, hp->connections, true/*expected*/);
+	hp->nr_connections--;
+	del_host_pair_remote_id(c);
 
 	pexpect(c->host_pair != NULL);
 	c->host_pair = NULL;
@@ -375,10 +850,13 @@ void host_pair_remove_connection(struct connection *c, bool connection_valid)
 	if (c->host_pair == NULL) {
 		/*
 		 * When CONNECTION_VALID expect to find/remove C from
-		 * the unoriented list.
+		 * the unoriented index.
 		 */
-		LIST_RM(hp_next, c, unoriented_connections,
-			connection_valid);
+		if (unoriented_connection_indexed(c)) {
+			del_unoriented_connection(c);
+		} else {
+			pexpect(!connection_valid);
+		}
 	} else {
 		delete_oriented_hp(c);
 	}
@@ -392,8 +870,19 @@ void update_host_pairs(struct connection *c)
 
 	/* ??? perhaps we should return early if dnshostname == NULL */
 
-	if (hp == NULL)
+	if (hp == NULL) {
+		/*
+		 * Unoriented; the new address may allow orientation
+		 * so re-index and queue it.
+		 */
+		if (unoriented_connection_indexed(c)) {
+			rehash_table_entry(&connection_unoriented_local_hash_table, c);
+			rehash_table_entry(&connection_unoriented_remote_hash_table, c);
+			queue_orientation_connection(c);
+			schedule_check_orientations();
+		}
 		return;
+	}
 
 	struct connection *d = hp->connections;
 
@@ -446,6 +935,8 @@ void update_host_pairs(struct connection *c)
 
 			d->remote->host.addr = new_addr;
 			LIST_RM(hp_next, d, d->host_pair->connections, true);
+			d->host_pair->nr_connections--;
+			del_host_pair_remote_id(d);
 
 			d->hp_next = conn_list;
 			conn_list = d;
@@ -466,29 +957,134 @@ void update_host_pairs(struct connection *c)
 	}
 }
 
-/* Adjust orientations of connections to reflect newly added interfaces. */
-void check_orientations(struct logger *logger)
+/*
+ * Try to orient an unoriented connection.  Either it ends up on a
+ * host pair, or back in the unoriented index.
+ */
+
+static void reorient_connection(struct connection *c, struct logger *logger)
+{
+	del_unoriented_connection(c);
+	orient(c, logger);
+	connect_to_host_pair(c);
+}
+
+static void orient_connections_by_address(const ip_address address, struct logger *logger)
 {
 	/*
-	 * Try to orient unoriented connections by re-building the
-	 * unoriented connections list.
-	 *
-	 * The list is emptied, then as each connection fails to
-	 * orient it goes back on the list.
+	 * Step off the entry before it is re-indexed (it may land
+	 * back in the same bucket).  Gather the candidates first.
 	 */
-	dbg("FOR_EACH_UNORIENTED_CONNECTION_... in %s", __func__);
-	struct connection *c = unoriented_connections;
-	unoriented_connections = NULL;
-	while (c != NULL) {
-		/* step off */
-		struct connection *nxt = c->hp_next;
-		orient(c, logger);
+	co_serial_t *serialnos = NULL;
+	unsigned nr_serialnos = 0;
+	FOR_EACH_THING(table, &connection_unoriented_local_hash_table,
+		       &connection_unoriented_remote_hash_table) {
+		hash_t hash = hash_hunk(address_as_shunk(&address), zero_hash);
+		struct list_head *bucket = hash_table_bucket(table, hash);
+		struct connection *c;
+		FOR_EACH_LIST_ENTRY_NEW2OLD(bucket, c) {
+			if (!address_eq_address(c->local->host.addr, address) &&
+			    !address_eq_address(c->remote->host.addr, address)) {
+				continue;
+			}
+			realloc_things(serialnos, nr_serialnos, nr_serialnos + 1,
+				       "unoriented connections");
+			serialnos[nr_serialnos++] = c->serialno;
+		}
+	}
+
+	address_buf ab;
+	dbg("orienting %u unoriented connections matching %s",
+	    nr_serialnos, str_address(&address, &ab));
+
+	for (unsigned i = 0; i < nr_serialnos; i++) {
+		/* found twice when both ends have ADDRESS */
+		struct connection *c = connection_by_serialno(serialnos[i]);
+		if (c != NULL && unoriented_connection_indexed(c)) {
+			reorient_connection(c, logger);
+		}
+	}
+	pfreeany(serialnos);
+}
+
+static void disorient_host_pairs_by_remote(const ip_address address, struct logger *logger)
+{
+	hash_t hash = hash_host_pair_remote_address(&address);
+	struct list_head *bucket = hash_table_bucket(&host_pair_remote_address_hash_table, hash);
+	struct host_pair *hp = NULL;
+	FOR_EACH_LIST_ENTRY_NEW2OLD(bucket, hp) {
 		/*
-		 * Either put C back on unoriented, or add to a host
-		 * pair.
+		 * XXX: what's with the maybe compare the port logic?
 		 */
-		connect_to_host_pair(c);
-		c = nxt;
+		if (!sameaddr(&hp->remote, &address)) {
+			continue;
+		}
+		/*
+		 * bad news: the whole chain of connections hanging
+		 * off this host pair has both sides matching an
+		 * interface.  We'll get rid of them, using orient and
+		 * connect_to_host_pair.
+		 */
+		struct connection *c = hp->connections;
+		hp->connections = NULL;
+		hp->nr_connections = 0;
+		while (c != NULL) {
+			struct connection *nxt = c->hp_next;
+			del_host_pair_remote_id(c);
+			iface_endpoint_delref(&c->interface);
+			c->host_pair = NULL;
+			c->hp_next = NULL;
+			orient(c, logger);
+			connect_to_host_pair(c);
+			c = nxt;
+		}
+		/*
+		 * XXX: is this ever not the case?
+		 */
+		if (hp->connections == NULL) {
+			free_host_pair(&hp, HERE);
+		}
+	}
+}
+
+/* Adjust orientations of connections to reflect queued changes and newly added interfaces. */
+void check_orientations(struct logger *logger)
+{
+	/*
+	 * Newly added interfaces are implicitly queued.
+	 */
+	for (struct iface_endpoint *i = interfaces; i != NULL; i = i->next) {
+		if (i->ip_dev->ifd_change == IFD_ADD) {
+			queue_orientation_address(i->ip_dev->id_address);
+		}
+	}
+
+	/*
+	 * Take the queue; orienting a connection can't add to it but
+	 * be safe.
+	 */
+	ip_address *addresses = orientation_queue.addresses;
+	unsigned nr_addresses = orientation_queue.nr_addresses;
+	co_serial_t *serialnos = orientation_queue.connections;
+	unsigned nr_serialnos = orientation_queue.nr_connections;
+	zero_thing(orientation_queue);
+
+	dbg("%s() processing %u addresses and %u connections",
+	    __func__, nr_addresses, nr_serialnos);
+
+	/*
+	 * Try to orient the unoriented connections that could be
+	 * affected.  As each connection fails to orient it goes back
+	 * into the unoriented index.
+	 */
+	for (unsigned i = 0; i < nr_serialnos; i++) {
+		struct connection *c = connection_by_serialno(serialnos[i]);
+		if (c != NULL && unoriented_connection_indexed(c)) {
+			reorient_connection(c, logger);
+		}
+	}
+	for (unsigned i = 0; i < nr_addresses; i++) {
+		orient_connections_by_address(addresses[i], logger);
 	}
 
 	/*
@@ -497,55 +1093,31 @@ void check_orientations(struct logger *logger)
 	 * interfaces.
 	 */
 	for (struct iface_endpoint *i = interfaces; i != NULL; i = i->next) {
-		if (i->ip_dev->ifd_change != IFD_ADD) {
-			continue;
-		}
-		for (unsigned u = 0; u < host_pair_addresses_hash_table.nr_slots; u++) {
-			struct list_head *bucket = &host_pair_addresses_hash_table.slots[u];
-			struct host_pair *hp = NULL;
-			FOR_EACH_LIST_ENTRY_NEW2OLD(bucket, hp) {
-				/*
-				 * XXX: what's with the maybe compare
-				 * the port logic?
-				 */
-				if (sameaddr(&hp->remote,
-					     &i->ip_dev->id_address)) {
-					/*
-					 * bad news: the whole chain
-					 * of connections hanging off
-					 * this host pair has both
-					 * sides matching an
-					 * interface.  We'll get rid
-					 * of them, using orient and
-					 * connect_to_host_pair.
-					 */
-					struct connection *c =
-						hp->connections;
-					hp->connections = NULL;
-					while (c != NULL) {
-						struct connection *nxt =
-							c->hp_next;
-						iface_endpoint_delref(&c->interface);
-						c->host_pair = NULL;
-						c->hp_next = NULL;
-						orient(c, logger);
-						connect_to_host_pair(c);
-						c = nxt;
-					}
-					/*
-					 * XXX: is this ever not the
-					 * case?
-					 */
-					if (hp->connections == NULL) {
-						free_host_pair(&hp, HERE);
-					}
-				}
-			}
+		if (i->ip_dev->ifd_change == IFD_ADD) {
+			disorient_host_pairs_by_remote(i->ip_dev->id_address, logger);
 		}
 	}
+
+	pfreeany(addresses);
+	pfreeany(serialnos);
+}
+
+void schedule_check_orientations(void)
+{
+	schedule_oneshot_timer(EVENT_CHECK_ORIENTATIONS, deltatime(0));
 }
 
 void init_host_pair_db(struct logger *logger)
 {
 	init_hash_table(&host_pair_addresses_hash_table, logger);
+	init_hash_table(&host_pair_local_address_hash_table, logger);
+	init_hash_table(&host_pair_remote_address_hash_table, logger);
+	init_hash_table(&connection_unoriented_local_hash_table, logger);
+	init_hash_table(&connection_unoriented_remote_hash_table, logger);
+	init_hash_table(&connection_host_pair_remote_id_hash_table, logger);
+}
+
+void init_host_pair_timer(void)
+{
+	init_oneshot_timer(EVENT_CHECK_ORIENTATIONS, check_orientations);
 }
@@ -41,8 +41,11 @@ struct host_pair {
 	ip_address remote;
 	struct connection *connections;         /* connections with this pair */
 	struct pending *pending;                /* awaiting Keying Channel */
+	unsigned nr_connections;                /* length of .connections */
 	struct {
 		struct list_entry addresses;
+		struct list_entry local_address;
+		struct list_entry remote_address;
 	} hash_table_entries;
 };
 
@@ -52,6 +55,9 @@ extern void host_pair_enqueue_pending(const struct connection *c,
 struct pending **host_pair_first_pending(const struct connection *c);
 
 extern void connect_to_host_pair(struct connection *c);
+void connect_group_instance_to_host_pair(struct connection *group,
+					 struct connection *t);
+void rehash_host_pair_remote_id(struct connection *c);
 
 void delete_oriented_hp(struct connection *c);
 void host_pair_remove_connection(struct connection *c, bool connection_valid);
@@ -59,9 +65,20 @@ void host_pair_remove_connection(struct connection *c, bool connection_valid);
 extern void update_host_pairs(struct connection *c);
 
 extern void release_dead_interfaces(struct logger *logger);
+
+/*
+ * Orientation is incremental: only connections mentioning an address
+ * that changed (an interface came or went, DNS resolved) are
+ * re-examined.  Changes are queued; check_orientations() processes
+ * everything queued in a single pass; schedule_check_orientations()
+ * arranges for that pass to happen from the event loop so that a
+ * burst of changes is coalesced.
+ */
 extern void check_orientations(struct logger *logger);
+extern void schedule_check_orientations(void);
 
 void init_host_pair_db(struct logger *logger);
+void init_host_pair_timer(void);
 
 struct connection *next_host_pair_connection(const ip_address local,
 					     const ip_address remote,
@@ -74,4 +91,16 @@ struct connection *next_host_pair_connection(const ip_address local,
 	     CONNECTION != NULL;					\
 	     CONNECTION = next_host_pair_connection(LOCAL, REMOTE, &next_, false, HERE))
 
+/*
+ * The connections on the LOCAL<-REMOTE host pair whose remote ID
+ * could match PEER_ID (NULL matches all), in host-pair order;
+ * returns the count and an array the caller must pfree().  SKIPPED
+ * is the number of connections ruled out.
+ */
+unsigned host_pair_remote_id_candidates(const ip_address local,
+					const ip_address remote,
+					const struct id *peer_id,
+					struct connection ***candidates,
+					unsigned *skipped);
+
 #endif
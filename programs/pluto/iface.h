@@ -20,6 +20,8 @@
 #ifndef IFACE_H
 #define IFACE_H
 
+#include <sys/uio.h>		/* for struct iovec */
+
 #include "ip_endpoint.h"
 #include "refcnt.h"
 #include "list_entry.h"
@@ -30,6 +32,7 @@ struct iface_endpoint;
 struct show;
 struct iface_dev;
 struct logger;
+struct iketcp_output;
 
 struct iface_packet {
 	ssize_t len;
@@ -38,6 +41,17 @@ struct iface_packet {
 	struct logger *logger; /*global*/
 };
 
+/*
+ * An outgoing packet, gathered from up to three pieces (the non-ESP
+ * marker, and the two hunks passed to send) so it needn't be copied.
+ */
+
+struct outgoing_packet {
+	struct iovec iov[3];
+	unsigned nr_iov;
+	size_t len;
+};
+
 struct iface_io {
 	bool send_keepalive;
 	struct {
@@ -48,9 +62,19 @@ struct iface_io {
 	struct msg_digest *(*read_packet)(struct iface_endpoint **ifp,
 					  struct logger *logger);
 	ssize_t (*write_packet)(const struct iface_endpoint *ifp,
-				const void *ptr, size_t len,
+				const struct outgoing_packet *packet,
 				const ip_endpoint *remote_endpoint,
 				struct logger *logger);
+	/*
+	 * Optional: send several packets to the one remote using a
+	 * single system call; returns the number sent, or -1 with
+	 * errno set when none were.
+	 */
+	int (*write_packets)(const struct iface_endpoint *ifp,
+			     const struct outgoing_packet *packets,
+			     unsigned nr_packets,
+			     const ip_endpoint *remote_endpoint,
+			     struct logger *logger);
 	void (*cleanup)(struct iface_endpoint *ifp);
 	void (*listen)(struct iface_endpoint *fip, struct logger *logger);
 	int (*bind_iface_endpoint)(const char *iface, ip_endpoint endpoint, struct logger *logger);
@@ -159,6 +183,8 @@ struct iface_endpoint {
 		/* tcp stream only */
 		struct timeout *prefix_timeout;
 		struct fd_read_listener *read_listener;
+		/* messages the kernel would not take; see iface_tcp.c */
+		struct iketcp_output *output;
 	} iketcp;
 	ip_endpoint iketcp_remote_endpoint;
 	bool iketcp_server;
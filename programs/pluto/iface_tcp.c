@@ -28,6 +28,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>		/* for read() */
+#include <sys/uio.h>		/* for writev() */
 
 #include <netinet/tcp.h>	/* for TCP_ULP (hopefully) */
 #ifndef TCP_ULP
@@ -130,6 +131,17 @@ static void stop_iketcp_read(const char *why, struct iface_endpoint *ifp)
 static void iketcp_shutdown(struct iface_endpoint **ifp)
 {
 	stop_iketcp_read("stop", *ifp);
+	if ((*ifp)->iketcp_server && (*ifp)->iketcp_state == IKETCP_ENABLED) {
+		/*
+		 * The server's reference went with the first packet;
+		 * what's left belongs to the states using IFP, and
+		 * releasing one would leave them with a dangling
+		 * pointer.
+		 */
+		dbg_iketcp(*ifp, "leaving the endpoint to its states");
+		*ifp = NULL;
+		return;
+	}
 	iface_endpoint_delref(ifp);
 }
 
@@ -142,6 +154,238 @@ static void stop_iketcp_timeout(const char *why, struct iface_endpoint *ifp)
 	}
 }
 
+/*
+ * Output queue.
+ *
+ * With ESPINTCP the kernel frames each write() as one message, and a
+ * non-blocking write() fails with EAGAIN while an earlier message is
+ * still going out; a burst of IKE_AUTH fragments is enough.  Instead
+ * of losing the message, keep it and write it once the socket is
+ * writable.  Messages are kept whole, and written one per write(),
+ * so the framing is preserved; only when ESPINTCP is impaired, and
+ * the socket is a plain stream, can a message be part written.
+ *
+ * Once the queue passes the high-water mark, reading is paused: a
+ * peer that isn't reading the responses shouldn't be sending more
+ * requests.  Past the cap, messages are dropped.
+ */
+
+#define IKETCP_OUTPUT_HIGH_WATER (64 * 1024)
+#define IKETCP_OUTPUT_LOW_WATER (IKETCP_OUTPUT_HIGH_WATER / 2)
+#define IKETCP_OUTPUT_CAP (256 * 1024)
+
+struct iketcp_message {
+	struct iketcp_message *next;
+	size_t len;
+	size_t offset;		/* already written */
+	uint8_t ptr[];
+};
+
+struct iketcp_output {
+	struct iface_endpoint *ifp;	/* back pointer, no reference */
+	struct iketcp_message *head;
+	struct iketcp_message **tail;
+	size_t bytes;			/* not yet written */
+	size_t peak;
+	bool read_paused;
+	struct fd_write_listener *write_listener;
+};
+
+static void alloc_iketcp_output(struct iface_endpoint *ifp)
+{
+	passert(ifp->iketcp.output == NULL);
+	struct iketcp_output *output = alloc_thing(struct iketcp_output, "IKETCP output");
+	output->ifp = ifp;
+	output->tail = &output->head;
+	ifp->iketcp.output = output;
+}
+
+static unsigned discard_iketcp_output(struct iketcp_output *output)
+{
+	unsigned nr = 0;
+	while (output->head != NULL) {
+		struct iketcp_message *message = output->head;
+		output->head = message->next;
+		pfree(message);
+		nr++;
+	}
+	output->tail = &output->head;
+	output->bytes = 0;
+	return nr;
+}
+
+static void free_iketcp_output(struct iface_endpoint *ifp)
+{
+	struct iketcp_output *output = ifp->iketcp.output;
+	if (output == NULL) {
+		return;
+	}
+	detach_fd_write_listener(&output->write_listener);
+	size_t bytes = output->bytes;
+	unsigned nr = discard_iketcp_output(output);
+	dbg_iketcp(ifp, "freeing output; %u messages %zu bytes unwritten, peak %zu bytes",
+		   nr, bytes, output->peak);
+	pfree(output);
+	ifp->iketcp.output = NULL;
+}
+
+static ssize_t iketcp_write(const struct iface_endpoint *ifp,
+			    const struct iovec *iov, unsigned nr_iov,
+			    struct logger *logger)
+{
+	size_t len = 0;
+	for (unsigned i = 0; i < nr_iov; i++) {
+		len += iov[i].iov_len;
+	}
+
+	int flags = 0;
+	if (impair.tcp_use_blocking_write) {
+		llog_iketcp(RC_LOG, logger, ifp, /*no-error*/0,
+			    "IMPAIR: switching off NONBLOCK before write");
+		flags = fcntl(ifp->fd, F_GETFL, 0);
+		if (flags == -1) {
+			int e = errno;
+			llog_iketcp(RC_LOG_SERIOUS, logger, ifp, e,
+				    "fcntl(%d, F_GETFL, 0) failed: ", ifp->fd);
+		}
+		if (fcntl(ifp->fd, F_SETFL, flags & ~O_NONBLOCK) == -1) {
+			int e = errno;
+			llog_iketcp(RC_LOG_SERIOUS, logger, ifp, e,
+				    "fcntl(%d, F_SETFL, 0%o) failed,: ",
+				    ifp->fd, flags);
+		}
+	}
+	ssize_t wlen = writev(ifp->fd, iov, nr_iov);
+	int wlen_errno = errno; /* save!!! */
+	dbg_iketcp(ifp, "wrote %zd of %zu bytes", wlen, len);
+	if (impair.tcp_use_blocking_write && flags >= 0) {
+		llog_iketcp(RC_LOG, logger, ifp, /*no-error*/0,
+			    "IMPAIR: restoring flags 0%o after write", flags);
+		if (fcntl(ifp->fd, F_SETFL, flags) == -1) {
+			int e = errno;
+			llog_iketcp(RC_LOG_SERIOUS, logger, ifp, e,
+				    "fcntl(%d, F_SETFL, 0%o) failed: ",
+				    ifp->fd, flags);
+		}
+	}
+	errno = wlen_errno;
+	return wlen;
+}
+
+static void resume_iketcp_read(struct iketcp_output *output)
+{
+	struct iface_endpoint *ifp = output->ifp;
+	if (output->read_paused && output->bytes <= IKETCP_OUTPUT_LOW_WATER) {
+		dbg_iketcp(ifp, "output down to %zu bytes; resuming reads", output->bytes);
+		output->read_paused = false;
+		attach_fd_read_listener(&ifp->iketcp.read_listener, ifp->fd,
+					"IKETCP", process_iface_packet, ifp);
+	}
+}
+
+static bool pause_iketcp_read(struct iface_endpoint *ifp, struct logger *logger)
+{
+	struct iketcp_output *output = ifp->iketcp.output;
+	if (output->bytes < IKETCP_OUTPUT_HIGH_WATER) {
+		return false;
+	}
+	llog_iketcp(RC_LOG, logger, ifp, /*no-error*/0,
+		    "peer is not reading, %zu bytes unwritten; pausing reads",
+		    output->bytes);
+	stop_iketcp_read("output above high-water mark", ifp);
+	output->read_paused = true;
+	pstats_iketcp_paused[ifp->iketcp_server]++;
+	return true;
+}
+
+static void iketcp_output_cb(int fd UNUSED, void *arg, struct logger *global_logger)
+{
+	struct iketcp_output *output = arg;
+	struct iface_endpoint *ifp = output->ifp;
+	struct logger from_logger = logger_from(global_logger, &ifp->iketcp_remote_endpoint);
+	struct logger *logger = &from_logger;
+
+	while (output->head != NULL) {
+		struct iketcp_message *message = output->head;
+		struct iovec iov = {
+			.iov_base = message->ptr + message->offset,
+			.iov_len = message->len - message->offset,
+		};
+		ssize_t wlen = iketcp_write(ifp, &iov, 1, logger);
+		if (wlen < 0) {
+			int e = errno;
+			if (e == EAGAIN || e == EWOULDBLOCK) {
+				break;
+			}
+			/* the read side will see the error and shutdown */
+			llog_iketcp(RC_LOG, logger, ifp, e,
+				    "discarding %zu unwritten bytes; write failed: ",
+				    output->bytes);
+			discard_iketcp_output(output);
+			break;
+		}
+		message->offset += wlen;
+		output->bytes -= wlen;
+		if (message->offset < message->len) {
+			/* only when ESPINTCP is impaired */
+			break;
+		}
+		output->head = message->next;
+		if (output->head == NULL) {
+			output->tail = &output->head;
+		}
+		pfree(message);
+	}
+
+	if (output->head == NULL) {
+		dbg_iketcp(ifp, "output drained; stopping write event");
+		detach_fd_write_listener(&output->write_listener);
+	}
+	resume_iketcp_read(output);
+}
+
+static ssize_t queue_iketcp_message(const struct iface_endpoint *ifp,
+				    const struct outgoing_packet *packet, size_t offset,
+				    struct logger *logger)
+{
+	struct iketcp_output *output = ifp->iketcp.output;
+	size_t len = packet->len;
+	if (output->bytes + (len - offset) > IKETCP_OUTPUT_CAP) {
+		dbg_iketcp(ifp, "output full, %zu bytes unwritten; dropping %zu byte message",
+			   output->bytes, len);
+		pstats_iketcp_dropped[ifp->iketcp_server]++;
+		errno = ENOBUFS; /* caller logs */
+		return -1;
+	}
+
+	struct iketcp_message *message = over_alloc_thing(struct iketcp_message, len);
+	uint8_t *cursor = message->ptr;
+	for (unsigned i = 0; i < packet->nr_iov; i++) {
+		memcpy(cursor, packet->iov[i].iov_base, packet->iov[i].iov_len);
+		cursor += packet->iov[i].iov_len;
+	}
+	message->len = len;
+	message->offset = offset;
+	*output->tail = message;
+	output->tail = &message->next;
+	output->bytes += len - offset;
+	output->peak = max(output->peak, output->bytes);
+	pstats_iketcp_queued[ifp->iketcp_server]++;
+	dbg_iketcp(ifp, "queued %zu byte message; %zu bytes unwritten",
+		   len, output->bytes);
+
+	if (output->write_listener == NULL) {
+		attach_fd_write_listener(&output->write_listener, ifp->fd,
+					 "IKETCP output", iketcp_output_cb, output);
+	}
+	if (output->bytes >= IKETCP_OUTPUT_HIGH_WATER) {
+		llog_iketcp(RC_LOG, logger, ifp, /*no-error*/0,
+			    "output above high-water mark, %zu bytes unwritten",
+			    output->bytes);
+	}
+	return len;
+}
+
 static struct msg_digest *read_espintcp_packet(const char *what,
 					       struct iface_endpoint **ifp,
 					       struct logger *logger)
@@ -333,6 +577,9 @@ static struct msg_digest *iketcp_read_packet(struct iface_endpoint **ifp,
 	}
 
 	case IKETCP_ENABLED:
+		if (pause_iketcp_read(*ifp, logger)) {
+			return NULL;
+		}
 		return read_espintcp_packet("packet", ifp, logger);
 
 	case IKETCP_STOPPED:
@@ -358,40 +605,22 @@ static struct msg_digest *iketcp_read_packet(struct iface_endpoint **ifp,
 }
 
 static ssize_t iketcp_write_packet(const struct iface_endpoint *ifp,
-				   const void *ptr, size_t len,
+				   const struct outgoing_packet *packet,
 				   const ip_endpoint *remote_endpoint UNUSED,
 				   struct logger *logger)
 {
-	int flags = 0;
-	if (impair.tcp_use_blocking_write) {
-		llog_iketcp(RC_LOG, logger, ifp, /*no-error*/0,
-			    "IMPAIR: switching off NONBLOCK before write");
-		flags = fcntl(ifp->fd, F_GETFL, 0);
-		if (flags == -1) {
-			int e = errno;
-			llog_iketcp(RC_LOG_SERIOUS, logger, ifp, e,
-				    "fcntl(%d, F_GETFL, 0) failed: ", ifp->fd);
-		}
-		if (fcntl(ifp->fd, F_SETFL, flags & ~O_NONBLOCK) == -1) {
-			int e = errno;
-			llog_iketcp(RC_LOG_SERIOUS, logger, ifp, e,
-				    "fcntl(%d, F_SETFL, 0%o) failed,: ",
-				    ifp->fd, flags);
-		}
+	if (ifp->iketcp.output->head != NULL) {
+		/* keep the order */
+		return queue_iketcp_message(ifp, packet, /*offset*/0, logger);
 	}
-	ssize_t wlen = write(ifp->fd, ptr, len);
-	dbg_iketcp(ifp, "wrote %zd of %zu bytes", wlen, len);
-	if (impair.tcp_use_blocking_write && flags >= 0) {
-		llog_iketcp(RC_LOG, logger, ifp, /*no-error*/0,
-			    "IMPAIR: restoring flags 0%o after write", flags);
-		if (fcntl(ifp->fd, F_SETFL, flags) == -1) {
-			int e = errno;
-			llog_iketcp(RC_LOG_SERIOUS, logger, ifp, e,
-				    "fcntl(%d, F_SETFL, 0%o) failed: ",
-				    ifp->fd, flags);
-		}
+	ssize_t wlen = iketcp_write(ifp, packet->iov, packet->nr_iov, logger);
+	if (wlen == (ssize_t)packet->len) {
+		return wlen;
 	}
-	return wlen;
+	if (wlen < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+		return wlen; /* caller logs errno */
+	}
+	return queue_iketcp_message(ifp, packet, (wlen < 0 ? 0 : wlen), logger);
 }
 
 static void iketcp_cleanup(struct iface_endpoint *ifp)
@@ -412,6 +641,7 @@ static void iketcp_cleanup(struct iface_endpoint *ifp)
 		detach_fd_accept_listener(&ifp->iketcp.accept_listener);
 	}
 	stop_iketcp_timeout("cleaning up", ifp);
+	free_iketcp_output(ifp);
 }
 
 static void iketcp_server_timeout(void *arg, struct logger *global_logger)
@@ -567,6 +797,7 @@ struct iface_endpoint *connect_to_tcp_endpoint(struct iface_dev *local_dev,
 	ifp->iketcp_remote_endpoint = remote_endpoint;
 	ifp->iketcp_state = IKETCP_ENABLED;
 	ifp->iketcp_server = false;
+	alloc_iketcp_output(ifp);
 #if 0
 	/* private */
 	ifp->next = interfaces;
@@ -612,6 +843,7 @@ void accept_ike_in_tcp_cb(int accepted_fd, ip_sockaddr *sa,
 	ifp->iketcp_remote_endpoint = remote_tcp_endpoint;
 	ifp->iketcp_state = IKETCP_ACCEPTED;
 	ifp->iketcp_server = true;
+	alloc_iketcp_output(ifp);
 
 	struct logger from_logger = logger_from(logger, &remote_tcp_endpoint);
 	logger = &from_logger;
@@ -23,6 +23,8 @@
  * for more details.
  */
 
+#define _GNU_SOURCE	/* for sendmmsg() */
+
 #include <sys/types.h>
 #include <sys/socket.h>		/* MSG_ERRQUEUE if defined */
 #include <netinet/udp.h>
@@ -251,7 +253,7 @@ static struct msg_digest * udp_read_packet(struct iface_endpoint **ifpp,
 }
 
 static ssize_t udp_write_packet(const struct iface_endpoint *ifp,
-				const void *ptr, size_t len,
+				const struct outgoing_packet *packet,
 				const ip_endpoint *remote_endpoint,
 				struct logger *logger /*possibly*/UNUSED)
 {
@@ -262,9 +264,54 @@ static ssize_t udp_write_packet(const struct iface_endpoint *ifp,
 #endif
 
 	ip_sockaddr remote_sa = sockaddr_from_endpoint(*remote_endpoint);
-	return sendto(ifp->fd, ptr, len, 0, &remote_sa.sa.sa, remote_sa.len);
+	struct msghdr msg = {
+		.msg_name = &remote_sa.sa.sa,
+		.msg_namelen = remote_sa.len,
+		/* sendmsg() doesn't modify the iovec */
+		.msg_iov = (struct iovec *)packet->iov,
+		.msg_iovlen = packet->nr_iov,
+	};
+	return sendmsg(ifp->fd, &msg, 0);
 };
 
+#ifdef MSG_WAITFORONE /* i.e., has sendmmsg() */
+
+/*
+ * A burst of fragments, say, in one sendmmsg().
+ */
+
+#define UDP_WRITE_PACKETS 16
+
+static int udp_write_packets(const struct iface_endpoint *ifp,
+			     const struct outgoing_packet *packets,
+			     unsigned nr_packets,
+			     const ip_endpoint *remote_endpoint,
+			     struct logger *logger /*possibly*/UNUSED)
+{
+#ifdef MSG_ERRQUEUE
+	if (pluto_sock_errqueue) {
+		check_msg_errqueue(ifp, POLLOUT, __func__, logger);
+	}
+#endif
+
+	ip_sockaddr remote_sa = sockaddr_from_endpoint(*remote_endpoint);
+	struct mmsghdr msgs[UDP_WRITE_PACKETS];
+	nr_packets = min(nr_packets, (unsigned)elemsof(msgs));
+	for (unsigned i = 0; i < nr_packets; i++) {
+		msgs[i] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_name = &remote_sa.sa.sa,
+				.msg_namelen = remote_sa.len,
+				.msg_iov = (struct iovec *)packets[i].iov,
+				.msg_iovlen = packets[i].nr_iov,
+			},
+		};
+	}
+	return sendmmsg(ifp->fd, msgs, nr_packets, 0);
+}
+
+#endif
+
 static void udp_listen(struct iface_endpoint *ifp,
 		       struct logger *unused_logger UNUSED)
 {
@@ -288,6 +335,9 @@ const struct iface_io udp_iface_io = {
 	.protocol = &ip_protocol_udp,
 	.read_packet = udp_read_packet,
 	.write_packet = udp_write_packet,
+#ifdef MSG_WAITFORONE
+	.write_packets = udp_write_packets,
+#endif
 	.listen = udp_listen,
 #ifdef UDP_ENCAP
 	.enable_esp_encap = nat_traversal_espinudp,
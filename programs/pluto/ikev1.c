@@ -172,6 +172,7 @@
 #endif
 
 #include "pluto_stats.h"
+#include "hash_table.h"		/* for hash_bytes() */
 
 /*
  * state_v1_microcode is a tuple of information parameterizing certain
@@ -1085,6 +1086,82 @@ static bool ikev1_duplicate(struct state *st, struct msg_digest *md)
 	return false;
 }
 
+/*
+ * Recently received packets, by digest.
+ *
+ * A retransmitted request is normally only recognized as a duplicate
+ * after the state has been found, the message ID checked and
+ * (depending on the exchange) an IV computed.  Remember, for the
+ * last few hundred packets that completed a transition, which state
+ * recorded them so that a retransmit can be matched and answered
+ * before any of that.
+ *
+ * The digest covers the length, the ISAKMP header (cookies, message
+ * ID) and the first few bytes of the body; a hit is confirmed by
+ * ikev1_duplicate() comparing the entire packet against
+ * .st_v1_rpacket so a stale or colliding slot just falls through.
+ *
+ * Only states whose message ID is the packet's (Main, Aggressive and
+ * Quick Mode) are remembered; Informational and Mode Config
+ * exchanges arrive on the ISAKMP SA and get the full treatment.
+ */
+
+#define V1_RECENT_PACKETS 512
+#define V1_RECENT_DIGEST_BYTES ((size_t)NSIZEOF_isakmp_hdr + 64)
+
+static struct v1_recent_packet {
+	hash_t digest;
+	size_t len;
+	so_serial_t serialno;	/* SOS_NOBODY is empty */
+} v1_recent_packets[V1_RECENT_PACKETS];
+
+static hash_t v1_packet_digest(shunk_t packet)
+{
+	hash_t digest = hash_thing(packet.len, zero_hash);
+	return hash_bytes(packet.ptr, min(packet.len, V1_RECENT_DIGEST_BYTES), digest);
+}
+
+static void remember_recent_v1_packet(const struct state *st, shunk_t packet,
+				      msgid_t msgid)
+{
+	if (st->st_v1_msgid.id != msgid) {
+		return;
+	}
+	hash_t digest = v1_packet_digest(packet);
+	struct v1_recent_packet *slot =
+		&v1_recent_packets[digest.hash % V1_RECENT_PACKETS];
+	*slot = (struct v1_recent_packet) {
+		.digest = digest,
+		.len = packet.len,
+		.serialno = st->st_serialno,
+	};
+}
+
+static bool ikev1_recent_duplicate(struct msg_digest *md)
+{
+	shunk_t packet = pbs_in_all_as_shunk(&md->packet_pbs);
+	hash_t digest = v1_packet_digest(packet);
+	const struct v1_recent_packet *slot =
+		&v1_recent_packets[digest.hash % V1_RECENT_PACKETS];
+	if (slot->serialno == SOS_NOBODY ||
+	    slot->digest.hash != digest.hash ||
+	    slot->len != packet.len) {
+		return false;
+	}
+	struct state *st = state_by_serialno(slot->serialno);
+	if (st == NULL ||
+	    st->st_v1_msgid.id != md->hdr.isa_msgid ||
+	    /* let the slow path report that it is busy */
+	    state_is_busy(st)) {
+		return false;
+	}
+	if (!ikev1_duplicate(st, md)) {
+		return false;
+	}
+	pstats_ikev1_recent_duplicates++;
+	return true;
+}
+
 /* process an input packet, possibly generating a reply.
  *
  * If all goes well, this routine eventually calls a state-specific
@@ -1115,6 +1192,14 @@ void process_v1_packet(struct msg_digest *md)
 #define LOG_PACKET(RC, ...) llog(RC, LOGGER, __VA_ARGS__)
 #define LOG_PACKET_JAMBUF(RC_FLAGS, BUF) LLOG_JAMBUF(RC_FLAGS, LOGGER, BUF)
 
+	/*
+	 * A retransmit of a packet that already completed a
+	 * transition?  Answer it from the recorded reply.
+	 */
+	if (ikev1_recent_duplicate(md)) {
+		return;
+	}
+
 	switch (md->hdr.isa_xchg) {
 	case ISAKMP_XCHG_AGGR:
 	case ISAKMP_XCHG_IDPROT: /* part of a Main Mode exchange */
@@ -2297,6 +2382,8 @@ static void remember_received_packet(struct state *st, struct msg_digest *md)
 					     pbs_room(&md->packet_pbs),
 					     "raw packet"));
 	}
+	remember_recent_v1_packet(st, HUNK_AS_SHUNK(st->st_v1_rpacket),
+				  md->hdr.isa_msgid);
 }
 
 static void jam_v1_ipsec_details(struct jambuf *buf, struct state *st)
@@ -54,12 +54,24 @@ extern void aggr_outI1(struct fd *whack_sock,
 
 extern void send_v1_delete(struct state *st);
 
-struct hash_signature v1_sign_hash_RSA(const struct connection *c,
-				       const struct crypt_mac *hash,
-				       struct logger *logger);
-
 struct crypt_mac main_mode_hash(struct state *st, enum sa_role role,
 				const pb_stream *idpl);  /* ID payload, as PBS; cur must be at end */
+bool main_mode_local_id_hash(struct state *st, enum sa_role role,
+			     struct crypt_mac *hash);
+
+/*
+ * With RSA, sign main_mode_local_id_hash() on a helper thread, return
+ * STF_SUSPEND, and then resume in CB with the signature.  With PSK
+ * there is nothing to sign and CB is called immediately with a NULL
+ * SIG.  See ikev1_auth_helper.c.
+ */
+struct hash_signature;
+typedef stf_status (v1_signature_cb)(struct state *st,
+				     struct msg_digest *md,
+				     const struct hash_signature *sig);
+stf_status submit_v1_id_signature(struct state *st, struct msg_digest *md,
+				  enum sa_role role, v1_signature_cb *cb,
+				  where_t where);
 
 void doi_log_cert_thinking(uint16_t auth,
 			   enum ike_cert_type certtype,
@@ -73,7 +73,11 @@
  * Called by:
  *	aggr_inI1_outR1_continue1: ke(aggr_inI1_outR1)
  *	aggr_inI1_outR1_continue2: dh(aggr_inI1_outR1_continue1)
- *	aggr_inI1_outR1_tail: aggr_inI1_outR1_continue2
+ *	aggr_outR1: signature(aggr_inI1_outR1_continue2)
+ *	aggr_inR1_outI2_crypto_continue: dh(aggr_inR1_outI2)
+ *	aggr_inR1_outI2_auth_continue: authsig(aggr_inR1_outI2_crypto_continue)
+ *	aggr_outI2: signature(aggr_inR1_outI2_auth_continue)
+ *	aggr_inI2_continue: authsig(aggr_inI2)
  */
 
 /*
@@ -81,6 +85,7 @@
  */
 
 static dh_shared_secret_cb aggr_inI1_outR1_continue2;	/* type assertion */
+static v1_signature_cb aggr_outR1;			/* type assertion */
 
 /*
  * for aggressive mode, this is sub-optimal, since we should have
@@ -282,6 +287,30 @@ static stf_status aggr_inI1_outR1_continue2(struct state *st,
 	    st->st_serialno);
 	passert(md != NULL);
 
+	if (st->st_dh_shared_secret == NULL) {
+		return STF_FAIL_v1N + v1N_INVALID_KEY_INFORMATION;
+	}
+	calc_v1_skeyid_and_iv(st);
+
+	/* decode certificate requests */
+	decode_v1_certificate_requests(st, md);
+
+	/*
+	 * The first parse_isakmp_sa_body() call, in aggr_inI1_outR1(),
+	 * chose the authentication method so HASH_R can be computed
+	 * now.
+	 */
+	return submit_v1_id_signature(st, md, SA_RESPONDER, aggr_outR1, HERE);
+}
+
+/*
+ * SIG is the signature over our HASH_R computed by the helper; NULL
+ * with PSK.
+ */
+
+static stf_status aggr_outR1(struct state *st, struct msg_digest *md,
+			     const struct hash_signature *sig)
+{
 	const struct connection *c = st->st_connection;
 	struct payload_digest *const sa_pd = md->chain[ISAKMP_NEXT_SA];
 	const struct cert *mycert = c->local->config->host.cert.nss_cert != NULL ? &c->local->config->host.cert : NULL;
@@ -290,13 +319,6 @@ static stf_status aggr_inI1_outR1_continue2(struct state *st,
 	 * so we have to build our reply_stream and emit HDR before calling it.
 	 */
 
-	if (st->st_dh_shared_secret == NULL) {
-		return STF_FAIL_v1N + v1N_INVALID_KEY_INFORMATION;
-	}
-	calc_v1_skeyid_and_iv(st);
-
-	/* decode certificate requests */
-	decode_v1_certificate_requests(st, md);
 	bool cert_requested = (st->st_v1_requested_ca != NULL);
 
 	/*
@@ -454,10 +476,9 @@ static stf_status aggr_inI1_outR1_continue2(struct state *st,
 
 	/* HASH_R or SIG_R out */
 	{
-		struct crypt_mac hash = main_mode_hash(st, SA_RESPONDER, &r_id_pbs);
-
 		if (auth_payload == ISAKMP_NEXT_HASH) {
 			/* HASH_R out */
+			struct crypt_mac hash = main_mode_hash(st, SA_RESPONDER, &r_id_pbs);
 			if (!ikev1_out_generic_raw(&isakmp_hash_desc,
 					     &rbody,
 					     hash.ptr,
@@ -466,15 +487,9 @@ static stf_status aggr_inI1_outR1_continue2(struct state *st,
 				return STF_INTERNAL_ERROR;
 		} else {
 			/* SIG_R out */
-			struct hash_signature sig = v1_sign_hash_RSA(c, &hash,
-								     st->st_logger);
-			if (sig.len == 0) {
-				/* already logged */
-				return STF_FAIL_v1N + v1N_AUTHENTICATION_FAILED;
-			}
-
+			passert(sig != NULL);
 			if (!ikev1_out_generic_raw(&isakmp_signature_desc,
-					     &rbody, sig.ptr, sig.len,
+					     &rbody, sig->ptr, sig->len,
 					     "SIG_R"))
 				return STF_INTERNAL_ERROR;
 		}
@@ -508,6 +523,8 @@ static stf_status aggr_inI1_outR1_continue2(struct state *st,
  *           --> HDR*, [CERT,] SIG_I
  */
 static dh_shared_secret_cb aggr_inR1_outI2_crypto_continue;	/* forward decl and type assertion */
+static oakley_auth_cb aggr_inR1_outI2_auth_continue;	/* forward decl and type assertion */
+static v1_signature_cb aggr_outI2;			/* forward decl and type assertion */
 
 stf_status aggr_inR1_outI2(struct state *st, struct msg_digest *md)
 {
@@ -590,8 +607,6 @@ static stf_status aggr_inR1_outI2_crypto_continue(struct state *st,
 {
 	dbg("aggr inR1_outI2: calculated DH, sending I2");
 
-	struct connection *c = st->st_connection;
-
 	passert(st != NULL);
 	passert(md != NULL);
 	passert(md->v1_st == st);
@@ -603,11 +618,24 @@ static stf_status aggr_inR1_outI2_crypto_continue(struct state *st,
 
 	/* HASH_R or SIG_R in */
 
-	stf_status r = oakley_auth(md, true);
-	if (r != STF_OK) {
-		return r;
-	}
+	return oakley_auth(md, true, aggr_inR1_outI2_auth_continue);
+}
+
+static stf_status aggr_inR1_outI2_auth_continue(struct state *st,
+						struct msg_digest *md)
+{
+	return submit_v1_id_signature(st, md, SA_INITIATOR, aggr_outI2, HERE);
+}
 
+/*
+ * SIG is the signature over our HASH_I computed by the helper; NULL
+ * with PSK.
+ */
+
+static stf_status aggr_outI2(struct state *st, struct msg_digest *md,
+			     const struct hash_signature *sig)
+{
+	struct connection *c = st->st_connection;
 	const struct cert *mycert = c->local->config->host.cert.nss_cert != NULL ? &c->local->config->host.cert : NULL;
 
 	enum next_payload_types_ikev1 auth_payload =
@@ -714,41 +742,20 @@ static stf_status aggr_inR1_outI2_crypto_continue(struct state *st,
 
 	/* HASH_I or SIG_I out */
 	{
-		dbg("next payload chain: creating a fake payload for hashing identity");
-
-		/* first build an ID payload as a raw material */
-		shunk_t id_b;
-		struct isakmp_ipsec_id id_hd = build_v1_id_payload(&c->spd.this, &id_b);
-
-		uint8_t idbuf[1024]; /* fits all possible identity payloads? */
-		struct pbs_out id_pbs = open_pbs_out("identity payload", idbuf, sizeof(idbuf), st->st_logger);
-		pb_stream r_id_pbs;
-		if (!out_struct(&id_hd, &isakmp_ipsec_identification_desc,
-				&id_pbs, &r_id_pbs) ||
-		    !out_hunk(id_b, &r_id_pbs, "my identity")) {
-			return STF_INTERNAL_ERROR;
-		}
-		close_output_pbs(&r_id_pbs);
-		close_output_pbs(&id_pbs);
-
-		struct crypt_mac hash = main_mode_hash(st, SA_INITIATOR, &id_pbs);
-
 		if (auth_payload == ISAKMP_NEXT_HASH) {
-			/* HASH_I out */
+			/* HASH_I out; IDii isn't sent, hash a fake payload */
+			struct crypt_mac hash;
+			if (!main_mode_local_id_hash(st, SA_INITIATOR, &hash)) {
+				return STF_INTERNAL_ERROR;
+			}
 			if (!ikev1_out_generic_raw(&isakmp_hash_desc, &rbody,
 					     hash.ptr, hash.len, "HASH_I"))
 				return STF_INTERNAL_ERROR;
 		} else {
 			/* SIG_I out */
-			struct hash_signature sig = v1_sign_hash_RSA(st->st_connection, &hash,
-								     st->st_logger);
-			if (sig.len == 0) {
-				/* already logged */
-				return STF_FAIL_v1N + v1N_AUTHENTICATION_FAILED;
-			}
-
+			passert(sig != NULL);
 			if (!ikev1_out_generic_raw(&isakmp_signature_desc,
-					     &rbody, sig.ptr, sig.len,
+					     &rbody, sig->ptr, sig->len,
 					     "SIG_I"))
 				return STF_INTERNAL_ERROR;
 		}
@@ -814,6 +821,8 @@ static stf_status aggr_inR1_outI2_crypto_continue(struct state *st,
  * SMF_DS_AUTH:  HDR*, SIG_I  --> done
  */
 
+static oakley_auth_cb aggr_inI2_continue;	/* type assertion */
+
 stf_status aggr_inI2(struct state *st, struct msg_digest *md)
 {
 	struct connection *c = st->st_connection;
@@ -900,16 +909,26 @@ stf_status aggr_inI2(struct state *st, struct msg_digest *md)
 
 	passert(c == st->st_connection); /* no switch */
 
-	/* HASH_I or SIG_I in */
+	/*
+	 * HASH_I or SIG_I in.
+	 *
+	 * The hash over the private ID payload is computed before
+	 * oakley_auth() returns, even when the signature check is
+	 * suspended.
+	 */
 
-	stf_status r = oakley_auth(md, false);
-	if (r != STF_OK) {
-		return r;
-	}
+	stf_status r = oakley_auth(md, false, aggr_inI2_continue);
 
 	/* And reset the md to not leave stale pointers to our private id payload */
 	md->chain[ISAKMP_NEXT_ID] = save_id;
 
+	return r;
+}
+
+static stf_status aggr_inI2_continue(struct state *st, struct msg_digest *md UNUSED)
+{
+	struct connection *c = st->st_connection;
+
 	/**************** done input ****************/
 
 	/* It seems as per Cisco implementation, XAUTH and MODECFG
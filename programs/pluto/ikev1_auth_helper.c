@@ -0,0 +1,196 @@
+/* IKEv1 Phase 1 signature helper, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ */
+
+/*
+ * Main and Aggressive Mode SIG_I/SIG_R, both generating ours and
+ * checking the peer's, using the helper threads.
+ *
+ * Same pattern as ikev2_auth_helper.c: the state transition submits
+ * the task and returns STF_SUSPEND; the task's completed callback
+ * resumes the transition with the result.  IKEv1 signatures are
+ * always RSA PKCS#1 1.5 over a SHA-1 sized PRF output.
+ */
+
+#include "crypt_mac.h"
+
+#include "defs.h"
+#include "state.h"
+#include "connections.h"
+#include "keys.h"
+#include "secrets.h"
+#include "demux.h"
+#include "log.h"
+#include "server_pool.h"
+#include "ike_alg_hash.h"
+#include "ikev1.h"
+#include "ikev1_peer_id.h"
+
+/*
+ * One task type for both directions; only the fields for the
+ * handler in use are set.
+ */
+
+struct task {
+	/* sign: in */
+	struct crypt_mac hash_to_sign;
+	const struct secret_stuff *pks;
+	v1_signature_cb *signature_cb;
+	/* sign: out */
+	struct hash_signature signature;
+	/* check: in/out */
+	struct authsig *authsig;
+	bool initiator;
+	oakley_auth_cb *authsig_cb;
+};
+
+static task_cleanup_cb v1_auth_cleanup; /* type check */
+
+static void v1_auth_cleanup(struct task **task)
+{
+	free_authsig(&(*task)->authsig);
+	pfreeany(*task);
+}
+
+/*
+ * Generate our signature.
+ */
+
+static task_computer_fn v1_signature_computer; /* type check */
+static task_completed_cb v1_signature_completed; /* type check */
+
+static const struct task_handler v1_signature_handler = {
+	.name = "IKEv1 signature",
+	.computer_fn = v1_signature_computer,
+	.completed_cb = v1_signature_completed,
+	.cleanup_cb = v1_auth_cleanup,
+};
+
+stf_status submit_v1_id_signature(struct state *st, struct msg_digest *md,
+				  enum sa_role role, v1_signature_cb *cb,
+				  where_t where)
+{
+	if (st->st_oakley.auth != OAKLEY_RSA_SIG) {
+		/* HASH_I/HASH_R is computed when the packet is built */
+		return cb(st, md, NULL);
+	}
+
+	struct task task = {
+		.signature_cb = cb,
+		.pks = get_local_private_key(st->st_connection, &pubkey_type_rsa,
+					     st->st_logger),
+	};
+
+	if (task.pks == NULL) {
+		llog(RC_LOG_SERIOUS, st->st_logger,
+		     "unable to locate my private key for RSA Signature");
+		return STF_FAIL_v1N + v1N_AUTHENTICATION_FAILED;
+	}
+
+	if (!main_mode_local_id_hash(st, role, &task.hash_to_sign)) {
+		return STF_INTERNAL_ERROR;
+	}
+
+	submit_task(st->st_logger, st /*state to resume*/,
+		    clone_thing(task, "IKEv1 signature task"),
+		    &v1_signature_handler, where);
+	return STF_SUSPEND;
+}
+
+static void v1_signature_computer(struct logger *logger, struct task *task,
+				  int unused_my_thread UNUSED)
+{
+	logtime_t start = logtime_start(logger);
+	if (DBGP(DBG_BASE)) {
+		DBG_dump_hunk("hash to sign", task->hash_to_sign);
+	}
+	task->signature = pubkey_signer_raw_rsa.sign_hash(task->pks,
+							  task->hash_to_sign.ptr,
+							  task->hash_to_sign.len,
+							  &ike_alg_hash_sha1, logger);
+	passert(task->signature.len <= sizeof(task->signature.ptr/*array*/));
+	logtime_stop(&start, "%s()", __func__);
+}
+
+static stf_status v1_signature_completed(struct state *st,
+					 struct msg_digest *md,
+					 struct task *task)
+{
+	if (task->signature.len == 0) {
+		/* already logged */
+		return STF_FAIL_v1N + v1N_AUTHENTICATION_FAILED;
+	}
+	return task->signature_cb(st, md, &task->signature);
+}
+
+/*
+ * Check the peer's signature.
+ *
+ * The candidate keys are collected up front, on the main thread,
+ * since the certificate and key databases are not thread safe; the
+ * helper only does the RSA operations.
+ */
+
+static task_computer_fn v1_authsig_computer; /* type check */
+static task_completed_cb v1_authsig_completed; /* type check */
+
+static const struct task_handler v1_authsig_handler = {
+	.name = "IKEv1 signature check",
+	.computer_fn = v1_authsig_computer,
+	.completed_cb = v1_authsig_completed,
+	.cleanup_cb = v1_auth_cleanup,
+};
+
+stf_status submit_v1_authsig(struct ike_sa *ike,
+			     const struct crypt_mac *hash,
+			     shunk_t signature,
+			     bool initiator,
+			     oakley_auth_cb *cb,
+			     where_t where)
+{
+	struct task task = {
+		.initiator = initiator,
+		.authsig_cb = cb,
+		.authsig = start_authsig(ike, hash, signature,
+					 &ike_alg_hash_sha1, /*always*/
+					 &pubkey_signer_raw_rsa),
+	};
+	submit_task(ike->sa.st_logger, &ike->sa /*state to resume*/,
+		    clone_thing(task, "IKEv1 signature check task"),
+		    &v1_authsig_handler, where);
+	return STF_SUSPEND;
+}
+
+static void v1_authsig_computer(struct logger *logger, struct task *task,
+				int unused_my_thread UNUSED)
+{
+	try_authsig(task->authsig, logger);
+}
+
+static stf_status v1_authsig_completed(struct state *st,
+				       struct msg_digest *md,
+				       struct task *task)
+{
+	diag_t d = finish_authsig(pexpect_ike_sa(st), &task->authsig,
+				  NULL/*legacy-signature-name*/);
+	if (d != NULL) {
+		llog_diag(RC_LOG_SERIOUS, st->st_logger, &d, "%s", "");
+		dbg("received message SIG_%s data did not match computed value",
+		    task->initiator ? "R" : "I" /*reverse*/);
+		return STF_FAIL_v1N + v1N_INVALID_KEY_INFORMATION;
+	}
+	dbg("authentication succeeded");
+	return task->authsig_cb(st, md);
+}
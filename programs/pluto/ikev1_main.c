@@ -289,28 +289,32 @@ struct crypt_mac main_mode_hash(struct state *st,
 }
 
 /*
- * Create an RSA signature of a hash.
- * Poorly specified in draft-ietf-ipsec-ike-01.txt 6.1.1.2.
- * Use PKCS#1 version 1.5 encryption of hash (called
- * RSAES-PKCS1-V1_5) in PKCS#2.
- * Returns 0 on failure.
+ * Compute our own HASH_I or HASH_R, the value that gets signed,
+ * before the packet is built: emit the ID payload into a scratch
+ * buffer.  build_v1_id_payload() produces the same bytes each time
+ * so this matches main_mode_hash() of the ID payload that is later
+ * put on the wire.
  */
 
-struct hash_signature v1_sign_hash_RSA(const struct connection *c,
-				       const struct crypt_mac *hash,
-				       struct logger *logger)
+bool main_mode_local_id_hash(struct state *st, enum sa_role role,
+			     struct crypt_mac *hash)
 {
-	const struct secret_stuff *pks = get_local_private_key(c, &pubkey_type_rsa,
-								    logger);
-	if (pks == NULL) {
-		llog(RC_LOG_SERIOUS, logger,
-			    "unable to locate my private key for RSA Signature");
-		return (struct hash_signature) { .len = 0, }; /* failure: no key to use */
+	shunk_t id_b;
+	struct isakmp_ipsec_id id_hd = build_v1_id_payload(&st->st_connection->spd.this, &id_b);
+
+	uint8_t idbuf[1024]; /* fits all possible identity payloads? */
+	struct pbs_out id_pbs = open_pbs_out("identity payload", idbuf, sizeof(idbuf), st->st_logger);
+	struct pbs_out r_id_pbs;
+	if (!out_struct(&id_hd, &isakmp_ipsec_identification_desc,
+			&id_pbs, &r_id_pbs) ||
+	    !out_hunk(id_b, &r_id_pbs, "my identity")) {
+		return false;
 	}
+	close_output_pbs(&r_id_pbs);
+	close_output_pbs(&id_pbs);
 
-	struct hash_signature sig = pubkey_signer_raw_rsa.sign_hash(pks, hash->ptr, hash->len,
-								    &ike_alg_hash_sha1, logger);
-	return sig;
+	*hash = main_mode_hash(st, role, &id_pbs);
+	return true;
 }
 
 /*
@@ -881,6 +885,7 @@ static stf_status main_inI2_outR2_continue1(struct state *st,
  */
 
 static dh_shared_secret_cb main_inR2_outI3_continue;	/* type assertion */
+static v1_signature_cb main_outI3;			/* type assertion */
 
 stf_status main_inR2_outI3(struct state *st, struct msg_digest *md)
 {
@@ -928,6 +933,28 @@ static stf_status main_inR2_outI3_continue(struct state *st,
 
 	calc_v1_skeyid_and_iv(st);
 
+	/* decode certificate requests */
+	decode_v1_certificate_requests(st, md);
+
+	/* done parsing; initialize crypto */
+
+	ikev1_natd_init(st, md);
+
+	return submit_v1_id_signature(st, md, SA_INITIATOR, main_outI3, HERE);
+}
+
+/*
+ * Build output packet HDR*;IDii;HASH/SIG_I
+ *
+ * SIG is the signature over our HASH_I computed by the helper; NULL
+ * with PSK.
+ *
+ * ??? NOTE: this is almost the same as main_inI3_outR3's code
+ */
+
+static stf_status main_outI3(struct state *st, struct msg_digest *md,
+			     const struct hash_signature *sig)
+{
 	struct pbs_out rbody[1]; /* hack */
 	ikev1_init_pbs_out_from_md_hdr(md, true,
 				       &reply_stream, reply_buffer, sizeof(reply_buffer),
@@ -936,8 +963,6 @@ static stf_status main_inR2_outI3_continue(struct state *st,
 	const struct connection *c = st->st_connection;
 	const struct cert *mycert = c->local->config->host.cert.nss_cert != NULL ? &c->local->config->host.cert : NULL;
 
-	/* decode certificate requests */
-	decode_v1_certificate_requests(st, md);
 	bool cert_requested = (st->st_v1_requested_ca != NULL);
 
 	/*
@@ -1000,16 +1025,6 @@ static stf_status main_inR2_outI3_continue(struct state *st,
 	dbg("I will %ssend an initial contact payload",
 	    initial_contact ? "" : "NOT ");
 
-	/* done parsing; initialize crypto */
-
-	ikev1_natd_init(st, md);
-
-	/*
-	 * Build output packet HDR*;IDii;HASH/SIG_I
-	 *
-	 * ??? NOTE: this is almost the same as main_inI3_outR3's code
-	 */
-
 	/* HDR* out done */
 
 	/* IDii out */
@@ -1088,26 +1103,19 @@ static stf_status main_inR2_outI3_continue(struct state *st,
 
 	/* HASH_I or SIG_I out */
 	{
-		struct crypt_mac hash = main_mode_hash(st, SA_INITIATOR, &id_pbs);
-
 		if (auth_payload == ISAKMP_NEXT_HASH) {
 			/* HASH_I out */
+			struct crypt_mac hash = main_mode_hash(st, SA_INITIATOR, &id_pbs);
 			if (!ikev1_out_generic_raw(&isakmp_hash_desc,
 						   rbody,
 						   hash.ptr, hash.len, "HASH_I"))
 				return STF_INTERNAL_ERROR;
 		} else {
 			/* SIG_I out */
-			struct hash_signature sig;
-			sig = v1_sign_hash_RSA(c, &hash, st->st_logger);
-			if (sig.len == 0) {
-				/* already logged */
-				return STF_FAIL_v1N + v1N_AUTHENTICATION_FAILED;
-			}
-
+			passert(sig != NULL);
 			if (!ikev1_out_generic_raw(&isakmp_signature_desc,
 						   rbody,
-						   sig.ptr, sig.len,
+						   sig->ptr, sig->len,
 						   "SIG_I"))
 				return STF_INTERNAL_ERROR;
 		}
@@ -1155,6 +1163,9 @@ static stf_status main_inR2_outI3_continue(struct state *st,
  * PKE_AUTH, RPKE_AUTH: HDR*, HASH_I --> HDR*, HASH_R
  */
 
+static oakley_auth_cb main_inI3_outR3_continue;	/* type assertion */
+static v1_signature_cb main_outR3;		/* type assertion */
+
 stf_status main_inI3_outR3(struct state *st, struct msg_digest *md)
 {
 	pexpect(st == md->v1_st);
@@ -1183,11 +1194,23 @@ stf_status main_inI3_outR3(struct state *st, struct msg_digest *md)
 
 	/* HASH_I or SIG_I */
 
-	stf_status r = oakley_auth(md, false);
-	if (r != STF_OK) {
-		return r;
-	}
+	return oakley_auth(md, false, main_inI3_outR3_continue);
+}
+
+static stf_status main_inI3_outR3_continue(struct state *st,
+					   struct msg_digest *md)
+{
+	return submit_v1_id_signature(st, md, SA_RESPONDER, main_outR3, HERE);
+}
+
+/*
+ * SIG is the signature over our HASH_R computed by the helper; NULL
+ * with PSK.
+ */
 
+static stf_status main_outR3(struct state *st, struct msg_digest *md,
+			     const struct hash_signature *sig)
+{
 	struct connection *c = st->st_connection; /* may have changed */
 
 	/* send certificate if we have one and auth is RSA */
@@ -1304,24 +1327,17 @@ stf_status main_inI3_outR3(struct state *st, struct msg_digest *md)
 
 	/* HASH_R or SIG_R out */
 	{
-		struct crypt_mac hash = main_mode_hash(st, SA_RESPONDER, &r_id_pbs);
-
 		if (auth_payload == ISAKMP_NEXT_HASH) {
 			/* HASH_R out */
+			struct crypt_mac hash = main_mode_hash(st, SA_RESPONDER, &r_id_pbs);
 			if (!ikev1_out_generic_raw(&isakmp_hash_desc, &rbody,
 						   hash.ptr, hash.len, "HASH_R"))
 				return STF_INTERNAL_ERROR;
 		} else {
 			/* SIG_R out */
-			struct hash_signature sig;
-			sig = v1_sign_hash_RSA(c, &hash, st->st_logger);
-			if (sig.len == 0) {
-				/* already logged */
-				return STF_FAIL_v1N + v1N_AUTHENTICATION_FAILED;
-			}
-
+			passert(sig != NULL);
 			if (!ikev1_out_generic_raw(&isakmp_signature_desc,
-						   &rbody, sig.ptr, sig.len,
+						   &rbody, sig->ptr, sig->len,
 						   "SIG_R"))
 				return STF_INTERNAL_ERROR;
 		}
@@ -1375,6 +1391,8 @@ stf_status main_inI3_outR3(struct state *st, struct msg_digest *md)
  *
  */
 
+static oakley_auth_cb main_inR3_continue;	/* type assertion */
+
 stf_status main_inR3(struct state *st, struct msg_digest *md)
 {
 	if (!v1_decode_certs(md)) {
@@ -1400,10 +1418,12 @@ stf_status main_inR3(struct state *st, struct msg_digest *md)
 
 	/* HASH_R or SIG_R */
 
-	stf_status r = oakley_auth(md, true);
-	if (r != STF_OK) {
-		return r;
-	}
+	return oakley_auth(md, true, main_inR3_continue);
+}
+
+static stf_status main_inR3_continue(struct state *st, struct msg_digest *md UNUSED)
+{
+	struct connection *c = st->st_connection;
 
 	/* Done input */
 
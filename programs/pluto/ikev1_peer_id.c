@@ -225,8 +225,13 @@ static bool decode_peer_id(struct state *st, struct msg_digest *md, struct id *p
  * Process the Main Mode ID Payload and the Authenticator
  * (Hash or Signature Payload).
  * XXX: This is used by aggressive mode too, move to ikev1.c ???
+ *
+ * When the authenticator checks out, continue with CB.  A signature
+ * is checked on a helper thread, see ikev1_auth_helper.c, so this
+ * returns STF_SUSPEND and CB is called later.
  */
-stf_status oakley_auth(struct msg_digest *md, bool initiator)
+stf_status oakley_auth(struct msg_digest *md, bool initiator,
+		       oakley_auth_cb *cb)
 {
 	struct state *st = md->v1_st;
 	stf_status r = STF_OK;
@@ -279,25 +284,18 @@ stf_status oakley_auth(struct msg_digest *md, bool initiator)
 	case OAKLEY_RSA_SIG:
 	{
 		shunk_t signature = pbs_in_left_as_shunk(&md->chain[ISAKMP_NEXT_SIG]->pbs);
-		diag_t d = authsig_and_log_using_pubkey(ike_sa(st, HERE),
-							&hash, signature,
-							&ike_alg_hash_sha1, /*always*/
-							&pubkey_signer_raw_rsa,
-							NULL/*legacy-signature-name*/);
-		if (d != NULL) {
-			llog_diag(RC_LOG_SERIOUS, st->st_logger, &d, "%s", "");
-			dbg("received message SIG_%s data did not match computed value",
-			    initiator ? "R" : "I" /*reverse*/);
-			r = STF_FAIL_v1N + v1N_INVALID_KEY_INFORMATION;
-		}
-		break;
+		return submit_v1_authsig(ike_sa(st, HERE), &hash, signature,
+					 initiator, cb, HERE);
 	}
 	/* These are the only IKEv1 AUTH methods we support */
 	default:
 		bad_case(st->st_oakley.auth);
 	}
 
-	if (r == STF_OK)
-		dbg("authentication succeeded");
-	return r;
+	if (r != STF_OK) {
+		return r;
+	}
+
+	dbg("authentication succeeded");
+	return cb(st, md);
 }
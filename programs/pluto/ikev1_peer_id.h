@@ -26,8 +26,23 @@
 #ifndef IKEV1_PEER_ID_H
 #define IKEV1_PEER_ID_H
 
+/*
+ * Check the peer's HASH_I/HASH_R or SIG_I/SIG_R and, when it is
+ * good, continue with CB.  Signatures are checked on a helper thread
+ * so this can return STF_SUSPEND.
+ */
+typedef stf_status (oakley_auth_cb)(struct state *st, struct msg_digest *md);
+
 extern stf_status oakley_auth(struct msg_digest *md,
-			      bool initiator); /* are we the Initiator? */
+			      bool initiator, /* are we the Initiator? */
+			      oakley_auth_cb *cb);
+
+stf_status submit_v1_authsig(struct ike_sa *ike,
+			     const struct crypt_mac *hash,
+			     shunk_t signature,
+			     bool initiator,
+			     oakley_auth_cb *cb,
+			     where_t where);
 
 bool ikev1_decode_peer_id_initiator(struct state *st, struct msg_digest *md);
 
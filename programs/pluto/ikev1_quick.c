@@ -88,6 +88,7 @@
 #include "crypt_dh.h"
 #include "unpack.h"
 #include "orient.h"
+#include "pluto_stats.h"
 
 #ifdef USE_XFRM_INTERFACE
 # include "kernel_xfrm_interface.h"
@@ -1587,6 +1588,7 @@ stf_status quick_inR1_outI2_tail(struct state *st, struct msg_digest *md)
 				shunk_t idfqdn = pbs_in_left_as_shunk(&IDcr->pbs);
 				st->st_connection->spd.that.client =
 					selector_from_address(st->hidden_variables.st_nat_oa);
+				rehash_db_spd_route_remote_client(&st->st_connection->spd);
 				LLOG_JAMBUF(RC_LOG_SERIOUS, st->st_logger, buf) {
 					jam(buf, "IDcr was FQDN: ");
 					jam_sanitized_hunk(buf, idfqdn);
@@ -1741,134 +1743,164 @@ stf_status quick_inI2(struct state *st, struct msg_digest *md UNUSED)
  * With virtual addressing, we must not allow someone to use an already
  * used (by another id) addr/net.
  */
-static bool is_virtual_net_used(struct connection *c,
+
+static bool virtual_net_used_by(struct connection *c,
+				struct connection *d,
 				const ip_selector *peer_net,
 				const struct id *peer_id)
 {
-	struct connection_filter cq = { .where = HERE, };
-	while (next_connection_new2old(&cq)) {
-		struct connection *d = cq.c;
-		switch (d->kind) {
-		case CK_PERMANENT:
-		case CK_TEMPLATE:
-		case CK_INSTANCE:
-
-			if (d->kind == CK_TEMPLATE &&
-			    !d->remote->config->client.subnet.is_set) {
-				/*
-				 * For instance when the template''s
-				 * peer's protoport=udp/%any but
-				 * peers' subnet is not set.  The
-				 * peer's .client is constructed from
-				 * %any:udp/%any.
-				 *
-				 * Since this has to be narrowed, any
-				 * comparison is pointless.
-				 */
-				connection_buf dcb;
-				enum_buf kb;
-				dbg(" skipping %s "PRI_CONNECTION" as remote's %ssubnet is wild (not set)",
-				    str_enum_short(&connection_kind_names, d->kind, &kb),
-				    pri_connection(d, &dcb),
-				    d->remote->config->leftright);
-				continue;
-			}
+	switch (d->kind) {
+	case CK_PERMANENT:
+	case CK_TEMPLATE:
+	case CK_INSTANCE:
 
-			if (!selector_overlaps_selector(*peer_net, d->spd.that.client)) {
-				/*
-				 * For instance when PEER_NET is IPv6
-				 * and remote .client is IPv4 (but can
-				 * be pretty much anything that
-				 * doesn't intersect).
-				 */
-				connection_buf dcb;
-				enum_buf kb;
-				dbg(" skipping %s "PRI_CONNECTION" as there is no overlap",
-				    str_enum_short(&connection_kind_names, d->kind, &kb),
-				    pri_connection(d, &dcb));
-				continue;
-			}
+		if (d->kind == CK_TEMPLATE &&
+		    !d->remote->config->client.subnet.is_set) {
+			/*
+			 * For instance when the template''s
+			 * peer's protoport=udp/%any but
+			 * peers' subnet is not set.  The
+			 * peer's .client is constructed from
+			 * %any:udp/%any.
+			 *
+			 * Since this has to be narrowed, any
+			 * comparison is pointless.
+			 */
+			connection_buf dcb;
+			enum_buf kb;
+			dbg(" skipping %s "PRI_CONNECTION" as remote's %ssubnet is wild (not set)",
+			    str_enum_short(&connection_kind_names, d->kind, &kb),
+			    pri_connection(d, &dcb),
+			    d->remote->config->leftright);
+			return false;
+		}
 
-			if (same_id(&d->remote->host.id, peer_id)) {
-				/*
-				 * Assumed to be a replace?
-				 */
-				connection_buf dcb;
-				enum_buf kb;
-				id_buf idb;
-				dbg(" skipping %s "PRI_CONNECTION" as it has the same id: %s",
-				    str_enum_short(&connection_kind_names, d->kind, &kb),
-				    pri_connection(d, &dcb),
-				    str_id(&d->remote->host.id, &idb));
-				continue;
-			}
+		if (!selector_overlaps_selector(*peer_net, d->spd.that.client)) {
+			/*
+			 * For instance when PEER_NET is IPv6
+			 * and remote .client is IPv4 (but can
+			 * be pretty much anything that
+			 * doesn't intersect).
+			 */
+			connection_buf dcb;
+			enum_buf kb;
+			dbg(" skipping %s "PRI_CONNECTION" as there is no overlap",
+			    str_enum_short(&connection_kind_names, d->kind, &kb),
+			    pri_connection(d, &dcb));
+			return false;
+		}
 
-			if (!kernel_ops->overlap_supported) {
-				connection_buf cbuf;
-				subnet_buf pcb, dcb;
-				llog(RC_LOG_SERIOUS, c->logger,
-				     "peer Virtual IP %s overlapping %s from "PRI_CONNECTION" is not supported by the kernel interface %s",
-				     str_selector_subnet(peer_net, &pcb),
-				     str_selector_subnet(&d->spd.that.client, &dcb),
-				     pri_connection(d, &cbuf),
-				     kernel_ops->interface_name);
-				return true;
-			}
+		if (same_id(&d->remote->host.id, peer_id)) {
+			/*
+			 * Assumed to be a replace?
+			 */
+			connection_buf dcb;
+			enum_buf kb;
+			id_buf idb;
+			dbg(" skipping %s "PRI_CONNECTION" as it has the same id: %s",
+			    str_enum_short(&connection_kind_names, d->kind, &kb),
+			    pri_connection(d, &dcb),
+			    str_id(&d->remote->host.id, &idb));
+			return false;
+		}
 
-			if (POLICY_OVERLAPIP & c->policy & d->policy) {
-				connection_buf cbuf;
-				subnet_buf pcb, dcb;
-				llog(RC_LOG, c->logger,
-				     "peer Virtual IP %s overlapping %s from "PRI_CONNECTION" permitted by mutual consent (and kernel support)",
-				     str_selector_subnet(peer_net, &pcb),
-				     pri_connection(d, &cbuf),
-				     str_selector_subnet(&d->spd.that.client, &dcb));
-				/*
-				 * Look for another overlap to report
-				 * on.
-				 */
-				continue;
-			}
+		if (!kernel_ops->overlap_supported) {
+			connection_buf cbuf;
+			subnet_buf pcb, dcb;
+			llog(RC_LOG_SERIOUS, c->logger,
+			     "peer Virtual IP %s overlapping %s from "PRI_CONNECTION" is not supported by the kernel interface %s",
+			     str_selector_subnet(peer_net, &pcb),
+			     str_selector_subnet(&d->spd.that.client, &dcb),
+			     pri_connection(d, &cbuf),
+			     kernel_ops->interface_name);
+			return true;
+		}
 
+		if (POLICY_OVERLAPIP & c->policy & d->policy) {
+			connection_buf cbuf;
+			subnet_buf pcb, dcb;
+			llog(RC_LOG, c->logger,
+			     "peer Virtual IP %s overlapping %s from "PRI_CONNECTION" permitted by mutual consent (and kernel support)",
+			     str_selector_subnet(peer_net, &pcb),
+			     pri_connection(d, &cbuf),
+			     str_selector_subnet(&d->spd.that.client, &dcb));
 			/*
-			 * We're not allowed to overlap.  Carefully
-			 * report.
+			 * Look for another overlap to report
+			 * on.
 			 */
+			return false;
+		}
 
-			if (LIN(POLICY_OVERLAPIP, c->policy)) {
-				/* not C; must be D objecting */
-				connection_buf cbuf;
-				subnet_buf pcb, dcb;
-				llog(RC_LOG_SERIOUS, c->logger,
-				     "peer Virtual IP %s overlapping %s fobidden by "PRI_CONNECTION" policy",
-				     str_selector_subnet(peer_net, &pcb),
-				     pri_connection(d, &cbuf),
-				     str_selector_subnet(&d->spd.that.client, &dcb));
-			} else if (LIN(POLICY_OVERLAPIP, d->policy)) {
-				/* not D; must be C objecting */
-				connection_buf cbuf;
-				subnet_buf pcb, dcb;
-				llog(RC_LOG_SERIOUS, c->logger,
-				     "policy forbids peer Virtual IP %s overlapping %s from "PRI_CONNECTION"",
-				     str_selector_subnet(peer_net, &pcb),
-				     pri_connection(d, &cbuf),
-				     str_selector_subnet(&d->spd.that.client, &dcb));
-			} else {
-				/* must be both D and C objecting */
-				connection_buf cbuf;
-				subnet_buf pcb, dcb;
-				llog(RC_LOG_SERIOUS, c->logger,
-				     "peer Virtual IP %s overlapping %s from "PRI_CONNECTION" is forbidden (neither agrees)",
-				     str_selector_subnet(peer_net, &pcb),
-				     str_selector_subnet(&d->spd.that.client, &dcb),
-				     pri_connection(d, &cbuf));
-			}
+		/*
+		 * We're not allowed to overlap.  Carefully
+		 * report.
+		 */
 
-			return true; /* already used by another one */
+		if (LIN(POLICY_OVERLAPIP, c->policy)) {
+			/* not C; must be D objecting */
+			connection_buf cbuf;
+			subnet_buf pcb, dcb;
+			llog(RC_LOG_SERIOUS, c->logger,
+			     "peer Virtual IP %s overlapping %s fobidden by "PRI_CONNECTION" policy",
+			     str_selector_subnet(peer_net, &pcb),
+			     pri_connection(d, &cbuf),
+			     str_selector_subnet(&d->spd.that.client, &dcb));
+		} else if (LIN(POLICY_OVERLAPIP, d->policy)) {
+			/* not D; must be C objecting */
+			connection_buf cbuf;
+			subnet_buf pcb, dcb;
+			llog(RC_LOG_SERIOUS, c->logger,
+			     "policy forbids peer Virtual IP %s overlapping %s from "PRI_CONNECTION"",
+			     str_selector_subnet(peer_net, &pcb),
+			     pri_connection(d, &cbuf),
+			     str_selector_subnet(&d->spd.that.client, &dcb));
+		} else {
+			/* must be both D and C objecting */
+			connection_buf cbuf;
+			subnet_buf pcb, dcb;
+			llog(RC_LOG_SERIOUS, c->logger,
+			     "peer Virtual IP %s overlapping %s from "PRI_CONNECTION" is forbidden (neither agrees)",
+			     str_selector_subnet(peer_net, &pcb),
+			     str_selector_subnet(&d->spd.that.client, &dcb),
+			     pri_connection(d, &cbuf));
+		}
 
-		case CK_GOING_AWAY:
-		default:
-			break;
+		return true; /* already used by another one */
+
+	case CK_GOING_AWAY:
+	default:
+		return false;
+	}
+}
+
+static bool is_virtual_net_used(struct connection *c,
+				const ip_selector *peer_net,
+				const struct id *peer_id)
+{
+	pstats_v1_virtual_net_calls++;
+
+	/*
+	 * Normally PEER_NET is a single address and only the
+	 * connections whose remote client contains it need a look.
+	 */
+	struct connection **candidates;
+	unsigned nr_candidates;
+	if (remote_client_overlap_candidates(peer_net, &candidates, &nr_candidates)) {
+		dbg(" %u connections could overlap the virtual net", nr_candidates);
+		pstats_v1_virtual_net_candidates += nr_candidates;
+		bool used = false;
+		for (unsigned i = 0; i < nr_candidates && !used; i++) {
+			used = virtual_net_used_by(c, candidates[i], peer_net, peer_id);
+		}
+		pfreeany(candidates);
+		return used;
+	}
+
+	struct connection_filter cq = { .where = HERE, };
+	while (next_connection_new2old(&cq)) {
+		pstats_v1_virtual_net_candidates++;
+		if (virtual_net_used_by(c, cq.c, peer_net, peer_id)) {
+			return true; /* already used by another one */
 		}
 	}
 	return false; /* you can safely use it */
@@ -1916,8 +1948,23 @@ static struct connection *fc_try(const struct connection *c,
 	const bool remote_is_host = selector_eq_address(*remote_client,
 							c->remote->host.addr);
 
+	/*
+	 * Unless connaliases are in play, only connections whose
+	 * remote ID matches C's can be chosen.
+	 */
+	const struct id *peer_id = (c->config->connalias != NULL ? NULL :
+				    &c->remote->host.id);
+	struct connection **candidates;
+	unsigned skipped;
+	unsigned nr_candidates =
+		host_pair_remote_id_candidates(local_address, remote_address, peer_id,
+					       &candidates, &skipped);
+	pstats_v1_client_candidates += nr_candidates;
+	pstats_v1_client_skipped += skipped;
+
 	err_t virtualwhy = NULL;
-	FOR_EACH_HOST_PAIR_CONNECTION(local_address, remote_address, d) {
+	for (unsigned i = 0; i < nr_candidates; i++) {
+		struct connection *d = candidates[i];
 
 		if (d->config->ike_version != IKEv1) {
 			continue;
@@ -2073,6 +2120,7 @@ static struct connection *fc_try(const struct connection *c,
 			}
 		}
 	}
+	pfreeany(candidates);
 
 	if (best != NULL && NEVER_NEGOTIATE(best->policy))
 		best = NULL;
@@ -2097,7 +2145,17 @@ static struct connection *fc_try_oppo(const struct connection *c,
 	struct connection *best = NULL;
 	policy_prio_t best_prio = BOTTOM_PRIO;
 
-	FOR_EACH_HOST_PAIR_CONNECTION(local_address, unset_address, d) {
+	struct connection **candidates;
+	unsigned skipped;
+	unsigned nr_candidates =
+		host_pair_remote_id_candidates(local_address, unset_address,
+					       &c->remote->host.id,
+					       &candidates, &skipped);
+	pstats_v1_client_candidates += nr_candidates;
+	pstats_v1_client_skipped += skipped;
+
+	for (unsigned i = 0; i < nr_candidates; i++) {
+		struct connection *d = candidates[i];
 
 		if (d->config->ike_version != IKEv1) {
 			continue;
@@ -2185,6 +2243,7 @@ static struct connection *fc_try_oppo(const struct connection *c,
 			}
 		}
 	}
+	pfreeany(candidates);
 
 	/* if the best wasn't opportunistic, we fail: it must be a shunt */
 	if (best != NULL &&
@@ -2208,6 +2267,8 @@ struct connection *find_v1_client_connection(struct connection *const c,
 		return NULL;
 	}
 
+	pstats_v1_client_calls++;
+
 	if (DBGP(DBG_BASE)) {
 		selectors_buf sb;
 		DBG_log("find_v1_client_connection starting with %s", c->name);
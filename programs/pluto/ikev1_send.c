@@ -80,9 +80,17 @@ static bool send_v1_frags(struct state *st, const char *where)
 	passert(sizeof(struct isakmp_hdr) == NSIZEOF_isakmp_hdr &&
 		sizeof(struct isakmp_ikefrag) == NSIZEOF_isakmp_ikefrag);
 
+	/*
+	 * Fragments are sent in batches; each needs its own prefix
+	 * until the batch is sent.
+	 */
+	struct send_packet packets[SEND_PACKETS_MAX];
+	uint8_t frag_prefixes[SEND_PACKETS_MAX][NSIZEOF_isakmp_hdr +
+						NSIZEOF_isakmp_ikefrag];
+	unsigned nr_packets = 0;
+
 	while (packet_remainder_len > 0) {
-		uint8_t frag_prefix[NSIZEOF_isakmp_hdr +
-				     NSIZEOF_isakmp_ikefrag];
+		uint8_t *frag_prefix = frag_prefixes[nr_packets];
 		const size_t data_len = packet_remainder_len > max_data_len ?
 					max_data_len : packet_remainder_len;
 		const size_t fragpl_len = NSIZEOF_isakmp_ikefrag + data_len;
@@ -128,14 +136,20 @@ static bool send_v1_frags(struct state *st, const char *where)
 		    fragnum,
 		    packet_remainder_len == data_len ? " (last)" : "");
 
-		if (!send_chunks_using_state(st, where,
-					     chunk2(frag_prefix,
-						    NSIZEOF_isakmp_hdr + NSIZEOF_isakmp_ikefrag),
-					     chunk2(packet_cursor, data_len)))
-			return false;
+		packets[nr_packets++] = (struct send_packet) {
+			.a = shunk2(frag_prefix, sizeof(frag_prefixes[0])),
+			.b = shunk2(packet_cursor, data_len),
+		};
 
 		packet_remainder_len -= data_len;
 		packet_cursor += data_len;
+
+		if (nr_packets == elemsof(packets) || packet_remainder_len == 0) {
+			if (!send_packets_using_state(st, where, packets, nr_packets)) {
+				return false;
+			}
+			nr_packets = 0;
+		}
 	}
 	return true;
 }
@@ -1102,7 +1102,7 @@ static stf_status ikev1_xauth_callback(struct state *st,
 		if (st->quirks.xauth_ack_msgid)
 			st->st_v1_msgid.phase15 = v1_MAINMODE_MSGID;
 
-		jam_str(st->st_xauth_username, sizeof(st->st_xauth_username), name);
+		update_xauth_username(st, name);
 	} else {
 		/*
 		 * Login attempt failed, display error, send XAUTH status to client
@@ -1883,6 +1883,12 @@ stf_status modecfg_inR1(struct state *st, struct msg_digest *md)
 	return STF_OK;
 }
 
+/* an unset username is sent as an empty string */
+static const char *xauth_username_str(const struct state *st)
+{
+	return (st->st_xauth_username == NULL ? "" : st->st_xauth_username);
+}
+
 /** XAUTH client code - response to challenge.  May open filehandle to console
  * in order to prompt user for password
  *
@@ -1948,7 +1954,7 @@ static stf_status xauth_client_resp(struct state *st,
 							&attrval))
 						return STF_INTERNAL_ERROR;
 
-					if (st->st_xauth_username[0] == '\0') {
+					if (st->st_xauth_username == NULL) {
 						if (!fd_p(st->st_logger->object_whackfd)) {
 							log_state(RC_LOG_SERIOUS, st,
 							       "XAUTH username requested, but no file descriptor available for prompt");
@@ -1973,14 +1979,11 @@ static stf_status xauth_client_resp(struct state *st,
 						if (cptr != NULL)
 							*cptr = '\0';
 
-						jam_str(st->st_xauth_username,
-							sizeof(st->st_xauth_username),
-							xauth_username);
+						update_xauth_username(st, xauth_username);
 					}
 
-					if (!out_raw(st->st_xauth_username,
-						     strlen(st->
-							    st_xauth_username),
+					if (!out_raw(xauth_username_str(st),
+						     strlen(xauth_username_str(st)),
 						     &attrval,
 						     "XAUTH username"))
 						return STF_INTERNAL_ERROR;
@@ -2003,10 +2006,10 @@ static stf_status xauth_client_resp(struct state *st,
 					{
 						struct secret *s =
 							lsw_get_xauthsecret(
-								st->st_xauth_username);
+								xauth_username_str(st));
 
 						dbg("looked up username=%s, got=%p",
-						    st->st_xauth_username,
+						    xauth_username_str(st),
 						    s);
 						if (s != NULL) {
 							struct secret_stuff *pks = get_secret_stuff(s);
@@ -2092,7 +2095,7 @@ static stf_status xauth_client_resp(struct state *st,
 	}
 
 	log_state(RC_LOG, st, "XAUTH: Answering XAUTH challenge with user='%s'",
-		      st->st_xauth_username);
+		      xauth_username_str(st));
 
 	fixup_xauth_hash(st, &hash_fixup, rbody->cur);
 
@@ -281,7 +281,20 @@ static /*const*/ struct v2_state_transition v2_state_transition_table[] = {
 	  .flags      = LEMPTY,
 	  .exchange   = ISAKMP_v2_IKE_SA_INIT,
 	  .send_role  = MESSAGE_REQUEST,
-	  .processor  = NULL, /* XXX: should be set */
+	  .processor  = record_v2_IKE_SA_INIT_request,
+	  .llog_success = llog_v2_success_sent_message_to,
+	  .timeout_event = EVENT_RETRANSMIT, },
+
+	/* no state:   --> I1
+	 * HDR, Ni, N(TICKET_OPAQUE) -->
+	 */
+	{ .story      = "initiating IKE_SESSION_RESUME",
+	  .state      = STATE_V2_PARENT_I0,
+	  .next_state = STATE_V2_PARENT_I1,
+	  .flags      = LEMPTY,
+	  .exchange   = ISAKMP_v2_IKE_SESSION_RESUME,
+	  .send_role  = MESSAGE_REQUEST,
+	  .processor  = record_v2_IKE_SESSION_RESUME_request,
 	  .llog_success = llog_v2_success_sent_message_to,
 	  .timeout_event = EVENT_RETRANSMIT, },
 
@@ -330,6 +343,39 @@ static /*const*/ struct v2_state_transition v2_state_transition_table[] = {
 	  .timeout_event = EVENT_SA_DISCARD,
 	},
 
+	/* STATE_V2_PARENT_I1: R1 --> I0
+	 *                     <--  HDR, N(TICKET_NACK)
+	 * HDR, SAi1, KEi, Ni -->
+	 */
+	{ .story      = "received TICKET_NACK response; falling back to IKE_SA_INIT",
+	  .state      = STATE_V2_PARENT_I1,
+	  .next_state = STATE_V2_PARENT_I0,
+	  .flags      = LEMPTY,
+	  .exchange   = ISAKMP_v2_IKE_SESSION_RESUME,
+	  .recv_role  = MESSAGE_RESPONSE,
+	  .send_role  = NO_MESSAGE,
+	  .message_payloads.required = P(N),
+	  .message_payloads.notification = v2N_TICKET_NACK,
+	  .processor  = process_v2_IKE_SESSION_RESUME_response_v2N_TICKET_NACK,
+	  .llog_success = ldbg_v2_success,
+	  .timeout_event = EVENT_SA_DISCARD, },
+
+	/* STATE_V2_PARENT_I1: R1 --> I2
+	 *                     <--  HDR, Nr
+	 * HDR, SK {IDi, AUTH, SAi2, TSi, TSr} -->
+	 */
+	{ .story      = "Initiator: process IKE_SESSION_RESUME reply, initiate IKE_AUTH",
+	  .state      = STATE_V2_PARENT_I1,
+	  .next_state = STATE_V2_PARENT_I2,
+	  .flags      = LEMPTY,
+	  .exchange   = ISAKMP_v2_IKE_SESSION_RESUME,
+	  .recv_role  = MESSAGE_RESPONSE,
+	  .send_role  = MESSAGE_REQUEST,
+	  .req_clear_payloads = P(Nr),
+	  .processor  = process_v2_IKE_SESSION_RESUME_response,
+	  .llog_success = llog_v2_success_story_details,
+	  .timeout_event = EVENT_RETRANSMIT, },
+
 	/* STATE_V2_PARENT_I1: R1 --> I2
 	 *                     <--  HDR, SAr1, KEr, Nr, [CERTREQ]
 	 * HDR, SK {IDi, [CERT,] [CERTREQ,]
@@ -413,6 +459,23 @@ static /*const*/ struct v2_state_transition v2_state_transition_table[] = {
 	  .llog_success = llog_v2_success_story_details,
 	  .timeout_event = EVENT_SA_DISCARD, },
 
+	/* no state: none I1 --> R1
+	 *                <-- HDR, Ni, N(TICKET_OPAQUE)
+	 * HDR, Nr -->
+	 */
+	{ .story      = "Respond to IKE_SESSION_RESUME",
+	  .state      = STATE_V2_PARENT_R0,
+	  .next_state = STATE_V2_PARENT_R1,
+	  .flags      = LEMPTY,
+	  .exchange   = ISAKMP_v2_IKE_SESSION_RESUME,
+	  .recv_role  = MESSAGE_REQUEST,
+	  .send_role  = MESSAGE_RESPONSE,
+	  .req_clear_payloads = P(Ni),
+	  .message_payloads.notification = v2N_TICKET_OPAQUE,
+	  .processor  = process_v2_IKE_SESSION_RESUME_request,
+	  .llog_success = llog_v2_success_sent_message_to,
+	  .timeout_event = EVENT_SA_DISCARD, },
+
 	/* STATE_V2_PARENT_R1: I2 --> R2
 	 *                  <-- HDR, SK {IDi, [CERT,] [CERTREQ,]
 	 *                             [IDr,] AUTH, SAi2,
@@ -1065,10 +1128,8 @@ void init_ikev2(void)
 		 *
 		 * "<=" is equivalent to implies (except the arrow
 		 * points the wrong way).
-		 *
-		 * XXX: IKE_SA_INIT should have processor set.
 		 */
-		if (t->processor != NULL || t->exchange == ISAKMP_v2_IKE_SA_INIT) {
+		if (t->processor != NULL) {
 			passert((t->recv_role == NO_MESSAGE) <=/*implies*/ (t->send_role == MESSAGE_REQUEST));
 			passert((t->recv_role == MESSAGE_REQUEST) == (t->send_role == MESSAGE_RESPONSE));
 			passert((t->recv_role == MESSAGE_RESPONSE) <=/*implies*/ (t->send_role == NO_MESSAGE || t->send_role == MESSAGE_REQUEST));
@@ -1086,11 +1147,11 @@ void init_ikev2(void)
 			LIN(P(SK), t->message_payloads.required) == from->v2.secured);
 
 		/*
-		 * Check that only IKE_SA_INIT transitions are from an
-		 * unsecured state.
+		 * Check that only IKE_SA_INIT (and IKE_SESSION_RESUME)
+		 * transitions are from an unsecured state.
 		 */
 		if (t->recv_role != 0) {
-			passert((t->exchange == ISAKMP_v2_IKE_SA_INIT) == !from->v2.secured);
+			passert(v2_exchange_is_unsecured(t->exchange) == !from->v2.secured);
 		}
 
 		/*
@@ -1119,6 +1180,9 @@ void init_ikev2(void)
 
 	/* finish the final state */
 	dbg("    %zu transitions", prev->nr_transitions);
+
+	/* now the transitions are attached to their states */
+	init_v2_state_transition_index();
 }
 
 /*
@@ -1358,11 +1422,11 @@ static bool is_duplicate_request_msgid(struct ike_sa *ike,
 
 	/* lie to keep test results happy */
 	dbg("#%lu st.st_msgid_lastrecv %jd md.hdr.isa_msgid %08jx",
-	    ike->sa.st_serialno, ike->sa.st_v2_msgid_windows.responder.recv, msgid);
+	    ike->sa.st_serialno, ike->st_v2_msgid_windows.responder.recv, msgid);
 
 	/* the sliding window is really small?!? */
-	pexpect(ike->sa.st_v2_msgid_windows.responder.recv ==
-		ike->sa.st_v2_msgid_windows.responder.sent);
+	const struct v2_msgid_window *responder = &ike->st_v2_msgid_windows.responder;
+	pexpect(responder->window > 1 || responder->recv == responder->sent);
 
 	/*
 	 * Is this request old?  Yes, drop it.
@@ -1370,13 +1434,13 @@ static bool is_duplicate_request_msgid(struct ike_sa *ike,
 	 * If the Message ID is earlier than the last response sent,
 	 * then the message is too old and not worth a retransmit:
 	 * since a message with ID SENT was received, the initiator
-	 * must have received up to SENT-1 responses.
+	 * must have received up to SENT-WINDOW responses.
 	 */
-	if (msgid < ike->sa.st_v2_msgid_windows.responder.sent) {
+	if (msgid <= responder->sent - (intmax_t)responder->window) {
 		llog_sa(RC_LOG, ike,
 			"%s request has duplicate Message ID %jd but it is older than last response (%jd); message dropped",
 			enum_name_short(&ikev2_exchange_names, md->hdr.isa_xchg),
-			msgid, ike->sa.st_v2_msgid_windows.responder.sent);
+			msgid, responder->sent);
 		return true;
 	}
 
@@ -1435,8 +1499,13 @@ static bool is_duplicate_request_msgid(struct ike_sa *ike,
 	 *   and encrypted and integrity protected payloads].
 	 *
 	 * Lets hold our breath.
+	 *
+	 * With a window larger than one, the response could also be
+	 * one that was parked.
 	 */
-	if (msgid == ike->sa.st_v2_msgid_windows.responder.sent) {
+	struct v2_outgoing_fragment *response;
+	unsigned recv_frags;
+	if (v2_msgid_recorded_response(ike, msgid, &response, &recv_frags)) {
 		/*
 		 * XXX: should a local timer delete the last outgoing
 		 * message after a short while so that retransmits
@@ -1448,7 +1517,7 @@ static bool is_duplicate_request_msgid(struct ike_sa *ike,
 		 *   are allowed to forget the response after a
 		 *   timeout of several minutes.
 		 */
-		if (ike->sa.st_v2_outgoing[MESSAGE_RESPONSE] == NULL) {
+		if (response == NULL) {
 			fail_v2_msgid(ike,
 				      "%s request has duplicate Message ID %jd but there is no saved message to retransmit; message dropped",
 				      enum_name(&ikev2_exchange_names, md->hdr.isa_xchg),
@@ -1476,7 +1545,7 @@ static bool is_duplicate_request_msgid(struct ike_sa *ike,
 
 		switch (md->hdr.isa_np) {
 		case ISAKMP_NEXT_v2SK:
-			if (ike->sa.st_v2_msgid_windows.responder.recv_frags > 0 &&
+			if (recv_frags > 0 &&
 			    md->hdr.isa_np == ISAKMP_NEXT_v2SKF) {
 				llog_sa(RC_LOG, ike,
 					"%s request has duplicate Message ID %jd but original was fragmented; message dropped",
@@ -1490,7 +1559,7 @@ static bool is_duplicate_request_msgid(struct ike_sa *ike,
 				msgid);
 			break;
 		case ISAKMP_NEXT_v2SKF:
-			if (ike->sa.st_v2_msgid_windows.responder.recv_frags == 0) {
+			if (recv_frags == 0) {
 				llog_sa(RC_LOG, ike,
 					"%s request fragment has duplicate Message ID %jd but original was not fragmented; message dropped",
 					enum_name_short(&ikev2_exchange_names, md->hdr.isa_xchg),
@@ -1507,12 +1576,12 @@ static bool is_duplicate_request_msgid(struct ike_sa *ike,
 				llog_diag(RC_LOG, ike->sa.st_logger, &d, "%s", "");
 				return true;
 			}
-			if (skf.isaskf_total != ike->sa.st_v2_msgid_windows.responder.recv_frags) {
+			if (skf.isaskf_total != recv_frags) {
 				dbg_v2_msgid(ike,
 					     "%s request fragment %u of %u has duplicate Message ID %jd but should have fragment total %u; message dropped",
 					     enum_name_short(&ikev2_exchange_names, md->hdr.isa_xchg),
 					     skf.isaskf_number, skf.isaskf_total, msgid,
-					     ike->sa.st_v2_msgid_windows.responder.recv_frags);
+					     recv_frags);
 				return true;
 			}
 			if (skf.isaskf_number != 1) {
@@ -1535,13 +1604,13 @@ static bool is_duplicate_request_msgid(struct ike_sa *ike,
 				msgid);
 			return true;
 		}
-		send_recorded_v2_message(ike, "ikev2-responder-retransmit",
-					 MESSAGE_RESPONSE);
+		send_v2_outgoing_fragments(ike, "ikev2-responder-retransmit",
+					   response);
 		return true;
 	}
 
 	/* all that is left */
-	pexpect(msgid > ike->sa.st_v2_msgid_windows.responder.sent);
+	pexpect(responder->window > 1 || msgid > responder->sent);
 
 	/*
 	 * Is the secured IKE SA responder already working on this
@@ -1557,17 +1626,47 @@ static bool is_duplicate_request_msgid(struct ike_sa *ike,
 	 * - the message successfully decrypts
 	 *
 	 */
-	if (ike->sa.st_v2_msgid_windows.responder.wip == msgid) {
+	if (responder->wip == msgid) {
 		/* this generates the log message */
 		pexpect(verbose_state_busy(&ike->sa));
 		return true;
 	}
 
+	/*
+	 * When the window is larger than one, the peer can send the
+	 * next request before this end has finished with the current
+	 * one.  Requests are still processed one at a time so, once
+	 * it has been decrypted and passed its integrity check, hang
+	 * onto it until the current request finishes (see
+	 * process_packet_with_secured_ike_sa()).  Anything that can't
+	 * be checked now is dropped; the peer will retransmit.
+	 */
+	struct v2_incoming_fragments *frags = ike->sa.st_v2_incoming[MESSAGE_REQUEST];
+	if (responder->window > 1) {
+		if (responder->wip != -1) {
+			if (md->hdr.isa_np != ISAKMP_NEXT_v2SK ||
+			    !ike->sa.hidden_variables.st_skeyid_calculated) {
+				dbg_v2_msgid(ike, "dropping request %jd, responder is busy with request %jd",
+					     msgid, responder->wip);
+				return true;
+			}
+			dbg_v2_msgid(ike,
+				     "not a duplicate - request %jd will be deferred once it decrypts, responder is busy with request %jd",
+				     msgid, responder->wip);
+			return false;
+		}
+		if (frags != NULL && frags->md != NULL &&
+		    frags->md->hdr.isa_msgid != msgid) {
+			dbg_v2_msgid(ike, "dropping request %jd, responder is accumulating fragments for request %jd",
+				     msgid, (intmax_t)frags->md->hdr.isa_msgid);
+			return true;
+		}
+	}
+
 	/*
 	 * If the message is not a "duplicate", then what is it?
 	 */
 
-	struct v2_incoming_fragments *frags = ike->sa.st_v2_incoming[MESSAGE_REQUEST];
 	if (ike->sa.st_offloaded_task_in_background) {
 		/*
 		 * The IKE SA responder is in the twilight zone:
@@ -1662,10 +1761,11 @@ static bool is_duplicate_response(struct ike_sa *ike,
 	intmax_t msgid = md->hdr.isa_msgid;
 
 	/* the sliding window is really small!?! */
-	pexpect(ike->sa.st_v2_msgid_windows.responder.recv ==
-		ike->sa.st_v2_msgid_windows.responder.sent);
+	pexpect(ike->st_v2_msgid_windows.responder.window > 1 ||
+		ike->st_v2_msgid_windows.responder.recv ==
+		ike->st_v2_msgid_windows.responder.sent);
 
-	if (msgid <= ike->sa.st_v2_msgid_windows.initiator.recv) {
+	if (msgid <= ike->st_v2_msgid_windows.initiator.recv) {
 		/*
 		 * Processing of the response was completed so drop as
 		 * too old.
@@ -1716,7 +1816,26 @@ static bool is_duplicate_response(struct ike_sa *ike,
 		return true;
 	}
 
-	if (ike->sa.st_v2_msgid_windows.initiator.wip != msgid) {
+	if (ike->st_v2_msgid_windows.initiator.wip != msgid &&
+	    v2_msgid_parked_request(ike, msgid)) {
+		/*
+		 * A response to a request that was parked (the window
+		 * is larger than one).  Switch to it, unless the IKE
+		 * SA is busy with the current exchange (the response
+		 * will be retransmitted).
+		 */
+		if (ike->sa.st_v2_incoming[MESSAGE_RESPONSE] != NULL) {
+			dbg_v2_msgid(ike, "dropping response %jd, accumulating fragments for response %jd",
+				     msgid, ike->st_v2_msgid_windows.initiator.wip);
+			return true;
+		}
+		if (verbose_state_busy(&ike->sa)) {
+			return true;
+		}
+		v2_msgid_unpark_request(ike, msgid);
+	}
+
+	if (ike->st_v2_msgid_windows.initiator.wip != msgid) {
 		/*
 		 * While there's an IKE SA matching the IKE SPIs,
 		 * there's no corresponding initiator for the message.
@@ -1732,14 +1851,14 @@ static bool is_duplicate_response(struct ike_sa *ike,
 	 * Message ID window.
 	 */
 
-	if (msgid > ike->sa.st_v2_msgid_windows.initiator.sent) {
+	if (msgid > ike->st_v2_msgid_windows.initiator.sent) {
 		/*
 		 * The IKE SA is waiting for a message that, according
 		 * to the IKE SA, has yet to be sent?!?
 		 */
 		fail_v2_msgid(ike,
 			      "dropping response with Message ID %jd which is from the future - last request sent was %jd",
-			      msgid, ike->sa.st_v2_msgid_windows.initiator.sent);
+			      msgid, ike->st_v2_msgid_windows.initiator.sent);
 		return true;
 	}
 
@@ -1840,10 +1959,11 @@ void ikev2_process_packet(struct msg_digest *md)
 	 * cookie is rejected before the IKE SA is created.
 	 *
 	 * Hence, the unprotected IKE_SA_INIT exchange is given its
-	 * own separate code path.
+	 * own separate code path.  IKE_SESSION_RESUME, which also
+	 * creates the IKE SA, shares it.
 	 */
 
-	if (ix == ISAKMP_v2_IKE_SA_INIT) {
+	if (v2_exchange_is_unsecured(ix)) {
 		process_v2_IKE_SA_INIT(md);
 		return;
 	}
@@ -2018,7 +2138,7 @@ static void complete_protected_but_fatal_exchange(struct ike_sa *ike, struct msg
 static void process_packet_with_secured_ike_sa(struct msg_digest *md, struct ike_sa *ike)
 {
 	passert(ike->sa.st_state->v2.secured);
-	passert(md->hdr.isa_xchg != ISAKMP_v2_IKE_SA_INIT);
+	passert(!v2_exchange_is_unsecured(md->hdr.isa_xchg));
 
 	/*
 	 * Deal with duplicate messages and busy states.
@@ -2194,10 +2314,51 @@ static void process_packet_with_secured_ike_sa(struct msg_digest *md, struct ike
 		return;
 	}
 
+	/*
+	 * A request that arrived while the responder is busy with an
+	 * earlier one (only possible when the window is larger than
+	 * one).  Now that it is known to have come from the peer,
+	 * defer it.
+	 */
+	if (v2_msg_role(protected_md) == MESSAGE_REQUEST &&
+	    ike->st_v2_msgid_windows.responder.window > 1 &&
+	    ike->st_v2_msgid_windows.responder.wip != -1) {
+		if (!v2_msgid_defer_request(ike, protected_md)) {
+			dbg_v2_msgid(ike, "dropping request %jd, responder is busy with request %jd",
+				     (intmax_t)protected_md->hdr.isa_msgid,
+				     ike->st_v2_msgid_windows.responder.wip);
+		}
+		md_delref(&protected_md);
+		return;
+	}
+
 	process_protected_v2_message(ike, protected_md);
 	md_delref(&protected_md);
 }
 
+/*
+ * A request deferred by v2_msgid_defer_request(); it has already
+ * been decrypted and passed its integrity check, but things may have
+ * moved on since.
+ */
+
+void process_deferred_v2_request(struct ike_sa *ike, struct msg_digest *md)
+{
+	if (is_duplicate_request_msgid(ike, md)) {
+		return;
+	}
+	if (ike->st_v2_msgid_windows.responder.wip != -1) {
+		/* busy again */
+		if (!v2_msgid_defer_request(ike, md)) {
+			dbg_v2_msgid(ike, "dropping request %jd, responder is busy with request %jd",
+				     (intmax_t)md->hdr.isa_msgid,
+				     ike->st_v2_msgid_windows.responder.wip);
+		}
+		return;
+	}
+	process_protected_v2_message(ike, md);
+}
+
 void process_protected_v2_message(struct ike_sa *ike, struct msg_digest *md)
 {
 	const enum isakmp_xchg_type ix = md->hdr.isa_xchg;
@@ -2816,7 +2977,10 @@ static void reinitiate_v2_ike_sa_init(const char *story, struct state *st, void
 	/*
 	 * Pretend to be running the initiate state transition.
 	 */
-	set_v2_transition(&ike->sa, finite_states[STATE_V2_PARENT_I0]->v2.transitions, HERE); /* first */
+	set_v2_transition(&ike->sa,
+			  find_v2_initiate_transition(finite_states[STATE_V2_PARENT_I0],
+						      ISAKMP_v2_IKE_SA_INIT),
+			  HERE);
 
 	/*
 	 * Need to re-open TCP.
@@ -2867,6 +3031,12 @@ bool v2_notification_fatal(v2_notification_t n)
 		n == v2N_UNSUPPORTED_CRITICAL_PAYLOAD);
 }
 
+bool v2_exchange_is_unsecured(enum isakmp_xchg_type ix)
+{
+	return (ix == ISAKMP_v2_IKE_SA_INIT ||
+		ix == ISAKMP_v2_IKE_SESSION_RESUME);
+}
+
 bool already_has_larval_v2_child(struct ike_sa *ike, const struct connection *c)
 {
 	const lset_t pending_states = (LELEM(STATE_V2_NEW_CHILD_I1) |
@@ -30,6 +30,7 @@ typedef stf_status crypto_transition_fn(struct state *st, struct msg_digest *md,
 void ikev2_process_packet(struct msg_digest *mdp);
 
 void process_protected_v2_message(struct ike_sa *ike, struct msg_digest *md);
+void process_deferred_v2_request(struct ike_sa *ike, struct msg_digest *md);
 
 typedef stf_status ikev2_state_transition_fn(struct ike_sa *ike,
 					     struct child_sa *child, /* could be NULL */
@@ -168,6 +169,12 @@ bool negotiate_hash_algo_from_notification(const struct pbs_in *payload_pbs,
 
 bool v2_notification_fatal(v2_notification_t n);
 
+/*
+ * IKE_SA_INIT and (RFC 5723) IKE_SESSION_RESUME create the IKE SA
+ * and are sent in the clear.
+ */
+bool v2_exchange_is_unsecured(enum isakmp_xchg_type ix);
+
 bool already_has_larval_v2_child(struct ike_sa *ike, const struct connection *c);
 
 void llog_v2_success_sent_message_to(struct ike_sa *ike);
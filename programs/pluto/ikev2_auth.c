@@ -38,6 +38,7 @@
 #include "ikev2.h"
 #include "keys.h"
 #include "ikev2_psk.h"
+#include "ikev2_eap.h"		/* for .sa_md */
 
 struct crypt_mac v2_calculate_sighash(const struct ike_sa *ike,
 				      const struct crypt_mac *idhash,
@@ -70,15 +71,15 @@ struct crypt_mac v2_calculate_sighash(const struct ike_sa *ike,
 		/* on initiator, we need to hash responders nonce */
 		nonce = &ike->sa.st_nr;
 		nonce_name = "inputs to hash2 (responder nonce)";
-		ia1 = ike->sa.st_v2_ike_intermediate.initiator;
-		ia2 = ike->sa.st_v2_ike_intermediate.responder;
+		ia1 = ike->st_v2_ike_intermediate.initiator;
+		ia2 = ike->st_v2_ike_intermediate.responder;
 		break;
 	case SA_RESPONDER:
 		/* on responder, we need to hash initiators nonce */
 		nonce = &ike->sa.st_ni;
 		nonce_name = "inputs to hash2 (initiator nonce)";
-		ia1 = ike->sa.st_v2_ike_intermediate.responder;
-		ia2 = ike->sa.st_v2_ike_intermediate.initiator;
+		ia1 = ike->st_v2_ike_intermediate.responder;
+		ia2 = ike->st_v2_ike_intermediate.initiator;
 		break;
 	default:
 		bad_case(role);
@@ -88,7 +89,7 @@ struct crypt_mac v2_calculate_sighash(const struct ike_sa *ike,
 		DBG_dump_hunk("inputs to hash1 (first packet)", firstpacket);
 		DBG_dump_hunk(nonce_name, *nonce);
 		DBG_dump_hunk("idhash", *idhash);
-		if (ike->sa.st_v2_ike_intermediate.used) {
+		if (ike->st_v2_ike_intermediate.used) {
 			DBG_dump_hunk("IntAuth_*_I_A", ia1);
 			DBG_dump_hunk("IntAuth_*_R_A", ia2);
 		}
@@ -101,12 +102,12 @@ struct crypt_mac v2_calculate_sighash(const struct ike_sa *ike,
 	/* we took the PRF(SK_d,ID[ir]'), so length is prf hash length */
 	passert(idhash->len == ike->sa.st_oakley.ta_prf->prf_output_size);
 	crypt_hash_digest_hunk(ctx, "IDHASH", *idhash);
-	if (ike->sa.st_v2_ike_intermediate.used) {
+	if (ike->st_v2_ike_intermediate.used) {
 		crypt_hash_digest_hunk(ctx, "IntAuth_*_I_A", ia1);
 		crypt_hash_digest_hunk(ctx, "IntAuth_*_R_A", ia2);
 		/* IKE AUTH's first Message ID */
-		uint8_t ike_auth_mid[sizeof(ike->sa.st_v2_ike_intermediate.id)];
-		hton_bytes(ike->sa.st_v2_ike_intermediate.id + 1,
+		uint8_t ike_auth_mid[sizeof(ike->st_v2_ike_intermediate.id)];
+		hton_bytes(ike->st_v2_ike_intermediate.id + 1,
 			   ike_auth_mid, sizeof(ike_auth_mid));
 		crypt_hash_digest_thing(ctx, "IKE_AUTH_MID", ike_auth_mid);
 	}
@@ -115,6 +116,14 @@ struct crypt_mac v2_calculate_sighash(const struct ike_sa *ike,
 
 enum keyword_auth local_v2_auth(struct ike_sa *ike)
 {
+	if (ike->sa.st_v2_resumption != NULL) {
+		/*
+		 * RFC 5723: a resumed IKE SA proves itself using
+		 * SK_pi/SK_pr (derived from the old SK_d), which is
+		 * how AUTH_NULL computes the AUTH payload.
+		 */
+		return AUTH_NULL;
+	}
 	if (ike->sa.st_peer_wants_null) {
 		/* we allow authby=null and IDr payload told us to use it */
 		return AUTH_NULL;
@@ -142,6 +151,12 @@ enum ikev2_auth_method local_v2AUTH_method(struct ike_sa *ike,
 		return impair.force_v2_auth_method;
 	}
 
+	if (ike->sa.st_v2_resumption != NULL) {
+		/* RFC 5723: on the wire it is a Shared Key MIC */
+		pexpect(authby == AUTH_NULL);
+		return IKEv2_AUTH_PSK;
+	}
+
 	switch (authby) {
 	case AUTH_RSASIG:
 		/*
@@ -274,7 +289,8 @@ bool emit_local_v2AUTH(struct ike_sa *ike,
 		       const struct crypt_mac *id_payload_mac,
 		       struct pbs_out *outs)
 {
-	enum keyword_auth authby = ike->sa.st_eap_sa_md ? AUTH_PSK : local_v2_auth(ike);
+	enum keyword_auth authby = (ike->sa.st_eap != NULL && ike->sa.st_eap->sa_md != NULL ?
+				    AUTH_PSK : local_v2_auth(ike));
 	struct ikev2_auth a = {
 		.isaa_critical = build_ikev2_critical(false, ike->sa.st_logger),
 		.isaa_auth_method = local_v2AUTH_method(ike, authby),
@@ -417,6 +433,16 @@ diag_t verify_v2AUTH_and_log(enum ikev2_auth_method recv_auth,
 	    str_enum_short(&ikev2_auth_method_names, recv_auth, &ramb),
 	    str_enum_short(&keyword_auth_names, that_auth, &eanb));
 
+	if (ike->sa.st_v2_resumption != NULL) {
+		/* RFC 5723: see local_v2_auth() */
+		if (recv_auth != IKEv2_AUTH_PSK) {
+			return diag("authentication failed: peer resuming IKE SA attempted %s authentication",
+				    enum_name(&ikev2_auth_method_names, recv_auth));
+		}
+		return verify_v2AUTH_and_log_using_psk(AUTH_NULL, ike, idhash_in,
+						       signature_pbs, NULL/*auth_sig*/);
+	}
+
 	/*
 	 * XXX: can the boiler plate check that THAT_AUTH matches
 	 * recv_auth appearing in all case branches be merged?
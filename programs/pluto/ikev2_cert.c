@@ -39,6 +39,103 @@
 #include "log.h"
 #include "pluto_x509.h"		/* for get_auth_chain() */
 
+/*
+ * Pre-encoded CERT payload bodies.
+ *
+ * Our own chain only changes when the certificate, or the NSS DB, is
+ * reloaded; so, instead of asking NSS to rebuild it for each
+ * IKE_AUTH, build the DER blobs once per certificate and send-ca
+ * policy.
+ *
+ * Entries are found using the CERTCertificate pointer, which is why
+ * they must be forgotten before the certificate is destroyed.
+ */
+
+struct v2_cert_payloads {
+	const CERTCertificate *cert;
+	enum send_ca_policy send_ca;
+	unsigned nr;			/* end cert + chain */
+	shunk_t body[1 + MAX_CA_PATH_LEN];	/* point into .blob */
+	chunk_t blob;
+	struct v2_cert_payloads *next;
+};
+
+static struct v2_cert_payloads *v2_cert_payloads_cache;
+
+static const struct v2_cert_payloads *v2_cert_payloads(const struct cert *mycert,
+							enum send_ca_policy send_ca)
+{
+	const CERTCertificate *cert = (mycert == NULL ? NULL : mycert->nss_cert);
+	for (struct v2_cert_payloads *p = v2_cert_payloads_cache; p != NULL; p = p->next) {
+		if (p->cert == cert && p->send_ca == send_ca) {
+			return p;
+		}
+	}
+
+	/*****
+	 * From here on, if send_authcerts, we are obligated to:
+	 * free_auth_chain(auth_chain, chain_len);
+	 *****/
+
+	bool send_authcerts = send_ca != CA_SEND_NONE;
+	bool send_full_chain = send_authcerts && send_ca == CA_SEND_ALL;
+	chunk_t auth_chain[MAX_CA_PATH_LEN] = { { NULL, 0 } };
+	int chain_len = 0;
+
+	if (send_authcerts) {
+		chain_len = get_auth_chain(auth_chain, MAX_CA_PATH_LEN,
+					   mycert,
+					   send_full_chain ? true : false);
+	}
+
+	shunk_t end_der = cert_der(mycert);
+	size_t size = end_der.len;
+	for (int i = 0; i < chain_len; i++) {
+		size += auth_chain[i].len;
+	}
+
+	struct v2_cert_payloads *p = alloc_thing(struct v2_cert_payloads, "v2 CERT payloads");
+	p->cert = cert;
+	p->send_ca = send_ca;
+	p->blob = alloc_chunk(size, "v2 CERT payload bodies");
+	size_t offset = 0;
+	if (end_der.len > 0) {
+		memcpy(p->blob.ptr + offset, end_der.ptr, end_der.len);
+	}
+	p->body[p->nr++] = shunk2(p->blob.ptr + offset, end_der.len);
+	offset += end_der.len;
+	for (int i = 0; i < chain_len; i++) {
+		memcpy(p->blob.ptr + offset, auth_chain[i].ptr, auth_chain[i].len);
+		p->body[p->nr++] = shunk2(p->blob.ptr + offset, auth_chain[i].len);
+		offset += auth_chain[i].len;
+	}
+	free_auth_chain(auth_chain, chain_len);
+
+	dbg("pre-encoded %u CERT payloads for %s", p->nr, cert_nickname(mycert));
+	p->next = v2_cert_payloads_cache;
+	v2_cert_payloads_cache = p;
+	return p;
+}
+
+/*
+ * Forget the payloads built from CERT, or all payloads when CERT is
+ * NULL.
+ */
+
+void forget_v2_cert_payloads(const CERTCertificate *cert)
+{
+	for (struct v2_cert_payloads **pp = &v2_cert_payloads_cache; *pp != NULL; ) {
+		struct v2_cert_payloads *p = *pp;
+		if (cert == NULL || p->cert == cert) {
+			*pp = p->next;
+			free_chunk_content(&p->blob);
+			pfree(p);
+		} else {
+			pp = &p->next;
+		}
+	}
+}
+
 /*
  * Send v2 CERT and possible CERTREQ (which should be separated
  * eventually).
@@ -47,10 +144,10 @@
 stf_status emit_v2CERT(const struct connection *c, struct pbs_out *outpbs)
 {
 	const struct cert *mycert = c->local->config->host.cert.nss_cert != NULL ? &c->local->config->host.cert : NULL;
-	bool send_authcerts = c->send_ca != CA_SEND_NONE;
-	bool send_full_chain = send_authcerts && c->send_ca == CA_SEND_ALL;
 
 	if (impair.send_pkcs7_thingie) {
+		bool send_authcerts = c->send_ca != CA_SEND_NONE;
+		bool send_full_chain = send_authcerts && c->send_ca == CA_SEND_ALL;
 		llog(RC_LOG, outpbs->outs_logger, "IMPAIR: sending cert as PKCS7 blob");
 		passert(mycert != NULL);
 		SECItem *pkcs7 = nss_pkcs7_blob(mycert, send_full_chain);
@@ -73,59 +170,34 @@ stf_status emit_v2CERT(const struct connection *c, struct pbs_out *outpbs)
 		return STF_OK;
 	}
 
-	/*****
-	 * From here on, if send_authcerts, we are obligated to:
-	 * free_auth_chain(auth_chain, chain_len);
-	 *****/
-
-	chunk_t auth_chain[MAX_CA_PATH_LEN] = { { NULL, 0 } };
-	int chain_len = 0;
-
-	if (send_authcerts) {
-		chain_len = get_auth_chain(auth_chain, MAX_CA_PATH_LEN,
-					   mycert,
-					   send_full_chain ? true : false);
-	}
+	const struct v2_cert_payloads *payloads = v2_cert_payloads(mycert, c->send_ca);
 
 	const struct ikev2_cert certhdr = {
 		.isac_critical = build_ikev2_critical(false, outpbs->outs_logger),
 		.isac_enc = cert_ike_type(mycert),
 	};
 
-	/*   send own (Initiator CERT) */
-	{
+	/*
+	 * Send own (Initiator CERT) and then the optional chain
+	 * CERTs.
+	 */
+	for (unsigned i = 0; i < payloads->nr; i++) {
 		pb_stream cert_pbs;
 
-		dbg("sending [CERT] of certificate: %s", cert_nickname(mycert));
+		if (i == 0) {
+			dbg("sending [CERT] of certificate: %s", cert_nickname(mycert));
+		} else {
+			dbg("sending an authcert");
+		}
 
 		if (!out_struct(&certhdr, &ikev2_certificate_desc,
 				outpbs, &cert_pbs) ||
-		    !out_hunk(cert_der(mycert), &cert_pbs, "CERT")) {
-			free_auth_chain(auth_chain, chain_len);
+		    !out_hunk(payloads->body[i], &cert_pbs, "CERT")) {
 			return STF_INTERNAL_ERROR;
 		}
 
 		close_output_pbs(&cert_pbs);
 	}
-
-	/* send optional chain CERTs */
-	{
-		for (int i = 0; i < chain_len ; i++) {
-			pb_stream cert_pbs;
-
-			dbg("sending an authcert");
-
-			if (!out_struct(&certhdr, &ikev2_certificate_desc,
-				outpbs, &cert_pbs) ||
-			    !out_hunk(auth_chain[i], &cert_pbs, "CERT"))
-			{
-				free_auth_chain(auth_chain, chain_len);
-				return STF_INTERNAL_ERROR;
-			}
-			close_output_pbs(&cert_pbs);
-		}
-	}
-	free_auth_chain(auth_chain, chain_len);
 	return STF_OK;
 }
 
@@ -145,6 +217,11 @@ bool ikev2_send_cert_decision(const struct ike_sa *ike)
 		return false;
 	}
 
+	if (ike->sa.st_v2_resumption != NULL) {
+		dbg("IKEv2 CERT: not sending cert: resuming IKE SA using a ticket");
+		return false;
+	}
+
 	if (c->local->config->host.auth == AUTH_EAPONLY) {
 		dbg("IKEv2 CERT: not sending cert: local %sauth==EAPONLY",
 		    c->local->config->leftright)
@@ -22,6 +22,8 @@
 #ifndef IKEV2_CERT_H
 #define IKEV2_CERT_H
 
+#include <cert.h>	/* for CERTCertificate */
+
 #include "demux.h"	/* "for" pbs_out */
 
 struct ike_sa;
@@ -30,5 +32,6 @@ struct connection;
 
 bool ikev2_send_cert_decision(const struct ike_sa *ike);
 stf_status emit_v2CERT(const struct connection *c, struct pbs_out *outpbs);
+void forget_v2_cert_payloads(const CERTCertificate *cert);
 
 #endif
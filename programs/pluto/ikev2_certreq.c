@@ -277,6 +277,11 @@ bool need_v2CERTREQ_in_IKE_AUTH_request(const struct ike_sa *ike)
 
 	const struct connection *c = ike->sa.st_connection;
 
+	if (ike->sa.st_v2_resumption != NULL) {
+		dbg("IKEv2 CERTREQ: resuming IKE SA using a ticket; responder won't send a cert");
+		return false;
+	}
+
 	if (!authby_has_digsig(c->remote->config->host.authby)) {
 		dbg("IKEv2 CERTREQ: responder has no auth method requiring them to send back their cert");
 		return false;
@@ -31,8 +31,7 @@
 #include "rnd.h"
 #include "ikev2_cookie.h"
 #include "demux.h"
-#include "ike_alg_hash.h"	/* for sha2 */
-#include "crypt_hash.h"
+#include "siphash.h"
 #include "ikev2_send.h"
 #include "log.h"
 #include "state.h"
@@ -40,54 +39,77 @@
 #include "ikev2_ike_sa_init.h"
 
 /*
- * That the cookie size of 32-bytes happens to match
- * SHA2_256_DIGEST_SIZE is just a happy coincidence.
+ * Cookie = <VersionIDofSecret> | MAC(<secret>, IPi | SPIi)
+ *
+ * The MAC is SipHash-2-4 so computing a cookie involves no NSS
+ * context and no allocation.
+ *
+ * Unlike the RFC 7296 2.6 example, Ni is not included.  This means
+ * that the cookie, which is always the first payload, can be checked
+ * before the rest of the message is decoded: under a flood, an
+ * IKE_SA_INIT without a valid cookie costs one MAC and, at most, one
+ * N(COOKIE) response.  What the cookie proves, that the initiator
+ * can receive at IPi, is unchanged.
+ *
+ * Two secrets are kept: the current one, used to create cookies, and
+ * the previous one.  <VersionIDofSecret> selects which of the two is
+ * used to check a returned cookie so that cookies issued just before
+ * the hourly refresh remain valid.
  */
+
 typedef struct {
-	uint8_t bytes[32];
+	uint8_t version;
+	struct siphash_mac mac;
 } v2_cookie_t;
 
-static v2_cookie_t v2_cookie_secret;
+struct v2_cookie_secret {
+	bool valid;
+	uint8_t version;
+	struct siphash_key key;
+};
+
+static struct v2_cookie_secret v2_cookie_secrets[2]; /* [0] is current */
 
 void refresh_v2_cookie_secret(void)
 {
-	get_rnd_bytes(&v2_cookie_secret, sizeof(v2_cookie_secret));
+	v2_cookie_secrets[1] = v2_cookie_secrets[0];
+	struct v2_cookie_secret *current = &v2_cookie_secrets[0];
+	current->valid = true;
+	current->version++;
+	get_rnd_bytes(&current->key, sizeof(current->key));
 	if (DBGP(DBG_CRYPT)) {
-		DBG_dump_thing("v2_cookie_secret", v2_cookie_secret);
+		DBG_log("v2_cookie_secret version %u", current->version);
+		DBG_dump_thing("v2_cookie_secret", current->key);
 	}
 }
 
-/*
- * Cookie = <VersionIDofSecret> | Hash(Ni | IPi | SPIi | <secret>)
- * where <secret> is a randomly generated secret known only to us
- *
- * Our implementation does not use <VersionIDofSecret> which means
- * once a day and while under DOS attack, we could fail a few cookies
- * until the peer restarts from scratch.
- */
-static bool compute_v2_cookie_from_md(v2_cookie_t *cookie,
-				      struct msg_digest *md,
-				      shunk_t Ni)
+static const struct v2_cookie_secret *v2_cookie_secret_by_version(uint8_t version)
 {
-	struct crypt_hash *ctx = crypt_hash_init("IKEv2 COOKIE",
-						 &ike_alg_hash_sha2_256,
-						 md->md_logger);
-
-	crypt_hash_digest_hunk(ctx, "Ni", Ni);
+	FOR_EACH_ELEMENT(secret, v2_cookie_secrets) {
+		if (secret->valid && secret->version == version) {
+			return secret;
+		}
+	}
+	return NULL;
+}
 
+static v2_cookie_t compute_v2_cookie_from_md(const struct v2_cookie_secret *secret,
+					     const struct msg_digest *md)
+{
 	ip_address sender = endpoint_address(md->sender);
 	shunk_t IPi = address_as_shunk(&sender);
-	crypt_hash_digest_hunk(ctx, "IPi", IPi);
-
-	crypt_hash_digest_thing(ctx, "SPIi", md->hdr.isa_ike_initiator_spi);
-
-	crypt_hash_digest_thing(ctx, "<secret>", v2_cookie_secret);
 
-	/* happy coincidence? */
-	pexpect(sizeof(cookie->bytes) == SHA2_256_DIGEST_SIZE);
-	crypt_hash_final_bytes(&ctx, cookie->bytes, sizeof(cookie->bytes));
+	/* IPi | SPIi */
+	uint8_t input[sizeof(struct ip_bytes) + IKE_SA_SPI_SIZE];
+	passert(IPi.len <= sizeof(struct ip_bytes));
+	memcpy(input, IPi.ptr, IPi.len);
+	memcpy(input + IPi.len, md->hdr.isa_ike_initiator_spi.bytes, IKE_SA_SPI_SIZE);
 
-	return true;
+	v2_cookie_t cookie = {
+		.version = secret->version,
+		.mac = siphash_2_4(&secret->key, shunk2(input, IPi.len + IKE_SA_SPI_SIZE)),
+	};
+	return cookie;
 }
 
 bool v2_rejected_initiator_cookie(struct msg_digest *md,
@@ -104,61 +126,52 @@ bool v2_rejected_initiator_cookie(struct msg_digest *md,
 	/*
 	 * Expect the cookie notification to be first, and don't
 	 * bother checking for things like duplicates.
-	 */
-	struct payload_digest *cookie_digest = NULL;
-	if (md->hdr.isa_np == ISAKMP_NEXT_v2N &&
-	    pexpect(md->chain[ISAKMP_NEXT_v2N] != NULL) &&
-	    md->chain[ISAKMP_NEXT_v2N]->payload.v2n.isan_type == v2N_COOKIE) {
-		cookie_digest = md->chain[ISAKMP_NEXT_v2N];
-		pexpect(cookie_digest == md->pd[PD_v2N_COOKIE]);
-	}
-	if (!me_want_cookie && cookie_digest == NULL) {
-		dbg("DDOS disabled and no cookie sent, continuing");
-		return false; /* all ok!?! */
-	}
-	pexpect(me_want_cookie || cookie_digest != NULL);
-
-	/*
-	 * Paranoid mode is on - either DDOS or there's a cookie (or
-	 * both).  So need to compute a cookie, but to do that v2Ni is
-	 * needed ...
-	 *
-	 * Annoyingly this is the only reason why the payload needs to
-	 * be parsed - the cookie is first so parsing the full packet
-	 * shouldn't be needed.
 	 *
-	 * RFC 5996 Section 2.10 Nonces used in IKEv2 MUST be randomly
-	 * chosen, MUST be at least 128 bits in size, and MUST be at
-	 * least half the key size of the negotiated pseudorandom
-	 * function (PRF) (We can check for minimum 128bit length).
+	 * This is called before the message is decoded so peek at
+	 * the first payload using a copy of the message PBS.
 	 */
-	if (md->chain[ISAKMP_NEXT_v2Ni] == NULL) {
-		rate_log(md, "DDOS cookie requires Ni paylod - dropping message");
-		return true; /* reject cookie */
-	}
-	shunk_t Ni = pbs_in_left_as_shunk(&md->chain[ISAKMP_NEXT_v2Ni]->pbs);
-	if (Ni.len < IKEv2_MINIMUM_NONCE_SIZE || IKEv2_MAXIMUM_NONCE_SIZE < Ni.len) {
-		rate_log(md, "DOS cookie failed as Ni payload invalid - dropping message");
-		return true; /* reject cookie */
+	bool have_cookie = false;
+	struct ikev2_notify cookie_header;
+	shunk_t remote_cookie = null_shunk;
+	if (md->hdr.isa_np == ISAKMP_NEXT_v2N) {
+		struct pbs_in message_pbs = md->message_pbs;
+		struct pbs_in notify_pbs;
+		diag_t d = pbs_in_struct(&message_pbs, &ikev2_notify_desc,
+					 &cookie_header, sizeof(cookie_header),
+					 &notify_pbs);
+		if (d != NULL) {
+			pfree_diag(&d);
+			if (me_want_cookie) {
+				rate_log(md, "DOS cookie notification corrupt, or invalid - dropping message");
+				return true; /* reject cookie */
+			}
+			/* leave it to the decoder to complain */
+			return false;
+		}
+		if (cookie_header.isan_type == v2N_COOKIE) {
+			have_cookie = true;
+			remote_cookie = pbs_in_left_as_shunk(&notify_pbs);
+		}
 	}
 
-	/* Most code paths require our cookie, compute it. */
-	v2_cookie_t my_cookie;
-	if (!compute_v2_cookie_from_md(&my_cookie, md, Ni)) {
-		return true; /* reject cookie */
+	if (!me_want_cookie && !have_cookie) {
+		dbg("DDOS disabled and no cookie sent, continuing");
+		return false; /* all ok!?! */
 	}
-	shunk_t local_cookie = shunk2(&my_cookie, sizeof(my_cookie));
+	pexpect(me_want_cookie || have_cookie);
 
 	/* No cookie? demand one */
-	if (me_want_cookie && cookie_digest == NULL) {
+	if (me_want_cookie && !have_cookie) {
+		v2_cookie_t my_cookie = compute_v2_cookie_from_md(&v2_cookie_secrets[0], md);
+		shunk_t local_cookie = shunk2(&my_cookie, sizeof(my_cookie));
 		rate_log(md, "DOS mode on; responding to IKE_SA_INIT with cookie notification request");
 		send_v2N_response_from_md(md, v2N_COOKIE, &local_cookie);
 		return true; /* reject cookie */
 	}
 
-	/* done: !me_want_cookie && cookie_digest == NULL */
-	/* done: me_want_cookie && cookie_digest == NULL */
-	passert(cookie_digest != NULL);
+	/* done: !me_want_cookie && !have_cookie */
+	/* done: me_want_cookie && !have_cookie */
+	passert(have_cookie);
 
 	/*
 	 * Check that the cookie notification is well constructed.
@@ -167,14 +180,23 @@ bool v2_rejected_initiator_cookie(struct msg_digest *md,
 	 * Since they payload is understood ISAKMP_PAYLOAD_CRITICAL
 	 * should be ignored.
 	 */
-	struct ikev2_notify *cookie_header = &cookie_digest->payload.v2n;
-	if (cookie_header->isan_protoid != 0 ||
-	    cookie_header->isan_spisize != 0 ||
-	    cookie_header->isan_length != sizeof(v2_cookie_t) + sizeof(struct ikev2_notify)) {
+	if (cookie_header.isan_protoid != 0 ||
+	    cookie_header.isan_spisize != 0 ||
+	    cookie_header.isan_length != sizeof(v2_cookie_t) + sizeof(struct ikev2_notify)) {
 		rate_log(md, "DOS cookie notification corrupt, or invalid - dropping message");
 		return true; /* reject cookie */
 	}
-	shunk_t remote_cookie = pbs_in_left_as_shunk(&cookie_digest->pbs);
+
+	const uint8_t *version = remote_cookie.ptr;
+	const struct v2_cookie_secret *secret = v2_cookie_secret_by_version(*version);
+	if (secret == NULL) {
+		rate_log(md, "DOS cookie secret version %u has expired - dropping message",
+			 *version);
+		return true; /* reject cookie */
+	}
+
+	v2_cookie_t my_cookie = compute_v2_cookie_from_md(secret, md);
+	shunk_t local_cookie = shunk2(&my_cookie, sizeof(my_cookie));
 
 	if (DBGP(DBG_BASE)) {
 		DBG_dump_hunk("received cookie", remote_cookie);
@@ -192,10 +214,7 @@ bool v2_rejected_initiator_cookie(struct msg_digest *md,
 
 static stf_status resume_IKE_SA_INIT_with_cookie(struct ike_sa *ike)
 {
-	if (!record_v2_IKE_SA_INIT_request(ike)) {
-		return STF_INTERNAL_ERROR;
-	}
-	return STF_OK;
+	return record_v2_IKE_SA_INIT_request(ike, NULL, NULL);
 }
 
 stf_status process_v2_IKE_SA_INIT_response_v2N_COOKIE(struct ike_sa *ike,
@@ -150,7 +150,7 @@ static void emancipate_larval_ike_sa(struct ike_sa *old_ike, struct child_sa *ne
 	v2_migrate_children(old_ike, new_ike);
 
 	dbg("moving over any pending requests");
-	v2_msgid_migrate_queue(old_ike, new_ike);
+	v2_msgid_migrate_queue(old_ike, pexpect_ike_sa(&new_ike->sa));
 	v2_msgid_schedule_next_initiator(pexpect_ike_sa(&new_ike->sa));
 
 	/* complete the state transition */
@@ -440,7 +440,7 @@ struct child_sa *submit_v2_CREATE_CHILD_SA_rekey_child(struct ike_sa *ike,
 static void llog_v2_success_rekey_child_request(struct ike_sa *ike)
 {
 	/* XXX: should the lerval SA be a parameter? */
-	struct child_sa *larval = ike->sa.st_v2_msgid_windows.initiator.wip_sa;
+	struct child_sa *larval = ike->st_v2_msgid_windows.initiator.wip_sa;
 	if (larval != NULL) {
 #if 0
 		llog_sa(RC_NEW_V2_STATE + larval->sa.st_state->kind, larval,
@@ -492,7 +492,7 @@ stf_status initiate_v2_CREATE_CHILD_SA_rekey_child_request(struct ike_sa *ike,
 							   struct msg_digest *null_md UNUSED)
 {
 	struct connection *cc = larval_child->sa.st_connection;
-	pexpect(ike->sa.st_v2_msgid_windows.initiator.wip_sa == larval_child);
+	pexpect(ike->st_v2_msgid_windows.initiator.wip_sa == larval_child);
 
 	if (!ike->sa.st_viable_parent) {
 		/*
@@ -530,7 +530,7 @@ stf_status initiate_v2_CREATE_CHILD_SA_rekey_child_request(struct ike_sa *ike,
 			ike->sa.st_serialno, larval_child->sa.st_v2_rekey_pred);
 		larval_child->sa.st_policy = cc->policy; /* for pick_initiator */
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
+		ike->st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
 		return STF_OK; /* IKE */
 	}
 
@@ -562,7 +562,7 @@ stf_status initiate_v2_CREATE_CHILD_SA_rekey_child_request(struct ike_sa *ike,
 
 	if (!prep_v2_child_for_request(larval_child)) {
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
+		ike->st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
 		return STF_OK; /* IKE */
 	}
 
@@ -640,7 +640,7 @@ stf_status process_v2_CREATE_CHILD_SA_rekey_child_request(struct ike_sa *ike,
 					  ike, IPSEC_SA, SA_RESPONDER,
 					  STATE_V2_REKEY_CHILD_R0,
 					  null_fd);
-	ike->sa.st_v2_msgid_windows.responder.wip_sa = larval_child;
+	ike->st_v2_msgid_windows.responder.wip_sa = larval_child;
 	larval_child->sa.st_v2_rekey_pred = predecessor->sa.st_serialno;
 	larval_child->sa.st_v2_create_child_sa_proposals =
 		get_v2_CREATE_CHILD_SA_rekey_child_proposals(ike,
@@ -652,7 +652,7 @@ stf_status process_v2_CREATE_CHILD_SA_rekey_child_request(struct ike_sa *ike,
 				    v2N_TS_UNACCEPTABLE, NULL/*no data*/,
 				    ENCRYPTED_PAYLOAD);
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return STF_OK; /*IKE*/
 	}
 
@@ -711,7 +711,7 @@ void submit_v2_CREATE_CHILD_SA_new_child(struct ike_sa *ike,
 static void llog_v2_success_new_child_request(struct ike_sa *ike)
 {
 	/* XXX: should the lerval SA be a parameter? */
-	struct child_sa *larval = ike->sa.st_v2_msgid_windows.initiator.wip_sa;
+	struct child_sa *larval = ike->st_v2_msgid_windows.initiator.wip_sa;
 	if (larval != NULL) {
 #if 0
 		llog_sa(RC_NEW_V2_STATE + larval->sa.st_state->kind, larval,
@@ -762,7 +762,7 @@ stf_status initiate_v2_CREATE_CHILD_SA_new_child_request(struct ike_sa *ike,
 							 struct child_sa *larval_child,
 							 struct msg_digest *null_md UNUSED)
 {
-	pexpect(ike->sa.st_v2_msgid_windows.initiator.wip_sa == larval_child);
+	pexpect(ike->st_v2_msgid_windows.initiator.wip_sa == larval_child);
 
 	if (!ike->sa.st_viable_parent) {
 		/*
@@ -789,7 +789,7 @@ stf_status initiate_v2_CREATE_CHILD_SA_new_child_request(struct ike_sa *ike,
 			ike->sa.st_serialno);
 		larval_child->sa.st_policy = larval_child->sa.st_connection->policy; /* for pick_initiator */
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
+		ike->st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
 		return STF_OK; /* IKE */
 	}
 
@@ -836,7 +836,7 @@ stf_status process_v2_CREATE_CHILD_SA_new_child_request(struct ike_sa *ike,
 					  ike, IPSEC_SA, SA_RESPONDER,
 					  STATE_V2_NEW_CHILD_R0,
 					  null_fd);
-	ike->sa.st_v2_msgid_windows.responder.wip_sa = larval_child;
+	ike->st_v2_msgid_windows.responder.wip_sa = larval_child;
 	larval_child->sa.st_v2_create_child_sa_proposals =
 		get_v2_CREATE_CHILD_SA_new_child_proposals(ike, larval_child);
 
@@ -849,7 +849,7 @@ stf_status process_v2_CREATE_CHILD_SA_new_child_request(struct ike_sa *ike,
 		record_v2N_response(larval_child->sa.st_logger, ike, md,
 				    n, NULL/*no-data*/, ENCRYPTED_PAYLOAD);
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return STF_OK; /*IKE*/
 	}
 
@@ -881,7 +881,7 @@ stf_status process_v2_CREATE_CHILD_SA_request(struct ike_sa *ike,
 				    v2N_INVALID_SYNTAX, NULL/*no-data*/,
 				    ENCRYPTED_PAYLOAD);
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return STF_FATAL; /* invalid syntax means we're dead */
 	}
 
@@ -893,7 +893,7 @@ stf_status process_v2_CREATE_CHILD_SA_request(struct ike_sa *ike,
 		record_v2N_response(ike->sa.st_logger, ike, md,
 				    n, NULL/*no-data*/, ENCRYPTED_PAYLOAD);
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return v2_notification_fatal(n) ? STF_FATAL : STF_OK; /*IKE*/
 	}
 
@@ -912,7 +912,7 @@ stf_status process_v2_CREATE_CHILD_SA_request(struct ike_sa *ike,
 			record_v2N_response(larval_child->sa.st_logger, ike, md, v2N_INVALID_SYNTAX,
 					    NULL/*no data*/, ENCRYPTED_PAYLOAD);
 			delete_state(&larval_child->sa);
-			ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+			ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 			return STF_OK; /*IKE*/
 		}
 	}
@@ -942,7 +942,7 @@ static stf_status process_v2_CREATE_CHILD_SA_request_continue_1(struct state *ik
 		return STF_INTERNAL_ERROR;
 	}
 
-	struct child_sa *larval_child = ike->sa.st_v2_msgid_windows.responder.wip_sa;
+	struct child_sa *larval_child = ike->st_v2_msgid_windows.responder.wip_sa;
 	pexpect(v2_msg_role(request_md) == MESSAGE_REQUEST); /* i.e., MD!=NULL */
 	pexpect(larval_child->sa.st_sa_role == SA_RESPONDER);
 	dbg("%s() for #%lu %s",
@@ -986,7 +986,7 @@ static stf_status process_v2_CREATE_CHILD_SA_request_continue_2(struct state *ik
 		return STF_OK; /*IKE*/
 	}
 
-	struct child_sa *larval_child = ike->sa.st_v2_msgid_windows.responder.wip_sa;
+	struct child_sa *larval_child = ike->st_v2_msgid_windows.responder.wip_sa;
 	passert(v2_msg_role(request_md) == MESSAGE_REQUEST); /* i.e., MD!=NULL */
 	passert(larval_child->sa.st_sa_role == SA_RESPONDER);
 	dbg("%s() for #%lu %s",
@@ -1006,7 +1006,7 @@ static stf_status process_v2_CREATE_CHILD_SA_request_continue_2(struct state *ik
 				    v2N_INVALID_SYNTAX, NULL,
 				    ENCRYPTED_PAYLOAD);
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return STF_FATAL; /* kill IKE family */
 	}
 
@@ -1017,7 +1017,7 @@ static stf_status process_v2_CREATE_CHILD_SA_request_continue_2(struct state *ik
 stf_status process_v2_CREATE_CHILD_SA_request_continue_3(struct ike_sa *ike,
 							 struct msg_digest *request_md)
 {
-	struct child_sa *larval_child = ike->sa.st_v2_msgid_windows.responder.wip_sa;
+	struct child_sa *larval_child = ike->st_v2_msgid_windows.responder.wip_sa;
 	passert(v2_msg_role(request_md) == MESSAGE_REQUEST); /* i.e., MD!=NULL */
 	passert(larval_child->sa.st_sa_role == SA_RESPONDER);
 	pexpect(larval_child->sa.st_state->kind == STATE_V2_NEW_CHILD_R0 ||
@@ -1048,7 +1048,7 @@ stf_status process_v2_CREATE_CHILD_SA_request_continue_3(struct ike_sa *ike,
 		record_v2N_response(larval_child->sa.st_logger, ike, request_md,
 				    n, NULL/*no-data*/, ENCRYPTED_PAYLOAD);
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return v2_notification_fatal(n) ? STF_FATAL : STF_OK; /*IKE*/
 	}
 
@@ -1074,7 +1074,7 @@ stf_status process_v2_CREATE_CHILD_SA_child_response(struct ike_sa *ike,
 	pexpect(ike != NULL);
 
 	pexpect(larval_child == NULL);
-	larval_child = ike->sa.st_v2_msgid_windows.initiator.wip_sa;
+	larval_child = ike->st_v2_msgid_windows.initiator.wip_sa;
 	if (!pexpect(larval_child != NULL)) {
 		/* XXX: drop everything on the floor */
 		return STF_INTERNAL_ERROR;
@@ -1123,7 +1123,7 @@ stf_status process_v2_CREATE_CHILD_SA_child_response(struct ike_sa *ike,
 		 * exchange.
 		 */
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
+		ike->st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
 		return STF_OK; /* IKE */
 	}
 
@@ -1143,7 +1143,7 @@ stf_status process_v2_CREATE_CHILD_SA_child_response(struct ike_sa *ike,
 			 * exchange.
 			 */
 			delete_state(&larval_child->sa);
-			ike->sa.st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
+			ike->st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
 			return STF_OK; /* IKE */
 		}
 		/*
@@ -1173,7 +1173,7 @@ stf_status process_v2_CREATE_CHILD_SA_child_response(struct ike_sa *ike,
 		 * XXX: Initiator; need to initiate a delete exchange.
 		 */
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
+		ike->st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
 		return STF_OK; /* IKE */
 	}
 
@@ -1193,7 +1193,7 @@ static stf_status process_v2_CREATE_CHILD_SA_child_response_continue_1(struct st
 		return STF_INTERNAL_ERROR;
 	}
 
-	struct child_sa *larval_child = ike->sa.st_v2_msgid_windows.initiator.wip_sa;
+	struct child_sa *larval_child = ike->st_v2_msgid_windows.initiator.wip_sa;
 	if (!pexpect(larval_child != NULL)) {
 		/* XXX: drop everything on the floor */
 		return STF_INTERNAL_ERROR;
@@ -1218,7 +1218,7 @@ static stf_status process_v2_CREATE_CHILD_SA_child_response_continue_1(struct st
 		 * XXX: initiator; need to initiate a delete exchange.
 		 */
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
+		ike->st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
 		return STF_OK; /* IKE */
 	}
 
@@ -1237,7 +1237,7 @@ static stf_status process_v2_CREATE_CHILD_SA_child_response_continue_1(struct st
 		 * XXX: initiator; need to intiate a delete exchange.
 		 */
 		delete_state(&larval_child->sa);
-		ike->sa.st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
+		ike->st_v2_msgid_windows.initiator.wip_sa = larval_child = NULL;
 		return STF_OK; /* IKE */
 	}
 
@@ -1306,7 +1306,7 @@ struct child_sa *submit_v2_CREATE_CHILD_SA_rekey_ike(struct ike_sa *ike)
 static void llog_v2_success_rekey_ike_request(struct ike_sa *ike)
 {
 	/* XXX: should the lerval SA be a parameter? */
-	struct child_sa *larval = ike->sa.st_v2_msgid_windows.initiator.wip_sa;
+	struct child_sa *larval = ike->st_v2_msgid_windows.initiator.wip_sa;
 	if (larval != NULL) {
 		pexpect(larval->sa.st_v2_rekey_pred == ike->sa.st_serialno);
 #if 0
@@ -1367,7 +1367,7 @@ stf_status initiate_v2_CREATE_CHILD_SA_rekey_ike_request(struct ike_sa *ike,
 
 	ike->sa.st_viable_parent = false;
 
-	pexpect(ike->sa.st_v2_msgid_windows.initiator.wip_sa == larval_ike);
+	pexpect(ike->st_v2_msgid_windows.initiator.wip_sa == larval_ike);
 
 	if (!record_v2_rekey_ike_message(ike, larval_ike, null_md)) {
 		return STF_INTERNAL_ERROR;
@@ -1395,7 +1395,7 @@ stf_status process_v2_CREATE_CHILD_SA_rekey_ike_request(struct ike_sa *ike,
 					ike, IKE_SA, SA_RESPONDER,
 					STATE_V2_REKEY_IKE_R0,
 					null_fd);
-	ike->sa.st_v2_msgid_windows.responder.wip_sa = larval_ike;
+	ike->st_v2_msgid_windows.responder.wip_sa = larval_ike;
 	larval_ike->sa.st_v2_rekey_pred = ike->sa.st_serialno;
 
 	struct connection *c = larval_ike->sa.st_connection;
@@ -1415,7 +1415,7 @@ stf_status process_v2_CREATE_CHILD_SA_rekey_ike_request(struct ike_sa *ike,
 				    v2N_INVALID_SYNTAX, NULL/*no-data*/,
 				    ENCRYPTED_PAYLOAD);
 		delete_state(&larval_ike->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return STF_FATAL; /* IKE family is doomed */
 	}
 
@@ -1436,7 +1436,7 @@ stf_status process_v2_CREATE_CHILD_SA_rekey_ike_request(struct ike_sa *ike,
 		record_v2N_response(larval_ike->sa.st_logger, ike, request_md,
 				    n, NULL, ENCRYPTED_PAYLOAD);
 		delete_state(&larval_ike->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return v2_notification_fatal(n) ? STF_FATAL : STF_OK; /* IKE */
 	}
 
@@ -1450,7 +1450,7 @@ stf_status process_v2_CREATE_CHILD_SA_rekey_ike_request(struct ike_sa *ike,
 		llog_sa(RC_LOG_SERIOUS, larval_ike,
 			"IKE responder accepted an unsupported algorithm");
 		delete_state(&larval_ike->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return STF_FATAL; /* IKE family is doomed */
 	}
 
@@ -1459,7 +1459,7 @@ stf_status process_v2_CREATE_CHILD_SA_rekey_ike_request(struct ike_sa *ike,
 				       ENCRYPTED_PAYLOAD)) {
 		/* passert(reply-recorded) */
 		delete_state(&larval_ike->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return STF_OK; /* IKE */
 	}
 
@@ -1478,7 +1478,7 @@ stf_status process_v2_CREATE_CHILD_SA_rekey_ike_request(struct ike_sa *ike,
 				    v2N_INVALID_SYNTAX, NULL/*no data*/,
 				    ENCRYPTED_PAYLOAD);
 		delete_state(&larval_ike->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return STF_FATAL; /* IKE family is doomed */
 	}
 
@@ -1502,7 +1502,7 @@ static stf_status process_v2_CREATE_CHILD_SA_rekey_ike_request_continue_1(struct
 		return STF_INTERNAL_ERROR;
 	}
 
-	struct child_sa *larval_ike = ike->sa.st_v2_msgid_windows.responder.wip_sa; /* not yet emancipated */
+	struct child_sa *larval_ike = ike->st_v2_msgid_windows.responder.wip_sa; /* not yet emancipated */
 	pexpect(larval_ike->sa.st_sa_role == SA_RESPONDER);
 	pexpect(larval_ike->sa.st_state->kind == STATE_V2_REKEY_IKE_R0);
 	dbg("%s() for #%lu %s",
@@ -1539,7 +1539,7 @@ static stf_status process_v2_CREATE_CHILD_SA_rekey_ike_request_continue_2(struct
 	}
 
 	/* Just checking this is the rekey IKE SA responder */
-	struct child_sa *larval_ike = ike->sa.st_v2_msgid_windows.responder.wip_sa; /* not yet emancipated */
+	struct child_sa *larval_ike = ike->st_v2_msgid_windows.responder.wip_sa; /* not yet emancipated */
 	if (!pexpect(larval_ike != NULL)) {
 		/* XXX: drop everything on the floor */
 		return STF_INTERNAL_ERROR;
@@ -1558,7 +1558,7 @@ static stf_status process_v2_CREATE_CHILD_SA_rekey_ike_request_continue_2(struct
 				    v2N_INVALID_SYNTAX, NULL,
 				    ENCRYPTED_PAYLOAD);
 		delete_state(&larval_ike->sa);
-		ike->sa.st_v2_msgid_windows.responder.wip_sa = NULL;
+		ike->st_v2_msgid_windows.responder.wip_sa = NULL;
 		return STF_FATAL; /* IKE family is doomed */
 	}
 
@@ -1586,7 +1586,7 @@ stf_status process_v2_CREATE_CHILD_SA_rekey_ike_response(struct ike_sa *ike,
 	v2_notification_t n;
 	pexpect(ike != NULL);
 	pexpect(larval_ike == NULL);
-	larval_ike = ike->sa.st_v2_msgid_windows.initiator.wip_sa;
+	larval_ike = ike->st_v2_msgid_windows.initiator.wip_sa;
 	if (!pexpect(larval_ike != NULL)) {
 		/* XXX: drop everything on the floor */
 		return STF_INTERNAL_ERROR;
@@ -1636,7 +1636,7 @@ stf_status process_v2_CREATE_CHILD_SA_rekey_ike_response(struct ike_sa *ike,
 	if (n != v2N_NOTHING_WRONG) {
 		dbg("failed to accept IKE SA, REKEY, response, in process_v2_CREATE_CHILD_SA_rekey_ike_response");
 		delete_state(&larval_ike->sa);
-		ike->sa.st_v2_msgid_windows.initiator.wip_sa = larval_ike = NULL;
+		ike->st_v2_msgid_windows.initiator.wip_sa = larval_ike = NULL;
 		return STF_OK; /* IKE */
 	}
 
@@ -1690,7 +1690,7 @@ static stf_status process_v2_CREATE_CHILD_SA_rekey_ike_response_continue_1(struc
 		return STF_INTERNAL_ERROR;
 	}
 
-	struct child_sa *larval_ike = ike->sa.st_v2_msgid_windows.initiator.wip_sa; /* not yet emancipated */
+	struct child_sa *larval_ike = ike->st_v2_msgid_windows.initiator.wip_sa; /* not yet emancipated */
 	if (!pexpect(larval_ike != NULL)) {
 		/* XXX: drop everything on the floor */
 		return STF_INTERNAL_ERROR;
@@ -1740,7 +1740,7 @@ stf_status process_v2_CREATE_CHILD_SA_failure_response(struct ike_sa *ike,
 {
 	passert(ike != NULL);
 	passert(child == NULL);
-	child = ike->sa.st_v2_msgid_windows.initiator.wip_sa;
+	child = ike->st_v2_msgid_windows.initiator.wip_sa;
 	if (!pexpect(child != NULL)) {
 		/* XXX: drop everything on the floor */
 		return STF_INTERNAL_ERROR;
@@ -1766,7 +1766,7 @@ stf_status process_v2_CREATE_CHILD_SA_failure_response(struct ike_sa *ike,
 		child->sa.st_v2_transition->story);
 
 	delete_state(&child->sa);
-	ike->sa.st_v2_msgid_windows.initiator.wip_sa = child = NULL;
+	ike->st_v2_msgid_windows.initiator.wip_sa = child = NULL;
 
 	return STF_OK; /* IKE */
 }
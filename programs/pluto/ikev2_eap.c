@@ -202,6 +202,7 @@ void free_eap_state(struct eap_state **_eap)
 
 	if (eap->eaptls_desc) PR_Close(eap->eaptls_desc);
 	free_chunk_content(&eap->eaptls_chunk);
+	md_delref(&eap->sa_md);
 
 	pfree(eap);
 	*_eap = NULL;
@@ -500,9 +501,9 @@ static stf_status process_v2_IKE_AUTH_request_EAP_start_signature_continue(struc
 	/* send out the IDr payload */
 	{
 		pb_stream r_id_pbs;
-		if (!out_struct(&ike->sa.st_v2_id_payload.header,
+		if (!out_struct(&ike->st_v2_id_payload.header,
 				&ikev2_id_r_desc, response.pbs, &r_id_pbs) ||
-		    !out_hunk(ike->sa.st_v2_id_payload.data,
+		    !out_hunk(ike->st_v2_id_payload.data,
 				  &r_id_pbs, "my identity"))
 			return STF_INTERNAL_ERROR;
 		close_output_pbs(&r_id_pbs);
@@ -523,7 +524,7 @@ static stf_status process_v2_IKE_AUTH_request_EAP_start_signature_continue(struc
 	/* now send AUTH payload */
 	if (c->local->config->host.auth == AUTH_EAPONLY) {
 		dbg("EAP: skipping AUTH payload as our proof-of-identity is eap-only");
-	} else if (!emit_local_v2AUTH(ike, auth_sig, &ike->sa.st_v2_id_payload.mac, response.pbs)) {
+	} else if (!emit_local_v2AUTH(ike, auth_sig, &ike->st_v2_id_payload.mac, response.pbs)) {
 		return STF_INTERNAL_ERROR;
 	}
 
@@ -536,7 +537,7 @@ static stf_status process_v2_IKE_AUTH_request_EAP_start_signature_continue(struc
 	}
 
 	/* remember the original message with child sa etc. parameters */
-	ike->sa.st_eap_sa_md = md_addref(md);
+	ike->sa.st_eap->sa_md = md_addref(md);
 
 	return STF_OK;
 
@@ -630,10 +631,10 @@ stf_status process_v2_IKE_AUTH_request_EAP_final(struct ike_sa *ike,
 {
 	static const char key_pad_str[] = "client EAP encryption"; /* EAP-TLS RFC 5216 */
 	struct eap_state *eap = ike->sa.st_eap;
-	struct msg_digest *sa_md = ike->sa.st_eap_sa_md;
 	struct logger *logger = ike->sa.st_logger;
 
 	pexpect(eap != NULL);
+	struct msg_digest *sa_md = eap->sa_md;
 	pexpect(sa_md != NULL);
 
 	if (!eap->eap_established)
@@ -730,10 +731,10 @@ stf_status process_v2_IKE_AUTH_request_EAP_final(struct ike_sa *ike,
 
 	/* now send AUTH payload */
 
-	if (!emit_local_v2AUTH(ike, &msk, &ike->sa.st_v2_id_payload.mac, response.pbs)) {
+	if (!emit_local_v2AUTH(ike, &msk, &ike->st_v2_id_payload.mac, response.pbs)) {
 		return STF_INTERNAL_ERROR;
 	}
-	ike->sa.st_v2_ike_intermediate.used = false;
+	ike->st_v2_ike_intermediate.used = false;
 
 	/*
 	 * Try to build a child.
@@ -744,7 +745,7 @@ stf_status process_v2_IKE_AUTH_request_EAP_final(struct ike_sa *ike,
 	if (send_redirect) {
 		dbg("skipping child; redirect response");
 	} else {
-		v2_notification_t cn = process_v2_IKE_AUTH_request_child_sa_payloads(ike, ike->sa.st_eap_sa_md,
+		v2_notification_t cn = process_v2_IKE_AUTH_request_child_sa_payloads(ike, eap->sa_md,
 										     response.pbs);
 		if (v2_notification_fatal(cn)) {
 			record_v2N_response(ike->sa.st_logger, ike, md,
@@ -760,6 +761,6 @@ stf_status process_v2_IKE_AUTH_request_EAP_final(struct ike_sa *ike,
 		return STF_INTERNAL_ERROR;
 	}
 
-	md_delref(&ike->sa.st_eap_sa_md);
+	md_delref(&eap->sa_md);
 	return STF_OK;
 }
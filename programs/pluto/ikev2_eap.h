@@ -28,6 +28,8 @@ struct eap_state {
 	shunk_t        eaptls_inbuf;
 	chunk_t        eaptls_chunk;
 	uint32_t       eaptls_pos;
+
+	struct msg_digest *sa_md;	/* initial message with SA request */
 };
 
 extern void free_eap_state(struct eap_state **eap);
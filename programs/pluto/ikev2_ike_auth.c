@@ -63,6 +63,7 @@
 #include "kernel.h"			/* for install_sec_label_connection_policies() */
 #include "ikev2_delete.h"		/* for submit_v2_delete_exchange() */
 #include "ikev2_certreq.h"
+#include "ikev2_resume.h"
 
 static stf_status process_v2_IKE_AUTH_request_tail(struct state *st,
 						   struct msg_digest *md,
@@ -162,17 +163,17 @@ stf_status initiate_v2_IKE_AUTH_request(struct ike_sa *ike, struct msg_digest *m
 
 	{
 		shunk_t data;
-		ike->sa.st_v2_id_payload.header = build_v2_id_payload(&pc->spd.this, &data,
+		ike->st_v2_id_payload.header = build_v2_id_payload(&pc->spd.this, &data,
 								      "my IDi", ike->sa.st_logger);
-		ike->sa.st_v2_id_payload.data = clone_hunk(data, "my IDi");
+		ike->st_v2_id_payload.data = clone_hunk(data, "my IDi");
 	}
 
-	ike->sa.st_v2_id_payload.mac = v2_hash_id_payload("IDi", ike,
+	ike->st_v2_id_payload.mac = v2_hash_id_payload("IDi", ike,
 							  "st_skey_pi_nss",
 							  ike->sa.st_skey_pi_nss);
 	if (ike->sa.st_seen_ppk && !LIN(POLICY_PPK_INSIST, pc->policy)) {
 		/* ID payload that we've build is the same */
-		ike->sa.st_v2_id_payload.mac_no_ppk_auth =
+		ike->st_v2_id_payload.mac_no_ppk_auth =
 			v2_hash_id_payload("IDi (no-PPK)", ike,
 					   "sk_pi_no_pkk",
 					   ike->sa.st_sk_pi_no_ppk);
@@ -183,26 +184,26 @@ stf_status initiate_v2_IKE_AUTH_request(struct ike_sa *ike, struct msg_digest *m
 	switch (auth_method) {
 	case IKEv2_AUTH_RSA:
 		return submit_v2_IKE_AUTH_request_signature(ike,
-							    &ike->sa.st_v2_id_payload,
+							    &ike->st_v2_id_payload,
 							    &ike_alg_hash_sha1,
 							    &pubkey_signer_raw_pkcs1_1_5_rsa,
 							    initiate_v2_IKE_AUTH_request_signature_continue);
 
 	case IKEv2_AUTH_ECDSA_SHA2_256_P256:
 		return submit_v2_IKE_AUTH_request_signature(ike,
-							    &ike->sa.st_v2_id_payload,
+							    &ike->st_v2_id_payload,
 							    &ike_alg_hash_sha2_256,
 							    &pubkey_signer_raw_ecdsa/*_p256*/,
 							    initiate_v2_IKE_AUTH_request_signature_continue);
 	case IKEv2_AUTH_ECDSA_SHA2_384_P384:
 		return submit_v2_IKE_AUTH_request_signature(ike,
-							    &ike->sa.st_v2_id_payload,
+							    &ike->st_v2_id_payload,
 							    &ike_alg_hash_sha2_384,
 							    &pubkey_signer_raw_ecdsa/*_p384*/,
 							    initiate_v2_IKE_AUTH_request_signature_continue);
 	case IKEv2_AUTH_ECDSA_SHA2_512_P521:
 		return submit_v2_IKE_AUTH_request_signature(ike,
-							    &ike->sa.st_v2_id_payload,
+							    &ike->st_v2_id_payload,
 							    &ike_alg_hash_sha2_512,
 							    &pubkey_signer_raw_ecdsa/*_p521*/,
 							    initiate_v2_IKE_AUTH_request_signature_continue);
@@ -237,7 +238,7 @@ stf_status initiate_v2_IKE_AUTH_request(struct ike_sa *ike, struct msg_digest *m
 		ike->sa.st_v2_digsig.signer = signer;
 
 		return submit_v2_IKE_AUTH_request_signature(ike,
-							    &ike->sa.st_v2_id_payload,
+							    &ike->st_v2_id_payload,
 							    ike->sa.st_v2_digsig.hash,
 							    ike->sa.st_v2_digsig.signer,
 							    initiate_v2_IKE_AUTH_request_signature_continue);
@@ -317,11 +318,11 @@ stf_status initiate_v2_IKE_AUTH_request_signature_continue(struct ike_sa *ike,
 
 	{
 		pb_stream i_id_pbs;
-		if (!out_struct(&ike->sa.st_v2_id_payload.header,
+		if (!out_struct(&ike->st_v2_id_payload.header,
 				&ikev2_id_i_desc,
 				request.pbs,
 				&i_id_pbs) ||
-		    !out_hunk(ike->sa.st_v2_id_payload.data, &i_id_pbs, "my identity"))
+		    !out_hunk(ike->st_v2_id_payload.data, &i_id_pbs, "my identity"))
 			return STF_INTERNAL_ERROR;
 		close_output_pbs(&i_id_pbs);
 	}
@@ -396,7 +397,7 @@ stf_status initiate_v2_IKE_AUTH_request_signature_continue(struct ike_sa *ike,
 
 	/* send out the AUTH payload */
 
-	if (!emit_local_v2AUTH(ike, auth_sig, &ike->sa.st_v2_id_payload.mac, request.pbs)) {
+	if (!emit_local_v2AUTH(ike, auth_sig, &ike->st_v2_id_payload.mac, request.pbs)) {
 		return STF_INTERNAL_ERROR;
 	}
 
@@ -407,6 +408,14 @@ stf_status initiate_v2_IKE_AUTH_request_signature_continue(struct ike_sa *ike,
 		}
 	}
 
+	if (!emit_v2N_SET_WINDOW_SIZE(ike, request.pbs)) {
+		return STF_INTERNAL_ERROR;
+	}
+
+	if (!emit_v2N_TICKET_REQUEST(ike, request.pbs)) {
+		return STF_INTERNAL_ERROR;
+	}
+
 	/*
 	 * Now that the AUTH payload is done(?), create and emit the
 	 * child using the first pending connection (or the IKE SA's
@@ -435,7 +444,7 @@ stf_status initiate_v2_IKE_AUTH_request_signature_continue(struct ike_sa *ike,
 							    STATE_V2_IKE_AUTH_CHILD_I0,
 							    child_whackfd);
 		fd_delref(&child_whackfd);
-		ike->sa.st_v2_msgid_windows.initiator.wip_sa = child;
+		ike->st_v2_msgid_windows.initiator.wip_sa = child;
 
 		/*
 		 * XXX because the early child state ends up with the
@@ -506,7 +515,7 @@ stf_status initiate_v2_IKE_AUTH_request_signature_continue(struct ike_sa *ike,
 		close_output_pbs(&ppks);
 
 		if (!LIN(POLICY_PPK_INSIST, cc->policy)) {
-			if (!ikev2_calc_no_ppk_auth(ike, &ike->sa.st_v2_id_payload.mac_no_ppk_auth,
+			if (!ikev2_calc_no_ppk_auth(ike, &ike->st_v2_id_payload.mac_no_ppk_auth,
 						    &ike->sa.st_no_ppk_auth)) {
 				dbg("ikev2_calc_no_ppk_auth() failed dying");
 				return STF_FATAL;
@@ -527,18 +536,19 @@ stf_status initiate_v2_IKE_AUTH_request_signature_continue(struct ike_sa *ike,
 	 * NULL_AUTH in separate chunk. This is only done on the
 	 * initiator in IKE_AUTH, and not repeated in rekeys.
 	 */
-	if (authby_has_digsig(pc->local->config->host.authby) &&
+	if (ike->sa.st_v2_resumption == NULL &&
+	    authby_has_digsig(pc->local->config->host.authby) &&
 	    pc->local->config->host.authby.null) {
 		/* store in null_auth */
 		chunk_t null_auth = NULL_HUNK;
 		if (!ikev2_create_psk_auth(AUTH_NULL, ike,
-					   &ike->sa.st_v2_id_payload.mac,
+					   &ike->st_v2_id_payload.mac,
 					   &null_auth)) {
 			log_state(RC_LOG_SERIOUS, &ike->sa,
 				  "Failed to calculate additional NULL_AUTH");
 			return STF_FATAL;
 		}
-		ike->sa.st_v2_ike_intermediate.used = false;
+		ike->st_v2_ike_intermediate.used = false;
 		if (!emit_v2N_hunk(v2N_NULL_AUTH, null_auth, request.pbs)) {
 			free_chunk_content(&null_auth);
 			return STF_INTERNAL_ERROR;
@@ -728,6 +738,7 @@ stf_status process_v2_IKE_AUTH_request_standard_payloads(struct ike_sa *ike, str
 		    "and sent" : "while it did not sent");
 	}
 	ike->sa.st_ike_seen_v2n_initial_contact = md->pd[PD_v2N_INITIAL_CONTACT] != NULL;
+	process_v2N_SET_WINDOW_SIZE(ike, md);
 
 	/*
 	 * If we found proper PPK ID and policy allows PPK, use that.
@@ -949,18 +960,18 @@ stf_status generate_v2_responder_auth(struct ike_sa *ike, struct msg_digest *md,
 
 	if (ike->sa.st_peer_wants_null) {
 		/* make it the Null ID */
-		ike->sa.st_v2_id_payload.header.isai_type = ID_NULL;
-		ike->sa.st_v2_id_payload.data = empty_chunk;
+		ike->st_v2_id_payload.header.isai_type = ID_NULL;
+		ike->st_v2_id_payload.data = empty_chunk;
 	} else {
 		shunk_t data;
-		ike->sa.st_v2_id_payload.header = build_v2_id_payload(&c->spd.this, &data,
+		ike->st_v2_id_payload.header = build_v2_id_payload(&c->spd.this, &data,
 								      "my IDr",
 								      ike->sa.st_logger);
-		ike->sa.st_v2_id_payload.data = clone_hunk(data, "my IDr");
+		ike->st_v2_id_payload.data = clone_hunk(data, "my IDr");
 	}
 
 	/* will be signed in auth payload */
-	ike->sa.st_v2_id_payload.mac = v2_hash_id_payload("IDr", ike, "st_skey_pr_nss",
+	ike->st_v2_id_payload.mac = v2_hash_id_payload("IDr", ike, "st_skey_pr_nss",
 							  ike->sa.st_skey_pr_nss);
 
 	enum keyword_auth authby = local_v2_auth(ike);
@@ -969,26 +980,26 @@ stf_status generate_v2_responder_auth(struct ike_sa *ike, struct msg_digest *md,
 
 	case IKEv2_AUTH_RSA:
 		return submit_v2_IKE_AUTH_response_signature(ike, md,
-							     &ike->sa.st_v2_id_payload,
+							     &ike->st_v2_id_payload,
 							     &ike_alg_hash_sha1,
 							     &pubkey_signer_raw_pkcs1_1_5_rsa,
 							     auth_cb);
 
 	case IKEv2_AUTH_ECDSA_SHA2_256_P256:
 		return submit_v2_IKE_AUTH_response_signature(ike, md,
-							    &ike->sa.st_v2_id_payload,
+							    &ike->st_v2_id_payload,
 							    &ike_alg_hash_sha2_256,
 							    &pubkey_signer_raw_ecdsa/*_p256*/,
 							    auth_cb);
 	case IKEv2_AUTH_ECDSA_SHA2_384_P384:
 		return submit_v2_IKE_AUTH_response_signature(ike, md,
-							    &ike->sa.st_v2_id_payload,
+							    &ike->st_v2_id_payload,
 							    &ike_alg_hash_sha2_384,
 							    &pubkey_signer_raw_ecdsa/*_p384*/,
 							    auth_cb);
 	case IKEv2_AUTH_ECDSA_SHA2_512_P521:
 		return submit_v2_IKE_AUTH_response_signature(ike, md,
-							    &ike->sa.st_v2_id_payload,
+							    &ike->st_v2_id_payload,
 							    &ike_alg_hash_sha2_512,
 							    &pubkey_signer_raw_ecdsa/*_p521*/,
 							    auth_cb);
@@ -1048,7 +1059,7 @@ stf_status generate_v2_responder_auth(struct ike_sa *ike, struct msg_digest *md,
 		    ike->sa.st_v2_digsig.signer->name, signer_story);
 
 		return submit_v2_IKE_AUTH_response_signature(ike, md,
-							     &ike->sa.st_v2_id_payload,
+							     &ike->st_v2_id_payload,
 							     ike->sa.st_v2_digsig.hash,
 							     ike->sa.st_v2_digsig.signer, auth_cb);
 	}
@@ -1218,11 +1229,19 @@ static stf_status process_v2_IKE_AUTH_request_auth_signature_continue(struct ike
 			return STF_INTERNAL_ERROR;
 	}
 
+	if (!emit_v2N_SET_WINDOW_SIZE(ike, response.pbs)) {
+		return STF_INTERNAL_ERROR;
+	}
+
 	if (ike->sa.st_ppk_used) {
 		if (!emit_v2N(v2N_PPK_IDENTITY, response.pbs))
 			return STF_INTERNAL_ERROR;
 	}
 
+	if (!emit_v2N_TICKET_LT_OPAQUE(ike, md, response.pbs)) {
+		return STF_INTERNAL_ERROR;
+	}
+
 	/*
 	 * A redirect does not tear down the IKE SA; instead that is
 	 * left to the initiator:
@@ -1244,9 +1263,9 @@ static stf_status process_v2_IKE_AUTH_request_auth_signature_continue(struct ike
 	/* send out the IDr payload */
 	{
 		pb_stream r_id_pbs;
-		if (!out_struct(&ike->sa.st_v2_id_payload.header,
+		if (!out_struct(&ike->st_v2_id_payload.header,
 				&ikev2_id_r_desc, response.pbs, &r_id_pbs) ||
-		    !out_hunk(ike->sa.st_v2_id_payload.data,
+		    !out_hunk(ike->st_v2_id_payload.data,
 				  &r_id_pbs, "my identity"))
 			return STF_INTERNAL_ERROR;
 		close_output_pbs(&r_id_pbs);
@@ -1266,10 +1285,10 @@ static stf_status process_v2_IKE_AUTH_request_auth_signature_continue(struct ike
 
 	/* now send AUTH payload */
 
-	if (!emit_local_v2AUTH(ike, auth_sig, &ike->sa.st_v2_id_payload.mac, response.pbs)) {
+	if (!emit_local_v2AUTH(ike, auth_sig, &ike->st_v2_id_payload.mac, response.pbs)) {
 		return STF_INTERNAL_ERROR;
 	}
-	ike->sa.st_v2_ike_intermediate.used = false;
+	ike->st_v2_ike_intermediate.used = false;
 
 	/*
 	 * Try to build a child.
@@ -1424,6 +1443,9 @@ static stf_status process_v2_IKE_AUTH_response_post_cert_decode(struct state *ik
 	change_v2_state(&ike->sa);
 	v2_ike_sa_established(ike);
 
+	/* so the next start can skip IKE_SA_INIT */
+	save_v2_resumption_ticket(ike, md);
+
 	/*
 	 * IF there's a redirect, process it and return immediately.
 	 * Function gets to decide status.
@@ -1439,6 +1461,7 @@ static stf_status process_v2_IKE_AUTH_response_post_cert_decode(struct state *ik
 		    (ike->sa.st_ike_sent_v2n_mobike_supported ? "and sent" :
 		     "while it did not sent"));
 	}
+	process_v2N_SET_WINDOW_SIZE(ike, md);
 
 	/*
 	 * Keep the portal open ...
@@ -1495,8 +1518,8 @@ static stf_status process_v2_IKE_AUTH_response_post_cert_decode(struct state *ik
 		 * v2N_NOTHING_WRONG.  After all, problem solved.
 		 */
 		llog_sa(RC_LOG_SERIOUS, ike, "IKE SA established but initiator rejected Child SA response");
-		struct child_sa *larval_child = ike->sa.st_v2_msgid_windows.initiator.wip_sa;
-		ike->sa.st_v2_msgid_windows.initiator.wip_sa = NULL;
+		struct child_sa *larval_child = ike->st_v2_msgid_windows.initiator.wip_sa;
+		ike->st_v2_msgid_windows.initiator.wip_sa = NULL;
 		passert(larval_child != NULL);
 		/*
 		 * Needed to un-plug the pending queue.  Without this
@@ -1543,7 +1566,7 @@ stf_status process_v2_IKE_AUTH_failure_response(struct ike_sa *ike,
 						struct child_sa *unused_child UNUSED,
 						struct msg_digest *md)
 {
-	struct child_sa *child = ike->sa.st_v2_msgid_windows.initiator.wip_sa;
+	struct child_sa *child = ike->st_v2_msgid_windows.initiator.wip_sa;
 
 	/*
 	 * Mark IKE SA as failing.
@@ -223,7 +223,7 @@ stf_status initiate_v2_IKE_INTERMEDIATE_request(struct ike_sa *ike, struct msg_d
 	compute_intermediate_mac(ike, ike->sa.st_skey_pi_nss,
 				 request.sk.pbs.container->start,
 				 HUNK_AS_SHUNK(request.sk.cleartext) /* inner payloads */,
-				 &ike->sa.st_v2_ike_intermediate.initiator);
+				 &ike->st_v2_ike_intermediate.initiator);
 
 	if (!encrypt_v2SK_payload(&request.sk)) {
 		llog(RC_LOG, request.logger,
@@ -252,8 +252,8 @@ stf_status process_v2_IKE_INTERMEDIATE_request(struct ike_sa *ike,
 
 	/* save the most recent ID */
 
-	ike->sa.st_v2_ike_intermediate.id = md->hdr.isa_msgid;
-	if (ike->sa.st_v2_ike_intermediate.id > 2/*magic!*/) {
+	ike->st_v2_ike_intermediate.id = md->hdr.isa_msgid;
+	if (ike->st_v2_ike_intermediate.id > 2/*magic!*/) {
 		llog_sa(RC_LOG_SERIOUS, ike, "too many IKE_INTERMEDIATE exchanges");
 		return STF_FATAL;
 	}
@@ -270,7 +270,7 @@ stf_status process_v2_IKE_INTERMEDIATE_request(struct ike_sa *ike,
 	shunk_t plain = pbs_in_all_as_shunk(&md->chain[ISAKMP_NEXT_v2SK]->pbs);
 	compute_intermediate_mac(ike, ike->sa.st_skey_pi_nss,
 				 md->packet_pbs.start, plain,
-				 &ike->sa.st_v2_ike_intermediate.initiator);
+				 &ike->st_v2_ike_intermediate.initiator);
 
 	/*
 	 * Since systems are go, start updating the state, starting
@@ -304,7 +304,7 @@ stf_status process_v2_IKE_INTERMEDIATE_request(struct ike_sa *ike,
 	compute_intermediate_mac(ike, ike->sa.st_skey_pr_nss,
 				 response.sk.pbs.container->start,
 				 HUNK_AS_SHUNK(response.sk.cleartext) /* inner payloads */,
-				 &ike->sa.st_v2_ike_intermediate.responder);
+				 &ike->st_v2_ike_intermediate.responder);
 
 	if (!encrypt_v2SK_payload(&response.sk)) {
 		llog(RC_LOG, response.logger,
@@ -334,7 +334,7 @@ stf_status process_v2_IKE_INTERMEDIATE_response(struct ike_sa *ike,
 	struct connection *c = ike->sa.st_connection;
 
 	/* save the most recent ID */
-	ike->sa.st_v2_ike_intermediate.id = md->hdr.isa_msgid;
+	ike->st_v2_ike_intermediate.id = md->hdr.isa_msgid;
 
 	/*
 	 * Now that the payload has been decrypted, perform the
@@ -348,7 +348,7 @@ stf_status process_v2_IKE_INTERMEDIATE_response(struct ike_sa *ike,
 	shunk_t plain = pbs_in_all_as_shunk(&md->chain[ISAKMP_NEXT_v2SK]->pbs);
 	compute_intermediate_mac(ike, ike->sa.st_skey_pr_nss,
 				 md->packet_pbs.start, plain,
-				 &ike->sa.st_v2_ike_intermediate.responder);
+				 &ike->st_v2_ike_intermediate.responder);
 
 	/*
 	 * if this connection has a newer Child SA than this state
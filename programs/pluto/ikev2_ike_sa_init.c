@@ -57,11 +57,15 @@
 #include "pluto_stats.h"
 #include "ikev2_proposals.h"
 #include "ikev2_certreq.h"
+#include "ikev2_resume.h"
+#include "ikev2_ticket.h"		/* for free_v2_resumption() */
 
 static ke_and_nonce_cb initiate_v2_IKE_SA_INIT_request_continue;	/* type assertion */
 static dh_shared_secret_cb process_v2_request_no_skeyseed_continue;	/* type assertion */
 static dh_shared_secret_cb process_v2_IKE_SA_INIT_response_continue;	/* type assertion */
 static ke_and_nonce_cb process_v2_IKE_SA_INIT_request_continue;		/* forward decl and type assertion */
+static ke_and_nonce_cb initiate_v2_IKE_SESSION_RESUME_request_continue;	/* type assertion */
+static ke_and_nonce_cb process_v2_IKE_SESSION_RESUME_request_continue;	/* type assertion */
 
 void process_v2_IKE_SA_INIT(struct msg_digest *md)
 {
@@ -208,8 +212,8 @@ void process_v2_IKE_SA_INIT(struct msg_digest *md)
 			if (verbose_state_busy(&old->sa)) {
 				/* already logged */;
 			} else if (old->sa.st_state->kind == STATE_V2_PARENT_R1 &&
-				   old->sa.st_v2_msgid_windows.responder.recv == 0 &&
-				   old->sa.st_v2_msgid_windows.responder.sent == 0 &&
+				   old->st_v2_msgid_windows.responder.recv == 0 &&
+				   old->st_v2_msgid_windows.responder.sent == 0 &&
 				   hunk_eq(old->sa.st_firstpacket_peer,
 					   pbs_in_all_as_shunk(&md->message_pbs))) {
 				/*
@@ -249,7 +253,7 @@ void process_v2_IKE_SA_INIT(struct msg_digest *md)
 				 */
 				log_state(RC_LOG, &old->sa,
 					  "received too old retransmit: %jd < %jd",
-					  msgid, old->sa.st_v2_msgid_windows.responder.sent);
+					  msgid, old->st_v2_msgid_windows.responder.sent);
 			}
 			return;
 		}
@@ -263,15 +267,29 @@ void process_v2_IKE_SA_INIT(struct msg_digest *md)
 		/*
 		 * Always check for cookies!
 		 *
-		 * XXX: why?
-		 *
-		 * Because the v2N_COOKIE payload is first, parsing
-		 * and verifying it should be relatively quick and
-		 * cheap.  Right?
-		 *
-		 * No.  The equation uses v2Ni forcing the entire
-		 * payload to be parsed.
-		 *
+		 * Because the v2N_COOKIE payload is first, and the
+		 * cookie doesn't cover v2Ni, it is checked before the
+		 * rest of the message is decoded.  Under a flood this
+		 * is the only work done.
+		 */
+		if (md->hdr.isa_xchg == ISAKMP_v2_IKE_SESSION_RESUME) {
+			/*
+			 * RFC 5723 allows a COOKIE exchange here
+			 * too; instead reject the ticket so that the
+			 * initiator falls back to IKE_SA_INIT (which
+			 * gets the cookie).
+			 */
+			if (require_ddos_cookies()) {
+				dbg("pluto is overloaded and demanding cookies; rejecting IKE_SESSION_RESUME");
+				send_v2N_response_from_md(md, v2N_TICKET_NACK, NULL);
+				return;
+			}
+		} else if (v2_rejected_initiator_cookie(md, require_ddos_cookies())) {
+			dbg("pluto is overloaded and demanding cookies; dropping new exchange");
+			return;
+		}
+
+		/*
 		 * The error notification is probably INVALID_SYNTAX,
 		 * but could be v2N_UNSUPPORTED_CRITICAL_PAYLOAD.
 		 */
@@ -291,14 +309,6 @@ void process_v2_IKE_SA_INIT(struct msg_digest *md)
 			return;
 		}
 
-		/*
-		 * Do I want a cookie?
-		 */
-		if (v2_rejected_initiator_cookie(md, require_ddos_cookies())) {
-			dbg("pluto is overloaded and demanding cookies; dropping new exchange");
-			return;
-		}
-
 		/*
 		 * Check for v2N_REDIRECT_SUPPORTED /
 		 * v2N_REDIRECTED_FROM notification.  If redirection
@@ -309,7 +319,14 @@ void process_v2_IKE_SA_INIT(struct msg_digest *md)
 		 * The function below will do everything (and log the
 		 * result).
 		 */
-		if (redirect_global(md)) {
+		if (md->hdr.isa_xchg == ISAKMP_v2_IKE_SESSION_RESUME) {
+			/* likewise, the IKE_SA_INIT gets redirected */
+			if (global_redirect == GLOBAL_REDIRECT_YES) {
+				dbg("global redirect; rejecting IKE_SESSION_RESUME");
+				send_v2N_response_from_md(md, v2N_TICKET_NACK, NULL);
+				return;
+			}
+		} else if (redirect_global(md)) {
 			return;
 		}
 
@@ -343,12 +360,27 @@ void process_v2_IKE_SA_INIT(struct msg_digest *md)
 			return;
 		}
 
+		/*
+		 * When resuming, is the ticket any good?  This is
+		 * stateless so a bad ticket is rejected before
+		 * anything is committed.
+		 */
+		struct v2_resumption *resumption = NULL;
+		if (md->hdr.isa_xchg == ISAKMP_v2_IKE_SESSION_RESUME) {
+			resumption = open_v2_resumption_ticket(md);
+			if (resumption == NULL) {
+				/* already logged and NACKed */
+				return;
+			}
+		}
+
 		/*
 		 * Is there a connection that matches the message?
 		 */
 		bool send_reject_response = true;
 		struct connection *c = find_v2_host_pair_connection(md, &send_reject_response);
 		if (c == NULL) {
+			free_v2_resumption(&resumption);
 			if (send_reject_response) {
 				/*
 				 * NO_PROPOSAL_CHOSEN is used when the
@@ -374,6 +406,7 @@ void process_v2_IKE_SA_INIT(struct msg_digest *md)
 						      ike_responder_spi(&md->sender,
 									md->md_logger),
 						      LEMPTY, 0, null_fd);
+		ike->sa.st_v2_resumption = resumption;
 
 		statetime_t start = statetime_backdate(&ike->sa, &md->md_inception);
 		/* XXX: keep test results happy */
@@ -446,9 +479,9 @@ void process_v2_IKE_SA_INIT(struct msg_digest *md)
 		}
 
 		if (ike->sa.st_state->kind != STATE_V2_PARENT_I1 ||
-		    ike->sa.st_v2_msgid_windows.initiator.sent != 0 ||
-		    ike->sa.st_v2_msgid_windows.initiator.recv != -1 ||
-		    ike->sa.st_v2_msgid_windows.initiator.wip != 0) {
+		    ike->st_v2_msgid_windows.initiator.sent != 0 ||
+		    ike->st_v2_msgid_windows.initiator.recv != -1 ||
+		    ike->st_v2_msgid_windows.initiator.wip != 0) {
 			/*
 			 * This doesn't seem right; drop the
 			 * packet.
@@ -522,12 +555,22 @@ void initiate_v2_IKE_SA_INIT_request(struct connection *c,
 		}
 	}
 
-	const struct finite_state *fs = finite_states[STATE_V2_PARENT_I0];
-	pexpect(fs->nr_transitions == 1);
-	const struct v2_state_transition *transition = &fs->v2.transitions[0];
+	/*
+	 * A fresh start (for instance after a restart) resumes the
+	 * old IKE SA when there's a ticket (RFC 5723); replacing an
+	 * SA re-authenticates.
+	 */
+	struct v2_resumption *resumption = (predecessor == NULL ?
+					    claim_v2_resumption_ticket(c, logger) : NULL);
+
+	const struct v2_state_transition *transition =
+		find_v2_initiate_transition(finite_states[STATE_V2_PARENT_I0],
+					    (resumption != NULL ? ISAKMP_v2_IKE_SESSION_RESUME :
+					     ISAKMP_v2_IKE_SA_INIT));
 	struct ike_sa *ike = new_v2_ike_state(c, transition, SA_INITIATOR,
 					      ike_initiator_spi(), zero_ike_spi,
 					      policy, try, logger->global_whackfd);
+	ike->sa.st_v2_resumption = resumption;
 	statetime_t start = statetime_backdate(&ike->sa, inception);
 
 	/* set up new state */
@@ -640,6 +683,19 @@ void initiate_v2_IKE_SA_INIT_request(struct connection *c,
 		}
 	}
 
+	/*
+	 * When resuming, ike->sa.st_oakley comes from the ticket and
+	 * there's no KE; just the nonce.
+	 */
+	if (ike->sa.st_v2_resumption != NULL) {
+		llog_sa(RC_LOG, ike, "resuming IKE SA using session resumption ticket");
+		apply_v2_resumption(ike);
+		submit_ke_and_nonce(&ike->sa, NULL/*no DH*/,
+				    initiate_v2_IKE_SESSION_RESUME_request_continue, HERE);
+		statetime_stop(&start, "%s()", __func__);
+		return;
+	}
+
 	/*
 	 * Initialize ike->sa.st_oakley, including the group number.
 	 * Grab the DH group from the first configured proposal and build KE.
@@ -676,11 +732,20 @@ stf_status initiate_v2_IKE_SA_INIT_request_continue(struct state *ike_st,
 
 	unpack_KE_from_helper(&ike->sa, local_secret, &ike->sa.st_gi);
 	unpack_nonce(&ike->sa.st_ni, nonce);
-	return record_v2_IKE_SA_INIT_request(ike) ? STF_OK : STF_INTERNAL_ERROR;
+	pexpect(ike->sa.st_v2_transition->exchange == ISAKMP_v2_IKE_SA_INIT);
+	return ike->sa.st_v2_transition->processor(ike, NULL, NULL);
 }
 
-bool record_v2_IKE_SA_INIT_request(struct ike_sa *ike)
+/* no state:   --> I1
+ * HDR, SAi1, KEi, Ni -->
+ */
+
+stf_status record_v2_IKE_SA_INIT_request(struct ike_sa *ike,
+					  struct child_sa *null_child,
+					  struct msg_digest *null_md)
 {
+	pexpect(null_child == NULL);
+	pexpect(null_md == NULL);
 	struct connection *c = ike->sa.st_connection;
 
 	struct v2_message request;
@@ -689,7 +754,7 @@ bool record_v2_IKE_SA_INIT_request(struct ike_sa *ike)
 			     ISAKMP_v2_IKE_SA_INIT,
 			     reply_buffer, sizeof(reply_buffer),
 			     &request, UNENCRYPTED_PAYLOAD)) {
-		return false;
+		return STF_INTERNAL_ERROR;
 	}
 
 	if (impair.send_bogus_dcookie) {
@@ -706,7 +771,7 @@ bool record_v2_IKE_SA_INIT_request(struct ike_sa *ike)
 	if (ike->sa.st_dcookie.ptr != NULL) {
 		/* In v2, for parent, protoid must be 0 and SPI must be empty */
 		if (!emit_v2N_hunk(v2N_COOKIE, ike->sa.st_dcookie, request.pbs)) {
-			return false;
+			return STF_INTERNAL_ERROR;
 		}
 	}
 
@@ -715,7 +780,7 @@ bool record_v2_IKE_SA_INIT_request(struct ike_sa *ike)
 	const struct ikev2_proposals *ike_proposals = c->config->v2_ike_proposals;
 	if (!ikev2_emit_sa_proposals(request.pbs, ike_proposals,
 				     null_shunk /* IKE - no CHILD SPI */)) {
-		return false;
+		return STF_INTERNAL_ERROR;
 	}
 
 	/*
@@ -725,7 +790,7 @@ bool record_v2_IKE_SA_INIT_request(struct ike_sa *ike)
 
 	/* send KE */
 	if (!emit_v2KE(ike->sa.st_gi, ike->sa.st_oakley.ta_dh, request.pbs))
-		return false;
+		return STF_INTERNAL_ERROR;
 
 	/* send NONCE */
 	{
@@ -736,7 +801,7 @@ bool record_v2_IKE_SA_INIT_request(struct ike_sa *ike)
 
 		if (!out_struct(&in, &ikev2_nonce_desc, request.pbs, &pb) ||
 		    !out_hunk(ike->sa.st_ni, &pb, "IKEv2 nonce"))
-			return false;
+			return STF_INTERNAL_ERROR;
 
 		close_output_pbs(&pb);
 	}
@@ -744,13 +809,13 @@ bool record_v2_IKE_SA_INIT_request(struct ike_sa *ike)
 	/* Send fragmentation support notification */
 	if (c->policy & POLICY_IKE_FRAG_ALLOW) {
 		if (!emit_v2N(v2N_IKEV2_FRAGMENTATION_SUPPORTED, request.pbs))
-			return false;
+			return STF_INTERNAL_ERROR;
 	}
 
 	/* Send USE_PPK Notify payload */
 	if (LIN(POLICY_PPK_ALLOW, c->policy)) {
 		if (!emit_v2N(v2N_USE_PPK, request.pbs))
-			return false;
+			return STF_INTERNAL_ERROR;
 	}
 
 	/* Send INTERMEDIATE_EXCHANGE_SUPPORTED Notify payload */
@@ -768,10 +833,10 @@ bool record_v2_IKE_SA_INIT_request(struct ike_sa *ike)
 	 */
 	if (address_is_specified(c->temp_vars.redirect_ip)) {
 		if (!emit_redirected_from_notification(&c->temp_vars.old_gw_address, request.pbs))
-			return false;
+			return STF_INTERNAL_ERROR;
 	} else if (LIN(POLICY_ACCEPT_REDIRECT_YES, c->policy)) {
 		if (!emit_v2N(v2N_REDIRECT_SUPPORTED, request.pbs))
-			return false;
+			return STF_INTERNAL_ERROR;
 	}
 
 	/*
@@ -789,22 +854,22 @@ bool record_v2_IKE_SA_INIT_request(struct ike_sa *ike)
 	} else if (authby_has_digsig(c->remote->config->host.authby) &&
 		   (c->config->sighash_policy != LEMPTY)) {
 		if (!emit_v2N_SIGNATURE_HASH_ALGORITHMS(c->config->sighash_policy, request.pbs))
-			return false;
+			return STF_INTERNAL_ERROR;
 	}
 
 	/* Send NAT-T Notify payloads */
 	if (!ikev2_out_nat_v2n(request.pbs, &ike->sa, &zero_ike_spi/*responder unknown*/))
-		return false;
+		return STF_INTERNAL_ERROR;
 
 	/* From here on, only payloads left are Vendor IDs */
 	if (c->config->send_vendorid) {
 		if (!emit_v2V(request.pbs, pluto_vendorid))
-			return false;
+			return STF_INTERNAL_ERROR;
 	}
 
 	if (c->config->send_vid_fake_strongswan) {
 		if (!emit_v2VID(request.pbs, VID_STRONGSWAN))
-			return false;
+			return STF_INTERNAL_ERROR;
 	}
 
 	/*
@@ -824,14 +889,14 @@ bool record_v2_IKE_SA_INIT_request(struct ike_sa *ike)
 	}
 
 	if (!close_and_record_v2_message(&request)) {
-		return false;
+		return STF_INTERNAL_ERROR;
 	}
 
 	/* save packet for later signing */
 	replace_chunk(&ike->sa.st_firstpacket_me,
 		      clone_pbs_out_as_chunk(&request.message, "saved first packet"));
 
-	return true;
+	return STF_OK;
 }
 
 /*
@@ -1125,7 +1190,7 @@ static stf_status process_v2_IKE_SA_INIT_request_continue(struct state *ike_st,
 	    md->pd[PD_v2N_INTERMEDIATE_EXCHANGE_SUPPORTED] != NULL) {
 		if (!emit_v2N(v2N_INTERMEDIATE_EXCHANGE_SUPPORTED, response.pbs))
 			return STF_INTERNAL_ERROR;
-		ike->sa.st_v2_ike_intermediate.used = true;
+		ike->st_v2_ike_intermediate.used = true;
 	}
 
 	/*
@@ -1497,7 +1562,7 @@ stf_status process_v2_IKE_SA_INIT_response(struct ike_sa *ike,
 	 * For now, do only one Intermediate Exchange round and
 	 * proceed with IKE_AUTH.
 	 */
-	ike->sa.st_v2_ike_intermediate.used = ((c->policy & POLICY_INTERMEDIATE) &&
+	ike->st_v2_ike_intermediate.used = ((c->policy & POLICY_INTERMEDIATE) &&
 					       md->pd[PD_v2N_INTERMEDIATE_EXCHANGE_SUPPORTED] != NULL);
 
 	submit_dh_shared_secret(&ike->sa, &ike->sa, ike->sa.st_gr/*initiator needs responder KE*/,
@@ -1555,7 +1620,7 @@ stf_status process_v2_IKE_SA_INIT_response_continue(struct state *ike_sa,
 	 * The IKE_SA_INIT response has been processed, now dispatch
 	 * the next request.
 	 */
-	return (ike->sa.st_v2_ike_intermediate.used /* SHH: GNU style ?: */
+	return (ike->st_v2_ike_intermediate.used /* SHH: GNU style ?: */
 		? initiate_v2_IKE_INTERMEDIATE_request
 		: initiate_v2_IKE_AUTH_request)(ike, md);
 }
@@ -1695,3 +1760,265 @@ static stf_status process_v2_request_no_skeyseed_continue(struct state *ike_st,
 	md_delref(&md);
 	return STF_SKIP_COMPLETE_STATE_TRANSITION;
 }
+
+/*
+ *
+ ***************************************************************
+ *                   IKE_SESSION_RESUME                    *****
+ ***************************************************************
+ *
+ * RFC 5723: instead of IKE_SA_INIT, a returning initiator presents
+ * the ticket issued by the responder.  The algorithms come from the
+ * ticket and SKEYSEED from the old SK_d and the nonces; there's no
+ * SA or KE payload and no DH.
+ *
+ */
+
+static bool emit_v2Nonce(const chunk_t nonce, struct pbs_out *outs,
+			 struct logger *logger)
+{
+	struct ikev2_generic in = {
+		.isag_critical = build_ikev2_critical(false, logger),
+	};
+	struct pbs_out pb;
+	if (!pbs_out_struct(outs, &ikev2_nonce_desc, &in, sizeof(in), &pb) ||
+	    !pbs_out_hunk(&pb, nonce, "IKEv2 nonce")) {
+		/* already logged */
+		return false;
+	}
+	close_output_pbs(&pb);
+	return true;
+}
+
+/* no state:   --> I1
+ * HDR, Ni, N(TICKET_OPAQUE) -->
+ */
+
+static stf_status initiate_v2_IKE_SESSION_RESUME_request_continue(struct state *ike_st,
+								  struct msg_digest *unused_md,
+								  struct dh_local_secret *local_secret,
+								  chunk_t *nonce)
+{
+	struct ike_sa *ike = pexpect_ike_sa(ike_st);
+	pexpect(ike->sa.st_sa_role == SA_INITIATOR);
+	pexpect(unused_md == NULL);
+	pexpect(local_secret == NULL);
+	pexpect(ike->sa.st_state->kind == STATE_V2_PARENT_I0);
+
+	unpack_nonce(&ike->sa.st_ni, nonce);
+	pexpect(ike->sa.st_v2_transition->exchange == ISAKMP_v2_IKE_SESSION_RESUME);
+	return ike->sa.st_v2_transition->processor(ike, NULL, NULL);
+}
+
+stf_status record_v2_IKE_SESSION_RESUME_request(struct ike_sa *ike,
+						struct child_sa *null_child,
+						struct msg_digest *null_md)
+{
+	pexpect(null_child == NULL);
+	pexpect(null_md == NULL);
+	struct connection *c = ike->sa.st_connection;
+
+	struct v2_message request;
+	if (!open_v2_message("IKE_SESSION_RESUME request",
+			     ike, ike->sa.st_logger, NULL/*request*/,
+			     ISAKMP_v2_IKE_SESSION_RESUME,
+			     reply_buffer, sizeof(reply_buffer),
+			     &request, UNENCRYPTED_PAYLOAD)) {
+		return STF_INTERNAL_ERROR;
+	}
+
+	if (!emit_v2Nonce(ike->sa.st_ni, request.pbs, ike->sa.st_logger) ||
+	    !emit_v2N_TICKET_OPAQUE(ike, request.pbs)) {
+		return STF_INTERNAL_ERROR;
+	}
+
+	if (c->policy & POLICY_IKE_FRAG_ALLOW) {
+		if (!emit_v2N(v2N_IKEV2_FRAGMENTATION_SUPPORTED, request.pbs))
+			return STF_INTERNAL_ERROR;
+	}
+
+	if (!ikev2_out_nat_v2n(request.pbs, &ike->sa, &zero_ike_spi/*responder unknown*/))
+		return STF_INTERNAL_ERROR;
+
+	if (!close_and_record_v2_message(&request)) {
+		return STF_INTERNAL_ERROR;
+	}
+
+	/* save packet for later signing */
+	replace_chunk(&ike->sa.st_firstpacket_me,
+		      clone_pbs_out_as_chunk(&request.message, "saved first packet"));
+	return STF_OK;
+}
+
+/* no state: none I1 --> R1
+ *                <-- HDR, Ni, N(TICKET_OPAQUE)
+ * HDR, Nr -->
+ */
+
+stf_status process_v2_IKE_SESSION_RESUME_request(struct ike_sa *ike,
+						 struct child_sa *child,
+						 struct msg_digest *md)
+{
+	pexpect(child == NULL);
+	update_ike_endpoints(ike, md);
+	passert(ike->sa.st_state->kind == STATE_V2_PARENT_R0);
+	passert(ike->sa.st_sa_role == SA_RESPONDER);
+	passert(ike->sa.st_v2_resumption != NULL);
+
+	if (!accept_v2_resumption_ticket(ike, md)) {
+		/*
+		 * STF_FATAL will send the recorded TICKET_NACK and
+		 * then kill the IKE SA.
+		 */
+		return STF_FATAL;
+	}
+
+	/* Vendor ID processing */
+	for (struct payload_digest *v = md->chain[ISAKMP_NEXT_v2V]; v != NULL; v = v->next) {
+		handle_v2_vendorid(pbs_in_left_as_shunk(&v->pbs), ike->sa.st_logger);
+	}
+
+	apply_v2_resumption(ike);
+
+	ike->sa.st_seen_fragmentation_supported = md->pd[PD_v2N_IKEV2_FRAGMENTATION_SUPPORTED] != NULL;
+
+	if (v2_nat_detected(ike, md)) {
+		dbg("NAT: responder so initiator gets to switch ports");
+	}
+
+	/* just the nonce */
+	submit_ke_and_nonce(&ike->sa, NULL/*no DH*/,
+			    process_v2_IKE_SESSION_RESUME_request_continue, HERE);
+	return STF_SUSPEND;
+}
+
+static stf_status process_v2_IKE_SESSION_RESUME_request_continue(struct state *ike_st,
+								 struct msg_digest *md,
+								 struct dh_local_secret *local_secret,
+								 chunk_t *nonce)
+{
+	struct ike_sa *ike = pexpect_ike_sa(ike_st);
+	pexpect(ike->sa.st_sa_role == SA_RESPONDER);
+	pexpect(v2_msg_role(md) == MESSAGE_REQUEST); /* i.e., MD!=NULL */
+	pexpect(local_secret == NULL);
+	pexpect(ike->sa.st_state->kind == STATE_V2_PARENT_R0);
+	struct connection *c = ike->sa.st_connection;
+
+	/* record first packet for later checking of AUTH */
+	replace_chunk(&ike->sa.st_firstpacket_peer,
+		      clone_pbs_out_as_chunk(&md->message_pbs,
+					     "saved first received packet"));
+
+	/* Ni in */
+	if (!accept_v2_nonce(ike->sa.st_logger, md, &ike->sa.st_ni, "Ni")) {
+		record_v2N_response(ike->sa.st_logger, ike, md,
+				    v2N_INVALID_SYNTAX, NULL/*no-data*/,
+				    UNENCRYPTED_PAYLOAD);
+		return STF_FATAL;
+	}
+
+	struct v2_message response;
+	if (!open_v2_message("IKE_SESSION_RESUME response",
+			     ike, ike->sa.st_logger, md/*response*/,
+			     ISAKMP_v2_IKE_SESSION_RESUME,
+			     reply_buffer, sizeof(reply_buffer),
+			     &response, UNENCRYPTED_PAYLOAD)) {
+		return STF_INTERNAL_ERROR;
+	}
+
+	unpack_nonce(&ike->sa.st_nr, nonce);
+	if (!emit_v2Nonce(ike->sa.st_nr, response.pbs, ike->sa.st_logger)) {
+		return STF_INTERNAL_ERROR;
+	}
+
+	if (c->policy & POLICY_IKE_FRAG_ALLOW) {
+		if (!emit_v2N(v2N_IKEV2_FRAGMENTATION_SUPPORTED, response.pbs))
+			return STF_INTERNAL_ERROR;
+	}
+
+	if (!ikev2_out_nat_v2n(response.pbs, &ike->sa, &ike->sa.st_ike_spis.responder)) {
+		return STF_INTERNAL_ERROR;
+	}
+
+	if (!close_and_record_v2_message(&response)) {
+		return STF_INTERNAL_ERROR;
+	}
+
+	/* save packet for later signing */
+	replace_chunk(&ike->sa.st_firstpacket_me,
+		      clone_pbs_out_as_chunk(&response.message, "saved first packet"));
+
+	/*
+	 * With both nonces, the keys can be derived (from the old
+	 * SK_d) now; the IKE_AUTH request can be decrypted directly.
+	 */
+	calc_v2_resumption_keymat(ike, &ike->sa.st_ike_spis);
+	return STF_OK;
+}
+
+/* STATE_V2_PARENT_I1: R1 --> I0
+ *                     <--  HDR, N(TICKET_NACK)
+ * HDR, SAi1, KEi, Ni -->
+ */
+
+stf_status process_v2_IKE_SESSION_RESUME_response_v2N_TICKET_NACK(struct ike_sa *ike,
+								  struct child_sa *child,
+								  struct msg_digest *md UNUSED)
+{
+	pexpect(child == NULL);
+	struct connection *c = ike->sa.st_connection;
+
+	llog_sa(RC_LOG, ike, "session resumption ticket rejected; falling back to IKE_SA_INIT");
+	free_v2_resumption(&ike->sa.st_v2_resumption);
+	free_ikev2_proposal(&ike->sa.st_v2_accepted_proposal);
+	zero(&ike->sa.st_oakley);
+	ike->sa.st_oakley.ta_dh = ikev2_proposals_first_dh(c->config->v2_ike_proposals);
+	if (ike->sa.st_oakley.ta_dh == NULL) {
+		llog_sa(RC_LOG, ike, "proposals do not contain a valid DH");
+		return STF_FATAL;
+	}
+
+	schedule_reinitiate_v2_ike_sa_init(ike, resubmit_ke_and_nonce);
+	return STF_OK;
+}
+
+/* STATE_V2_PARENT_I1: R1 --> I2
+ *                     <--  HDR, Nr
+ * HDR, SK {IDi, AUTH, SAi2, TSi, TSr} -->
+ */
+
+stf_status process_v2_IKE_SESSION_RESUME_response(struct ike_sa *ike,
+						  struct child_sa *unused_child UNUSED,
+						  struct msg_digest *md)
+{
+	passert(ike->sa.st_v2_resumption != NULL);
+
+	if (!accept_v2_nonce(ike->sa.st_logger, md, &ike->sa.st_nr, "Nr")) {
+		/* STF_FATAL will send the code down the retry path */
+		return STF_FATAL;
+	}
+
+	ike->sa.st_seen_fragmentation_supported = md->pd[PD_v2N_IKEV2_FRAGMENTATION_SUPPORTED] != NULL;
+
+	replace_chunk(&ike->sa.st_firstpacket_peer,
+		      clone_pbs_out_as_chunk(&md->message_pbs,
+					     "saved first received packet"));
+
+	if (v2_nat_detected(ike, md)) {
+		pexpect(ike->sa.hidden_variables.st_nat_traversal & NAT_T_DETECTED);
+		if (!v2_natify_initiator_endpoints(ike, HERE)) {
+			/* already logged */
+			return STF_FATAL;
+		}
+	}
+
+	pexpect(ike_spi_is_zero(&ike->sa.st_ike_spis.responder));
+	ike->sa.st_ike_rekey_spis = (ike_spis_t) {
+		.initiator = ike->sa.st_ike_spis.initiator,
+		.responder = md->hdr.isa_ike_responder_spi,
+	};
+	calc_v2_resumption_keymat(ike, &ike->sa.st_ike_rekey_spis);
+	rehash_state(&ike->sa, &md->hdr.isa_ike_responder_spi);
+
+	return initiate_v2_IKE_AUTH_request(ike, md);
+}
@@ -22,10 +22,15 @@ extern void initiate_v2_IKE_SA_INIT_request(struct connection *c,
 					    bool background, struct logger *logger);
 
 extern void process_v2_request_no_skeyseed(struct ike_sa *ike, struct msg_digest *md);
+extern ikev2_state_transition_fn record_v2_IKE_SA_INIT_request;
 extern ikev2_state_transition_fn process_v2_IKE_SA_INIT_request;
 extern ikev2_state_transition_fn process_v2_IKE_SA_INIT_response;
 extern ikev2_state_transition_fn process_v2_IKE_SA_INIT_response_v2N_INVALID_KE_PAYLOAD;
 
-bool record_v2_IKE_SA_INIT_request(struct ike_sa *ike);
+/* RFC 5723: IKE_SESSION_RESUME stands in for IKE_SA_INIT */
+extern ikev2_state_transition_fn record_v2_IKE_SESSION_RESUME_request;
+extern ikev2_state_transition_fn process_v2_IKE_SESSION_RESUME_request;
+extern ikev2_state_transition_fn process_v2_IKE_SESSION_RESUME_response;
+extern ikev2_state_transition_fn process_v2_IKE_SESSION_RESUME_response_v2N_TICKET_NACK;
 
 #endif
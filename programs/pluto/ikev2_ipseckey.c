@@ -70,7 +70,7 @@ static void add_dns_pubkeys_to_pluto(struct p_dns_req *dnsr, struct dns_pubkey *
 
 	/* algorithm is hardcoded RSA -- PUBKEY_ALG_RSA */
 	/* delete only once. then multiple keys could be added */
-	delete_public_keys(&pluto_pubkeys, keyid, &pubkey_type_rsa);
+	delete_preloaded_pubkeys(keyid, &pubkey_type_rsa);
 
 	realtime_t install_time = realnow();
 	for (struct dns_pubkey *dns_pubkey = dns_pubkeys; dns_pubkey != NULL; dns_pubkey = dns_pubkey->next) {
@@ -107,20 +107,24 @@ static void add_dns_pubkeys_to_pluto(struct p_dns_req *dnsr, struct dns_pubkey *
 			    enum_name(&dns_auth_level_names, al));
 		}
 
+		struct pubkey *pubkey = NULL; /* must-delref */
 		diag_t d = unpack_dns_ipseckey(keyid, /*dns_auth_level*/al,
 					       dns_pubkey->algorithm_type,
 					       install_time,
 					       realtimesum(install_time, deltatime(ttl_used)),
 					       ttl,
 					       dns_pubkey->pubkey,
-					       NULL/*don't-return-pubkey*/, &pluto_pubkeys);
+					       &pubkey);
 		if (d != NULL) {
 			id_buf thatidbuf;
 			llog_diag(RC_LOG_SERIOUS, dnsr->logger, &d,
 				  "add %s publickey failed, %s",
 				  str_id(&st->st_connection->remote->host.id, &thatidbuf),
 				  dnsr->log_buf);
+			continue;
 		}
+		add_preloaded_pubkey(pubkey);
+		pubkey_delref(&pubkey);
 	}
 }
 
@@ -197,7 +197,7 @@ void liveness_check(struct state *st)
 	 * Since this end initiated the exchange and got a response, a
 	 * recent round-trip probe worked.
 	 */
-	struct v2_msgid_window *our = &ike->sa.st_v2_msgid_windows.initiator;
+	struct v2_msgid_window *our = &ike->st_v2_msgid_windows.initiator;
 	pexpect(!is_monotime_epoch(our->last_recv));
 	if (recent_last_contact(child, now, our->last_recv, "successful exchange")) {
 		return;
@@ -220,7 +220,7 @@ void liveness_check(struct state *st)
 	 * constantly sending liveness probes so this end can skip
 	 * them.
 	 */
-	struct v2_msgid_window *peer = &ike->sa.st_v2_msgid_windows.responder;
+	struct v2_msgid_window *peer = &ike->st_v2_msgid_windows.responder;
 	if (recent_last_contact(child, now, peer->last_recv, "peer contact")) {
 		return;
 	}
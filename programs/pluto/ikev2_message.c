@@ -40,6 +40,7 @@
 #include "ike_alg_encrypt_ops.h"	/* XXX: oops */
 #include "pluto_stats.h"
 #include "demux.h"	/* for struct msg_digest */
+#include "arena.h"
 #include "rnd.h"
 #include "crypt_prf.h"
 #include "send.h"	/* record_outbound_ike_message() */
@@ -47,6 +48,7 @@
 #include "iface.h"
 #include "ip_protocol.h"
 #include "ikev2_send.h"
+#include "ikev2.h"		/* for v2_exchange_is_unsecured() */
 
 /*
  * Determine the IKE version we will use for the IKE packet
@@ -196,7 +198,7 @@ static struct pbs_out open_v2_message_body(struct pbs_out *message,
 		 * transition and sending the message.
 		 */
 		passert(ike != NULL);
-		hdr.isa_msgid = ike->sa.st_v2_msgid_windows.initiator.sent + 1;
+		hdr.isa_msgid = ike->st_v2_msgid_windows.initiator.sent + 1;
 	}
 
 	if (impair.bad_ike_auth_xchg) {
@@ -1013,16 +1015,15 @@ struct msg_digest *reassemble_v2_incoming_fragments(struct v2_incoming_fragments
 	}
 
 	/*
-	 * Pass 2: Re-assemble the fragments into the .raw_packet
-	 * buffer.
+	 * Pass 2: Re-assemble the fragments into a buffer in MD's
+	 * arena; it is released along with MD.
 	 */
-	pexpect(md->raw_packet.ptr == NULL); /* empty */
-	md->raw_packet = alloc_chunk(size, "IKEv2 fragments buffer");
+	chunk_t plain = arena_alloc_chunk(md->arena, size);
 	unsigned int offset = 0;
 	for (unsigned i = 1; i <= (*frags)->total; i++) {
 		struct v2_incoming_fragment *frag = &(*frags)->frags[i];
 		passert(offset + frag->plain.len <= size);
-		memcpy(md->raw_packet.ptr + offset,
+		memcpy(plain.ptr + offset,
 		       frag->plain.ptr, frag->plain.len);
 		offset += frag->plain.len;
 	}
@@ -1033,7 +1034,7 @@ struct msg_digest *reassemble_v2_incoming_fragments(struct v2_incoming_fragments
 	 * and SKF .chain[] pointers).
 	 */
 	struct payload_digest sk = {
-		.pbs = same_chunk_as_pbs_in(md->raw_packet, "decrypted SFK payloads"),
+		.pbs = same_chunk_as_pbs_in(plain, "decrypted SFK payloads"),
 		.payload_type = ISAKMP_NEXT_v2SK,
 		.payload.generic.isag_np = (*frags)->first_np,
 	};
@@ -1081,6 +1082,7 @@ bool ikev2_decrypt_msg(struct ike_sa *ike, struct msg_digest *md)
 	bool ok = verify_and_decrypt_v2_message(ike, c, &plain,
 						sk_pbs->cur - md->packet_pbs.start);
 	md->chain[ISAKMP_NEXT_v2SK]->pbs = same_chunk_as_pbs_in(plain, "decrypted SK payload");
+	md->v2_decrypted = ok;
 
 	dbg("#%lu ikev2 %s decrypt %s",
 	    ike->sa.st_serialno,
@@ -1406,7 +1408,7 @@ bool open_v2_message(const char *story,
 	switch (security) {
 	case ENCRYPTED_PAYLOAD:
 		/* never encrypt an IKE_SA_INIT exchange */
-		if (exchange_type == ISAKMP_v2_IKE_SA_INIT) {
+		if (v2_exchange_is_unsecured(exchange_type)) {
 			llog_pexpect(message->logger, HERE,
 				     "exchange type IKE_SA_INIT is invalid for encrypted notification");
 			return false;
@@ -127,7 +127,7 @@ bool process_v2N_mobike_requests(struct ike_sa *ike, struct msg_digest *md,
 		 * for only this reply packet, without updating IKE
 		 * endpoint and without UPDATE_SA.
 		 */
-		ike->sa.st_mobike_remote_endpoint = md->sender;
+		v2_mobike(&ike->sa)->remote_endpoint = md->sender;
 	}
 
 	if (ntfy_update_sa) {
@@ -215,7 +215,7 @@ bool add_mobike_response_payloads(shunk_t cookie2, struct msg_digest *md,
 static payload_emitter_fn add_mobike_payloads; /* type check */
 static bool add_mobike_payloads(struct state *st, pb_stream *pbs)
 {
-	ip_endpoint local_endpoint = st->st_mobike_local_endpoint;
+	ip_endpoint local_endpoint = v2_mobike(st)->local_endpoint;
 	ip_endpoint remote_endpoint = st->st_remote_endpoint;
 	return emit_v2N(v2N_UPDATE_SA_ADDRESSES, pbs) &&
 		ikev2_out_natd(&local_endpoint, &remote_endpoint,
@@ -241,7 +241,8 @@ void record_newaddr(ip_address *ip, char *a_type)
 			continue;
 		}
 
-		if (address_is_specified(ike->sa.st_deleted_local_addr)) {
+		if (ike->sa.st_v2_mobike != NULL &&
+		    address_is_specified(ike->sa.st_v2_mobike->deleted_local_addr)) {
 			/*
 			 * A work around for delay between new address
 			 * and new route A better fix would be listen
@@ -286,8 +287,8 @@ void record_deladdr(ip_address *ip, char *a_type)
 			continue;
 		}
 
-		ip_address ip_p = ike->sa.st_deleted_local_addr;
-		ike->sa.st_deleted_local_addr = local_address;
+		ip_address ip_p = v2_mobike(&ike->sa)->deleted_local_addr;
+		ike->sa.st_v2_mobike->deleted_local_addr = local_address;
 		struct child_sa *child = child_sa_by_serialno(ike->sa.st_connection->newest_ipsec_sa);
 		if (child == NULL) {
 			llog_pexpect(ike->sa.st_logger, HERE,
@@ -381,8 +382,8 @@ static void initiate_mobike_probe(struct ike_sa *ike,
 	 * The interface changed (new address in .address) but
 	 * continue to use the existing port.
 	 */
-	ike->sa.st_mobike_local_endpoint = new_iface->local_endpoint;
-	ike->sa.st_mobike_host_nexthop = new_nexthop; /* for updown, after xfrm migration */
+	v2_mobike(&ike->sa)->local_endpoint = new_iface->local_endpoint;
+	ike->sa.st_v2_mobike->host_nexthop = new_nexthop; /* for updown, after xfrm migration */
 
 	/* notice how it gets set back below */
 	struct iface_endpoint *old_iface = ike->sa.st_interface;
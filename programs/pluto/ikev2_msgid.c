@@ -21,8 +21,12 @@
 #include "ikev2_msgid.h"
 #include "log.h"
 #include "ikev2.h"		/* for complete_v2_state_transition() */
+#include "ikev2_send.h"		/* for emit_v2N_bytes() */
+#include "packet.h"		/* for pbs_in_raw() */
+#include "timer.h"		/* for clear_retransmits() */
 
 static callback_cb initiate_next;		/* type assertion */
+static callback_cb process_deferred_request;	/* type assertion */
 
 /*
  * Logging.
@@ -78,6 +82,18 @@ static void jam_ike_window(struct jambuf *buf,
 	jam_old_new_intmax(buf, ".wip", &old->wip, &new->wip);
 	jam_old_new_monotime(buf, ".last_sent", &old->last_sent, &new->last_sent);
 	jam_old_new_monotime(buf, ".last_recv", &old->last_recv, &new->last_recv);
+	if (old == new ? new->window > 1 : old->window != new->window) {
+		jam_old_new_unsigned(buf, ".window", &old->window, &new->window);
+	}
+	if (new->parked != NULL) {
+		jam_string(buf, " .parked=");
+		const char *sep = "";
+		for (const struct v2_msgid_slot *slot = new->parked;
+		     slot != NULL; slot = slot->next) {
+			jam(buf, "%s%jd", sep, slot->msgid);
+			sep = ",";
+		}
+	}
 }
 
 static void jam_ike_windows(struct jambuf *buf,
@@ -96,8 +112,8 @@ static void jam_window_details(struct jambuf *buf,
 			       const struct v2_msgid_windows *old_windows)
 {
 	jam_ike_windows(buf,
-			old_windows != NULL ? old_windows : &ike->sa.st_v2_msgid_windows,
-			&ike->sa.st_v2_msgid_windows);
+			old_windows != NULL ? old_windows : &ike->st_v2_msgid_windows,
+			&ike->st_v2_msgid_windows);
 }
 
 VPRINTF_LIKE(3)
@@ -174,25 +190,129 @@ static const struct v2_msgid_windows empty_v2_msgid_windows = {
 		.sent = -1,
 		.recv = -1,
 		.wip = -1,
+		.window = 1,
 	},
 	.responder = {
 		.sent = -1,
 		.recv = -1,
 		.wip = -1,
+		.window = 1,
 	},
 };
 
+/*
+ * Parked exchanges.
+ *
+ * When the window is larger than one, the single per-role
+ * .wip/.wip_sa/.st_v2_outgoing[] register only describes the exchange
+ * currently being worked on; the others are moved to (and from) a
+ * small list.  The list is bounded by the window size.
+ */
+
+static struct v2_msgid_slot *park_slot(struct v2_msgid_window *window, intmax_t msgid)
+{
+	struct v2_msgid_slot slot = {
+		.msgid = msgid,
+		.wip_sa = SOS_NOBODY,
+		.next = window->parked,
+	};
+	window->parked = clone_thing(slot, "parked exchange");
+	return window->parked;
+}
+
+static struct v2_msgid_slot **find_parked_slot(struct v2_msgid_window *window, intmax_t msgid)
+{
+	for (struct v2_msgid_slot **slot = &window->parked;
+	     (*slot) != NULL; slot = &(*slot)->next) {
+		if ((*slot)->msgid == msgid) {
+			return slot;
+		}
+	}
+	return NULL;
+}
+
+static void free_parked_slot(struct v2_msgid_slot **slot)
+{
+	struct v2_msgid_slot *tbd = *slot;
+	*slot = tbd->next;
+	free_v2_outgoing_fragments(&tbd->outgoing);
+	pfree(tbd);
+}
+
+static void park_initiator_request(struct ike_sa *ike)
+{
+	struct v2_msgid_window *initiator = &ike->st_v2_msgid_windows.initiator;
+	if (initiator->window <= 1 || initiator->wip == -1) {
+		return;
+	}
+	struct v2_msgid_slot *slot = park_slot(initiator, initiator->wip);
+	slot->wip_sa = (initiator->wip_sa != NULL ? initiator->wip_sa->sa.st_serialno : SOS_NOBODY);
+	slot->outgoing = ike->sa.st_v2_outgoing[MESSAGE_REQUEST];
+	ike->sa.st_v2_outgoing[MESSAGE_REQUEST] = NULL;
+	initiator->wip = -1;
+	initiator->wip_sa = NULL;
+	dbg_v2_msgid(ike, "parked request %jd while awaiting its response", slot->msgid);
+}
+
+static void park_responder_response(struct ike_sa *ike)
+{
+	struct v2_msgid_window *responder = &ike->st_v2_msgid_windows.responder;
+	if (responder->window <= 1 ||
+	    responder->recv < 0 ||
+	    ike->sa.st_v2_outgoing[MESSAGE_RESPONSE] == NULL) {
+		return;
+	}
+	struct v2_msgid_slot *slot = park_slot(responder, responder->recv);
+	slot->recv_frags = responder->recv_frags;
+	slot->outgoing = ike->sa.st_v2_outgoing[MESSAGE_RESPONSE];
+	ike->sa.st_v2_outgoing[MESSAGE_RESPONSE] = NULL;
+	dbg_v2_msgid(ike, "parked response %jd for retransmits", slot->msgid);
+}
+
+static void forget_old_responses(struct ike_sa *ike)
+{
+	/*
+	 * The peer can't have more than WINDOW requests outstanding
+	 * so, once a response has fallen out the bottom of the
+	 * window, a retransmit of its request is impossible.
+	 */
+	struct v2_msgid_window *responder = &ike->st_v2_msgid_windows.responder;
+	intmax_t oldest = responder->sent - responder->window;
+	struct v2_msgid_slot **slot = &responder->parked;
+	while (*slot != NULL) {
+		if ((*slot)->msgid <= oldest) {
+			dbg("Message ID: IKE #%lu forgetting response %jd",
+			    ike->sa.st_serialno, (*slot)->msgid);
+			free_parked_slot(slot);
+		} else {
+			slot = &(*slot)->next;
+		}
+	}
+}
+
+static intmax_t oldest_outstanding_request(const struct v2_msgid_window *initiator)
+{
+	intmax_t oldest = initiator->wip;
+	for (const struct v2_msgid_slot *slot = initiator->parked;
+	     slot != NULL; slot = slot->next) {
+		if (oldest == -1 || slot->msgid < oldest) {
+			oldest = slot->msgid;
+		}
+	}
+	return oldest;
+}
+
 void v2_msgid_init_ike(struct ike_sa *ike)
 {
 	const monotime_t now = mononow();
-	struct v2_msgid_windows old_windows = ike->sa.st_v2_msgid_windows;
-	ike->sa.st_v2_msgid_windows = empty_v2_msgid_windows;
-	ike->sa.st_v2_msgid_windows.last_sent = now;
-	ike->sa.st_v2_msgid_windows.last_recv = now;
-	ike->sa.st_v2_msgid_windows.responder.last_sent = now;
-	ike->sa.st_v2_msgid_windows.responder.last_recv = now;
-	ike->sa.st_v2_msgid_windows.initiator.last_sent = now;
-	ike->sa.st_v2_msgid_windows.initiator.last_recv = now;
+	struct v2_msgid_windows old_windows = ike->st_v2_msgid_windows;
+	ike->st_v2_msgid_windows = empty_v2_msgid_windows;
+	ike->st_v2_msgid_windows.last_sent = now;
+	ike->st_v2_msgid_windows.last_recv = now;
+	ike->st_v2_msgid_windows.responder.last_sent = now;
+	ike->st_v2_msgid_windows.responder.last_recv = now;
+	ike->st_v2_msgid_windows.initiator.last_sent = now;
+	ike->st_v2_msgid_windows.initiator.last_recv = now;
 	/* pretend there's a sender */
 	dbg_msgids_update("initializing", NO_MESSAGE, -1, ike, &old_windows);
 }
@@ -203,19 +323,23 @@ void v2_msgid_start(struct ike_sa *ike, const struct msg_digest *md)
 	switch (role) {
 	case NO_MESSAGE:
 		dbg_v2_msgid(ike, "initiator starting new exchange");
+		/* make room in the register for the new request */
+		park_initiator_request(ike);
 		break;
 	case MESSAGE_REQUEST:
 	{
 		/* extend msgid */
 		intmax_t msgid = md->hdr.isa_msgid;
-		if (ike->sa.st_v2_msgid_windows.responder.wip != -1) {
+		/* keep the previous response for retransmits */
+		park_responder_response(ike);
+		if (ike->st_v2_msgid_windows.responder.wip != -1) {
 			fail_v2_msgid(ike,
 				      "responder.wip shold be -1, was %jd",
-				      ike->sa.st_v2_msgid_windows.responder.wip);
+				      ike->st_v2_msgid_windows.responder.wip);
 		}
-		ike->sa.st_v2_msgid_windows.responder.wip = msgid;
+		ike->st_v2_msgid_windows.responder.wip = msgid;
 		dbg_msgids_update("responder starting", role, msgid,
-				  ike, &ike->sa.st_v2_msgid_windows);
+				  ike, &ike->st_v2_msgid_windows);
 		break;
 	}
 	case MESSAGE_RESPONSE:
@@ -224,6 +348,8 @@ void v2_msgid_start(struct ike_sa *ike, const struct msg_digest *md)
 	}
 }
 
+static void schedule_deferred_request(struct ike_sa *ike);
+
 void v2_msgid_cancel(struct ike_sa *ike, const struct msg_digest *md)
 {
 	enum message_role msg_role = v2_msg_role(md);
@@ -235,14 +361,15 @@ void v2_msgid_cancel(struct ike_sa *ike, const struct msg_digest *md)
 	{
 		/* extend msgid */
 		intmax_t msgid = md->hdr.isa_msgid;
-		if (ike->sa.st_v2_msgid_windows.responder.wip != msgid) {
+		if (ike->st_v2_msgid_windows.responder.wip != msgid) {
 			fail_v2_msgid(ike,
 				      "responder.wip should be %jd, was %jd",
-				      msgid, ike->sa.st_v2_msgid_windows.responder.wip);
+				      msgid, ike->st_v2_msgid_windows.responder.wip);
 		}
-		ike->sa.st_v2_msgid_windows.responder.wip = -1;
+		ike->st_v2_msgid_windows.responder.wip = -1;
 		dbg_msgids_update("responder cancelling", msg_role, msgid,
-				  ike, &ike->sa.st_v2_msgid_windows);
+				  ike, &ike->st_v2_msgid_windows);
+		schedule_deferred_request(ike);
 		break;
 	}
 	case MESSAGE_RESPONSE:
@@ -254,11 +381,12 @@ void v2_msgid_cancel(struct ike_sa *ike, const struct msg_digest *md)
 static void v2_msgid_update_recv(struct ike_sa *ike, const struct msg_digest *md)
 {
 	/* save old value, and add shortcut to new */
-	const struct v2_msgid_windows old = ike->sa.st_v2_msgid_windows;
-	struct v2_msgid_windows *new = &ike->sa.st_v2_msgid_windows;
+	const struct v2_msgid_windows old = ike->st_v2_msgid_windows;
+	struct v2_msgid_windows *new = &ike->st_v2_msgid_windows;
 
 	enum message_role receiving = v2_msg_role(md);
 	intmax_t msgid;
+	intmax_t recv;
 	struct v2_msgid_window *update;
 	const char *update_received_story;
 
@@ -267,7 +395,7 @@ static void v2_msgid_update_recv(struct ike_sa *ike, const struct msg_digest *md
 	{
 		update_received_story = "updating responder received";
 		/* update responder's last request received */
-		struct v2_msgid_window *responder = &ike->sa.st_v2_msgid_windows.responder;
+		struct v2_msgid_window *responder = &ike->st_v2_msgid_windows.responder;
 		update = responder;
 		/*
 		 * Processing request finished.  Scrub it as wip.
@@ -283,13 +411,14 @@ static void v2_msgid_update_recv(struct ike_sa *ike, const struct msg_digest *md
 				      msgid, responder->wip);
 		}
 		responder->wip = -1;
+		recv = msgid;
 		break;
 	}
 	case MESSAGE_RESPONSE:
 	{
 		update_received_story = "updating initiator received";
 		/* update initiator's last response received */
-		struct v2_msgid_window *initiator = &ike->sa.st_v2_msgid_windows.initiator;
+		struct v2_msgid_window *initiator = &ike->st_v2_msgid_windows.initiator;
 		update = initiator;
 		/*
 		 * Since the response has been successfully processed,
@@ -324,6 +453,19 @@ static void v2_msgid_update_recv(struct ike_sa *ike, const struct msg_digest *md
 		}
 		/* this is what matters */
 		pexpect(new->initiator.wip != msgid);
+		/*
+		 * .recv is the last request for which it and all
+		 * earlier responses have been received.  With a
+		 * window of one this is MSGID; otherwise the
+		 * responses can arrive out-of-order and it is just
+		 * before the oldest request still outstanding.
+		 */
+		if (initiator->window <= 1) {
+			recv = msgid;
+		} else {
+			intmax_t oldest = oldest_outstanding_request(initiator);
+			recv = (oldest == -1 ? initiator->sent : oldest - 1);
+		}
 		/*
 		 * Clear the retransmits for the old message
 		 *
@@ -336,7 +478,9 @@ static void v2_msgid_update_recv(struct ike_sa *ike, const struct msg_digest *md
 		 * responder; a background task; or the message could
 		 * be rejected.  All reasons to continue retransmits.
 		 */
-		if (ike->sa.st_retransmit_event != NULL) {
+		if (initiator->parked != NULL) {
+			dbg_v2_msgid(ike, "keeping EVENT_RETRANSMIT as requests are still outstanding");
+		} else if (ike->sa.st_retransmit_event != NULL) {
 			dbg_v2_msgid(ike, "clearing EVENT_RETRANSMIT as response received");
 			clear_retransmits(&ike->sa);
 		} else {
@@ -351,17 +495,21 @@ static void v2_msgid_update_recv(struct ike_sa *ike, const struct msg_digest *md
 		bad_case(receiving);
 	}
 
-	update->recv = msgid;
+	update->recv = recv;
 	update->recv_frags = md->v2_frags_total;
 	new->last_recv = update->last_recv = mononow(); /* not strictly correct */
 
 	dbg_msgids_update(update_received_story, receiving, msgid, ike, &old);
+
+	if (receiving == MESSAGE_REQUEST) {
+		schedule_deferred_request(ike);
+	}
 }
 
 static void v2_msgid_update_sent(struct ike_sa *ike, const struct msg_digest *md, enum message_role sending)
 {
-	struct v2_msgid_windows old = ike->sa.st_v2_msgid_windows;
-	struct v2_msgid_windows *new = &ike->sa.st_v2_msgid_windows;
+	struct v2_msgid_windows old = ike->st_v2_msgid_windows;
+	struct v2_msgid_windows *new = &ike->st_v2_msgid_windows;
 
 	/* tbd */
 	intmax_t msgid;
@@ -401,6 +549,8 @@ static void v2_msgid_update_sent(struct ike_sa *ike, const struct msg_digest *md
 		if (ike->sa.st_retransmit_event == NULL) {
 			dbg_v2_msgid(ike, "scheduling EVENT_RETRANSMIT");
 			start_retransmits(&ike->sa);
+		} else if (new->initiator.parked != NULL) {
+			dbg_v2_msgid(ike, "EVENT_RETRANSMIT already scheduled for outstanding requests");
 		} else {
 			dbg_v2_msgid(ike, "XXX: EVENT_RETRANSMIT already scheduled -- suspect record'n'send");
 		}
@@ -428,7 +578,16 @@ static void v2_msgid_update_sent(struct ike_sa *ike, const struct msg_digest *md
 		bad_case(sending);
 	}
 
-	update->sent = msgid;
+	/*
+	 * With a larger window, a request (and hence response) can
+	 * be processed after a later one; .sent stays the highest.
+	 */
+	if (update->window <= 1 || msgid > update->sent) {
+		update->sent = msgid;
+	}
+	if (sending == MESSAGE_RESPONSE) {
+		forget_old_responses(ike);
+	}
 	new->last_sent = update->last_sent = mononow(); /* close enough */
 
 	dbg_msgids_update(update_sent_story, sending, msgid, ike, &old);
@@ -454,27 +613,260 @@ struct v2_msgid_pending {
 	struct v2_msgid_pending *next;
 };
 
-void v2_msgid_free(struct state *st)
+struct v2_msgid_deferred {
+	struct msg_digest *md;
+	struct v2_msgid_deferred *next;
+};
+
+void v2_msgid_free(struct ike_sa *ike)
 {
 	/* find the end; small list? */
-	struct v2_msgid_pending **pp = &st->st_v2_msgid_windows.pending_requests;
+	struct v2_msgid_pending **pp = &ike->st_v2_msgid_windows.pending_requests;
 	while (*pp != NULL) {
 		struct v2_msgid_pending *tbd = *pp;
 		*pp = tbd->next;
 		pfree(tbd);
 	}
+	struct v2_msgid_deferred **dp = &ike->st_v2_msgid_windows.deferred_requests;
+	while (*dp != NULL) {
+		struct v2_msgid_deferred *tbd = *dp;
+		*dp = tbd->next;
+		md_delref(&tbd->md);
+		pfree(tbd);
+	}
+	while (ike->st_v2_msgid_windows.initiator.parked != NULL) {
+		free_parked_slot(&ike->st_v2_msgid_windows.initiator.parked);
+	}
+	while (ike->st_v2_msgid_windows.responder.parked != NULL) {
+		free_parked_slot(&ike->st_v2_msgid_windows.responder.parked);
+	}
+}
+
+/*
+ * RFC 7296 2.3: the responder advertises how many requests it is
+ * willing to have outstanding using N(SET_WINDOW_SIZE) in IKE_AUTH.
+ *
+ * This end only advertises (and only uses) a window larger than one
+ * when configured with ikewindow=.  Requests are still processed one
+ * at a time; requests that arrive while the responder is busy are
+ * deferred instead of being dropped.
+ */
+
+bool emit_v2N_SET_WINDOW_SIZE(struct ike_sa *ike, struct pbs_out *outs)
+{
+	unsigned window = ike->sa.st_connection->ike_window;
+	if (window <= 1) {
+		return true;
+	}
+	uint32_t nwindow = htonl(window);
+	if (!emit_v2N_bytes(v2N_SET_WINDOW_SIZE, &nwindow, sizeof(nwindow), outs)) {
+		return false;
+	}
+	ike->st_v2_msgid_windows.responder.window = window;
+	dbg_v2_msgid(ike, "advertised SET_WINDOW_SIZE %u", window);
+	return true;
+}
+
+void process_v2N_SET_WINDOW_SIZE(struct ike_sa *ike, const struct msg_digest *md)
+{
+	const struct payload_digest *pd = md->pd[PD_v2N_SET_WINDOW_SIZE];
+	if (pd == NULL) {
+		return;
+	}
+
+	struct pbs_in pbs = pd->pbs;
+	uint32_t nwindow;
+	diag_t d = pbs_in_raw(&pbs, &nwindow, sizeof(nwindow), "SET_WINDOW_SIZE");
+	if (d != NULL) {
+		llog_diag(RC_LOG, ike->sa.st_logger, &d, "%s", "ignoring N(SET_WINDOW_SIZE): ");
+		return;
+	}
+
+	unsigned window = ntohl(nwindow);
+	if (window < 1) {
+		llog_sa(RC_LOG, ike, "ignoring N(SET_WINDOW_SIZE) with window size 0");
+		return;
+	}
+
+	/* don't use more than this end is willing to handle */
+	unsigned local = ike->sa.st_connection->ike_window;
+	ike->st_v2_msgid_windows.initiator.window = (window < local ? window : local);
+	dbg_v2_msgid(ike, "peer advertised SET_WINDOW_SIZE %u, using %u",
+		     window, ike->st_v2_msgid_windows.initiator.window);
+}
+
+/*
+ * Responder: find the response to retransmit for MSGID (either the
+ * most recent one, or one that has been parked).  Returns false when
+ * MSGID isn't known.
+ */
+
+bool v2_msgid_recorded_response(struct ike_sa *ike, intmax_t msgid,
+				struct v2_outgoing_fragment **response,
+				unsigned *recv_frags)
+{
+	struct v2_msgid_window *responder = &ike->st_v2_msgid_windows.responder;
+	struct v2_msgid_slot **slot = find_parked_slot(responder, msgid);
+	if (slot != NULL) {
+		*response = (*slot)->outgoing;
+		*recv_frags = (*slot)->recv_frags;
+		return true;
+	}
+	if (msgid == responder->recv) {
+		*response = ike->sa.st_v2_outgoing[MESSAGE_RESPONSE];
+		*recv_frags = responder->recv_frags;
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Responder: while a request is being processed (for instance
+ * waiting on crypto), hang onto later requests that are within the
+ * window.  They are re-injected, in Message ID order, once the
+ * current request finishes.
+ *
+ * Only requests that have been decrypted, and hence passed their
+ * integrity check, are accepted.  Otherwise anyone knowing the SPIs
+ * could fill the list with forgeries and have the real requests
+ * dropped as duplicates.
+ */
+
+bool v2_msgid_defer_request(struct ike_sa *ike, struct msg_digest *md)
+{
+	struct v2_msgid_windows *windows = &ike->st_v2_msgid_windows;
+	intmax_t msgid = md->hdr.isa_msgid;
+
+	if (!md->v2_decrypted) {
+		dbg_v2_msgid(ike, "not deferring request %jd, it has not passed its integrity check", msgid);
+		return false;
+	}
+
+	unsigned nr_deferred = 0;
+	for (struct v2_msgid_deferred *d = windows->deferred_requests;
+	     d != NULL; d = d->next) {
+		if (d->md->hdr.isa_msgid == msgid) {
+			dbg_v2_msgid(ike, "request %jd is already deferred", msgid);
+			return true;
+		}
+		nr_deferred++;
+	}
+	if (nr_deferred + 1 >= windows->responder.window) {
+		dbg_v2_msgid(ike, "not deferring request %jd, %u requests already deferred",
+			     msgid, nr_deferred);
+		return false;
+	}
+
+	/* keep the list sorted */
+	struct v2_msgid_deferred **dp = &windows->deferred_requests;
+	while (*dp != NULL && (*dp)->md->hdr.isa_msgid < msgid) {
+		dp = &(*dp)->next;
+	}
+	struct v2_msgid_deferred deferred = {
+		.md = md_addref(md),
+		.next = *dp,
+	};
+	*dp = clone_thing(deferred, "deferred request");
+	dbg_v2_msgid(ike, "deferring request %jd", msgid);
+	return true;
+}
+
+static void schedule_deferred_request(struct ike_sa *ike)
+{
+	struct v2_msgid_deferred *deferred = ike->st_v2_msgid_windows.deferred_requests;
+	if (deferred == NULL) {
+		return;
+	}
+	ike->st_v2_msgid_windows.deferred_requests = deferred->next;
+	dbg_v2_msgid(ike, "scheduling deferred request %jd",
+		     (intmax_t)deferred->md->hdr.isa_msgid);
+	/* callback takes ownership of the reference */
+	schedule_callback("deferred request", ike->sa.st_serialno,
+			  process_deferred_request, deferred->md);
+	pfree(deferred);
+}
+
+static void process_deferred_request(const char *story, struct state *ike_sa, void *context)
+{
+	struct msg_digest *md = context;
+	if (ike_sa == NULL) {
+		dbg("IKE SA with deferred request disappeared (%s)", story);
+		md_delref(&md);
+		return;
+	}
+
+	so_serial_t serialno = ike_sa->st_serialno;
+	struct ike_sa *ike = pexpect_ike_sa(ike_sa);
+	if (ike != NULL) {
+		process_deferred_v2_request(ike, md);
+	}
+	md_delref(&md);
+
+	/*
+	 * If the request was rejected before being processed, kick
+	 * the next one along (otherwise that happens when the
+	 * request finishes).
+	 */
+	ike = ike_sa_by_serialno(serialno);
+	if (ike != NULL && ike->st_v2_msgid_windows.responder.wip == -1) {
+		schedule_deferred_request(ike);
+	}
+}
+
+/*
+ * Initiator: requests parked while awaiting their response.
+ */
+
+bool v2_msgid_parked_request(struct ike_sa *ike, intmax_t msgid)
+{
+	return find_parked_slot(&ike->st_v2_msgid_windows.initiator, msgid) != NULL;
+}
+
+void v2_msgid_unpark_request(struct ike_sa *ike, intmax_t msgid)
+{
+	struct v2_msgid_window *initiator = &ike->st_v2_msgid_windows.initiator;
+	/* make room */
+	park_initiator_request(ike);
+	struct v2_msgid_slot **slot = find_parked_slot(initiator, msgid);
+	if (slot == NULL) {
+		fail_v2_msgid(ike, "request %jd is not parked", msgid);
+		return;
+	}
+	initiator->wip = msgid;
+	initiator->wip_sa = child_sa_by_serialno((*slot)->wip_sa);
+	free_v2_outgoing_fragments(&ike->sa.st_v2_outgoing[MESSAGE_REQUEST]);
+	ike->sa.st_v2_outgoing[MESSAGE_REQUEST] = (*slot)->outgoing;
+	(*slot)->outgoing = NULL;
+	free_parked_slot(slot);
+	dbg_v2_msgid(ike, "unparked request %jd to process its response", msgid);
+}
+
+void send_v2_msgid_outstanding_requests(struct ike_sa *ike, const char *where)
+{
+	struct v2_msgid_window *initiator = &ike->st_v2_msgid_windows.initiator;
+	if (initiator->parked == NULL) {
+		send_recorded_v2_message(ike, where, MESSAGE_REQUEST);
+		return;
+	}
+	if (initiator->wip != -1) {
+		send_recorded_v2_message(ike, where, MESSAGE_REQUEST);
+	}
+	for (struct v2_msgid_slot *slot = initiator->parked;
+	     slot != NULL; slot = slot->next) {
+		send_v2_outgoing_fragments(ike, where, slot->outgoing);
+	}
 }
 
 bool v2_msgid_request_outstanding(struct ike_sa *ike)
 {
-	struct v2_msgid_window *initiator = &ike->sa.st_v2_msgid_windows.initiator;
+	struct v2_msgid_window *initiator = &ike->st_v2_msgid_windows.initiator;
 	intmax_t unack = (initiator->sent - initiator->recv);
 	return (unack != 0); /* well >0 */
 }
 
 bool v2_msgid_request_pending(struct ike_sa *ike)
 {
-	return ike->sa.st_v2_msgid_windows.pending_requests != NULL;
+	return ike->st_v2_msgid_windows.pending_requests != NULL;
 }
 
 void v2_msgid_queue_initiator(struct ike_sa *ike, struct child_sa *child,
@@ -490,7 +882,7 @@ void v2_msgid_queue_initiator(struct ike_sa *ike, struct child_sa *child,
 	 * notification) are put at the front before anything else
 	 * (namely CREATE_CHILD_SA).
 	 */
-	struct v2_msgid_pending **pp = &ike->sa.st_v2_msgid_windows.pending_requests;
+	struct v2_msgid_pending **pp = &ike->st_v2_msgid_windows.pending_requests;
 	while (*pp != NULL) {
 		if (transition->exchange == ISAKMP_v2_INFORMATIONAL
 		    && (*pp)->transition->exchange != ISAKMP_v2_INFORMATIONAL) {
@@ -512,12 +904,12 @@ void v2_msgid_queue_initiator(struct ike_sa *ike, struct child_sa *child,
 	v2_msgid_schedule_next_initiator(ike);
 }
 
-void v2_msgid_migrate_queue(struct ike_sa *from, struct child_sa *to)
+void v2_msgid_migrate_queue(struct ike_sa *from, struct ike_sa *to)
 {
-	pexpect(to->sa.st_v2_msgid_windows.pending_requests == NULL);
-	to->sa.st_v2_msgid_windows.pending_requests = from->sa.st_v2_msgid_windows.pending_requests;
-	from->sa.st_v2_msgid_windows.pending_requests = NULL;
-	for (struct v2_msgid_pending *pending = to->sa.st_v2_msgid_windows.pending_requests; pending != NULL;
+	pexpect(to->st_v2_msgid_windows.pending_requests == NULL);
+	to->st_v2_msgid_windows.pending_requests = from->st_v2_msgid_windows.pending_requests;
+	from->st_v2_msgid_windows.pending_requests = NULL;
+	for (struct v2_msgid_pending *pending = to->st_v2_msgid_windows.pending_requests; pending != NULL;
 	     pending = pending->next) {
 		if (pending->who_for == from->sa.st_serialno) {
 			pending->who_for = to->sa.st_serialno;
@@ -532,18 +924,18 @@ static void initiate_next(const char *story, struct state *ike_sa, void *context
 		dbg("IKE SA with pending initiates disappeared (%s)", story);
 		return;
 	}
-	struct v2_msgid_window *initiator = &ike->sa.st_v2_msgid_windows.initiator;
+	struct v2_msgid_window *initiator = &ike->st_v2_msgid_windows.initiator;
 	for (intmax_t unack = (initiator->sent - initiator->recv);
-	     unack < ike->sa.st_connection->ike_window && ike->sa.st_v2_msgid_windows.pending_requests != NULL;
+	     unack < initiator->window && ike->st_v2_msgid_windows.pending_requests != NULL;
 	     unack++) {
 
 		/*
 		 * Make a copy of the pending exchange, and then
 		 * release it.
 		 */
-		struct v2_msgid_pending pending = *ike->sa.st_v2_msgid_windows.pending_requests;
-		pfree(ike->sa.st_v2_msgid_windows.pending_requests);
-		ike->sa.st_v2_msgid_windows.pending_requests = pending.next;
+		struct v2_msgid_pending pending = *ike->st_v2_msgid_windows.pending_requests;
+		pfree(ike->st_v2_msgid_windows.pending_requests);
+		ike->st_v2_msgid_windows.pending_requests = pending.next;
 
 		struct child_sa *child = child_sa_by_serialno(pending.child);
 		if (pending.child != SOS_NOBODY && child == NULL) {
@@ -586,6 +978,7 @@ static void initiate_next(const char *story, struct state *ike_sa, void *context
 		 */
 
 		set_v2_transition(&ike->sa, pending.transition, HERE);
+		v2_msgid_start(ike, NULL/*initiator*/);
 		/* pexpect(initiator->wip_sa == NULL); */
 		initiator->wip_sa = child;
 		stf_status status = pending.transition->processor(ike, child, NULL);
@@ -595,8 +988,8 @@ static void initiate_next(const char *story, struct state *ike_sa, void *context
 
 void v2_msgid_schedule_next_initiator(struct ike_sa *ike)
 {
-	const struct v2_msgid_window *initiator = &ike->sa.st_v2_msgid_windows.initiator;
-	const struct v2_msgid_pending *pending = ike->sa.st_v2_msgid_windows.pending_requests;
+	const struct v2_msgid_window *initiator = &ike->st_v2_msgid_windows.initiator;
+	const struct v2_msgid_pending *pending = ike->st_v2_msgid_windows.pending_requests;
 	/*
 	 * If there appears to be space and there's a pending
 	 * initiate, poke the IKE SA so it tries to initiate things.
@@ -604,7 +997,7 @@ void v2_msgid_schedule_next_initiator(struct ike_sa *ike)
 	if (pending != NULL) {
 		/* if this returns NULL, that's ok; will log "LOST" */
 		intmax_t unack = (initiator->sent - initiator->recv);
-		if (unack < ike->sa.st_connection->ike_window) {
+		if (unack < initiator->window) {
 			dbg_v2_msgid(ike,
 				     "wakeing IKE SA for next initiator "PRI_SO", (unack %jd)",
 				     pri_so(pending->who_for), unack);
@@ -20,11 +20,14 @@
 #include <stdint.h>		/* for intmax_t */
 
 #include "monotime.h"
+#include "defs.h"		/* for so_serial_t */
 
 struct state;
 struct ike_sa;
 struct msg_digest;
 struct v2_state_transition;
+struct v2_outgoing_fragment;
+struct pbs_out;
 enum message_role;
 
 /*
@@ -37,6 +40,24 @@ enum message_role;
  * MSGIDs.
  */
 
+/*
+ * An exchange that is still outstanding but isn't the one the IKE SA
+ * is currently working on.  Only used when the window is larger than
+ * one (RFC 7296 2.3).
+ *
+ * On the initiator it is a request waiting for its response (along
+ * with the SA being worked on); on the responder it is a response
+ * retained so that a retransmitted request can be answered.
+ */
+
+struct v2_msgid_slot {
+	intmax_t msgid;
+	unsigned recv_frags;		/* responder */
+	so_serial_t wip_sa;		/* initiator */
+	struct v2_outgoing_fragment *outgoing;
+	struct v2_msgid_slot *next;
+};
+
 struct v2_msgid_window {
 	monotime_t last_sent;  /* sent a message */
 	monotime_t last_recv;  /* received a message */
@@ -63,6 +84,20 @@ struct v2_msgid_window {
 	 * rekeyd by a CREATE_CHILD_SA exchange.
 	 */
 	struct child_sa *wip_sa;
+	/*
+	 * The number of exchanges that can be outstanding.  For the
+	 * initiator it is what the peer advertised using
+	 * SET_WINDOW_SIZE; for the responder it is what this end
+	 * advertised.  Both start out as 1.
+	 *
+	 * When larger than one, exchanges other than WIP are kept in
+	 * PARKED.  For the initiator, .recv is then the last Message
+	 * ID for which it and all earlier responses have been
+	 * received, and for the responder, .recv is the last request
+	 * processed and .sent the highest response sent.
+	 */
+	unsigned window;
+	struct v2_msgid_slot *parked;
 };
 
 struct v2_msgid_windows {
@@ -71,10 +106,11 @@ struct v2_msgid_windows {
 	struct v2_msgid_window initiator;
 	struct v2_msgid_window responder;
 	struct v2_msgid_pending *pending_requests;
+	struct v2_msgid_deferred *deferred_requests;
 };
 
 void v2_msgid_init_ike(struct ike_sa *ike);
-void v2_msgid_free(struct state *st);
+void v2_msgid_free(struct ike_sa *ike);
 
 bool v2_msgid_request_outstanding(struct ike_sa *ike);
 bool v2_msgid_request_pending(struct ike_sa *ike);
@@ -116,7 +152,22 @@ void v2_msgid_finish(struct ike_sa *ike, const struct msg_digest *md);
 void v2_msgid_queue_initiator(struct ike_sa *ike, struct child_sa *child/*optional*/,
 			      const struct v2_state_transition *transition);
 
-void v2_msgid_migrate_queue(struct ike_sa *from, struct child_sa *to);
+void v2_msgid_migrate_queue(struct ike_sa *from, struct ike_sa *to);
+
+/*
+ * RFC 7296 SET_WINDOW_SIZE, and the multi-slot windows it enables.
+ */
+
+bool emit_v2N_SET_WINDOW_SIZE(struct ike_sa *ike, struct pbs_out *outs);
+void process_v2N_SET_WINDOW_SIZE(struct ike_sa *ike, const struct msg_digest *md);
+
+bool v2_msgid_recorded_response(struct ike_sa *ike, intmax_t msgid,
+				struct v2_outgoing_fragment **response,
+				unsigned *recv_frags);
+bool v2_msgid_defer_request(struct ike_sa *ike, struct msg_digest *md);
+bool v2_msgid_parked_request(struct ike_sa *ike, intmax_t msgid);
+void v2_msgid_unpark_request(struct ike_sa *ike, intmax_t msgid);
+void send_v2_msgid_outstanding_requests(struct ike_sa *ike, const char *where);
 
 void v2_msgid_schedule_next_initiator(struct ike_sa *ike);
 
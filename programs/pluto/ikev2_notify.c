@@ -62,8 +62,14 @@ enum v2_pd v2_pd_from_notification(v2_notification_t n)
 	C(REDIRECTED_FROM);
 	C(REDIRECT_SUPPORTED);
 	C(REKEY_SA);
+	C(SET_WINDOW_SIZE);
 	C(SIGNATURE_HASH_ALGORITHMS);
 	C(SINGLE_PAIR_REQUIRED);
+	C(TICKET_ACK);
+	C(TICKET_LT_OPAQUE);
+	C(TICKET_NACK);
+	C(TICKET_OPAQUE);
+	C(TICKET_REQUEST);
 	C(TS_UNACCEPTABLE);
 	C(UNSUPPORTED_CRITICAL_PAYLOAD);
 	C(UPDATE_SA_ADDRESSES);
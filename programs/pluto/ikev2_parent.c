@@ -347,14 +347,14 @@ struct crypt_mac v2_hash_id_payload(const char *id_name, struct ike_sa *ike,
 	struct crypt_prf *id_ctx = crypt_prf_init_symkey(id_name, ike->sa.st_oakley.ta_prf,
 							 key_name, key, ike->sa.st_logger);
 	/* skip PayloadHeader; hash: IDType | RESERVED */
-	crypt_prf_update_bytes(id_ctx, "IDType", &ike->sa.st_v2_id_payload.header.isai_type,
-				sizeof(ike->sa.st_v2_id_payload.header.isai_type));
+	crypt_prf_update_bytes(id_ctx, "IDType", &ike->st_v2_id_payload.header.isai_type,
+				sizeof(ike->st_v2_id_payload.header.isai_type));
 	/* note that res1+res2 is 3 zero bytes */
-	crypt_prf_update_byte(id_ctx, "RESERVED 1", ike->sa.st_v2_id_payload.header.isai_res1);
-	crypt_prf_update_byte(id_ctx, "RESERVED 2", ike->sa.st_v2_id_payload.header.isai_res2);
-	crypt_prf_update_byte(id_ctx, "RESERVED 3", ike->sa.st_v2_id_payload.header.isai_res3);
+	crypt_prf_update_byte(id_ctx, "RESERVED 1", ike->st_v2_id_payload.header.isai_res1);
+	crypt_prf_update_byte(id_ctx, "RESERVED 2", ike->st_v2_id_payload.header.isai_res2);
+	crypt_prf_update_byte(id_ctx, "RESERVED 3", ike->st_v2_id_payload.header.isai_res3);
 	/* hash: InitIDData */
-	crypt_prf_update_hunk(id_ctx, "InitIDData", ike->sa.st_v2_id_payload.data);
+	crypt_prf_update_hunk(id_ctx, "InitIDData", ike->st_v2_id_payload.data);
 	return crypt_prf_final_mac(&id_ctx, NULL/*no-truncation*/);
 }
 
@@ -39,6 +39,7 @@
 #include "pluto_x509.h"
 #include "peer_id.h"
 #include "ikev2_certreq.h"
+#include "ikev2_resume.h"
 
 static diag_t decode_v2_peer_id(const char *peer, struct payload_digest *const id_peer, struct id *peer_id)
 {
@@ -90,6 +91,18 @@ diag_t ikev2_responder_decode_initiator_id(struct ike_sa *ike, struct msg_digest
 		}
 	}
 
+	/*
+	 * A resumed IKE SA keeps its connection; the peer must be who
+	 * the ticket says was authenticated.
+	 */
+	if (ike->sa.st_v2_resumption != NULL) {
+		d = check_v2_resumption_peer_id(ike, &peer_id);
+		if (d != NULL) {
+			return d;
+		}
+		return update_peer_id(ike, &peer_id, tarzan_id);
+	}
+
 	/*
 	 * Convert the proposed connections into something this
 	 * responder might accept.
@@ -170,6 +183,11 @@ diag_t ikev2_initiator_decode_responder_id(struct ike_sa *ike, struct msg_digest
 		return d;
 	}
 
+	d = check_v2_resumption_peer_id(ike, &responder_id);
+	if (d != NULL) {
+		return d;
+	}
+
 	/* start considering connection */
 	return update_peer_id(ike, &responder_id, NULL/*tarzan isn't interesting*/);
 
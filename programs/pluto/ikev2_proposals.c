@@ -194,6 +194,56 @@ struct ikev2_proposal {
 	     (TYPE)++, (TRANSFORMS)++)
 
 struct ikev2_proposal_match {
+	/*
+	 * The remote proposal that this entry was last reset for.
+	 * Entries are only reset when a remote transform first
+	 * matches the local proposal; an entry from an earlier remote
+	 * proposal is treated as having matched nothing.
+	 */
+	unsigned remote_proposal_nr;
+	/*
+	 * Set of transform types in the remote proposal that matched
+	 * at least one local transform of the same type.
+	 *
+	 * Note: MATCHED <= REQUIRED | OPTIONAL
+	 */
+	lset_t matched_transform_types;
+	/*
+	 * Index of the best matched transform within the local
+	 * proposal, or of the (invalid) sentinel transform.
+	 */
+	uint8_t matching_transform[IKEv2_TRANS_TYPE_ROOF];
+};
+
+/*
+ * The local proposals compiled into lookup tables.
+ *
+ * For each transform type there is a table, sorted by ID+KEYLEN, of
+ * the distinct transforms found in any local proposal.  Each entry
+ * lists, in proposal order, just the local proposals containing
+ * that ID+KEYLEN along with the index of the first such transform in
+ * the proposal.  Matching a remote transform is then a binary search
+ * followed by a walk of that list; local proposals without the
+ * transform are never looked at.
+ *
+ * Built once, when the proposals are constructed; for a connection's
+ * IKE and IKE_AUTH Child SA proposals that is when the connection is
+ * loaded.
+ */
+
+struct ikev2_transform_match {
+	int propnum;
+	uint8_t transform;
+};
+
+struct ikev2_transform_key {
+	unsigned id;
+	unsigned attr_keylen;
+	unsigned nr_matches;
+	struct ikev2_transform_match *match;	/* [nr_matches] */
+};
+
+struct ikev2_proposal_matcher {
 	/*
 	 * Set of local transform types to expect in the remote
 	 * proposal.
@@ -206,22 +256,19 @@ struct ikev2_proposal_match {
 	lset_t required_transform_types;
 	lset_t optional_transform_types;
 	/*
-	 * Location of the sentinel transform for each transform type.
-	 * MATCHING_TRANSFORMS starts out with this value.
+	 * Index of the sentinel transform for each transform type.
+	 * MATCHING_TRANSFORM starts out with this value.
 	 */
-	struct ikev2_transform *sentinel_transform[IKEv2_TRANS_TYPE_ROOF];
-	/*
-	 * Set of transform types in the remote proposal that matched
-	 * at least one local transform of the same type.
-	 *
-	 * Note: MATCHED <= REQUIRED | OPTIONAL
-	 */
-	lset_t matched_transform_types;
-	/*
-	 * Pointer to the best matched transform within the local
-	 * proposal, or the (invalid) sentinel transform.
-	 */
-	const struct ikev2_transform *matching_transform[IKEv2_TRANS_TYPE_ROOF];
+	uint8_t sentinel_transform[IKEv2_TRANS_TYPE_ROOF];
+};
+
+struct ikev2_proposals_matcher {
+	struct {
+		unsigned nr;
+		struct ikev2_transform_key *key;
+	} transforms[IKEv2_TRANS_TYPE_ROOF];
+	struct ikev2_proposal_matcher *proposal;	/* [proposals->roof] */
+	struct ikev2_transform_match *matches;	/* storage for the keys' MATCH */
 };
 
 struct ikev2_proposals {
@@ -244,6 +291,11 @@ struct ikev2_proposals {
 	 * is ignored).
 	 */
 	struct ikev2_proposal *proposal;
+	/*
+	 * PROPOSAL compiled for matching; see
+	 * compile_ikev2_proposals().
+	 */
+	struct ikev2_proposals_matcher *matcher;
 };
 
 /*
@@ -391,6 +443,216 @@ void llog_v2_proposals(lset_t rc_flags, struct logger *logger,
 	}
 }
 
+static int transform_key_cmp(const void *l, const void *r)
+{
+	const struct ikev2_transform_key *lk = l;
+	const struct ikev2_transform_key *rk = r;
+	if (lk->id != rk->id) {
+		return lk->id < rk->id ? -1 : 1;
+	}
+	if (lk->attr_keylen != rk->attr_keylen) {
+		return lk->attr_keylen < rk->attr_keylen ? -1 : 1;
+	}
+	return 0;
+}
+
+static const struct ikev2_transform_key *lookup_transform_key(const struct ikev2_proposals_matcher *matcher,
+							      enum ikev2_trans_type type,
+							      const struct ikev2_transform *transform)
+{
+	const struct ikev2_transform_key key = {
+		.id = transform->id,
+		.attr_keylen = transform->attr_keylen,
+	};
+	if (matcher->transforms[type].nr == 0) {
+		return NULL;
+	}
+	return bsearch(&key, matcher->transforms[type].key,
+		       matcher->transforms[type].nr,
+		       sizeof(key), transform_key_cmp);
+}
+
+static void free_ikev2_proposals_matcher(struct ikev2_proposals_matcher **matcher)
+{
+	if (*matcher == NULL) {
+		return;
+	}
+	for (enum ikev2_trans_type type = 1; type < IKEv2_TRANS_TYPE_ROOF; type++) {
+		pfreeany((*matcher)->transforms[type].key);
+	}
+	pfreeany((*matcher)->matches);
+	pfree((*matcher)->proposal);
+	pfree(*matcher);
+	*matcher = NULL;
+}
+
+static struct ikev2_transform_key *find_transform_key(struct ikev2_proposals_matcher *matcher,
+							enum ikev2_trans_type type,
+							const struct ikev2_transform *transform)
+{
+	/* the table is still small and unsorted */
+	for (unsigned k = 0; k < matcher->transforms[type].nr; k++) {
+		struct ikev2_transform_key *key = &matcher->transforms[type].key[k];
+		if (key->id == transform->id &&
+		    key->attr_keylen == transform->attr_keylen) {
+			return key;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Is TRANSFORM the first in TRANSFORMS with its ID+KEYLEN?
+ */
+
+static bool first_transform(const struct ikev2_transforms *transforms,
+			    const struct ikev2_transform *transform)
+{
+	for (const struct ikev2_transform *earlier = transforms->transform;
+	     earlier < transform; earlier++) {
+		if (earlier->id == transform->id &&
+		    earlier->attr_keylen == transform->attr_keylen) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void compile_ikev2_proposals(struct ikev2_proposals *proposals)
+{
+	free_ikev2_proposals_matcher(&proposals->matcher);
+	struct ikev2_proposals_matcher *matcher =
+		alloc_thing(struct ikev2_proposals_matcher, "v2 proposals matcher");
+	matcher->proposal = alloc_things(struct ikev2_proposal_matcher,
+					 proposals->roof, "v2 proposals matcher proposal");
+
+	/*
+	 * First pass: find the distinct transforms of each type and
+	 * count the local proposals containing each.
+	 */
+	unsigned nr_matches = 0;
+	int propnum;
+	struct ikev2_proposal *proposal;
+	FOR_EACH_V2_PROPOSAL(propnum, proposal, proposals) {
+		lset_t all_transform_types = LEMPTY;
+		lset_t optional_transform_types = LEMPTY;
+		enum ikev2_trans_type type;
+		struct ikev2_transforms *transforms;
+		FOR_EACH_TRANSFORMS_TYPE(type, transforms, proposal) {
+			struct ikev2_transform *transform;
+			FOR_EACH_TRANSFORM(transform, transforms) {
+				all_transform_types |= LELEM(type);
+				/*
+				 * When INTEG=NONE and/or DH=NONE is
+				 * included in a local proposal, the
+				 * transform is optional and, when
+				 * missing from a remote proposal,
+				 * NONE is implied.
+				 */
+				if ((type == IKEv2_TRANS_TYPE_INTEG &&
+				     transform->id == IKEv2_INTEG_NONE) ||
+				    (type == IKEv2_TRANS_TYPE_DH &&
+				     transform->id == OAKLEY_GROUP_NONE)) {
+					optional_transform_types |= LELEM(type);
+				}
+				struct ikev2_transform_key *key =
+					find_transform_key(matcher, type, transform);
+				if (key == NULL) {
+					unsigned nr = matcher->transforms[type].nr++;
+					realloc_things(matcher->transforms[type].key, nr, nr + 1,
+						       "v2 proposals matcher keys");
+					key = &matcher->transforms[type].key[nr];
+					*key = (struct ikev2_transform_key) {
+						.id = transform->id,
+						.attr_keylen = transform->attr_keylen,
+					};
+				}
+				/* only the first, lowest, index counts */
+				if (first_transform(transforms, transform)) {
+					key->nr_matches++;
+					nr_matches++;
+				}
+			}
+			/* save the sentinel */
+			passert(!transform->valid);
+			matcher->proposal[propnum].sentinel_transform[type] =
+				transform - transforms->transform;
+			dbg("local proposal %d type %s has %td transforms",
+			    propnum, trans_type_name(type),
+			    transform - transforms->transform);
+		}
+		/*
+		 * A proposal's transform type can't be both required
+		 * an optional.
+		 *
+		 * Since a proposal containing DH=NONE + DH=MODP2048 is
+		 * valid, REQUIRED gets computed (INTEG=NONE +
+		 * INTEG=SHA1 isn't valid but that should only happen
+		 * when impaired).
+		 */
+		matcher->proposal[propnum].optional_transform_types = optional_transform_types;
+		matcher->proposal[propnum].required_transform_types = all_transform_types & ~optional_transform_types;
+		LSWDBGP(DBG_BASE, buf) {
+			jam(buf, "local proposal %d transforms: required: ",
+			    propnum);
+			jam_trans_types(buf, matcher->proposal[propnum].required_transform_types);
+			jam(buf, "; optional: ");
+			jam_trans_types(buf, matcher->proposal[propnum].optional_transform_types);
+		}
+	}
+
+	/*
+	 * Lay out each key's list of matches, in one block.
+	 */
+	if (nr_matches > 0) {
+		matcher->matches = alloc_things(struct ikev2_transform_match, nr_matches,
+						"v2 proposals matcher matches");
+	}
+	struct ikev2_transform_match *next_match = matcher->matches;
+	for (enum ikev2_trans_type type = 1; type < IKEv2_TRANS_TYPE_ROOF; type++) {
+		for (unsigned k = 0; k < matcher->transforms[type].nr; k++) {
+			struct ikev2_transform_key *key = &matcher->transforms[type].key[k];
+			key->match = next_match;
+			next_match += key->nr_matches;
+			key->nr_matches = 0;
+		}
+	}
+	passert(next_match == matcher->matches + nr_matches);
+
+	/*
+	 * Second pass: fill in each key's list; proposals are visited
+	 * in order so the lists are sorted by proposal.
+	 */
+	FOR_EACH_V2_PROPOSAL(propnum, proposal, proposals) {
+		enum ikev2_trans_type type;
+		struct ikev2_transforms *transforms;
+		FOR_EACH_TRANSFORMS_TYPE(type, transforms, proposal) {
+			struct ikev2_transform *transform;
+			FOR_EACH_TRANSFORM(transform, transforms) {
+				if (!first_transform(transforms, transform)) {
+					continue;
+				}
+				struct ikev2_transform_key *key =
+					find_transform_key(matcher, type, transform);
+				passert(key != NULL);
+				key->match[key->nr_matches++] = (struct ikev2_transform_match) {
+					.propnum = propnum,
+					.transform = transform - transforms->transform,
+				};
+			}
+		}
+	}
+
+	for (enum ikev2_trans_type type = 1; type < IKEv2_TRANS_TYPE_ROOF; type++) {
+		if (matcher->transforms[type].nr > 1) {
+			qsort(matcher->transforms[type].key, matcher->transforms[type].nr,
+			      sizeof(struct ikev2_transform_key), transform_key_cmp);
+		}
+	}
+
+	proposals->matcher = matcher;
+}
+
 /*
  * Compare the initiator's proposal's transforms against local
  * proposals [LOCAL_PROPNUM_BASE .. LOCAL_PROPNUM_BOUND) finding the
@@ -406,7 +668,28 @@ void llog_v2_proposals(lset_t rc_flags, struct logger *logger,
  * is accumulated in REMOTE_JAM_BUF.
  */
 
+static struct ikev2_proposal_match *current_matching_local_proposal(struct ikev2_proposal_match *matching_local_proposals,
+								    const struct ikev2_proposals_matcher *matcher,
+								    int local_propnum,
+								    unsigned remote_proposal_nr)
+{
+	struct ikev2_proposal_match *matching_local_proposal = &matching_local_proposals[local_propnum];
+	if (matching_local_proposal->remote_proposal_nr != remote_proposal_nr) {
+		matching_local_proposal->remote_proposal_nr = remote_proposal_nr;
+		/* clear matched */
+		matching_local_proposal->matched_transform_types = LEMPTY;
+		/* start with the sentinels */
+		passert(sizeof(matching_local_proposal->matching_transform) ==
+			sizeof(matcher->proposal[local_propnum].sentinel_transform));
+		memcpy(matching_local_proposal->matching_transform,
+		       matcher->proposal[local_propnum].sentinel_transform,
+		       sizeof(matching_local_proposal->matching_transform));
+	}
+	return matching_local_proposal;
+}
+
 static int process_transforms(pb_stream *prop_pbs, struct jambuf *remote_jam_buf,
+			      unsigned remote_proposal_nr,
 			      unsigned remote_propnum, int num_remote_transforms,
 			      enum ikev2_sec_proto_id remote_protoid,
 			      const struct ikev2_proposals *local_proposals,
@@ -421,30 +704,18 @@ static int process_transforms(pb_stream *prop_pbs, struct jambuf *remote_jam_buf
 
 	/*
 	 * The MATCHING_LOCAL_PROPOSALS table contains one entry per
-	 * local proposal.  Each entry points to the best matching or
+	 * local proposal.  Each entry indexes the best matching or
 	 * sentinel transforms for that proposal.
 	 *
-	 * Initially the MATCHING_TRANSFORM[TRANS_TYPE]s point to the
-	 * proposal's sentinel transforms making an upper bound on
-	 * searches.  If a transform matches, then the pointer is
-	 * updated (reduced) accordingly.
+	 * The first time a remote transform matches a local proposal,
+	 * the entry's MATCHING_TRANSFORM[TRANS_TYPE]s are reset to
+	 * index the proposal's sentinel transforms making an upper
+	 * bound on searches.  If a transform matches, then the index
+	 * is updated (reduced) accordingly.  Entries for local
+	 * proposals that nothing matched are left alone.
 	 */
-	{
-		int local_propnum;
-		const struct ikev2_proposal *local_proposal;
-		FOR_EACH_V2_PROPOSAL_IN_RANGE(local_propnum, local_proposal, local_proposals,
-					      local_propnum_base, local_propnum_bound) {
-			struct ikev2_proposal_match *matching_local_proposal = &matching_local_proposals[local_propnum];
-			/* clear matched */
-			matching_local_proposal->matched_transform_types = LEMPTY;
-			/* start with the sentinels */
-			passert(sizeof(matching_local_proposal->matching_transform) ==
-				sizeof(matching_local_proposal->sentinel_transform));
-			memcpy(matching_local_proposal->matching_transform,
-			       matching_local_proposal->sentinel_transform,
-			       sizeof(matching_local_proposal->sentinel_transform));
-		}
-	}
+	const struct ikev2_proposals_matcher *matcher = local_proposals->matcher;
+	passert(matcher != NULL);
 
 	/*
 	 * Track all the remote transform types included in the
@@ -570,70 +841,57 @@ static int process_transforms(pb_stream *prop_pbs, struct jambuf *remote_jam_buf
 
 		/*
 		 * Find the proposals that match and flag them.
+		 *
+		 * The table lookup finds, for each local proposal,
+		 * the first transform of this type that matches.
+		 * Only keep it when it is earlier than the previous
+		 * best match.
 		 */
-		int local_propnum;
-		struct ikev2_proposal *local_proposal;
-		FOR_EACH_V2_PROPOSAL_IN_RANGE(local_propnum, local_proposal, local_proposals,
-					      local_propnum_base, local_propnum_bound) {
-			if (local_proposal->protoid == remote_protoid) {
-				/*
-				 * Search the proposal for transforms of this
-				 * type that match.  Limit the search to
-				 * transforms before the last match.
-				 */
-				passert(type < elemsof(local_proposal->transforms)); /* aka IKEv2_TRANS_TYPE_ROOF */
-				const struct ikev2_transforms *local_transforms = &local_proposal->transforms[type];
-				struct ikev2_proposal_match *matching_local_proposal = &matching_local_proposals[local_propnum];
-				passert(type < elemsof(matching_local_proposal->matching_transform)); /* aka IKEv2_TRANS_TYPE_ROOF */
-				const struct ikev2_transform **matching_local_transform = &matching_local_proposal->matching_transform[type];
-				/*
-				 * The matching local transform always
-				 * points into the local transform
-				 * array (which includes includes the
-				 * sentinel transform at the array
-				 * end).
-				 */
-				passert(*matching_local_transform >= &local_transforms->transform[0]);
-				passert(*matching_local_transform < &local_transforms->transform[elemsof(local_transforms->transform)]);
-				/*
-				 * See if this match improves things.
-				 */
-				const struct ikev2_transform *local_transform;
-				FOR_EACH_TRANSFORM(local_transform, local_transforms) {
-					if (local_transform >= *matching_local_transform) {
-						break;
-					}
-					if (local_transform->id == remote_transform.id &&
-					    local_transform->attr_keylen == remote_transform.attr_keylen) {
-						LSWDBGP(DBG_BASE, buf) {
-							jam(buf, "remote proposal %u transform %d (",
-							    remote_propnum, remote_transform_nr);
-							jam_type_transform(buf, type, &remote_transform);
-							jam(buf, ") matches local proposal %d type %d (%s) transform %td",
-							    local_propnum,
-							    type, trans_type_name(type),
-							    local_transform - local_transforms->transform);
-						}
-						/*
-						 * Update the sentinel
-						 * with this new best
-						 * match for this
-						 * local proposal.
-						 */
-						*matching_local_transform = local_transform;
-						/*
-						 * Also record that
-						 * the local transform
-						 * type has
-						 * successfully
-						 * matched.
-						 */
-						matched_remote_transform_types |= LELEM(type);
-						matching_local_proposal->matched_transform_types |= LELEM(type);
-						break;
-					}
-				}
+		passert(type < elemsof(matcher->transforms)); /* aka IKEv2_TRANS_TYPE_ROOF */
+		const struct ikev2_transform_key *key =
+			lookup_transform_key(matcher, type, &remote_transform);
+		if (key == NULL) {
+			continue;
+		}
+		for (const struct ikev2_transform_match *match = key->match;
+		     match < key->match + key->nr_matches; match++) {
+			int local_propnum = match->propnum;
+			if (local_propnum < local_propnum_base) {
+				continue;
+			}
+			if (local_propnum >= local_propnum_bound) {
+				break;	/* sorted */
+			}
+			if (local_proposals->proposal[local_propnum].protoid != remote_protoid) {
+				continue;
 			}
+			struct ikev2_proposal_match *matching_local_proposal =
+				current_matching_local_proposal(matching_local_proposals, matcher,
+								local_propnum, remote_proposal_nr);
+			uint8_t local_transform = match->transform;
+			if (local_transform >= matching_local_proposal->matching_transform[type]) {
+				continue;
+			}
+			LSWDBGP(DBG_BASE, buf) {
+				jam(buf, "remote proposal %u transform %d (",
+				    remote_propnum, remote_transform_nr);
+				jam_type_transform(buf, type, &remote_transform);
+				jam(buf, ") matches local proposal %d type %d (%s) transform %u",
+				    local_propnum,
+				    type, trans_type_name(type),
+				    local_transform);
+			}
+			/*
+			 * Update the sentinel with this new best
+			 * match for this local proposal.
+			 */
+			matching_local_proposal->matching_transform[type] = local_transform;
+			/*
+			 * Also record that the local transform type
+			 * has successfully matched.
+			 */
+			matched_remote_transform_types |= LELEM(type);
+			matching_local_proposal->matched_transform_types |= LELEM(type);
 		}
 	}
 
@@ -678,7 +936,12 @@ static int process_transforms(pb_stream *prop_pbs, struct jambuf *remote_jam_buf
 	struct ikev2_proposal *local_proposal;
 	FOR_EACH_V2_PROPOSAL_IN_RANGE(local_propnum, local_proposal, local_proposals,
 				      local_propnum_base, local_propnum_bound) {
-		struct ikev2_proposal_match *matching_local_proposal = &matching_local_proposals[local_propnum];
+		/* an entry that nothing touched matched nothing */
+		const struct ikev2_proposal_match *matching_local_proposal =
+			&matching_local_proposals[local_propnum];
+		lset_t matched_transform_types =
+			(matching_local_proposal->remote_proposal_nr == remote_proposal_nr ?
+			 matching_local_proposal->matched_transform_types : LEMPTY);
 		LSWDBGP(DBG_BASE, log) {
 			jam(log, "comparing remote proposal %u containing ",
 			    remote_propnum);
@@ -686,14 +949,13 @@ static int process_transforms(pb_stream *prop_pbs, struct jambuf *remote_jam_buf
 			jam(log, " transforms to local proposal %d",
 			    local_propnum);
 			jam(log, "; required: ");
-			jam_trans_types(log, matching_local_proposal->
+			jam_trans_types(log, matcher->proposal[local_propnum].
 					required_transform_types);
 			jam(log, "; optional: ");
-			jam_trans_types(log, matching_local_proposal->
+			jam_trans_types(log, matcher->proposal[local_propnum].
 					optional_transform_types);
 			jam(log, "; matched: ");
-			jam_trans_types(log, matching_local_proposal->
-					matched_transform_types);
+			jam_trans_types(log, matched_transform_types);
 		}
 		/*
 		 * Using the set relationships:
@@ -711,7 +973,7 @@ static int process_transforms(pb_stream *prop_pbs, struct jambuf *remote_jam_buf
 		 */
 		lset_t unmatched =
 			(proposed_remote_transform_types
-			 & ~matching_local_proposal->matched_transform_types);
+			 & ~matched_transform_types);
 		/*
 		 *   missing = required_local - matched_local
 		 *
@@ -721,8 +983,8 @@ static int process_transforms(pb_stream *prop_pbs, struct jambuf *remote_jam_buf
 		 *     Optional transforms are not included.
 		 */
 		lset_t missing =
-			(matching_local_proposal->required_transform_types
-			 & ~matching_local_proposal->matched_transform_types);
+			(matcher->proposal[local_propnum].required_transform_types
+			 & ~matched_transform_types);
 		/*
 		 * vis:
 		 *
@@ -771,6 +1033,9 @@ static int process_transforms(pb_stream *prop_pbs, struct jambuf *remote_jam_buf
 		} else {
 			dbg("remote proposal %u matches local proposal %d",
 			    remote_propnum, local_propnum);
+			/* the caller reads the entry; make it current */
+			current_matching_local_proposal(matching_local_proposals, matcher,
+							local_propnum, remote_proposal_nr);
 			return local_propnum;
 		}
 	}
@@ -815,80 +1080,17 @@ static int ikev2_process_proposals(pb_stream *sa_payload,
 	 * far.
 	 *
 	 * The MATCHING_LOCAL_PROPOSALS table contains one entry per
-	 * local proposal, and each entry contains a pointer best
-	 * matching transform, or the sentinel transform.
-	 *
-	 * The required, optional, and sentinel fields are initialized
-	 * here.  The remaining fields are initialized each time a
-	 * remote proposal is parsed.
+	 * local proposal, and each entry contains the index of the
+	 * best matching transform, or the sentinel transform.  An
+	 * entry is reset when a remote proposal's transform first
+	 * matches it; REMOTE_PROPOSAL_NR tells stale entries apart.
 	 *
 	 * Must be freed.
 	 */
 	struct ikev2_proposal_match *matching_local_proposals =
 		alloc_things(struct ikev2_proposal_match, local_proposals->roof,
 			     "matching_local_proposals");
-	{
-		int local_propnum;
-		struct ikev2_proposal *local_proposal;
-		FOR_EACH_V2_PROPOSAL(local_propnum, local_proposal, local_proposals) {
-			struct ikev2_proposal_match *matching_local_proposal = &matching_local_proposals[local_propnum];
-			enum ikev2_trans_type type;
-			struct ikev2_transforms *local_transforms;
-			lset_t all_transform_types = LEMPTY;
-			lset_t optional_transform_types = LEMPTY;
-			FOR_EACH_TRANSFORMS_TYPE(type, local_transforms, local_proposal) {
-				/*
-				 * Find the sentinel transform for
-				 * this transform-type.
-				 */
-				struct ikev2_transform *sentinel_transform;
-				FOR_EACH_TRANSFORM(sentinel_transform, local_transforms) {
-					all_transform_types |= LELEM(type);
-					/*
-					 * When INTEG=NONE and/or
-					 * DH=NONE is included in a
-					 * local proposal, the
-					 * transform is optional and,
-					 * when missing from a remote
-					 * proposal, NONE is implied.
-					 */
-					if ((type == IKEv2_TRANS_TYPE_INTEG &&
-					     sentinel_transform->id == IKEv2_INTEG_NONE) ||
-					    (type == IKEv2_TRANS_TYPE_DH &&
-					     sentinel_transform->id == OAKLEY_GROUP_NONE)) {
-						optional_transform_types |= LELEM(type);
-					}
-				}
-				/* save the sentinel */
-				passert(!sentinel_transform->valid);
-				matching_local_proposal->sentinel_transform[type] = sentinel_transform;
-				dbg("local proposal %d type %s has %td transforms",
-				    local_propnum, trans_type_name(type),
-				    sentinel_transform - local_transforms->transform);
-			}
-			/*
-			 * A proposal's transform type can't be both
-			 * required an optional.
-			 *
-			 * Since a proposal containing DH=NONE +
-			 * DH=MODP2048 is valid, REQUIRED gets
-			 * computed (INTEG=NONE + INTEG=SHA1 isn't
-			 * valid but that should only happen when
-			 * impaired).
-			 */
-			matching_local_proposal->optional_transform_types = optional_transform_types;
-			matching_local_proposal->required_transform_types = all_transform_types & ~optional_transform_types;
-			LSWDBGP(DBG_BASE, buf) {
-				jam(buf, "local proposal %d transforms: required: ",
-					local_propnum);
-				jam_trans_types(buf, matching_local_proposal->
-						required_transform_types);
-				jam(buf, "; optional: ");
-				jam_trans_types(buf, matching_local_proposal->
-						optional_transform_types);
-			}
-		}
-	}
+	unsigned remote_proposal_nr = 0; /* entries start out stale */
 
 	/*
 	 * This loop contains no "return" statements.  Instead it
@@ -1033,6 +1235,7 @@ static int ikev2_process_proposals(pb_stream *sa_payload,
 					       : local_proposals->roof);
 		}
 		int match = process_transforms(&proposal_pbs, remote_jam_buf,
+					       ++remote_proposal_nr,
 					       remote_proposal.isap_propnum,
 					       remote_proposal.isap_numtrans,
 					       remote_proposal.isap_protoid,
@@ -1074,11 +1277,15 @@ static int ikev2_process_proposals(pb_stream *sa_payload,
 			struct ikev2_transforms *best_transforms;
 			const struct ikev2_proposal_match *matching_local_proposal =
 				&matching_local_proposals[matching_local_propnum];
+			const struct ikev2_proposal *matching_proposal =
+				&local_proposals->proposal[matching_local_propnum];
+			lset_t optional_transform_types =
+				local_proposals->matcher->proposal[matching_local_propnum].optional_transform_types;
 			FOR_EACH_TRANSFORMS_TYPE(type, best_transforms, best_proposal) {
-				const struct ikev2_transform *matching_transform = matching_local_proposal->matching_transform[type];
-				passert(matching_transform != NULL);
+				const struct ikev2_transform *matching_transform =
+					&matching_proposal->transforms[type].transform[matching_local_proposal->matching_transform[type]];
 				if (!matching_transform->valid &&
-				    LHAS(matching_local_proposal->optional_transform_types, type)) {
+				    LHAS(optional_transform_types, type)) {
 					/*
 					 * DH=NONE and/or INTEG=NONE
 					 * is implied.
@@ -1773,6 +1980,7 @@ struct ikev2_proposals *ikev2_proposals_from_proposal(const char *story, const s
 	proposals->proposal[1] = *proposal;
 	proposals->proposal[1].propnum = 0; /* auto assign */
 	zero_thing(proposals->proposal[1].remote_spi);
+	compile_ikev2_proposals(proposals);
 	LSWDBGP(DBG_BASE, buf) {
 		jam_string(buf, story);
 		jam_v2_proposals(buf, proposals);
@@ -1780,11 +1988,37 @@ struct ikev2_proposals *ikev2_proposals_from_proposal(const char *story, const s
 	return proposals;
 }
 
+/*
+ * Reconstruct an accepted IKE proposal from TA; used when an IKE SA
+ * is resumed (RFC 5723) and there was no SA payload to accept.
+ */
+
+struct ikev2_proposal *ikev2_proposal_from_trans_attrs(const struct trans_attrs *ta)
+{
+	struct ikev2_proposal *proposal = alloc_thing(struct ikev2_proposal,
+						      "resumed IKE proposal");
+	proposal->protoid = IKEv2_SEC_PROTO_IKE;
+	proposal->propnum = 1;
+	append_transform(proposal, IKEv2_TRANS_TYPE_ENCR,
+			 ta->ta_encrypt->common.id[IKEv2_ALG_ID],
+			 (ta->ta_encrypt->keylen_omitted ? 0 : ta->enckeylen));
+	append_transform(proposal, IKEv2_TRANS_TYPE_PRF,
+			 ta->ta_prf->common.id[IKEv2_ALG_ID], 0);
+	if (ta->ta_integ != NULL && ta->ta_integ != &ike_alg_integ_none) {
+		append_transform(proposal, IKEv2_TRANS_TYPE_INTEG,
+				 ta->ta_integ->common.id[IKEv2_ALG_ID], 0);
+	}
+	append_transform(proposal, IKEv2_TRANS_TYPE_DH,
+			 ta->ta_dh->common.id[IKEv2_ALG_ID], 0);
+	return proposal;
+}
+
 void free_ikev2_proposals(struct ikev2_proposals **proposals)
 {
 	if (proposals == NULL || *proposals == NULL) {
 		return;
 	}
+	free_ikev2_proposals_matcher(&(*proposals)->matcher);
 	pfree((*proposals)->proposal);
 	pfree((*proposals));
 	*proposals = NULL;
@@ -2059,6 +2293,7 @@ struct ikev2_proposals *ikev2_proposals_from_proposals(enum ikev2_sec_proto_id p
 			v2_proposals->roof++;
 		}
 	}
+	compile_ikev2_proposals(v2_proposals);
 	return v2_proposals;
 }
 
@@ -2163,6 +2398,7 @@ struct ikev2_proposals *get_v2_child_proposals(struct connection *c,
 			}
 		}
 	}
+	compile_ikev2_proposals(v2_proposals);
 	return v2_proposals;
 }
 
@@ -2231,6 +2467,7 @@ static struct ikev2_proposals *get_v2_child_rekey_proposals(const char *story,
 				  /*2:MSDH_DOWNGRADE*/ OAKLEY_GROUP_NONE),
 				 0);
 	}
+	compile_ikev2_proposals(proposals);
 	LSWDBGP(DBG_BASE, buf) {
 		jam_string(buf, story);
 		jam_v2_proposals(buf, proposals);
@@ -71,6 +71,8 @@ bool ikev2_proposal_to_proto_info(const struct ikev2_proposal *proposal,
 
 struct ikev2_proposals *ikev2_proposals_from_proposal(const char *story, const struct ikev2_proposal *proposal);
 
+struct ikev2_proposal *ikev2_proposal_from_trans_attrs(const struct trans_attrs *ta);
+
 void free_ikev2_proposals(struct ikev2_proposals **proposals);
 
 void free_ikev2_proposal(struct ikev2_proposal **proposal);
@@ -74,13 +74,13 @@ static diag_t ikev2_calculate_psk_sighash(bool verify,
 	passert(ike->sa.hidden_variables.st_skeyid_calculated);
 
 	chunk_t intermediate_auth = empty_chunk;
-	if (ike->sa.st_v2_ike_intermediate.used) {
-		intermediate_auth = clone_hunk_hunk(ike->sa.st_v2_ike_intermediate.initiator,
-						    ike->sa.st_v2_ike_intermediate.responder,
+	if (ike->st_v2_ike_intermediate.used) {
+		intermediate_auth = clone_hunk_hunk(ike->st_v2_ike_intermediate.initiator,
+						    ike->st_v2_ike_intermediate.responder,
 						    "IntAuth_*_I_A | IntAuth_*_R");
 		/* IKE AUTH's first Message ID */
-		uint8_t ike_auth_mid[sizeof(ike->sa.st_v2_ike_intermediate.id)];
-		hton_bytes(ike->sa.st_v2_ike_intermediate.id + 1,
+		uint8_t ike_auth_mid[sizeof(ike->st_v2_ike_intermediate.id)];
+		hton_bytes(ike->st_v2_ike_intermediate.id + 1,
 			   ike_auth_mid, sizeof(ike_auth_mid));
 		append_chunk_thing("IKE_AUTH_MID", &intermediate_auth, ike_auth_mid);
 	}
@@ -318,8 +318,12 @@ diag_t verify_v2AUTH_and_log_using_psk(enum keyword_auth authby,
 		/* what was in the AUTH payload */
 		/* XXX: log prf(prf(hash based on null or secret)) how? */
 		/* now it was authenticated */
-		jam_string(buf, "using authby=");
-		jam_enum(buf, &keyword_auth_names, authby);
+		if (ike->sa.st_v2_resumption != NULL) {
+			jam_string(buf, "using session resumption ticket");
+		} else {
+			jam_string(buf, "using authby=");
+			jam_enum(buf, &keyword_auth_names, authby);
+		}
 		jam_string(buf, " and ");
 		jam_enum(buf, &ike_id_type_names, ike->sa.st_connection->remote->host.id.kind);
 		jam_string(buf, " '");
@@ -0,0 +1,346 @@
+/* IKEv2 Session Resumption (RFC 5723), for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "defs.h"
+#include "log.h"
+#include "state.h"
+#include "demux.h"
+#include "connections.h"
+#include "packet.h"
+#include "unpack.h"		/* for unpack_peer_id() */
+#include "realtime.h"
+#include "crypt_hash.h"
+#include "crypt_symkey.h"
+#include "crypt_dh.h"		/* for calc_v2_keymat() */
+#include "ike_alg.h"
+#include "ike_alg_hash.h"
+#include "ikev2_message.h"
+#include "ikev2_send.h"
+#include "ikev2_proposals.h"
+#include "ikev2_resume.h"
+#include "ikev2_ticket.h"
+#include "pluto_stats.h"
+
+/*
+ * The ticket keys, the sealing, and the snapshot live in
+ * ikev2_ticket.c; this is the exchange side.
+ */
+
+static bool session_resumption = false;
+
+/*
+ * What a ticket is bound to: a hash of how each end of C
+ * authenticates; and C's generation, which changes whenever C is
+ * deleted (for instance by a reload).  A ticket issued before either
+ * changed is not used.
+ */
+
+static void bind_v2_resumption(struct v2_resumption *r, const struct connection *c,
+			       struct logger *logger)
+{
+	struct crypt_hash *hash = crypt_hash_init("session resumption policy",
+						  &ike_alg_hash_sha2_256, logger);
+	const struct config_end *ends[] = { c->local->config, c->remote->config, };
+	FOR_EACH_ELEMENT(end, ends) {
+		const struct config_host_end *host = &(*end)->host;
+		crypt_hash_digest_thing(hash, "auth", host->auth);
+		crypt_hash_digest_thing(hash, "authby", host->authby);
+		crypt_hash_digest_thing(hash, "eap", host->eap);
+		crypt_hash_digest_byte(hash, "xauth server", host->xauth.server);
+		crypt_hash_digest_byte(hash, "xauth client", host->xauth.client);
+		uint32_t ca_len = host->ca.len;	/* so fields can't run together */
+		crypt_hash_digest_thing(hash, "ca length", ca_len);
+		crypt_hash_digest_hunk(hash, "ca", host->ca);
+	}
+	crypt_hash_digest_thing(hash, "sighash policy", c->config->sighash_policy);
+	passert(sizeof(r->policy_hash) <= ike_alg_hash_sha2_256.hash_digest_size);
+	crypt_hash_final_bytes(&hash, r->policy_hash, sizeof(r->policy_hash));
+	r->generation = v2_ticket_generation(c->name);
+}
+
+/*
+ * Does R, unsealed or unstashed, still match C?
+ */
+
+static const char *v2_resumption_mismatch(const struct v2_resumption *r,
+					  const struct connection *c,
+					  struct logger *logger)
+{
+	if (!streq(r->connection_name, c->name)) {
+		return "issued for another connection";
+	}
+	struct v2_resumption now = {0};
+	bind_v2_resumption(&now, c, logger);
+	if (!memeq(now.policy_hash, r->policy_hash, sizeof(now.policy_hash))) {
+		return "connection's authentication policy has changed";
+	}
+	if (now.generation != r->generation) {
+		return "connection has been reloaded";
+	}
+	return NULL;
+}
+
+/*
+ * Capture IKE's state; what a ticket for it needs to hold.
+ */
+
+static struct v2_resumption *resumption_from_ike(const struct ike_sa *ike)
+{
+	const struct connection *c = ike->sa.st_connection;
+	chunk_t sk_d = chunk_from_symkey("SK_d", ike->sa.st_skey_d_nss,
+					 ike->sa.st_logger);
+	if (sk_d.len == 0 || sk_d.len > UINT16_MAX) {
+		free_chunk_content(&sk_d);
+		return NULL;
+	}
+	struct v2_resumption *r = alloc_thing(struct v2_resumption, "session resumption");
+	r->encrypt = ike->sa.st_oakley.ta_encrypt;
+	r->enckeylen = ike->sa.st_oakley.enckeylen;
+	r->prf = ike->sa.st_oakley.ta_prf;
+	r->integ = ike->sa.st_oakley.ta_integ;
+	r->dh = ike->sa.st_oakley.ta_dh;
+	r->sk_d = sk_d;
+	shunk_t peer_id;
+	r->peer_id_type = id_to_payload(&c->remote->host.id, &c->remote->host.addr, &peer_id);
+	r->peer_id = clone_hunk(peer_id, "resumed peer ID");
+	r->connection_name = clone_str(c->name, "resumed connection name");
+	bind_v2_resumption(r, c, ike->sa.st_logger);
+	return r;
+}
+
+/*
+ * A ticket's lifetime is the IKE SA's, but never longer than the key
+ * used to seal it is kept.
+ */
+
+static deltatime_t v2_resumption_lifetime(const struct connection *c)
+{
+	deltatime_t lifetime = c->config->sa_ike_max_lifetime;
+	if (deltatime_cmp(lifetime, >, TICKET_KEY_LIFETIME)) {
+		lifetime = TICKET_KEY_LIFETIME;
+	}
+	return lifetime;
+}
+
+/*
+ * Initiator.
+ */
+
+struct v2_resumption *claim_v2_resumption_ticket(const struct connection *c,
+						 struct logger *logger)
+{
+	if (!session_resumption) {
+		return NULL;
+	}
+	struct v2_resumption *r = unstash_v2_ticket(c->name);
+	if (r == NULL) {
+		return NULL;
+	}
+	if (realtime_sub_sign(r->expires, realnow()) <= 0) {
+		llog(RC_LOG, logger, "session resumption ticket for \"%s\" has expired", c->name);
+		free_v2_resumption(&r);
+		return NULL;
+	}
+	const char *why = v2_resumption_mismatch(r, c, logger);
+	if (why != NULL) {
+		llog(RC_LOG, logger, "discarding session resumption ticket for \"%s\": %s",
+		     c->name, why);
+		free_v2_resumption(&r);
+		return NULL;
+	}
+	return r;
+}
+
+bool emit_v2N_TICKET_OPAQUE(const struct ike_sa *ike, struct pbs_out *outs)
+{
+	return emit_v2N_hunk(v2N_TICKET_OPAQUE, ike->sa.st_v2_resumption->ticket, outs);
+}
+
+bool emit_v2N_TICKET_REQUEST(const struct ike_sa *ike UNUSED, struct pbs_out *outs)
+{
+	if (!session_resumption) {
+		return true;
+	}
+	return emit_v2N(v2N_TICKET_REQUEST, outs);
+}
+
+void save_v2_resumption_ticket(struct ike_sa *ike, struct msg_digest *md)
+{
+	if (!session_resumption || md->pd[PD_v2N_TICKET_LT_OPAQUE] == NULL) {
+		return;
+	}
+
+	/* RFC 5723 3.2: 4-octet lifetime (seconds) then the ticket */
+	struct pbs_in pbs = md->pd[PD_v2N_TICKET_LT_OPAQUE]->pbs;
+	uint8_t lifetime[4];
+	diag_t d = pbs_in_raw(&pbs, lifetime, sizeof(lifetime), "ticket lifetime");
+	if (d != NULL) {
+		llog_diag(RC_LOG, ike->sa.st_logger, &d, "ignoring session resumption ticket: ");
+		return;
+	}
+	shunk_t ticket = pbs_in_left_as_shunk(&pbs);
+	if (ticket.len == 0 || ticket.len > UINT16_MAX) {
+		llog_sa(RC_LOG, ike, "ignoring session resumption ticket: bad length %zu", ticket.len);
+		return;
+	}
+
+	struct v2_resumption *r = resumption_from_ike(ike);
+	if (r == NULL) {
+		return;
+	}
+	uint32_t seconds = ntoh_bytes(lifetime, sizeof(lifetime));
+	r->expires = realtimesum(realnow(), deltatime(seconds));
+	r->ticket = clone_hunk(ticket, "resumption ticket");
+	stash_v2_ticket(r);
+	dbg("saved %zu byte session resumption ticket valid for %us",
+	    ticket.len, (unsigned)seconds);
+}
+
+/*
+ * Responder.
+ */
+
+struct v2_resumption *open_v2_resumption_ticket(struct msg_digest *md)
+{
+	const char *why;
+	struct v2_resumption *r = NULL;
+	if (!session_resumption) {
+		why = "not enabled";
+	} else if (md->pd[PD_v2N_TICKET_OPAQUE] == NULL) {
+		why = "missing";
+	} else {
+		why = unseal_v2_ticket(pbs_in_left_as_shunk(&md->pd[PD_v2N_TICKET_OPAQUE]->pbs),
+				       &r, md->md_logger);
+	}
+
+	if (why != NULL) {
+		llog(RC_LOG, md->md_logger, "session resumption ticket rejected: %s", why);
+		pstats_ikev2_resume_rejected++;
+		send_v2N_response_from_md(md, v2N_TICKET_NACK, NULL);
+		return NULL;
+	}
+	return r;
+}
+
+bool accept_v2_resumption_ticket(struct ike_sa *ike, struct msg_digest *md)
+{
+	const struct v2_resumption *r = ike->sa.st_v2_resumption;
+	const struct connection *c = ike->sa.st_connection;
+	const char *why = v2_resumption_mismatch(r, c, ike->sa.st_logger);
+	if (why != NULL) {
+		llog_sa(RC_LOG, ike, "session resumption ticket rejected: %s", why);
+		pstats_ikev2_resume_rejected++;
+		record_v2N_response(ike->sa.st_logger, ike, md,
+				    v2N_TICKET_NACK, NULL, UNENCRYPTED_PAYLOAD);
+		return false;
+	}
+	pstats_ikev2_resume_accepted++;
+	return true;
+}
+
+bool emit_v2N_TICKET_LT_OPAQUE(const struct ike_sa *ike,
+			       const struct msg_digest *md,
+			       struct pbs_out *outs)
+{
+	if (!session_resumption || md->pd[PD_v2N_TICKET_REQUEST] == NULL) {
+		return true;
+	}
+
+	struct v2_resumption *r = resumption_from_ike(ike);
+	if (r == NULL) {
+		dbg("can't issue session resumption ticket; SK_d unavailable");
+		return true;
+	}
+	intmax_t seconds = deltasecs(v2_resumption_lifetime(ike->sa.st_connection));
+	r->expires = realtimesum(realnow(), deltatime(seconds));
+	chunk_t ticket = seal_v2_ticket(r, ike->sa.st_logger);
+	free_v2_resumption(&r);
+	if (ticket.len == 0) {
+		return true;
+	}
+
+	uint8_t lifetime[4];
+	hton_bytes(seconds, lifetime, sizeof(lifetime));
+	struct pbs_out lt_opaque;
+	bool ok = (emit_v2Npl(v2N_TICKET_LT_OPAQUE, outs, &lt_opaque) &&
+		   pbs_out_raw(&lt_opaque, lifetime, sizeof(lifetime), "ticket lifetime") &&
+		   pbs_out_hunk(&lt_opaque, ticket, "ticket"));
+	free_chunk_content(&ticket);
+	if (!ok) {
+		return false;
+	}
+	close_output_pbs(&lt_opaque);
+	pstats_ikev2_resume_issued++;
+	return true;
+}
+
+/*
+ * Both.
+ */
+
+void apply_v2_resumption(struct ike_sa *ike)
+{
+	const struct v2_resumption *r = ike->sa.st_v2_resumption;
+	ike->sa.st_oakley.ta_encrypt = r->encrypt;
+	ike->sa.st_oakley.enckeylen = r->enckeylen;
+	ike->sa.st_oakley.ta_prf = r->prf;
+	ike->sa.st_oakley.ta_integ = r->integ;
+	ike->sa.st_oakley.ta_dh = r->dh;
+	free_ikev2_proposal(&ike->sa.st_v2_accepted_proposal);
+	ike->sa.st_v2_accepted_proposal = ikev2_proposal_from_trans_attrs(&ike->sa.st_oakley);
+}
+
+void calc_v2_resumption_keymat(struct ike_sa *ike, const ike_spis_t *ike_spis)
+{
+	struct v2_resumption *r = ike->sa.st_v2_resumption;
+	PK11SymKey *old_skey_d = prf_key_from_hunk("SK_d (old)", r->prf, r->sk_d,
+						   ike->sa.st_logger);
+	pexpect(ike->sa.st_dh_shared_secret == NULL);
+	calc_v2_keymat(&ike->sa, old_skey_d, r->prf, ike_spis);
+	release_symkey(__func__, "SK_d (old)", &old_skey_d);
+	/* no longer needed */
+	memset(r->sk_d.ptr, 0, r->sk_d.len);
+	free_chunk_content(&r->sk_d);
+}
+
+diag_t check_v2_resumption_peer_id(const struct ike_sa *ike, const struct id *peer_id)
+{
+	const struct v2_resumption *r = ike->sa.st_v2_resumption;
+	if (r == NULL) {
+		return NULL;
+	}
+	struct id ticket_id;
+	struct pbs_in pbs = pbs_in_from_shunk(HUNK_AS_SHUNK(r->peer_id), "ticket peer ID");
+	diag_t d = unpack_peer_id(r->peer_id_type, &ticket_id, &pbs);
+	if (d != NULL) {
+		return diag_diag(&d, "session resumption ticket peer ID invalid: ");
+	}
+	if (!same_id(&ticket_id, peer_id)) {
+		id_buf pb, tb;
+		return diag("peer ID '%s' does not match '%s' from the session resumption ticket",
+			    str_id(peer_id, &pb), str_id(&ticket_id, &tb));
+	}
+	return NULL;
+}
+
+void init_v2_resumption(bool enable, const char *snapshot_file,
+			struct logger *logger)
+{
+	session_resumption = (enable || snapshot_file != NULL);
+	if (!session_resumption) {
+		return;
+	}
+	init_v2_tickets(snapshot_file, logger);
+}
@@ -0,0 +1,68 @@
+/* IKEv2 Session Resumption (RFC 5723), for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef IKEV2_RESUME_H
+#define IKEV2_RESUME_H
+
+#include <stdbool.h>
+
+#include "diag.h"
+#include "ike_spi.h"
+
+struct ike_sa;
+struct msg_digest;
+struct connection;
+struct logger;
+struct pbs_out;
+struct id;
+
+struct v2_resumption;		/* see ikev2_ticket.h */
+
+void init_v2_resumption(bool enable, const char *snapshot_file,
+			struct logger *logger);
+
+/*
+ * Initiator: take (it is single use) the ticket saved for C, if
+ * any; emit it in the IKE_SESSION_RESUME request; and save any new
+ * ticket that arrives with the IKE_AUTH response.
+ */
+struct v2_resumption *claim_v2_resumption_ticket(const struct connection *c,
+						 struct logger *logger);
+bool emit_v2N_TICKET_OPAQUE(const struct ike_sa *ike, struct pbs_out *outs);
+bool emit_v2N_TICKET_REQUEST(const struct ike_sa *ike, struct pbs_out *outs);
+void save_v2_resumption_ticket(struct ike_sa *ike, struct msg_digest *md);
+
+/*
+ * Responder: decrypt the ticket in the IKE_SESSION_RESUME request
+ * (returning NULL and sending TICKET_NACK when it won't do); once the
+ * IKE SA exists, check the ticket was issued for its connection
+ * (recording TICKET_NACK when it wasn't); and, when asked, issue a
+ * ticket in the IKE_AUTH response.
+ */
+struct v2_resumption *open_v2_resumption_ticket(struct msg_digest *md);
+bool accept_v2_resumption_ticket(struct ike_sa *ike, struct msg_digest *md);
+bool emit_v2N_TICKET_LT_OPAQUE(const struct ike_sa *ike,
+			       const struct msg_digest *md,
+			       struct pbs_out *outs);
+
+/*
+ * Both ends: load the negotiated algorithms; and, once the nonces
+ * are known, derive the new keys from the old SK_d (no DH).
+ */
+void apply_v2_resumption(struct ike_sa *ike);
+void calc_v2_resumption_keymat(struct ike_sa *ike, const ike_spis_t *ike_spis);
+diag_t check_v2_resumption_peer_id(const struct ike_sa *ike, const struct id *peer_id);
+
+#endif
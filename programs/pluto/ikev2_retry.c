@@ -30,6 +30,7 @@
 #include "log.h"
 #include "pluto_stats.h"
 #include "ikev2_send.h"
+#include "ikev2_msgid.h"
 #include "pending.h"
 #include "ipsec_doi.h"
 #include "kernel.h"
@@ -165,8 +166,7 @@ void retransmit_v2_msg(struct state *ike_sa)
 
 	switch (retransmit(&ike->sa)) {
 	case RETRANSMIT_YES:
-		send_recorded_v2_message(ike, "EVENT_RETRANSMIT",
-					 MESSAGE_REQUEST);
+		send_v2_msgid_outstanding_requests(ike, "EVENT_RETRANSMIT");
 		return;
 	case RETRANSMIT_NO:
 		return;
@@ -44,7 +44,13 @@ bool send_recorded_v2_message(struct ike_sa *ike,
 			      const char *where,
 			      enum message_role message)
 {
-	struct v2_outgoing_fragment *frags = ike->sa.st_v2_outgoing[message];
+	return send_v2_outgoing_fragments(ike, where, ike->sa.st_v2_outgoing[message]);
+}
+
+bool send_v2_outgoing_fragments(struct ike_sa *ike,
+				const char *where,
+				struct v2_outgoing_fragment *frags)
+{
 	if (ike->sa.st_interface == NULL) {
 		log_state(RC_LOG, &ike->sa, "cannot send packet - interface vanished!");
 		return false;
@@ -54,14 +60,26 @@ bool send_recorded_v2_message(struct ike_sa *ike,
 		return false;
 	}
 
+	/*
+	 * Send the fragments in batches, so that the interface can
+	 * put each batch on the wire with one system call.
+	 */
 	unsigned nr_frags = 0;
-	for (struct v2_outgoing_fragment *frag = frags;
-	     frag != NULL; frag = frag->next) {
-		nr_frags++;
-		if (!send_hunk_using_state(&ike->sa, where, *frag)) {
-			dbg("send of %s fragment %u failed", where, nr_frags);
+	struct v2_outgoing_fragment *frag = frags;
+	while (frag != NULL) {
+		struct send_packet packets[SEND_PACKETS_MAX];
+		unsigned nr_packets = 0;
+		for (; frag != NULL && nr_packets < elemsof(packets); frag = frag->next) {
+			packets[nr_packets++] = (struct send_packet) {
+				.a = shunk2(frag->ptr, frag->len),
+			};
+		}
+		if (!send_packets_using_state(&ike->sa, where, packets, nr_packets)) {
+			dbg("send of %s fragments %u..%u failed",
+			    where, nr_frags + 1, nr_frags + nr_packets);
 			return false;
 		}
+		nr_frags += nr_packets;
 	}
 	dbg("sent %u messages", nr_frags);
 	return true;
@@ -421,6 +439,7 @@ void send_v2N_response_from_md(struct msg_digest *md,
 	 */
 	switch (exchange_type) {
 	case ISAKMP_v2_IKE_SA_INIT:
+	case ISAKMP_v2_IKE_SESSION_RESUME:
 	case ISAKMP_v2_IKE_AUTH:
 		break;
 	default:
@@ -161,19 +161,26 @@ struct finite_state v2_states[] = {
 static const lset_t everywhere_payloads = P(N) | P(V);	/* can appear in any packet */
 static const lset_t repeatable_payloads = P(N) | P(D) | P(CP) | P(V) | P(CERT) | P(CERTREQ);	/* if one can appear, many can appear */
 
-struct ikev2_payload_errors ikev2_verify_payloads(struct msg_digest *md,
-						  const struct payload_summary *summary,
-						  const struct ikev2_expected_payloads *payloads)
+/*
+ * Convert SKF onto SK for the comparison (but only when it is on its
+ * own).
+ */
+
+static lset_t v2_seen_payloads(const struct payload_summary *summary)
 {
-	/*
-	 * Convert SKF onto SK for the comparison (but only when it is
-	 * on its own).
-	 */
 	lset_t seen = summary->present;
 	if ((seen & (P(SKF)|P(SK))) == P(SKF)) {
 		seen &= ~P(SKF);
 		seen |= P(SK);
 	}
+	return seen;
+}
+
+struct ikev2_payload_errors ikev2_verify_payloads(struct msg_digest *md,
+						  const struct payload_summary *summary,
+						  const struct ikev2_expected_payloads *payloads)
+{
+	lset_t seen = v2_seen_payloads(summary);
 
 	lset_t req_payloads = payloads->required;
 	lset_t opt_payloads = payloads->optional;
@@ -200,15 +207,71 @@ struct ikev2_payload_errors ikev2_verify_payloads(struct msg_digest *md,
 	return errors;
 }
 
+/*
+ * Same answer as ikev2_verify_payloads(), but without gathering up
+ * the details needed to log a mismatch; SEEN is from
+ * v2_seen_payloads().
+ */
+
+static bool v2_payloads_fit(struct msg_digest *md,
+			    const struct payload_summary *summary, lset_t seen,
+			    const struct ikev2_expected_payloads *payloads)
+{
+	lset_t allowed = payloads->required | payloads->optional | everywhere_payloads;
+	if ((payloads->required & ~seen) != LEMPTY ||
+	    (seen & ~allowed) != LEMPTY ||
+	    (summary->repeated & ~repeatable_payloads) != LEMPTY) {
+		return false;
+	}
+	if (payloads->notification != v2N_NOTHING_WRONG &&
+	    md->pd[v2_pd_from_notification(payloads->notification)] == NULL) {
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Each state's transitions indexed by the incoming message's
+ * exchange type and role.  Bit N set means .v2.transitions[N] is a
+ * candidate; visiting the bits lowest first tries the candidates in
+ * table order.  Transitions that initiate an exchange are indexed
+ * under NO_MESSAGE.
+ */
+
+#define V2_EXCHANGE_FLOOR ISAKMP_v2_IKE_SA_INIT
+#define V2_EXCHANGE_ROOF (ISAKMP_v2_IKE_INTERMEDIATE + 1)
+
+static lset_t v2_transitions_by_exchange[STATE_IKEv2_ROOF - STATE_IKEv2_FLOOR]
+					[V2_EXCHANGE_ROOF - V2_EXCHANGE_FLOOR]
+					[MESSAGE_ROLE_ROOF];
+
+void init_v2_state_transition_index(void)
+{
+	for (enum state_kind kind = STATE_IKEv2_FLOOR; kind < STATE_IKEv2_ROOF; kind++) {
+		const struct finite_state *fs = &v2_states[kind - STATE_IKEv2_FLOOR];
+		passert(fs->nr_transitions <= LELEM_ROOF);
+		for (unsigned i = 0; i < fs->nr_transitions; i++) {
+			const struct v2_state_transition *t = &fs->v2.transitions[i];
+			if (t->recv_role == NO_MESSAGE &&
+			    t->send_role != MESSAGE_REQUEST) {
+				/* neither matches an incoming message nor initiates */
+				continue;
+			}
+			passert(t->exchange >= V2_EXCHANGE_FLOOR);
+			passert(t->exchange < V2_EXCHANGE_ROOF);
+			passert(t->recv_role < MESSAGE_ROLE_ROOF);
+			v2_transitions_by_exchange[kind - STATE_IKEv2_FLOOR]
+				[t->exchange - V2_EXCHANGE_FLOOR][t->recv_role] |= LELEM(i);
+		}
+	}
+}
+
 static const struct v2_state_transition *v2_state_transition(struct logger *logger,
 							     const struct finite_state *state,
 							     struct msg_digest *md,
 							     bool check_secured_payloads,
 							     bool *secured_payload_failed)
 {
-	struct ikev2_payload_errors message_payload_status = { .bad = false };
-	struct ikev2_payload_errors encrypted_payload_status = { .bad = false };
-
 	LSWDBGP(DBG_BASE, buf) {
 		jam(buf, "looking for transition from %s matching ",
 		    state->short_name);
@@ -218,39 +281,52 @@ static const struct v2_state_transition *v2_state_transition(struct logger *logg
 		}
 	}
 
-	for (unsigned i = 0; i < state->nr_transitions; i++) {
-		const struct v2_state_transition *transition = &state->v2.transitions[i];
+	/*
+	 * Only consider transitions expecting this exchange and
+	 * message role.
+	 */
+	lset_t candidates = LEMPTY;
+	enum message_role role = v2_msg_role(md);
+	if (md->hdr.isa_xchg >= V2_EXCHANGE_FLOOR &&
+	    md->hdr.isa_xchg < V2_EXCHANGE_ROOF &&
+	    role != NO_MESSAGE &&
+	    role < MESSAGE_ROLE_ROOF &&
+	    pexpect(state->kind >= STATE_IKEv2_FLOOR) &&
+	    pexpect(state->kind < STATE_IKEv2_ROOF)) {
+		candidates = v2_transitions_by_exchange[state->kind - STATE_IKEv2_FLOOR]
+			[md->hdr.isa_xchg - V2_EXCHANGE_FLOOR][role];
+	}
+	if (candidates == LEMPTY) {
+		enum_buf xb;
+		dbg("  no transitions for %s %s",
+		    str_enum_short(&ikev2_exchange_names, md->hdr.isa_xchg, &xb),
+		    (role == MESSAGE_REQUEST ? "request" :
+		     role == MESSAGE_RESPONSE ? "response" :
+		     "no-message"));
+	} else if (!pexpect(md->message_payloads.parsed)) {
+		return NULL;
+	}
 
-		dbg("  trying: %s", transition->story);
+	/*
+	 * When nothing fits, the last mismatch is logged.
+	 */
+	const struct ikev2_expected_payloads *message_payload_mismatch = NULL;
+	const struct ikev2_expected_payloads *encrypted_payload_mismatch = NULL;
+	lset_t message_seen = v2_seen_payloads(&md->message_payloads);
+	lset_t encrypted_seen = v2_seen_payloads(&md->encrypted_payloads);
 
-		/* message type? */
-		if (transition->exchange != md->hdr.isa_xchg) {
-			enum_buf xb;
-			dbg("    exchange type does not match %s",
-			    str_enum_short(&ikev2_exchange_names, transition->exchange, &xb));
-			continue;
-		}
+	for (lset_t c = candidates; c != LEMPTY; c &= c - 1) {
+		const struct v2_state_transition *transition =
+			&state->v2.transitions[__builtin_ctzll(c)];
 
-		/* role? */
-		if (transition->recv_role != v2_msg_role(md)) {
-			dbg("     message role does not match %s",
-			    (transition->recv_role == MESSAGE_REQUEST ? "request" :
-			     transition->recv_role == MESSAGE_RESPONSE ? "response" :
-			     "no-message"));
-			continue;
-		}
+		dbg("  trying: %s", transition->story);
 
 		/* message payloads */
-		if (!pexpect(md->message_payloads.parsed)) {
-			return NULL;
-		}
-		struct ikev2_payload_errors message_payload_errors
-			= ikev2_verify_payloads(md, &md->message_payloads,
-						&transition->message_payloads);
-		if (message_payload_errors.bad) {
+		if (!v2_payloads_fit(md, &md->message_payloads, message_seen,
+				     &transition->message_payloads)) {
 			dbg("    message payloads do not match");
 			/* save error for last pattern!?! */
-			message_payload_status = message_payload_errors;
+			message_payload_mismatch = &transition->message_payloads;
 			continue;
 		}
 
@@ -279,13 +355,11 @@ static const struct v2_state_transition *v2_state_transition(struct logger *logg
 		    !pexpect(state->v2.secured)) {
 			return NULL;
 		}
-		struct ikev2_payload_errors encrypted_payload_errors
-			= ikev2_verify_payloads(md, &md->encrypted_payloads,
-						&transition->encrypted_payloads);
-		if (encrypted_payload_errors.bad) {
+		if (!v2_payloads_fit(md, &md->encrypted_payloads, encrypted_seen,
+				     &transition->encrypted_payloads)) {
 			dbg("    secured payloads do not match");
 			/* save error for last pattern!?! */
-			encrypted_payload_status = encrypted_payload_errors;
+			encrypted_payload_mismatch = &transition->encrypted_payloads;
 			continue;
 		}
 
@@ -293,6 +367,20 @@ static const struct v2_state_transition *v2_state_transition(struct logger *logg
 		return transition;
 	}
 
+	/* now gather the details */
+	struct ikev2_payload_errors message_payload_status = { .bad = false };
+	struct ikev2_payload_errors encrypted_payload_status = { .bad = false };
+	if (message_payload_mismatch != NULL) {
+		message_payload_status = ikev2_verify_payloads(md, &md->message_payloads,
+							       message_payload_mismatch);
+		pexpect(message_payload_status.bad);
+	}
+	if (encrypted_payload_mismatch != NULL) {
+		encrypted_payload_status = ikev2_verify_payloads(md, &md->encrypted_payloads,
+								 encrypted_payload_mismatch);
+		pexpect(encrypted_payload_status.bad);
+	}
+
 	/*
 	 * Always log an error.
 	 *
@@ -341,6 +429,28 @@ const struct v2_state_transition *find_v2_state_transition(struct logger *logger
 				   secured_payload_failed);
 }
 
+/*
+ * The (only) transition that initiates EXCHANGE from STATE.
+ */
+
+const struct v2_state_transition *find_v2_initiate_transition(const struct finite_state *state,
+							       enum isakmp_xchg_type exchange)
+{
+	passert(state->kind >= STATE_IKEv2_FLOOR);
+	passert(state->kind < STATE_IKEv2_ROOF);
+	passert(exchange >= V2_EXCHANGE_FLOOR);
+	passert(exchange < V2_EXCHANGE_ROOF);
+	lset_t candidates = v2_transitions_by_exchange[state->kind - STATE_IKEv2_FLOOR]
+		[exchange - V2_EXCHANGE_FLOOR][NO_MESSAGE];
+	/* exactly one */
+	passert(candidates != LEMPTY);
+	passert((candidates & (candidates - 1)) == LEMPTY);
+	const struct v2_state_transition *transition =
+		&state->v2.transitions[__builtin_ctzll(candidates)];
+	passert(transition->send_role == MESSAGE_REQUEST);
+	return transition;
+}
+
 /*
  * report problems - but less so when OE
  */
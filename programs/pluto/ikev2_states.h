@@ -26,6 +26,8 @@ enum smf2_flags {
 	SMF2_RELEASE_WHACK = LELEM(10),
 };
 
+void init_v2_state_transition_index(void);
+
 bool sniff_v2_state_transition(struct logger *logger, const struct finite_state *state, struct msg_digest *md);
 
 const struct v2_state_transition *find_v2_state_transition(struct logger *logger,
@@ -33,4 +35,7 @@ const struct v2_state_transition *find_v2_state_transition(struct logger *logger
 							   struct msg_digest *md,
 							   bool *secured_payload_failed);
 
+const struct v2_state_transition *find_v2_initiate_transition(const struct finite_state *state,
+							       enum isakmp_xchg_type exchange);
+
 #endif
@@ -0,0 +1,749 @@
+/* IKEv2 Session Resumption tickets (RFC 5723), for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>		/* for rename() */
+#include <errno.h>
+#include <limits.h>		/* for PATH_MAX */
+
+#include "lswalloc.h"
+#include "lswlog.h"
+#include "constants.h"		/* for BITS_PER_BYTE, TICKET_KEY_LIFETIME */
+#include "rnd.h"
+#include "crypt_symkey.h"
+#include "ike_alg.h"
+#include "ike_alg_encrypt.h"
+#include "ike_alg_encrypt_ops.h"
+#include "ike_alg_integ.h"
+#include "timer.h"		/* for schedule_oneshot_timer() */
+#include "ikev2_ticket.h"
+
+/*
+ * The responder is stateless: everything needed to resume the IKE
+ * SA is sealed, using a key only it knows, into the ticket handed to
+ * the initiator.
+ *
+ * The key is replaced every TICKET_KEY_LIFETIME; the previous key is
+ * kept for one more TICKET_KEY_LIFETIME so that tickets issued just
+ * before the change (which expire within TICKET_KEY_LIFETIME) can
+ * still be opened.
+ *
+ * So that a restart (or failover to a standby sharing the file)
+ * doesn't invalidate every ticket, the keys are written to the
+ * snapshot, write-to-temp, fsync() then rename(), as soon as they
+ * are created.  The snapshot also holds the initiator's tickets and
+ * each connection's generation.  It is only ever read by a pluto
+ * sharing the ticket key so fields are in host byte order.
+ */
+
+#define TICKET_VERSION 2
+
+/*
+ * Sealed in the ticket; and, with .ticket_len, the initiator's
+ * snapshot record.  Followed by SK_d, peer ID, connection name and
+ * (snapshot only) the ticket.
+ */
+struct resumption_record {
+	int64_t expires;
+	uint8_t version;
+	uint8_t peer_id_type;
+	uint16_t encrypt;
+	uint16_t enckeylen;
+	uint16_t prf;
+	uint16_t integ;
+	uint16_t dh;
+	uint16_t sk_d_len;
+	uint16_t peer_id_len;
+	uint16_t name_len;
+	uint16_t ticket_len;
+	uint32_t generation;
+	uint8_t policy_hash[RESUMPTION_POLICY_HASH_SIZE];
+};
+
+/*
+ * Ticket: KEY_ID | NONCE | ENCRYPTED RECORD | TAG; KEY_ID is also
+ * the AAD.  All 96 bits of the GCM nonce are random.
+ */
+#define TICKET_ENCRYPT (&ike_alg_encrypt_aes_gcm_16)
+#define TICKET_KEY_SIZE (256 / BITS_PER_BYTE)
+#define TICKET_KEY_ID_SIZE sizeof(uint32_t)
+#define TICKET_NONCE_SIZE 12
+#define TICKET_TAG_SIZE 16
+#define TICKET_OVERHEAD (TICKET_KEY_ID_SIZE + TICKET_NONCE_SIZE + TICKET_TAG_SIZE)
+
+struct ticket_key {
+	uint32_t id;		/* 0 when unused */
+	uint8_t pad[4];
+	int64_t created;	/* realtime, seconds */
+	uint8_t key[TICKET_KEY_SIZE];
+};
+
+struct ticket_key_slot {
+	struct ticket_key key;
+	PK11SymKey *symkey;
+};
+
+#define TICKET_SNAPSHOT_MAGIC "LSWTICKT"
+#define TICKET_SNAPSHOT_VERSION 2
+
+/*
+ * Header, then NR_GENERATIONS generation records, then NR_TICKETS
+ * resumption records; each record padded to a multiple of 8 bytes.
+ */
+struct ticket_snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t nr_generations;
+	uint32_t nr_tickets;
+	uint8_t pad[4];
+	struct ticket_key current;
+	struct ticket_key previous;
+};
+
+struct generation_record {
+	uint32_t generation;
+	uint16_t name_len;
+	uint8_t pad[2];
+};
+
+#define SNAPSHOT_PAD(SIZE) (((SIZE) + 7) & ~(size_t)7)
+
+struct ticket_generation {
+	char *name;
+	uint32_t generation;
+	struct ticket_generation *next;
+};
+
+static char *ticket_snapshot_file = NULL;
+static struct ticket_key_slot current_key;
+static struct ticket_key_slot previous_key;
+static struct v2_resumption *stashed_tickets = NULL;
+static struct ticket_generation *generations = NULL;
+
+void free_v2_resumption(struct v2_resumption **resumption)
+{
+	struct v2_resumption *r = *resumption;
+	if (r == NULL) {
+		return;
+	}
+	if (r->sk_d.ptr != NULL) {
+		memset(r->sk_d.ptr, 0, r->sk_d.len);
+	}
+	free_chunk_content(&r->sk_d);
+	free_chunk_content(&r->peer_id);
+	free_chunk_content(&r->ticket);
+	pfreeany(r->connection_name);
+	pfree(r);
+	*resumption = NULL;
+}
+
+/*
+ * Records.
+ */
+
+static size_t resumption_record_size(const struct resumption_record *record)
+{
+	return SNAPSHOT_PAD(sizeof(*record) + record->sk_d_len + record->peer_id_len +
+			    record->name_len + record->ticket_len);
+}
+
+static void fill_record(struct resumption_record *record,
+			const struct v2_resumption *r)
+{
+	zero(record);
+	record->expires = r->expires.rt.tv_sec;
+	record->version = TICKET_VERSION;
+	record->peer_id_type = r->peer_id_type;
+	record->encrypt = r->encrypt->common.id[IKEv2_ALG_ID];
+	record->enckeylen = r->enckeylen;
+	record->prf = r->prf->common.id[IKEv2_ALG_ID];
+	record->integ = (r->integ == NULL || r->integ == &ike_alg_integ_none ? 0 :
+			 r->integ->common.id[IKEv2_ALG_ID]);
+	record->dh = r->dh->common.id[IKEv2_ALG_ID];
+	record->sk_d_len = r->sk_d.len;
+	record->peer_id_len = r->peer_id.len;
+	record->name_len = strlen(r->connection_name);
+	record->ticket_len = r->ticket.len;
+	record->generation = r->generation;
+	memcpy(record->policy_hash, r->policy_hash, sizeof(record->policy_hash));
+}
+
+static uint8_t *append_record(uint8_t *pos, const struct resumption_record *record,
+			      const struct v2_resumption *r)
+{
+	memcpy(pos, record, sizeof(*record));
+	pos += sizeof(*record);
+	memcpy(pos, r->sk_d.ptr, record->sk_d_len);
+	pos += record->sk_d_len;
+	memcpy(pos, r->peer_id.ptr, record->peer_id_len);
+	pos += record->peer_id_len;
+	memcpy(pos, r->connection_name, record->name_len);
+	pos += record->name_len;
+	memcpy(pos, r->ticket.ptr, record->ticket_len);
+	pos += record->ticket_len;
+	return pos;
+}
+
+/*
+ * Unpack RECORD and the SK_d, peer ID, connection name and ticket
+ * that follow it in BYTES (ticket or snapshot); NULL when it is
+ * malformed or uses algorithms this pluto doesn't know.
+ */
+
+static struct v2_resumption *resumption_from_record(const struct resumption_record *record,
+						    const uint8_t *bytes, size_t size)
+{
+	if (record->version != TICKET_VERSION ||
+	    record->sk_d_len == 0 ||
+	    record->name_len == 0 ||
+	    (size_t)record->sk_d_len + record->peer_id_len +
+	    record->name_len + record->ticket_len > size) {
+		return NULL;
+	}
+
+	const struct encrypt_desc *encrypt = ikev2_get_encrypt_desc(record->encrypt);
+	const struct prf_desc *prf = ikev2_get_prf_desc(record->prf);
+	const struct integ_desc *integ = (record->integ == 0 ? &ike_alg_integ_none :
+					  ikev2_get_integ_desc(record->integ));
+	const struct dh_desc *dh = ikev2_get_dh_desc(record->dh);
+	if (encrypt == NULL || prf == NULL || integ == NULL || dh == NULL) {
+		return NULL;
+	}
+
+	struct v2_resumption *r = alloc_thing(struct v2_resumption, "session resumption");
+	r->encrypt = encrypt;
+	r->enckeylen = record->enckeylen;
+	r->prf = prf;
+	r->integ = integ;
+	r->dh = dh;
+	r->expires = realtime(record->expires);
+	r->peer_id_type = record->peer_id_type;
+	r->generation = record->generation;
+	memcpy(r->policy_hash, record->policy_hash, sizeof(r->policy_hash));
+	r->sk_d = clone_bytes_as_chunk(bytes, record->sk_d_len, "resumed SK_d");
+	bytes += record->sk_d_len;
+	r->peer_id = clone_bytes_as_chunk(bytes, record->peer_id_len, "resumed peer ID");
+	bytes += record->peer_id_len;
+	r->connection_name = clone_bytes(bytes, record->name_len + 1, "resumed connection name");
+	r->connection_name[record->name_len] = '\0';
+	bytes += record->name_len;
+	if (record->ticket_len > 0) {
+		r->ticket = clone_bytes_as_chunk(bytes, record->ticket_len, "resumption ticket");
+	}
+	return r;
+}
+
+/*
+ * Keys.
+ */
+
+static void load_ticket_symkey(struct ticket_key_slot *slot, struct logger *logger)
+{
+	release_symkey(__func__, "ticket key", &slot->symkey);
+	if (slot->key.id != 0) {
+		slot->symkey = encrypt_key_from_bytes("ticket key", TICKET_ENCRYPT,
+						      slot->key.key, sizeof(slot->key.key),
+						      HERE, logger);
+	}
+}
+
+static void clear_ticket_key(struct ticket_key_slot *slot)
+{
+	release_symkey(__func__, "ticket key", &slot->symkey);
+	memset(&slot->key, 0, sizeof(slot->key));
+}
+
+/* the current key becomes the previous key */
+static void new_ticket_key(struct logger *logger)
+{
+	clear_ticket_key(&previous_key);
+	previous_key = current_key;
+	zero(&current_key);
+	do {
+		get_rnd_bytes(&current_key.key.id, sizeof(current_key.key.id));
+	} while (current_key.key.id == 0 || current_key.key.id == previous_key.key.id);
+	get_rnd_bytes(current_key.key.key, sizeof(current_key.key.key));
+	current_key.key.created = realnow().rt.tv_sec;
+	load_ticket_symkey(&current_key, logger);
+}
+
+static intmax_t ticket_key_age(void)
+{
+	return realnow().rt.tv_sec - current_key.key.created;
+}
+
+static void schedule_ticket_key_rotation(void)
+{
+	intmax_t left = deltasecs(TICKET_KEY_LIFETIME) - ticket_key_age();
+	schedule_oneshot_timer(EVENT_ROTATE_TICKET_KEY, deltatime(left > 0 ? left : 0));
+}
+
+/*
+ * Snapshot.
+ */
+
+static bool sync_snapshot_directory(const char *file, struct logger *logger)
+{
+	char dir[PATH_MAX];
+	const char *slash = strrchr(file, '/');
+	if (slash == NULL) {
+		jam_str(dir, sizeof(dir), ".");
+	} else if (slash == file) {
+		jam_str(dir, sizeof(dir), "/");
+	} else {
+		snprintf(dir, sizeof(dir), "%.*s", (int)(slash - file), file);
+	}
+	int fd = open(dir, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+	if (fd < 0) {
+		llog_error(logger, errno, "session resumption snapshot directory %s: open() failed", dir);
+		return false;
+	}
+	bool ok = true;
+	if (fsync(fd) < 0) {
+		llog_error(logger, errno, "session resumption snapshot directory %s: fsync() failed", dir);
+		ok = false;
+	}
+	close(fd);
+	return ok;
+}
+
+static bool write_snapshot_file(const char *tmp, size_t size,
+				unsigned nr_generations, unsigned nr_tickets,
+				struct logger *logger)
+{
+	int fd = open(tmp, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+	if (fd < 0) {
+		llog_error(logger, errno, "session resumption snapshot %s: open() failed", tmp);
+		return false;
+	}
+	if (ftruncate(fd, size) < 0) {
+		llog_error(logger, errno, "session resumption snapshot %s: ftruncate() failed", tmp);
+		close(fd);
+		return false;
+	}
+	uint8_t *base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		llog_error(logger, errno, "session resumption snapshot %s: mmap() failed", tmp);
+		close(fd);
+		return false;
+	}
+
+	struct ticket_snapshot_header header = {
+		.version = TICKET_SNAPSHOT_VERSION,
+		.nr_generations = nr_generations,
+		.nr_tickets = nr_tickets,
+		.current = current_key.key,
+		.previous = previous_key.key,
+	};
+	memcpy(header.magic, TICKET_SNAPSHOT_MAGIC, sizeof(header.magic));
+	memcpy(base, &header, sizeof(header));
+
+	/* ftruncate() zero filled the padding */
+	size_t pos = sizeof(header);
+	for (const struct ticket_generation *g = generations; g != NULL; g = g->next) {
+		struct generation_record record = {
+			.generation = g->generation,
+			.name_len = strlen(g->name),
+		};
+		size_t record_size = SNAPSHOT_PAD(sizeof(record) + record.name_len);
+		passert(pos + record_size <= size);
+		memcpy(base + pos, &record, sizeof(record));
+		memcpy(base + pos + sizeof(record), g->name, record.name_len);
+		pos += record_size;
+	}
+	for (const struct v2_resumption *r = stashed_tickets; r != NULL; r = r->next) {
+		struct resumption_record record;
+		fill_record(&record, r);
+		size_t record_size = resumption_record_size(&record);
+		passert(pos + record_size <= size);
+		append_record(base + pos, &record, r);
+		pos += record_size;
+	}
+	passert(pos == size);
+	munmap(base, size);
+
+	bool ok = true;
+	if (fsync(fd) < 0) {
+		llog_error(logger, errno, "session resumption snapshot %s: fsync() failed", tmp);
+		ok = false;
+	}
+	close(fd);
+	return ok;
+}
+
+/*
+ * Write the snapshot, write-to-temp then rename, so that a crash
+ * leaves either the old or the new snapshot.
+ */
+
+static bool write_v2_tickets(struct logger *logger)
+{
+	if (ticket_snapshot_file == NULL) {
+		return true;
+	}
+
+	size_t size = sizeof(struct ticket_snapshot_header);
+	unsigned nr_generations = 0;
+	for (const struct ticket_generation *g = generations; g != NULL; g = g->next) {
+		size += SNAPSHOT_PAD(sizeof(struct generation_record) + strlen(g->name));
+		nr_generations++;
+	}
+	unsigned nr_tickets = 0;
+	for (const struct v2_resumption *r = stashed_tickets; r != NULL; r = r->next) {
+		struct resumption_record record;
+		fill_record(&record, r);
+		size += resumption_record_size(&record);
+		nr_tickets++;
+	}
+
+	char tmp[PATH_MAX];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", ticket_snapshot_file);
+	if (!write_snapshot_file(tmp, size, nr_generations, nr_tickets, logger)) {
+		unlink(tmp);
+		return false;
+	}
+	if (rename(tmp, ticket_snapshot_file) < 0) {
+		llog_error(logger, errno, "session resumption snapshot %s: rename() failed",
+			   ticket_snapshot_file);
+		unlink(tmp);
+		return false;
+	}
+	if (!sync_snapshot_directory(ticket_snapshot_file, logger)) {
+		return false;
+	}
+	dbg("saved session resumption ticket keys, %u generations and %u tickets to %s",
+	    nr_generations, nr_tickets, ticket_snapshot_file);
+	return true;
+}
+
+static void add_generation(const char *name, size_t name_len, uint32_t generation)
+{
+	struct ticket_generation *g = alloc_thing(struct ticket_generation, "ticket generation");
+	g->name = clone_bytes(name, name_len + 1, "ticket generation name");
+	g->name[name_len] = '\0';
+	g->generation = generation;
+	g->next = generations;
+	generations = g;
+}
+
+static void load_v2_tickets(const char *file, struct logger *logger)
+{
+	int fd = open(file, O_RDONLY|O_CLOEXEC);
+	if (fd < 0) {
+		if (errno == ENOENT) {
+			dbg("session resumption snapshot %s does not exist", file);
+		} else {
+			llog_error(logger, errno, "session resumption snapshot %s: open() failed", file);
+		}
+		return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		llog_error(logger, errno, "session resumption snapshot %s: fstat() failed", file);
+		close(fd);
+		return;
+	}
+	size_t size = st.st_size;
+	if (size < sizeof(struct ticket_snapshot_header)) {
+		llog(RC_LOG, logger, "session resumption snapshot %s: truncated; ignored", file);
+		close(fd);
+		return;
+	}
+
+	const uint8_t *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		llog_error(logger, errno, "session resumption snapshot %s: mmap() failed", file);
+		return;
+	}
+
+	struct ticket_snapshot_header header;
+	memcpy(&header, base, sizeof(header));
+	if (!memeq(header.magic, TICKET_SNAPSHOT_MAGIC, sizeof(header.magic)) ||
+	    header.version != TICKET_SNAPSHOT_VERSION ||
+	    header.current.id == 0) {
+		llog(RC_LOG, logger, "session resumption snapshot %s: unrecognized format; ignored", file);
+		munmap((void *)base, size);
+		return;
+	}
+	current_key.key = header.current;
+	load_ticket_symkey(&current_key, logger);
+	previous_key.key = header.previous;
+	load_ticket_symkey(&previous_key, logger);
+
+	size_t pos = sizeof(header);
+	unsigned nr_generations = 0;
+	for (; nr_generations < header.nr_generations; nr_generations++) {
+		struct generation_record record;
+		if (size - pos < sizeof(record)) {
+			break;
+		}
+		memcpy(&record, base + pos, sizeof(record));
+		size_t record_size = SNAPSHOT_PAD(sizeof(record) + record.name_len);
+		if (record.name_len == 0 || record_size > size - pos) {
+			break;
+		}
+		add_generation((const char *)base + pos + sizeof(record),
+			       record.name_len, record.generation);
+		pos += record_size;
+	}
+
+	unsigned nr = 0;
+	unsigned nr_tickets = 0;
+	if (nr_generations == header.nr_generations) {
+		for (; nr < header.nr_tickets; nr++) {
+			struct resumption_record record;
+			if (size - pos < sizeof(record)) {
+				break;
+			}
+			memcpy(&record, base + pos, sizeof(record));
+			size_t record_size = resumption_record_size(&record);
+			if (record.ticket_len == 0 || record_size > size - pos) {
+				break;
+			}
+			struct v2_resumption *r = resumption_from_record(&record, base + pos + sizeof(record),
+									 record_size - sizeof(record));
+			pos += record_size;
+			if (r == NULL) {
+				/* algorithm no longer supported? */
+				continue;
+			}
+			if (realtime_sub_sign(r->expires, realnow()) <= 0) {
+				free_v2_resumption(&r);
+				continue;
+			}
+			r->next = stashed_tickets;
+			stashed_tickets = r;
+			nr_tickets++;
+		}
+	}
+	if (nr_generations < header.nr_generations || nr < header.nr_tickets) {
+		llog(RC_LOG, logger, "session resumption snapshot %s: corrupt; ignoring the rest",
+		     file);
+	}
+	llog(RC_LOG, logger, "restored session resumption ticket keys and %u tickets from %s",
+	     nr_tickets, file);
+	munmap((void *)base, size);
+}
+
+void init_v2_tickets(const char *snapshot_file, struct logger *logger)
+{
+	init_oneshot_timer(EVENT_ROTATE_TICKET_KEY, rotate_v2_ticket_key);
+	if (snapshot_file != NULL) {
+		ticket_snapshot_file = clone_str(snapshot_file, "session resumption snapshot file");
+		load_v2_tickets(snapshot_file, logger);
+	}
+	if (current_key.key.id == 0) {
+		new_ticket_key(logger);
+		write_v2_tickets(logger);
+		schedule_ticket_key_rotation();
+	} else if (ticket_key_age() >= deltasecs(TICKET_KEY_LIFETIME)) {
+		rotate_v2_ticket_key(logger);
+	} else {
+		schedule_ticket_key_rotation();
+	}
+}
+
+void rotate_v2_ticket_key(struct logger *logger)
+{
+	new_ticket_key(logger);
+	llog(RC_LOG, logger, "rotated session resumption ticket key");
+	write_v2_tickets(logger);
+	schedule_ticket_key_rotation();
+}
+
+void save_v2_tickets(struct logger *logger)
+{
+	if (ticket_snapshot_file == NULL) {
+		return;
+	}
+	unsigned nr_tickets = 0;
+	for (const struct v2_resumption *r = stashed_tickets; r != NULL; r = r->next) {
+		nr_tickets++;
+	}
+	if (write_v2_tickets(logger)) {
+		llog(RC_LOG, logger, "saved session resumption ticket keys and %u tickets to %s",
+		     nr_tickets, ticket_snapshot_file);
+	}
+}
+
+void free_v2_tickets(void)
+{
+	while (stashed_tickets != NULL) {
+		struct v2_resumption *r = stashed_tickets;
+		stashed_tickets = r->next;
+		free_v2_resumption(&r);
+	}
+	while (generations != NULL) {
+		struct ticket_generation *g = generations;
+		generations = g->next;
+		pfree(g->name);
+		pfree(g);
+	}
+	clear_ticket_key(&current_key);
+	clear_ticket_key(&previous_key);
+	pfreeany(ticket_snapshot_file);
+}
+
+/*
+ * Seal and unseal.
+ */
+
+static bool crypt_ticket(PK11SymKey *symkey, uint8_t *ticket, size_t text_size,
+			 bool enc, struct logger *logger)
+{
+	uint8_t *key_id = ticket;
+	uint8_t *nonce = key_id + TICKET_KEY_ID_SIZE;
+	uint8_t *text_and_tag = nonce + TICKET_NONCE_SIZE;
+	/* NSS wants the nonce as SALT|IV; split it as RFC 4106 does */
+	return TICKET_ENCRYPT->encrypt_ops->do_aead(TICKET_ENCRYPT,
+						    nonce, TICKET_ENCRYPT->salt_size,
+						    nonce + TICKET_ENCRYPT->salt_size,
+						    TICKET_NONCE_SIZE - TICKET_ENCRYPT->salt_size,
+						    key_id, TICKET_KEY_ID_SIZE,
+						    text_and_tag, text_size, TICKET_TAG_SIZE,
+						    symkey, enc, logger);
+}
+
+chunk_t seal_v2_ticket(const struct v2_resumption *r, struct logger *logger)
+{
+	passert(current_key.symkey != NULL);
+	struct resumption_record record;
+	fill_record(&record, r);
+	record.ticket_len = 0;
+	size_t text_size = (sizeof(record) + record.sk_d_len +
+			    record.peer_id_len + record.name_len);
+
+	chunk_t ticket = alloc_chunk(TICKET_OVERHEAD + text_size, "resumption ticket");
+	memcpy(ticket.ptr, &current_key.key.id, TICKET_KEY_ID_SIZE);
+	get_rnd_bytes(ticket.ptr + TICKET_KEY_ID_SIZE, TICKET_NONCE_SIZE);
+	struct v2_resumption text = *r;
+	text.ticket = empty_chunk;
+	append_record(ticket.ptr + TICKET_KEY_ID_SIZE + TICKET_NONCE_SIZE, &record, &text);
+	if (!crypt_ticket(current_key.symkey, ticket.ptr, text_size, true, logger)) {
+		free_chunk_content(&ticket);
+	}
+	return ticket;
+}
+
+const char *unseal_v2_ticket(shunk_t sealed, struct v2_resumption **resumption,
+			     struct logger *logger)
+{
+	*resumption = NULL;
+	if (sealed.len < TICKET_OVERHEAD + sizeof(struct resumption_record)) {
+		return "truncated";
+	}
+
+	uint32_t key_id;
+	memcpy(&key_id, sealed.ptr, sizeof(key_id));
+	PK11SymKey *symkey = (key_id == 0 ? NULL :
+			      key_id == current_key.key.id ? current_key.symkey :
+			      key_id == previous_key.key.id ? previous_key.symkey :
+			      NULL);
+	if (symkey == NULL) {
+		return "issued using an unknown key";
+	}
+
+	chunk_t ticket = clone_hunk(sealed, "resumption ticket");
+	size_t text_size = ticket.len - TICKET_OVERHEAD;
+	const char *why = NULL;
+	if (!crypt_ticket(symkey, ticket.ptr, text_size, false, logger)) {
+		why = "integrity check failed";
+	} else {
+		const uint8_t *text = ticket.ptr + TICKET_KEY_ID_SIZE + TICKET_NONCE_SIZE;
+		struct resumption_record record;
+		memcpy(&record, text, sizeof(record));
+		if (record.ticket_len != 0 ||
+		    sizeof(record) + record.sk_d_len + record.peer_id_len +
+		    record.name_len != text_size) {
+			why = "corrupt";
+		} else if (record.expires <= realnow().rt.tv_sec) {
+			why = "expired";
+		} else {
+			*resumption = resumption_from_record(&record, text + sizeof(record),
+							     text_size - sizeof(record));
+			if (*resumption == NULL) {
+				why = "using unsupported algorithms";
+			}
+		}
+	}
+	memset(ticket.ptr, 0, ticket.len);
+	free_chunk_content(&ticket);
+	return why;
+}
+
+/*
+ * Initiator.
+ */
+
+struct v2_resumption *unstash_v2_ticket(const char *connection_name)
+{
+	for (struct v2_resumption **rp = &stashed_tickets; *rp != NULL; rp = &(*rp)->next) {
+		struct v2_resumption *r = *rp;
+		if (streq(r->connection_name, connection_name)) {
+			*rp = r->next;
+			r->next = NULL;
+			return r;
+		}
+	}
+	return NULL;
+}
+
+void stash_v2_ticket(struct v2_resumption *r)
+{
+	/* replace any older ticket for this connection */
+	struct v2_resumption *old = unstash_v2_ticket(r->connection_name);
+	free_v2_resumption(&old);
+	r->next = stashed_tickets;
+	stashed_tickets = r;
+}
+
+/*
+ * Generations.
+ */
+
+uint32_t v2_ticket_generation(const char *connection_name)
+{
+	for (const struct ticket_generation *g = generations; g != NULL; g = g->next) {
+		if (streq(g->name, connection_name)) {
+			return g->generation;
+		}
+	}
+	return 0;
+}
+
+void bump_v2_ticket_generation(const char *connection_name, struct logger *logger)
+{
+	if (current_key.symkey == NULL) {
+		/* session resumption isn't enabled */
+		return;
+	}
+	struct ticket_generation *g = generations;
+	while (g != NULL && !streq(g->name, connection_name)) {
+		g = g->next;
+	}
+	if (g == NULL) {
+		add_generation(connection_name, strlen(connection_name), 0);
+		g = generations;
+	}
+	g->generation++;
+	dbg("session resumption generation of \"%s\" is now %u",
+	    connection_name, g->generation);
+	write_v2_tickets(logger);
+}
@@ -0,0 +1,95 @@
+/* IKEv2 Session Resumption tickets (RFC 5723), for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef IKEV2_TICKET_H
+#define IKEV2_TICKET_H
+
+#include <stdint.h>
+
+#include "chunk.h"
+#include "shunk.h"
+#include "realtime.h"
+#include "ietf_constants.h"	/* for enum ike_id_type */
+
+struct logger;
+struct encrypt_desc;
+struct prf_desc;
+struct integ_desc;
+struct dh_desc;
+
+#define RESUMPTION_POLICY_HASH_SIZE 32	/* SHA2_256 */
+
+/*
+ * What a resumed IKE SA inherits from the IKE SA that the ticket was
+ * issued for, and what the ticket is bound to; hangs off
+ * .st_v2_resumption.
+ */
+
+struct v2_resumption {
+	const struct encrypt_desc *encrypt;
+	unsigned enckeylen;
+	const struct prf_desc *prf;
+	const struct integ_desc *integ;
+	const struct dh_desc *dh;
+	chunk_t sk_d;			/* of the old IKE SA */
+	enum ike_id_type peer_id_type;	/* as authenticated */
+	chunk_t peer_id;		/* ID payload body */
+	char *connection_name;
+	/* see bind_v2_resumption() */
+	uint8_t policy_hash[RESUMPTION_POLICY_HASH_SIZE];
+	uint32_t generation;
+	realtime_t expires;
+	chunk_t ticket;			/* initiator */
+	struct v2_resumption *next;	/* initiator's ticket list */
+};
+
+void free_v2_resumption(struct v2_resumption **resumption);
+
+/*
+ * The ticket keys, the tickets the initiator is holding, and each
+ * connection's generation.  With a SNAPSHOT_FILE they are read back
+ * at startup, and written whenever the keys or a generation change
+ * and at shutdown.
+ */
+void init_v2_tickets(const char *snapshot_file, struct logger *logger);
+void save_v2_tickets(struct logger *logger);
+void free_v2_tickets(void);
+
+/*
+ * Responder: seal R into a ticket using the current key; and unseal
+ * a ticket using the current or, during its grace period, previous
+ * key (returning why not).
+ */
+chunk_t seal_v2_ticket(const struct v2_resumption *r, struct logger *logger);
+const char *unseal_v2_ticket(shunk_t sealed, struct v2_resumption **r,
+			     struct logger *logger);
+void rotate_v2_ticket_key(struct logger *logger);
+
+/*
+ * Initiator: hold on to a ticket until the connection is next
+ * started; and take it back (it is single use).
+ */
+void stash_v2_ticket(struct v2_resumption *r);
+struct v2_resumption *unstash_v2_ticket(const char *connection_name);
+
+/*
+ * A connection's generation changes each time it is deleted (for
+ * instance by a reload) so tickets issued for an earlier incarnation
+ * are not accepted.
+ */
+uint32_t v2_ticket_generation(const char *connection_name);
+void bump_v2_ticket_generation(const char *connection_name, struct logger *logger);
+
+#endif
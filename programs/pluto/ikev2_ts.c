@@ -1136,6 +1136,7 @@ static void scribble_request_ts_on_connection(struct child_sa *child,
 	dbg_ts("XXX: updating best connection's ports/protocols");
 	c->spd.this.client = selector_from_range_protocol_port(n.r.range, n.r.protocol, ip_hport(n.r.port));
 	c->spd.that.client = selector_from_range_protocol_port(n.i.range, n.i.protocol, ip_hport(n.i.port));
+	rehash_db_spd_route_remote_client(&c->spd);
 }
 
 /*
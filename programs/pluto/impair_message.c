@@ -14,9 +14,12 @@
  *
  */
 
+#include <sys/uio.h>		/* for struct iovec */
+
 #include "impair.h"
 #include "lswalloc.h"
 #include "passert.h"
+
 #include "lswlog.h"
 
 #include "chunk.h"
@@ -169,10 +172,27 @@ bool impair_incoming_message(struct msg_digest *md)
 	return true;
 }
 
-bool impair_outgoing_message(shunk_t message, struct logger *logger)
+bool impair_outgoing_message(const struct iovec *iov, unsigned nr_iov,
+			     struct logger *logger)
 {
+	if (outgoing_impairments.impairments == NULL) {
+		return false;
+	}
+	size_t len = 0;
+	for (unsigned i = 0; i < nr_iov; i++) {
+		len += iov[i].iov_len;
+	}
+	chunk_t message = alloc_chunk(len, "outgoing message");
+	uint8_t *cursor = message.ptr;
+	for (unsigned i = 0; i < nr_iov; i++) {
+		memcpy(cursor, iov[i].iov_base, iov[i].iov_len);
+		cursor += iov[i].iov_len;
+	}
 	struct message_impairment impairment; /*ignored*/
-	return impair_message(message, &outgoing_impairments, &impairment, logger);
+	bool impaired = impair_message(HUNK_AS_SHUNK(message), &outgoing_impairments,
+				       &impairment, logger);
+	free_chunk_content(&message);
+	return impaired;
 }
 
 static void free_direction(struct direction_impairment *direction, struct logger *logger)
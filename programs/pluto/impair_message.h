@@ -50,6 +50,8 @@
 
 #include "shunk.h"
 
+struct iovec;
+
 struct logger;
 struct msg_digest;
 enum impair_action;
@@ -57,7 +59,9 @@ enum impair_action;
 void add_message_impairment(unsigned nr, enum impair_action action, struct logger *logger);
 
 bool impair_incoming_message(struct msg_digest *md);
-bool impair_outgoing_message(shunk_t message, struct logger *logger);
+/* MESSAGE is gathered from IOV; only flattened when impaired */
+bool impair_outgoing_message(const struct iovec *iov, unsigned nr_iov,
+			     struct logger *logger);
 
 void free_impair_message(struct logger *logger);
 
@@ -1152,6 +1152,7 @@ static void connection_check_ddns1(struct connection *c, struct logger *logger)
 	    str_address_sensitive(&new_addr, &new));
 	c->remote->host.addr = new_addr;
 	update_ends_from_this_host_addr(&c->spd.that, &c->spd.this);
+	rehash_db_spd_route_remote_client(&c->spd);	/* .that.client may have changed */
 
 	/*
 	 * reduce the work we do by updating all connections waiting for this
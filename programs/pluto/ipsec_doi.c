@@ -212,9 +212,7 @@ void initialize_new_state(struct state *st,
 	     sr != NULL; sr = sr->spd_next) {
 		if (sr->this.config->host.xauth.client) {
 			if (sr->this.config->host.xauth.username != NULL) {
-				jam_str(st->st_xauth_username,
-					sizeof(st->st_xauth_username),
-					sr->this.config->host.xauth.username);
+				update_xauth_username(st, sr->this.config->host.xauth.username);
 				break;
 			}
 		}
@@ -308,7 +306,7 @@ void jam_child_sa_details(struct jambuf *buf, struct state *st)
 		jam_string(buf, "passive");
 	}
 
-	if (st->st_xauth_username[0] != '\0') {
+	if (st->st_xauth_username != NULL) {
 		jam_string(buf, ini);
 		ini = " ";
 		jam_string(buf, "username=");
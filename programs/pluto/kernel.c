@@ -589,12 +589,14 @@ bool fmt_common_shell_out(char *buf,
 	JDuint("PLUTO_PEER_PROTOCOL", sr->that.client.ipproto);
 
 	jam_string(&jb, "PLUTO_PEER_CA='");
-	for (struct pubkey_list *p = pluto_pubkeys; p != NULL; p = p->next) {
-		struct pubkey *key = p->key;
+	struct preloaded_pubkey_filter pkf = {
+		.id = &c->remote->host.id,
+		.type = &pubkey_type_rsa,
+	};
+	while (next_preloaded_pubkey(&pkf)) {
+		struct pubkey *key = pkf.key;
 		int pathlen;	/* value ignored */
-		if (key->content.type == &pubkey_type_rsa &&
-		    same_id(&c->remote->host.id, &key->id) &&
-		    trusted_ca(key->issuer, ASN1(sr->that.config->host.ca), &pathlen)) {
+		if (trusted_ca(key->issuer, ASN1(sr->that.config->host.ca), &pathlen)) {
 			jam_dn_or_null(&jb, key->issuer, "", jam_shell_quoted_bytes);
 			break;
 		}
@@ -617,7 +619,7 @@ bool fmt_common_shell_out(char *buf,
 	jam(&jb, "PLUTO_CONN_ADDRFAMILY='ipv%d' ", address_type(&sr->this.host->addr)->ip_version);
 	JDuint("XAUTH_FAILED", (st != NULL && st->st_xauth_soft) ? 1 : 0);
 
-	if (st != NULL && st->st_xauth_username[0] != '\0') {
+	if (st != NULL && st->st_xauth_username != NULL) {
 		JDemitter("PLUTO_USERNAME", jam_clean_xauth_username(&jb, st->st_xauth_username, st->st_logger));
 	}
 
@@ -625,7 +627,8 @@ bool fmt_common_shell_out(char *buf,
 		JDipaddr("PLUTO_MY_SOURCEIP", sr->this.host_srcip);
 		if (st != NULL)
 			JDstr("PLUTO_MOBIKE_EVENT",
-			    st->st_mobike_del_src_ip ? "yes" : "");
+			    (st->st_v2_mobike != NULL &&
+			     st->st_v2_mobike->del_src_ip) ? "yes" : "");
 	}
 
 	JDuint("PLUTO_IS_PEER_CISCO", c->remotepeertype /* ??? kind of odd printing an enum with %u */);
@@ -1334,9 +1337,9 @@ void migration_down(struct child_sa *child)
 		/* only unroute if no other connection shares it */
 		if (routed(cr) && route_owner(c, sr, NULL, NULL, NULL) == NULL) {
 			do_command(c, sr, "down", &child->sa, child->sa.st_logger);
-			child->sa.st_mobike_del_src_ip = true;
+			v2_mobike(&child->sa)->del_src_ip = true;
 			do_command(c, sr, "unroute", &child->sa, child->sa.st_logger);
-			child->sa.st_mobike_del_src_ip = false;
+			child->sa.st_v2_mobike->del_src_ip = false;
 		}
 	}
 }
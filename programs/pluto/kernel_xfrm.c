@@ -988,20 +988,22 @@ static bool create_xfrm_migrate_sa(struct state *st,
 		/* WWW what about sec_label? */
 	};
 
-	passert(endpoint_is_specified(st->st_mobike_local_endpoint) != endpoint_is_specified(st->st_mobike_remote_endpoint));
+	const struct v2_mobike *mobike = st->st_v2_mobike;
+	passert(mobike != NULL);
+	passert(endpoint_is_specified(mobike->local_endpoint) != endpoint_is_specified(mobike->remote_endpoint));
 
 	struct jambuf story_jb = ARRAY_AS_JAMBUF(story->buf);
 	const struct end_info *old_ei;
 	ip_endpoint new_ep;
 
-	if (endpoint_is_specified(st->st_mobike_local_endpoint)) {
+	if (endpoint_is_specified(mobike->local_endpoint)) {
 		jam_string(&story_jb, "initiator migrate kernel SA ");
 		old_ei = &local;
-		new_ep = st->st_mobike_local_endpoint;
+		new_ep = mobike->local_endpoint;
 	} else {
 		jam_string(&story_jb, "responder migrate kernel SA ");
 		old_ei = &remote;
-		new_ep = st->st_mobike_remote_endpoint;
+		new_ep = mobike->remote_endpoint;
 	}
 
 	struct kernel_state_end *changing_ke = (old_ei == src) ? &sa.src : &sa.dst;
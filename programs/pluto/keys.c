@@ -26,6 +26,7 @@
  */
 
 #include <unistd.h>
+#include <ctype.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -67,6 +68,7 @@
 #include "ike_alg_hash.h"
 #include "pluto_timing.h"
 #include "show.h"
+#include "hash_table.h"
 
 static struct secret *pluto_secrets = NULL;
 
@@ -148,107 +150,184 @@ void list_psks(struct show *s)
 }
 
 /*
- * Check signature against all RSA public keys we can find.  If we
- * need keys from DNS KEY records, and they haven't been fetched,
- * return STF_SUSPEND to ask for asynch DNS lookup.
+ * Check signature against all public keys we can find.
  *
- * Note: parameter keys_from_dns contains results of DNS lookup for
- * key or is NULL indicating lookup not yet tried.
+ * This is done in three steps so that the expensive part, trying the
+ * signature against each candidate key, can be run on a helper
+ * thread:
  *
- * take_a_crack is a helper function.  Mostly forensic.  If only we
- * had coroutines. (XXX: generators).
+ * start_authsig() (main thread) collects the keys that could have
+ * made the signature, the peer's certificate first and then the
+ * preloaded keys, filtering out those with the wrong type, ID, CA
+ * or lifetime.
+ *
+ * try_authsig() (any thread) tries each candidate in turn until one
+ * works or one fails fatally.
+ *
+ * finish_authsig() (main thread) logs the outcome and saves the key
+ * that worked.
  */
 
-struct tac_state {
-	const struct pubkey_signer *signer;
-	const struct crypt_mac *hash;
-	shunk_t signature;
-	const struct hash_desc *hash_algo;
-	realtime_t now;
-	struct logger *logger;
-	const struct end *remote;
+struct authsig_candidate {
+	struct pubkey *key;
 	const char *cert_origin;
+};
 
-	/*
-	 * Both accumulated across calls and used to return the final
-	 * result.
-	 *
-	 * See below.
-	 */
+struct authsig {
+	/* in */
+	const struct pubkey_signer *signer;
+	struct crypt_mac hash;
+	chunk_t signature;
+	const struct hash_desc *hash_algo;
+	struct authsig_candidate *candidates;
+	unsigned nr_candidates;
 
+	/* out */
 	int tried_cnt;			/* number of keys tried */
 	char tried[50];			/* keyids of tried public keys */
-	struct jambuf tried_jambuf;	/* jambuf for same */
 	struct pubkey *key;		/* last key tried, if any */
 	diag_t fatal_diag;		/* fatal error from KEY, if any */
 };
 
 /*
- * Try all keys from PUBKEY_DB.
- *
- * Return true when searching should stop (not when it succeeded);
- * return false when searching can continue.
- *
- *   Returns  FATAL_DIAG  KEY     tried_cnt
- *    false     NULL     NULL        0      no key, try again
- *    false     NULL     NULL       >0      no key worked, try again
- *    true    <valid>   <valid>     N/A     fatal error caused by KEY
- *    true      NULL    <valid>     N/A     KEY worked
+ * Should KEY be tried?
  */
 
-static bool try_all_keys(const char *cert_origin,
-			 struct pubkey_list *pubkey_db,
-			 struct tac_state *s)
+static bool authsig_candidate(const struct pubkey *key,
+			      const struct pubkey_signer *signer,
+			      const struct end *remote,
+			      realtime_t now)
+{
+	if (key->content.type != signer->type) {
+		id_buf printkid;
+		dbg("  skipping '%s' with type %s",
+		    str_id(&key->id, &printkid), key->content.type->name);
+		return false;
+	}
+
+	int wildcards; /* value ignored */
+	if (!match_id("  ", &key->id, &remote->host->id, &wildcards)) {
+		id_buf printkid;
+		dbg("  skipping '%s' with wrong ID",
+		    str_id(&key->id, &printkid));
+		return false;
+	}
+
+	int pl;	/* value ignored */
+	if (!trusted_ca(key->issuer, ASN1(remote->config->host.ca), &pl)) {
+		id_buf printkid;
+		dn_buf buf;
+		dbg("  skipping '%s' with untrusted CA '%s'",
+		    str_id(&key->id, &printkid),
+		    str_dn_or_null(key->issuer, "%any", &buf));
+		return false;
+	}
+
+	/*
+	 * XXX: even though loop above filtered out these
+	 * certs, keep this check, at some point the above
+	 * loop will be deleted.
+	 */
+	if (!is_realtime_epoch(key->until_time) &&
+	    realtime_cmp(key->until_time, <, now)) {
+		id_buf printkid;
+		realtime_buf buf;
+		dbg("  skipping '%s' which expired on %s",
+		    str_id(&key->id, &printkid),
+		    str_realtime(key->until_time, /*utc?*/false, &buf));
+		return false;
+	}
+
+	return true;
+}
+
+static void add_authsig_candidate(struct authsig *as, struct pubkey *key,
+				  const char *cert_origin)
 {
+	realloc_things(as->candidates, as->nr_candidates, as->nr_candidates + 1,
+		       "authsig candidates");
+	as->candidates[as->nr_candidates++] = (struct authsig_candidate) {
+		.key = pubkey_addref(key),
+		.cert_origin = cert_origin,
+	};
+}
+
+struct authsig *start_authsig(struct ike_sa *ike,
+			      const struct crypt_mac *hash,
+			      shunk_t signature,
+			      const struct hash_desc *hash_algo,
+			      const struct pubkey_signer *signer)
+{
+	const struct connection *c = ike->sa.st_connection;
+	const struct end *remote = &c->spd.that;
+	realtime_t now = realnow();
+
+	struct authsig *as = alloc_thing(struct authsig, "authsig");
+	as->signer = signer;
+	as->hash = *hash;
+	as->signature = clone_hunk(signature, "authsig signature");
+	as->hash_algo = hash_algo;
+
+	dn_buf buf;
+	dbg("CA is '%s' for %s key using %s signature",
+	    str_dn_or_null(ASN1(c->remote->config->host.ca), "%any", &buf),
+	    signer->type->name, signer->name);
+
+	passert(ike->sa.st_remote_certs.processed);
+
+	/*
+	 * Prune the expired public keys from the pre-loaded public
+	 * key list.  But why here, and why not as a separate job?
+	 * And why blame the IKE SA as it isn't really its fault?
+	 */
+	expire_preloaded_pubkeys(now, ike->sa.st_logger);
+
+	/* try all appropriate Public keys */
+
 	id_buf thatid;
-	dbg("trying all '%s's for %s key using %s signature that matches ID: %s",
-	    cert_origin, s->signer->type->name, s->signer->name,
-	    str_id(&s->remote->host->id, &thatid));
-	s->cert_origin = cert_origin;
-
-	bool described = false;
-	for (struct pubkey_list *p = pubkey_db; p != NULL; p = p->next) {
-		struct pubkey *key = p->key;
-
-		if (key->content.type != s->signer->type) {
-			id_buf printkid;
-			dbg("  skipping '%s' with type %s",
-			    str_id(&key->id, &printkid), key->content.type->name);
-			continue;
+	dbg("trying all 'peer's for %s key using %s signature that matches ID: %s",
+	    signer->type->name, signer->name,
+	    str_id(&remote->host->id, &thatid));
+	for (struct pubkey_list *p = ike->sa.st_remote_certs.pubkey_db;
+	     p != NULL; p = p->next) {
+		if (authsig_candidate(p->key, signer, remote, now)) {
+			add_authsig_candidate(as, p->key, "peer");
 		}
+	}
 
-		int wildcards; /* value ignored */
-		if (!match_id("  ", &key->id, &s->remote->host->id, &wildcards)) {
-			id_buf printkid;
-			dbg("  skipping '%s' with wrong ID",
-			    str_id(&key->id, &printkid));
-			continue;
+	/*
+	 * Try the preloaded keys; only those with a matching ID
+	 * (which can contain wildcards) are considered.
+	 */
+	dbg("trying 'preloaded's for %s key using %s signature that matches ID: %s",
+	    signer->type->name, signer->name,
+	    str_id(&remote->host->id, &thatid));
+	struct preloaded_pubkey_filter pkf = {
+		.remote_id = &remote->host->id,
+		.type = signer->type,
+	};
+	while (next_preloaded_pubkey(&pkf)) {
+		if (authsig_candidate(pkf.key, signer, remote, now)) {
+			add_authsig_candidate(as, pkf.key, "preloaded");
 		}
+	}
 
-		int pl;	/* value ignored */
-		if (!trusted_ca(key->issuer, ASN1(s->remote->config->host.ca), &pl)) {
-			id_buf printkid;
-			dn_buf buf;
-			dbg("  skipping '%s' with untrusted CA '%s'",
-			    str_id(&key->id, &printkid),
-			    str_dn_or_null(key->issuer, "%any", &buf));
-			continue;
-		}
+	return as;
+}
 
-		/*
-		 * XXX: even though loop above filtered out these
-		 * certs, keep this check, at some point the above
-		 * loop will be deleted.
-		 */
-		if (!is_realtime_epoch(key->until_time) &&
-		    realtime_cmp(key->until_time, <, s->now)) {
-			id_buf printkid;
-			realtime_buf buf;
-			dbg("  skipping '%s' which expired on %s",
-			    str_id(&key->id, &printkid),
-			    str_realtime(key->until_time, /*utc?*/false, &buf));
-			continue;
-		}
+/*
+ * Try each candidate in turn.  Stop when one works (AS->KEY is set)
+ * or one fails fatally (AS->KEY and AS->FATAL_DIAG are set).
+ */
+
+void try_authsig(struct authsig *as, struct logger *logger)
+{
+	struct jambuf tried_jambuf = ARRAY_AS_JAMBUF(as->tried);
+	const char *described = NULL;
+
+	for (unsigned i = 0; i < as->nr_candidates; i++) {
+		struct pubkey *key = as->candidates[i].key;
+		const char *cert_origin = as->candidates[i].cert_origin;
 
 		id_buf printkid;
 		dn_buf buf;
@@ -256,161 +335,146 @@ static bool try_all_keys(const char *cert_origin,
 		dbg("  trying '%s' aka *%s issued by CA '%s'",
 		    str_id(&key->id, &printkid), keyid_str,
 		    str_dn_or_null(key->issuer, "%any", &buf));
-		s->tried_cnt++;
+		as->tried_cnt++;
 
-		if (!described) {
-			jam(&s->tried_jambuf, " %s:", cert_origin);
-			described = true;
+		if (described != cert_origin) {
+			jam(&tried_jambuf, " %s:", cert_origin);
+			described = cert_origin;
 		}
-		jam(&s->tried_jambuf, " *%s", keyid_str);
+		jam(&tried_jambuf, " *%s", keyid_str);
 
-		logtime_t try_time = logtime_start(s->logger);
-		bool passed = (s->signer->authenticate_signature)(s->hash, s->signature,
-								  key, s->hash_algo,
-								  &s->fatal_diag, s->logger);
+		logtime_t try_time = logtime_start(logger);
+		bool passed = (as->signer->authenticate_signature)(&as->hash,
+								   HUNK_AS_SHUNK(as->signature),
+								   key, as->hash_algo,
+								   &as->fatal_diag, logger);
 		logtime_stop(&try_time, "%s() trying a pubkey", __func__);
 
-		if (s->fatal_diag != NULL) {
+		if (as->fatal_diag != NULL) {
 			/* already logged */
 			dbg("  '%s' fatal", keyid_str);
-			jam(&s->tried_jambuf, "(fatal)");
-			s->key = key; /* also return failing key */
-			return true; /* stop searching; enough is enough */
+			jam(&tried_jambuf, "(fatal)");
+			as->key = key; /* also return failing key */
+			return; /* stop searching; enough is enough */
 		}
 
 		if (passed) {
 			dbg("  '%s' passed", keyid_str);
-			s->key = key;
-			return true; /* stop searching */
+			as->key = key;
+			return; /* stop searching */
 		}
 
 		/* should have been logged */
 		dbg("  '%s' failed", keyid_str);
-		pexpect(s->key == NULL);
+		pexpect(as->key == NULL);
 	}
-
-	return false; /* keep searching */
 }
 
-diag_t authsig_and_log_using_pubkey(struct ike_sa *ike,
-				    const struct crypt_mac *hash,
-				    shunk_t signature,
-				    const struct hash_desc *hash_algo,
-				    const struct pubkey_signer *signer,
-				    const char *signature_payload_name)
+diag_t finish_authsig(struct ike_sa *ike, struct authsig **asp,
+		      const char *signature_payload_name)
 {
+	struct authsig *as = *asp;
 	const struct connection *c = ike->sa.st_connection;
-	struct tac_state s = {
-		/* in */
-		.signer = signer,
-		.logger = ike->sa.st_logger,
-		.hash = hash,
-		.now = realnow(),
-		.signature = signature,
-		.hash_algo = hash_algo,
-		.remote = &c->spd.that,
-		/* out */
-		.tried_cnt = 0,
-		.key = NULL,
-		.fatal_diag = NULL,
-	};
-	s.tried_jambuf = ARRAY_AS_JAMBUF(s.tried);
-
-	/* try all appropriate Public keys */
-
-	dn_buf buf;
-	dbg("CA is '%s' for %s key using %s signature",
-	    str_dn_or_null(ASN1(c->remote->config->host.ca), "%any", &buf),
-	    signer->type->name, signer->name);
-
-	passert(ike->sa.st_remote_certs.processed);
-
-	/*
-	 * Prune the expired public keys from the pre-loaded public
-	 * key list.  But why here, and why not as a separate job?
-	 * And why blame the IKE SA as it isn't really its fault?
-	 */
-	for (struct pubkey_list **pp = &pluto_pubkeys; *pp != NULL; ) {
-		struct pubkey *key = (*pp)->key;
-		if (!is_realtime_epoch(key->until_time) &&
-		    realtime_cmp(key->until_time, <, s.now)) {
-			id_buf printkid;
-			log_state(RC_LOG_SERIOUS, &ike->sa,
-				  "cached %s public key '%s' has expired and has been deleted",
-				  key->content.type->name, str_id(&key->id, &printkid));
-			*pp = free_public_keyentry(*(pp));
-			continue; /* continue with next public key */
-		}
-		pp = &(*pp)->next;
-	}
-
-	bool stop = try_all_keys("peer", ike->sa.st_remote_certs.pubkey_db, &s);
-	if (!stop) {
-		stop = try_all_keys("preloaded", pluto_pubkeys, &s);
-	}
+	const struct pubkey_signer *signer = as->signer;
+	const struct hash_desc *hash_algo = as->hash_algo;
+	diag_t d = NULL;
 
-	if (s.fatal_diag != NULL) {
-		passert(s.key != NULL);
+	if (as->fatal_diag != NULL) {
+		passert(as->key != NULL);
 		id_buf idb;
-		return diag_diag(&s.fatal_diag, "authentication aborted: problem with '%s': ",
-				 str_id(&s.key->id, &idb));
-	}
-
-	if (s.key == NULL) {
-		if (s.tried_cnt == 0) {
+		d = diag_diag(&as->fatal_diag, "authentication aborted: problem with '%s': ",
+			      str_id(&as->key->id, &idb));
+	} else if (as->key == NULL) {
+		if (as->tried_cnt == 0) {
 			id_buf idb;
-			return diag("authentication failed: no certificate matched %s with %s and '%s'",
-				    signer->name, hash_algo->common.fqn,
-				    str_id(&c->remote->host.id, &idb));
+			d = diag("authentication failed: no certificate matched %s with %s and '%s'",
+				 signer->name, hash_algo->common.fqn,
+				 str_id(&c->remote->host.id, &idb));
 		} else {
 			id_buf idb;
-			return diag("authentication failed: using %s with %s for '%s' tried%s",
-				    signer->name, hash_algo->common.fqn,
-				    str_id(&c->remote->host.id, &idb),
-				    s.tried);
-		}
-	}
-
-	pexpect(s.key != NULL);
-	pexpect(s.tried_cnt > 0);
-	LLOG_JAMBUF(RC_LOG_SERIOUS, ike->sa.st_logger, buf) {
-		if (ike->sa.st_ike_version == IKEv2) {
-			/*
-			 * IKEv2 only; IKEv1 logs established as a
-			 * separate line.
-			 */
-			jam(buf, "%s established IKE SA; ",
-			    (ike->sa.st_sa_role == SA_INITIATOR ? "initiator" :
-			     ike->sa.st_sa_role == SA_RESPONDER ? "responder" :
-			     "?"));
+			d = diag("authentication failed: using %s with %s for '%s' tried%s",
+				 signer->name, hash_algo->common.fqn,
+				 str_id(&c->remote->host.id, &idb),
+				 as->tried);
 		}
-		/* all methods log this string */
-		jam_string(buf, "authenticated peer ");
-		/* what is the AUTH method ... */
-		jam_string(buf, "'");
-		signer->jam_auth_method(buf, signer, s.key, hash_algo);
-		jam_string(buf, "'");
-		if (signature_payload_name != NULL) {
-			jam(buf, " %s", signature_payload_name);
-		} else {
-			jam(buf, " signature");
+	} else {
+		pexpect(as->tried_cnt > 0);
+		const char *cert_origin = NULL;
+		for (unsigned i = 0; i < as->nr_candidates; i++) {
+			if (as->candidates[i].key == as->key) {
+				cert_origin = as->candidates[i].cert_origin;
+				break;
+			}
 		}
-		/* ... and what was used to authenticate it */
-		jam(buf, " using %s certificate ", s.cert_origin);
-		jam_string(buf, "'");
-		jam_id_bytes(buf, &s.key->id, jam_sanitized_bytes);
-		jam_string(buf, "'");
-		/* this is so that the cert verified line can be deleted */
-		if (s.key->issuer.ptr != NULL) {
-			jam_string(buf, " issued by CA ");
+		LLOG_JAMBUF(RC_LOG_SERIOUS, ike->sa.st_logger, buf) {
+			if (ike->sa.st_ike_version == IKEv2) {
+				/*
+				 * IKEv2 only; IKEv1 logs established as a
+				 * separate line.
+				 */
+				jam(buf, "%s established IKE SA; ",
+				    (ike->sa.st_sa_role == SA_INITIATOR ? "initiator" :
+				     ike->sa.st_sa_role == SA_RESPONDER ? "responder" :
+				     "?"));
+			}
+			/* all methods log this string */
+			jam_string(buf, "authenticated peer ");
+			/* what is the AUTH method ... */
+			jam_string(buf, "'");
+			signer->jam_auth_method(buf, signer, as->key, hash_algo);
 			jam_string(buf, "'");
-			jam_dn(buf, s.key->issuer, jam_sanitized_bytes);
+			if (signature_payload_name != NULL) {
+				jam(buf, " %s", signature_payload_name);
+			} else {
+				jam(buf, " signature");
+			}
+			/* ... and what was used to authenticate it */
+			jam(buf, " using %s certificate ", cert_origin);
+			jam_string(buf, "'");
+			jam_id_bytes(buf, &as->key->id, jam_sanitized_bytes);
 			jam_string(buf, "'");
+			/* this is so that the cert verified line can be deleted */
+			if (as->key->issuer.ptr != NULL) {
+				jam_string(buf, " issued by CA ");
+				jam_string(buf, "'");
+				jam_dn(buf, as->key->issuer, jam_sanitized_bytes);
+				jam_string(buf, "'");
+			}
 		}
+		pubkey_delref(&ike->sa.st_peer_pubkey);
+		ike->sa.st_peer_pubkey = pubkey_addref(as->key);
 	}
-	pubkey_delref(&ike->sa.st_peer_pubkey);
-	ike->sa.st_peer_pubkey = pubkey_addref(s.key);
-	return NULL;
+
+	free_authsig(asp);
+	return d;
+}
+
+void free_authsig(struct authsig **asp)
+{
+	struct authsig *as = *asp;
+	if (as == NULL) {
+		return;
+	}
+	*asp = NULL;
+	for (unsigned i = 0; i < as->nr_candidates; i++) {
+		pubkey_delref(&as->candidates[i].key);
+	}
+	pfreeany(as->candidates);
+	free_chunk_content(&as->signature);
+	pfree_diag(&as->fatal_diag);
+	pfree(as);
+}
+
+diag_t authsig_and_log_using_pubkey(struct ike_sa *ike,
+				    const struct crypt_mac *hash,
+				    shunk_t signature,
+				    const struct hash_desc *hash_algo,
+				    const struct pubkey_signer *signer,
+				    const char *signature_payload_name)
+{
+	struct authsig *as = start_authsig(ike, hash, signature, hash_algo, signer);
+	try_authsig(as, ike->sa.st_logger);
+	return finish_authsig(ike, &as, signature_payload_name);
 }
 
 /*
@@ -475,7 +539,7 @@ static struct secret *lsw_get_secret(const struct connection *c,
 /*
  * find the struct secret associated with an XAUTH username.
  */
-struct secret *lsw_get_xauthsecret(char *xauthname)
+struct secret *lsw_get_xauthsecret(const char *xauthname)
 {
 	struct secret *best = NULL;
 
@@ -686,13 +750,342 @@ const struct secret_stuff *get_local_private_key(const struct connection *c,
  * public key machinery
  */
 
-/* root of chained public key list */
+/*
+ * The preloaded public key DB: keys from ipsec.conf, whack, DNS
+ * (IPSECKEY) and local certificates.
+ *
+ * Each key is on a list (newest first) and is hashed by its ID and
+ * its CKAID.  Keys that expire are also kept on a heap ordered by
+ * .until_time so that pruning only looks at keys that have actually
+ * expired.
+ *
+ * The ID hash is consistent with id_eq(): FQDNs ignore case and
+ * trailing dots, and DNs, which can be matched using wildcards, are
+ * hashed by kind alone.  Since buckets are ordered oldest to newest,
+ * walking a bucket NEW2OLD visits keys in the same order as the list.
+ */
+
+#define PUBKEY_TABLE_SIZE 4093
+
+struct preloaded_pubkey {
+	struct pubkey *key;
+	unsigned expiry_slot;	/* 0 when never expires */
+	struct {
+		struct list_entry list;
+		struct list_entry id;
+		struct list_entry ckaid;
+	} hash_table_entries;
+};
+
+static void jam_preloaded_pubkey(struct jambuf *buf, const struct preloaded_pubkey *pp)
+{
+	jam_id_bytes(buf, &pp->key->id, jam_sanitized_bytes);
+	jam(buf, " %s", pp->key->content.type->name);
+	jam(buf, " *%s", str_keyid(pp->key->content.keyid));
+}
+
+static hash_t hash_preloaded_pubkey_id(const struct id *id)
+{
+	hash_t hash = hash_thing(id->kind, zero_hash);
+	switch (id->kind) {
+	case ID_IPV4_ADDR:
+	case ID_IPV6_ADDR:
+		return hash_hunk(address_as_shunk(&id->ip_addr), hash);
+	case ID_FQDN:
+	case ID_USER_FQDN:
+	{
+		/* same as id_eq(): ignore case and trailing dots */
+		const char *name = (const char *)id->name.ptr;
+		size_t len = id->name.len;
+		while (len > 0 && name[len - 1] == '.') {
+			len--;
+		}
+		for (size_t i = 0; i < len; i++) {
+			uint8_t c = tolower((unsigned char)name[i]);
+			hash = hash_thing(c, hash);
+		}
+		return hash;
+	}
+	case ID_KEY_ID:
+		return hash_hunk(id->name, hash);
+	default:
+		/* DNs (wildcards), NULL, NONE */
+		return hash;
+	}
+}
+
+static void jam_preloaded_pubkey_id(struct jambuf *buf, const struct preloaded_pubkey *pp)
+{
+	jam_preloaded_pubkey(buf, pp);
+}
+
+HASH_TABLE(preloaded_pubkey, id, .key->id, PUBKEY_TABLE_SIZE);
+
+static hash_t hash_preloaded_pubkey_ckaid(const ckaid_t *ckaid)
+{
+	return hash_bytes(ckaid->ptr, ckaid->len, zero_hash);
+}
+
+static void jam_preloaded_pubkey_ckaid(struct jambuf *buf, const struct preloaded_pubkey *pp)
+{
+	jam_preloaded_pubkey(buf, pp);
+	jam_string(buf, " ");
+	jam_ckaid(buf, &pp->key->content.ckaid);
+}
 
-struct pubkey_list *pluto_pubkeys = NULL;       /* keys from ipsec.conf */
+HASH_TABLE(preloaded_pubkey, ckaid, .key->content.ckaid, PUBKEY_TABLE_SIZE);
+
+HASH_DB(preloaded_pubkey,
+	&preloaded_pubkey_id_hash_table,
+	&preloaded_pubkey_ckaid_hash_table);
+
+/*
+ * Number of keys with ID_NONE; since same_id() treats those as a
+ * wildcard, lookups using same_id() can't rely on the ID hash.
+ */
+static unsigned nr_wildcard_pubkeys;
+
+/*
+ * Binary min-heap, by .until_time, of the keys that expire.  Slot 0
+ * is unused so that .expiry_slot==0 means "not on the heap".
+ */
+static struct {
+	struct preloaded_pubkey **slots;
+	unsigned len;	/* including unused slot 0 */
+	unsigned size;
+} pubkey_expiry;
+
+static bool pubkey_expires_before(const struct preloaded_pubkey *l,
+				  const struct preloaded_pubkey *r)
+{
+	return realtime_cmp(l->key->until_time, <, r->key->until_time);
+}
+
+static void set_pubkey_expiry_slot(unsigned slot, struct preloaded_pubkey *pp)
+{
+	pubkey_expiry.slots[slot] = pp;
+	pp->expiry_slot = slot;
+}
+
+static void sift_pubkey_expiry_up(unsigned slot)
+{
+	struct preloaded_pubkey *pp = pubkey_expiry.slots[slot];
+	while (slot > 1 && pubkey_expires_before(pp, pubkey_expiry.slots[slot / 2])) {
+		set_pubkey_expiry_slot(slot, pubkey_expiry.slots[slot / 2]);
+		slot /= 2;
+	}
+	set_pubkey_expiry_slot(slot, pp);
+}
+
+static void sift_pubkey_expiry_down(unsigned slot)
+{
+	struct preloaded_pubkey *pp = pubkey_expiry.slots[slot];
+	while (2 * slot < pubkey_expiry.len) {
+		unsigned child = 2 * slot;
+		if (child + 1 < pubkey_expiry.len &&
+		    pubkey_expires_before(pubkey_expiry.slots[child + 1],
+					  pubkey_expiry.slots[child])) {
+			child++;
+		}
+		if (!pubkey_expires_before(pubkey_expiry.slots[child], pp)) {
+			break;
+		}
+		set_pubkey_expiry_slot(slot, pubkey_expiry.slots[child]);
+		slot = child;
+	}
+	set_pubkey_expiry_slot(slot, pp);
+}
+
+static void add_pubkey_expiry(struct preloaded_pubkey *pp)
+{
+	if (pubkey_expiry.len == 0) {
+		pubkey_expiry.len = 1; /* skip slot 0 */
+	}
+	if (pubkey_expiry.len >= pubkey_expiry.size) {
+		unsigned size = (pubkey_expiry.size == 0 ? 16 : pubkey_expiry.size * 2);
+		realloc_things(pubkey_expiry.slots, pubkey_expiry.size, size,
+			       "pubkey expiry heap");
+		pubkey_expiry.size = size;
+	}
+	unsigned slot = pubkey_expiry.len++;
+	set_pubkey_expiry_slot(slot, pp);
+	sift_pubkey_expiry_up(slot);
+}
+
+static void del_pubkey_expiry(struct preloaded_pubkey *pp)
+{
+	unsigned slot = pp->expiry_slot;
+	passert(slot > 0 && slot < pubkey_expiry.len);
+	passert(pubkey_expiry.slots[slot] == pp);
+	pp->expiry_slot = 0;
+	struct preloaded_pubkey *last = pubkey_expiry.slots[--pubkey_expiry.len];
+	pubkey_expiry.slots[pubkey_expiry.len] = NULL;
+	if (last != pp) {
+		set_pubkey_expiry_slot(slot, last);
+		sift_pubkey_expiry_down(slot);
+		sift_pubkey_expiry_up(last->expiry_slot);
+	}
+}
+
+void add_preloaded_pubkey(struct pubkey *key)
+{
+	struct preloaded_pubkey *pp = alloc_thing(struct preloaded_pubkey, "preloaded pubkey");
+	pp->key = pubkey_addref(key);
+	init_db_preloaded_pubkey(pp);
+	add_db_preloaded_pubkey(pp);
+	if (key->id.kind == ID_NONE) {
+		nr_wildcard_pubkeys++;
+	}
+	if (!is_realtime_epoch(key->until_time)) {
+		add_pubkey_expiry(pp);
+	}
+}
+
+static void free_preloaded_pubkey(struct preloaded_pubkey **ppp)
+{
+	struct preloaded_pubkey *pp = *ppp;
+	*ppp = NULL;
+	del_db_preloaded_pubkey(pp, true);
+	if (pp->key->id.kind == ID_NONE) {
+		nr_wildcard_pubkeys--;
+	}
+	if (pp->expiry_slot > 0) {
+		del_pubkey_expiry(pp);
+	}
+	pubkey_delref(&pp->key);
+	pfree(pp);
+}
+
+static struct list_head *preloaded_pubkey_filter_head(struct preloaded_pubkey_filter *filter)
+{
+	/* select list head */
+	if (filter->remote_id != NULL && filter->remote_id->kind != ID_NONE) {
+		/* match_id() requires the same kind */
+		hash_t hash = hash_preloaded_pubkey_id(filter->remote_id);
+		return hash_table_bucket(&preloaded_pubkey_id_hash_table, hash);
+	}
+	if (filter->id != NULL && filter->id->kind != ID_NONE &&
+	    nr_wildcard_pubkeys == 0) {
+		/* same_id() requires the same kind, or ID_NONE */
+		hash_t hash = hash_preloaded_pubkey_id(filter->id);
+		return hash_table_bucket(&preloaded_pubkey_id_hash_table, hash);
+	}
+	if (filter->ckaid != NULL) {
+		hash_t hash = hash_preloaded_pubkey_ckaid(filter->ckaid);
+		return hash_table_bucket(&preloaded_pubkey_ckaid_hash_table, hash);
+	}
+	return &preloaded_pubkey_db_list_head;
+}
+
+static bool preloaded_pubkey_matches_filter(const struct pubkey *key,
+					    struct preloaded_pubkey_filter *filter)
+{
+	if (filter->type != NULL && key->content.type != filter->type) {
+		return false;
+	}
+	if (filter->remote_id != NULL) {
+		int wildcards; /* value ignored */
+		if (!match_id("  ", &key->id, filter->remote_id, &wildcards)) {
+			return false;
+		}
+	}
+	if (filter->id != NULL && !same_id(filter->id, &key->id)) {
+		return false;
+	}
+	if (filter->ckaid != NULL && !hunk_eq(key->content.ckaid, *filter->ckaid)) {
+		return false;
+	}
+	return true;
+}
+
+static struct preloaded_pubkey *next_preloaded_pubkey_entry(struct preloaded_pubkey_filter *filter)
+{
+	if (filter->internal == NULL) {
+		filter->internal = preloaded_pubkey_filter_head(filter)->head.next[NEW2OLD];
+	}
+	filter->key = NULL;
+	for (struct list_entry *entry = filter->internal;
+	     entry->data != NULL /* head has DATA == NULL */;
+	     entry = entry->next[NEW2OLD]) {
+		struct preloaded_pubkey *pp = entry->data;
+		if (preloaded_pubkey_matches_filter(pp->key, filter)) {
+			/* save key; but step off current entry */
+			filter->internal = entry->next[NEW2OLD];
+			filter->key = pp->key;
+			return pp;
+		}
+	}
+	return NULL;
+}
+
+bool next_preloaded_pubkey(struct preloaded_pubkey_filter *filter)
+{
+	return next_preloaded_pubkey_entry(filter) != NULL;
+}
+
+/*
+ * Delete keys, same_id() style, matching ID and TYPE.
+ */
+
+void delete_preloaded_pubkeys(const struct id *id, const struct pubkey_type *type)
+{
+	struct preloaded_pubkey_filter filter = {
+		.id = id,
+		.type = type,
+	};
+	struct preloaded_pubkey *pp;
+	/* .internal has already stepped past PP */
+	while ((pp = next_preloaded_pubkey_entry(&filter)) != NULL) {
+		free_preloaded_pubkey(&pp);
+	}
+}
+
+void replace_preloaded_pubkeys(struct pubkey_list **keys)
+{
+	/* the list is newest first; install oldest first */
+	struct pubkey_list *reversed = NULL;
+	while (*keys != NULL) {
+		struct pubkey_list *p = *keys;
+		*keys = p->next;
+		p->next = reversed;
+		reversed = p;
+	}
+	while (reversed != NULL) {
+		struct pubkey *key = reversed->key;
+		delete_preloaded_pubkeys(&key->id, key->content.type);
+		add_preloaded_pubkey(key);
+		reversed = free_public_keyentry(reversed);
+	}
+}
+
+/*
+ * Prune the keys that have expired (the heap's root expires first).
+ */
+
+void expire_preloaded_pubkeys(realtime_t now, struct logger *logger)
+{
+	while (pubkey_expiry.len > 1) {
+		struct preloaded_pubkey *pp = pubkey_expiry.slots[1];
+		if (!realtime_cmp(pp->key->until_time, <, now)) {
+			break;
+		}
+		id_buf printkid;
+		llog(RC_LOG_SERIOUS, logger,
+		     "cached %s public key '%s' has expired and has been deleted",
+		     pp->key->content.type->name, str_id(&pp->key->id, &printkid));
+		free_preloaded_pubkey(&pp);
+	}
+}
 
 void free_remembered_public_keys(void)
 {
-	free_public_keys(&pluto_pubkeys);
+	struct preloaded_pubkey *pp;
+	FOR_EACH_LIST_ENTRY_NEW2OLD(&preloaded_pubkey_db_list_head, pp) {
+		free_preloaded_pubkey(&pp);
+	}
+	pexpect(pubkey_expiry.len <= 1);
+	pfreeany(pubkey_expiry.slots);
+	pubkey_expiry.len = pubkey_expiry.size = 0;
 }
 
 /*
@@ -788,8 +1181,9 @@ void show_pubkeys(struct show *s, bool utc, enum keys_to_show keys_to_show)
 		show_blank(s);
 	}
 
-	for (struct pubkey_list *p = pluto_pubkeys; p != NULL; p = p->next) {
-		struct pubkey *pubkey = p->key;
+	struct preloaded_pubkey_filter pkf = {0};
+	while (next_preloaded_pubkey(&pkf)) {
+		struct pubkey *pubkey = pkf.key;
 		expiry_buf eb;
 		const char *expiry_msg = check_expiry(pubkey->until_time, PUBKEY_WARNING_INTERVAL, &eb);
 		switch (keys_to_show) {
@@ -828,9 +1222,23 @@ err_t preload_private_key_by_ckaid(const ckaid_t *ckaid, bool *load_needed, stru
 
 const struct pubkey *find_pubkey_by_ckaid(const char *ckaid)
 {
-	for (struct pubkey_list *p = pluto_pubkeys; p != NULL; p = p->next) {
-		DBG_log("looking at a PUBKEY");
-		struct pubkey *key = p->key;
+	/*
+	 * Try CKAID as a complete CKAID, which can use the hash
+	 * table, before searching for it as a prefix.
+	 */
+	ckaid_t full;
+	if (string_to_ckaid(ckaid, &full) == NULL) {
+		struct preloaded_pubkey_filter pkf = {
+			.ckaid = &full,
+		};
+		if (next_preloaded_pubkey(&pkf)) {
+			dbg("ckaid matching pubkey");
+			return pkf.key;
+		}
+	}
+	struct preloaded_pubkey_filter pkf = {0};
+	while (next_preloaded_pubkey(&pkf)) {
+		struct pubkey *key = pkf.key;
 		const ckaid_t *key_ckaid = pubkey_ckaid(key);
 		if (ckaid_starts_with(key_ckaid, ckaid)) {
 			dbg("ckaid matching pubkey");
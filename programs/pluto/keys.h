@@ -30,6 +30,8 @@
 #include "certs.h"
 #include "err.h"
 #include "ckaid.h"
+#include "realtime.h"
+#include "where.h"
 
 struct connection;
 struct RSA_private_key;
@@ -43,6 +45,9 @@ struct hash_desc;
 struct show;
 struct ike_sa;
 struct pubkey_signer;
+struct pubkey_list;
+struct list_entry;
+struct id;
 
 const struct secret_stuff *get_local_private_key(const struct connection *c,
 						      const struct pubkey_type *type,
@@ -64,13 +69,65 @@ extern void free_remembered_public_keys(void);
 err_t preload_private_key_by_cert(const struct cert *cert, bool *load_needed, struct logger *logger);
 err_t preload_private_key_by_ckaid(const ckaid_t *ckaid, bool *load_needed, struct logger *logger);
 
-extern struct secret *lsw_get_xauthsecret(char *xauthname);
+extern struct secret *lsw_get_xauthsecret(const char *xauthname);
 
-/* keys from ipsec.conf */
-extern struct pubkey_list *pluto_pubkeys;
+/*
+ * The preloaded public key DB (keys from ipsec.conf, whack, DNS and
+ * certificates); indexed by ID and CKAID.
+ */
+
+void init_preloaded_pubkey_db(struct logger *logger);
+void check_preloaded_pubkey_db(struct logger *logger);
+
+struct preloaded_pubkey;
+void init_db_preloaded_pubkey(struct preloaded_pubkey *pp);
+void check_db_preloaded_pubkey(struct preloaded_pubkey *pp, struct logger *logger, where_t where);
+void add_db_preloaded_pubkey(struct preloaded_pubkey *pp);
+void del_db_preloaded_pubkey(struct preloaded_pubkey *pp, bool valid);
+
+void add_preloaded_pubkey(struct pubkey *key);	/* adds a reference */
+void delete_preloaded_pubkeys(const struct id *id, const struct pubkey_type *type);
+void replace_preloaded_pubkeys(struct pubkey_list **keys);	/* steals KEYS */
+void expire_preloaded_pubkeys(realtime_t now, struct logger *logger);
+
+/*
+ * Iterate over the preloaded public keys, newest first, that match
+ * all of the filter's non-NULL fields.
+ */
+
+struct preloaded_pubkey_filter {
+	/* filters */
+	const struct id *id;		/* same_id(ID, KEY) */
+	const struct id *remote_id;	/* match_id(KEY, REMOTE_ID), DNs can be wild */
+	const struct pubkey_type *type;
+	const ckaid_t *ckaid;
+	/* current result */
+	struct pubkey *key;
+	/* internal: handle on next entry */
+	struct list_entry *internal;
+};
+
+bool next_preloaded_pubkey(struct preloaded_pubkey_filter *filter);
 
 const struct pubkey *find_pubkey_by_ckaid(const char *ckaid);
 
+/*
+ * authsig_and_log_using_pubkey() broken into its main thread and
+ * helper thread parts; see keys.c.
+ */
+
+struct authsig;
+
+struct authsig *start_authsig(struct ike_sa *ike,
+			      const struct crypt_mac *hash,
+			      shunk_t signature,
+			      const struct hash_desc *hash_algo,
+			      const struct pubkey_signer *signer);
+void try_authsig(struct authsig *as, struct logger *logger);
+diag_t finish_authsig(struct ike_sa *ike, struct authsig **as,
+		      const char *signature_payload_name);
+void free_authsig(struct authsig **as);
+
 extern diag_t authsig_and_log_using_pubkey(struct ike_sa *ike,
 					   const struct crypt_mac *hash,
 					   shunk_t signature,
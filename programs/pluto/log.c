@@ -29,6 +29,8 @@
 #include <string.h>
 #include <errno.h>
 #include <syslog.h>
+#include <unistd.h>		/* for STDERR_FILENO */
+#include <sys/uio.h>		/* for writev() */
 
 #include "defs.h"
 #include "log.h"
@@ -40,6 +42,7 @@
 #include "impair.h"
 #include "demux.h"	/* for struct msg_digest */
 #include "pending.h"
+#include "log_limiter.h"
 
 static void log_raw(int severity, const char *prefix, struct jambuf *buf);
 
@@ -62,6 +65,9 @@ static FILE *pluto_log_fp = NULL;
 
 char *pluto_stats_binary = NULL;
 
+static void start_log_ring(void);
+static void stop_log_ring(void);
+
 /*
  * Initialization.
  */
@@ -93,6 +99,9 @@ void pluto_init_log(struct log_param param)
 	if (log_to_syslog)
 		openlog("pluto", LOG_CONS | LOG_NDELAY | LOG_PID,
 			LOG_AUTHPRIV);
+
+	if (log_param.log_async)
+		start_log_ring();
 }
 
 /*
@@ -204,10 +213,287 @@ bool whack_prompt_for(struct state *st, const char *prompt,
 	return true;
 }
 
+/*
+ * Asynchronous log ring (--log-async).
+ *
+ * Formatting a message is cheap; writing it (and in particular
+ * syslog()ing it) is not.  When enabled, threads format each
+ * message, with timestamp, into a slot of a fixed size ring and
+ * return; a dedicated writer thread drains the ring, in order,
+ * batching the lines into a single writev().
+ *
+ * The ring is a bounded multi-producer queue (each slot carries a
+ * sequence number that says whose turn it is) so producers never
+ * block on each other, or on the writer.  When the ring is full
+ * the message is dropped and counted; debug messages are dropped
+ * early, so that a debug storm doesn't crowd out real log lines.
+ * The writer reports drops, subject to log_ring_limiter.
+ *
+ * Errors (which include passert() and fatal() on their way to
+ * abort()/exit()) are not queued: the ring is drained and the
+ * error written directly so it is never lost.
+ */
+
+#define LOG_RING_SLOTS 1024		/* power of 2 */
+#define LOG_RING_MASK (LOG_RING_SLOTS - 1)
+#define LOG_RING_BATCH 64		/* lines per writev() */
+#define LOG_RING_LINE (LOG_WIDTH + 64)	/* message + timestamp */
+
+struct log_slot {
+	size_t sequence;
+	int severity;
+	size_t len;		/* including trailing NL */
+	size_t message;		/* offset past timestamp */
+	char line[LOG_RING_LINE];
+};
+
+static struct {
+	volatile bool running;
+	bool stopping;
+	pthread_t writer;
+	/* producers */
+	size_t tail;
+	uintmax_t dropped;
+	/* consumer, writer thread or error */
+	pthread_mutex_t drain_mutex;
+	size_t head;
+	uintmax_t reported;
+	/* sleeping writer */
+	pthread_mutex_t wake_mutex;
+	pthread_cond_t wake;
+	bool waiting;
+	struct log_slot slots[LOG_RING_SLOTS];
+} log_ring = {
+	.drain_mutex = PTHREAD_MUTEX_INITIALIZER,
+	.wake_mutex = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+};
+
+static void add_to_log_ring(int severity, const char *prefix,
+			    const char *message, const struct realtm *t)
+{
+	/* HEAD first so that HEAD <= POS */
+	size_t head = __atomic_load_n(&log_ring.head, __ATOMIC_RELAXED);
+	size_t pos = __atomic_load_n(&log_ring.tail, __ATOMIC_RELAXED);
+
+	/* leave the last quarter of the ring for real messages */
+	if (severity == LOG_DEBUG &&
+	    pos - head > LOG_RING_SLOTS - LOG_RING_SLOTS / 4) {
+		__atomic_add_fetch(&log_ring.dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	struct log_slot *slot;
+	while (true) {
+		slot = &log_ring.slots[pos & LOG_RING_MASK];
+		size_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&log_ring.tail, &pos, pos + 1,
+							/*weak*/true, __ATOMIC_RELAXED,
+							__ATOMIC_RELAXED)) {
+				break;
+			}
+			/* POS updated */
+		} else if (diff < 0) {
+			/* full */
+			__atomic_add_fetch(&log_ring.dropped, 1, __ATOMIC_RELAXED);
+			return;
+		} else {
+			pos = __atomic_load_n(&log_ring.tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	/* slot is ours; format the line, leaving room for the NL */
+	int n = 0;
+	if (log_param.log_with_timestamp) {
+		char now[34] = "";
+		strftime(now, sizeof(now), "%b %e %T", &t->tm);
+		n = snprintf(slot->line, sizeof(slot->line),
+			     "%s.%06ld: ", now, t->microsec);
+	}
+	slot->message = n;
+	n += snprintf(slot->line + n, sizeof(slot->line) - n - 1,
+		      "%s%s", prefix, message);
+	if ((size_t)n > sizeof(slot->line) - 2) {
+		n = sizeof(slot->line) - 2; /* truncated */
+	}
+	slot->line[n++] = '\n';
+	slot->line[n] = '\0';
+	slot->len = n;
+	slot->severity = severity;
+	__atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+
+	/* pairs with the writer setting .waiting then checking */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&log_ring.waiting, __ATOMIC_RELAXED)) {
+		pthread_mutex_lock(&log_ring.wake_mutex);
+		pthread_cond_signal(&log_ring.wake);
+		pthread_mutex_unlock(&log_ring.wake_mutex);
+	}
+}
+
+static bool log_ring_empty(void)
+{
+	size_t head = log_ring.head;
+	struct log_slot *slot = &log_ring.slots[head & LOG_RING_MASK];
+	return __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != head + 1;
+}
+
+/* caller holds .drain_mutex */
+static void drain_log_ring(void)
+{
+	while (!log_ring_empty()) {
+		struct iovec iov[LOG_RING_BATCH];
+		unsigned nr = 0;
+		while (nr < elemsof(iov) && !log_ring_empty()) {
+			struct log_slot *slot =
+				&log_ring.slots[(log_ring.head + nr) & LOG_RING_MASK];
+			if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) !=
+			    log_ring.head + nr + 1) {
+				break;
+			}
+			iov[nr].iov_base = slot->line;
+			iov[nr].iov_len = slot->len;
+			nr++;
+		}
+
+		if (log_to_stderr || pluto_log_fp != NULL) {
+			int fd = (log_to_stderr ? STDERR_FILENO : fileno(pluto_log_fp));
+			/* a short write loses the tail; same as fprintf() */
+			if (writev(fd, iov, nr) < 0) {
+				/* nowhere to report this */
+			}
+		}
+
+		for (unsigned i = 0; i < nr; i++) {
+			struct log_slot *slot =
+				&log_ring.slots[log_ring.head & LOG_RING_MASK];
+			if (log_to_syslog) {
+				syslog(slot->severity, "%.*s",
+				       (int)(slot->len - slot->message - 1),
+				       slot->line + slot->message);
+			}
+			/* hand the slot back to the producers */
+			__atomic_store_n(&slot->sequence,
+					 log_ring.head + LOG_RING_SLOTS,
+					 __ATOMIC_RELEASE);
+			__atomic_store_n(&log_ring.head, log_ring.head + 1,
+					 __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static void report_log_ring_drops(void)
+{
+	uintmax_t dropped = __atomic_load_n(&log_ring.dropped, __ATOMIC_RELAXED);
+	if (dropped == log_ring.reported) {
+		return;
+	}
+	struct logger logger[1] = { global_logger, };
+	if (!log_is_limited(logger, &log_ring_limiter)) {
+		llog(RC_LOG, logger, "log ring full, dropped %ju messages (%ju total)",
+		     dropped - log_ring.reported, dropped);
+	}
+	log_ring.reported = dropped;
+}
+
+static void *log_ring_writer(void *arg UNUSED)
+{
+	while (true) {
+		pthread_mutex_lock(&log_ring.drain_mutex);
+		drain_log_ring();
+		report_log_ring_drops();
+		pthread_mutex_unlock(&log_ring.drain_mutex);
+
+		pthread_mutex_lock(&log_ring.wake_mutex);
+		__atomic_store_n(&log_ring.waiting, true, __ATOMIC_SEQ_CST);
+		bool stopping = log_ring.stopping;
+		if (!stopping && log_ring_empty()) {
+			/* timeout is belt-and-braces */
+			struct timespec ts;
+			clock_gettime(realtime_clockid(), &ts);
+			ts.tv_sec += 1;
+			pthread_cond_timedwait(&log_ring.wake, &log_ring.wake_mutex, &ts);
+		}
+		__atomic_store_n(&log_ring.waiting, false, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&log_ring.wake_mutex);
+
+		if (stopping) {
+			/* drained above, after .stopping was set */
+			break;
+		}
+	}
+	return NULL;
+}
+
+static void log_ring_atfork_child(void)
+{
+	/* the writer thread didn't come along; log directly */
+	log_ring.running = false;
+}
+
+static void start_log_ring(void)
+{
+	for (unsigned i = 0; i < LOG_RING_SLOTS; i++) {
+		log_ring.slots[i].sequence = i;
+	}
+	log_ring.head = log_ring.tail = 0;
+	log_ring.stopping = false;
+
+	int e = pthread_create(&log_ring.writer, NULL, log_ring_writer, NULL);
+	if (e != 0) {
+		fprintf(stderr, "cannot start log writer thread: %s; logging synchronously\n",
+			strerror(e));
+		return;
+	}
+	static bool atfork;
+	if (!atfork) {
+		pthread_atfork(NULL, NULL, log_ring_atfork_child);
+		atfork = true;
+	}
+	log_ring.running = true;
+}
+
+static void stop_log_ring(void)
+{
+	if (!log_ring.running) {
+		return;
+	}
+	pthread_mutex_lock(&log_ring.wake_mutex);
+	log_ring.stopping = true;
+	pthread_cond_signal(&log_ring.wake);
+	pthread_mutex_unlock(&log_ring.wake_mutex);
+	pthread_join(log_ring.writer, NULL);
+	/* from here on, log directly */
+	log_ring.running = false;
+	pthread_mutex_lock(&log_ring.drain_mutex);
+	drain_log_ring();
+	pthread_mutex_unlock(&log_ring.drain_mutex);
+}
+
+bool log_is_async(void)
+{
+	return log_ring.running;
+}
+
 static void log_raw(int severity, const char *prefix, struct jambuf *buf)
 {
 	/* assume there's a logging prefix; normally there is */
 	struct realtm t = local_realtime(realnow());
+	if (log_ring.running) {
+		if (severity != LOG_ERR) {
+			add_to_log_ring(severity, prefix, buf->array, &t);
+			return;
+		}
+		/* after what is already queued; before any abort() */
+		pthread_mutex_lock(&log_ring.drain_mutex);
+		drain_log_ring();
+		stdlog_raw(prefix, buf->array, &t);
+		syslog_raw(severity, prefix, buf->array);
+		pthread_mutex_unlock(&log_ring.drain_mutex);
+		return;
+	}
 	stdlog_raw(prefix, buf->array, &t);
 	syslog_raw(severity, prefix, buf->array);
 	/* not whack */
@@ -215,6 +501,8 @@ static void log_raw(int severity, const char *prefix, struct jambuf *buf)
 
 void close_log(void)
 {
+	stop_log_ring();
+
 	if (log_to_syslog)
 		closelog();
 
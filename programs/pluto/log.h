@@ -37,6 +37,7 @@ struct show;
 
 struct log_param {
 	bool log_with_timestamp;	/* testsuite requires no timestamps */
+	bool log_async;			/* queue for a writer thread */
 };
 
 /* start with this before parsing options */
@@ -48,6 +49,7 @@ extern const struct log_param default_log_param;
 
 extern void pluto_init_log(struct log_param);
 extern void close_log(void);
+extern bool log_is_async(void);
 
 extern bool log_to_audit;
 extern bool log_append;
@@ -38,6 +38,7 @@ struct log_limiter {
 #define RATE_LIMIT 1000
 struct log_limiter md_log_limiter = LOG_LIMIT(RATE_LIMIT, "message digest");
 struct log_limiter certificate_log_limiter = LOG_LIMIT(10, "bad certificate");
+struct log_limiter log_ring_limiter = LOG_LIMIT(10, "log ring overflow");
 
 static unsigned log_limit(const struct log_limiter *limiter)
 {
@@ -110,12 +111,17 @@ static global_timer_cb reset_log_limiter;	/* type check */
 
 static void reset_log_limiter(struct logger *logger)
 {
-	FOR_EACH_THING(limiter, &md_log_limiter, &certificate_log_limiter) {
-		if (limiter->count > log_limit(limiter)) {
+	FOR_EACH_THING(limiter, &md_log_limiter, &certificate_log_limiter,
+		       &log_ring_limiter) {
+		unsigned limit = log_limit(limiter);
+		pthread_mutex_lock(&limiter->mutex);
+		bool was_limited = (limiter->count > limit);
+		limiter->count = 0;
+		pthread_mutex_unlock(&limiter->mutex);
+		if (was_limited) {
 			llog(RC_LOG, logger, "%s rate limited log reset",
 			     limiter->what);
 		}
-		limiter->count = 0;
 	}
 }
 
@@ -29,6 +29,7 @@ struct logger;
 
 extern struct log_limiter md_log_limiter;
 extern struct log_limiter certificate_log_limiter;
+extern struct log_limiter log_ring_limiter;
 
 bool log_is_limited(struct logger *logger, struct log_limiter *limiter);
 
@@ -19,14 +19,21 @@
 #include "log.h"
 #include "demux.h"      /* needs packet.h */
 #include "iface.h"
+#include "arena.h"
+
+static struct arena_category md_arena_category = ARENA_CATEGORY("msg_digest arena");
 
 static void free_md(void *obj, where_t where)
 {
 	struct msg_digest *md = obj;
 	free_chunk_content(&md->raw_packet);
-	free_logger(&md->md_logger, where);
+	/* allocated from the arena; see alloc_md() */
+	release_whack(md->md_logger, where);
+	dbg_free("logger", md->md_logger, where);
 	iface_endpoint_delref_where(&md->iface, where);
-	pfree(md);
+	/* MD is part of the arena */
+	struct arena *arena = md->arena;
+	free_arena(&arena, where);
 }
 
 struct msg_digest *alloc_md(struct iface_endpoint *ifp,
@@ -34,15 +41,27 @@ struct msg_digest *alloc_md(struct iface_endpoint *ifp,
 			    const uint8_t *packet, size_t packet_len,
 			    where_t where)
 {
-	struct msg_digest *md = refcnt_overalloc(struct msg_digest, packet_len, free_md, where);
+	static const struct refcnt_base md_refcnt_base = {
+		.what = "struct msg_digest",
+		.free = free_md,
+	};
+	struct arena *arena = alloc_arena(&md_arena_category, where);
+	struct msg_digest *md = arena_alloc_thing(arena, struct msg_digest);
+	refcnt_init(md, &md->refcnt, &md_refcnt_base, where);
+	md->arena = arena;
 	md->iface = iface_endpoint_addref_where(ifp, where);
 	md->sender = *sender;
-	md->md_logger = alloc_logger(md, &logger_message_vec, where);
-	void *buffer = md + 1;
+	/* same as alloc_logger(), but in the arena */
+	struct logger logger = {
+		.object = md,
+		.object_vec = &logger_message_vec,
+		.where = where,
+	};
+	md->md_logger = arena_clone_thing(arena, logger);
+	dbg_alloc("alloc logger", md->md_logger, where);
+	void *buffer = (packet != NULL ? arena_clone_bytes(arena, packet, packet_len) :
+			arena_alloc_bytes(arena, packet_len));
 	init_pbs(&md->packet_pbs, buffer, packet_len, "packet");
-	if (packet != NULL) {
-		memcpy(buffer, packet, packet_len);
-	}
 	return md;
 }
 
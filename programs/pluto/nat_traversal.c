@@ -230,8 +230,12 @@ static void nat_traversal_ka_event_state(struct state *st, unsigned *data)
 		 * anything eg, if short LIVENESS timers are used we
 		 * can skip this.
 		 */
-		if (!is_monotime_epoch(st->st_v2_msgid_windows.last_sent) &&
-		    deltasecs(monotimediff(mononow(), st->st_v2_msgid_windows.last_sent)) < DEFAULT_KEEP_ALIVE_SECS) {
+		struct ike_sa *ike = pexpect_ike_sa(st);
+		if (ike == NULL) {
+			return;
+		}
+		if (!is_monotime_epoch(ike->st_v2_msgid_windows.last_sent) &&
+		    deltasecs(monotimediff(mononow(), ike->st_v2_msgid_windows.last_sent)) < DEFAULT_KEEP_ALIVE_SECS) {
 			dbg("skipping NAT-T KEEP-ALIVE: recent message sent using the IKE SA on conn %s",
 			    c->name);
 			return;
@@ -4,6 +4,8 @@
 #include "constants.h"
 #include "defs.h"
 #include "keys.h"
+#include "ikev2_cert.h"		/* for forget_v2_cert_payloads() */
+#include "pluto_x509.h"		/* for flush_trusted_ca_cache() */
 #include "log.h"
 #include "nss_cert_load.h"
 #include "whack.h"
@@ -50,6 +52,7 @@ static void reread_end_cert(struct end *end,
 		return;
 	}
 
+	forget_v2_cert_payloads(old_cert);
 	CERT_DestroyCertificate(old_cert);
 	config_end->host.cert.nss_cert = new_cert;
 
@@ -79,6 +82,9 @@ static void reread_cert(struct connection *c, struct logger *logger)
 /* reread all left/right certificates from NSS DB */
 void reread_cert_connections(struct logger *logger)
 {
+	/* the chains, and not just the certs, may have changed */
+	forget_v2_cert_payloads(NULL);
+	flush_trusted_ca_cache("certificates re-read");
 	struct connection_filter cf = { .where = HERE, };
 	while (next_connection_new2old(&cf)) {
 		struct connection *c = cf.c;
@@ -25,6 +25,7 @@
 #include <dirent.h>
 #include <time.h>
 #include <limits.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include "sysdep.h"
 #include "lswnss.h"
@@ -45,6 +46,8 @@
 #include "ip_info.h"
 #include "log.h"
 #include "log_limiter.h"
+#include "crypt_hash.h"
+#include "ike_alg_hash.h"
 
 static bool crl_is_current(CERTSignedCrl *crl)
 {
@@ -497,6 +500,174 @@ static struct certs *decode_cert_payloads(CERTCertDBHandle *handle,
 	return certs;
 }
 
+/*
+ * Cache of verified certificate chains.
+ *
+ * A peer that re-authenticates, or reconnects, sends the same CERT
+ * payloads; remember the chains that verified (end cert first) so
+ * that, next time, the decode and CERT_PKIXVerifyCert() can be
+ * skipped.
+ *
+ * An entry is keyed by a hash of the CERT payloads, the trust
+ * anchors (root_certs.digest) and the revocation options.  It
+ * expires when the first of its certs reaches notAfter.  Everything
+ * is flushed when a CRL is imported.  OCSP results can't be
+ * invalidated so, when OCSP is enabled, nothing is cached.
+ *
+ * This is called from both the main thread (IKEv1) and helper
+ * threads (IKEv2), and flushed from the fetch thread, hence the
+ * lock.
+ */
+
+#define VERIFIED_CERTS_CACHE_SIZE 256
+
+struct verified_certs_entry {
+	struct crypt_mac payloads;
+	struct crypt_mac anchors;
+	struct rev_opts rev_opts;
+	PRTime not_after;
+	uint64_t last_used;
+	struct certs *cert_chain;	/* end cert first */
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	uint64_t clock;
+	struct verified_certs_entry entries[VERIFIED_CERTS_CACHE_SIZE];
+} verified_certs_cache = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static struct certs *clone_certs(const struct certs *certs)
+{
+	struct certs *head = NULL;
+	struct certs **tail = &head;
+	for (const struct certs *entry = certs; entry != NULL; entry = entry->next) {
+		struct certs *new = alloc_thing(struct certs, __func__);
+		new->cert = CERT_DupCertificate(entry->cert);
+		*tail = new;
+		tail = &new->next;
+	}
+	return head;
+}
+
+static struct crypt_mac hash_cert_payloads(enum ike_version ike_version,
+					   struct payload_digest *cert_payloads,
+					   struct logger *logger)
+{
+	struct crypt_hash *hash = crypt_hash_init("CERT payloads", &ike_alg_hash_sha2_256, logger);
+	crypt_hash_digest_thing(hash, "IKE version", ike_version);
+	for (struct payload_digest *p = cert_payloads; p != NULL; p = p->next) {
+		uint8_t cert_type = (ike_version == IKEv2 ? p->payload.v2cert.isac_enc :
+				     p->payload.cert.isacert_type);
+		crypt_hash_digest_thing(hash, "type", cert_type);
+		shunk_t payload = pbs_in_left_as_shunk(&p->pbs);
+		size_t len = payload.len;
+		crypt_hash_digest_thing(hash, "length", len);
+		crypt_hash_digest_hunk(hash, "payload", payload);
+	}
+	return crypt_hash_final_mac(&hash);
+}
+
+static bool verified_certs_entry_matches(const struct verified_certs_entry *entry,
+					 const struct crypt_mac *payloads,
+					 const struct root_certs *root_certs,
+					 const struct rev_opts *rev_opts)
+{
+	return (entry->cert_chain != NULL &&
+		hunk_eq(entry->payloads, *payloads) &&
+		hunk_eq(entry->anchors, root_certs->digest) &&
+		memeq(&entry->rev_opts, rev_opts, sizeof(*rev_opts)));
+}
+
+static void flush_verified_certs_entry(struct verified_certs_entry *entry)
+{
+	release_certs(&entry->cert_chain);
+	zero(entry);
+}
+
+/*
+ * Return a copy of the cached chain, or NULL.
+ */
+
+static struct certs *find_verified_certs(const struct crypt_mac *payloads,
+					 const struct root_certs *root_certs,
+					 const struct rev_opts *rev_opts)
+{
+	struct certs *cert_chain = NULL;
+	PRTime now = PR_Now();
+	pthread_mutex_lock(&verified_certs_cache.mutex);
+	FOR_EACH_ELEMENT(entry, verified_certs_cache.entries) {
+		if (verified_certs_entry_matches(entry, payloads, root_certs, rev_opts)) {
+			if (now >= entry->not_after) {
+				dbg("verified certs cache: %s has expired",
+				    entry->cert_chain->cert->subjectName);
+				flush_verified_certs_entry(entry);
+				break;
+			}
+			entry->last_used = ++verified_certs_cache.clock;
+			cert_chain = clone_certs(entry->cert_chain);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&verified_certs_cache.mutex);
+	return cert_chain;
+}
+
+static void add_verified_certs(const struct crypt_mac *payloads,
+			       const struct root_certs *root_certs,
+			       const struct rev_opts *rev_opts,
+			       const struct certs *cert_chain)
+{
+	/* the entry can't outlive any cert in the chain */
+	PRTime not_after = LL_MAXINT;
+	for (const struct certs *entry = cert_chain; entry != NULL; entry = entry->next) {
+		PRTime not_before, cert_not_after;
+		if (CERT_GetCertTimes(entry->cert, &not_before, &cert_not_after) != SECSuccess) {
+			return;
+		}
+		not_after = (cert_not_after < not_after ? cert_not_after : not_after);
+	}
+
+	pthread_mutex_lock(&verified_certs_cache.mutex);
+	/* replace a match, an empty slot, or the least recently used */
+	struct verified_certs_entry *victim = NULL;
+	FOR_EACH_ELEMENT(entry, verified_certs_cache.entries) {
+		if (verified_certs_entry_matches(entry, payloads, root_certs, rev_opts) ||
+		    entry->cert_chain == NULL) {
+			victim = entry;
+			break;
+		}
+		if (victim == NULL || entry->last_used < victim->last_used) {
+			victim = entry;
+		}
+	}
+	flush_verified_certs_entry(victim);
+	*victim = (struct verified_certs_entry) {
+		.payloads = *payloads,
+		.anchors = root_certs->digest,
+		.rev_opts = *rev_opts,
+		.not_after = not_after,
+		.last_used = ++verified_certs_cache.clock,
+		.cert_chain = clone_certs(cert_chain),
+	};
+	pthread_mutex_unlock(&verified_certs_cache.mutex);
+}
+
+void flush_verified_certs_cache(const char *reason)
+{
+	unsigned nr = 0;
+	pthread_mutex_lock(&verified_certs_cache.mutex);
+	FOR_EACH_ELEMENT(entry, verified_certs_cache.entries) {
+		if (entry->cert_chain != NULL) {
+			flush_verified_certs_entry(entry);
+			nr++;
+		}
+	}
+	pthread_mutex_unlock(&verified_certs_cache.mutex);
+	dbg("verified certs cache: flushed %u entries: %s", nr, reason);
+}
+
 /*
  * Decode and verify the chain received by pluto.
  * ee_out is the resulting end cert
@@ -538,6 +709,31 @@ struct verified_certs find_and_verify_certs(struct logger *logger,
 	CERTCertDBHandle *handle = CERT_GetDefaultCertDB();
 	passert(handle != NULL);
 
+	/*
+	 * Has this chain already been verified?
+	 *
+	 * In strict mode, the CRLs still need to be current.
+	 */
+	bool cacheable = !rev_opts->ocsp;
+	struct crypt_mac payloads_hash = empty_mac;
+	if (cacheable) {
+		payloads_hash = hash_cert_payloads(ike_version, cert_payloads, logger);
+		result.cert_chain = find_verified_certs(&payloads_hash, root_certs, rev_opts);
+		if (result.cert_chain != NULL) {
+			if (rev_opts->crl_strict &&
+			    crl_update_check(handle, result.cert_chain)) {
+				dbg("verified certs cache: CRL is missing or expired");
+				release_certs(&result.cert_chain);
+			} else {
+				dbg("verified certs cache: %s already verified",
+				    result.cert_chain->cert->subjectName);
+				add_pubkey_from_nss_cert(&result.pubkey_db, keyid,
+							 result.cert_chain->cert, logger);
+				return result;
+			}
+		}
+	}
+
 	/*
 	 * In order for NSS to verify an entire chain, down to a
 	 * CA loaded permanently into the NSS db, a temporary import
@@ -600,6 +796,10 @@ struct verified_certs find_and_verify_certs(struct logger *logger,
 		return result;
 	}
 
+	if (cacheable) {
+		add_verified_certs(&payloads_hash, root_certs, rev_opts, result.cert_chain);
+	}
+
 	logtime_t start_add = logtime_start(logger);
 	add_pubkey_from_nss_cert(&result.pubkey_db, keyid, end_cert, logger);
 	logtime_stop(&start_add, "%s() calling add_pubkey_from_nss_cert()", __func__);
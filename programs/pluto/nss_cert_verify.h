@@ -55,6 +55,12 @@ struct verified_certs find_and_verify_certs(struct logger *log,
 					    struct root_certs *root_cert,
 					    const struct id *keyid);
 
+/*
+ * Forget the chains that have been verified; for instance, because a
+ * CRL was imported.
+ */
+void flush_verified_certs_cache(const char *reason);
+
 extern diag_t cert_verify_subject_alt_name(const CERTCertificate *cert, const struct id *id);
 
 extern SECItem *nss_pkcs7_blob(const struct cert *cert, bool send_full_chain);
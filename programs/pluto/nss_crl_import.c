@@ -29,9 +29,81 @@
 #include "log.h"
 #include "lswalloc.h"
 #include "lswnss.h"	/* for llog_nss_error() */
+#include "nss_cert_verify.h"	/* for flush_verified_certs_cache() */
+#include "pluto_x509.h"		/* for flush_trusted_ca_cache() */
 
 static const char crl_name[] = "_import_crl";
 
+/*
+ * Does NSS hold a CRL issued by ISSUER_DN?
+ */
+bool nss_has_crl(chunk_t issuer_dn)
+{
+	CERTCertDBHandle *handle = CERT_GetDefaultCertDB();
+	passert(handle != NULL);
+	SECItem issuer = same_chunk_as_secitem(issuer_dn, siBuffer);
+	CERTSignedCrl *crl = SEC_FindCrlByName(handle, &issuer, SEC_CRL_TYPE);
+	if (crl == NULL) {
+		return false;
+	}
+	SEC_DestroyCrl(crl);
+	return true;
+}
+
+/*
+ * Compare the CRL numbers (or, when either lacks one, thisUpdate) of
+ * two CRLs from the same issuer.
+ */
+static bool same_crl_version(CERTCrl *l, CERTCrl *r)
+{
+	PLArenaPool *arena = PORT_NewArena(SEC_ASN1_DEFAULT_ARENA_SIZE);
+	if (arena == NULL) {
+		return false;
+	}
+	SECItem ln = {0}, rn = {0};
+	bool same;
+	if (CERT_FindCRLNumberExten(arena, l, &ln) == SECSuccess &&
+	    CERT_FindCRLNumberExten(arena, r, &rn) == SECSuccess) {
+		same = SECITEM_ItemsAreEqual(&ln, &rn);
+	} else {
+		same = SECITEM_ItemsAreEqual(&l->lastUpdate, &r->lastUpdate);
+	}
+	PORT_FreeArena(arena, PR_FALSE);
+	return same;
+}
+
+/*
+ * Does NSS already hold this very CRL?  When it does, importing it
+ * again would only churn the NSS CRL cache (and everything
+ * revalidated against it).
+ */
+bool nss_crl_is_current(const uint8_t *der, size_t len, struct logger *logger)
+{
+	SECItem crl_si = {
+		.type = siBuffer,
+		.data = (uint8_t *)der,
+		.len = len,
+	};
+	CERTSignedCrl *fetched = CERT_DecodeDERCrlWithFlags(NULL, &crl_si, SEC_CRL_TYPE,
+							    CRL_DECODE_DONT_COPY_DER |
+							    CRL_DECODE_SKIP_ENTRIES);
+	if (fetched == NULL) {
+		ldbg_nss_error(logger, "decoding CRL using CERT_DecodeDERCrlWithFlags() failed");
+		return false;
+	}
+
+	CERTCertDBHandle *handle = CERT_GetDefaultCertDB();
+	passert(handle != NULL);
+	CERTSignedCrl *current = SEC_FindCrlByName(handle, &fetched->crl.derName, SEC_CRL_TYPE);
+	bool same = (current != NULL && same_crl_version(&fetched->crl, &current->crl));
+
+	if (current != NULL) {
+		SEC_DestroyCrl(current);
+	}
+	SEC_DestroyCrl(fetched);
+	return same;
+}
+
 /*
  * Calls the _import_crl process to add a CRL to the NSS db.
  */
@@ -192,6 +264,8 @@ int send_crl_to_import(uint8_t *der, size_t len, const char *url, struct logger
 	/* update CRL cache */
 	if (ret == 0) {
 		CERT_CRLCacheRefreshIssuer(handle, &cacert->derSubject);
+		flush_verified_certs_cache("CRL imported");
+		flush_trusted_ca_cache("CRL imported");
 	}
 end:
 	if (cacert != NULL)
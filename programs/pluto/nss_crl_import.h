@@ -15,8 +15,15 @@
 #ifndef _NSS_CRL_IMPORT
 #define _NSS_CRL_IMPORT
 
+#include <stdbool.h>
+
+#include "chunk.h"
+
 struct logger;
 
 extern int send_crl_to_import(uint8_t *der, size_t len, const char *url, struct logger *logger);
 
+extern bool nss_has_crl(chunk_t issuer_dn);
+extern bool nss_crl_is_current(const uint8_t *der, size_t len, struct logger *logger);
+
 #endif /* _NSS_CRL_IMPORT */
@@ -29,6 +29,7 @@
 #include "impair.h"
 #include "ip_info.h"		/* used by pbs_in_address() */
 #include "packet.h"
+#include "packet_codec.h"
 #include "shunk.h"
 
 #include "defs.h"
@@ -91,6 +92,7 @@ static field_desc isa_fields[] = {
 struct_desc isakmp_hdr_desc = {
 	.name = "ISAKMP Message",
 	.fields = isa_fields,
+	.codec = &isakmp_hdr_codec,
 	.size = sizeof(struct isakmp_hdr),
 	.pt = ISAKMP_NEXT_NONE,
 };
@@ -858,6 +860,7 @@ static field_desc ikev2generic_fields[] = {
 struct_desc ikev2_generic_desc = {
 	.name = "IKEv2 Generic Payload",
 	.fields = ikev2generic_fields,
+	.codec = &ikev2_generic_codec,
 	.size = sizeof(struct ikev2_generic),
 	.pt = ISAKMP_NEXT_v2NONE,	/* could be any unknown */
 };
@@ -865,6 +868,7 @@ struct_desc ikev2_generic_desc = {
 struct_desc ikev2_unknown_payload_desc = {
 	.name = "IKEv2 Unknown Payload",
 	.fields = ikev2generic_fields,
+	.codec = &ikev2_generic_codec,
 	.size = sizeof(struct ikev2_generic),
 	.pt = ISAKMP_NEXT_v2UNKNOWN,
 };
@@ -889,6 +893,7 @@ struct_desc ikev2_unknown_payload_desc = {
 struct_desc ikev2_sa_desc = {
 	.name = "IKEv2 Security Association Payload",
 	.fields = ikev2generic_fields,
+	.codec = &ikev2_generic_codec,
 	.size = sizeof(struct ikev2_sa),
 	.pt = ISAKMP_NEXT_v2SA,
 	.nsst = v2_PROPOSAL_NON_LAST,
@@ -929,6 +934,7 @@ static field_desc ikev2prop_fields[] = {
 struct_desc ikev2_prop_desc = {
 	.name = "IKEv2 Proposal Substructure Payload",
 	.fields = ikev2prop_fields,
+	.codec = &ikev2_prop_codec,
 	.size = sizeof(struct ikev2_prop),
 	.nsst = v2_TRANSFORM_NON_LAST,
 };
@@ -963,6 +969,7 @@ static field_desc ikev2trans_fields[] = {
 struct_desc ikev2_trans_desc = {
 	.name = "IKEv2 Transform Substructure Payload",
 	.fields = ikev2trans_fields,
+	.codec = &ikev2_trans_codec,
 	.size = sizeof(struct ikev2_trans),
 };
 
@@ -1026,6 +1033,7 @@ static field_desc ikev2ke_fields[] = {
 struct_desc ikev2_ke_desc = {
 	.name = "IKEv2 Key Exchange Payload",
 	.fields = ikev2ke_fields,
+	.codec = &ikev2_ke_codec,
 	.size = sizeof(struct ikev2_ke),
 	.pt = ISAKMP_NEXT_v2KE,
 };
@@ -1270,6 +1278,7 @@ struct_desc ikev2_auth_desc = {
 struct_desc ikev2_nonce_desc = {
 	.name = "IKEv2 Nonce Payload",
 	.fields = ikev2generic_fields,
+	.codec = &ikev2_generic_codec,
 	.size = sizeof(struct ikev2_generic),
 	.pt = ISAKMP_NEXT_v2Ni, /*==ISAKMP_NEXT_v2Nr*/
 };
@@ -1307,6 +1316,7 @@ static field_desc ikev2_notify_fields[] = {
 struct_desc ikev2_notify_desc = {
 	.name = "IKEv2 Notify Payload",
 	.fields = ikev2_notify_fields,
+	.codec = &ikev2_notify_codec,
 	.size = sizeof(struct ikev2_notify),
 	.pt = ISAKMP_NEXT_v2N,
 };
@@ -1364,6 +1374,7 @@ struct_desc ikev2_delete_desc = {
 struct_desc ikev2_vendor_id_desc = {
 	.name = "IKEv2 Vendor ID Payload",
 	.fields = ikev2generic_fields,
+	.codec = &ikev2_generic_codec,
 	.size = sizeof(struct ikev2_generic),
 	.pt = ISAKMP_NEXT_v2V,
 };
@@ -1400,12 +1411,14 @@ static field_desc ikev2_ts_fields[] = {
 struct_desc ikev2_ts_i_desc = {
 	.name = "IKEv2 Traffic Selector - Initiator - Payload",
 	.fields = ikev2_ts_fields,
+	.codec = &ikev2_ts_codec,
 	.size = sizeof(struct ikev2_ts),
 	.pt = ISAKMP_NEXT_v2TSi,
 };
 struct_desc ikev2_ts_r_desc = {
 	.name = "IKEv2 Traffic Selector - Responder - Payload",
 	.fields = ikev2_ts_fields,
+	.codec = &ikev2_ts_codec,
 	.size = sizeof(struct ikev2_ts),
 	.pt = ISAKMP_NEXT_v2TSr,
 };
@@ -1464,6 +1477,7 @@ static field_desc ikev2_ts_header_fields[] = {
 struct_desc ikev2_ts_header_desc = {
 	.name = "IKEv2 Traffic Selector Header",
 	.fields = ikev2_ts_header_fields,
+	.codec = &ikev2_ts_header_codec,
 	.size = 4 /*sizeof(struct ikev2_ts_header) */ ,
 };
 
@@ -1475,6 +1489,7 @@ static field_desc ikev2_ts_portrange_fields[] = {
 struct_desc ikev2_ts_portrange_desc = {
 	.name = "IKEv2 IP Traffic Selector port range",
 	.fields = ikev2_ts_portrange_fields,
+	.codec = &ikev2_ts_portrange_codec,
 	.size = sizeof(struct ikev2_ts_portrange),
 };
 
@@ -1502,6 +1517,7 @@ struct_desc ikev2_ts_portrange_desc = {
 struct_desc ikev2_sk_desc = {
 	.name = "IKEv2 Encryption Payload",
 	.fields = ikev2generic_fields,
+	.codec = &ikev2_generic_codec,
 	.size = sizeof(struct ikev2_generic),
 	.pt = ISAKMP_NEXT_v2SK,
 };
@@ -1516,6 +1532,7 @@ struct_desc ikev2_sk_desc = {
 struct_desc ikev2_eap_desc = {
 	.name = "EAP Payload",
 	.fields = ikev2generic_fields,
+	.codec = &ikev2_generic_codec,
 	.size = sizeof(struct ikev2_generic),
 	.pt = ISAKMP_NEXT_v2EAP,
 };
@@ -2090,6 +2107,34 @@ diag_t pbs_in_struct(struct pbs_in *ins, struct_desc *sd,
 	}
 
 	passert(dest_size >= sd->size);
+
+	/*
+	 * Try the hand-unrolled decoder first; on anything out of the
+	 * ordinary it punts, leaving the interpreter below to produce
+	 * the diagnostic.  Only structures with a length field have
+	 * an OBJ_PBS.
+	 */
+	const struct struct_codec *codec = sd->codec;
+	if (codec != NULL && (codec->length >= 0) == (obj_pbs != NULL)) {
+		uintmax_t len = sd->size;
+		if (codec->decode(cur, dest_start, &len) &&
+		    len >= sd->size && len <= pbs_left(ins)) {
+			if (obj_pbs != NULL) {
+				init_pbs(obj_pbs, ins->cur, len, sd->name);
+				obj_pbs->container = ins;
+				obj_pbs->desc = sd;
+				obj_pbs->cur = cur + sd->size;
+			}
+			ins->cur += len;
+			if (DBGP(DBG_BASE)) {
+				DBG_prefix_print_struct(ins, "parse ",
+							dest_start, sd,
+							true);
+			}
+			return NULL;
+		}
+	}
+
 	uint8_t *roof = cur + sd->size; /* may be changed by a length field */
 	bool length_field_found = false;
 	uint8_t *dest = dest_start;
@@ -2589,6 +2634,72 @@ static bool pbs_out_number(struct pbs_out *outs, struct_desc *sd,
 	return true;
 }
 
+static void close_out_struct(struct pbs_out *outs, struct pbs_out *obj,
+			     uint8_t *cur, struct pbs_out *obj_pbs)
+{
+	obj->start = outs->cur;
+	obj->cur = cur;
+	obj->roof = outs->roof; /* limit of possible */
+	/* obj.lenfld* and obj.previous_np* already set */
+
+	if (obj_pbs == NULL) {
+		close_output_pbs(obj); /* fill in length field, if any */
+	} else {
+		/* We set outs->cur to outs->roof so that
+		 * any attempt to output something into outs
+		 * before obj is closed will trigger an error.
+		 */
+		outs->cur = outs->roof;
+
+		*obj_pbs = *obj;
+	}
+}
+
+/*
+ * Emit SD using its hand-unrolled encoder; false (with nothing
+ * threaded into the payload chain) means the interpreter should be
+ * used instead.
+ */
+
+static bool pbs_out_codec(struct pbs_out *outs, struct_desc *sd,
+			  const uint8_t *inp, uint8_t *cur,
+			  struct pbs_out *obj)
+{
+	const struct struct_codec *codec = sd->codec;
+	if (codec == NULL ||
+	    impair.send_nonzero_reserved ||
+	    DBGP(DBG_TMI) ||
+	    !codec->encode(inp, cur)) {
+		return false;
+	}
+
+	if (codec->chain >= 0) {
+		field_desc *fp = &sd->fields[codec->chain];
+		const uint8_t *chain_inp = inp + codec->chain_offset;
+		uint8_t *chain_cur = cur + codec->chain_offset;
+		switch (fp->field_type) {
+		case ft_mnpc:
+			start_next_payload_chain(outs, sd, fp, chain_inp, chain_cur);
+			break;
+		case ft_pnpc:
+			update_next_payload_chain(outs, sd, fp, chain_inp, chain_cur);
+			break;
+		case ft_lss:
+			update_last_substructure(outs, sd, fp, chain_inp, chain_cur);
+			break;
+		default:
+			bad_case(fp->field_type);
+		}
+	}
+
+	if (codec->length >= 0) {
+		obj->lenfld = cur + codec->length_offset;
+		obj->lenfld_desc = &sd->fields[codec->length];
+	}
+
+	return true;
+}
+
 bool pbs_out_struct(struct pbs_out *outs, struct_desc *sd,
 		    const void *struct_ptr, size_t struct_size,
 		    struct pbs_out *obj_pbs)
@@ -2629,6 +2740,11 @@ bool pbs_out_struct(struct pbs_out *outs, struct_desc *sd,
 		/* .last_substructure = {0}, */
 	};
 
+	if (pbs_out_codec(outs, sd, inp, cur, &obj)) {
+		close_out_struct(outs, &obj, cur + sd->size, obj_pbs);
+		return true;
+	}
+
 	for (field_desc *fp = sd->fields; ; fp++) {
 		size_t i = fp->size;
 
@@ -2730,23 +2846,7 @@ bool pbs_out_struct(struct pbs_out *outs, struct_desc *sd,
 
 		case ft_end: /* end of field list */
 			passert(cur == outs->cur + sd->size);
-
-			obj.start = outs->cur;
-			obj.cur = cur;
-			obj.roof = outs->roof; /* limit of possible */
-			/* obj.lenfld* and obj.previous_np* already set */
-
-			if (obj_pbs == NULL) {
-				close_output_pbs(&obj); /* fill in length field, if any */
-			} else {
-				/* We set outs->cur to outs->roof so that
-				 * any attempt to output something into outs
-				 * before obj is closed will trigger an error.
-				 */
-				outs->cur = outs->roof;
-
-				*obj_pbs = obj;
-			}
+			close_out_struct(outs, &obj, cur, obj_pbs);
 			return true;
 
 		default:
@@ -74,12 +74,20 @@ typedef const struct {
 	const void *desc;
 } field_desc;
 
+struct struct_codec;	/* see packet_codec.h */
+
 typedef const struct {
 	const char *name;
 	field_desc *fields;
 	size_t size;
 	int pt;	/* this payload type */
 	unsigned nsst; /* Nested Substructure Type */
+	/*
+	 * When non-NULL, a straight-line equivalent of FIELDS used
+	 * by pbs_in_struct() and pbs_out_struct(); on anything out
+	 * of the ordinary it punts back to the interpreter.
+	 */
+	const struct struct_codec *codec;
 } struct_desc;
 
 /*
@@ -0,0 +1,409 @@
+/* straight-line codecs for the common IKEv2 structures, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Each codec below is the FIELDS table of the struct_desc with the
+ * same name (see packet.c) unrolled by hand.  Any change to one of
+ * those tables must be mirrored here; testing/programs/packetcheck
+ * compares the two against each other.
+ *
+ * The host structures use the wire layout with multi-byte integers
+ * in host order; memcpy() is used so that DEST / SRC need not be
+ * aligned.
+ */
+
+#include <string.h>
+
+#include "lswcdefs.h"		/* for UNUSED */
+#include "lset.h"
+#include "constants.h"		/* for enum_name() and names */
+#include "ietf_constants.h"
+
+#include "packet_codec.h"
+
+static inline unsigned get16(const uint8_t *in)
+{
+	return (in[0] << 8) | in[1];
+}
+
+static inline uint32_t get32(const uint8_t *in)
+{
+	return ((uint32_t)in[0] << 24) | (in[1] << 16) | (in[2] << 8) | in[3];
+}
+
+static inline void put16(uint8_t *out, unsigned n)
+{
+	out[0] = n >> 8;
+	out[1] = n;
+}
+
+static inline void put32(uint8_t *out, uint32_t n)
+{
+	out[0] = n >> 24;
+	out[1] = n >> 16;
+	out[2] = n >> 8;
+	out[3] = n;
+}
+
+static inline void store16(uint8_t *dest, uint16_t n)
+{
+	memcpy(dest, &n, sizeof(n));
+}
+
+static inline void store32(uint8_t *dest, uint32_t n)
+{
+	memcpy(dest, &n, sizeof(n));
+}
+
+static inline uint16_t load16(const uint8_t *src)
+{
+	uint16_t n;
+	memcpy(&n, src, sizeof(n));
+	return n;
+}
+
+static inline uint32_t load32(const uint8_t *src)
+{
+	uint32_t n;
+	memcpy(&n, src, sizeof(n));
+	return n;
+}
+
+static inline bool known_enum(enum_names *names, unsigned long n)
+{
+	return enum_name(names, n) != NULL;
+}
+
+/*
+ * ISAKMP Message header: raw8 raw8 mnpc1 loose_enum1 enum1 lset1
+ * nat4 len4.
+ */
+
+static bool isakmp_hdr_decode(const uint8_t *in, uint8_t *dest, uintmax_t *length)
+{
+	if (!known_enum(&isakmp_xchg_type_names, in[18]) ||
+	    !test_lset(&isakmp_flag_names, in[19])) {
+		return false;
+	}
+	memcpy(dest, in, 2 * IKE_SA_SPI_SIZE + 4);
+	store32(dest + 20, get32(in + 20));
+	*length = get32(in + 24);
+	store32(dest + 24, *length);
+	return true;
+}
+
+static bool isakmp_hdr_encode(const uint8_t *src, uint8_t *out)
+{
+	if (!known_enum(&isakmp_xchg_type_names, src[18]) ||
+	    !test_lset(&isakmp_flag_names, src[19])) {
+		return false;
+	}
+	memcpy(out, src, 2 * IKE_SA_SPI_SIZE + 4);
+	put32(out + 20, load32(src + 20));
+	memset(out + 24, 0xFA, 4);
+	return true;
+}
+
+const struct struct_codec isakmp_hdr_codec = {
+	.decode = isakmp_hdr_decode,
+	.encode = isakmp_hdr_encode,
+	.chain = 2, .chain_offset = 16,
+	.length = 7, .length_offset = 24,
+};
+
+/*
+ * IKEv2 Generic Payload Header: pnpc1 lset1 len2.
+ *
+ * The first four bytes of every payload; the payload specific
+ * codecs below start with the same code.
+ */
+
+static inline bool generic_decode(const uint8_t *in, uint8_t *dest, uintmax_t *length)
+{
+	if (!test_lset(&payload_flag_names, in[1])) {
+		return false;
+	}
+	dest[0] = in[0];
+	dest[1] = in[1];
+	*length = get16(in + 2);
+	store16(dest + 2, *length);
+	return true;
+}
+
+static inline bool generic_encode(const uint8_t *src, uint8_t *out)
+{
+	if (!test_lset(&payload_flag_names, src[1])) {
+		return false;
+	}
+	out[0] = src[0];
+	out[1] = src[1];
+	out[2] = out[3] = 0xFA;
+	return true;
+}
+
+static bool ikev2_generic_decode(const uint8_t *in, uint8_t *dest, uintmax_t *length)
+{
+	return generic_decode(in, dest, length);
+}
+
+static bool ikev2_generic_encode(const uint8_t *src, uint8_t *out)
+{
+	return generic_encode(src, out);
+}
+
+const struct struct_codec ikev2_generic_codec = {
+	.decode = ikev2_generic_decode,
+	.encode = ikev2_generic_encode,
+	.chain = 0, .chain_offset = 0,
+	.length = 2, .length_offset = 2,
+};
+
+/*
+ * IKEv2 Proposal Substructure: lss1 zig1 len2 nat1 enum1 nat1 nat1.
+ */
+
+static bool ikev2_prop_decode(const uint8_t *in, uint8_t *dest, uintmax_t *length)
+{
+	if (in[1] != 0 ||
+	    !known_enum(&ikev2_proposal_protocol_id_names, in[5])) {
+		return false;
+	}
+	dest[0] = in[0];
+	dest[1] = 0;
+	*length = get16(in + 2);
+	store16(dest + 2, *length);
+	memcpy(dest + 4, in + 4, 4);
+	return true;
+}
+
+static bool ikev2_prop_encode(const uint8_t *src, uint8_t *out)
+{
+	if (!known_enum(&ikev2_proposal_protocol_id_names, src[5])) {
+		return false;
+	}
+	out[0] = src[0];
+	out[1] = 0;
+	out[2] = out[3] = 0xFA;
+	memcpy(out + 4, src + 4, 4);
+	return true;
+}
+
+const struct struct_codec ikev2_prop_codec = {
+	.decode = ikev2_prop_decode,
+	.encode = ikev2_prop_encode,
+	.chain = 0, .chain_offset = 0,
+	.length = 2, .length_offset = 2,
+};
+
+/*
+ * IKEv2 Transform Substructure: lss1 zig1 len2 loose_enum1 zig1
+ * loose_enum_enum2.
+ */
+
+static bool ikev2_trans_decode(const uint8_t *in, uint8_t *dest, uintmax_t *length)
+{
+	if (in[1] != 0 || in[5] != 0) {
+		return false;
+	}
+	dest[0] = in[0];
+	dest[1] = 0;
+	*length = get16(in + 2);
+	store16(dest + 2, *length);
+	dest[4] = in[4];
+	dest[5] = 0;
+	store16(dest + 6, get16(in + 6));
+	return true;
+}
+
+static bool ikev2_trans_encode(const uint8_t *src, uint8_t *out)
+{
+	out[0] = src[0];
+	out[1] = 0;
+	out[2] = out[3] = 0xFA;
+	out[4] = src[4];
+	out[5] = 0;
+	put16(out + 6, load16(src + 6));
+	return true;
+}
+
+const struct struct_codec ikev2_trans_codec = {
+	.decode = ikev2_trans_decode,
+	.encode = ikev2_trans_encode,
+	.chain = 0, .chain_offset = 0,
+	.length = 2, .length_offset = 2,
+};
+
+/*
+ * IKEv2 Key Exchange Payload: pnpc1 lset1 len2 enum2 zig2.
+ */
+
+static bool ikev2_ke_decode(const uint8_t *in, uint8_t *dest, uintmax_t *length)
+{
+	unsigned group = get16(in + 4);
+	if (in[6] != 0 || in[7] != 0 ||
+	    !known_enum(&oakley_group_names, group) ||
+	    !generic_decode(in, dest, length)) {
+		return false;
+	}
+	store16(dest + 4, group);
+	store16(dest + 6, 0);
+	return true;
+}
+
+static bool ikev2_ke_encode(const uint8_t *src, uint8_t *out)
+{
+	unsigned group = load16(src + 4);
+	if (!known_enum(&oakley_group_names, group) ||
+	    !generic_encode(src, out)) {
+		return false;
+	}
+	put16(out + 4, group);
+	put16(out + 6, 0);
+	return true;
+}
+
+const struct struct_codec ikev2_ke_codec = {
+	.decode = ikev2_ke_decode,
+	.encode = ikev2_ke_encode,
+	.chain = 0, .chain_offset = 0,
+	.length = 2, .length_offset = 2,
+};
+
+/*
+ * IKEv2 Notify Payload: pnpc1 lset1 len2 enum1 nat1 loose_enum2.
+ */
+
+static bool ikev2_notify_decode(const uint8_t *in, uint8_t *dest, uintmax_t *length)
+{
+	if (!known_enum(&ikev2_notify_protocol_id_names, in[4]) ||
+	    !generic_decode(in, dest, length)) {
+		return false;
+	}
+	dest[4] = in[4];
+	dest[5] = in[5];
+	store16(dest + 6, get16(in + 6));
+	return true;
+}
+
+static bool ikev2_notify_encode(const uint8_t *src, uint8_t *out)
+{
+	if (!known_enum(&ikev2_notify_protocol_id_names, src[4]) ||
+	    !generic_encode(src, out)) {
+		return false;
+	}
+	out[4] = src[4];
+	out[5] = src[5];
+	put16(out + 6, load16(src + 6));
+	return true;
+}
+
+const struct struct_codec ikev2_notify_codec = {
+	.decode = ikev2_notify_decode,
+	.encode = ikev2_notify_encode,
+	.chain = 0, .chain_offset = 0,
+	.length = 2, .length_offset = 2,
+};
+
+/*
+ * IKEv2 Traffic Selector Payload: pnpc1 lset1 len2 nat1 zig3.
+ */
+
+static bool ikev2_ts_decode(const uint8_t *in, uint8_t *dest, uintmax_t *length)
+{
+	if (in[5] != 0 || in[6] != 0 || in[7] != 0 ||
+	    !generic_decode(in, dest, length)) {
+		return false;
+	}
+	dest[4] = in[4];
+	memset(dest + 5, 0, 3);
+	return true;
+}
+
+static bool ikev2_ts_encode(const uint8_t *src, uint8_t *out)
+{
+	if (!generic_encode(src, out)) {
+		return false;
+	}
+	out[4] = src[4];
+	memset(out + 5, 0, 3);
+	return true;
+}
+
+const struct struct_codec ikev2_ts_codec = {
+	.decode = ikev2_ts_decode,
+	.encode = ikev2_ts_encode,
+	.chain = 0, .chain_offset = 0,
+	.length = 2, .length_offset = 2,
+};
+
+/*
+ * IKEv2 Traffic Selector Header: enum1 loose_enum1 len2.
+ */
+
+static bool ikev2_ts_header_decode(const uint8_t *in, uint8_t *dest, uintmax_t *length)
+{
+	if (!known_enum(&ikev2_ts_type_names, in[0])) {
+		return false;
+	}
+	dest[0] = in[0];
+	dest[1] = in[1];
+	*length = get16(in + 2);
+	store16(dest + 2, *length);
+	return true;
+}
+
+static bool ikev2_ts_header_encode(const uint8_t *src, uint8_t *out)
+{
+	if (!known_enum(&ikev2_ts_type_names, src[0])) {
+		return false;
+	}
+	out[0] = src[0];
+	out[1] = src[1];
+	out[2] = out[3] = 0xFA;
+	return true;
+}
+
+const struct struct_codec ikev2_ts_header_codec = {
+	.decode = ikev2_ts_header_decode,
+	.encode = ikev2_ts_header_encode,
+	.chain = -1,
+	.length = 2, .length_offset = 2,
+};
+
+/*
+ * IKEv2 Traffic Selector port range: nat2 nat2.
+ */
+
+static bool ikev2_ts_portrange_decode(const uint8_t *in, uint8_t *dest,
+				      uintmax_t *length UNUSED)
+{
+	store16(dest + 0, get16(in + 0));
+	store16(dest + 2, get16(in + 2));
+	return true;
+}
+
+static bool ikev2_ts_portrange_encode(const uint8_t *src, uint8_t *out)
+{
+	put16(out + 0, load16(src + 0));
+	put16(out + 2, load16(src + 2));
+	return true;
+}
+
+const struct struct_codec ikev2_ts_portrange_codec = {
+	.decode = ikev2_ts_portrange_decode,
+	.encode = ikev2_ts_portrange_encode,
+	.chain = -1,
+	.length = -1,
+};
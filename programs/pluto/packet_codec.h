@@ -0,0 +1,62 @@
+/* straight-line codecs for the common IKEv2 structures, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef PACKET_CODEC_H
+#define PACKET_CODEC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * A hand specialized version of a struct_desc's FIELDS table.
+ *
+ * Both DECODE and ENCODE are all-or-nothing: they return false,
+ * having possibly scribbled on DEST or OUT, when any field holds a
+ * value the interpreter would reject or comment on (unknown enum,
+ * unknown flag bit, non-zero reserved byte).  The caller then runs
+ * the interpreter which re-does the work and reports the problem.
+ *
+ * DECODE converts the wire image at IN into the host structure at
+ * DEST and, when there is a length field, stores its value in
+ * LENGTH.  ENCODE converts the host structure at SRC into the wire
+ * image at OUT; the length field is filled with 0xFA and the
+ * payload-chain field is copied verbatim, the same as the
+ * interpreter, leaving the caller to thread the chain.
+ *
+ * CHAIN and LENGTH are the indexes into the FIELDS table of the
+ * ft_mnpc/ft_pnpc/ft_lss and ft_len fields (or -1); the *_OFFSET is
+ * where each starts.
+ */
+
+struct struct_codec {
+	bool (*decode)(const uint8_t *in, uint8_t *dest, uintmax_t *length);
+	bool (*encode)(const uint8_t *src, uint8_t *out);
+	int chain;
+	unsigned chain_offset;
+	int length;
+	unsigned length_offset;
+};
+
+extern const struct struct_codec isakmp_hdr_codec;
+extern const struct struct_codec ikev2_generic_codec;
+extern const struct struct_codec ikev2_prop_codec;
+extern const struct struct_codec ikev2_trans_codec;
+extern const struct struct_codec ikev2_ke_codec;
+extern const struct struct_codec ikev2_notify_codec;
+extern const struct struct_codec ikev2_ts_codec;
+extern const struct struct_codec ikev2_ts_header_codec;
+extern const struct struct_codec ikev2_ts_portrange_codec;
+
+#endif
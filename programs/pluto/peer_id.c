@@ -44,6 +44,7 @@
 #include "keys.h"
 #include "nss_cert_verify.h"
 #include "pluto_x509.h"
+#include "pluto_stats.h"
 
 /*
  * This is to support certificates with SAN using wildcard, eg SAN
@@ -177,6 +178,7 @@ static struct connection *refine_host_connection_on_responder(int indent,
 	struct connection *c = st->st_connection;
 
 	indent = 1;
+	pstats_refine_calls++;
 
 	const generalName_t *requested_ca = st->st_v1_requested_ca;
 
@@ -190,7 +192,13 @@ static struct connection *refine_host_connection_on_responder(int indent,
 	asn1_t peer_ca = get_peer_ca(&st->st_remote_certs.pubkey_db, peer_id);
 
 	if (hunk_isempty(peer_ca)) {
-		peer_ca = get_peer_ca(&pluto_pubkeys, peer_id);
+		struct preloaded_pubkey_filter pkf = {
+			.id = peer_id,
+			.type = &pubkey_type_rsa,
+		};
+		if (next_preloaded_pubkey(&pkf)) {
+			peer_ca = pkf.key->issuer;
+		}
 	}
 
 	/*
@@ -231,7 +239,16 @@ static struct connection *refine_host_connection_on_responder(int indent,
 		dbg_rhc("trying connections matching %s->%s",
 			str_address(&local, &lb), str_address(&remote, &rb));
 
-		FOR_EACH_HOST_PAIR_CONNECTION(local, remote, d) {
+		/* only connections whose remote ID could match */
+		struct connection **candidates;
+		unsigned skipped;
+		unsigned nr_candidates =
+			host_pair_remote_id_candidates(local, remote, peer_id,
+						       &candidates, &skipped);
+		pstats_refine_candidates += nr_candidates;
+		pstats_refine_skipped += skipped;
+		for (unsigned i = 0; i < nr_candidates; i++) {
+			struct connection *d = candidates[i];
 
 			connection_buf b1, b2;
 			indent = 2;
@@ -525,6 +542,7 @@ static struct connection *refine_host_connection_on_responder(int indent,
 				connection_buf dcb;
 				dbg_rhc("returning "PRI_CONNECTION" because exact peer id match",
 					pri_connection(d, &dcb));
+				pfreeany(candidates);
 				return d;
 			}
 
@@ -551,6 +569,7 @@ static struct connection *refine_host_connection_on_responder(int indent,
 				best_our_pathlen = our_pathlen;
 			}
 		}
+		pfreeany(candidates);
 	}
 	return best_found;
 }
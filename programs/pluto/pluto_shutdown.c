@@ -34,6 +34,7 @@
 #include "lswconf.h"		/* for lsw_conf_free_oco() */
 #include "lswnss.h"		/* for lsw_nss_shutdown() */
 #include "lswalloc.h"		/* for report_leaks() et.al. */
+#include "arena.h"		/* for free_arena_cache() */
 
 #include "defs.h"		/* for so_serial_t */
 #include "pluto_shutdown.h"
@@ -42,6 +43,8 @@
 #include "server_pool.h"	/* for stop_crypto_helpers() */
 #include "pluto_sd.h"		/* for pluto_sd() */
 #include "root_certs.h"		/* for free_root_certs() */
+#include "nss_cert_verify.h"	/* for flush_verified_certs_cache() */
+#include "pluto_x509.h"		/* for flush_trusted_ca_cache() */
 #include "keys.h"		/* for free_preshared_secrets() */
 #include "connections.h"	/* for delete_every_connection() */
 #include "fetch.h"		/* for stop_crl_fetch_helper() et.al. */
@@ -58,6 +61,8 @@
 #include "impair_message.h"	/* for free_impair_message() */
 #include "state_db.h"		/* for check_state_db() */
 #include "connection_db.h"	/* for check_{connection,spd}_db() */
+#include "addresspool.h"		/* for save_addresspool_snapshot() */
+#include "ikev2_ticket.h"		/* for save_v2_tickets() */
 
 volatile bool exiting_pluto = false;
 static enum pluto_exit_code pluto_exit_code;
@@ -120,16 +125,28 @@ void exit_epilogue(void)
 	check_state_db(logger);
 	check_connection_db(logger);
 	check_spd_route_db(logger);
+	check_preloaded_pubkey_db(logger);
+
+	/*
+	 * Save reusable leases while the connections, and their
+	 * address pools, still exist.
+	 */
+	save_addresspool_snapshot(logger);
+	save_v2_tickets(logger);
 
 	/*
 	 * This should wipe pretty much everything: states, revivals,
 	 * ...
 	 */
 	delete_every_connection();
+	free_addresspool_snapshot();
+	free_v2_tickets();
 
 	free_server_helper_jobs(logger);
 
 	free_root_certs(logger);
+	flush_verified_certs_cache("shutting down");
+	flush_trusted_ca_cache("shutting down");
 	free_preshared_secrets(logger);
 	free_remembered_public_keys();
 	/*
@@ -175,6 +192,7 @@ void exit_epilogue(void)
 	free_virtual_ip();	/* virtual_private= */
 	free_pluto_main();	/* our static chars */
 	free_impair_message(logger);
+	free_arena_cache();	/* this thread's; helpers empty theirs on exit */
 
 	/* report memory leaks now, after all free_* calls */
 	if (leak_detective) {
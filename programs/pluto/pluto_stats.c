@@ -49,6 +49,20 @@ unsigned long pstats_ikev1_completed;
 unsigned long pstats_ikev2_completed;
 unsigned long pstats_ikev2_redirect_failed;
 unsigned long pstats_ikev2_redirect_completed;
+
+unsigned long pstats_refine_calls;
+unsigned long pstats_refine_candidates;
+unsigned long pstats_refine_skipped;
+
+unsigned long pstats_v1_client_calls;
+unsigned long pstats_v1_client_candidates;
+unsigned long pstats_v1_client_skipped;
+unsigned long pstats_v1_virtual_net_calls;
+unsigned long pstats_v1_virtual_net_candidates;
+
+unsigned long pstats_ikev2_resume_issued;
+unsigned long pstats_ikev2_resume_accepted;
+unsigned long pstats_ikev2_resume_rejected;
 unsigned long pstats_ikev1_encr[OAKLEY_ENCR_PSTATS_ROOF];
 unsigned long pstats_ikev2_encr[IKEv2_ENCR_PSTATS_ROOF];
 unsigned long pstats_ikev1_integ[OAKLEY_HASH_PSTATS_ROOF];
@@ -69,8 +83,12 @@ uint64_t pstats_ipsec_in_bytes;	/* total incoming IPsec traffic */
 uint64_t pstats_ipsec_out_bytes;	/* total outgoing IPsec traffic */
 unsigned long pstats_ike_in_bytes;	/* total incoming IPsec traffic */
 unsigned long pstats_ike_out_bytes;	/* total outgoing IPsec traffic */
+unsigned long pstats_ike_out_packets;
+unsigned long pstats_ike_out_syscalls;
+unsigned long pstats_ike_out_batched;
 unsigned long pstats_ikev1_sent_notifies_e[v1N_ERROR_PSTATS_ROOF]; /* types of NOTIFY ERRORS */
 unsigned long pstats_ikev1_recv_notifies_e[v1N_ERROR_PSTATS_ROOF]; /* types of NOTIFY ERRORS */
+unsigned long pstats_ikev1_recent_duplicates;
 unsigned long pstats_ipsec_esp;
 unsigned long pstats_ipsec_ah;
 unsigned long pstats_ipsec_ipcomp;
@@ -84,6 +102,9 @@ unsigned long pstats_ike_dpd_replied;
 unsigned long pstats_iketcp_started[2];
 unsigned long pstats_iketcp_stopped[2];
 unsigned long pstats_iketcp_aborted[2];
+unsigned long pstats_iketcp_queued[2];
+unsigned long pstats_iketcp_dropped[2];
+unsigned long pstats_iketcp_paused[2];
 unsigned long pstats_pamauth_started;
 unsigned long pstats_pamauth_stopped;
 unsigned long pstats_pamauth_aborted;
@@ -411,9 +432,21 @@ void show_pluto_stats(struct show *s)
 	show_raw(s, "total.ike.ikev2.completed=%lu", pstats_ikev2_completed);
 	show_raw(s, "total.ike.ikev2.redirect.completed=%lu", pstats_ikev2_redirect_completed);
 	show_raw(s, "total.ike.ikev2.redirect.failed=%lu", pstats_ikev2_redirect_failed);
+	show_raw(s, "total.ike.refine.calls=%lu", pstats_refine_calls);
+	show_raw(s, "total.ike.refine.candidates=%lu", pstats_refine_candidates);
+	show_raw(s, "total.ike.refine.skipped=%lu", pstats_refine_skipped);
+	show_raw(s, "total.ike.ikev1.client.calls=%lu", pstats_v1_client_calls);
+	show_raw(s, "total.ike.ikev1.client.candidates=%lu", pstats_v1_client_candidates);
+	show_raw(s, "total.ike.ikev1.client.skipped=%lu", pstats_v1_client_skipped);
+	show_raw(s, "total.ike.ikev1.virtual_net.calls=%lu", pstats_v1_virtual_net_calls);
+	show_raw(s, "total.ike.ikev1.virtual_net.candidates=%lu", pstats_v1_virtual_net_candidates);
+	show_raw(s, "total.ike.ikev2.resume.issued=%lu", pstats_ikev2_resume_issued);
+	show_raw(s, "total.ike.ikev2.resume.accepted=%lu", pstats_ikev2_resume_accepted);
+	show_raw(s, "total.ike.ikev2.resume.rejected=%lu", pstats_ikev2_resume_rejected);
 	show_raw(s, "total.ike.ikev1.established=%lu", pstats_ikev1_sa);
 	show_raw(s, "total.ike.ikev1.failed=%lu", pstats_ikev1_fail);
 	show_raw(s, "total.ike.ikev1.completed=%lu", pstats_ikev1_completed);
+	show_raw(s, "total.ike.ikev1.duplicates.recent=%lu", pstats_ikev1_recent_duplicates);
 
 	/* new */
 	for (enum ike_version v = IKE_VERSION_FLOOR; v < IKE_VERSION_ROOF; v++) {
@@ -445,6 +478,9 @@ void show_pluto_stats(struct show *s)
 	show_raw(s, "total.ike.dpd.replied=%lu", pstats_ike_dpd_replied);
 	show_raw(s, "total.ike.traffic.in=%lu", pstats_ike_in_bytes);
 	show_raw(s, "total.ike.traffic.out=%lu", pstats_ike_out_bytes);
+	show_raw(s, "total.ike.out.packets=%lu", pstats_ike_out_packets);
+	show_raw(s, "total.ike.out.syscalls=%lu", pstats_ike_out_syscalls);
+	show_raw(s, "total.ike.out.batched=%lu", pstats_ike_out_batched);
 
 	show_raw(s, "total.pamauth.started=%lu", pstats_pamauth_started);
 	show_raw(s, "total.pamauth.stopped=%lu", pstats_pamauth_stopped);
@@ -453,9 +489,15 @@ void show_pluto_stats(struct show *s)
 	show_raw(s, "total.iketcp.client.started=%lu", pstats_iketcp_started[false]);
 	show_raw(s, "total.iketcp.client.stopped=%lu", pstats_iketcp_stopped[false]);
 	show_raw(s, "total.iketcp.client.aborted=%lu", pstats_iketcp_aborted[false]);
+	show_raw(s, "total.iketcp.client.queued=%lu", pstats_iketcp_queued[false]);
+	show_raw(s, "total.iketcp.client.dropped=%lu", pstats_iketcp_dropped[false]);
+	show_raw(s, "total.iketcp.client.paused=%lu", pstats_iketcp_paused[false]);
 	show_raw(s, "total.iketcp.server.started=%lu", pstats_iketcp_started[true]);
 	show_raw(s, "total.iketcp.server.stopped=%lu", pstats_iketcp_stopped[true]);
 	show_raw(s, "total.iketcp.server.aborted=%lu", pstats_iketcp_aborted[true]);
+	show_raw(s, "total.iketcp.server.queued=%lu", pstats_iketcp_queued[true]);
+	show_raw(s, "total.iketcp.server.dropped=%lu", pstats_iketcp_dropped[true]);
+	show_raw(s, "total.iketcp.server.paused=%lu", pstats_iketcp_paused[true]);
 
 	ENUM_STATS(&oakley_enc_names, OAKLEY_3DES_CBC, "ikev1.encr", pstats_ikev1_encr);
 	ENUM_STATS(&oakley_hash_names, OAKLEY_MD5, "ikev1.integ", pstats_ikev1_integ);
@@ -492,7 +534,12 @@ void clear_pluto_stats(void)
 	pstats_ipsec_sa = pstats_ikev1_sa = pstats_ikev2_sa = 0;
 	pstats_ikev1_fail = pstats_ikev2_fail = 0;
 	pstats_ikev1_completed = pstats_ikev2_completed = 0;
+	pstats_ikev1_recent_duplicates = 0;
 	pstats_ikev2_redirect_failed = pstats_ikev2_redirect_completed=0;
+	pstats_refine_calls = pstats_refine_candidates = pstats_refine_skipped = 0;
+	pstats_v1_client_calls = pstats_v1_client_candidates = pstats_v1_client_skipped = 0;
+	pstats_v1_virtual_net_calls = pstats_v1_virtual_net_candidates = 0;
+	pstats_ikev2_resume_issued = pstats_ikev2_resume_accepted = pstats_ikev2_resume_rejected = 0;
 
 	memset(pstats_sa_started, 0, sizeof pstats_sa_started);
 	memset(pstats_sa_finished, 0, sizeof pstats_sa_finished);
@@ -500,6 +547,7 @@ void clear_pluto_stats(void)
 
 	pstats_ipsec_in_bytes = pstats_ipsec_out_bytes = 0;
 	pstats_ike_in_bytes = pstats_ike_out_bytes = 0;
+	pstats_ike_out_packets = pstats_ike_out_syscalls = pstats_ike_out_batched = 0;
 	pstats_ipsec_esp = pstats_ipsec_ah = pstats_ipsec_ipcomp = 0;
 	pstats_ipsec_encap_yes = pstats_ipsec_encap_no = 0;
 	pstats_ipsec_esn = pstats_ipsec_tfc = 0;
@@ -509,6 +557,9 @@ void clear_pluto_stats(void)
 	memset(pstats_iketcp_started, 0, sizeof(pstats_iketcp_started));
 	memset(pstats_iketcp_stopped, 0, sizeof(pstats_iketcp_stopped));
 	memset(pstats_iketcp_aborted, 0, sizeof(pstats_iketcp_aborted));
+	memset(pstats_iketcp_queued, 0, sizeof(pstats_iketcp_queued));
+	memset(pstats_iketcp_dropped, 0, sizeof(pstats_iketcp_dropped));
+	memset(pstats_iketcp_paused, 0, sizeof(pstats_iketcp_paused));
 
 	memset(pstats_ikev1_encr, 0, sizeof pstats_ikev1_encr);
 	memset(pstats_ikev2_encr, 0, sizeof pstats_ikev2_encr);
@@ -40,8 +40,12 @@ extern uint64_t pstats_ipsec_in_bytes;	/* total incoming IPsec traffic */
 extern uint64_t pstats_ipsec_out_bytes;	/* total outgoing IPsec traffic */
 extern unsigned long pstats_ike_in_bytes;	/* total incoming IPsec traffic */
 extern unsigned long pstats_ike_out_bytes;	/* total outgoing IPsec traffic */
+extern unsigned long pstats_ike_out_packets;	/* IKE packets sent */
+extern unsigned long pstats_ike_out_syscalls;	/* system calls used to send them */
+extern unsigned long pstats_ike_out_batched;	/* packets sent using sendmmsg() */
 extern unsigned long pstats_ikev1_sent_notifies_e[v1N_ERROR_PSTATS_ROOF]; /* types of NOTIFY ERRORS */
 extern unsigned long pstats_ikev1_recv_notifies_e[v1N_ERROR_PSTATS_ROOF]; /* types of NOTIFY ERRORS */
+extern unsigned long pstats_ikev1_recent_duplicates;	/* answered before state lookup */
 extern const struct pluto_stat pstats_ikev2_sent_notifies_e; /* types of NOTIFY ERRORS */
 extern const struct pluto_stat pstats_ikev2_recv_notifies_e; /* types of NOTIFY ERRORS */
 extern const struct pluto_stat pstats_ikev2_sent_notifies_s; /* types of NOTIFY STATUS */
@@ -54,6 +58,9 @@ extern unsigned long pstats_ike_dpd_replied;
 extern unsigned long pstats_iketcp_started[2];
 extern unsigned long pstats_iketcp_aborted[2];
 extern unsigned long pstats_iketcp_stopped[2];
+extern unsigned long pstats_iketcp_queued[2];	/* writes that had to wait */
+extern unsigned long pstats_iketcp_dropped[2];	/* output queue full */
+extern unsigned long pstats_iketcp_paused[2];	/* reads held back */
 
 extern unsigned long pstats_pamauth_started;
 extern unsigned long pstats_pamauth_stopped;
@@ -62,6 +69,23 @@ extern unsigned long pstats_pamauth_aborted;
 extern unsigned long pstats_ikev2_redirect_failed;
 extern unsigned long pstats_ikev2_redirect_completed;
 
+/* refine_host_connection_on_responder() */
+extern unsigned long pstats_refine_calls;
+extern unsigned long pstats_refine_candidates;	/* connections examined */
+extern unsigned long pstats_refine_skipped;	/* ruled out by remote ID index */
+
+/* IKEv1 Quick Mode: find_v1_client_connection(), is_virtual_net_used() */
+extern unsigned long pstats_v1_client_calls;
+extern unsigned long pstats_v1_client_candidates;	/* connections examined */
+extern unsigned long pstats_v1_client_skipped;	/* ruled out by remote ID index */
+extern unsigned long pstats_v1_virtual_net_calls;
+extern unsigned long pstats_v1_virtual_net_candidates;	/* connections examined */
+
+/* IKEv2 session resumption (RFC 5723) */
+extern unsigned long pstats_ikev2_resume_issued;	/* tickets sent */
+extern unsigned long pstats_ikev2_resume_accepted;
+extern unsigned long pstats_ikev2_resume_rejected;	/* TICKET_NACK sent */
+
 extern void show_pluto_stats(struct show *s);
 extern void clear_pluto_stats(void);
 
@@ -49,6 +49,12 @@ extern void load_authcerts(const char *type, const char *path,
 extern bool match_requested_ca(const generalName_t *requested_ca,
 			       chunk_t our_ca, int *our_pathlen);
 
+/*
+ * Forget the remembered trusted_ca() results; for instance, because
+ * the NSS DB was reloaded.
+ */
+void flush_trusted_ca_cache(const char *reason);
+
 extern int get_auth_chain(chunk_t *out_chain, int chain_max,
 			  const struct cert *end_cert, bool full_chain);
 extern void free_auth_chain(chunk_t *chain, int chain_len);
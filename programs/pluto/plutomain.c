@@ -62,6 +62,8 @@
 #include "vendorid.h"
 #include "enum_names.h"
 #include "virtual_ip.h"
+#include "addresspool.h"		/* for init_addresspool_snapshot() */
+#include "ikev2_resume.h"		/* for init_v2_resumption() */
 #include "state_db.h"		/* for init_state_db() */
 #include "revival.h"		/* for init_revival_timer() */
 #include "connection_db.h"	/* for init_connection_db() */
@@ -69,7 +71,7 @@
 #include "ike_alg.h"
 #include "ikev2_redirect.h"
 #include "root_certs.h"		/* for init_root_certs() */
-#include "host_pair.h"		/* for init_host_pair_db() */
+#include "host_pair.h"		/* for init_host_pair_db() init_host_pair_timer() */
 #include "ikev1.h"		/* for init_ikev1() */
 #include "ikev2.h"		/* for init_ikev2() */
 #include "crypt_symkey.h"	/* for init_crypt_symkey() */
@@ -143,6 +145,11 @@ static bool pluto_lock_created = false;
 /* Overridden by virtual_private= in ipsec.conf */
 static char *virtual_private = NULL;
 
+static char *lease_snapshot = NULL;
+
+static bool session_resumption = false;
+static char *session_resumption_snapshot = NULL;
+
 void free_pluto_main(void)
 {
 	/* Some values can be NULL if not specified as pluto argument */
@@ -161,6 +168,8 @@ void free_pluto_main(void)
 	pfreeany(rundir);
 	free_global_redirect_dests();
 	pfreeany(virtual_private);
+	pfreeany(lease_snapshot);
+	pfreeany(session_resumption_snapshot);
 }
 
 /* string naming compile-time options that have interop implications */
@@ -481,6 +490,10 @@ enum {
 	OPT_IMPAIR,
 	OPT_DNSSEC_ROOTKEY_FILE,
 	OPT_DNSSEC_TRUSTED,
+	OPT_LOG_ASYNC,
+	OPT_LEASE_SNAPSHOT,
+	OPT_SESSION_RESUMPTION,
+	OPT_SESSION_RESUMPTION_SNAPSHOT,
 };
 
 static const struct option long_opts[] = {
@@ -501,6 +514,7 @@ static const struct option long_opts[] = {
 	{ "log-no-append\0", no_argument, NULL, '7' },
 	{ "log-no-ip\0", no_argument, NULL, '<' },
 	{ "log-no-audit\0", no_argument, NULL, 'a' },
+	{ "log-async\0", no_argument, NULL, OPT_LOG_ASYNC },
 	{ "force-busy\0", no_argument, NULL, 'D' },
 	{ "force-unlimited\0", no_argument, NULL, 'U' },
 	{ "crl-strict\0", no_argument, NULL, 'r' },
@@ -543,6 +557,9 @@ static const struct option long_opts[] = {
 	{ "nssdir\0<path>", required_argument, NULL, 'd' },	/* nss-tools use -d */
 	{ "keep-alive\0<delay_secs>", required_argument, NULL, '2' },
 	{ "virtual-private\0<network_list>", required_argument, NULL, '6' },
+	{ "lease-snapshot\0<filename>", required_argument, NULL, OPT_LEASE_SNAPSHOT },
+	{ "session-resumption\0", no_argument, NULL, OPT_SESSION_RESUMPTION },
+	{ "session-resumption-snapshot\0<filename>", required_argument, NULL, OPT_SESSION_RESUMPTION_SNAPSHOT },
 	{ "nhelpers\0<number>", required_argument, NULL, 'j' },
 	{ "expire-shunt-interval\0<secs>", required_argument, NULL, '9' },
 	{ "seedbits\0<number>", required_argument, NULL, 'c' },
@@ -920,6 +937,10 @@ int main(int argc, char **argv)
 			log_to_audit = false;
 			continue;
 
+		case OPT_LOG_ASYNC:	/* --log-async */
+			log_param.log_async = true;
+			continue;
+
 		case '8':	/* --drop-oppo-null */
 			pluto_drop_oppo_null = true;
 			continue;
@@ -1198,6 +1219,18 @@ int main(int argc, char **argv)
 			replace_value(&virtual_private, optarg);
 			continue;
 
+		case OPT_LEASE_SNAPSHOT:	/* --lease-snapshot */
+			replace_value(&lease_snapshot, optarg);
+			continue;
+
+		case OPT_SESSION_RESUMPTION:	/* --session-resumption */
+			session_resumption = true;
+			continue;
+
+		case OPT_SESSION_RESUMPTION_SNAPSHOT:	/* --session-resumption-snapshot */
+			replace_value(&session_resumption_snapshot, optarg);
+			continue;
+
 		case 'z':	/* --config */
 		{
 			/*
@@ -1360,6 +1393,7 @@ int main(int argc, char **argv)
 			keep_alive = deltatime(cfg->setup.options[KBF_KEEPALIVE]);
 
 			replace_when_cfg_setup(&virtual_private, cfg, KSF_VIRTUALPRIVATE);
+			replace_when_cfg_setup(&lease_snapshot, cfg, KSF_LEASE_SNAPSHOT);
 
 			set_global_redirect_dests(cfg->setup.strings[KSF_GLOBAL_REDIRECT_TO]);
 
@@ -1615,6 +1649,7 @@ int main(int argc, char **argv)
 	init_connection_db(logger);
 	init_spd_route_db(logger);
 	init_host_pair_db(logger);
+	init_preloaded_pubkey_db(logger);
 
 	pluto_init_nss(oco->nssdir, logger);
 	if (libreswan_fipsmode()) {
@@ -1773,10 +1808,12 @@ int main(int argc, char **argv)
 	init_log_limiter();
 	init_nat_traversal_timer(keep_alive, logger);
 	init_revival_timer();
+	init_host_pair_timer();
 	init_connections_timer();
 	init_pending();
 
 	init_virtual_ip(virtual_private, logger);
+	init_addresspool_snapshot(lease_snapshot, logger);
 
 	/* require NSS */
 	init_root_certs();
@@ -1803,6 +1840,8 @@ int main(int argc, char **argv)
 	start_crl_fetch_helper(logger);
 #endif
 	init_labeled_ipsec(logger);
+	/* after init_ike_alg() */
+	init_v2_resumption(session_resumption, session_resumption_snapshot, logger);
 #ifdef USE_SYSTEMD_WATCHDOG
 	pluto_sd_init(logger);
 #endif
@@ -1837,6 +1876,13 @@ void show_setup_plutomain(struct show *s)
 		coredir,
 		pluto_stats_binary == NULL ? "unset" :  pluto_stats_binary);
 
+	show_comment(s, "lease-snapshot=%s",
+		lease_snapshot == NULL ? "<unset>" : lease_snapshot);
+
+	show_comment(s, "session-resumption=%s, session-resumption-snapshot=%s",
+		     bool_str(session_resumption || session_resumption_snapshot != NULL),
+		     session_resumption_snapshot == NULL ? "<unset>" : session_resumption_snapshot);
+
 #ifdef USE_DNSSEC
 	show_comment(s, "dnssec-rootkey-file=%s, dnssec-trusted=%s",
 		     pluto_dnssec_rootkey_file == NULL ? "<unset>" : pluto_dnssec_rootkey_file,
@@ -1857,6 +1903,7 @@ void show_setup_plutomain(struct show *s)
 		jam(buf, ", uniqueids=%s", bool_str(uniqueIDs));
 		jam(buf, ", dnssec-enable=%s", bool_str(do_dnssec));
 		jam(buf, ", logappend=%s", bool_str(log_append));
+		jam(buf, ", logasync=%s", bool_str(log_is_async()));
 		jam(buf, ", logip=%s", bool_str(log_ip));
 		jam(buf, ", shuntlifetime=%jds", deltasecs(pluto_shunt_lifetime));
 #ifdef XFRM_LIFETIME_DEFAULT
@@ -335,7 +335,7 @@ static void key_add_request(const struct whack_message *msg, struct logger *logg
 			llog(LOG_STREAM/*not-whack*/, logger,
 			     "delete keyid %s", msg->keyid);
 		}
-		delete_public_keys(&pluto_pubkeys, &keyid, type);
+		delete_preloaded_pubkeys(&keyid, type);
 		/* XXX: what about private keys; suspect not easy as not 1:1? */
 	}
 
@@ -364,13 +364,13 @@ static void key_add_request(const struct whack_message *msg, struct logger *logg
 					       /*until_time*/realtime_epoch,
 					       /*ttl*/0,
 					       HUNK_AS_SHUNK(msg->keyval),
-					       &pubkey/*new-public-key:must-delref*/,
-					       &pluto_pubkeys);
+					       &pubkey/*new-public-key:must-delref*/);
 		if (d != NULL) {
 			llog_diag(RC_LOG_SERIOUS, logger, &d, "%s", "");
 			free_id_content(&keyid);
 			return;
 		}
+		add_preloaded_pubkey(pubkey);
 
 		/* try to pre-load the private key */
 		bool load_needed;
@@ -770,6 +770,7 @@ static void whack_process(const struct whack_message *const m, struct show *s)
 		list_crls(s);
 #if defined(LIBCURL) || defined(LIBLDAP)
 		list_crl_fetch_requests(s, m->whack_utc);
+		list_crl_fetch_stats(s, m->whack_utc);
 #endif
 		dbg_whack(s, "stop: list & LIST_CRLS");
 	}
@@ -931,6 +932,12 @@ static void whack_process(const struct whack_message *const m, struct show *s)
 		dbg_whack(s, "...processstatus");
 	}
 
+	if (m->whack_memory_status) {
+		dbg_whack(s, "start: memory");
+		show_memory_status(s);
+		dbg_whack(s, "stop: memory");
+	}
+
 	if (m->whack_addresspool_status) {
 		dbg_whack(s, "start: addresspoolstatus");
 		show_addresspool_status(s);
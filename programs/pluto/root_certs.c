@@ -23,6 +23,9 @@
 #include "server.h"
 #include "pluto_timing.h"
 #include "log.h"
+#include "pluto_x509.h"		/* for flush_trusted_ca_cache() */
+#include "crypt_hash.h"
+#include "ike_alg_hash.h"
 
 static struct root_certs *root_cert_db;
 
@@ -84,6 +87,7 @@ struct root_certs *root_certs_addref_where(where_t where)
 	 * and the result is being cached anyway.
 	 */
 	threadtime_t ca_time = threadtime_start();
+	struct crypt_hash *digest = crypt_hash_init("trust anchors", &ike_alg_hash_sha2_256, &logger);
 	for (CERTCertListNode *node = CERT_LIST_HEAD(allcerts);
 	     !CERT_LIST_END(node, allcerts);
 	     node = CERT_LIST_NEXT(node)) {
@@ -98,7 +102,9 @@ struct root_certs *root_certs_addref_where(where_t where)
 		dbg("adding the CA+root cert %s", node->cert->subjectName);
 		CERTCertificate *dup = CERT_DupCertificate(node->cert);
 		CERT_AddCertToListTail(root_certs->trustcl, dup);
+		crypt_hash_digest_hunk(digest, "CA", same_secitem_as_shunk(dup->derCert));
 	}
+	root_certs->digest = crypt_hash_final_mac(&digest);
 	CERT_DestroyCertList(allcerts);
 	threadtime_stop(&ca_time, SOS_NOBODY, "%s() filtering CAs", __func__);
 
@@ -154,5 +160,7 @@ void free_root_certs(struct logger *logger)
 	} else {
 		root_certs_delref(&root_cert_db);
 		pexpect(root_cert_db == NULL);
+		/* next time, the NSS DB will be re-read */
+		flush_trusted_ca_cache("root certificates released");
 	}
 }
@@ -19,6 +19,7 @@
 #include "lswnss.h"
 #include "refcnt.h"
 #include "where.h"
+#include "crypt_mac.h"
 
 void init_root_certs(void);
 void free_root_certs(struct logger *logger);
@@ -26,6 +27,8 @@ void free_root_certs(struct logger *logger);
 struct root_certs {
 	refcnt_t refcnt;
 	CERTCertList *trustcl;
+	/* SHA-256 of the trusted CAs; identifies this set of anchors */
+	struct crypt_mac digest;
 };
 
 struct root_certs *root_certs_addref_where(where_t where);
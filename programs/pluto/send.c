@@ -53,45 +53,59 @@
  * The first two call send_or_resend_ike_msg().
  * That handles an IKE message.
  * It calls send_v1_frags() if the message needs to be fragmented.
- * Otherwise it calls send_packet() to send it in one gulp.
+ * Otherwise it calls send_packets() to send it in one gulp.
  *
  * send_v1_frags() breaks an IKE message into fragments and sends
- * them by send_packet().
+ * them, in batches, by send_packets().
  *
- * send_keepalive() calls send_packet() directly: uses a special
+ * send_keepalive() calls send_packets() directly: uses a special
  * tiny packet; non-ESP marker does not apply; logging on write error
  * is suppressed.
  *
- * send_packet() sends a UDP packet, possibly prefixed by a non-ESP Marker
- * for NATT.  It accepts two chunks because this avoids double-copying.
+ * send_packets() sends UDP packets, each possibly prefixed by a
+ * non-ESP Marker for NATT.  Each packet is two chunks, and the
+ * marker and chunks are gathered by the kernel so nothing is copied.
  */
 
-static bool send_shunks(const char *where, bool just_a_keepalive,
-			so_serial_t serialno, /* can be SOS_NOBODY */
-			const struct iface_endpoint *interface,
-			ip_endpoint remote_endpoint,
-			shunk_t a, shunk_t b,
-			struct logger *logger)
+static void log_send_failure(const char *where,
+			     const struct iface_endpoint *interface,
+			     const ip_endpoint *remote_endpoint,
+			     int error, struct logger *logger)
 {
-	/* NOTE: on system with limited stack, buf could be made static */
-	uint8_t buf[MAX_OUTPUT_UDP_SIZE];
+	endpoint_buf lb;
+	endpoint_buf rb;
+	llog_error(logger, error,
+		   "send on %s from %s to %s using %s failed in %s",
+		   interface->ip_dev->id_rname,
+		   str_endpoint(&interface->local_endpoint, &lb),
+		   str_endpoint_sensitive(remote_endpoint, &rb),
+		   interface->io->protocol->name,
+		   where);
+}
 
-	/* Each fragment, if we are doing NATT, needs a non-ESP_Marker prefix.
-	 * natt_bonus is the size of the addition (0 if not needed).
-	 */
-	size_t natt_bonus;
+/*
+ * Send NR_PACKETS packets, each made up of the A and B hunks, to
+ * REMOTE_ENDPOINT.
+ *
+ * Nothing is copied: each packet, along with its non-ESP marker, is
+ * gathered by the kernel.  When the interface can, the packets go
+ * out in a single system call.
+ */
+
+static bool send_packets(const char *where, bool just_a_keepalive,
+			 so_serial_t serialno, /* can be SOS_NOBODY */
+			 const struct iface_endpoint *interface,
+			 ip_endpoint remote_endpoint,
+			 const struct send_packet *packets, unsigned nr_packets,
+			 struct logger *logger)
+{
+	static const uint8_t non_esp_marker[NON_ESP_MARKER_SIZE]; /* zero */
 
 	if (interface == NULL) {
 		llog(RC_LOG, logger, "cannot send packet - interface vanished!");
 		return false;
 	}
 
-	/* bandaid */
-	if (a.ptr == NULL) {
-		llog(RC_LOG, logger, "cannot send packet - a.ptr is NULL");
-		return false;
-	}
-
 	/*
 	 * XXX:
 	 *
@@ -119,105 +133,159 @@ static bool send_shunks(const char *where, bool just_a_keepalive,
 	 * prefix.  natt_bonus is the size of the addition (0 if not
 	 * needed).
 	 */
-	natt_bonus = !just_a_keepalive &&
+	size_t natt_bonus = !just_a_keepalive &&
 				  interface->esp_encapsulation_enabled ?
 				  NON_ESP_MARKER_SIZE : 0;
 
-	const uint8_t *ptr;
-	size_t len = natt_bonus + a.len + b.len;
-
-	if (len > MAX_OUTPUT_UDP_SIZE) {
-		/* XXX: UDP centric? */
-		llog(RC_LOG_SERIOUS, logger,
-			    "send_ike_msg(): really too big %zu bytes", len);
-		return false;
-	}
-
-	if (len != a.len) {
-		/* copying required */
-
-		/* 1. non-ESP Marker (0x00 octets) */
-		memset(buf, 0x00, natt_bonus);
-
-		/* 2. chunk a */
-		memcpy(buf + natt_bonus, a.ptr, a.len);
+	while (nr_packets > 0) {
 
-		/* 3. chunk b */
-		memcpy(buf + natt_bonus + a.len, b.ptr, b.len);
+		struct outgoing_packet out[SEND_PACKETS_MAX];
+		unsigned nr_out = 0;
+		unsigned nr_used = 0;
 
-		ptr = buf;
-	} else {
-		ptr = a.ptr;
-	}
+		for (; nr_used < nr_packets && nr_out < elemsof(out); nr_used++) {
+			const struct send_packet *packet = &packets[nr_used];
+			/* bandaid */
+			if (packet->a.ptr == NULL) {
+				llog(RC_LOG, logger, "cannot send packet - a.ptr is NULL");
+				return false;
+			}
 
-	if (DBGP(DBG_BASE)) {
-		endpoint_buf lb;
-		endpoint_buf rb;
-		llog(DEBUG_STREAM, logger,
-			    "sending %zu bytes for %s through %s from %s to %s using %s (for #%lu)",
-			    len, where,
-			    interface->ip_dev->id_rname,
-			    str_endpoint(&interface->local_endpoint, &lb),
-			    str_endpoint(&remote_endpoint, &rb),
-			    interface->io->protocol->name,
-			    serialno);
-		DBG_dump(NULL, ptr, len);
-	}
+			struct outgoing_packet *o = &out[nr_out];
+			o->nr_iov = 0;
+			o->len = natt_bonus + packet->a.len + packet->b.len;
+			if (o->len > MAX_OUTPUT_UDP_SIZE) {
+				/* XXX: UDP centric? */
+				llog(RC_LOG_SERIOUS, logger,
+				     "send_ike_msg(): really too big %zu bytes", o->len);
+				return false;
+			}
+			/* 1. non-ESP Marker (0x00 octets) */
+			if (natt_bonus > 0) {
+				o->iov[o->nr_iov++] = (struct iovec) {
+					.iov_base = (void *)non_esp_marker,
+					.iov_len = natt_bonus,
+				};
+			}
+			/* 2. chunk a */
+			o->iov[o->nr_iov++] = (struct iovec) {
+				.iov_base = (void *)packet->a.ptr,
+				.iov_len = packet->a.len,
+			};
+			/* 3. chunk b */
+			if (packet->b.len > 0) {
+				o->iov[o->nr_iov++] = (struct iovec) {
+					.iov_base = (void *)packet->b.ptr,
+					.iov_len = packet->b.len,
+				};
+			}
 
-	if (!impair_outgoing_message(shunk2(ptr, len), logger)) {
-		ssize_t wlen = interface->io->write_packet(interface, ptr, len,
-							   &remote_endpoint, logger);
-		if (wlen != (ssize_t)len) {
-			if (!just_a_keepalive) {
+			if (DBGP(DBG_BASE)) {
 				endpoint_buf lb;
 				endpoint_buf rb;
-				llog_error(logger, errno,
-					   "send on %s from %s to %s using %s failed in %s",
-					   interface->ip_dev->id_rname,
-					   str_endpoint(&interface->local_endpoint, &lb),
-					   str_endpoint_sensitive(&remote_endpoint, &rb),
-					   interface->io->protocol->name,
-					   where);
+				llog(DEBUG_STREAM, logger,
+				     "sending %zu bytes for %s through %s from %s to %s using %s (for #%lu)",
+				     o->len, where,
+				     interface->ip_dev->id_rname,
+				     str_endpoint(&interface->local_endpoint, &lb),
+				     str_endpoint(&remote_endpoint, &rb),
+				     interface->io->protocol->name,
+				     serialno);
+				for (unsigned i = 0; i < o->nr_iov; i++) {
+					DBG_dump(NULL, o->iov[i].iov_base, o->iov[i].iov_len);
+				}
 			}
-			return false;
-		}
-		pstats_ike_out_bytes += len;
-	}
 
-	/*
-	 * For testing: send a duplicate packet when this impair is
-	 * enabled.
-	 *
-	 * XXX: sends the packet out using UDP?  Merge with above?
-	 */
-	if (impair.jacob_two_two) {
-		/* sleep for half a second, and second another packet */
-		usleep(500000);
-		endpoint_buf b;
-		endpoint_buf ib;
-		llog(RC_LOG, logger,
-			    "IMPAIR: JACOB 2-2: resending %zu bytes for %s through %s from %s to %s:",
-			    len, where,
-			    interface->ip_dev->id_rname,
-			    str_endpoint(&interface->local_endpoint, &ib),
-			    str_endpoint(&remote_endpoint, &b));
+			if (impair_outgoing_message(o->iov, o->nr_iov, logger)) {
+				/* dropped */
+				continue;
+			}
+			nr_out++;
+		}
+		packets += nr_used;
+		nr_packets -= nr_used;
 
-		ip_sockaddr remote_sa = sockaddr_from_endpoint(remote_endpoint);
-		ssize_t wlen = sendto(interface->fd, ptr, len, 0, &remote_sa.sa.sa, remote_sa.len);
-		if (wlen != (ssize_t)len) {
+		unsigned sent = 0;
+		if (nr_out > 1 && interface->io->write_packets != NULL) {
+			while (sent < nr_out) {
+				int n = interface->io->write_packets(interface, out + sent,
+								     nr_out - sent,
+								     &remote_endpoint, logger);
+				pstats_ike_out_syscalls++;
+				if (n <= 0) {
+					break;
+				}
+				for (int i = 0; i < n; i++) {
+					pstats_ike_out_bytes += out[sent + i].len;
+				}
+				pstats_ike_out_packets += n;
+				pstats_ike_out_batched += n;
+				sent += n;
+			}
+		} else {
+			for (; sent < nr_out; sent++) {
+				ssize_t wlen = interface->io->write_packet(interface, &out[sent],
+									   &remote_endpoint, logger);
+				pstats_ike_out_syscalls++;
+				if (wlen != (ssize_t)out[sent].len) {
+					break;
+				}
+				pstats_ike_out_bytes += out[sent].len;
+				pstats_ike_out_packets++;
+			}
+		}
+		if (sent < nr_out) {
 			if (!just_a_keepalive) {
-				llog_error(logger, errno,
-					   "sendto on %s to %s failed in %s",
-					   interface->ip_dev->id_rname,
-					   str_endpoint(&remote_endpoint, &b),
-					   where);
+				log_send_failure(where, interface, &remote_endpoint,
+						 errno, logger);
 			}
 			return false;
 		}
+
+		/*
+		 * For testing: send a duplicate packet when this impair is
+		 * enabled.
+		 */
+		if (impair.jacob_two_two) {
+			for (unsigned i = 0; i < nr_out; i++) {
+				/* sleep for half a second, and second another packet */
+				usleep(500000);
+				endpoint_buf b;
+				endpoint_buf ib;
+				llog(RC_LOG, logger,
+				     "IMPAIR: JACOB 2-2: resending %zu bytes for %s through %s from %s to %s:",
+				     out[i].len, where,
+				     interface->ip_dev->id_rname,
+				     str_endpoint(&interface->local_endpoint, &ib),
+				     str_endpoint(&remote_endpoint, &b));
+				ssize_t wlen = interface->io->write_packet(interface, &out[i],
+									   &remote_endpoint, logger);
+				if (wlen != (ssize_t)out[i].len) {
+					if (!just_a_keepalive) {
+						log_send_failure(where, interface, &remote_endpoint,
+								 errno, logger);
+					}
+					return false;
+				}
+			}
+		}
 	}
 	return true;
 }
 
+static bool send_shunks(const char *where, bool just_a_keepalive,
+			so_serial_t serialno, /* can be SOS_NOBODY */
+			const struct iface_endpoint *interface,
+			ip_endpoint remote_endpoint,
+			shunk_t a, shunk_t b,
+			struct logger *logger)
+{
+	struct send_packet packet = { .a = a, .b = b, };
+	return send_packets(where, just_a_keepalive, serialno,
+			    interface, remote_endpoint,
+			    &packet, 1, logger);
+}
+
 bool send_pbs_out_using_md(struct msg_digest *md, const char *where, struct pbs_out *packet)
 {
 	return send_shunks(where, false, SOS_NOBODY,
@@ -235,6 +303,14 @@ bool send_chunks_using_state(struct state *st, const char *where,
 			   st->st_logger);
 }
 
+bool send_packets_using_state(struct state *st, const char *where,
+			      const struct send_packet *packets, unsigned nr_packets)
+{
+	return send_packets(where, false, st->st_serialno,
+			    st->st_interface, st->st_remote_endpoint,
+			    packets, nr_packets, st->st_logger);
+}
+
 bool send_chunk_using_state(struct state *st, const char *where, chunk_t packet)
 {
 	return send_chunks_using_state(st, where, packet, EMPTY_CHUNK);
@@ -33,6 +33,21 @@ bool send_chunks_using_state(struct state *st, const char *where,
 
 bool send_chunk_using_state(struct state *st, const char *where, chunk_t packet);
 
+/*
+ * Several packets for the one remote, such as a message's fragments;
+ * when the interface allows, they go out in one system call.
+ */
+
+struct send_packet {
+	shunk_t a;
+	shunk_t b;
+};
+
+#define SEND_PACKETS_MAX 16
+
+bool send_packets_using_state(struct state *st, const char *where,
+			      const struct send_packet *packets, unsigned nr_packets);
+
 #define send_hunk_using_state(ST, WHERE, HUNK)				\
 	({								\
 		chunk_t h_ = { .ptr = (HUNK).ptr, .len = (HUNK).len, };	\
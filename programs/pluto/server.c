@@ -83,6 +83,7 @@
 #include "nat_traversal.h"
 
 #include "lswfips.h"
+#include "arena.h"		/* for arena_usage() */
 
 #ifdef USE_SECCOMP
 # include "pluto_seccomp.h"
@@ -261,8 +262,11 @@ static struct global_timer_desc global_timers[] = {
 	E(EVENT_PENDING_PHASE2),
 	E(EVENT_CHECK_CRLS),
 	E(EVENT_REVIVE_CONNS),
+	E(EVENT_CHECK_ORIENTATIONS),
 	E(EVENT_FREE_ROOT_CERTS),
 	E(EVENT_RESET_LOG_LIMITER),
+	E(EVENT_SAVE_LEASE_SNAPSHOT),
+	E(EVENT_ROTATE_TICKET_KEY),
 	E(EVENT_PROCESS_KERNEL_QUEUE),
 	E(EVENT_NAT_T_KEEPALIVE),
 #undef E
@@ -832,6 +836,55 @@ void add_fd_read_listener(int fd, const char *name,
 	link_pluto_event_list(fdl);
 }
 
+/*
+ * Wait for FD to become writable; used to drain a stream's output
+ * queue.  Unlike the read listener there is no global list, the
+ * owner must detach it.
+ */
+
+struct fd_write_listener {
+	fd_write_listener_cb *cb;
+	void *arg;
+	const char *name;
+	struct event ev;		/* libevent data structure */
+};
+
+static void fd_write_listener_event_handler(evutil_socket_t fd,
+					    short events UNUSED,
+					    void *arg)
+{
+	struct logger logger[1] = { global_logger, }; /* event-handler */
+	struct fd_write_listener *fdl = arg;
+	fdl->cb(fd, fdl->arg, logger);
+}
+
+void attach_fd_write_listener(struct fd_write_listener **fdl,
+			      int fd, const char *name,
+			      fd_write_listener_cb *cb, void *arg)
+{
+	passert(*fdl == NULL);
+	passert(fd >= 0);
+	*fdl = alloc_thing(struct fd_write_listener, name);
+	dbg_alloc("fdl", *fdl, HERE);
+	(*fdl)->name = name;
+	(*fdl)->arg = arg;
+	(*fdl)->cb = cb;
+	EVENT_ADD(*fdl, EV_WRITE|EV_PERSIST,
+		  (evutil_socket_t)fd,
+		  (struct timeval*)NULL,
+		  fd_write_listener_event_handler);
+}
+
+void detach_fd_write_listener(struct fd_write_listener **fdl)
+{
+	if (*fdl != NULL) {
+		EVENT_DEL(*fdl);
+		dbg_free("fdl", *fdl, HERE);
+		pfree(*fdl);
+		*fdl = NULL;
+	}
+}
+
 struct fd_accept_listener {
 	fd_accept_listener_cb *cb;
 	void *arg;
@@ -924,6 +977,28 @@ void show_fips_status(struct show *s)
 		impair.force_fips ? "enabled [forced]" : "enabled");
 }
 
+static void show_alloc_usage(const struct alloc_usage *u, void *context)
+{
+	struct show *s = context;
+	show_comment(s, "  %s: %ju * %ju bytes; peak %ju * %ju bytes",
+		     u->name, u->count, u->bytes, u->peak_count, u->peak_bytes);
+}
+
+void show_memory_status(struct show *s)
+{
+	show_comment(s, "memory usage by category:");
+	if (leak_detective) {
+		alloc_usage(show_alloc_usage, s);
+	} else {
+		show_comment(s, "  (heap allocations are only tracked with --leak-detective)");
+	}
+	show_separator(s);
+	show_comment(s, "memory usage by arena:");
+	arena_usage(show_alloc_usage, s);
+	show_separator(s);
+	show_state_memory(s);
+}
+
 static void huphandler_cb(struct logger *logger)
 {
 	llog(RC_LOG, logger, "Pluto ignores SIGHUP -- perhaps you want \"whack --listen\"");
@@ -39,6 +39,7 @@ struct iface_dev;
 struct show;
 struct fd_read_listener;
 struct fd_accept_listener;
+struct fd_write_listener;
 struct timeout;
 
 extern char *pluto_vendorid;
@@ -73,6 +74,7 @@ extern bool pluto_drop_oppo_null;
 
 extern void show_debug_status(struct show *s);
 extern void show_fips_status(struct show *s);
+extern void show_memory_status(struct show *s);
 extern void run_server(char *conffile, struct logger *logger) NEVER_RETURNS;
 
 /* XXX: grr, need pointer to function else NEVER_RETURNS is ignored */
@@ -103,6 +105,13 @@ void detach_fd_read_listener(struct fd_read_listener **fdl);
 void add_fd_read_listener(int fd, const char *name,
 			  fd_read_listener_cb *cb, void *arg);
 
+typedef void (fd_write_listener_cb)(int fd, void *arg, struct logger *logger);
+
+void attach_fd_write_listener(struct fd_write_listener **fdl,
+			      int fd, const char *name,
+			      fd_write_listener_cb *cb, void *arg);
+void detach_fd_write_listener(struct fd_write_listener **fdl);
+
 extern void set_pluto_busy(bool busy);
 extern void set_whack_pluto_ddos(enum ddos_mode mode, struct logger *logger);
 
@@ -65,7 +65,8 @@
 #include "ikev2_delete.h"	/* for record_v2_delete() */
 #include "orient.h"
 #include "ikev2_proposals.h"		/* for free_ikev2_proposal() */
-#include "ikev2_eap.h"			/* for free_eap_state() */
+#include "ikev2_ticket.h"		/* for free_v2_resumption() */
+#include "ikev2_eap.h"			/* for free_eap_state(), struct eap_state */
 #include "lswfips.h"			/* for libreswan_fipsmode() */
 #include "show.h"
 
@@ -357,6 +358,22 @@ static size_t jam_readable_humber(struct jambuf *buf, uint64_t num, bool kilos)
 	return jam(buf, "%" PRIu64 "%s", to_print, suffix + kilos);
 }
 
+/*
+ * Only states created as an IKE SA were allocated as a struct ike_sa
+ * (see new_state()); casting anything else would expose memory past
+ * the end of the state.
+ */
+
+static struct ike_sa *ike_sa_allocation(struct state *st, where_t where)
+{
+	if (st->st_establishing_sa != IKE_SA) {
+		llog_pexpect(st->st_logger, where,
+			     "state #%lu was not allocated as an IKE SA", st->st_serialno);
+		return NULL; /* kaboom */
+	}
+	return (struct ike_sa*) st;
+}
+
 /*
  * Get the IKE SA managing the security association.
  */
@@ -372,9 +389,12 @@ struct ike_sa *ike_sa(struct state *st, where_t where)
 			/* about to crash with an NPE? */
 			return NULL;
 		}
-		return (struct ike_sa*) pst;
+		return ike_sa_allocation(pst, where);
 	}
-	return (struct ike_sa*) st;
+	if (st == NULL) {
+		return NULL;
+	}
+	return ike_sa_allocation(st, where);
 }
 
 struct ike_sa *pexpect_ike_sa_where(struct state *st, where_t where)
@@ -387,7 +407,7 @@ struct ike_sa *pexpect_ike_sa_where(struct state *st, where_t where)
 			     "state #%lu is not an IKE SA", st->st_serialno);
 		return NULL; /* kaboom */
 	}
-	return (struct ike_sa*) st;
+	return ike_sa_allocation(st, where);
 }
 
 struct child_sa *pexpect_child_sa_where(struct state *st, where_t where)
@@ -419,15 +439,23 @@ static struct state *new_state(struct connection *c,
 			       struct fd *whackfd,
 			       where_t where)
 {
-	union sas {
-		struct child_sa child;
-		struct ike_sa ike;
-		struct state st;
-	};
-	union sas *sap = alloc_thing(union sas, "struct state");
-	passert(&sap->st == &sap->child.sa);
-	passert(&sap->st == &sap->ike.sa);
-	struct state *st = &sap->st;
+	/*
+	 * Only an IKE SA carries the IKE-only fields that follow
+	 * struct state; see struct ike_sa.
+	 */
+	struct state *st;
+	if (sa_type == IKE_SA) {
+		struct ike_sa *ike = alloc_thing(struct ike_sa, "struct ike_sa");
+		st = &ike->sa;
+	} else {
+		struct child_sa *child = alloc_thing(struct child_sa, "struct child_sa");
+		st = &child->sa;
+	}
+#ifdef USE_IKEv1
+	if (c->config->ike_version == IKEv1) {
+		st->st_v1_ivs = alloc_thing(struct v1_ivs, "IKEv1 IVs");
+	}
+#endif
 
 	/* Create the logger ASAP; needs real ST */
 	st->st_logger = alloc_logger(st, &logger_state_vec, where);
@@ -501,6 +529,14 @@ struct ike_sa *new_v2_ike_state(struct connection *c,
 	return ike;
 }
 
+struct v2_mobike *v2_mobike(struct state *st)
+{
+	if (st->st_v2_mobike == NULL) {
+		st->st_v2_mobike = alloc_thing(struct v2_mobike, "IKEv2 MOBIKE");
+	}
+	return st->st_v2_mobike;
+}
+
 /*
  * Initialize the state table.
  */
@@ -533,13 +569,32 @@ void delete_state_by_id_name(struct state *st, const char *name)
 	}
 }
 
+/*
+ * Replace ST's XAUTH username; NULL and "" both clear it.  Like the
+ * fixed size array it replaces, the name is truncated to
+ * MAX_XAUTH_USERNAME_LEN-1 characters.
+ */
+
+void update_xauth_username(struct state *st, const char *name)
+{
+	char *username = NULL;
+	if (name != NULL && name[0] != '\0') {
+		size_t len = strnlen(name, MAX_XAUTH_USERNAME_LEN - 1);
+		username = alloc_things(char, len + 1, "xauth username");
+		memcpy(username, name, len); /* already NUL terminated */
+	}
+	/* NAME could be the old username */
+	replace(st->st_xauth_username, username);
+}
+
 void v1_delete_state_by_username(struct state *st, const char *name)
 {
 	/* only support deleting ikev1 with XAUTH username */
 	if (st->st_ike_version == IKEv2)
 		return;
 
-	if (IS_IKE_SA(st) && streq(st->st_xauth_username, name)) {
+	if (IS_IKE_SA(st) && st->st_xauth_username != NULL &&
+	    streq(st->st_xauth_username, name)) {
 		struct ike_sa *ike = pexpect_ike_sa(st);
 		delete_ike_family(&ike, PROBABLY_SEND_DELETE);
 		/* note: no md->v1_st to clear */
@@ -867,7 +922,7 @@ static void log_and_update_traffic(struct state *st, const char *name, struct ip
 		jam_string(buf, " out=");
 		jam_humber(buf, traffic->outbound.bytes);
 		jam_string(buf, "B");
-		if (st->st_xauth_username[0] != '\0') {
+		if (st->st_xauth_username != NULL) {
 			jam_string(buf, " XAUTHuser=");
 			jam_string(buf, st->st_xauth_username);
 		}
@@ -979,10 +1034,6 @@ void delete_state_tail(struct state *st)
 	}
 #endif
 
-	/* intermediate */
-	free_chunk_content(&st->st_v2_ike_intermediate.initiator);
-	free_chunk_content(&st->st_v2_ike_intermediate.responder);
-
 	/* if there is a suspended state transition, disconnect us */
 	struct msg_digest *md = unsuspend_any_md(st);
 	if (md != NULL) {
@@ -1124,7 +1175,14 @@ void delete_state_tail(struct state *st)
 
 	pexpect(st->st_connection == NULL);
 
-	v2_msgid_free(st);
+	if (st->st_establishing_sa == IKE_SA) {
+		struct ike_sa *ike = (struct ike_sa *)st;
+		v2_msgid_free(ike);
+		/* intermediate */
+		free_chunk_content(&ike->st_v2_ike_intermediate.initiator);
+		free_chunk_content(&ike->st_v2_ike_intermediate.responder);
+		free_chunk_content(&ike->st_v2_id_payload.data);
+	}
 
 	change_state(st, STATE_UNDEFINED);
 
@@ -1134,13 +1192,15 @@ void delete_state_tail(struct state *st)
 
 #ifdef USE_IKEv1
 	ikev1_clear_msgid_list(st);
+	pfreeany(st->st_v1_ivs);
 #endif
 	pubkey_delref(&st->st_peer_pubkey);
-	md_delref(&st->st_eap_sa_md);
 	free_eap_state(&st->st_eap);
+	pfreeany(st->st_v2_mobike);
 
 	free_ikev2_proposals(&st->st_v2_create_child_sa_proposals);
 	free_ikev2_proposal(&st->st_v2_accepted_proposal);
+	free_v2_resumption(&st->st_v2_resumption);
 
 	/* helper may have its own ref */
 	dh_local_secret_delref(&st->st_dh_local_secret, HERE);
@@ -1165,7 +1225,6 @@ void delete_state_tail(struct state *st)
 	free_chunk_content(&st->st_ni);
 	free_chunk_content(&st->st_nr);
 	free_chunk_content(&st->st_dcookie);
-	free_chunk_content(&st->st_v2_id_payload.data);
 
 #    define free_any_nss_symkey(p)  release_symkey(__func__, #p, &(p))
 	free_any_nss_symkey(st->st_dh_shared_secret);
@@ -1213,7 +1272,7 @@ void delete_state_tail(struct state *st)
 	wipe_any(st->st_xauth_password.ptr, st->st_xauth_password.len);
 #   undef wipe_any
 
-	/* st_xauth_username is an array on the state itself, not clone_str()'ed */
+	pfreeany(st->st_xauth_username);
 	pfreeany(st->st_seen_cfg_dns);
 	pfreeany(st->st_seen_cfg_domains);
 	pfreeany(st->st_seen_cfg_banner);
@@ -1598,7 +1657,7 @@ static struct state *duplicate_state(struct connection *c,
 	 * Maybe similarly to above for chunks, do this for all
 	 * strings on the state?
 	 */
-	jam_str(nst->st_xauth_username, sizeof(nst->st_xauth_username), st->st_xauth_username);
+	update_xauth_username(nst, st->st_xauth_username);
 
 	nst->st_seen_cfg_dns = clone_str(st->st_seen_cfg_dns, "child st_seen_cfg_dns");
 	nst->st_seen_cfg_domains = clone_str(st->st_seen_cfg_domains, "child st_seen_cfg_domains");
@@ -1993,7 +2052,7 @@ static void jam_state_traffic(struct jambuf *buf, struct state *st)
 	const struct connection *c = st->st_connection;
 	jam_connection(buf, c);
 
-	if (st->st_xauth_username[0] != '\0') {
+	if (st->st_xauth_username != NULL) {
 		jam(buf, ", username=%s", st->st_xauth_username);
 	}
 
@@ -2019,7 +2078,7 @@ static void jam_state_traffic(struct jambuf *buf, struct state *st)
 		}
 	}
 
-	if (st->st_xauth_username[0] == '\0') {
+	if (st->st_xauth_username == NULL) {
 		jam(buf, ", id='");
 		jam_id_bytes(buf, &c->remote->host.id, jam_sanitized_bytes);
 		jam(buf, "'");
@@ -2137,10 +2196,10 @@ static void show_state(struct show *s, struct state *st, const monotime_t now)
 		} else if (dpd_active_locally(st->st_connection) && (st->st_ike_version == IKEv2)) {
 			/* stats are on parent sa */
 			if (IS_CHILD_SA(st)) {
-				struct state *pst = state_by_serialno(st->st_clonedfrom);
-				if (pst != NULL) {
+				struct ike_sa *ike = pexpect_ike_sa(state_by_serialno(st->st_clonedfrom));
+				if (ike != NULL) {
 					jam(buf, " lastlive=%jds;",
-					    deltasecs(monotimediff(now, pst->st_v2_msgid_windows.last_recv)));
+					    deltasecs(monotimediff(now, ike->st_v2_msgid_windows.last_recv)));
 				}
 			}
 		} else if (st->st_ike_version == IKEv1) {
@@ -2280,7 +2339,7 @@ static void show_established_child_details(struct show *s, struct state *st,
 		}
 
 		jam(buf, " "); /* TBD: trailing blank */
-		if (st->st_xauth_username[0] != '\0') {
+		if (st->st_xauth_username != NULL) {
 			jam(buf, "username=%s", st->st_xauth_username);
 		}
 	}
@@ -2453,6 +2512,65 @@ void show_brief_status(struct show *s)
 		  cat_count_child_sa[CAT_ANONYMOUS]);
 }
 
+/*
+ * whack --memory: what the state table costs, by kind.
+ *
+ * Counts the fixed size allocations new_state() makes plus the small
+ * side structures hanging off them; variable length contents such
+ * as packets, keys and certificates are not included.
+ */
+
+void show_state_memory(struct show *s)
+{
+	struct state_usage {
+		const struct ike_info *info;
+		uintmax_t count;
+		uintmax_t bytes;	/* the struct ike_sa / struct child_sa */
+		uintmax_t side;		/* IVs, XAUTH username, MOBIKE, EAP */
+	} usage[IKE_VERSION_ROOF][SA_TYPE_ROOF] = {0};
+
+	struct state_filter sf = { .where = HERE, };
+	while (next_state_new2old(&sf)) {
+		struct state *st = sf.st;
+		const struct config *config = st->st_connection->config;
+		enum sa_type sa_type = st->st_establishing_sa;
+		struct state_usage *u = &usage[config->ike_version][sa_type];
+		u->info = config->ike_info;
+		u->count++;
+		u->bytes += (sa_type == IKE_SA ? sizeof(struct ike_sa) :
+			     sizeof(struct child_sa));
+#ifdef USE_IKEv1
+		if (st->st_v1_ivs != NULL) {
+			u->side += sizeof(struct v1_ivs);
+		}
+#endif
+		if (st->st_xauth_username != NULL) {
+			u->side += strlen(st->st_xauth_username) + 1;
+		}
+		if (st->st_v2_mobike != NULL) {
+			u->side += sizeof(struct v2_mobike);
+		}
+		if (st->st_eap != NULL) {
+			u->side += sizeof(struct eap_state);
+		}
+	}
+
+	show_comment(s, "memory usage by state kind:");
+	show_comment(s, "  struct ike_sa %zu bytes, struct child_sa %zu bytes",
+		     sizeof(struct ike_sa), sizeof(struct child_sa));
+	for (enum ike_version v = IKE_VERSION_FLOOR; v < IKE_VERSION_ROOF; v++) {
+		for (enum sa_type t = SA_TYPE_FLOOR; t < SA_TYPE_ROOF; t++) {
+			const struct state_usage *u = &usage[v][t];
+			if (u->count == 0) {
+				continue;
+			}
+			show_comment(s, "  %s %s: %ju * %ju bytes; side %ju bytes",
+				     u->info->version_name, u->info->sa_type_name[t],
+				     u->count, u->bytes / u->count, u->side);
+		}
+	}
+}
+
 void show_states(struct show *s, const monotime_t now)
 {
 	show_separator(s);
@@ -2650,17 +2768,17 @@ bool update_mobike_endpoints(struct ike_sa *ike, const struct msg_digest *md)
 		/* MOBIKE inititor processing response */
 		old_endpoint = ike->sa.st_interface->local_endpoint;
 
-		child->sa.st_mobike_local_endpoint = ike->sa.st_mobike_local_endpoint;
-		child->sa.st_mobike_host_nexthop = ike->sa.st_mobike_host_nexthop;
+		v2_mobike(&child->sa)->local_endpoint = v2_mobike(&ike->sa)->local_endpoint;
+		v2_mobike(&child->sa)->host_nexthop = v2_mobike(&ike->sa)->host_nexthop;
 
-		new_endpoint = ike->sa.st_mobike_local_endpoint;
+		new_endpoint = ike->sa.st_v2_mobike->local_endpoint;
 		break;
 	case MESSAGE_REQUEST:
 		/* MOBIKE responder processing request */
 		old_endpoint = ike->sa.st_remote_endpoint;
 
-		child->sa.st_mobike_remote_endpoint = md->sender;
-		ike->sa.st_mobike_remote_endpoint = md->sender;
+		v2_mobike(&child->sa)->remote_endpoint = md->sender;
+		v2_mobike(&ike->sa)->remote_endpoint = md->sender;
 
 		new_endpoint =md->sender;
 		break;
@@ -2701,11 +2819,11 @@ bool update_mobike_endpoints(struct ike_sa *ike, const struct msg_digest *md)
 	switch (md_role) {
 	case MESSAGE_RESPONSE:
 		/* MOBIKE initiator processing response */
-		c->local->host.addr = endpoint_address(child->sa.st_mobike_local_endpoint);
+		c->local->host.addr = endpoint_address(child->sa.st_v2_mobike->local_endpoint);
 		dbg("%s() %s.host_port: %u->%u", __func__, c->spd.this.config->leftright,
-		    c->spd.this.host->port, endpoint_hport(child->sa.st_mobike_local_endpoint));
-		c->spd.this.host->port = endpoint_hport(child->sa.st_mobike_local_endpoint);
-		c->spd.this.host->nexthop = child->sa.st_mobike_host_nexthop;
+		    c->spd.this.host->port, endpoint_hport(child->sa.st_v2_mobike->local_endpoint));
+		c->spd.this.host->port = endpoint_hport(child->sa.st_v2_mobike->local_endpoint);
+		c->spd.this.host->nexthop = child->sa.st_v2_mobike->host_nexthop;
 		break;
 	case MESSAGE_REQUEST:
 		/* MOBIKE responder processing request */
@@ -2736,8 +2854,8 @@ bool update_mobike_endpoints(struct ike_sa *ike, const struct msg_digest *md)
 	if (md_role == MESSAGE_RESPONSE) {
 		/* MOBIKE initiator processing response */
 		migration_up(child);
-		ike->sa.st_deleted_local_addr = unset_address;
-		child->sa.st_deleted_local_addr = unset_address;
+		v2_mobike(&ike->sa)->deleted_local_addr = unset_address;
+		v2_mobike(&child->sa)->deleted_local_addr = unset_address;
 		if (dpd_active_locally(child->sa.st_connection) &&
 		    child->sa.st_v2_liveness_event == NULL) {
 			dbg("dpd re-enabled after mobike, scheduling ikev2 liveness checks");
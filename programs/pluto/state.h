@@ -58,6 +58,7 @@
 
 struct v2_state_transition;
 struct ikev2_ipseckey_dns; /* forward declaration of tag */
+struct v2_resumption;
 
 struct state;   /* forward declaration of tag */
 struct eap_state;
@@ -299,10 +300,35 @@ extern const struct finite_state *finite_states[STATE_IKE_ROOF];
  *   This prevents leaks.
  */
 struct state {
-	realtime_t st_inception;		/* time state is created, for logging */
-	struct state_timing st_timing;		/* accumulative cpu time */
+	/*
+	 * Lookup fields.
+	 *
+	 * The state_db.c hash-chain predicates and the IS_*()
+	 * macros read these on every state they pass over; keep
+	 * them at the front so they share the first cache line.
+	 */
 	so_serial_t st_serialno;                /* serial number (for seniority)*/
 	so_serial_t st_clonedfrom;              /* serial number of parent */
+	ike_spis_t st_ike_spis;
+	struct connection *st_connection;       /* connection for this SA */
+	const struct finite_state *st_state;	/* Current FSM state */
+	reqid_t st_reqid;			/* bundle of 4 (out,in, compout,compin */
+	/*const*/ enum sa_type st_establishing_sa;	/* where is this state going? */
+	enum sa_role st_sa_role;			/* who initiated the SA */
+	/* end of lookup fields */
+
+	/* all the hash table entries */
+	struct {
+		struct list_entry list;
+		struct list_entry serialno;
+		struct list_entry connection_serialno;
+		struct list_entry reqid;
+		struct list_entry ike_spis;
+		struct list_entry ike_initiator_spi;
+	} hash_table_entries;
+
+	realtime_t st_inception;		/* time state is created, for logging */
+	struct state_timing st_timing;		/* accumulative cpu time */
 
 	so_serial_t st_v1_ipsec_pred;		/* IKEv1: replacing established IPsec SA */
 	so_serial_t st_v2_ike_pred;		/* IKEv2: replacing established IKE SA */
@@ -320,12 +346,10 @@ struct state {
 	 * new_state() could use clone_thing(const state on stack).
 	 */
 #define st_ike_version st_connection->config->ike_version
-	/*const*/ enum sa_type st_establishing_sa;	/* where is this state going? */
 
 	bool st_ikev2_anon;                     /* is this an anonymous IKEv2 state? */
 	enum send_delete st_send_delete;	/* suppress or force sending DELETE */
 
-	struct connection *st_connection;       /* connection for this SA */
  	struct logger *st_logger;
 
 	struct trans_attrs st_oakley;
@@ -334,8 +358,6 @@ struct state {
 	struct ipsec_proto_info st_esp;
 	struct ipsec_proto_info st_ipcomp;
 
-	reqid_t st_reqid;			/* bundle of 4 (out,in, compout,compin */
-
 	bool st_outbound_done;			/* if true, then outgoing SA already installed */
 
 	const struct dh_desc *st_pfs_group;   /*group for Phase 2 PFS */
@@ -384,12 +406,19 @@ struct state {
 	 */
 	struct iface_endpoint *st_interface;  /* where to send from */
 
-	bool st_mobike_del_src_ip;		/* for mobike migrate unroute */
-	/* IKEv2 MOBIKE probe copies */
-	ip_address st_deleted_local_addr;	/* kernel deleted address */
-	ip_endpoint st_mobike_remote_endpoint;
-	ip_endpoint st_mobike_local_endpoint;	/* new address to initiate MOBIKE */
-	ip_address st_mobike_host_nexthop;	/* for updown script */
+	/*
+	 * IKEv2 MOBIKE probe copies.
+	 *
+	 * Allocated by v2_mobike() the first time an address changes;
+	 * states that never migrate don't pay for them.
+	 */
+	struct v2_mobike {
+		bool del_src_ip;		/* for mobike migrate unroute */
+		ip_address deleted_local_addr;	/* kernel deleted address */
+		ip_endpoint remote_endpoint;
+		ip_endpoint local_endpoint;	/* new address to initiate MOBIKE */
+		ip_address host_nexthop;	/* for updown script */
+	} *st_v2_mobike;
 
 	/** IKEv1-only things **/
 	/* XXX: union { struct { .. } v1; struct {...} v2;} st? */
@@ -416,11 +445,21 @@ struct state {
 	const struct state_v1_microcode *st_v1_last_transition;
 	const struct state_v1_microcode *st_v1_transition; /* anyone? */
 
-	/* Initialization Vectors for IKEv1 IKE encryption */
+	/*
+	 * Initialization Vectors for IKEv1 IKE encryption.
+	 *
+	 * Allocated by new_state() for IKEv1 states only; IKEv2
+	 * states don't pay for them.
+	 */
 
-	struct crypt_mac st_v1_new_iv;	/* tentative IV (calculated from current packet) */
-	struct crypt_mac st_v1_iv;		/* accepted IV (after packet passes muster) */
-	struct crypt_mac st_v1_ph1_iv;	/* IV at end of phase 1 */
+	struct v1_ivs {
+		struct crypt_mac new_iv;	/* tentative IV (calculated from current packet) */
+		struct crypt_mac iv;		/* accepted IV (after packet passes muster) */
+		struct crypt_mac ph1_iv;	/* IV at end of phase 1 */
+	} *st_v1_ivs;
+#define st_v1_new_iv st_v1_ivs->new_iv
+#define st_v1_iv st_v1_ivs->iv
+#define st_v1_ph1_iv st_v1_ivs->ph1_iv
 
 	/* end of IKEv1-only things */
 #endif
@@ -439,10 +478,7 @@ struct state {
 	bool st_viable_parent;	/* can initiate new CERAET_CHILD_SA */
 	struct ikev2_proposal *st_v2_accepted_proposal;
 	struct ikev2_proposals *st_v2_create_child_sa_proposals;
-
-	enum sa_role st_sa_role;			/* who initiated the SA */
-
-	struct v2_msgid_windows st_v2_msgid_windows;	/* IKE */
+	struct v2_resumption *st_v2_resumption;	/* RFC 5723; see ikev2_resume.c */
 
 	/* message ID sequence for things we send (as initiator) */
 	msgid_t st_msgid_lastack;               /* last one peer acknowledged - host order */
@@ -459,32 +495,14 @@ struct state {
 
 	chunk_t st_active_redirect_gw;		/* needed for sending of REDIRECT in informational */
 
-	/*
-	 * IKEv2 intermediate exchange.
-	 */
-
-	struct {
-		chunk_t initiator;	/* calculated from my last Intermediate Exchange packet */
-		chunk_t responder;	/* calculated from peers last Intermediate Exchange packet */
-		bool used;		/* both ends agree/use Intermediate Exchange */
-		uint32_t id;		/* ID of last IKE_INTERMEDIATE exchange */
-	} st_v2_ike_intermediate;
-
 	/** end of IKEv2-only things **/
 
-	/*
-	 * Identity sent across the wire in the ID[ir] payload as part
-	 * of authentication (proof of identity).
-	 */
-	struct v2_id_payload st_v2_id_payload;
-
 	char *st_seen_cfg_dns; /* obtained internal nameserver IP's */
 	char *st_seen_cfg_domains; /* obtained internal domain names */
 	char *st_seen_cfg_banner; /* obtained banner */
 
 	/* symmetric stuff */
 
-	ike_spis_t st_ike_spis;
 	ike_spis_t st_ike_rekey_spis;		/* what was exchanged */
 
 	/* initiator stuff */
@@ -567,8 +585,6 @@ struct state {
 	/* In a Phase 1 state, preserve peer's public key after authentication */
 	struct pubkey *st_peer_pubkey;
 
-	const struct finite_state *st_state;	/* Current FSM state */
-
 	/*
 	 * Account for why an SA is is started, established, and
 	 * finished (deleted).
@@ -675,8 +691,7 @@ struct state {
 	PK11SymKey *st_skey_pi_nss;	/* v2 PPK for initiator */
 	PK11SymKey *st_skey_pr_nss;	/* v2 PPK for responder */
 
-	struct eap_state  *st_eap;	/* v2 EAP */
-	struct msg_digest *st_eap_sa_md; /* v2 EAP initial message with SA request */
+	struct eap_state  *st_eap;	/* v2 EAP; includes initial SA request */
 
 	chunk_t st_skey_initiator_salt;	/* v2 */
 	chunk_t st_skey_responder_salt;	/* v2 */
@@ -695,24 +710,19 @@ struct state {
 	PK11SymKey *st_sk_pr_no_ppk;
 	PK11SymKey *st_enc_key_nss;	/* Oakley Encryption key */
 
-	/* all the hash table entries */
-	struct {
-		struct list_entry list;
-		struct list_entry serialno;
-		struct list_entry connection_serialno;
-		struct list_entry reqid;
-		struct list_entry ike_spis;
-		struct list_entry ike_initiator_spi;
-	} hash_table_entries;
-
 	struct hidden_variables hidden_variables;
 
-	char st_xauth_username[MAX_XAUTH_USERNAME_LEN];	/* NUL-terminated */
+	char *st_xauth_username;	/* NULL or NUL-terminated; see update_xauth_username() */
 	chunk_t st_xauth_password;
 
 	/*
 	 * Events for state object.  Some are shared between IKEv1 and
 	 * IKEv2, some are not.
+	 *
+	 * These stay inline: every state arms st_event and, once
+	 * established, its lifetime event (IKEv2 also its refresh
+	 * event) so a side structure would add an allocation to each
+	 * state to save a few pointers.
 	 */
 
 	struct state_event *st_event;			/* generic timer event for one-off events */
@@ -787,7 +797,39 @@ struct state {
  * NULL.
  */
 
-struct ike_sa { struct state sa; };
+struct ike_sa {
+	struct state sa;
+
+	/*
+	 * IKEv2 IKE SA only.
+	 *
+	 * These live past the end of struct state so that a Child SA,
+	 * which is allocated as just a struct child_sa, doesn't carry
+	 * them.  A rekeyed IKE SA starts out looking like a child but
+	 * is allocated as an IKE SA (.st_establishing_sa == IKE_SA)
+	 * so these are available from the start.
+	 */
+
+	struct v2_msgid_windows st_v2_msgid_windows;
+
+	/*
+	 * IKEv2 intermediate exchange.
+	 */
+
+	struct {
+		chunk_t initiator;	/* calculated from my last Intermediate Exchange packet */
+		chunk_t responder;	/* calculated from peers last Intermediate Exchange packet */
+		bool used;		/* both ends agree/use Intermediate Exchange */
+		uint32_t id;		/* ID of last IKE_INTERMEDIATE exchange */
+	} st_v2_ike_intermediate;
+
+	/*
+	 * Identity sent across the wire in the ID[ir] payload as part
+	 * of authentication (proof of identity).
+	 */
+	struct v2_id_payload st_v2_id_payload;
+};
+
 struct ike_sa *ike_sa(struct state *st, where_t where);
 struct ike_sa *pexpect_ike_sa_where(struct state *st, where_t where);
 #define pexpect_ike_sa(ST) pexpect_ike_sa_where(ST, HERE)
@@ -826,6 +868,8 @@ struct child_sa *new_v2_child_state(struct connection *c,
 				    enum sa_role sa_role,
 				    enum state_kind kind,
 				    struct fd *whackfd);
+/* allocate .st_v2_mobike on first use */
+struct v2_mobike *v2_mobike(struct state *st);
 
 void set_v1_transition(struct state *st, const struct state_v1_microcode *transition, where_t where);
 void set_v2_transition(struct state *st, const struct v2_state_transition *transition, where_t where);
@@ -875,6 +919,7 @@ extern void initialize_new_state(struct state *st,
 extern void show_traffic_status(struct show *s, const char *name);
 extern void show_brief_status(struct show *s);
 extern void show_states(struct show *s, const monotime_t now);
+extern void show_state_memory(struct show *s);
 
 void v2_migrate_children(struct ike_sa *from, struct child_sa *to);
 
@@ -884,6 +929,7 @@ extern ipsec_spi_t uniquify_peer_cpi(ipsec_spi_t cpi, const struct state *st, in
 extern void delete_states_by_peer(const struct fd *whackfd, const ip_address *peer);
 extern void replace_states_by_peer(const ip_address *peer);
 extern void v1_delete_state_by_username(struct state *st, const char *name);
+extern void update_xauth_username(struct state *st, const char *name);
 extern void delete_state_by_id_name(struct state *st, const char *name);
 
 extern void delete_cryptographic_continuation(struct state *st);
@@ -27,6 +27,7 @@
  *
  */
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -69,6 +70,7 @@
 #include "root_certs.h"
 #include "iface.h"
 #include "show.h"
+#include "hash_table.h"		/* for hash_hunk() */
 
 /* new NSS code */
 #include "pluto_x509.h"
@@ -186,44 +188,74 @@ static void same_nss_gn_as_pluto_gn(CERTGeneralName *nss_gn,
 }
 
 /*
- * Checks if CA a is trusted by CA b
- * This very well could end up being condensed into
- * an NSS call or two. TBD.
+ * Remembered trusted_ca() results.
+ *
+ * Deciding if CA A is trusted by CA B means walking A's issuer chain
+ * using CERT_FindCertByName(), and that is done for each candidate
+ * key and for each connection considered when refining the peer's
+ * connection.  The answer only depends on the CA certificates in the
+ * NSS DB so remember it, keyed by the two DNs.
+ *
+ * Only walks that visited nothing but permanent certificates and
+ * ended at B, a root, or MAX_CA_PATH_LEN are remembered; a chain
+ * that needs (or failed to find) a certificate is left alone since
+ * a peer's temporary intermediate can change the answer.
+ *
+ * Everything is flushed when the root certificates are reloaded,
+ * when the certificates are re-read, and when a CRL is imported
+ * (from the fetch thread, hence the lock).
  */
-bool trusted_ca(asn1_t a, asn1_t b, int *pathlen)
-{
-	if (DBGP(DBG_BASE)) {
-		if (a.ptr != NULL) {
-			dn_buf abuf;
-	    		DBG_log("%s: trustee A = '%s'", __func__,
-				str_dn(a, &abuf));
-		}
-		if (b.ptr != NULL) {
-			dn_buf bbuf;
-	    		DBG_log("%s: trustor B = '%s'", __func__,
-				str_dn(b, &bbuf));
-		}
-	}
 
-	/* no CA b specified => any CA a is accepted */
-	if (b.ptr == NULL) {
-		*pathlen = (a.ptr == NULL) ? 0 : MAX_CA_PATH_LEN;
-		return true;
-	}
+#define TRUSTED_CA_CACHE_SIZE 64
 
-	/* no CA a specified => trust cannot be established */
-	if (a.ptr == NULL) {
-		*pathlen = MAX_CA_PATH_LEN;
-		return false;
-	}
+struct trusted_ca_entry {
+	chunk_t a;
+	chunk_t b;
+	bool trusted;
+	int pathlen;
+};
 
-	*pathlen = 0;
+static struct {
+	pthread_mutex_t mutex;
+	struct trusted_ca_entry entries[TRUSTED_CA_CACHE_SIZE];
+} trusted_ca_cache = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
 
-	/* CA a equals CA b => we have a match */
-	if (same_dn(a, b)) {
-		return true;
+static struct trusted_ca_entry *trusted_ca_slot(asn1_t a, asn1_t b)
+{
+	hash_t hash = hash_hunk(b, hash_hunk(a, zero_hash));
+	return &trusted_ca_cache.entries[hash.hash % TRUSTED_CA_CACHE_SIZE];
+}
+
+static void flush_trusted_ca_entry(struct trusted_ca_entry *entry)
+{
+	free_chunk_content(&entry->a);
+	free_chunk_content(&entry->b);
+	zero(entry);
+}
+
+void flush_trusted_ca_cache(const char *reason)
+{
+	unsigned nr = 0;
+	pthread_mutex_lock(&trusted_ca_cache.mutex);
+	FOR_EACH_ELEMENT(entry, trusted_ca_cache.entries) {
+		if (entry->a.ptr != NULL) {
+			flush_trusted_ca_entry(entry);
+			nr++;
+		}
 	}
+	pthread_mutex_unlock(&trusted_ca_cache.mutex);
+	dbg("trusted CA cache: flushed %u entries: %s", nr, reason);
+}
 
+/*
+ * Walk A's issuer chain looking for B.  Sets CACHEABLE when the
+ * result is worth remembering.
+ */
+
+static bool find_trusted_ca(asn1_t a, asn1_t b, int *pathlen, bool *cacheable)
+{
 	/*
 	 * CERT_GetDefaultCertDB() simply returns the contents of a
 	 * static variable set by NSS_Initialize().  It doesn't check
@@ -237,11 +269,16 @@ bool trusted_ca(asn1_t a, asn1_t b, int *pathlen)
 
 	bool match = false;
 	CERTCertificate *cacert = NULL;
+	*cacheable = true;
 
 	while ((*pathlen)++ < MAX_CA_PATH_LEN) {
 		SECItem a_dn = same_shunk_as_dercert_secitem(a);
 		cacert = CERT_FindCertByName(handle, &a_dn);
 
+		if (cacert == NULL || !cacert->isperm) {
+			*cacheable = false;
+		}
+
 		/* cacert not found or self-signed root cacert => exit */
 		if (cacert == NULL || CERT_IsRootDERCert(&cacert->derCert)) {
 			break;
@@ -263,12 +300,87 @@ bool trusted_ca(asn1_t a, asn1_t b, int *pathlen)
 		cacert = NULL;
 	}
 
+	if (cacert != NULL) {
+		CERT_DestroyCertificate(cacert);
+	}
+	return match;
+}
+
+/*
+ * Checks if CA a is trusted by CA b
+ * This very well could end up being condensed into
+ * an NSS call or two. TBD.
+ */
+bool trusted_ca(asn1_t a, asn1_t b, int *pathlen)
+{
+	if (DBGP(DBG_BASE)) {
+		if (a.ptr != NULL) {
+			dn_buf abuf;
+	    		DBG_log("%s: trustee A = '%s'", __func__,
+				str_dn(a, &abuf));
+		}
+		if (b.ptr != NULL) {
+			dn_buf bbuf;
+	    		DBG_log("%s: trustor B = '%s'", __func__,
+				str_dn(b, &bbuf));
+		}
+	}
+
+	/* no CA b specified => any CA a is accepted */
+	if (b.ptr == NULL) {
+		*pathlen = (a.ptr == NULL) ? 0 : MAX_CA_PATH_LEN;
+		return true;
+	}
+
+	/* no CA a specified => trust cannot be established */
+	if (a.ptr == NULL) {
+		*pathlen = MAX_CA_PATH_LEN;
+		return false;
+	}
+
+	*pathlen = 0;
+
+	/* CA a equals CA b => we have a match */
+	if (same_dn(a, b)) {
+		return true;
+	}
+
+	bool match;
+	bool found = false;
+	struct trusted_ca_entry *entry = trusted_ca_slot(a, b);
+
+	pthread_mutex_lock(&trusted_ca_cache.mutex);
+	if (hunk_eq(entry->a, a) && hunk_eq(entry->b, b)) {
+		match = entry->trusted;
+		*pathlen = entry->pathlen;
+		found = true;
+	}
+	pthread_mutex_unlock(&trusted_ca_cache.mutex);
+
+	if (found) {
+		dbg("%s: remembered %s at pathlen %d",
+		    __func__, match ? "trusted" : "untrusted", *pathlen);
+		return match;
+	}
+
+	bool cacheable;
+	match = find_trusted_ca(a, b, pathlen, &cacheable);
+
 	dbg("%s: returning %s at pathlen %d",
 	    __func__, match ? "trusted" : "untrusted", *pathlen);
 
-	if (cacert != NULL) {
-		CERT_DestroyCertificate(cacert);
+	if (cacheable) {
+		pthread_mutex_lock(&trusted_ca_cache.mutex);
+		flush_trusted_ca_entry(entry);
+		*entry = (struct trusted_ca_entry) {
+			.a = clone_hunk(a, "trusted CA A"),
+			.b = clone_hunk(b, "trusted CA B"),
+			.trusted = match,
+			.pathlen = *pathlen,
+		};
+		pthread_mutex_unlock(&trusted_ca_cache.mutex);
 	}
+
 	return match;
 }
 
@@ -696,13 +808,14 @@ bool remote_has_preloaded_pubkey(const struct state *st)
 	 */
 	if (c->kind == CK_PERMANENT) {
 		/* look for a matching RSA public key */
-		for (const struct pubkey_list *p = pluto_pubkeys; p != NULL;
-		     p = p->next) {
-			const struct pubkey *key = p->key;
+		struct preloaded_pubkey_filter pkf = {
+			.id = &c->remote->host.id,
+		};
+		while (next_preloaded_pubkey(&pkf)) {
+			const struct pubkey *key = pkf.key;
 
 			if ((key->content.type == &pubkey_type_rsa ||
 			     key->content.type == &pubkey_type_ecdsa) &&
-			    same_id(&c->remote->host.id, &key->id) &&
 			    is_realtime_epoch(key->until_time)) {
 				/* found a preloaded public key */
 				return true;
@@ -104,6 +104,7 @@ static void help(void)
 		"	[--rekeymargin <seconds>] [--rekeyfuzz <percentage>] \\\n"
 		"	[--retransmit-timeout <seconds>] \\\n"
 		"	[--retransmit-interval <msecs>] \\\n"
+		"	[--ikewindow <exchanges>] \\\n"
 		"	[--send-redirect] [--redirect-to <ip>] \\\n"
 		"	[--accept-redirect] [--accept-redirect-to <ip>] \\\n"
 		"	[--keyingtries <count>] \\\n"
@@ -204,7 +205,7 @@ static void help(void)
 		"\n"
 		"status: whack [--status] | [--trafficstatus] | [--globalstatus] | \\\n"
 		"	[--clearstats] | [--shuntstatus] | [--fipsstatus] | [--briefstatus] \n"
-		"	[--showstates] | [--addresspoolstatus] [--processstatus]\n"
+		"	[--showstates] | [--addresspoolstatus] [--processstatus] | [--memory]\n"
 		"\n"
 		"refresh dns: whack --ddns\n"
 		"\n"
@@ -342,6 +343,7 @@ enum option_enums {
 	OPT_FIPS_STATUS,
 	OPT_BRIEF_STATUS,
 	OPT_PROCESS_STATUS,
+	OPT_MEMORY_STATUS,
 
 #ifdef USE_SECCOMP
 	OPT_SECCOMP_CRASHTEST,
@@ -483,7 +485,11 @@ enum option_enums {
 	CD_NIC_OFFLOAD,
 	CD_ESP,
 	CD_INTERMEDIATE,
-#   define CD_LAST CD_INTERMEDIATE	/* last connection description */
+#   define CD_LAST CD_INTERMEDIATE	/* last connection description, range 1 */
+
+#   define CD_FIRST2 CD_IKE_WINDOW	/* first connection description, range 2 */
+	CD_IKE_WINDOW,
+#   define CD_LAST2 CD_IKE_WINDOW	/* last connection description, range 2 */
 
 /*
  * Proof-of-identity options (just because CD_ was full) that fill in
@@ -629,6 +635,7 @@ static const struct option long_opts[] = {
 	{ "fipsstatus", no_argument, NULL, OPT_FIPS_STATUS + OO },
 	{ "briefstatus", no_argument, NULL, OPT_BRIEF_STATUS + OO },
 	{ "processstatus", no_argument, NULL, OPT_PROCESS_STATUS + OO },
+	{ "memory", no_argument, NULL, OPT_MEMORY_STATUS + OO },
 	{ "showstates", no_argument, NULL, OPT_SHOW_STATES + OO },
 #ifdef USE_SECCOMP
 	{ "seccomp-crashtest", no_argument, NULL, OPT_SECCOMP_CRASHTEST + OO },
@@ -763,6 +770,7 @@ static const struct option long_opts[] = {
 	{ "send-no-esp-tfc", no_argument, NULL, CD_SEND_TFCPAD + OO },
 	{ "reqid", required_argument, NULL, CD_REQID + OO + NUMERIC_ARG },
 	{ "nflog-group", required_argument, NULL, CD_NFLOG_GROUP + OO + NUMERIC_ARG },
+	{ "ikewindow", required_argument, NULL, CD_IKE_WINDOW + OO + NUMERIC_ARG },
 	{ "conn-mark", required_argument, NULL, CD_CONN_MARK_BOTH + OO },
 	{ "conn-mark-in", required_argument, NULL, CD_CONN_MARK_IN + OO },
 	{ "conn-mark-out", required_argument, NULL, CD_CONN_MARK_OUT + OO },
@@ -1024,6 +1032,7 @@ int main(int argc, char **argv)
 		opts2_seen = LEMPTY,
 		lst_seen = LEMPTY,
 		cd_seen = LEMPTY,
+		cd2_seen = LEMPTY,
 		cdp_seen = LEMPTY,
 		end_seen = LEMPTY,
 		algo_seen = LEMPTY;
@@ -1043,6 +1052,7 @@ int main(int argc, char **argv)
 	assert(LST_LAST - LST_FIRST < LELEM_ROOF);
 	assert(END_LAST - END_FIRST < LELEM_ROOF);
 	assert(CD_LAST - CD_FIRST < LELEM_ROOF);
+	assert(CD_LAST2 - CD_FIRST2 < LELEM_ROOF);
 	assert(OPT_AUTHBY_LAST - OPT_AUTHBY_FIRST < LELEM_ROOF);
 
 	zero(&msg);	/* ??? pointer fields might not be NULLed */
@@ -1206,6 +1216,19 @@ int main(int argc, char **argv)
 				      long_opts[long_index].name);
 			cd_seen |= f;
 			opts1_seen |= LELEM(OPT_CD);
+		} else if (CD_FIRST2 <= c && c <= CD_LAST2) {
+			/*
+			 * CD_* options, range 2, are added to cd2_seen.
+			 * Reject repeated options (unless later code
+			 * intervenes).
+			 */
+			lset_t f = LELEM(c - CD_FIRST2);
+
+			if (cd2_seen & f)
+				diagq("duplicated flag",
+				      long_opts[long_index].name);
+			cd2_seen |= f;
+			opts1_seen |= LELEM(OPT_CD);
 		} else if (CDP_FIRST <= c && c <= CDP_LAST) {
 			/*
 			 * CDP_* options are added to cdp_seen.
@@ -1516,6 +1539,11 @@ int main(int argc, char **argv)
 			ignore_errors = true;
 			continue;
 
+		case OPT_MEMORY_STATUS:	/* --memory */
+			msg.whack_memory_status = true;
+			ignore_errors = true;
+			continue;
+
 		case OPT_SHOW_STATES:	/* --showstates */
 			msg.whack_show_states = true;
 			ignore_errors = true;
@@ -2371,6 +2399,19 @@ int main(int argc, char **argv)
 			msg.nflog_group = opt_whole;
 			continue;
 
+		case CD_IKE_WINDOW:	/* --ikewindow */
+			if (opt_whole <= 0  ||
+			    opt_whole > IKE_V2_MAX_WINDOW_SIZE) {
+				char buf[120];
+
+				snprintf(buf, sizeof(buf),
+					"invalid ikewindow value - range must be 1-%d \"%s\"",
+					IKE_V2_MAX_WINDOW_SIZE, optarg);
+				diagw(buf);
+			}
+			msg.ike_window = opt_whole;
+			continue;
+
 		case CD_REQID:	/* --reqid */
 			if (opt_whole <= 0  ||
 			    opt_whole > IPSEC_MANUAL_REQID_MAX) {
@@ -2546,7 +2587,8 @@ int main(int argc, char **argv)
 		msg.whack_oppo_initiate = true;
 		if (LIN(cd_seen,
 			LELEM(CD_TUNNELIPV4 -
-			      CD_FIRST) | LELEM(CD_TUNNELIPV6 - CD_FIRST)))
+			      CD_FIRST) | LELEM(CD_TUNNELIPV6 - CD_FIRST)) &&
+		    cd2_seen == LEMPTY)
 			opts1_seen &= ~LELEM(OPT_CD);
 		break;
 	}
@@ -2641,7 +2683,7 @@ int main(int argc, char **argv)
 	      msg.whack_reread || msg.whack_crash || msg.whack_shunt_status ||
 	      msg.whack_status || msg.whack_global_status || msg.whack_traffic_status ||
 	      msg.whack_addresspool_status ||
-	      msg.whack_process_status ||
+	      msg.whack_process_status || msg.whack_memory_status ||
 	      msg.whack_fips_status || msg.whack_brief_status || msg.whack_clear_stats || msg.whack_options ||
 	      msg.whack_shutdown || msg.whack_purgeocsp || msg.whack_seccomp_crashtest || msg.whack_show_states ||
 	      msg.whack_rekey_ike || msg.whack_rekey_ipsec ||
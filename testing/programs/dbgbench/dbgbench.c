@@ -0,0 +1,221 @@
+/* debug logging fast path benchmark, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * With debugging off, what does a packet pay for the dbg() calls
+ * along its path?
+ *
+ * Each "packet" mimics the look-up done by process_md() ->
+ * v2_state_transition(): a walk over a table of transitions where
+ * each rejected transition is explained with dbg()s that format an
+ * enum name, and the packet's endpoint is logged on the way in.
+ * The same walk is timed:
+ *
+ *   no-dbg:     with the dbg()s compiled out (the floor)
+ *   dbg:        using dbg() / LDBGP() (DBGP() with a branch hint)
+ *   unhinted:   using the previous DBGP() (no branch hint)
+ *
+ * The process is pinned to one CPU and the three walks are timed in
+ * interleaved rounds; the median, minimum and maximum of the rounds
+ * are reported.  A disabled dbg() costs a load and a branch; the
+ * few ns between the walks are of the same order as the spread
+ * between rounds, so don't read anything into a single run.  The
+ * branch hint is there for code layout, not because this shows a
+ * speed-up.  What the program is for is spotting a change that makes
+ * a disabled dbg() expensive.
+ *
+ * This is not process_md() itself; that can't be linked into a test
+ * program.
+ */
+
+#define _GNU_SOURCE	/* sched_setaffinity() */
+#include <sched.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "lswtool.h"
+#include "lswlog.h"
+#include "constants.h"
+#include "ip_endpoint.h"
+#include "ip_info.h"
+#include "ip_protocol.h"
+
+#define NR_TRANSITIONS 16
+
+struct transition {
+	unsigned exchange;
+	const char *story;
+};
+
+static struct transition transitions[NR_TRANSITIONS];
+static volatile unsigned sink;
+
+/* the historic DBGP(), without UNLIKELY() */
+#define UNHINTED_DBGP(COND) (cur_debugging & (COND))
+#define unhinted_dbg(MESSAGE, ...)				\
+	{							\
+		if (UNHINTED_DBGP(DBG_BASE)) {			\
+			DBG_log(MESSAGE, ##__VA_ARGS__);	\
+		}						\
+	}
+
+static unsigned walk_no_dbg(unsigned exchange, const ip_endpoint *from UNUSED)
+{
+	for (unsigned i = 0; i < NR_TRANSITIONS; i++) {
+		if (transitions[i].exchange != exchange) {
+			continue;
+		}
+		return i;
+	}
+	return NR_TRANSITIONS;
+}
+
+static unsigned walk_dbg(unsigned exchange, const ip_endpoint *from,
+			 struct logger *logger)
+{
+	LDBGP(logger, DBG_BASE, buf) {
+		jam(buf, "looking for transition matching packet from ");
+		jam_endpoint(buf, from);
+	}
+	for (unsigned i = 0; i < NR_TRANSITIONS; i++) {
+		dbg("  trying: %s", transitions[i].story);
+		if (transitions[i].exchange != exchange) {
+			enum_buf xb;
+			dbg("    exchange type does not match %s",
+			    str_enum_short(&ikev2_exchange_names,
+					   transitions[i].exchange, &xb));
+			continue;
+		}
+		return i;
+	}
+	return NR_TRANSITIONS;
+}
+
+static unsigned walk_unhinted(unsigned exchange, const ip_endpoint *from)
+{
+	if (UNHINTED_DBGP(DBG_BASE)) {
+		endpoint_buf eb;
+		DBG_log("looking for transition matching packet from %s",
+			str_endpoint(from, &eb));
+	}
+	for (unsigned i = 0; i < NR_TRANSITIONS; i++) {
+		unhinted_dbg("  trying: %s", transitions[i].story);
+		if (transitions[i].exchange != exchange) {
+			enum_buf xb;
+			unhinted_dbg("    exchange type does not match %s",
+				     str_enum_short(&ikev2_exchange_names,
+						    transitions[i].exchange, &xb));
+			continue;
+		}
+		return i;
+	}
+	return NR_TRANSITIONS;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+enum walk { NO_DBG, DBG, UNHINTED, };
+#define NR_WALKS (UNHINTED + 1)
+static const char *walk_name[] = {
+	[NO_DBG] = "no-dbg",
+	[DBG] = "dbg",
+	[UNHINTED] = "unhinted",
+};
+
+static double bench(enum walk walk, unsigned long nr_packets,
+		    const ip_endpoint *from, struct logger *logger)
+{
+	double start = now();
+	for (unsigned long p = 0; p < nr_packets; p++) {
+		/* last transition matches; worst case */
+		unsigned exchange = ISAKMP_v2_INFORMATIONAL;
+		switch (walk) {
+		case NO_DBG: sink = walk_no_dbg(exchange, from); break;
+		case DBG: sink = walk_dbg(exchange, from, logger); break;
+		case UNHINTED: sink = walk_unhinted(exchange, from); break;
+		}
+	}
+	return (now() - start) / nr_packets;
+}
+
+static int cmp_double(const void *l, const void *r)
+{
+	double ld = *(const double *)l;
+	double rd = *(const double *)r;
+	return (ld < rd ? -1 : ld > rd ? 1 : 0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct logger *logger = tool_init_log(argv[0]);
+	unsigned long nr_packets = (argc > 1 ? strtoul(argv[1], NULL, 0) : 2000000);
+	unsigned nr_rounds = (argc > 2 ? strtoul(argv[2], NULL, 0) : 15);
+	if (nr_rounds == 0 || nr_rounds > 1000) {
+		fprintf(stderr, "%s: rounds must be 1..1000\n", argv[0]);
+		exit(1);
+	}
+
+	/* keep the walks on one CPU so they see the same caches */
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(sched_getcpu() < 0 ? 0 : sched_getcpu(), &cpus);
+	bool pinned = (sched_setaffinity(0, sizeof(cpus), &cpus) == 0);
+
+	for (unsigned i = 0; i < NR_TRANSITIONS; i++) {
+		transitions[i].exchange = (i + 1 == NR_TRANSITIONS ?
+					   ISAKMP_v2_INFORMATIONAL :
+					   ISAKMP_v2_CREATE_CHILD_SA);
+		transitions[i].story = "Initiator: process IKE_SA_INIT response";
+	}
+	ip_address a = ipv4_info.address.loopback;
+	ip_endpoint from = endpoint_from_address_protocol_port(a, &ip_protocol_udp,
+							       ip_hport(500));
+
+	/* debugging off: nothing should be logged */
+	cur_debugging = DBG_NONE;
+
+	/* warm up */
+	for (enum walk w = 0; w < NR_WALKS; w++) {
+		bench(w, nr_packets / 10 + 1, &from, logger);
+	}
+
+	/* interleave the walks so drift hits each of them alike */
+	double *ns[NR_WALKS];
+	for (enum walk w = 0; w < NR_WALKS; w++) {
+		ns[w] = calloc(nr_rounds, sizeof(double));
+	}
+	for (unsigned r = 0; r < nr_rounds; r++) {
+		for (enum walk w = 0; w < NR_WALKS; w++) {
+			ns[w][r] = bench(w, nr_packets, &from, logger);
+		}
+	}
+
+	printf("%lu packets x %u rounds%s\n", nr_packets, nr_rounds,
+	       pinned ? ", pinned" : ", not pinned");
+	printf("%-10s %8s %8s %8s  ns/packet\n", "", "median", "min", "max");
+	for (enum walk w = 0; w < NR_WALKS; w++) {
+		qsort(ns[w], nr_rounds, sizeof(double), cmp_double);
+		printf("%-10s %8.1f %8.1f %8.1f\n", walk_name[w],
+		       ns[w][nr_rounds / 2], ns[w][0], ns[w][nr_rounds - 1]);
+		free(ns[w]);
+	}
+	return 0;
+}
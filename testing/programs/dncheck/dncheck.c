@@ -256,12 +256,85 @@ static void dn_check(void)
 	}
 }
 
+static void match_check(void)
+{
+	static const struct test {
+		const char *a;
+		const char *b;
+		bool same;
+		bool match;
+		int wildcards;
+	} tests[] = {
+		/* identical */
+		{ "CN=west, O=Acme", "CN=west, O=Acme", true, true, 0, },
+		/* printableString ignores case */
+		{ "CN=West, O=Acme", "CN=west, O=acme", true, true, 0, },
+		/* same length, different value */
+		{ "CN=west, O=Acme", "CN=east, O=Acme", false, false, 0, },
+		/* any order */
+		{ "CN=west, O=Acme", "O=Acme, CN=west", false, true, 0, },
+		{ "CN=west, O=Acme", "O=acme, CN=WEST", false, true, 0, },
+		/* A can have RDNs that B doesn't */
+		{ "C=CA, O=Acme, CN=west", "CN=west, O=Acme", false, true, 0, },
+		{ "CN=west, O=Acme", "C=CA, O=Acme, CN=west", false, false, 0, },
+		/* wildcards */
+		{ "CN=west, O=Acme", "CN=*, O=Acme", false, true, 1, },
+		{ "CN=west, O=Acme", "O=Acme, CN=*", false, true, 1, },
+		{ "CN=west, O=Acme", "CN=*, O=Widgets", false, false, 0, },
+		{ "CN=*, O=Acme", "CN=*, O=Acme", true, true, 1, },
+		/* escaped values skip the summary */
+		{ "CN=we\\,st, O=Acme", "O=Acme, CN=we\\,st", false, true, 0, },
+		{ "CN=we#st, O=Acme", "CN=ea#st, O=Acme", false, false, 0, },
+	};
+
+	for (size_t ti = 0; ti < elemsof(tests); ti++) {
+		const struct test *t = &tests[ti];
+		PRINT(stdout, " '%s' vs '%s'", t->a, t->b);
+
+		chunk_t a, b;
+		err_t err = atodn(t->a, &a);
+		if (err != NULL) {
+			FAIL(" atodn('%s') failed: %s", t->a, err);
+		}
+		err = atodn(t->b, &b);
+		if (err != NULL) {
+			free_chunk_content(&a);
+			FAIL(" atodn('%s') failed: %s", t->b, err);
+		}
+
+		/* twice, the second time the summaries are cached */
+		for (unsigned pass = 0; pass < 2; pass++) {
+			bool same = same_dn(ASN1(a), ASN1(b));
+			if (same != t->same) {
+				PRINT(stderr, " pass %u same_dn() returned %s, expecting %s",
+				      pass, bool_str(same), bool_str(t->same));
+				fails++;
+			}
+			int wildcards = -1;
+			bool match = match_dn_any_order_wild("", ASN1(a), ASN1(b), &wildcards);
+			if (match != t->match) {
+				PRINT(stderr, " pass %u match_dn_any_order_wild() returned %s, expecting %s",
+				      pass, bool_str(match), bool_str(t->match));
+				fails++;
+			} else if (match && wildcards != t->wildcards) {
+				PRINT(stderr, " pass %u match_dn_any_order_wild() returned %d wildcards, expecting %d",
+				      pass, wildcards, t->wildcards);
+				fails++;
+			}
+		}
+
+		free_chunk_content(&a);
+		free_chunk_content(&b);
+	}
+}
+
 int main(int argc UNUSED, char *argv[])
 {
 	leak_detective = true;
 	struct logger *logger = tool_init_log(argv[0]);
 
 	dn_check();
+	match_check();
 
 	if (report_leaks(logger)) {
 		fails++;
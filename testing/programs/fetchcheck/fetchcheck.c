@@ -0,0 +1,491 @@
+/* CRL fetch check, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Drive pluto's CRL fetcher (fetch.c) against a local HTTP server.
+ *
+ * The fetch thread is started as pluto would start it; the CRL queue
+ * below is replaced by a script that hands fetch_crls() one round of
+ * jobs at a time and checks what happened: which jobs yielded a CRL,
+ * what was passed to the NSS import, and what whack --listcrls would
+ * show.  NSS is stubbed out: the "CRL" is any ASN.1 SEQUENCE.
+ *
+ * The server answers:
+ *
+ *   /crl       a DER CRL with an ETag, or 304 when If-None-Match matches
+ *   /crl.pem   the same CRL PEM encoded
+ *   /error     500
+ *   /garbage   200 with a body that isn't ASN.1
+ *   /slow      nothing, until the client gives up
+ */
+
+#define _GNU_SOURCE	/* strcasestr() */
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "lswtool.h"
+#include "lswlog.h"
+#include "constants.h"
+#include "impair.h"
+
+#include "defs.h"
+#include "log.h"
+#include "x509.h"
+#include "fetch.h"
+#include "crl_queue.h"
+#include "nss_crl_import.h"
+#include "keys.h"
+#include "timer.h"
+#include "show.h"
+#include "pluto_shutdown.h"
+
+static unsigned fails;
+
+#define FAIL(FMT, ...)							\
+	{								\
+		fails++;						\
+		fprintf(stderr, "FAIL: %s: "FMT"\n",			\
+			__func__, ##__VA_ARGS__);			\
+	}
+
+static const uint8_t crl_der[] = { 0x30, 0x03, 0x02, 0x01, 0x01, };
+static const char crl_pem[] =
+	"-----BEGIN X509 CRL-----\n"
+	"MAMCAQE=\n"
+	"-----END X509 CRL-----\n";
+#define CRL_ETAG "\"v1\""
+
+/*
+ * The local HTTP server; one thread per connection so that /slow
+ * doesn't hold up the others.
+ */
+
+static int listen_fd = -1;
+static in_port_t server_port;
+static volatile bool server_stopping;
+static unsigned nr_requests;
+static unsigned nr_conditional_requests;
+
+static void send_string(int fd, const char *s, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = send(fd, s, len, MSG_NOSIGNAL);
+		if (n <= 0) {
+			return;
+		}
+		s += n;
+		len -= n;
+	}
+}
+
+static void respond(int fd, const char *status, const char *headers,
+		    const void *body, size_t len)
+{
+	char head[256];
+	int n = snprintf(head, sizeof(head),
+			 "HTTP/1.1 %s\r\n%sContent-Length: %zu\r\nConnection: close\r\n\r\n",
+			 status, headers, len);
+	send_string(fd, head, n);
+	send_string(fd, body, len);
+}
+
+static void *serve_connection(void *arg)
+{
+	int fd = (int)(intptr_t)arg;
+	char request[2048];
+	size_t len = 0;
+	while (len < sizeof(request) - 1) {
+		ssize_t n = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+		if (n <= 0) {
+			break;
+		}
+		len += n;
+		request[len] = '\0';
+		if (strstr(request, "\r\n\r\n") != NULL) {
+			break;
+		}
+	}
+	request[len] = '\0';
+	__atomic_add_fetch(&nr_requests, 1, __ATOMIC_RELAXED);
+
+	char path[64] = "";
+	sscanf(request, "GET %63s", path);
+	bool not_modified = (strcasestr(request, "If-None-Match: " CRL_ETAG) != NULL);
+	if (strcasestr(request, "If-None-Match:") != NULL ||
+	    strcasestr(request, "If-Modified-Since:") != NULL) {
+		__atomic_add_fetch(&nr_conditional_requests, 1, __ATOMIC_RELAXED);
+	}
+
+	if (streq(path, "/crl")) {
+		if (not_modified) {
+			respond(fd, "304 Not Modified", "ETag: " CRL_ETAG "\r\n", "", 0);
+		} else {
+			respond(fd, "200 OK", "ETag: " CRL_ETAG "\r\n",
+				crl_der, sizeof(crl_der));
+		}
+	} else if (streq(path, "/crl.pem")) {
+		respond(fd, "200 OK", "", crl_pem, strlen(crl_pem));
+	} else if (streq(path, "/error")) {
+		respond(fd, "500 Internal Server Error", "", "oops", 4);
+	} else if (streq(path, "/garbage")) {
+		static const char garbage[] = "this is not a CRL";
+		respond(fd, "200 OK", "", garbage, strlen(garbage));
+	} else if (streq(path, "/slow")) {
+		/* say nothing until the client gives up */
+		for (unsigned i = 0; i < 100 && !server_stopping; i++) {
+			usleep(100 * 1000);
+		}
+	} else {
+		respond(fd, "404 Not Found", "", "", 0);
+	}
+	close(fd);
+	return NULL;
+}
+
+static void *server_thread(void *arg UNUSED)
+{
+	while (!server_stopping) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0) {
+			continue;
+		}
+		pthread_t t;
+		if (pthread_create(&t, NULL, serve_connection, (void *)(intptr_t)fd) != 0) {
+			close(fd);
+			continue;
+		}
+		pthread_detach(t);
+	}
+	return NULL;
+}
+
+static pthread_t server_thread_id;
+
+static void start_server(void)
+{
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in sin = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t sin_len = sizeof(sin);
+	if (listen_fd < 0 ||
+	    bind(listen_fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 ||
+	    listen(listen_fd, 16) < 0 ||
+	    getsockname(listen_fd, (struct sockaddr *)&sin, &sin_len) < 0) {
+		fprintf(stderr, "fetchcheck: cannot start HTTP server: %s\n", strerror(errno));
+		exit(1);
+	}
+	server_port = ntohs(sin.sin_port);
+	pthread_create(&server_thread_id, NULL, server_thread, NULL);
+}
+
+static void stop_server(void)
+{
+	server_stopping = true;
+	shutdown(listen_fd, SHUT_RDWR);
+	pthread_join(server_thread_id, NULL);
+	close(listen_fd);
+}
+
+/*
+ * What pluto would otherwise provide.
+ */
+
+volatile bool exiting_pluto;
+deltatime_t crl_check_interval;
+char *curl_iface;
+long curl_timeout = 1;	/* seconds */
+
+static bool have_crl;		/* NSS has a CRL for the issuer */
+static bool crl_is_current;	/* ... and it is the one fetched */
+static unsigned nr_imports;
+static double last_import;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int send_crl_to_import(uint8_t *der, size_t len, const char *url UNUSED,
+		       struct logger *logger UNUSED)
+{
+	if (len != sizeof(crl_der) || memcmp(der, crl_der, len) != 0) {
+		FAIL("imported %zu bytes that are not the CRL", len);
+	}
+	nr_imports++;
+	last_import = now();
+	have_crl = true;
+	return 0;
+}
+
+bool nss_has_crl(chunk_t issuer_dn UNUSED)
+{
+	return have_crl;
+}
+
+bool nss_crl_is_current(const uint8_t *der UNUSED, size_t len UNUSED,
+			struct logger *logger UNUSED)
+{
+	return crl_is_current;
+}
+
+struct logger *string_logger(struct fd *whackfd UNUSED, where_t where UNUSED,
+			     const char *fmt UNUSED, ...)
+{
+	return clone_const_thing(global_logger, "crl thread logger");
+}
+
+void free_logger(struct logger **logp, where_t where UNUSED)
+{
+	pfreeany(*logp);
+}
+
+void init_oneshot_timer(enum global_timer type UNUSED, global_timer_cb *cb UNUSED)
+{
+}
+
+void schedule_oneshot_timer(enum global_timer type UNUSED, deltatime_t delay UNUSED)
+{
+}
+
+void add_crl_fetch_request(asn1_t issuer_dn UNUSED, shunk_t url UNUSED,
+			   struct crl_fetch_request **requests UNUSED,
+			   struct logger *logger UNUSED)
+{
+}
+
+void submit_crl_fetch_requests(struct crl_fetch_request **requests UNUSED,
+			       struct logger *logger UNUSED)
+{
+}
+
+bool next_preloaded_pubkey(struct preloaded_pubkey_filter *filter UNUSED)
+{
+	return false;
+}
+
+CERTCertList *get_all_certificates(struct logger *logger UNUSED)
+{
+	return NULL;
+}
+
+/* whack --listcrls output, collected */
+static char listing[4096];
+static struct jambuf listing_buf;
+static char show_line[512];
+static struct jambuf show_buf;
+
+struct jambuf *show_jambuf(struct show *s UNUSED)
+{
+	show_buf = ARRAY_AS_JAMBUF(show_line);
+	return &show_buf;
+}
+
+void jambuf_to_show(struct jambuf *buf, struct show *s UNUSED, enum rc_type rc UNUSED)
+{
+	jam(&listing_buf, "%s\n", buf->array);
+}
+
+void show_blank(struct show *s UNUSED)
+{
+}
+
+void show_comment(struct show *s UNUSED, const char *message, ...)
+{
+	va_list ap;
+	va_start(ap, message);
+	jam_va_list(&listing_buf, message, ap);
+	va_end(ap);
+	jam(&listing_buf, "\n");
+}
+
+/*
+ * The queue; runs on the fetch thread.
+ */
+
+#define NR_URLS_MAX 4
+static char url[NR_URLS_MAX][64];
+
+static pthread_mutex_t script_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t script_done = PTHREAD_COND_INITIALIZER;
+static bool script_finished;
+
+static void fetch_round(fetch_crls_fn *fetch_crls, struct logger *logger,
+			const char *paths[], unsigned nr_paths,
+			bool fetched[], double *seconds)
+{
+	struct crl_fetch_job jobs[NR_URLS_MAX] = {0};
+	for (unsigned j = 0; j < nr_paths; j++) {
+		snprintf(url[j], sizeof(url[j]), "http://127.0.0.1:%u%s",
+			 (unsigned)server_port, paths[j]);
+		jobs[j] = (struct crl_fetch_job) {
+			.issuer_dn = chunk2((void *)crl_der, sizeof(crl_der)),
+			.url = url[j],
+			.logger = logger,
+		};
+	}
+	double start = now();
+	fetch_crls(jobs, nr_paths);
+	*seconds = now() - start;
+	for (unsigned j = 0; j < nr_paths; j++) {
+		fetched[j] = jobs[j].fetched;
+	}
+}
+
+#define CHECK_ROUND(WHAT, PATHS, FETCHED, IMPORTS)			\
+	{								\
+		const char *paths_[] = PATHS;				\
+		bool expected_[] = FETCHED;				\
+		unsigned n_ = elemsof(paths_);				\
+		bool fetched_[NR_URLS_MAX];				\
+		unsigned imports_ = nr_imports;				\
+		double seconds_;					\
+		fetch_round(fetch_crls, logger, paths_, n_, fetched_, &seconds_); \
+		printf("%s: %.2fs\n", WHAT, seconds_);			\
+		for (unsigned j_ = 0; j_ < n_; j_++) {			\
+			if (fetched_[j_] != expected_[j_]) {		\
+				FAIL("%s: %s %s", WHAT, paths_[j_],	\
+				     fetched_[j_] ? "fetched" : "not fetched"); \
+			}						\
+		}							\
+		if (nr_imports - imports_ != (IMPORTS)) {		\
+			FAIL("%s: %u imports, expecting %u", WHAT,	\
+			     nr_imports - imports_, (IMPORTS));		\
+		}							\
+		round_seconds = seconds_;				\
+	}
+
+#define LIST(...) { __VA_ARGS__ }
+
+void process_crl_fetch_requests(fetch_crls_fn *fetch_crls, struct logger *logger)
+{
+	double round_seconds;
+
+	CHECK_ROUND("fetch", LIST("/crl"), LIST(true), 1);
+	CHECK_ROUND("pem", LIST("/crl.pem"), LIST(true), 1);
+
+	/* NSS has the CRL; If-None-Match: gets a 304 */
+	unsigned conditional = nr_conditional_requests;
+	CHECK_ROUND("not modified", LIST("/crl"), LIST(true), 0);
+	if (nr_conditional_requests != conditional + 1) {
+		FAIL("not modified: request was not conditional");
+	}
+
+	/* NSS lost the CRL; fetch, but it turns out to be current */
+	have_crl = false;
+	crl_is_current = true;
+	CHECK_ROUND("unchanged", LIST("/crl"), LIST(true), 0);
+	crl_is_current = false;
+
+	CHECK_ROUND("http error", LIST("/error"), LIST(false), 0);
+	CHECK_ROUND("bad response", LIST("/garbage"), LIST(false), 0);
+
+	CHECK_ROUND("timeout", LIST("/slow"), LIST(false), 0);
+	if (round_seconds > 2 * curl_timeout + 2) {
+		FAIL("timeout: took %.2fs, expecting about %lds",
+		     round_seconds, 2 * curl_timeout);
+	}
+
+	/* in parallel: the slow server doesn't hold up the others */
+	have_crl = false;
+	double start = now();
+	CHECK_ROUND("parallel", LIST("/slow", "/crl", "/error", "/crl.pem"),
+		    LIST(false, true, false, true), 2);
+	if (last_import - start > curl_timeout) {
+		FAIL("parallel: CRL imported after %.2fs, behind the slow server",
+		     last_import - start);
+	}
+	if (round_seconds > 2 * curl_timeout + 2) {
+		FAIL("parallel: took %.2fs, expecting about %lds",
+		     round_seconds, 2 * curl_timeout);
+	}
+
+	pthread_mutex_lock(&script_mutex);
+	script_finished = true;
+	pthread_cond_signal(&script_done);
+	pthread_mutex_unlock(&script_mutex);
+}
+
+static void check_listing(const char *path, const char *expected)
+{
+	char needle[128];
+	snprintf(needle, sizeof(needle), "'http://127.0.0.1:%u%s'\n",
+		 (unsigned)server_port, path);
+	const char *entry = strstr(listing, needle);
+	if (entry == NULL) {
+		FAIL("%s not listed", path);
+		return;
+	}
+	const char *next = strstr(entry + 1, "'http://");
+	const char *hit = strstr(entry, expected);
+	if (hit == NULL || (next != NULL && hit > next)) {
+		FAIL("%s: expecting \"%s\"", path, expected);
+	}
+}
+
+int main(int argc UNUSED, char *argv[])
+{
+	struct logger *logger = tool_init_log(argv[0]);
+	listing_buf = ARRAY_AS_JAMBUF(listing);
+
+	start_server();
+
+	crl_check_interval = deltatime(60);
+	start_crl_fetch_helper(logger);
+
+	pthread_mutex_lock(&script_mutex);
+	while (!script_finished) {
+		pthread_cond_wait(&script_done, &script_mutex);
+	}
+	pthread_mutex_unlock(&script_mutex);
+
+	exiting_pluto = true;
+	stop_crl_fetch_helper(logger);
+
+	list_crl_fetch_stats(NULL, /*utc*/true);
+	printf("%s", listing);
+	check_listing("/crl", "imported 2, unchanged 1, not modified 1, failed 0");
+	check_listing("/crl.pem", "imported 2, unchanged 0, not modified 0, failed 0");
+	check_listing("/error", "failed 2");
+	check_listing("/garbage", "failed 1");
+	check_listing("/slow", "failed 2");
+
+	free_crl_fetch();
+	stop_server();
+
+	if (nr_requests != 11) {
+		FAIL("server saw %u requests, expecting 11", nr_requests);
+	}
+
+	if (report_leaks(logger)) {
+		fails++;
+	}
+	if (fails > 0) {
+		fprintf(stderr, "TOTAL FAILURES: %u\n", fails);
+		exit(1);
+	}
+	return 0;
+}
@@ -0,0 +1,415 @@
+/* Address pool lease check, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Lease, release and recover reusable addresses from a large pool
+ * (addresspool.c), checking that each client gets its address back
+ * and that the cost of an operation stays flat while the pool, and
+ * its table of reusable leases, grows.
+ *
+ * Then check the lease snapshot: that records are re-used in place,
+ * and that the leases survive both a crash and a shutdown.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>		/* for PATH_MAX */
+#include <sys/stat.h>
+
+#include "lswtool.h"
+#include "lswlog.h"
+#include "lswalloc.h"
+#include "constants.h"
+
+#include "defs.h"
+#include "log.h"
+#include "connections.h"
+#include "state.h"
+#include "addresspool.h"
+#include "show.h"
+#include "timer.h"
+
+static unsigned fails;
+static struct logger *logger;
+
+#define FAIL(FMT, ...)							\
+	{								\
+		fails++;						\
+		fprintf(stderr, "FAIL: %s: "FMT"\n",			\
+			__func__, ##__VA_ARGS__);			\
+	}
+
+#define CHECK(COND)							\
+	{								\
+		if (!(COND)) {						\
+			FAIL("line %d: %s", __LINE__, #COND);		\
+		}							\
+	}
+
+/*
+ * Stubs for the bits of pluto addresspool.c uses.
+ */
+
+bool uniqueIDs = true;
+
+struct connection *connection_by_serialno(co_serial_t serialno UNUSED)
+{
+	return NULL;
+}
+
+void rehash_db_spd_route_remote_client(struct spd_route *sr UNUSED)
+{
+}
+
+void init_oneshot_timer(enum global_timer type UNUSED, global_timer_cb *cb UNUSED)
+{
+}
+
+void schedule_oneshot_timer(enum global_timer type UNUSED, deltatime_t delay UNUSED)
+{
+}
+
+const char *str_connection_instance(const struct connection *c UNUSED,
+				    connection_buf *buf)
+{
+	buf->buf[0] = '\0';
+	return buf->buf;
+}
+
+struct logger *show_logger(struct show *s UNUSED)
+{
+	return logger;
+}
+
+void show_separator(struct show *s UNUSED)
+{
+}
+
+void show_comment(struct show *s UNUSED, const char *message UNUSED, ...)
+{
+}
+
+/*
+ * One connection, re-used for each client; a client's lease stays
+ * assigned to the serial number it was leased to.
+ */
+
+#define NR_CLIENTS (1 << 18)
+#define BATCH 256
+#define NR_BATCHES (NR_CLIENTS / BATCH)
+
+static struct config_end remote_config;
+static struct connection_end remote = { .config = &remote_config, };
+static struct connection road = { .name = "road", .remote = &remote, };
+static struct state st;
+static co_serial_t serialno;
+
+struct client {
+	char name[32];
+	co_serial_t serialno;
+	ip_address address;
+};
+
+static struct client *clients;
+
+static void as_client(struct client *client)
+{
+	remote.host.id = (struct id) {
+		.kind = ID_FQDN,
+		.name = shunk1(client->name),
+	};
+	road.serialno = ++serialno;
+	road.spd.that.has_lease = false;
+}
+
+static bool lease(struct client *client)
+{
+	as_client(client);
+	err_t e = lease_that_address(&road, &st);
+	if (e != NULL) {
+		FAIL("%s: %s", client->name, e);
+		return false;
+	}
+	client->serialno = road.serialno;
+	client->address = selector_prefix(road.spd.that.client);
+	return true;
+}
+
+static void release(struct client *client)
+{
+	road.serialno = client->serialno;
+	road.spd.that.has_lease = true;
+	road.spd.that.client = selector_from_address(client->address);
+	free_that_address_lease(&road);
+}
+
+static intmax_t cpu_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (intmax_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int cmp_ns(const void *l, const void *r)
+{
+	intmax_t ll = *(const intmax_t *)l;
+	intmax_t rr = *(const intmax_t *)r;
+	return (ll < rr ? -1 : ll > rr ? 1 : 0);
+}
+
+/*
+ * No batch may cost more than a small multiple of the median batch;
+ * a full rehash of the table, or a walk of every lease, would.
+ */
+
+#define FLAT 10
+
+static void check_flat(const char *what, const intmax_t batch_ns[NR_BATCHES])
+{
+	static intmax_t sorted[NR_BATCHES];
+	memcpy(sorted, batch_ns, sizeof(sorted));
+	qsort(sorted, NR_BATCHES, sizeof(sorted[0]), cmp_ns);
+	intmax_t median = sorted[NR_BATCHES / 2];
+	intmax_t worst = sorted[NR_BATCHES - 1];
+	printf("%s: %d clients: %jd ns median, %jd ns worst per %d\n",
+	       what, NR_CLIENTS, median, worst, BATCH);
+	if (worst > median * FLAT) {
+		for (unsigned b = 0; b < NR_BATCHES; b++) {
+			if (batch_ns[b] > median * FLAT) {
+				FAIL("%s: batch %u (clients %u..%u) took %jd ns; median %jd ns",
+				     what, b, b * BATCH, (b + 1) * BATCH - 1,
+				     batch_ns[b], median);
+			}
+		}
+	}
+}
+
+static void check_leases(void)
+{
+	ip_range range;
+	err_t e = ttorange("10.0.0.0/12", NULL, &range);
+	if (e != NULL) {
+		FAIL("ttorange: %s", e);
+		return;
+	}
+	diag_t d = install_addresspool(range, &road);
+	if (d != NULL) {
+		FAIL("%s", str_diag(d));
+		pfree_diag(&d);
+		return;
+	}
+
+	clients = alloc_things(struct client, NR_CLIENTS, "clients");
+	for (unsigned i = 0; i < NR_CLIENTS; i++) {
+		snprintf(clients[i].name, sizeof(clients[i].name), "client%u.example.com", i);
+	}
+	static intmax_t batch_ns[NR_BATCHES];
+
+	/* new clients; grows the pool and the table */
+	for (unsigned b = 0; b < NR_BATCHES; b++) {
+		intmax_t start = cpu_ns();
+		for (unsigned i = b * BATCH; i < (b + 1) * BATCH; i++) {
+			if (!lease(&clients[i])) {
+				return;
+			}
+		}
+		batch_ns[b] = cpu_ns() - start;
+	}
+	check_flat("allocate", batch_ns);
+
+	/* returning clients, lease still in use */
+	for (unsigned b = 0; b < NR_BATCHES; b++) {
+		intmax_t start = cpu_ns();
+		for (unsigned i = b * BATCH; i < (b + 1) * BATCH; i++) {
+			ip_address old = clients[i].address;
+			if (!lease(&clients[i])) {
+				return;
+			}
+			CHECK(address_eq_address(old, clients[i].address));
+		}
+		batch_ns[b] = cpu_ns() - start;
+	}
+	check_flat("recover in-use", batch_ns);
+
+	/* returning clients, lease lingering on the free list */
+	for (unsigned i = 0; i < NR_CLIENTS; i++) {
+		release(&clients[i]);
+	}
+	for (unsigned b = 0; b < NR_BATCHES; b++) {
+		intmax_t start = cpu_ns();
+		for (unsigned i = b * BATCH; i < (b + 1) * BATCH; i++) {
+			ip_address old = clients[i].address;
+			if (!lease(&clients[i])) {
+				return;
+			}
+			CHECK(address_eq_address(old, clients[i].address));
+		}
+		batch_ns[b] = cpu_ns() - start;
+	}
+	check_flat("recover lingering", batch_ns);
+
+	/* no two clients share an address */
+	bool *leased = alloc_things(bool, range_size(range), "leased");
+	for (unsigned i = 0; i < NR_CLIENTS; i++) {
+		uintmax_t offset;
+		e = address_to_range_offset(range, clients[i].address, &offset);
+		if (e != NULL) {
+			FAIL("%s: %s", clients[i].name, e);
+			break;
+		}
+		CHECK(!leased[offset]);
+		leased[offset] = true;
+	}
+	pfree(leased);
+
+	addresspool_delref(&road.pool);
+	pfree(clients);
+}
+
+/*
+ * A full pool of clients; when they all go and a new set of clients
+ * arrives, each steals a lease and, with it, a free record of the
+ * same size, so the file doesn't grow.
+ */
+
+#define NR_SNAPSHOT_CLIENTS 4096
+
+static off_t file_size(const char *file)
+{
+	struct stat st;
+	if (stat(file, &st) < 0) {
+		FAIL("stat(%s) failed", file);
+		return -1;
+	}
+	return st.st_size;
+}
+
+static bool install_snapshot_pool(void)
+{
+	ip_range range;
+	err_t e = ttorange("10.64.0.0/20", NULL, &range);
+	if (e != NULL) {
+		FAIL("ttorange: %s", e);
+		return false;
+	}
+	diag_t d = install_addresspool(range, &road);
+	if (d != NULL) {
+		FAIL("%s", str_diag(d));
+		pfree_diag(&d);
+		return false;
+	}
+	return true;
+}
+
+/* the second half of CLIENTS get their addresses back */
+
+static void check_recovered(const char *what)
+{
+	for (unsigned i = NR_SNAPSHOT_CLIENTS; i < NR_SNAPSHOT_CLIENTS * 2; i++) {
+		ip_address old = clients[i].address;
+		if (!lease(&clients[i])) {
+			return;
+		}
+		if (!address_eq_address(old, clients[i].address)) {
+			FAIL("%s: %s changed address", what, clients[i].name);
+			return;
+		}
+	}
+}
+
+static void check_snapshot(void)
+{
+	char file[PATH_MAX];
+	snprintf(file, sizeof(file), "%s/leasecheck.%d", P_tmpdir, getpid());
+	unlink(file);
+
+	clients = alloc_things(struct client, NR_SNAPSHOT_CLIENTS * 2, "clients");
+	for (unsigned i = 0; i < NR_SNAPSHOT_CLIENTS * 2; i++) {
+		snprintf(clients[i].name, sizeof(clients[i].name), "client%u.example.com", i);
+	}
+
+	init_addresspool_snapshot(file, logger);
+	if (!install_snapshot_pool()) {
+		goto out;
+	}
+	for (unsigned i = 0; i < NR_SNAPSHOT_CLIENTS; i++) {
+		if (!lease(&clients[i])) {
+			goto out;
+		}
+	}
+	off_t size = file_size(file);
+	for (unsigned i = 0; i < NR_SNAPSHOT_CLIENTS; i++) {
+		release(&clients[i]);
+	}
+	for (unsigned i = NR_SNAPSHOT_CLIENTS; i < NR_SNAPSHOT_CLIENTS * 2; i++) {
+		if (!lease(&clients[i])) {
+			goto out;
+		}
+	}
+	CHECK(file_size(file) == size);
+
+	/* crash; nothing is saved */
+	free_addresspool_snapshot();
+	addresspool_delref(&road.pool);
+	init_addresspool_snapshot(file, logger);
+	if (!install_snapshot_pool()) {
+		goto out;
+	}
+	check_recovered("crash");
+
+	/* shutdown; the file is compacted */
+	save_addresspool_snapshot(logger);
+	addresspool_delref(&road.pool);
+	free_addresspool_snapshot();
+	CHECK(file_size(file) < size);
+	init_addresspool_snapshot(file, logger);
+	if (!install_snapshot_pool()) {
+		goto out;
+	}
+	check_recovered("shutdown");
+
+out:
+	addresspool_delref(&road.pool);
+	free_addresspool_snapshot();
+	pfree(clients);
+	unlink(file);
+}
+
+int main(int argc UNUSED, char *argv[])
+{
+	logger = tool_init_log(argv[0]);
+
+	/* quiet */
+	cur_debugging = DBG_NONE;
+
+	remote_config.host.auth = AUTH_RSASIG;
+	road.logger = logger;
+	st.st_logger = logger;
+
+	check_leases();
+	check_snapshot();
+
+	if (report_leaks(logger)) {
+		fails++;
+	}
+	if (fails > 0) {
+		fprintf(stderr, "TOTAL FAILURES: %u\n", fails);
+		exit(1);
+	}
+	return 0;
+}
@@ -0,0 +1,456 @@
+/* IKEv2 Message ID window check, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Drive the responder side of pluto's Message ID window
+ * (ikev2_msgid.c) with a window larger than one: requests arriving
+ * while an earlier one is being processed are deferred, and then
+ * drained, in Message ID order, as each request finishes.
+ *
+ * A "request" is just a message digest with a Message ID; processing
+ * one is v2_msgid_start() followed, when the test says so, by
+ * v2_msgid_finish().  The main event loop is a queue of callbacks.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lswtool.h"
+#include "lswlog.h"
+#include "constants.h"
+
+#include "defs.h"
+#include "state.h"
+#include "demux.h"
+#include "log.h"
+#include "ikev2.h"
+#include "ikev2_msgid.h"
+#include "ikev2_send.h"
+#include "retransmit.h"
+#include "server.h"
+#include "packet.h"
+
+static unsigned fails;
+
+#define FAIL(FMT, ...)							\
+	{								\
+		fails++;						\
+		fprintf(stderr, "FAIL: %s: "FMT"\n",			\
+			__func__, ##__VA_ARGS__);			\
+	}
+
+#define CHECK(COND)							\
+	{								\
+		if (!(COND)) {						\
+			FAIL("line %d: %s", __LINE__, #COND);		\
+		}							\
+	}
+
+/*
+ * Messages; reference counted so leaks show up.
+ */
+
+struct test_md {
+	struct msg_digest md;	/* must be first */
+	unsigned refs;
+};
+
+static unsigned nr_mds;
+
+static struct msg_digest *request(intmax_t msgid, bool decrypted)
+{
+	struct test_md *t = alloc_thing(struct test_md, "test md");
+	t->md.hdr.isa_msgid = msgid;
+	t->md.hdr.isa_np = ISAKMP_NEXT_v2SK;
+	t->md.v2_decrypted = decrypted;
+	t->refs = 1;
+	nr_mds++;
+	return &t->md;
+}
+
+struct msg_digest *md_addref_where(struct msg_digest *md, where_t where UNUSED)
+{
+	((struct test_md *)md)->refs++;
+	return md;
+}
+
+void md_delref_where(struct msg_digest **mdp, where_t where UNUSED)
+{
+	struct test_md *t = (struct test_md *)*mdp;
+	*mdp = NULL;
+	if (t != NULL && --t->refs == 0) {
+		nr_mds--;
+		pfree(t);
+	}
+}
+
+enum message_role v2_msg_role(const struct msg_digest *md)
+{
+	return (md->hdr.isa_flags & ISAKMP_FLAGS_v2_MSG_R ?
+		MESSAGE_RESPONSE : MESSAGE_REQUEST);
+}
+
+/*
+ * The IKE SA and the event loop.
+ */
+
+static struct ike_sa *test_ike;
+
+struct ike_sa *ike_sa_by_serialno(so_serial_t serialno)
+{
+	return (test_ike != NULL && test_ike->sa.st_serialno == serialno ? test_ike : NULL);
+}
+
+struct child_sa *child_sa_by_serialno(so_serial_t serialno UNUSED)
+{
+	return NULL;
+}
+
+struct ike_sa *pexpect_ike_sa_where(struct state *st, where_t where UNUSED)
+{
+	return (struct ike_sa *)st;
+}
+
+struct callback {
+	const char *story;
+	so_serial_t serialno;
+	callback_cb *cb;
+	void *context;
+};
+
+static struct callback callbacks[16];
+static unsigned nr_callbacks;
+
+void schedule_callback(const char *story, so_serial_t serialno,
+		       callback_cb *cb, void *context)
+{
+	if (nr_callbacks >= elemsof(callbacks)) {
+		FAIL("too many callbacks");
+		return;
+	}
+	callbacks[nr_callbacks++] = (struct callback) {
+		.story = story,
+		.serialno = serialno,
+		.cb = cb,
+		.context = context,
+	};
+}
+
+static void run_callbacks(void)
+{
+	while (nr_callbacks > 0) {
+		struct callback c = callbacks[0];
+		memmove(&callbacks[0], &callbacks[1], --nr_callbacks * sizeof(callbacks[0]));
+		struct ike_sa *ike = ike_sa_by_serialno(c.serialno);
+		c.cb(c.story, ike != NULL ? &ike->sa : NULL, c.context);
+	}
+}
+
+/*
+ * Processing a request: start it; it is finished by finish().
+ */
+
+static intmax_t processed[16];
+static unsigned nr_processed;
+static struct msg_digest *in_progress;
+
+static void start(struct ike_sa *ike, struct msg_digest *md)
+{
+	CHECK(in_progress == NULL);
+	v2_msgid_start(ike, md);
+	in_progress = md_addref(md);
+	if (nr_processed < elemsof(processed)) {
+		processed[nr_processed++] = md->hdr.isa_msgid;
+	}
+}
+
+static const struct v2_state_transition respond = {
+	.story = "test responder",
+	.send_role = MESSAGE_RESPONSE,
+};
+
+static void finish(struct ike_sa *ike)
+{
+	struct msg_digest *md = in_progress;
+	in_progress = NULL;
+	ike->sa.st_v2_transition = &respond;
+	/* the response, for retransmits */
+	free_v2_outgoing_fragments(&ike->sa.st_v2_outgoing[MESSAGE_RESPONSE]);
+	ike->sa.st_v2_outgoing[MESSAGE_RESPONSE] = alloc_bytes(1, "response");
+	v2_msgid_finish(ike, md);
+	md_delref(&md);
+}
+
+/*
+ * What ikev2.c would do with a deferred request (once it checks the
+ * window): anything at or below .recv is a duplicate; anything else
+ * is processed.
+ */
+
+void process_deferred_v2_request(struct ike_sa *ike, struct msg_digest *md)
+{
+	if (md->hdr.isa_msgid <= ike->st_v2_msgid_windows.responder.recv) {
+		return;
+	}
+	if (ike->st_v2_msgid_windows.responder.wip != -1) {
+		v2_msgid_defer_request(ike, md);
+		return;
+	}
+	start(ike, md);
+}
+
+/*
+ * Things the window code calls that don't matter here.
+ */
+
+void free_v2_outgoing_fragments(struct v2_outgoing_fragment **frags)
+{
+	pfreeany(*frags);
+}
+
+bool send_recorded_v2_message(struct ike_sa *ike UNUSED, const char *where UNUSED,
+			      enum message_role role UNUSED)
+{
+	return true;
+}
+
+bool send_v2_outgoing_fragments(struct ike_sa *ike UNUSED, const char *where UNUSED,
+				struct v2_outgoing_fragment *frags UNUSED)
+{
+	return true;
+}
+
+bool emit_v2N_bytes(v2_notification_t ntype UNUSED, const void *bytes UNUSED,
+		    size_t size UNUSED, struct pbs_out *outs UNUSED)
+{
+	return true;
+}
+
+diag_t pbs_in_raw(struct pbs_in *pbs UNUSED, void *bytes UNUSED, size_t len UNUSED,
+		  const char *name UNUSED)
+{
+	return NULL;
+}
+
+void complete_v2_state_transition(struct ike_sa *ike UNUSED,
+				  struct msg_digest *md UNUSED,
+				  stf_status result UNUSED)
+{
+}
+
+void set_v2_transition(struct state *st, const struct v2_state_transition *transition,
+		       where_t where UNUSED)
+{
+	st->st_v2_transition = transition;
+}
+
+void start_retransmits(struct state *st UNUSED)
+{
+}
+
+void clear_retransmits(struct state *st UNUSED)
+{
+}
+
+void log_state(lset_t rc_flags UNUSED, const struct state *st UNUSED,
+	       const char *msg, ...)
+{
+	va_list ap;
+	va_start(ap, msg);
+	vfprintf(stderr, msg, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+}
+
+const struct finite_state *finite_states[STATE_IKE_ROOF];
+
+/*
+ * The checks.
+ */
+
+static struct ike_sa *new_ike(unsigned window)
+{
+	struct ike_sa *ike = alloc_thing(struct ike_sa, "test ike");
+	ike->sa.st_serialno = 1;
+	ike->sa.st_logger = clone_const_thing(global_logger, "test logger");
+	v2_msgid_init_ike(ike);
+	ike->st_v2_msgid_windows.responder.window = window;
+	test_ike = ike;
+	return ike;
+}
+
+static void free_ike(struct ike_sa **ike)
+{
+	v2_msgid_free(*ike);
+	free_v2_outgoing_fragments(&(*ike)->sa.st_v2_outgoing[MESSAGE_RESPONSE]);
+	pfree((*ike)->sa.st_logger);
+	pfree(*ike);
+	*ike = test_ike = NULL;
+}
+
+static bool defer(struct ike_sa *ike, intmax_t msgid, bool decrypted)
+{
+	struct msg_digest *md = request(msgid, decrypted);
+	bool ok = v2_msgid_defer_request(ike, md);
+	md_delref(&md);
+	return ok;
+}
+
+static void check_in_order_drain(void)
+{
+	struct ike_sa *ike = new_ike(4);
+	nr_processed = 0;
+
+	struct msg_digest *md = request(0, true);
+	start(ike, md);
+	md_delref(&md);
+
+	/* arrive out of order while 0 is being processed */
+	CHECK(defer(ike, 3, true));
+	CHECK(defer(ike, 1, true));
+	CHECK(defer(ike, 2, true));
+	/* a retransmit of a deferred request is absorbed */
+	CHECK(defer(ike, 2, true));
+	/* the window is 4: 0 plus three deferred */
+	CHECK(!defer(ike, 4, true));
+	CHECK(nr_callbacks == 0);
+
+	/* each finish kicks the next deferred request along */
+	for (intmax_t msgid = 0; msgid <= 3; msgid++) {
+		CHECK(in_progress != NULL && in_progress->hdr.isa_msgid == msgid);
+		finish(ike);
+		run_callbacks();
+	}
+	CHECK(in_progress == NULL);
+	CHECK(nr_processed == 4);
+	for (unsigned i = 0; i < nr_processed; i++) {
+		if (processed[i] != i) {
+			FAIL("request %u processed as %jd", i, processed[i]);
+		}
+	}
+	CHECK(ike->st_v2_msgid_windows.responder.recv == 3);
+	CHECK(ike->st_v2_msgid_windows.responder.sent == 3);
+
+	/* earlier responses are still there for retransmits */
+	for (intmax_t msgid = 1; msgid <= 3; msgid++) {
+		struct v2_outgoing_fragment *response = NULL;
+		unsigned recv_frags;
+		CHECK(v2_msgid_recorded_response(ike, msgid, &response, &recv_frags));
+		CHECK(response != NULL);
+	}
+
+	free_ike(&ike);
+	CHECK(nr_mds == 0);
+}
+
+/*
+ * Requests that haven't passed their integrity check can't be
+ * deferred: otherwise forgeries with the next Message IDs would fill
+ * the list and the real requests, arriving later, would be thrown
+ * away as already deferred.
+ */
+
+static void check_forgeries_not_deferred(void)
+{
+	struct ike_sa *ike = new_ike(4);
+	nr_processed = 0;
+
+	struct msg_digest *md = request(0, true);
+	start(ike, md);
+	md_delref(&md);
+
+	for (intmax_t msgid = 1; msgid <= 3; msgid++) {
+		CHECK(!defer(ike, msgid, /*decrypted*/false));
+	}
+	/* the genuine requests still get in */
+	for (intmax_t msgid = 1; msgid <= 3; msgid++) {
+		CHECK(defer(ike, msgid, /*decrypted*/true));
+	}
+	while (in_progress != NULL) {
+		finish(ike);
+		run_callbacks();
+	}
+	CHECK(nr_processed == 4);
+	CHECK(ike->st_v2_msgid_windows.responder.recv == 3);
+
+	free_ike(&ike);
+	CHECK(nr_mds == 0);
+}
+
+/*
+ * A deferred request that has since become a duplicate is dropped
+ * when it comes round, and the drain carries on.
+ */
+
+static void check_duplicate_skipped(void)
+{
+	struct ike_sa *ike = new_ike(4);
+	nr_processed = 0;
+
+	struct msg_digest *md = request(0, true);
+	start(ike, md);
+	md_delref(&md);
+	CHECK(defer(ike, 1, true));
+	CHECK(defer(ike, 2, true));
+
+	/* 0 finishes; 1 is scheduled ... */
+	finish(ike);
+	/* ... but, before it runs, pretend it was also processed */
+	ike->st_v2_msgid_windows.responder.recv = 1;
+	run_callbacks();
+	/* 1 was dropped so 2 went next */
+	CHECK(in_progress != NULL && in_progress->hdr.isa_msgid == 2);
+	finish(ike);
+	run_callbacks();
+	CHECK(nr_processed == 2);
+
+	free_ike(&ike);
+	CHECK(nr_mds == 0);
+}
+
+/* freeing the IKE SA releases anything still deferred */
+
+static void check_free(void)
+{
+	struct ike_sa *ike = new_ike(4);
+	struct msg_digest *md = request(0, true);
+	start(ike, md);
+	md_delref(&md);
+	CHECK(defer(ike, 2, true));
+	CHECK(defer(ike, 1, true));
+	md_delref(&in_progress);
+	free_ike(&ike);
+	CHECK(nr_mds == 0);
+}
+
+int main(int argc UNUSED, char *argv[])
+{
+	struct logger *logger = tool_init_log(argv[0]);
+
+	check_in_order_drain();
+	check_forgeries_not_deferred();
+	check_duplicate_skipped();
+	check_free();
+
+	if (report_leaks(logger)) {
+		fails++;
+	}
+	if (fails > 0) {
+		fprintf(stderr, "TOTAL FAILURES: %u\n", fails);
+		exit(1);
+	}
+	return 0;
+}
@@ -0,0 +1,214 @@
+/* Remote client overlap index check, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Check remote_client_overlap_candidates() (connection_db.c) against
+ * a handful of connections, including after a connection's remote
+ * client is narrowed the way IKEv2 traffic selector processing does
+ * it: overwrite .that.client, then rehash.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lswtool.h"
+#include "lswlog.h"
+#include "lswalloc.h"
+#include "constants.h"
+
+#include "defs.h"
+#include "log.h"
+#include "connections.h"
+#include "connection_db.h"
+#include "host_pair.h"
+
+static unsigned fails;
+static struct logger *logger;
+
+#define FAIL(FMT, ...)							\
+	{								\
+		fails++;						\
+		fprintf(stderr, "FAIL: %s: "FMT"\n",			\
+			__func__, ##__VA_ARGS__);			\
+	}
+
+#define CHECK(COND)							\
+	{								\
+		if (!(COND)) {						\
+			FAIL("line %d: %s", __LINE__, #COND);		\
+		}							\
+	}
+
+/*
+ * Stubs for the bits of pluto connection_db.c uses.
+ */
+
+const struct logger_object_vec logger_connection_vec = {
+	.name = "connection",
+};
+
+struct logger *alloc_logger(void *object UNUSED,
+			    const struct logger_object_vec *vec UNUSED,
+			    where_t where UNUSED)
+{
+	return clone_const_thing(global_logger, "test logger");
+}
+
+void free_logger(struct logger **logp, where_t where UNUSED)
+{
+	pfreeany(*logp);
+}
+
+size_t jam_connection(struct jambuf *buf, const struct connection *c)
+{
+	return jam_string(buf, c->name);
+}
+
+void rehash_host_pair_remote_id(struct connection *c UNUSED)
+{
+}
+
+void unshare_connection_end(struct connection *c UNUSED, struct end *e UNUSED)
+{
+}
+
+/*
+ * Connections with just enough to be hashed.
+ */
+
+static ip_selector selector(const char *s)
+{
+	ip_subnet subnet;
+	err_t e = ttosubnet(shunk1(s), NULL, '0', &subnet, logger);
+	if (e != NULL) {
+		fprintf(stderr, "%s: %s\n", s, e);
+		exit(1);
+	}
+	return selector_from_subnet(subnet);
+}
+
+static struct connection *new_connection(const char *name, const char *client)
+{
+	struct connection *c = alloc_connection(name, HERE);
+	c->spd.that.client = selector(client);
+	add_db_connection(c);
+	add_db_spd_route(&c->spd);
+	return c;
+}
+
+static void free_connection(struct connection **c)
+{
+	del_db_spd_route(&(*c)->spd, true);
+	del_db_connection(*c, true);
+	free_logger(&(*c)->logger, HERE);
+	pfree((*c)->name);
+	pfree((*c)->root_config);
+	pfree(*c);
+	*c = NULL;
+}
+
+/*
+ * The candidates for NET, as a space separated list of connection
+ * names, newest first.
+ */
+
+static const char *candidates(const char *net)
+{
+	static char names[100];
+	ip_selector key = selector(net);
+	struct connection **cs;
+	unsigned nr;
+	if (!remote_client_overlap_candidates(&key, &cs, &nr)) {
+		return "(not indexed)";
+	}
+	struct jambuf buf = ARRAY_AS_JAMBUF(names);
+	for (unsigned i = 0; i < nr; i++) {
+		if (i > 0) {
+			jam_string(&buf, " ");
+		}
+		jam_string(&buf, cs[i]->name);
+	}
+	pfreeany(cs);
+	return names;
+}
+
+#define CHECK_CANDIDATES(NET, NAMES)					\
+	{								\
+		const char *got = candidates(NET);			\
+		if (!streq(got, NAMES)) {				\
+			FAIL("line %d: %s: expecting '%s' got '%s'",	\
+			     __LINE__, NET, NAMES, got);		\
+		}							\
+	}
+
+static void check_overlap(void)
+{
+	struct connection *wide = new_connection("wide", "10.0.0.0/8");
+	struct connection *narrow = new_connection("narrow", "10.1.0.0/16");
+	struct connection *other = new_connection("other", "192.168.0.0/24");
+	struct connection *host = new_connection("host", "10.1.2.3/32");
+
+	CHECK_CANDIDATES("10.1.2.3/32", "host narrow wide");
+	CHECK_CANDIDATES("10.1.9.9/32", "narrow wide");
+	CHECK_CANDIDATES("10.9.9.9/32", "wide");
+	CHECK_CANDIDATES("192.168.0.1/32", "other");
+	CHECK_CANDIDATES("172.16.0.1/32", "");
+	/* a subnet can't be looked up */
+	CHECK_CANDIDATES("10.1.0.0/16", "(not indexed)");
+
+	/*
+	 * Narrow WIDE to a /24 outside of NARROW, as accepting the
+	 * peer's TSi does; the old prefix must stop matching and the
+	 * new one must start.
+	 */
+	wide->spd.that.client = selector("10.9.9.0/24");
+	rehash_db_spd_route_remote_client(&wide->spd);
+
+	CHECK_CANDIDATES("10.1.2.3/32", "host narrow");
+	CHECK_CANDIDATES("10.9.9.9/32", "wide");
+	CHECK_CANDIDATES("10.9.8.1/32", "");
+
+	/* now narrow it to a single address inside NARROW */
+	wide->spd.that.client = selector("10.1.7.7/32");
+	rehash_db_spd_route_remote_client(&wide->spd);
+
+	CHECK_CANDIDATES("10.1.7.7/32", "narrow wide");
+	CHECK_CANDIDATES("10.9.9.9/32", "");
+
+	free_connection(&host);
+	free_connection(&other);
+	free_connection(&narrow);
+	free_connection(&wide);
+}
+
+int main(int argc UNUSED, char *argv[])
+{
+	logger = tool_init_log(argv[0]);
+
+	init_connection_db(logger);
+	init_spd_route_db(logger);
+
+	check_overlap();
+
+	if (report_leaks(logger)) {
+		fails++;
+	}
+	if (fails > 0) {
+		fprintf(stderr, "TOTAL FAILURES: %u\n", fails);
+		exit(1);
+	}
+	return 0;
+}
@@ -0,0 +1,712 @@
+/* packet codec differential check, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Do the hand-unrolled codecs in packet_codec.c behave exactly like
+ * the field table interpreter in packet.c?
+ *
+ * Each struct_desc with a codec is compared against a copy of itself
+ * with the codec stripped off.  Both are fed the same biased random
+ * input (mostly valid, with the occasional unknown enum, unknown
+ * flag, non-zero reserved byte, bad length, or short packet) and
+ * everything observable is compared: the diagnostic, the decoded
+ * structure, the input and body PBS cursors, and the encoded message
+ * bytes including the patched next-payload chain and length fields.
+ *
+ * Emitting an unknown enum is a pluto bug and is reported with a
+ * pexpect(), so the encoders are only fed known values for those
+ * fields; anything the encoders log is then a failure.  Rejecting an
+ * unknown enum is checked once per codec, with the two expected
+ * pexpect()s counted and kept off the console.
+ *
+ * Finally the two are timed against each other.
+ *
+ * Usage: packetcheck [<iterations> [<seed>]]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "lswtool.h"
+#include "lswlog.h"
+#include "constants.h"
+#include "diag.h"
+
+#include "packet.h"
+#include "packet_codec.h"
+
+static unsigned fails;
+static unsigned long decodes, decode_rejects;
+static unsigned long encodes, encode_rejects;
+
+#define FAIL(SD, FMT, ...)						\
+	{								\
+		fails++;						\
+		fprintf(stderr, "FAIL: %s: %s: "FMT"\n",		\
+			(SD)->name, __func__, ##__VA_ARGS__);		\
+	}
+
+/*
+ * xorshift64*; deterministic so that a failure can be reproduced.
+ */
+
+static uint64_t seed = 0x5eed5eed5eed5eedULL;
+
+static uint64_t rnd(uint64_t roof)
+{
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	return ((seed * 0x2545F4914F6CDD1DULL) >> 11) % roof;
+}
+
+/*
+ * A logger that counts what is logged through it.
+ */
+
+static unsigned long logged;
+
+static size_t jam_counting_prefix(struct jambuf *buf, const void *object UNUSED)
+{
+	logged++;
+	return jam_string(buf, "packetcheck: ");
+}
+
+static const struct logger_object_vec counting_object_vec = {
+	.name = "packetcheck",
+	.jam_object_prefix = jam_counting_prefix,
+};
+
+/*
+ * The codecs only handle the straight-forward field types; the
+ * offsets and indexes they use must match the table.
+ */
+
+static void check_layout(struct_desc *sd)
+{
+	const struct struct_codec *codec = sd->codec;
+	int chain = -1, length = -1;
+	unsigned chain_offset = 0, length_offset = 0;
+	unsigned offset = 0;
+	for (field_desc *fp = sd->fields; fp->field_type != ft_end; fp++) {
+		switch (fp->field_type) {
+		case ft_mnpc:
+		case ft_pnpc:
+		case ft_lss:
+			chain = fp - sd->fields;
+			chain_offset = offset;
+			break;
+		case ft_len:
+			length = fp - sd->fields;
+			length_offset = offset;
+			break;
+		case ft_zig:
+		case ft_nat:
+		case ft_enum:
+		case ft_loose_enum:
+		case ft_loose_enum_enum:
+		case ft_lset:
+		case ft_raw:
+			break;
+		default:
+			FAIL(sd, "field %s has unexpected type %d",
+			     fp->name, fp->field_type);
+		}
+		offset += fp->size;
+	}
+	if (offset != sd->size) {
+		FAIL(sd, "fields are %u bytes, structure is %zu", offset, sd->size);
+	}
+	if (codec->chain != chain ||
+	    (chain >= 0 && codec->chain_offset != chain_offset)) {
+		FAIL(sd, "chain field %d@%u, expecting %d@%u",
+		     codec->chain, codec->chain_offset, chain, chain_offset);
+	}
+	if (codec->length != length ||
+	    (length >= 0 && codec->length_offset != length_offset)) {
+		FAIL(sd, "length field %d@%u, expecting %d@%u",
+		     codec->length, codec->length_offset, length, length_offset);
+	}
+}
+
+/*
+ * Generate a mostly valid value for the field.  When KNOWN_ENUMS,
+ * ft_enum fields, which the encoders pexpect(), are always known.
+ */
+
+static uint64_t known_value(field_desc *fp, uint64_t roof)
+{
+	/* search up from a random start, wrapping */
+	uint64_t start = rnd(2) ? rnd(64) : rnd(roof);
+	for (uint64_t i = 0; i < roof; i++) {
+		uint64_t n = (start + i) % roof;
+		if (enum_name(fp->desc, n) != NULL) {
+			return n;
+		}
+	}
+	bad_case(fp->field_type);
+}
+
+static uint64_t random_value(field_desc *fp, int chain, bool known_enums)
+{
+	uint64_t roof = UINT64_C(1) << (fp->size * BITS_PER_BYTE);
+	switch (fp->field_type) {
+	case ft_mnpc:
+	case ft_pnpc:
+	case ft_lss:
+		return chain >= 0 ? (uint64_t)chain : rnd(roof);
+	case ft_enum:
+		if (known_enums) {
+			return known_value(fp, roof);
+		}
+		/* fall through */
+	case ft_loose_enum:
+		if (rnd(16) != 0) {
+			for (unsigned i = 0; i < 256; i++) {
+				uint64_t n = rnd(2) ? rnd(64) : rnd(roof < 1024 ? roof : 1024);
+				if (enum_name(fp->desc, n) != NULL) {
+					return n;
+				}
+			}
+		}
+		return rnd(roof);
+	case ft_lset:
+	{
+		uint64_t n = 0;
+		for (unsigned b = 0; b < fp->size * BITS_PER_BYTE; b++) {
+			if (test_lset(fp->desc, LELEM(b)) && rnd(2)) {
+				n |= LELEM(b);
+			}
+		}
+		if (rnd(16) == 0) {
+			n |= UINT64_C(1) << rnd(fp->size * BITS_PER_BYTE);
+		}
+		return n;
+	}
+	case ft_loose_enum_enum:
+		return rnd(2) ? rnd(32) : rnd(roof);
+	default:
+		return rnd(roof);
+	}
+}
+
+static void put_value(uint8_t *p, size_t size, uint64_t n, bool wire)
+{
+	if (wire) {
+		for (int i = size - 1; i >= 0; i--) {
+			p[i] = n;
+			n >>= BITS_PER_BYTE;
+		}
+		return;
+	}
+	switch (size) {
+	case 1: { uint8_t v = n; memcpy(p, &v, sizeof(v)); break; }
+	case 2: { uint16_t v = n; memcpy(p, &v, sizeof(v)); break; }
+	case 4: { uint32_t v = n; memcpy(p, &v, sizeof(v)); break; }
+	default: bad_case(size);
+	}
+}
+
+/*
+ * Fill P with a random SD; WIRE selects network or host order.  When
+ * CHAIN is non-negative it is used for the payload chain field.
+ */
+
+static void random_struct(struct_desc *sd, uint8_t *p, bool wire, int chain,
+			  bool known_enums)
+{
+	for (field_desc *fp = sd->fields; fp->field_type != ft_end; fp++) {
+		if (fp->field_type == ft_raw) {
+			for (size_t i = 0; i < fp->size; i++) {
+				p[i] = rnd(256);
+			}
+		} else if (fp->field_type == ft_zig) {
+			/* any size; byte order is irrelevant */
+			for (size_t i = 0; i < fp->size; i++) {
+				p[i] = (rnd(16) == 0 ? rnd(256) : 0);
+			}
+		} else {
+			put_value(p, fp->size, random_value(fp, chain, known_enums), wire);
+		}
+		p += fp->size;
+	}
+}
+
+/*
+ * Decode.
+ */
+
+#define MAX_STRUCT 64
+
+static void check_decode(struct_desc *sd, struct_desc *plain)
+{
+	const struct struct_codec *codec = sd->codec;
+	bool has_length = (codec->length >= 0);
+
+	uint8_t wire[MAX_STRUCT + 16];
+	size_t size = sd->size + rnd(12);
+	for (size_t i = 0; i < size; i++) {
+		wire[i] = rnd(256);
+	}
+	random_struct(sd, wire, true, -1, /*known_enums*/false);
+	if (has_length && rnd(4) != 0) {
+		field_desc *fp = &sd->fields[codec->length];
+		uint64_t len;
+		switch (rnd(4)) {
+		case 0: len = sd->size + rnd(size - sd->size + 1); break;
+		case 1: len = rnd(sd->size + 1); break;
+		case 2: len = size + 1 + rnd(4); break;
+		default: len = size; break;
+		}
+		put_value(wire + codec->length_offset, fp->size, len, true);
+	}
+	size_t avail = (rnd(16) == 0 ? rnd(size + 1) : size);
+
+	struct pbs_in ins[2];
+	struct pbs_in obj[2];
+	uint8_t dest[2][MAX_STRUCT];
+	diag_t d[2];
+	for (unsigned v = 0; v < 2; v++) {
+		ins[v] = pbs_in_from_shunk(shunk2(wire, avail), "wire");
+		memset(&obj[v], 0, sizeof(obj[v]));
+		memset(dest[v], 0xA5, sizeof(dest[v]));
+		d[v] = pbs_in_struct(&ins[v], v == 0 ? sd : plain,
+				     dest[v], sizeof(dest[v]),
+				     has_length ? &obj[v] : NULL);
+	}
+
+	decodes++;
+	decode_rejects += (d[0] != NULL);
+	if ((d[0] == NULL) != (d[1] == NULL)) {
+		FAIL(sd, "codec %s, interpreter %s",
+		     d[0] == NULL ? "succeeded" : str_diag(d[0]),
+		     d[1] == NULL ? "succeeded" : str_diag(d[1]));
+	} else if (d[0] != NULL) {
+		if (!streq(str_diag(d[0]), str_diag(d[1]))) {
+			FAIL(sd, "codec '%s', interpreter '%s'",
+			     str_diag(d[0]), str_diag(d[1]));
+		}
+	} else {
+		if (memcmp(dest[0], dest[1], sizeof(dest[0])) != 0) {
+			FAIL(sd, "decoded structures differ");
+		}
+		if (ins[0].cur != ins[1].cur) {
+			FAIL(sd, "input cursor %td vs %td",
+			     ins[0].cur - wire, ins[1].cur - wire);
+		}
+		if (has_length &&
+		    (obj[0].start != obj[1].start ||
+		     obj[0].cur != obj[1].cur ||
+		     obj[0].roof != obj[1].roof ||
+		     obj[0].container != &ins[0] ||
+		     obj[1].container != &ins[1] ||
+		     obj[0].desc != sd ||
+		     obj[1].desc != plain ||
+		     !streq(obj[0].name, obj[1].name))) {
+			FAIL(sd, "body PBS differs");
+		}
+	}
+	pfree_diag(&d[0]);
+	pfree_diag(&d[1]);
+}
+
+/*
+ * Encode.
+ *
+ * The structure is emitted twice, in the context it is found in a
+ * real message, so that the next payload chain and last substructure
+ * threading is exercised.
+ */
+
+enum context {
+	NOT_EMITTED,	/* only used to parse unknown payloads */
+	IN_PACKET,	/* the message header */
+	IN_MESSAGE,	/* a payload */
+	IN_SA,		/* a proposal */
+	IN_PROPOSAL,	/* a transform */
+	IN_TS,		/* a traffic selector */
+	IN_TS_HEADER,	/* a port range */
+};
+
+struct emit {
+	uint8_t src[2][MAX_STRUCT];
+	size_t tail[2];
+	uint8_t bytes[2][8];
+};
+
+static bool emit_container(struct pbs_out *outs, struct_desc *sd,
+			   const void *src, struct pbs_out *obj)
+{
+	return pbs_out_struct(outs, sd, src, sd->size, obj);
+}
+
+static bool emit_message(struct_desc *sd, bool has_length, enum context context,
+			 const struct emit *e, uint8_t *buf, size_t sizeof_buf,
+			 struct logger *logger)
+{
+	memset(buf, 0xEE, sizeof_buf);
+	struct pbs_out message = open_pbs_out("message", buf, sizeof_buf, logger);
+	struct pbs_out pbs[4];
+	unsigned depth = 0;
+	struct pbs_out *outs = &message;
+
+	if (context != IN_PACKET) {
+		struct isakmp_hdr hdr = {
+			.isa_version = IKEv2_MAJOR_VERSION << ISA_MAJ_SHIFT,
+			.isa_xchg = ISAKMP_v2_IKE_SA_INIT,
+		};
+		if (!emit_container(outs, &isakmp_hdr_desc, &hdr, &pbs[depth])) {
+			return false;
+		}
+		outs = &pbs[depth++];
+	}
+
+	switch (context) {
+	case IN_SA:
+	case IN_PROPOSAL:
+	{
+		struct ikev2_sa sa = { .isasa_np = 0, };
+		if (!emit_container(outs, &ikev2_sa_desc, &sa, &pbs[depth])) {
+			return false;
+		}
+		outs = &pbs[depth++];
+		if (context == IN_PROPOSAL) {
+			struct ikev2_prop prop = {
+				.isap_propnum = 1,
+				.isap_protoid = IKEv2_SEC_PROTO_IKE,
+			};
+			if (!emit_container(outs, &ikev2_prop_desc, &prop, &pbs[depth])) {
+				return false;
+			}
+			outs = &pbs[depth++];
+		}
+		break;
+	}
+	case IN_TS:
+	case IN_TS_HEADER:
+	{
+		struct ikev2_ts ts = { .isat_num = 1, };
+		if (!emit_container(outs, &ikev2_ts_i_desc, &ts, &pbs[depth])) {
+			return false;
+		}
+		outs = &pbs[depth++];
+		if (context == IN_TS_HEADER) {
+			struct ikev2_ts_header tsh = {
+				.isath_type = IKEv2_TS_IPV4_ADDR_RANGE,
+			};
+			if (!emit_container(outs, &ikev2_ts_header_desc, &tsh, &pbs[depth])) {
+				return false;
+			}
+			outs = &pbs[depth++];
+		}
+		break;
+	}
+	default:
+		break;
+	}
+
+	for (unsigned i = 0; i < 2; i++) {
+		struct pbs_out obj;
+		if (!pbs_out_struct(outs, sd, e->src[i], sd->size,
+				    has_length ? &obj : NULL)) {
+			return false;
+		}
+		if (context == IN_PACKET) {
+			/* thread a payload onto the header's chain */
+			struct ikev2_generic gen = { .isag_np = 0, };
+			if (!pbs_out_struct(&obj, &ikev2_nonce_desc, &gen, sizeof(gen), NULL)) {
+				return false;
+			}
+		}
+		if (has_length) {
+			if (!pbs_out_raw(&obj, e->bytes[i], e->tail[i], "tail")) {
+				return false;
+			}
+			close_output_pbs(&obj);
+		}
+		if (context == IN_PACKET) {
+			/* a message has only one header */
+			break;
+		}
+	}
+
+	while (depth > 0) {
+		close_output_pbs(&pbs[--depth]);
+	}
+	close_output_pbs(&message);
+	return true;
+}
+
+static void check_encode(struct_desc *sd, struct_desc *plain,
+			 enum context context, struct logger *logger)
+{
+	struct emit e;
+	for (unsigned i = 0; i < 2; i++) {
+		/* chain fields are initialized by the caller */
+		int chain = 0;
+		if (context == IN_SA || context == IN_PROPOSAL) {
+			/* last substructure is zero */
+			chain = (i == 0 ? (int)(context == IN_SA ?
+						v2_PROPOSAL_NON_LAST :
+						v2_TRANSFORM_NON_LAST) : 0);
+		}
+		memset(e.src[i], 0, sizeof(e.src[i]));
+		random_struct(sd, e.src[i], false, chain, /*known_enums*/true);
+		e.tail[i] = rnd(sizeof(e.bytes[i]) + 1);
+		for (unsigned b = 0; b < sizeof(e.bytes[i]); b++) {
+			e.bytes[i][b] = rnd(256);
+		}
+	}
+
+	uint8_t buf[2][256];
+	bool ok[2];
+	bool has_length = (sd->codec->length >= 0);
+	unsigned long was_logged = logged;
+	ok[0] = emit_message(sd, has_length, context, &e, buf[0], sizeof(buf[0]), logger);
+	ok[1] = emit_message(plain, has_length, context, &e, buf[1], sizeof(buf[1]), logger);
+	encodes++;
+	encode_rejects += !ok[0];
+	if (ok[0] != ok[1]) {
+		FAIL(sd, "codec %s, interpreter %s",
+		     ok[0] ? "succeeded" : "failed",
+		     ok[1] ? "succeeded" : "failed");
+	}
+	if (memcmp(buf[0], buf[1], sizeof(buf[0])) != 0) {
+		FAIL(sd, "encoded messages differ");
+	}
+	if (logged != was_logged) {
+		FAIL(sd, "encoders logged %lu unexpected messages", logged - was_logged);
+	}
+}
+
+/*
+ * Emitting an unknown value in each ft_enum field must fail, in both
+ * encoders, with exactly one pexpect() each.  Stderr is pointed at
+ * /dev/null so the expected pexpect()s don't look like a problem.
+ */
+
+static void check_encode_unknown_enum(struct_desc *sd, struct_desc *plain,
+				      enum context context, struct logger *logger)
+{
+	bool has_length = (sd->codec->length >= 0);
+	unsigned offset = 0;
+	for (field_desc *fp = sd->fields; fp->field_type != ft_end; offset += fp->size, fp++) {
+		if (fp->field_type != ft_enum) {
+			continue;
+		}
+		uint64_t roof = UINT64_C(1) << (fp->size * BITS_PER_BYTE);
+		uint64_t unknown = roof - 1;
+		while (enum_name(fp->desc, unknown) != NULL) {
+			unknown--;
+		}
+		struct emit e = {0};
+		random_struct(sd, e.src[0], false, 0, /*known_enums*/true);
+		put_value(e.src[0] + offset, fp->size, unknown, false);
+		memcpy(e.src[1], e.src[0], sizeof(e.src[1]));
+
+		fflush(stderr);
+		int saved_stderr = dup(STDERR_FILENO);
+		int null = open("/dev/null", O_WRONLY);
+		dup2(null, STDERR_FILENO);
+		close(null);
+
+		bool ok[2];
+		unsigned long was_logged[2];
+		for (unsigned v = 0; v < 2; v++) {
+			uint8_t buf[256];
+			was_logged[v] = logged;
+			ok[v] = emit_message(v == 0 ? sd : plain, has_length, context,
+					     &e, buf, sizeof(buf), logger);
+			was_logged[v] = logged - was_logged[v];
+		}
+
+		fflush(stderr);
+		dup2(saved_stderr, STDERR_FILENO);
+		close(saved_stderr);
+
+		encodes++;
+		encode_rejects++;
+		for (unsigned v = 0; v < 2; v++) {
+			if (ok[v] || was_logged[v] != 1) {
+				FAIL(sd, "%s emitting unknown %s %"PRIu64" %s, logging %lu messages",
+				     v == 0 ? "codec" : "interpreter", fp->name, unknown,
+				     ok[v] ? "succeeded" : "failed", was_logged[v]);
+			}
+		}
+	}
+}
+
+/*
+ * Timing.
+ */
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double time_decode(struct_desc *sd, const uint8_t *wire, size_t len,
+			  unsigned long count)
+{
+	uint8_t dest[MAX_STRUCT];
+	double start = now();
+	for (unsigned long i = 0; i < count; i++) {
+		struct pbs_in ins = pbs_in_from_shunk(shunk2(wire, len), "wire");
+		struct pbs_in obj;
+		diag_t d = pbs_in_struct(&ins, sd, dest, sizeof(dest), &obj);
+		if (d != NULL) {
+			FAIL(sd, "%s", str_diag(d));
+			pfree_diag(&d);
+			break;
+		}
+	}
+	return (now() - start) / count;
+}
+
+static double time_encode(struct_desc *sd, const void *src, unsigned long count,
+			  struct logger *logger)
+{
+	uint8_t buf[64];
+	double start = now();
+	for (unsigned long i = 0; i < count; i++) {
+		struct pbs_out outs = open_pbs_out("message", buf, sizeof(buf), logger);
+		struct pbs_out obj;
+		if (!pbs_out_struct(&outs, sd, src, sd->size, &obj)) {
+			FAIL(sd, "emit failed");
+			break;
+		}
+		close_output_pbs(&obj);
+	}
+	return (now() - start) / count;
+}
+
+static void bench(struct_desc *sd, struct_desc *plain, const uint8_t *wire,
+		  size_t len, const void *src, unsigned long count,
+		  struct logger *logger)
+{
+	double d[2] = {
+		time_decode(sd, wire, len, count),
+		time_decode(plain, wire, len, count),
+	};
+	double e[2] = {
+		time_encode(sd, src, count, logger),
+		time_encode(plain, src, count, logger),
+	};
+	printf("%-45s decode %6.1f ns (was %6.1f)  encode %6.1f ns (was %6.1f)\n",
+	       sd->name, d[0], d[1], e[0], e[1]);
+}
+
+static const struct {
+	struct_desc *sd;
+	enum context context;
+} tests[] = {
+	{ &isakmp_hdr_desc, IN_PACKET, },
+	{ &ikev2_generic_desc, NOT_EMITTED, },
+	{ &ikev2_unknown_payload_desc, IN_MESSAGE, },
+	{ &ikev2_sa_desc, IN_MESSAGE, },
+	{ &ikev2_prop_desc, IN_SA, },
+	{ &ikev2_trans_desc, IN_PROPOSAL, },
+	{ &ikev2_ke_desc, IN_MESSAGE, },
+	{ &ikev2_nonce_desc, IN_MESSAGE, },
+	{ &ikev2_notify_desc, IN_MESSAGE, },
+	{ &ikev2_vendor_id_desc, IN_MESSAGE, },
+	{ &ikev2_ts_i_desc, IN_MESSAGE, },
+	{ &ikev2_ts_r_desc, IN_MESSAGE, },
+	{ &ikev2_ts_header_desc, IN_TS, },
+	{ &ikev2_ts_portrange_desc, IN_TS_HEADER, },
+	{ &ikev2_sk_desc, IN_MESSAGE, },
+	{ &ikev2_eap_desc, IN_MESSAGE, },
+};
+
+int main(int argc, char *argv[])
+{
+	tool_init_log(argv[0]);
+	/* count everything the encoders log */
+	struct logger *logger = clone_const_thing(global_logger, "counting logger");
+	logger->object_vec = &counting_object_vec;
+	unsigned long iterations = (argc > 1 ? strtoul(argv[1], NULL, 0) : 20000);
+	if (argc > 2) {
+		seed = strtoull(argv[2], NULL, 0) | 1;
+	}
+
+	/* quiet; and DBG_TMI would bypass the encoders */
+	cur_debugging = DBG_NONE;
+
+	for (unsigned t = 0; t < elemsof(tests); t++) {
+		struct_desc *sd = tests[t].sd;
+		if (sd->codec == NULL) {
+			FAIL(sd, "has no codec");
+			continue;
+		}
+		passert(sd->size <= MAX_STRUCT);
+		struct_desc plain = {
+			.name = sd->name,
+			.fields = sd->fields,
+			.size = sd->size,
+			.pt = sd->pt,
+			.nsst = sd->nsst,
+			/* .codec = NULL, */
+		};
+		check_layout(sd);
+		if (tests[t].context != NOT_EMITTED) {
+			check_encode_unknown_enum(sd, &plain, tests[t].context, logger);
+		}
+		for (unsigned long i = 0; i < iterations; i++) {
+			check_decode(sd, &plain);
+			if (tests[t].context != NOT_EMITTED) {
+				check_encode(sd, &plain, tests[t].context, logger);
+			}
+		}
+	}
+
+	printf("%lu decodes (%lu rejected), %lu encodes (%lu rejected)\n",
+	       decodes, decode_rejects, encodes, encode_rejects);
+
+	/* a Notify and a Key Exchange payload header */
+	static const uint8_t notify_wire[] = { 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x40, 0x04, };
+	static const struct ikev2_notify notify = { .isan_type = v2N_NAT_DETECTION_SOURCE_IP, };
+	static const uint8_t ke_wire[] = { 0x00, 0x00, 0x00, 0x08, 0x00, 0x0e, 0x00, 0x00, };
+	static const struct ikev2_ke ke = { .isak_group = OAKLEY_GROUP_MODP2048, };
+	struct_desc plain_notify = {
+		.name = ikev2_notify_desc.name,
+		.fields = ikev2_notify_desc.fields,
+		.size = ikev2_notify_desc.size,
+		.pt = ikev2_notify_desc.pt,
+	};
+	struct_desc plain_ke = {
+		.name = ikev2_ke_desc.name,
+		.fields = ikev2_ke_desc.fields,
+		.size = ikev2_ke_desc.size,
+		.pt = ikev2_ke_desc.pt,
+	};
+	bench(&ikev2_notify_desc, &plain_notify, notify_wire, sizeof(notify_wire),
+	      &notify, iterations * 10, logger);
+	bench(&ikev2_ke_desc, &plain_ke, ke_wire, sizeof(ke_wire),
+	      &ke, iterations * 10, logger);
+
+	pfree(logger);
+
+	if (fails > 0) {
+		fprintf(stderr, "TOTAL FAILURES: %u\n", fails);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,381 @@
+/* IKEv2 Session Resumption ticket check, for libreswan
+ *
+ * Copyright (C) 2026 Libreswan contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <https://www.gnu.org/licenses/gpl2.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Check the ticket sealing, key rotation and snapshot code
+ * (ikev2_ticket.c): tickets round-trip; a tampered, expired or
+ * foreign ticket is rejected; the key survives a restart; and a
+ * truncated or corrupt snapshot is survived.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lswtool.h"
+#include "lswlog.h"
+#include "lswalloc.h"
+#include "lswnss.h"
+#include "constants.h"
+#include "crypt_symkey.h"
+#include "ike_alg.h"
+#include "ike_alg_encrypt.h"
+#include "ike_alg_prf.h"
+#include "ike_alg_integ.h"
+#include "ike_alg_dh.h"
+
+#include "timer.h"
+#include "ikev2_ticket.h"
+
+#define ERROR 124
+
+static unsigned fails;
+static struct logger *logger;
+
+#define FAIL(FMT, ...)							\
+	{								\
+		fails++;						\
+		fprintf(stderr, "FAIL: %s: "FMT"\n",			\
+			__func__, ##__VA_ARGS__);			\
+	}
+
+#define CHECK(COND)							\
+	{								\
+		if (!(COND)) {						\
+			FAIL("line %d: %s", __LINE__, #COND);		\
+		}							\
+	}
+
+/*
+ * Stubs for the bits of pluto ikev2_ticket.c uses.
+ */
+
+static global_timer_cb *rotate_cb;
+static deltatime_t rotate_delay;
+
+void init_oneshot_timer(enum global_timer type, global_timer_cb *cb)
+{
+	passert(type == EVENT_ROTATE_TICKET_KEY);
+	rotate_cb = cb;
+}
+
+void schedule_oneshot_timer(enum global_timer type, deltatime_t delay)
+{
+	passert(type == EVENT_ROTATE_TICKET_KEY);
+	rotate_delay = delay;
+}
+
+/*
+ * Tickets.
+ */
+
+static char snapshot[] = "/tmp/ticketcheck.XXXXXX";
+
+static struct v2_resumption *new_resumption(const char *name, intmax_t lifetime)
+{
+	static const uint8_t sk_d[] = "not a very secret SK_d";
+	static const uint8_t peer_id[] = "east";
+	struct v2_resumption *r = alloc_thing(struct v2_resumption, "test resumption");
+	r->encrypt = &ike_alg_encrypt_aes_cbc;
+	r->enckeylen = 256;
+	r->prf = &ike_alg_prf_sha2_256;
+	r->integ = &ike_alg_integ_sha2_256;
+	r->dh = &ike_alg_dh_secp256r1;
+	r->sk_d = clone_bytes_as_chunk(sk_d, sizeof(sk_d), "test SK_d");
+	r->peer_id_type = ID_FQDN;
+	r->peer_id = clone_bytes_as_chunk(peer_id, sizeof(peer_id) - 1, "test peer ID");
+	r->connection_name = clone_str(name, "test connection name");
+	memset(r->policy_hash, 0x5a, sizeof(r->policy_hash));
+	r->generation = 7;
+	r->expires = realtime(realnow().rt.tv_sec + lifetime);
+	return r;
+}
+
+static bool same_resumption(const struct v2_resumption *l, const struct v2_resumption *r)
+{
+	return (l->encrypt == r->encrypt &&
+		l->enckeylen == r->enckeylen &&
+		l->prf == r->prf &&
+		l->integ == r->integ &&
+		l->dh == r->dh &&
+		hunk_eq(l->sk_d, r->sk_d) &&
+		l->peer_id_type == r->peer_id_type &&
+		hunk_eq(l->peer_id, r->peer_id) &&
+		streq(l->connection_name, r->connection_name) &&
+		memeq(l->policy_hash, r->policy_hash, sizeof(l->policy_hash)) &&
+		l->generation == r->generation &&
+		l->expires.rt.tv_sec == r->expires.rt.tv_sec);
+}
+
+/* unseal TICKET expecting WHY (NULL for success) */
+static void check_unseal(int line, chunk_t ticket, const char *why,
+			 const struct v2_resumption *expected)
+{
+	struct v2_resumption *r;
+	const char *got = unseal_v2_ticket(HUNK_AS_SHUNK(ticket), &r, logger);
+	if (why == NULL && got != NULL) {
+		FAIL("line %d: expecting success got '%s'", line, got);
+	} else if (why != NULL && (got == NULL || !streq(why, got))) {
+		FAIL("line %d: expecting '%s' got '%s'", line, why,
+		     (got == NULL ? "success" : got));
+	} else if (why == NULL && !same_resumption(r, expected)) {
+		FAIL("line %d: unsealed ticket differs", line);
+	} else if (why != NULL && r != NULL) {
+		FAIL("line %d: failure returned a ticket", line);
+	}
+	free_v2_resumption(&r);
+}
+
+#define CHECK_UNSEAL(TICKET, WHY, EXPECTED) \
+	check_unseal(__LINE__, TICKET, WHY, EXPECTED)
+
+static void check_seal(void)
+{
+	init_v2_tickets(NULL, logger);
+	CHECK(rotate_cb != NULL);
+	CHECK(deltasecs(rotate_delay) == deltasecs(TICKET_KEY_LIFETIME));
+
+	struct v2_resumption *r = new_resumption("east-west", 60);
+	chunk_t ticket = seal_v2_ticket(r, logger);
+	CHECK(ticket.len > 0);
+	CHECK_UNSEAL(ticket, NULL, r);
+
+	/* two tickets for the same IKE SA don't share a nonce */
+	chunk_t again = seal_v2_ticket(r, logger);
+	CHECK(again.len == ticket.len);
+	CHECK(!hunk_eq(again, ticket));
+	CHECK_UNSEAL(again, NULL, r);
+	free_chunk_content(&again);
+
+	/* flip a bit in the tag, the text, the nonce and the key ID */
+	size_t offsets[] = { ticket.len - 1, ticket.len / 2, 4, 0, };
+	FOR_EACH_ELEMENT(offset, offsets) {
+		chunk_t tampered = clone_hunk(ticket, "tampered ticket");
+		tampered.ptr[*offset] ^= 0x01;
+		CHECK_UNSEAL(tampered, (*offset == 0 ? "issued using an unknown key" :
+					"integrity check failed"), NULL);
+		free_chunk_content(&tampered);
+	}
+
+	/* cut short */
+	chunk_t truncated = clone_hunk(ticket, "truncated ticket");
+	truncated.len = 20;
+	CHECK_UNSEAL(truncated, "truncated", NULL);
+	truncated.len = ticket.len - 1;
+	CHECK_UNSEAL(truncated, "integrity check failed", NULL);
+	free_chunk_content(&truncated);
+
+	/* expired */
+	struct v2_resumption *old = new_resumption("east-west", -1);
+	chunk_t expired = seal_v2_ticket(old, logger);
+	CHECK_UNSEAL(expired, "expired", NULL);
+	free_chunk_content(&expired);
+	free_v2_resumption(&old);
+
+	/* the previous key is still accepted, the one before isn't */
+	rotate_cb(logger);
+	CHECK_UNSEAL(ticket, NULL, r);
+	chunk_t newer = seal_v2_ticket(r, logger);
+	CHECK(memcmp(newer.ptr, ticket.ptr, 4) != 0);
+	CHECK_UNSEAL(newer, NULL, r);
+	rotate_cb(logger);
+	CHECK_UNSEAL(ticket, "issued using an unknown key", NULL);
+	CHECK_UNSEAL(newer, NULL, r);
+
+	/* relabelled with a known key ID, the wrong key is used */
+	memcpy(ticket.ptr, newer.ptr, 4);
+	CHECK_UNSEAL(ticket, "integrity check failed", NULL);
+	free_chunk_content(&newer);
+
+	/* a new pluto, with its own key */
+	chunk_t foreign = seal_v2_ticket(r, logger);
+	free_v2_tickets();
+	init_v2_tickets(NULL, logger);
+	CHECK_UNSEAL(foreign, "issued using an unknown key", NULL);
+	free_chunk_content(&foreign);
+
+	free_chunk_content(&ticket);
+	free_v2_resumption(&r);
+	free_v2_tickets();
+}
+
+/*
+ * Snapshot.
+ */
+
+static void write_file(const char *file, const uint8_t *bytes, size_t size)
+{
+	FILE *f = fopen(file, "w");
+	if (f == NULL || fwrite(bytes, 1, size, f) != size || fclose(f) != 0) {
+		fprintf(stderr, "%s: write failed\n", file);
+		exit(1);
+	}
+}
+
+static chunk_t read_file(const char *file)
+{
+	FILE *f = fopen(file, "r");
+	if (f == NULL) {
+		fprintf(stderr, "%s: open failed\n", file);
+		exit(1);
+	}
+	uint8_t buf[4096];
+	size_t size = fread(buf, 1, sizeof(buf), f);
+	fclose(f);
+	return clone_bytes_as_chunk(buf, size, "snapshot");
+}
+
+static void check_snapshot(void)
+{
+	/* the key is written as soon as it is created */
+	init_v2_tickets(snapshot, logger);
+	struct v2_resumption *r = new_resumption("east-west", 60);
+	chunk_t ticket = seal_v2_ticket(r, logger);
+	CHECK(access(snapshot, R_OK) == 0);
+	free_v2_tickets();	/* a crash; nothing saved */
+
+	init_v2_tickets(snapshot, logger);
+	CHECK_UNSEAL(ticket, NULL, r);
+	CHECK(v2_ticket_generation("east-west") == 0);
+
+	/* generations are written as they change */
+	bump_v2_ticket_generation("east-west", logger);
+	bump_v2_ticket_generation("east-west", logger);
+	bump_v2_ticket_generation("north-south", logger);
+	CHECK(v2_ticket_generation("east-west") == 2);
+	CHECK(v2_ticket_generation("north-south") == 1);
+	CHECK(v2_ticket_generation("other") == 0);
+
+	/* and tickets at shutdown */
+	struct v2_resumption *held = new_resumption("north-south", 60);
+	held->ticket = clone_hunk(ticket, "held ticket");
+	stash_v2_ticket(held);
+	struct v2_resumption *gone = new_resumption("west-east", -1);
+	gone->ticket = clone_hunk(ticket, "expired ticket");
+	stash_v2_ticket(gone);
+	save_v2_tickets(logger);
+	free_v2_tickets();
+
+	init_v2_tickets(snapshot, logger);
+	CHECK_UNSEAL(ticket, NULL, r);
+	CHECK(v2_ticket_generation("east-west") == 2);
+	CHECK(v2_ticket_generation("north-south") == 1);
+	struct v2_resumption *restored = unstash_v2_ticket("north-south");
+	CHECK(restored != NULL);
+	if (restored != NULL) {
+		struct v2_resumption *expected = new_resumption("north-south", 60);
+		expected->expires = restored->expires;
+		CHECK(same_resumption(restored, expected));
+		CHECK(hunk_eq(restored->ticket, ticket));
+		free_v2_resumption(&expected);
+		/* single use */
+		CHECK(unstash_v2_ticket("north-south") == NULL);
+		free_v2_resumption(&restored);
+	}
+	/* expired tickets aren't restored */
+	CHECK(unstash_v2_ticket("west-east") == NULL);
+	stash_v2_ticket(new_resumption("north-south", 60));
+	save_v2_tickets(logger);
+	free_v2_tickets();
+
+	chunk_t good = read_file(snapshot);
+
+	/* truncated within the header: ignored, so a new key */
+	write_file(snapshot, good.ptr, 20);
+	init_v2_tickets(snapshot, logger);
+	CHECK_UNSEAL(ticket, "issued using an unknown key", NULL);
+	CHECK(v2_ticket_generation("east-west") == 0);
+	free_v2_tickets();
+
+	/* not a snapshot: ignored */
+	chunk_t garbage = clone_hunk(good, "garbage");
+	memset(garbage.ptr, 'x', garbage.len);
+	write_file(snapshot, garbage.ptr, garbage.len);
+	init_v2_tickets(snapshot, logger);
+	CHECK_UNSEAL(ticket, "issued using an unknown key", NULL);
+	free_v2_tickets();
+	free_chunk_content(&garbage);
+
+	/* truncated within the ticket: keys and generations kept */
+	write_file(snapshot, good.ptr, good.len - 1);
+	init_v2_tickets(snapshot, logger);
+	CHECK_UNSEAL(ticket, NULL, r);
+	CHECK(v2_ticket_generation("east-west") == 2);
+	restored = unstash_v2_ticket("north-south");
+	CHECK(restored == NULL);
+	free_v2_resumption(&restored);
+	free_v2_tickets();
+
+	/* records after the keys scribbled on: keys kept */
+	chunk_t corrupt = clone_hunk(good, "corrupt");
+	for (size_t i = 120; i < corrupt.len; i++) {
+		corrupt.ptr[i] = 0xff;
+	}
+	write_file(snapshot, corrupt.ptr, corrupt.len);
+	init_v2_tickets(snapshot, logger);
+	CHECK_UNSEAL(ticket, NULL, r);
+	free_v2_tickets();
+	free_chunk_content(&corrupt);
+
+	/* cut at every length; mustn't crash or leak */
+	for (size_t len = 0; len < good.len; len++) {
+		write_file(snapshot, good.ptr, len);
+		init_v2_tickets(snapshot, logger);
+		free_v2_tickets();
+	}
+
+	free_chunk_content(&good);
+	free_chunk_content(&ticket);
+	free_v2_resumption(&r);
+	unlink(snapshot);
+	char tmp[sizeof(snapshot) + 4];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", snapshot);
+	unlink(tmp);
+}
+
+int main(int argc UNUSED, char *argv[])
+{
+	logger = tool_init_log(argv[0]);
+
+	diag_t d = lsw_nss_setup(NULL, LSW_NSS_READONLY, logger);
+	if (d != NULL) {
+		fatal_diag(ERROR, logger, &d, "%s", "");
+	}
+	init_crypt_symkey(logger);
+	init_ike_alg(logger);
+
+	int fd = mkstemp(snapshot);
+	if (fd < 0) {
+		fprintf(stderr, "%s: mkstemp failed\n", snapshot);
+		exit(1);
+	}
+	close(fd);
+	unlink(snapshot);
+
+	check_seal();
+	check_snapshot();
+
+	lsw_nss_shutdown();
+
+	if (report_leaks(logger)) {
+		fails++;
+	}
+	if (fails > 0) {
+		fprintf(stderr, "TOTAL FAILURES: %u\n", fails);
+		exit(1);
+	}
+	return 0;
+}
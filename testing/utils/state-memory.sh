@@ -0,0 +1,143 @@
+#!/bin/sh
+#
+# How much memory does pluto use per IKE SA?
+#
+# Starts two plutos on the loopback, west on 127.0.0.1 and east on
+# 127.0.0.2, both with --leak-detective.  Loads N connections into
+# each, records east's heap and RSS, establishes the N IKE SAs, and
+# records them again.  The difference, divided by N, is printed
+# along with east's biggest heap categories and the "memory usage by
+# state kind" section of whack --memory.
+#
+# Child SAs are only established when the kernel can install ESP;
+# when it can't, each connection ends up with just its IKE SA.
+#
+# Needs root (to bind port 500) and certutil (to create the NSS
+# databases).  127.0.0.2 must be reachable via lo (it is on Linux).
+#
+# Usage: state-memory.sh <OBJDIR> [<N>]
+#   e.g. state-memory.sh OBJ.linux.x86_64 1000
+
+set -eu
+
+if test $# -lt 1 ; then
+	echo "Usage: $0 <OBJDIR> [<N>]" 1>&2
+	exit 1
+fi
+
+objdir=$(cd $1 && pwd)
+n=${2:-1000}
+pluto=${objdir}/programs/pluto/pluto
+whack=${objdir}/programs/whack/whack
+
+tmp=$(mktemp -d /tmp/state-memory.XXXXXX)
+cleanup() {
+	for host in west east ; do
+		test -r ${tmp}/${host}/pluto.pid && kill $(cat ${tmp}/${host}/pluto.pid) 2>/dev/null || :
+	done
+	sleep 1
+	rm -rf ${tmp}
+}
+trap cleanup EXIT
+
+cat > ${tmp}/ipsec.secrets <<EOF
+%any %any : PSK "this is a benchmark, not a secret"
+EOF
+
+for host in west east ; do
+	case ${host} in
+	west ) addr=127.0.0.1 ;;
+	east ) addr=127.0.0.2 ;;
+	esac
+	mkdir ${tmp}/${host} ${tmp}/${host}/nss
+	certutil -N -d sql:${tmp}/${host}/nss --empty-password
+	${pluto} --nofork --leak-detective \
+		 --rundir ${tmp}/${host} \
+		 --nssdir ${tmp}/${host}/nss \
+		 --ipsecdir ${tmp} \
+		 --secretsfile ${tmp}/ipsec.secrets \
+		 --logfile ${tmp}/${host}/pluto.log \
+		 --listen ${addr} &
+done
+
+# wait for the control sockets
+for host in west east ; do
+	i=0
+	while ! test -S ${tmp}/${host}/pluto.ctl ; do
+		i=$((i + 1))
+		if test $i -gt 30 ; then
+			echo "${host}: pluto did not start; see ${tmp}/${host}/pluto.log" 1>&2
+			exit 1
+		fi
+		sleep 1
+	done
+	${whack} --rundir ${tmp}/${host} --listen > /dev/null
+done
+
+# each connection gets its own IDs so that it gets its own IKE SA
+echo "loading ${n} connections"
+i=0
+while test $i -lt $n ; do
+	client="$((i / 256)).$((i % 256))"
+	for host in west east ; do
+		${whack} --rundir ${tmp}/${host} \
+			 --name c$i --ikev2 --psk --encrypt --tunnel \
+			 --host 127.0.0.1 --id @west$i --client 10.1.${client}/32 \
+			 --to \
+			 --host 127.0.0.2 --id @east$i --client 10.2.${client}/32 \
+			 > /dev/null
+	done
+	i=$((i + 1))
+done
+
+# sum the heap categories; and RSS
+heap() {
+	${whack} --rundir ${tmp}/east --memory |
+		awk '/memory usage by category:/ { on = 1; next }
+		     on && !/\*/ { exit }
+		     on { sum += $(NF - 6) }
+		     END { print sum + 0 }'
+}
+rss() {
+	awk '/^VmRSS:/ { print $2 * 1024 }' /proc/$(cat ${tmp}/east/pluto.pid)/status
+}
+
+heap_before=$(heap)
+rss_before=$(rss)
+
+echo "establishing ${n} IKE SAs"
+i=0
+while test $i -lt $n ; do
+	${whack} --rundir ${tmp}/west --name c$i --initiate --asynchronous > /dev/null
+	i=$((i + 1))
+done
+
+i=0
+while : ; do
+	established=$(${whack} --rundir ${tmp}/east --showstates |
+			      grep -c 'ESTABLISHED_IKE_SA' || :)
+	test ${established} -ge ${n} && break
+	i=$((i + 1))
+	if test $i -gt 120 ; then
+		echo "only ${established} of ${n} IKE SAs established" 1>&2
+		exit 1
+	fi
+	sleep 1
+done
+
+heap_after=$(heap)
+rss_after=$(rss)
+
+echo
+echo "east, ${n} IKE SAs:"
+echo "  heap: $((heap_after - heap_before)) bytes; $(((heap_after - heap_before) / n)) per IKE SA"
+echo "  RSS:  $((rss_after - rss_before)) bytes; $(((rss_after - rss_before) / n)) per IKE SA"
+echo
+echo "east, biggest heap categories:"
+${whack} --rundir ${tmp}/east --memory |
+	awk '/memory usage by category:/ { on = 1; next }
+	     on && !/\*/ { exit }
+	     on && n++ < 12 { print }'
+echo
+${whack} --rundir ${tmp}/east --memory |
+	sed -n -e '/memory usage by state kind:/,$p'